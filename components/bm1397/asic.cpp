@@ -103,7 +103,8 @@ void Asic::sendReadAddress(void)
 
 // Function to set the hash frequency
 // gives the same PLL settings as the S21 dumps
-bool Asic::sendHashFrequency(float target_freq) {
+// chip < 0 broadcasts to all chips, otherwise only the chip with this index is set
+bool Asic::sendHashFrequency(float target_freq, int chip) {
     float min_diff = 2.0;
     uint8_t freqbuf[6] = {0x00, 0x08, 0x40, 0xA0, 0x02, 0x41};
     int postdiv_min = 255;
@@ -150,6 +151,13 @@ bool Asic::sendHashFrequency(float target_freq) {
     freqbuf[4] = best_refdiv;
     freqbuf[5] = (((best_postdiv1 - 1) & 0xf) << 4) | ((best_postdiv2 - 1) & 0xf);
 
+    if (chip >= 0) {
+        freqbuf[0] = addrFromChipIndex((uint8_t) chip);
+        send(CMD_WRITE_SINGLE, freqbuf, sizeof(freqbuf));
+        ESP_LOGI(TAG, "Setting Frequency of chip %d to %.2fMHz (%.2f) (error: %.2fMHZ)", chip, target_freq, best_newf, min_diff);
+        return true;
+    }
+
     send(CMD_WRITE_ALL, freqbuf, sizeof(freqbuf));
     //ESP_LOG_BUFFER_HEX(TAG, freqbuf, sizeof(freqbuf));
 
@@ -222,9 +230,8 @@ void Asic::readCounter(uint8_t reg) {
 
 
 // Function to perform frequency transition up or down
-bool Asic::doFrequencyTransition(float target_frequency) {
+bool Asic::doFrequencyTransition(float current, float target_frequency, int chip) {
     float step = 6.25;
-    float current = m_current_frequency;
     float target = target_frequency;
 
     // Determine the direction of the transition
@@ -240,7 +247,7 @@ bool Asic::doFrequencyTransition(float target_frequency) {
             next_dividable = floor(current / step) * step;
         }
         current = next_dividable;
-        if (!sendHashFrequency(current)) {
+        if (!sendHashFrequency(current, chip)) {
             printf("ERROR: Failed to set frequency to %.2f MHz\n", current);
             return false;
         }
@@ -251,7 +258,7 @@ bool Asic::doFrequencyTransition(float target_frequency) {
     while ((direction > 0 && current < target) || (direction < 0 && current > target)) {
         float next_step = fmin(fabs(direction), fabs(target - current));
         current += direction > 0 ? next_step : -next_step;
-        if (!sendHashFrequency(current)) {
+        if (!sendHashFrequency(current, chip)) {
             printf("ERROR: Failed to set frequency to %.2f MHz\n", current);
             return false;
         }
@@ -259,7 +266,7 @@ bool Asic::doFrequencyTransition(float target_frequency) {
     }
 
     // Set the exact target frequency to finalize
-    if (!sendHashFrequency(target)) {
+    if (!sendHashFrequency(target, chip)) {
         printf("ERROR: Failed to set frequency to %.2f MHz\n", target);
         return false;
     }
@@ -323,7 +330,23 @@ void Asic::setJobDifficultyMask(int difficulty)
 
 // can ramp up and down in 6.25MHz steps
 bool Asic::setAsicFrequency(float target_freq) {
-    return doFrequencyTransition(target_freq);
+    return doFrequencyTransition(m_current_frequency, target_freq);
+}
+
+// ramps a single chip, the caller keeps track of the per-chip frequency
+bool Asic::setChipFrequency(int chip, float current, float target) {
+    return doFrequencyTransition(current, target, chip);
+}
+
+// chips on individual frequencies are ramped one by one from their own
+// frequency, the broadcast afterwards doesn't change any chip
+bool Asic::setAsicFrequency(float target_freq, const float *chip_freqs, int num_chips) {
+    for (int i = 0; i < num_chips; i++) {
+        if (chip_freqs[i] != target_freq && !doFrequencyTransition(chip_freqs[i], target_freq, i)) {
+            return false;
+        }
+    }
+    return sendHashFrequency(target_freq);
 }
 
 
@@ -347,6 +370,25 @@ uint8_t Asic::sendWork(uint32_t job_id, bm_job *next_bm_job)
     return job.job_id;
 }
 
+// the ASIC job ID sendWork() will use
+uint8_t Asic::getAsicJobId(uint32_t job_id)
+{
+    return jobToAsicId(job_id);
+}
+
+// distinct job IDs, a slot is reused after this many jobs
+int Asic::getJobSlotCount()
+{
+    bool used[128] = {};
+    int count = 0;
+    for (int i = 0; i < 256; i++) {
+        uint8_t id = jobToAsicId(i) & 0x7f;
+        count += !used[id];
+        used[id] = true;
+    }
+    return count;
+}
+
 bool Asic::receiveWork(asic_result_t *result)
 {
     // wait for a response, wait time is pretty arbitrary
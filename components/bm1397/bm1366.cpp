@@ -100,7 +100,7 @@ uint8_t BM1366::init(uint64_t frequency, uint16_t asic_count, uint32_t difficult
         send6(CMD_WRITE_SINGLE, i * 2, 0x3C, 0x80, 0x00, 0x82, 0xAA);
     }
 
-    doFrequencyTransition(frequency);
+    doFrequencyTransition(m_current_frequency, frequency);
 
     // set 0x10
     setVrFrequency(vrFrequency);
@@ -120,7 +120,7 @@ uint8_t BM1370::init(uint64_t frequency, uint16_t asic_count, uint32_t difficult
     // Core Register Control
     send6(CMD_WRITE_ALL, 0x00, 0x3C, 0x80, 0x00, 0x8D, 0xEE);
 
-    doFrequencyTransition(frequency);
+    doFrequencyTransition(m_current_frequency, frequency);
 
     // set 0x10
     setVrFrequency(vrFrequency);
@@ -0,0 +1,268 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "capture.h"
+
+static const char *TAG = "capture";
+
+static pthread_mutex_t capture_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint8_t *s_buf = NULL;
+static size_t s_size = 0;
+static size_t s_head = 0;
+static size_t s_tail = 0;
+static size_t s_used = 0;
+
+static uint32_t s_frames = 0;
+static uint32_t s_dropped = 0;
+
+// time of the record before the tail and of the last record
+static int64_t s_base_time = 0;
+static int64_t s_last_time = 0;
+
+// checked without lock on the hot path
+static volatile uint8_t s_sources = 0;
+static volatile bool s_paused = false;
+
+// inside a mining.authorize line that continues in the next write
+static bool s_redacting = false;
+
+static size_t put_varint(uint8_t *out, uint64_t v)
+{
+    size_t n = 0;
+    do {
+        uint8_t b = v & 0x7f;
+        v >>= 7;
+        out[n++] = b | (v ? 0x80 : 0x00);
+    } while (v);
+    return n;
+}
+
+static void ring_write(const uint8_t *data, size_t len)
+{
+    size_t first = (len < s_size - s_head) ? len : s_size - s_head;
+    memcpy(s_buf + s_head, data, first);
+    memcpy(s_buf, data + first, len - first);
+    s_head = (s_head + len) % s_size;
+    s_used += len;
+}
+
+static uint64_t ring_varint(size_t *pos)
+{
+    uint64_t v = 0;
+    int shift = 0;
+    uint8_t b;
+    do {
+        b = s_buf[*pos];
+        *pos = (*pos + 1) % s_size;
+        v |= (uint64_t) (b & 0x7f) << shift;
+        shift += 7;
+    } while ((b & 0x80) && shift < 64);
+    return v;
+}
+
+static void drop_oldest(void)
+{
+    size_t pos = s_tail;
+    uint64_t delta = ring_varint(&pos);
+    pos = (pos + 1) % s_size; // type
+    uint64_t len = ring_varint(&pos);
+    pos = (pos + len) % s_size;
+
+    s_used -= (pos + s_size - s_tail) % s_size;
+    s_tail = pos;
+    s_base_time += delta;
+    s_frames--;
+    s_dropped++;
+
+    // wrapped to the same position means the ring is empty now
+    if (!s_frames) {
+        s_used = 0;
+        s_head = s_tail = 0;
+    }
+}
+
+bool CAPTURE_start(size_t size, uint8_t sources)
+{
+    CAPTURE_stop();
+
+    uint8_t *buf = (uint8_t *) heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buf) {
+        ESP_LOGE(TAG, "no memory for %u byte capture buffer", (unsigned) size);
+        return false;
+    }
+
+    pthread_mutex_lock(&capture_mutex);
+    s_buf = buf;
+    s_size = size;
+    s_head = s_tail = s_used = 0;
+    s_frames = s_dropped = 0;
+    s_base_time = s_last_time = esp_timer_get_time();
+    s_paused = false;
+    s_redacting = false;
+    s_sources = sources;
+    pthread_mutex_unlock(&capture_mutex);
+
+    ESP_LOGI(TAG, "capture started (%u bytes, sources 0x%02x)", (unsigned) size, sources);
+    return true;
+}
+
+void CAPTURE_stop(void)
+{
+    pthread_mutex_lock(&capture_mutex);
+    s_sources = 0;
+    uint8_t *buf = s_buf;
+    s_buf = NULL;
+    s_size = s_head = s_tail = s_used = 0;
+    pthread_mutex_unlock(&capture_mutex);
+
+    if (buf) {
+        heap_caps_free(buf);
+        ESP_LOGI(TAG, "capture stopped");
+    }
+}
+
+void CAPTURE_pause(bool pause)
+{
+    s_paused = pause;
+}
+
+static void record_locked(capture_type_t type, const uint8_t *data, size_t len, int64_t now)
+{
+    uint8_t hdr[21];
+    size_t hdr_len = put_varint(hdr, (uint64_t) (now - s_last_time));
+    hdr[hdr_len++] = (uint8_t) type;
+    hdr_len += put_varint(hdr + hdr_len, len);
+
+    // a single frame must not take more than a quarter of the ring
+    if (hdr_len + len > s_size / 4) {
+        s_dropped++;
+        return;
+    }
+
+    while (s_size - s_used < hdr_len + len) {
+        drop_oldest();
+    }
+
+    ring_write(hdr, hdr_len);
+    ring_write(data, len);
+    s_last_time = now;
+    s_frames++;
+}
+
+// mining.authorize carries the pool password, its params are replaced. A
+// line split over several writes is cut until its newline, the rest of the
+// write is kept.
+static void record_stratum_tx_locked(const uint8_t *data, size_t len, int64_t now)
+{
+    static const char method[] = "\"mining.authorize\"";
+    static const char redacted[] = "\"<redacted>\"]}\n";
+
+    if (s_redacting) {
+        const uint8_t *nl = (const uint8_t *) memchr(data, '\n', len);
+        if (!nl) {
+            return;
+        }
+        s_redacting = false;
+        len -= nl + 1 - data;
+        data = nl + 1;
+        if (len) {
+            record_locked(CAPTURE_STRATUM_TX, data, len, now);
+        }
+        return;
+    }
+
+    const uint8_t *m = (const uint8_t *) memmem(data, len, method, sizeof(method) - 1);
+    if (!m) {
+        record_locked(CAPTURE_STRATUM_TX, data, len, now);
+        return;
+    }
+
+    const uint8_t *end = data + len;
+    const uint8_t *nl = (const uint8_t *) memchr(m, '\n', end - m);
+    const uint8_t *lineEnd = nl ? nl : end;
+
+    // keep everything up to the params array
+    const uint8_t *keep = m + sizeof(method) - 1;
+    const uint8_t *params = (const uint8_t *) memmem(keep, lineEnd - keep, "\"params\"", 8);
+    const uint8_t *open = params ? (const uint8_t *) memchr(params, '[', lineEnd - params) : NULL;
+    const char *insert = ", \"params\": [";
+    if (open) {
+        keep = open + 1;
+        insert = "";
+    }
+
+    size_t tail = nl ? end - (nl + 1) : 0;
+    size_t out_len = (keep - data) + strlen(insert) + sizeof(redacted) - 1 + tail;
+    uint8_t out[out_len];
+    uint8_t *p = out;
+    memcpy(p, data, keep - data);
+    p += keep - data;
+    memcpy(p, insert, strlen(insert));
+    p += strlen(insert);
+    memcpy(p, redacted, sizeof(redacted) - 1);
+    p += sizeof(redacted) - 1;
+    if (tail) {
+        memcpy(p, nl + 1, tail);
+    }
+
+    s_redacting = !nl;
+    record_locked(CAPTURE_STRATUM_TX, out, out_len, now);
+}
+
+void CAPTURE_record(capture_type_t type, const void *data, size_t len)
+{
+    if (!(s_sources & (1 << type)) || s_paused) {
+        return;
+    }
+
+    pthread_mutex_lock(&capture_mutex);
+    if (!s_buf) {
+        pthread_mutex_unlock(&capture_mutex);
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (type == CAPTURE_STRATUM_TX) {
+        record_stratum_tx_locked((const uint8_t *) data, len, now);
+    } else {
+        record_locked(type, (const uint8_t *) data, len, now);
+    }
+    pthread_mutex_unlock(&capture_mutex);
+}
+
+void CAPTURE_get_info(capture_info_t *info)
+{
+    pthread_mutex_lock(&capture_mutex);
+    info->sources = s_sources;
+    info->size = s_size;
+    info->used = s_used;
+    info->frames = s_frames;
+    info->dropped = s_dropped;
+    info->base_time_us = s_base_time;
+    pthread_mutex_unlock(&capture_mutex);
+}
+
+size_t CAPTURE_read(size_t offset, uint8_t *out, size_t len)
+{
+    pthread_mutex_lock(&capture_mutex);
+    if (!s_buf || offset >= s_used) {
+        pthread_mutex_unlock(&capture_mutex);
+        return 0;
+    }
+
+    if (len > s_used - offset) {
+        len = s_used - offset;
+    }
+
+    size_t pos = (s_tail + offset) % s_size;
+    size_t first = (len < s_size - pos) ? len : s_size - pos;
+    memcpy(out, s_buf + pos, first);
+    memcpy(out + first, s_buf, len - first);
+    pthread_mutex_unlock(&capture_mutex);
+    return len;
+}
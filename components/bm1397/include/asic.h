@@ -84,9 +84,9 @@ protected:
     void send2(uint8_t header, uint8_t b0, uint8_t b1);
     void send6(uint8_t header, uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4, uint8_t b5);
     int count_asics();
-    bool sendHashFrequency(float target_freq);
+    bool sendHashFrequency(float target_freq, int chip = -1);
     void setVrFreqReg(uint32_t value);
-    bool doFrequencyTransition(float target_frequency);
+    bool doFrequencyTransition(float current, float target_frequency, int chip = -1);
     void setChipAddress(uint8_t chipAddr);
     void sendReadAddress(void);
     void sendChainInactive(void);
@@ -110,9 +110,13 @@ public:
     Asic();
     virtual const char* getName() = 0;
     uint8_t sendWork(uint32_t job_id, bm_job *next_bm_job);
+    uint8_t getAsicJobId(uint32_t job_id);
+    int getJobSlotCount();
     bool processWork(task_result *result);
     void setJobDifficultyMask(int difficulty);
     bool setAsicFrequency(float frequency);
+    bool setAsicFrequency(float frequency, const float *chipFrequencies, int numChips);
+    bool setChipFrequency(int chip, float current, float target);
     virtual void requestChipTemp();
     virtual void resetCounter(uint8_t reg);
     virtual void readCounter(uint8_t reg);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Traffic capture into a PSRAM ring buffer
+//
+// Record format (little endian varints):
+//   [delta_us][type][len][payload]
+// delta_us is relative to the previous record, the first record of the
+// ring is relative to capture_info_t::base_time_us. When the ring is full
+// the oldest records are dropped. The params of mining.authorize (pool
+// password) are not recorded.
+//
+// main/host/capture_replay.cpp replays a download on Linux.
+
+#define CAPTURE_MAGIC "NQCAP"
+#define CAPTURE_VERSION 1
+
+typedef enum
+{
+    CAPTURE_UART_TX = 0,
+    CAPTURE_UART_RX = 1,
+    CAPTURE_STRATUM_TX = 2,
+    CAPTURE_STRATUM_RX = 3,
+} capture_type_t;
+
+#define CAPTURE_SRC_UART ((1 << CAPTURE_UART_TX) | (1 << CAPTURE_UART_RX))
+#define CAPTURE_SRC_STRATUM ((1 << CAPTURE_STRATUM_TX) | (1 << CAPTURE_STRATUM_RX))
+
+typedef struct
+{
+    uint8_t sources;
+    size_t size;
+    size_t used;
+    uint32_t frames;
+    uint32_t dropped;
+    int64_t base_time_us;
+} capture_info_t;
+
+// file header of a download, the ring data from the oldest record follows
+typedef struct __attribute__((__packed__))
+{
+    char magic[5];
+    uint8_t version;
+    uint8_t sources;
+    uint8_t reserved;
+    int64_t base_time_us;
+    uint32_t frames;
+    uint32_t dropped;
+} capture_file_header_t;
+
+// allocates the ring and starts recording the given sources
+bool CAPTURE_start(size_t size, uint8_t sources);
+
+// stops recording and frees the ring
+void CAPTURE_stop(void);
+
+// pauses or resumes recording, the ring is kept
+void CAPTURE_pause(bool pause);
+
+void CAPTURE_record(capture_type_t type, const void *data, size_t len);
+
+void CAPTURE_get_info(capture_info_t *info);
+
+// copies ring data starting at the oldest record, returns the number of bytes copied
+size_t CAPTURE_read(size_t offset, uint8_t *out, size_t len);
@@ -37,6 +37,10 @@ void calculate_merkle_root_hash(const char *coinbase_tx, const uint8_t merkle_br
 
 void construct_bm_job(mining_notify *params, const char *merkle_root, const uint32_t version_mask, bm_job *new_job);
 
+// job of a notify with the extranonces as the ASICs get it, the job ID and
+// extranonce2 are copied. Pool fields are left to the caller
+bm_job *create_bm_job(mining_notify *notify, const char *extranonce, const char *extranonce_2, uint32_t version_mask);
+
 double test_nonce_value(const bm_job *job, const uint32_t nonce, const uint32_t rolled_version);
 
 char *extranonce_2_generate(uint32_t extranonce_2, uint32_t length);
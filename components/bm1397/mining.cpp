@@ -3,6 +3,7 @@
 #include "mining_utils.h"
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 void free_bm_job(bm_job *job)
@@ -57,6 +58,25 @@ void construct_bm_job(mining_notify *params, const char *merkle_root, const uint
 }
 
 ///////cgminer nonce testing
+bm_job *create_bm_job(mining_notify *notify, const char *extranonce, const char *extranonce_2, uint32_t version_mask)
+{
+    // generate coinbase tx
+    int coinbase_tx_len = strlen(notify->coinbase_1) + strlen(extranonce) + strlen(extranonce_2) + strlen(notify->coinbase_2);
+    char coinbase_tx[coinbase_tx_len + 1]; // +1 zero termination
+    snprintf(coinbase_tx, sizeof(coinbase_tx), "%s%s%s%s", notify->coinbase_1, extranonce, extranonce_2, notify->coinbase_2);
+
+    // calculate merkle root
+    char merkle_root[65];
+    calculate_merkle_root_hash(coinbase_tx, notify->_merkle_branches, notify->n_merkle_branches, merkle_root);
+
+    // we need malloc because it is saved in the job array
+    bm_job *job = (bm_job *) malloc(sizeof(bm_job));
+    construct_bm_job(notify, merkle_root, version_mask, job);
+    job->jobid = strdup(notify->job_id);
+    job->extranonce2 = strdup(extranonce_2);
+    return job;
+}
+
 /* truediffone == 0x00000000FFFF0000000000000000000000000000000000000000000000000000
  */
 static const double truediffone = 26959535291011309493156476344723991336010898738574164086137773096960.0;
@@ -1,6 +1,7 @@
 #include "mining_utils.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "mbedtls/sha256.h"
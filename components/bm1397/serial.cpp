@@ -11,6 +11,7 @@
 #include "soc/uart_struct.h"
 
 #include "asic.h"
+#include "capture.h"
 #include "serial.h"
 #include "mining_utils.h"
 
@@ -64,6 +65,9 @@ int SERIAL_send(uint8_t *data, int len)
 #endif
 
     int written = uart_write_bytes(UART_NUM_1, (const char *) data, len);
+    if (written > 0) {
+        CAPTURE_record(CAPTURE_UART_TX, data, written);
+    }
     pthread_mutex_unlock(&tx_mute);
 
     return written;
@@ -76,6 +80,9 @@ int SERIAL_send(uint8_t *data, int len)
 int16_t SERIAL_rx(uint8_t *buf, uint16_t size, uint16_t timeout_ms)
 {
     int16_t bytes_read = uart_read_bytes(UART_NUM_1, buf, size, pdMS_TO_TICKS(timeout_ms));
+    if (bytes_read > 0) {
+        CAPTURE_record(CAPTURE_UART_RX, buf, bytes_read);
+    }
 
 #ifdef ASIC_SERIALRX_DEBUG
     size_t buff_len = 0;
@@ -0,0 +1,262 @@
+/*
+ * DNS query parsing and reply generation of the captive portal DNS server.
+ */
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#include "dns_packet.h"
+
+#define DNS_HEADER_LEN (12)
+#define DNS_ANSWER_LEN (16) // name pointer, type, class, ttl, length, IPv4
+#define DNS_NAME_MAX (256)
+
+#define DNS_FLAG_QR (0x8000)
+#define DNS_FLAG_AA (0x0400)
+#define DNS_FLAG_RD (0x0100)
+#define DNS_OPCODE_MASK (0x7800)
+
+#define DNS_CLASS_IN (1)
+#define ANS_TTL_SEC (300)
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t) (v >> 8);
+    p[1] = (uint8_t) v;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, (uint16_t) (v >> 16));
+    put16(p + 2, (uint16_t) v);
+}
+
+/*
+    Parses a name of the question section into a lower case .-separated string,
+    returns the length of the name in the packet, 0 if it is invalid
+*/
+static size_t parse_name(const uint8_t *p, size_t len, char *out, size_t out_max)
+{
+    size_t pos = 0;
+    size_t o = 0;
+
+    while (pos < len) {
+        uint8_t label_len = p[pos++];
+        if (label_len == 0) {
+            // replace the last '.', the root name is empty
+            out[o ? o - 1 : 0] = '\0';
+            return pos;
+        }
+        // compression isn't used in questions
+        if (label_len & 0xC0) {
+            return 0;
+        }
+        if (pos + label_len > len || o + label_len + 1 >= out_max) {
+            return 0;
+        }
+        for (int i = 0; i < label_len; i++) {
+            out[o++] = (char) tolower(p[pos + i]);
+        }
+        out[o++] = '.';
+        pos += label_len;
+    }
+    return 0;
+}
+
+bool dns_name_matches(const char *name, const char *pattern)
+{
+    if (pattern[0] == '*' && pattern[1] == '.') {
+        // "*.example.com" matches example.com and all subdomains
+        const char *suffix = pattern + 1;
+        size_t name_len = strlen(name);
+        size_t suffix_len = strlen(suffix);
+        if (!strcasecmp(name, suffix + 1)) {
+            return true;
+        }
+        return name_len > suffix_len && !strcasecmp(name + name_len - suffix_len, suffix);
+    }
+    return !strcasecmp(name, pattern);
+}
+
+static bool is_exception(dns_responder_t *r, const char *name)
+{
+    for (int i = 0; i < r->num_of_exceptions; i++) {
+        if (r->exceptions[i] && dns_name_matches(name, r->exceptions[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int header_only_reply(const uint8_t *req, uint8_t *reply, size_t reply_max_len, uint16_t flags, int rcode)
+{
+    if (reply_max_len < DNS_HEADER_LEN) {
+        return 0;
+    }
+    memset(reply, 0, DNS_HEADER_LEN);
+    memcpy(reply, req, 2); // id
+    put16(reply + 2, DNS_FLAG_QR | (flags & (DNS_OPCODE_MASK | DNS_FLAG_RD)) | rcode);
+    return DNS_HEADER_LEN;
+}
+
+static dns_cache_entry_t *cache_lookup(dns_cache_t *cache, const uint8_t *req, uint16_t flags, size_t question_len,
+                                       uint32_t now_ms)
+{
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        dns_cache_entry_t *e = &cache->entry[i];
+        if (!e->reply_len || e->flags != flags || e->question_len != question_len) {
+            continue;
+        }
+        if ((uint32_t) (now_ms - e->time_ms) >= DNS_CACHE_TTL_MS) {
+            e->reply_len = 0;
+            continue;
+        }
+        // the name is compared case insensitive (0x20 encoding), type and class exactly
+        const uint8_t *a = e->reply + DNS_HEADER_LEN;
+        const uint8_t *b = req + DNS_HEADER_LEN;
+        size_t name_len = question_len - 4;
+        size_t j = 0;
+        while (j < name_len && tolower(a[j]) == tolower(b[j])) {
+            j++;
+        }
+        if (j == name_len && !memcmp(a + name_len, b + name_len, 4)) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void cache_store(dns_cache_t *cache, const uint8_t *reply, size_t reply_len, uint16_t flags, size_t question_len,
+                        uint32_t now_ms)
+{
+    if (reply_len > DNS_CACHE_REPLY_MAX) {
+        return;
+    }
+    dns_cache_entry_t *e = &cache->entry[cache->next];
+    cache->next = (cache->next + 1) % DNS_CACHE_SIZE;
+
+    memcpy(e->reply, reply, reply_len);
+    e->reply_len = (uint16_t) reply_len;
+    e->question_len = (uint16_t) question_len;
+    e->flags = flags;
+    e->time_ms = now_ms;
+}
+
+int dns_build_reply(dns_responder_t *r, const uint8_t *req, size_t req_len, uint8_t *reply, size_t reply_max_len,
+                    uint32_t now_ms)
+{
+    if (req_len < DNS_HEADER_LEN) {
+        return 0;
+    }
+
+    uint16_t flags = get16(req + 2);
+    uint16_t qd_count = get16(req + 4);
+
+    // ignore responses
+    if (flags & DNS_FLAG_QR) {
+        return 0;
+    }
+
+    // Not a standard query
+    if ((flags & DNS_OPCODE_MASK) != 0) {
+        return header_only_reply(req, reply, reply_max_len, flags, DNS_RCODE_NOTIMP);
+    }
+
+    if (qd_count == 0) {
+        return header_only_reply(req, reply, reply_max_len, flags, DNS_RCODE_FORMERR);
+    }
+
+    // length of the question section, additional records (EDNS) are not copied
+    char name[DNS_NAME_MAX];
+    size_t pos = DNS_HEADER_LEN;
+    for (int i = 0; i < qd_count; i++) {
+        size_t name_len = parse_name(req + pos, req_len - pos, name, sizeof(name));
+        if (!name_len || pos + name_len + 4 > req_len) {
+            return header_only_reply(req, reply, reply_max_len, flags, DNS_RCODE_FORMERR);
+        }
+        pos += name_len + 4;
+    }
+    size_t question_len = pos - DNS_HEADER_LEN;
+    uint16_t key_flags = flags & (DNS_OPCODE_MASK | DNS_FLAG_RD);
+
+    if (pos > reply_max_len) {
+        return 0;
+    }
+
+    // connectivity checks repeat the same few questions
+    bool cacheable = r->cache && qd_count == 1;
+    if (cacheable) {
+        dns_cache_entry_t *e = cache_lookup(r->cache, req, key_flags, question_len, now_ms);
+        if (e && e->reply_len <= reply_max_len) {
+            r->cache->hits++;
+            memcpy(reply, e->reply, e->reply_len);
+            memcpy(reply, req, 2); // id
+            // echo the question exactly like it was asked
+            memcpy(reply + DNS_HEADER_LEN, req + DNS_HEADER_LEN, question_len);
+            return e->reply_len;
+        }
+        r->cache->misses++;
+    }
+
+    memcpy(reply, req, DNS_HEADER_LEN);
+    memcpy(reply + DNS_HEADER_LEN, req + DNS_HEADER_LEN, question_len);
+
+    uint8_t *ans = reply + pos;
+    uint16_t an_count = 0;
+    int rcode = DNS_RCODE_NOERROR;
+
+    // Respond to all questions based on configured rules
+    pos = DNS_HEADER_LEN;
+    for (int i = 0; i < qd_count; i++) {
+        size_t q_offset = pos;
+        pos += parse_name(req + pos, req_len - pos, name, sizeof(name));
+        uint16_t qd_type = get16(req + pos);
+        uint16_t qd_class = get16(req + pos + 2);
+        pos += 4;
+
+        if (is_exception(r, name)) {
+            rcode = DNS_RCODE_NXDOMAIN;
+            continue;
+        }
+
+        // everything else than A gets an empty answer
+        if (qd_type != DNS_TYPE_A || qd_class != DNS_CLASS_IN) {
+            continue;
+        }
+
+        uint32_t ip = r->resolve ? r->resolve(name, r->ctx) : 0;
+        if (!ip) { // no rule applies, continue with another question
+            continue;
+        }
+
+        if ((size_t) (ans - reply) + DNS_ANSWER_LEN > reply_max_len) {
+            return 0;
+        }
+        put16(ans, (uint16_t) (0xC000 | q_offset));
+        put16(ans + 2, qd_type);
+        put16(ans + 4, qd_class);
+        put32(ans + 6, ANS_TTL_SEC);
+        put16(ans + 10, 4);
+        memcpy(ans + 12, &ip, 4); // already network byte order
+        ans += DNS_ANSWER_LEN;
+        an_count++;
+    }
+
+    put16(reply + 2, DNS_FLAG_QR | DNS_FLAG_AA | key_flags | rcode);
+    put16(reply + 4, qd_count);
+    put16(reply + 6, an_count);
+    put16(reply + 8, 0);
+    put16(reply + 10, 0);
+
+    int reply_len = (int) (ans - reply);
+    if (cacheable) {
+        cache_store(r->cache, reply, reply_len, key_flags, question_len, now_ms);
+    }
+    return reply_len;
+}
@@ -0,0 +1,88 @@
+/*
+ * DNS query parsing and reply generation of the captive portal DNS server.
+ *
+ * No ESP-IDF dependencies so it can be built on the host (see host/).
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define DNS_MAX_LEN (512) // max UDP DNS message without EDNS
+
+#define DNS_TYPE_A (1)
+#define DNS_TYPE_AAAA (28)
+#define DNS_TYPE_SVCB (64)
+#define DNS_TYPE_HTTPS (65)
+
+#define DNS_RCODE_NOERROR (0)
+#define DNS_RCODE_FORMERR (1)
+#define DNS_RCODE_NXDOMAIN (3)
+#define DNS_RCODE_NOTIMP (4)
+
+// replies of single question queries are cached
+#define DNS_CACHE_SIZE (32)
+#define DNS_CACHE_REPLY_MAX (128)
+#define DNS_CACHE_TTL_MS (5000) // the answers depend on the netif IP that can change
+
+    /**
+     * @brief Returns the IPv4 address (network byte order) to answer an A query for name with,
+     * 0 if the name shouldn't be answered
+     */
+    typedef uint32_t (*dns_resolve_fn)(const char *name, void *ctx);
+
+    typedef struct
+    {
+        uint8_t reply[DNS_CACHE_REPLY_MAX]; // reply with the question section as key
+        uint16_t reply_len;
+        uint16_t question_len;
+        uint16_t flags; // opcode and RD bit of the query
+        uint32_t time_ms;
+    } dns_cache_entry_t;
+
+    typedef struct
+    {
+        dns_cache_entry_t entry[DNS_CACHE_SIZE];
+        int next;
+        uint32_t hits;
+        uint32_t misses;
+    } dns_cache_t;
+
+    typedef struct
+    {
+        dns_resolve_fn resolve;
+        void *ctx;
+        const char *const *exceptions; // names answered with NXDOMAIN, "*.example.com" matches subdomains
+        int num_of_exceptions;
+        dns_cache_t *cache; // optional
+    } dns_responder_t;
+
+    /**
+     * @brief Builds the reply of a query
+     *
+     * - A queries are answered by the resolver
+     * - AAAA, HTTPS, SVCB and all other types get an empty answer (NODATA), so clients
+     *   don't wait for a timeout before they fall back to the A record
+     * - names on the exception list get NXDOMAIN
+     * - other opcodes get NOTIMP, malformed queries FORMERR
+     *
+     * @return length of the reply, 0 if the packet should be dropped
+     */
+    int dns_build_reply(dns_responder_t *r, const uint8_t *req, size_t req_len, uint8_t *reply, size_t reply_max_len,
+                        uint32_t now_ms);
+
+    /**
+     * @brief Checks a name against a list of exceptions (case insensitive)
+     */
+    bool dns_name_matches(const char *name, const char *pattern);
+
+#ifdef __cplusplus
+}
+#endif
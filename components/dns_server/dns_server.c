@@ -5,13 +5,16 @@
  */
 
 #include <inttypes.h>
+#include <strings.h>
 #include <sys/param.h>
 
 #include "esp_check.h"
 #include "esp_log.h"
 #include "esp_netif.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 
+#include "dns_packet.h"
 #include "dns_server.h"
 #include "lwip/err.h"
 #include "lwip/netdb.h"
@@ -19,180 +22,109 @@
 #include "lwip/sys.h"
 
 #define DNS_PORT (53)
-#define DNS_MAX_LEN (256)
 
-#define OPCODE_MASK (0x7800)
-#define QR_FLAG (1 << 7)
-#define QD_TYPE_A (0x0001)
-#define ANS_TTL_SEC (300)
+// queries handled per wakeup, phones send bursts of them
+#define DNS_BATCH_MAX (16)
+// how often the task checks if it should stop
+#define DNS_SELECT_TIMEOUT_MS (500)
 
 static const char *TAG = "example_dns_redirect_server";
 
-// DNS Header Packet
-typedef struct __attribute__((__packed__))
-{
-    uint16_t id;
-    uint16_t flags;
-    uint16_t qd_count;
-    uint16_t an_count;
-    uint16_t ns_count;
-    uint16_t ar_count;
-} dns_header_t;
-
-// DNS Question Packet
-typedef struct
-{
-    uint16_t type;
-    uint16_t class;
-} dns_question_t;
-
-// DNS Answer Packet
-typedef struct __attribute__((__packed__))
-{
-    uint16_t ptr_offset;
-    uint16_t type;
-    uint16_t class;
-    uint32_t ttl;
-    uint16_t addr_len;
-    uint32_t ip_addr;
-} dns_answer_t;
-
 // DNS server handle
 struct dns_server_handle
 {
-    bool started;
+    volatile bool started;
+    volatile bool running;
     TaskHandle_t task;
+    dns_cache_t cache;
+    uint32_t queries;
+    uint32_t dropped;
+    int num_of_exceptions;
+    const char *exception[DNS_SERVER_MAX_EXCEPTIONS];
     int num_of_entries;
     dns_entry_pair_t entry[];
 };
 
-/*
-    Parse the name from the packet from the DNS name format to a regular .-seperated name
-    returns the pointer to the next part of the packet
-*/
-static char *parse_dns_name(char *raw_name, char *parsed_name, size_t parsed_name_max_len)
+// Answers A queries based on the configured rules
+static uint32_t resolve_name(const char *name, void *ctx)
 {
+    dns_server_handle_t h = ctx;
 
-    char *label = raw_name;
-    char *name_itr = parsed_name;
-    int name_len = 0;
-
-    do {
-        int sub_name_len = *label;
-        // (len + 1) since we are adding  a '.'
-        name_len += (sub_name_len + 1);
-        if (name_len > parsed_name_max_len) {
-            return NULL;
+    // Check the configured rules to decide whether to answer this question or not
+    for (int i = 0; i < h->num_of_entries; ++i) {
+        // check if the name either corresponds to the entry, or if we should answer to all queries ("*")
+        if (strcmp(h->entry[i].name, "*") != 0 && strcasecmp(h->entry[i].name, name) != 0) {
+            continue;
         }
-
-        // Copy the sub name that follows the the label
-        memcpy(name_itr, label + 1, sub_name_len);
-        name_itr[sub_name_len] = '.';
-        name_itr += (sub_name_len + 1);
-        label += sub_name_len + 1;
-    } while (*label != 0);
-
-    // Terminate the final string, replacing the last '.'
-    parsed_name[name_len - 1] = '\0';
-    // Return pointer to first char after the name
-    return label + 1;
+        if (h->entry[i].if_key) {
+            esp_netif_ip_info_t ip_info;
+            if (esp_netif_get_ip_info(esp_netif_get_handle_from_ifkey(h->entry[i].if_key), &ip_info) != ESP_OK) {
+                return IPADDR_ANY;
+            }
+            return ip_info.ip.addr;
+        } else if (h->entry[i].ip.addr != IPADDR_ANY) {
+            return h->entry[i].ip.addr;
+        }
+    }
+    return IPADDR_ANY;
 }
 
-// Parses the DNS request and prepares a DNS response with the IP of the softAP
-static int parse_dns_request(char *req, size_t req_len, char *dns_reply, size_t dns_reply_max_len, dns_server_handle_t h)
+static int create_socket(void)
 {
-    ESP_LOGD(TAG, "TEST");
-    if (req_len > dns_reply_max_len) {
+    struct sockaddr_in dest_addr;
+    dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_port = htons(DNS_PORT);
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
         return -1;
     }
 
-    // Prepare the reply
-    memset(dns_reply, 0, dns_reply_max_len);
-    memcpy(dns_reply, req, req_len);
-
-    // Endianess of NW packet different from chip
-    dns_header_t *header = (dns_header_t *) dns_reply;
-    ESP_LOGD(TAG, "DNS query with header id: 0x%X, flags: 0x%X, qd_count: %d", ntohs(header->id), ntohs(header->flags),
-             ntohs(header->qd_count));
-
-    // Not a standard query
-    if ((header->flags & OPCODE_MASK) != 0) {
-        return 0;
-    }
-
-    // Set question response flag
-    header->flags |= QR_FLAG;
-
-    uint16_t qd_count = ntohs(header->qd_count);
-    header->an_count = htons(qd_count);
-
-    int reply_len = qd_count * sizeof(dns_answer_t) + req_len;
-    if (reply_len > dns_reply_max_len) {
+    if (bind(sock, (struct sockaddr *) &dest_addr, sizeof(dest_addr)) < 0) {
+        ESP_LOGE(TAG, "Socket unable to bind: errno %d", errno);
+        close(sock);
         return -1;
     }
+    ESP_LOGI(TAG, "Socket bound, port %d", DNS_PORT);
+    return sock;
+}
 
-    // Pointer to current answer and question
-    char *cur_ans_ptr = dns_reply + req_len;
-    char *cur_qd_ptr = dns_reply + sizeof(dns_header_t);
-    char name[128];
-
-    // Respond to all questions based on configured rules
-    for (int qd_i = 0; qd_i < qd_count; qd_i++) {
-        char *name_end_ptr = parse_dns_name(cur_qd_ptr, name, sizeof(name));
-        if (name_end_ptr == NULL) {
-            ESP_LOGE(TAG, "Failed to parse DNS question: %s", cur_qd_ptr);
-            return -1;
-        }
-
-        dns_question_t *question = (dns_question_t *) (name_end_ptr);
-        uint16_t qd_type = ntohs(question->type);
-        uint16_t qd_class = ntohs(question->class);
-
-        ESP_LOGD(TAG, "Received type: %d | Class: %d | Question for: %s", qd_type, qd_class, name);
-
-        if (qd_type == QD_TYPE_A) {
-            esp_ip4_addr_t ip = {.addr = IPADDR_ANY};
-            // Check the configured rules to decide whether to answer this question or not
-            for (int i = 0; i < h->num_of_entries; ++i) {
-                // check if the name either corresponds to the entry, or if we should answer to all queries ("*")
-                if (strcmp(h->entry[i].name, "*") == 0 || strcmp(h->entry[i].name, name) == 0) {
-                    if (h->entry[i].if_key) {
-
-                        esp_netif_ip_info_t ip_info;
-                        esp_netif_get_ip_info(esp_netif_get_handle_from_ifkey(h->entry[i].if_key), &ip_info);
-                        ip.addr = ip_info.ip.addr;
-                        ESP_LOGD(TAG, "TEST %s", h->entry[i].if_key);
-                        break;
-                    } else if (h->entry->ip.addr != IPADDR_ANY) {
-                        ip.addr = h->entry[i].ip.addr;
-                        break;
-                    }
-                }
-            }
-            uint8_t octet1 = (ip.addr >> 24) & 0xFF;
-            uint8_t octet2 = (ip.addr >> 16) & 0xFF;
-            uint8_t octet3 = (ip.addr >> 8) & 0xFF;
-            uint8_t octet4 = ip.addr & 0xFF;
+// answers all queued queries, returns false on socket errors
+static bool process_batch(dns_server_handle_t handle, dns_responder_t *responder, int sock)
+{
+    uint8_t rx_buffer[DNS_MAX_LEN];
+    uint8_t reply[DNS_MAX_LEN];
 
-            printf("IP address: %u.%u.%u.%u\n", octet1, octet2, octet3, octet4);
+    for (int n = 0; n < DNS_BATCH_MAX; n++) {
+        struct sockaddr_in6 source_addr; // Large enough for both IPv4 or IPv6
+        socklen_t socklen = sizeof(source_addr);
+        int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer), MSG_DONTWAIT, (struct sockaddr *) &source_addr, &socklen);
 
-            if (ip.addr == IPADDR_ANY) { // no rule applies, continue with another question
-                continue;
+        if (len < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true; // drained
             }
-            dns_answer_t *answer = (dns_answer_t *) cur_ans_ptr;
-
-            answer->ptr_offset = htons(0xC000 | (cur_qd_ptr - dns_reply));
-            answer->type = htons(qd_type);
-            answer->class = htons(qd_class);
-            answer->ttl = htonl(ANS_TTL_SEC);
+            ESP_LOGE(TAG, "recvfrom failed: errno %d", errno);
+            return false;
+        }
 
-            ESP_LOGD(TAG, "Answer with PTR offset: 0x%" PRIX16 " and IP 0x%" PRIX32, ntohs(answer->ptr_offset), ip.addr);
+        handle->queries++;
+        uint32_t now_ms = (uint32_t) (esp_timer_get_time() / 1000);
+        int reply_len = dns_build_reply(responder, rx_buffer, len, reply, sizeof(reply), now_ms);
+        if (reply_len <= 0) {
+            handle->dropped++;
+            ESP_LOGD(TAG, "Dropped DNS packet with len: %d", len);
+            continue;
+        }
 
-            answer->addr_len = htons(sizeof(ip.addr));
-            answer->ip_addr = ip.addr;
+        if (sendto(sock, reply, reply_len, 0, (struct sockaddr *) &source_addr, socklen) < 0) {
+            // a full send buffer only loses this reply
+            ESP_LOGW(TAG, "Error occurred during sending: errno %d", errno);
         }
     }
-    return reply_len;
+    return true;
 }
 
 /*
@@ -201,81 +133,49 @@ static int parse_dns_request(char *req, size_t req_len, char *dns_reply, size_t
 */
 void dns_server_task(void *pvParameters)
 {
-    char rx_buffer[128];
-    char addr_str[128];
-    int addr_family;
-    int ip_protocol;
     dns_server_handle_t handle = pvParameters;
 
-    while (handle->started) {
-
-        struct sockaddr_in dest_addr;
-        dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-        dest_addr.sin_family = AF_INET;
-        dest_addr.sin_port = htons(DNS_PORT);
-        addr_family = AF_INET;
-        ip_protocol = IPPROTO_IP;
-        inet_ntoa_r(dest_addr.sin_addr, addr_str, sizeof(addr_str) - 1);
+    dns_responder_t responder = {
+        .resolve = resolve_name,
+        .ctx = handle,
+        .exceptions = handle->exception,
+        .num_of_exceptions = handle->num_of_exceptions,
+        .cache = &handle->cache,
+    };
 
-        int sock = socket(addr_family, SOCK_DGRAM, ip_protocol);
+    while (handle->started) {
+        int sock = create_socket();
         if (sock < 0) {
-            ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
-            break;
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
         }
-        ESP_LOGI(TAG, "Socket created");
-
-        int err = bind(sock, (struct sockaddr *) &dest_addr, sizeof(dest_addr));
-        if (err < 0) {
-            ESP_LOGE(TAG, "Socket unable to bind: errno %d", errno);
-        }
-        ESP_LOGI(TAG, "Socket bound, port %d", DNS_PORT);
 
         while (handle->started) {
-            ESP_LOGI(TAG, "Waiting for data");
-            struct sockaddr_in6 source_addr; // Large enough for both IPv4 or IPv6
-            socklen_t socklen = sizeof(source_addr);
-            int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer) - 1, 0, (struct sockaddr *) &source_addr, &socklen);
-
-            // Error occurred during receiving
-            if (len < 0) {
-                ESP_LOGE(TAG, "recvfrom failed: errno %d", errno);
-                close(sock);
+            fd_set rfds;
+            FD_ZERO(&rfds);
+            FD_SET(sock, &rfds);
+            struct timeval tv = {.tv_sec = 0, .tv_usec = DNS_SELECT_TIMEOUT_MS * 1000};
+
+            int ret = select(sock + 1, &rfds, NULL, NULL, &tv);
+            if (ret < 0) {
+                ESP_LOGE(TAG, "select failed: errno %d", errno);
                 break;
             }
-            // Data received
-            else {
-                // Get the sender's ip address as string
-                if (source_addr.sin6_family == PF_INET) {
-                    inet_ntoa_r(((struct sockaddr_in *) &source_addr)->sin_addr.s_addr, addr_str, sizeof(addr_str) - 1);
-                } else if (source_addr.sin6_family == PF_INET6) {
-                    inet6_ntoa_r(source_addr.sin6_addr, addr_str, sizeof(addr_str) - 1);
-                }
-
-                // Null-terminate whatever we received and treat like a string...
-                rx_buffer[len] = 0;
-
-                char reply[DNS_MAX_LEN];
-                int reply_len = parse_dns_request(rx_buffer, len, reply, DNS_MAX_LEN, handle);
-
-                ESP_LOGI(TAG, "Received %d bytes from %s | DNS reply with len: %d", len, addr_str, reply_len);
-                if (reply_len <= 0) {
-                    ESP_LOGE(TAG, "Failed to prepare a DNS reply");
-                } else {
-                    int err = sendto(sock, reply, reply_len, 0, (struct sockaddr *) &source_addr, sizeof(source_addr));
-                    if (err < 0) {
-                        ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
-                        break;
-                    }
-                }
+            if (ret == 0) {
+                continue;
+            }
+            if (!process_batch(handle, &responder, sock)) {
+                break;
             }
         }
 
-        if (sock != -1) {
-            ESP_LOGE(TAG, "Shutting down socket");
-            shutdown(sock, 0);
-            close(sock);
-        }
+        ESP_LOGI(TAG, "Shutting down socket (queries: %" PRIu32 ", cache hits: %" PRIu32 ", dropped: %" PRIu32 ")",
+                 handle->queries, handle->cache.hits, handle->dropped);
+        shutdown(sock, 0);
+        close(sock);
     }
+
+    handle->running = false;
     vTaskDelete(NULL);
 }
 
@@ -285,18 +185,29 @@ dns_server_handle_t start_dns_server(dns_server_config_t *config)
     ESP_RETURN_ON_FALSE(handle, NULL, TAG, "Failed to allocate dns server handle");
 
     handle->started = true;
+    handle->running = true;
     handle->num_of_entries = config->num_of_entries;
     memcpy(handle->entry, config->item, config->num_of_entries * sizeof(dns_entry_pair_t));
 
-    xTaskCreate(dns_server_task, "dns_server", 4096, handle, 5, &handle->task);
+    handle->num_of_exceptions = MIN(config->num_of_exceptions, DNS_SERVER_MAX_EXCEPTIONS);
+    memcpy(handle->exception, config->exception, handle->num_of_exceptions * sizeof(const char *));
+
+    if (xTaskCreate(dns_server_task, "dns_server", 4096, handle, 5, &handle->task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create dns server task");
+        free(handle);
+        return NULL;
+    }
     return handle;
 }
 
 void stop_dns_server(dns_server_handle_t handle)
 {
     if (handle) {
+        // let the task close its socket, it checks the flag after each select timeout
         handle->started = false;
-        vTaskDelete(handle->task);
+        while (handle->running) {
+            vTaskDelay(pdMS_TO_TICKS(50));
+        }
         free(handle);
     }
 }
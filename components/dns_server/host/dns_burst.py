@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+"""
+Replays the DNS query bursts phones and PCs send when they join a network
+(captive portal detection) and measures the response latency.
+
+  python3 dns_burst.py 192.168.4.1                    # miner in AP mode
+  python3 dns_burst.py 127.0.0.1 --port 5353          # host build
+  python3 dns_burst.py 127.0.0.1 --port 5353 --exception example.com
+
+Every reply is checked: matching id and question, A queries answered with
+the expected IP, AAAA/HTTPS and other types with an empty answer and
+exceptions with NXDOMAIN. Only the Python 3 standard library is needed.
+"""
+
+import argparse
+import random
+import select
+import socket
+import statistics
+import struct
+import sys
+import time
+
+TYPE_A = 1
+TYPE_AAAA = 28
+TYPE_HTTPS = 65
+TYPE_NAMES = {TYPE_A: "A", TYPE_AAAA: "AAAA", TYPE_HTTPS: "HTTPS"}
+
+# queries seen right after connecting to a network
+PROFILES = {
+    "ios": [
+        ("captive.apple.com", (TYPE_A, TYPE_AAAA, TYPE_HTTPS)),
+        ("www.apple.com", (TYPE_A, TYPE_AAAA, TYPE_HTTPS)),
+        ("gateway.icloud.com", (TYPE_A, TYPE_AAAA, TYPE_HTTPS)),
+        ("mask.icloud.com", (TYPE_A, TYPE_AAAA, TYPE_HTTPS)),
+        ("time.apple.com", (TYPE_A, TYPE_AAAA)),
+    ],
+    "android": [
+        ("connectivitycheck.gstatic.com", (TYPE_A, TYPE_AAAA)),
+        ("www.google.com", (TYPE_A, TYPE_AAAA)),
+        ("clients3.google.com", (TYPE_A, TYPE_AAAA)),
+        ("mtalk.google.com", (TYPE_A, TYPE_AAAA)),
+        ("play.googleapis.com", (TYPE_A, TYPE_AAAA)),
+        ("dns.google", (TYPE_A, TYPE_AAAA)),
+    ],
+    "windows": [
+        ("www.msftconnecttest.com", (TYPE_A, TYPE_AAAA)),
+        ("dns.msftncsi.com", (TYPE_A, TYPE_AAAA)),
+        ("ipv6.msftconnecttest.com", (TYPE_AAAA,)),
+    ],
+    "firefox": [
+        ("detectportal.firefox.com", (TYPE_A, TYPE_AAAA, TYPE_HTTPS)),
+    ],
+}
+
+
+def encode_name(name):
+    out = b""
+    for label in name.split("."):
+        out += bytes([len(label)]) + label.encode()
+    return out + b"\0"
+
+
+def build_query(qid, name, qtype, edns, randomize_case):
+    if randomize_case:
+        # like resolvers with 0x20 encoding
+        name = "".join(c.upper() if random.random() < 0.5 else c for c in name)
+    header = struct.pack(">HHHHHH", qid, 0x0100, 1, 0, 0, 1 if edns else 0)
+    question = encode_name(name) + struct.pack(">HH", qtype, 1)
+    opt = b"\0" + struct.pack(">HHIH", 41, 1232, 0, 0) if edns else b""
+    return header + question + opt, question
+
+
+def check_reply(data, qid, question, qtype, expect_ip, nxdomain):
+    if len(data) < 12:
+        return "short reply"
+    rid, flags, qd, an, _ns, _ar = struct.unpack(">HHHHHH", data[:12])
+    rcode = flags & 0x0F
+    if rid != qid or not flags & 0x8000:
+        return "bad header"
+    if qd != 1 or data[12:12 + len(question)] != question:
+        return "question not echoed"
+    if nxdomain:
+        return None if rcode == 3 else "expected NXDOMAIN, got rcode %d" % rcode
+    if rcode != 0:
+        return "rcode %d" % rcode
+    if qtype != TYPE_A:
+        return None if an == 0 else "expected empty answer, got %d" % an
+    if an != 1:
+        return "expected 1 answer, got %d" % an
+    pos = 12 + len(question)
+    if len(data) < pos + 16:
+        return "answer truncated"
+    ptr, atype, _aclass, _ttl, alen = struct.unpack(">HHHIH", data[pos:pos + 12])
+    if ptr != 0xC00C or atype != TYPE_A or alen != 4:
+        return "bad answer record"
+    ip = socket.inet_ntoa(data[pos + 12:pos + 16])
+    if expect_ip and ip != expect_ip:
+        return "answered %s" % ip
+    return None
+
+
+def run_burst(socks, addr, queries, args, stats):
+    # all clients send their burst back to back, then the replies are collected
+    pending = {}
+    for sock in socks:
+        burst = queries[:]
+        random.shuffle(burst)
+        for name, qtype in burst:
+            qid = random.randrange(0x10000)
+            while (sock, qid) in pending:
+                qid = random.randrange(0x10000)
+            packet, question = build_query(qid, name, qtype, args.edns, args.randomize_case)
+            nxdomain = any(name == x or name.endswith("." + x) for x in args.exception)
+            pending[(sock, qid)] = (time.perf_counter(), question, qtype, nxdomain)
+            sock.sendto(packet, addr)
+        stats["sent"] += len(burst)
+
+    deadline = time.perf_counter() + args.timeout
+    while pending and time.perf_counter() < deadline:
+        readable, _, _ = select.select(socks, [], [], max(0.0, deadline - time.perf_counter()))
+        if not readable:
+            break
+        now = time.perf_counter()
+        for sock in readable:
+            data, _ = sock.recvfrom(2048)
+            if len(data) < 2:
+                continue
+            key = (sock, struct.unpack(">H", data[:2])[0])
+            if key not in pending:
+                continue
+            sent, question, qtype, nxdomain = pending.pop(key)
+            stats["latency"].setdefault(TYPE_NAMES.get(qtype, str(qtype)), []).append((now - sent) * 1000)
+            error = check_reply(data, key[1], question, qtype, args.expect_ip, nxdomain)
+            if error:
+                stats["invalid"] += 1
+                if stats["invalid"] <= 5:
+                    print("invalid reply for %s: %s" % (question, error))
+    stats["lost"] += len(pending)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host", help="DNS server address")
+    parser.add_argument("--port", type=int, default=53)
+    parser.add_argument("--profile", default="all", choices=["all"] + sorted(PROFILES))
+    parser.add_argument("--bursts", type=int, default=20, help="number of bursts")
+    parser.add_argument("--interval", type=float, default=0.2, help="seconds between bursts")
+    parser.add_argument("--clients", type=int, default=3, help="clients sending at the same time")
+    parser.add_argument("--timeout", type=float, default=2.0, help="seconds to wait for the replies of a burst")
+    parser.add_argument("--expect-ip", default=None, help="IP the A queries must be answered with")
+    parser.add_argument("--exception", action="append", default=[], help="name expected to get NXDOMAIN")
+    parser.add_argument("--randomize-case", action="store_true", help="0x20 encoding of the names")
+    parser.add_argument("--no-edns", dest="edns", action="store_false", help="don't add an EDNS OPT record")
+    args = parser.parse_args()
+
+    profiles = sorted(PROFILES) if args.profile == "all" else [args.profile]
+    queries = [(name, qtype) for p in profiles for name, types in PROFILES[p] for qtype in types]
+    queries += [(x, TYPE_A) for x in args.exception]
+
+    addr = (args.host, args.port)
+    socks = [socket.socket(socket.AF_INET, socket.SOCK_DGRAM) for _ in range(args.clients)]
+    stats = {"latency": {}, "lost": 0, "invalid": 0, "sent": 0}
+
+    start = time.perf_counter()
+    for _ in range(args.bursts):
+        run_burst(socks, addr, queries, args, stats)
+        time.sleep(args.interval)
+    elapsed = time.perf_counter() - start
+
+    print("%d queries in %d bursts of %d (%d clients), %.1f s" % (
+        stats["sent"], args.bursts, len(queries), args.clients, elapsed))
+    all_latency = []
+    for qtype, values in sorted(stats["latency"].items()):
+        values.sort()
+        all_latency += values
+        print("  %-5s n=%-5d median %6.2f ms  p95 %6.2f ms  max %6.2f ms" % (
+            qtype, len(values), statistics.median(values), values[int(len(values) * 0.95) - 1], values[-1]))
+    if all_latency:
+        all_latency.sort()
+        print("  all   n=%-5d median %6.2f ms  p95 %6.2f ms" % (
+            len(all_latency), statistics.median(all_latency), all_latency[int(len(all_latency) * 0.95) - 1]))
+    print("lost: %d  invalid: %d" % (stats["lost"], stats["invalid"]))
+    return 1 if stats["lost"] or stats["invalid"] else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,144 @@
+/*
+ * Host build of the captive portal DNS server for testing on a PC.
+ *
+ * Uses the same query handling (dns_packet.c) and socket loop as the
+ * firmware: wait with select, then answer all queued queries.
+ *
+ *   cc -O2 -I.. -o dns_server_host dns_server_host.c ../dns_packet.c
+ *   ./dns_server_host [-p port] [-a answer-ip] [-x exception]... [-n (no cache)]
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dns_packet.h"
+
+#define DNS_BATCH_MAX (16)
+#define MAX_EXCEPTIONS (16)
+
+static volatile sig_atomic_t s_stop = 0;
+
+static void on_signal(int sig)
+{
+    (void) sig;
+    s_stop = 1;
+}
+
+static uint32_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t) (ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static uint32_t resolve_all(const char *name, void *ctx)
+{
+    (void) name;
+    return *(uint32_t *) ctx;
+}
+
+int main(int argc, char **argv)
+{
+    int port = 5353;
+    uint32_t answer_ip = inet_addr("192.168.4.1");
+    const char *exceptions[MAX_EXCEPTIONS];
+    int num_of_exceptions = 0;
+    int use_cache = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:a:x:n")) != -1) {
+        switch (opt) {
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'a':
+            answer_ip = inet_addr(optarg);
+            break;
+        case 'x':
+            if (num_of_exceptions < MAX_EXCEPTIONS) {
+                exceptions[num_of_exceptions++] = optarg;
+            }
+            break;
+        case 'n':
+            use_cache = 0;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-p port] [-a answer-ip] [-x exception]... [-n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    static dns_cache_t cache;
+    dns_responder_t responder = {
+        .resolve = resolve_all,
+        .ctx = &answer_ip,
+        .exceptions = exceptions,
+        .num_of_exceptions = num_of_exceptions,
+        .cache = use_cache ? &cache : NULL,
+    };
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return 1;
+    }
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("bind");
+        return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    printf("listening on udp port %d\n", port);
+    fflush(stdout);
+
+    uint32_t queries = 0, dropped = 0, batches = 0;
+    uint8_t rx_buffer[DNS_MAX_LEN];
+    uint8_t reply[DNS_MAX_LEN];
+
+    while (!s_stop) {
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(sock, &rfds);
+        struct timeval tv = {.tv_sec = 0, .tv_usec = 500 * 1000};
+        int ret = select(sock + 1, &rfds, NULL, NULL, &tv);
+        if (ret <= 0) {
+            continue;
+        }
+        batches++;
+
+        for (int n = 0; n < DNS_BATCH_MAX; n++) {
+            struct sockaddr_in6 source_addr;
+            socklen_t socklen = sizeof(source_addr);
+            int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer), MSG_DONTWAIT, (struct sockaddr *) &source_addr, &socklen);
+            if (len < 0) {
+                break;
+            }
+            queries++;
+            int reply_len = dns_build_reply(&responder, rx_buffer, len, reply, sizeof(reply), now_ms());
+            if (reply_len <= 0) {
+                dropped++;
+                continue;
+            }
+            sendto(sock, reply, reply_len, 0, (struct sockaddr *) &source_addr, socklen);
+        }
+    }
+
+    printf("queries: %u, batches: %u, dropped: %u, cache hits: %u, misses: %u\n", queries, batches, dropped, cache.hits,
+           cache.misses);
+    close(sock);
+    return 0;
+}
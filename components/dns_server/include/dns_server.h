@@ -15,6 +15,10 @@ extern "C"
 #define DNS_SERVER_MAX_ITEMS 1
 #endif
 
+#ifndef DNS_SERVER_MAX_EXCEPTIONS
+#define DNS_SERVER_MAX_EXCEPTIONS 4
+#endif
+
 #include "esp_netif.h"
 #include "esp_system.h"
 
@@ -56,6 +60,9 @@ extern "C"
     {
         int num_of_entries;                          /**<! Number of rules specified in the config struct */
         dns_entry_pair_t item[DNS_SERVER_MAX_ITEMS]; /**<! Array of pairs */
+        int num_of_exceptions;                       /**<! Number of exceptions */
+        const char *exception[DNS_SERVER_MAX_EXCEPTIONS]; /**<! Names answered with NXDOMAIN instead of a rule,
+                                                               "*.example.com" also matches all subdomains */
     } dns_server_config_t;
 
     /**
@@ -67,6 +74,9 @@ extern "C"
      * @brief Set ups and starts a simple DNS server that will respond to all A queries (IPv4)
      * based on configured rules, pairs of name and either IPv4 address or a netif ID (to respond by it's IPv4 add)
      *
+     * AAAA, HTTPS and all other query types get an empty answer, so clients fall back to the
+     * A record without waiting for a timeout. Replies are cached for a few seconds.
+     *
      * @param config Configuration structure listing the pairs of (name, IP/netif-id)
      * @return dns_server's handle on success, NULL on failure
      */
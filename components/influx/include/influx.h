@@ -1,6 +1,9 @@
 #pragma once
 
 #include <pthread.h>
+#include <stdint.h>
+
+#define INFLUX_MAX_POOLS 4
 
 typedef struct
 {
@@ -35,6 +38,31 @@ typedef struct
     float recent_ping_loss;
 } Stats;
 
+typedef struct
+{
+    bool configured;
+    bool connected;
+    char host[64];
+    uint64_t accepted;
+    uint64_t rejected;
+    uint32_t difficulty;
+    int share;          // expected share of the work in percent
+    float response_ms;  // submit -> response
+    float ping_rtt;
+} PoolStats;
+
+typedef struct
+{
+    bool valid;                 // network difficulty known
+    double network_difficulty;
+    double expected_time_s;     // to a block at the current hashrate
+    double expected_blocks;
+    double luck;                // percent
+    double effort;              // percent of a block since the last one
+    double best_percentile;     // percent
+    double expected_best;       // median best share of the work
+} SoloMiningStats;
+
 class Influx {
   protected:
     char *m_host;
@@ -52,6 +80,9 @@ class Influx {
   public:
     // make this beautiful later
     Stats m_stats;
+    PoolStats m_pools[INFLUX_MAX_POOLS];
+    SoloMiningStats m_solo;
+    char m_poolMode[16];
     pthread_mutex_t m_lock;
 
     Influx();
@@ -20,7 +20,22 @@ static const char *TAG = "InfluxDB";
 #define m_big_buffer_SIZE 32768
 
 Influx::Influx() {
-    // nop
+    memset(m_pools, 0, sizeof(m_pools));
+    memset(&m_solo, 0, sizeof(m_solo));
+    m_poolMode[0] = 0;
+}
+
+// line protocol: spaces, commas and equal signs in tag values need a backslash
+static void escape_tag(const char *in, char *out, size_t max_len)
+{
+    size_t o = 0;
+    for (; *in && o + 2 < max_len; in++) {
+        if (*in == ' ' || *in == ',' || *in == '=') {
+            out[o++] = '\\';
+        }
+        out[o++] = *in;
+    }
+    out[o] = 0;
 }
 
 bool Influx::ping()
@@ -396,6 +411,33 @@ void Influx::write()
             m_stats.total_blocks_found, m_stats.duplicate_hashes, m_stats.last_ping_rtt, m_stats.recent_ping_loss,
             m_stats.fan_pwm_0, m_stats.fan_rpm_0, m_stats.fan_rpm_1, m_stats.fan_pwm_1);
 
+    // one line per configured pool
+    for (int i = 0; i < INFLUX_MAX_POOLS; i++) {
+        const PoolStats *p = &m_pools[i];
+        if (!p->configured) {
+            continue;
+        }
+        char host[sizeof(p->host) * 2];
+        escape_tag(p->host, host, sizeof(host));
+
+        size_t len = strlen(m_big_buffer);
+        snprintf(m_big_buffer + len, m_big_buffer_SIZE - len,
+                 "\n%s_pool,pool=%d,host=%s,mode=%s connected=%d,accepted=%llu,rejected=%llu,difficulty=%lu,"
+                 "share=%d,response_ms=%.2f,ping_rtt=%.2f",
+                 m_prefix, i + 1, host[0] ? host : "-", m_poolMode[0] ? m_poolMode : "-", p->connected ? 1 : 0,
+                 (unsigned long long) p->accepted, (unsigned long long) p->rejected, (unsigned long) p->difficulty,
+                 p->share, p->response_ms, p->ping_rtt);
+    }
+
+    if (m_solo.valid) {
+        size_t len = strlen(m_big_buffer);
+        snprintf(m_big_buffer + len, m_big_buffer_SIZE - len,
+                 "\n%s_solo network_difficulty=%f,expected_time_to_block=%f,expected_blocks=%g,luck=%f,effort=%f,"
+                 "best_percentile=%f,expected_best_difficulty=%f",
+                 m_prefix, m_solo.network_difficulty, m_solo.expected_time_s, m_solo.expected_blocks, m_solo.luck,
+                 m_solo.effort, m_solo.best_percentile, m_solo.expected_best);
+    }
+
     snprintf(url, sizeof(url), "%s:%d/api/v2/write?bucket=%s&org=%s&precision=s", m_host, m_port, m_bucket,
              m_org);
 
@@ -0,0 +1,456 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "alert_queue.h"
+
+const alert_policy_t AlertQueue::DEFAULT_POLICY = {
+    .rateBurst = 3,
+    .rateIntervalMs = 20 * 1000,
+    .retryBaseMs = 5 * 1000,
+    .retryMaxMs = 10 * 60 * 1000,
+    .maxAgeMs = 24 * 60 * 60 * 1000,
+};
+
+static const char *kind_names[ALERT_KIND_MAX] = {"test", "watchdog", "block_found", "best_diff"};
+static const char *kind_titles[ALERT_KIND_MAX] = {"Test message", "Watchdog reboot", "Block found!", "New best difficulty"};
+static const char *type_names[WEBHOOK_TYPE_MAX] = {"discord", "telegram", "ntfy", "generic"};
+
+// discord shortcodes, UTF-8 for everyone else, ntfy tags
+static const char *kind_discord_emoji[ALERT_KIND_MAX] = {"", ":warning: ", ":tada: ", ":chart_with_upwards_trend: "};
+static const char *kind_emoji[ALERT_KIND_MAX] = {"", "\xE2\x9A\xA0\xEF\xB8\x8F ", "\xF0\x9F\x8E\x89 ", "\xF0\x9F\x93\x88 "};
+static const char *kind_ntfy_tag[ALERT_KIND_MAX] = {"bell", "warning", "tada", "chart_with_upwards_trend"};
+
+AlertQueue::AlertQueue(const alert_policy_t *policy)
+{
+    memset(m_targets, 0, sizeof(m_targets));
+    memset(m_state, 0, sizeof(m_state));
+    setPolicy(policy);
+}
+
+void AlertQueue::setPolicy(const alert_policy_t *policy)
+{
+    m_policy = policy ? *policy : DEFAULT_POLICY;
+    for (int i = 0; i < ALERT_MAX_TARGETS; i++) {
+        m_state[i].tokens = (float) m_policy.rateBurst;
+    }
+}
+
+const char *AlertQueue::kindToStr(alert_kind_t kind)
+{
+    return (kind < ALERT_KIND_MAX) ? kind_names[kind] : "unknown";
+}
+
+const char *AlertQueue::typeToStr(webhook_type_t type)
+{
+    return (type < WEBHOOK_TYPE_MAX) ? type_names[type] : "unknown";
+}
+
+webhook_type_t AlertQueue::typeFromStr(const char *str)
+{
+    for (int i = 0; str && i < WEBHOOK_TYPE_MAX; i++) {
+        if (!strcmp(str, type_names[i])) {
+            return (webhook_type_t) i;
+        }
+    }
+    return WEBHOOK_TYPE_MAX;
+}
+
+uint8_t AlertQueue::allTargets() const
+{
+    return (uint8_t) ((1u << m_numTargets) - 1);
+}
+
+void AlertQueue::setTargets(const webhook_target_t *targets, int num)
+{
+    if (num > ALERT_MAX_TARGETS) {
+        num = ALERT_MAX_TARGETS;
+    }
+
+    for (int i = 0; i < num; i++) {
+        // keep the rate limit and backoff of unchanged targets
+        if (i >= m_numTargets || memcmp(&m_targets[i], &targets[i], sizeof(webhook_target_t))) {
+            memset(&m_state[i], 0, sizeof(alert_target_state_t));
+            m_state[i].tokens = (float) m_policy.rateBurst;
+        }
+        m_targets[i] = targets[i];
+    }
+    m_numTargets = num;
+    m_lastTarget = -1;
+
+    // alerts for removed targets
+    for (int i = 0; i < m_numEntries; i++) {
+        m_entries[i].pending &= allTargets();
+    }
+    removeDone(0);
+}
+
+alert_entry_t *AlertQueue::findEntry(uint32_t id)
+{
+    for (int i = 0; i < m_numEntries; i++) {
+        if (m_entries[i].id == id) {
+            return &m_entries[i];
+        }
+    }
+    return nullptr;
+}
+
+void AlertQueue::removeEntry(int index)
+{
+    memmove(&m_entries[index], &m_entries[index + 1], (m_numEntries - index - 1) * sizeof(alert_entry_t));
+    m_numEntries--;
+    m_dirty = true;
+}
+
+// removes delivered and expired alerts, nowMs 0 skips the expiry
+void AlertQueue::removeDone(uint64_t nowMs)
+{
+    for (int i = m_numEntries - 1; i >= 0; i--) {
+        alert_entry_t *e = &m_entries[i];
+        bool expired = nowMs && nowMs - e->queuedMs > m_policy.maxAgeMs;
+        if (expired) {
+            for (int t = 0; t < m_numTargets; t++) {
+                if (e->pending & (1 << t)) {
+                    m_state[t].dropped++;
+                }
+            }
+            m_dropped++;
+        }
+        if (!e->pending || expired) {
+            removeEntry(i);
+        }
+    }
+}
+
+bool AlertQueue::hasPending(alert_kind_t kind) const
+{
+    for (int i = 0; i < m_numEntries; i++) {
+        if (m_entries[i].kind == kind) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AlertQueue::push(alert_kind_t kind, const char *message, uint32_t utc, uint64_t nowMs)
+{
+    if (!m_numTargets || kind >= ALERT_KIND_MAX) {
+        return false;
+    }
+
+    alert_entry_t *e = nullptr;
+
+    // the newest alert of a kind replaces the waiting one, found blocks
+    // are always reported one by one
+    if (kind != ALERT_BLOCK_FOUND) {
+        for (int i = 0; i < m_numEntries; i++) {
+            if (m_entries[i].kind == kind) {
+                alert_entry_t tmp = m_entries[i];
+                removeEntry(i);
+                m_entries[m_numEntries++] = tmp;
+                e = &m_entries[m_numEntries - 1];
+                e->count++;
+                m_coalesced++;
+                break;
+            }
+        }
+    }
+
+    if (!e) {
+        if (m_numEntries == ALERT_QUEUE_LEN) {
+            // drop the oldest alert, found blocks are kept as long as possible
+            int victim = 0;
+            for (int i = 0; i < m_numEntries; i++) {
+                if (m_entries[i].kind != ALERT_BLOCK_FOUND) {
+                    victim = i;
+                    break;
+                }
+            }
+            removeEntry(victim);
+            m_dropped++;
+        }
+        e = &m_entries[m_numEntries++];
+        memset(e, 0, sizeof(alert_entry_t));
+        e->kind = kind;
+        e->count = 1;
+    }
+
+    // a new id marks the content as changed, in-flight requests don't
+    // complete the coalesced alert
+    e->id = m_nextId++;
+    e->pending = allTargets();
+    e->time = utc;
+    e->queuedMs = nowMs;
+    snprintf(e->message, sizeof(e->message), "%s", message);
+    m_dirty = true;
+    return true;
+}
+
+void AlertQueue::refill(int target, uint64_t nowMs)
+{
+    alert_target_state_t *s = &m_state[target];
+    if (nowMs > s->refillMs && m_policy.rateIntervalMs) {
+        s->tokens += (float) (nowMs - s->refillMs) / (float) m_policy.rateIntervalMs;
+        if (s->tokens > (float) m_policy.rateBurst) {
+            s->tokens = (float) m_policy.rateBurst;
+        }
+    }
+    s->refillMs = nowMs;
+}
+
+bool AlertQueue::nextBatch(uint64_t nowMs, alert_batch_t *batch)
+{
+    removeDone(nowMs);
+
+    // round robin, a busy target doesn't starve the others
+    for (int n = 1; n <= m_numTargets; n++) {
+        int t = (m_lastTarget + n) % m_numTargets;
+        refill(t, nowMs);
+        if (m_state[t].retryAtMs > nowMs || m_state[t].tokens < 1.0f) {
+            continue;
+        }
+
+        batch->target = t;
+        batch->num = 0;
+        for (int i = 0; i < m_numEntries && batch->num < ALERT_MAX_BATCH; i++) {
+            if (m_entries[i].pending & (1 << t)) {
+                batch->ids[batch->num++] = m_entries[i].id;
+            }
+        }
+        if (batch->num) {
+            m_lastTarget = t;
+            m_state[t].tokens -= 1.0f;
+            return true;
+        }
+    }
+    return false;
+}
+
+int64_t AlertQueue::nextDueInMs(uint64_t nowMs)
+{
+    int64_t due = -1;
+    for (int t = 0; t < m_numTargets; t++) {
+        bool pending = false;
+        for (int i = 0; i < m_numEntries && !pending; i++) {
+            pending = m_entries[i].pending & (1 << t);
+        }
+        if (!pending) {
+            continue;
+        }
+        refill(t, nowMs);
+        int64_t wait = 0;
+        if (m_state[t].tokens < 1.0f) {
+            wait = (int64_t) ((1.0f - m_state[t].tokens) * (float) m_policy.rateIntervalMs) + 1;
+        }
+        if (m_state[t].retryAtMs > nowMs && (int64_t) (m_state[t].retryAtMs - nowMs) > wait) {
+            wait = (int64_t) (m_state[t].retryAtMs - nowMs);
+        }
+        if (due < 0 || wait < due) {
+            due = wait;
+        }
+    }
+    return due;
+}
+
+void AlertQueue::complete(const alert_batch_t *batch, int status, uint32_t retryAfterMs, uint64_t nowMs)
+{
+    if (batch->target >= m_numTargets) {
+        return;
+    }
+    alert_target_state_t *s = &m_state[batch->target];
+    uint8_t bit = 1 << batch->target;
+
+    bool ok = status >= 200 && status < 300;
+    // the request itself is wrong, retrying doesn't help
+    bool permanent = status >= 400 && status < 500 && status != 408 && status != 429;
+
+    if (ok || permanent) {
+        for (int i = 0; i < batch->num; i++) {
+            alert_entry_t *e = findEntry(batch->ids[i]);
+            if (e) {
+                e->pending &= ~bit;
+                m_dirty = true;
+            }
+        }
+        if (ok) {
+            s->sent += batch->num;
+            s->failures = 0;
+        } else {
+            s->dropped += batch->num;
+        }
+        removeDone(0);
+        return;
+    }
+
+    s->failed++;
+    if (s->failures < 16) {
+        s->failures++;
+    }
+    uint64_t delay = (uint64_t) m_policy.retryBaseMs << (s->failures - 1);
+    if (delay > m_policy.retryMaxMs) {
+        delay = m_policy.retryMaxMs;
+    }
+    if (status == 429) {
+        s->tokens = 0.0f;
+        if (retryAfterMs > delay) {
+            delay = retryAfterMs;
+        }
+    }
+    s->retryAtMs = nowMs + delay;
+}
+
+size_t AlertQueue::buildPayload(const alert_batch_t *batch, const alert_host_t *host, char *buf, size_t len)
+{
+    const webhook_target_t *target = &m_targets[batch->target];
+
+    alert_entry_t *entries[ALERT_MAX_BATCH];
+    int num = 0;
+    for (int i = 0; i < batch->num; i++) {
+        alert_entry_t *e = findEntry(batch->ids[i]);
+        if (e) {
+            entries[num++] = e;
+        }
+    }
+    if (!num) {
+        return 0;
+    }
+
+    const char *hostname = (host && host->hostname) ? host->hostname : "unknown";
+    const char *ip = (host && host->ip) ? host->ip : "unknown";
+    const char *mac = (host && host->mac) ? host->mac : "unknown";
+
+    JsonDocument doc;
+
+    if (target->type == WEBHOOK_GENERIC) {
+        JsonObject h = doc["host"].to<JsonObject>();
+        h["hostname"] = hostname;
+        h["ip"] = ip;
+        h["mac"] = mac;
+        JsonArray alerts = doc["alerts"].to<JsonArray>();
+        for (int i = 0; i < num; i++) {
+            JsonObject a = alerts.add<JsonObject>();
+            a["kind"] = kind_names[entries[i]->kind];
+            a["message"] = (const char *) entries[i]->message;
+            a["count"] = entries[i]->count;
+            if (entries[i]->time) {
+                a["time"] = entries[i]->time;
+            }
+        }
+    } else {
+        bool discord = target->type == WEBHOOK_DISCORD;
+        std::string text;
+        char count[16];
+        for (int i = 0; i < num; i++) {
+            const alert_entry_t *e = entries[i];
+            // ntfy shows the emoji of the tags
+            if (target->type != WEBHOOK_NTFY) {
+                text += discord ? kind_discord_emoji[e->kind] : kind_emoji[e->kind];
+            }
+            text += e->message;
+            if (e->count > 1) {
+                snprintf(count, sizeof(count), " (%ux)", e->count);
+                text += count;
+            }
+            text += "\n";
+        }
+
+        char info[160];
+        snprintf(info, sizeof(info), discord ? "```\nHostname: %s\nIP:       %s\nMAC:      %s\n```" : "Hostname: %s\nIP: %s\nMAC: %s",
+                 hostname, ip, mac);
+        text += info;
+
+        switch (target->type) {
+        case WEBHOOK_DISCORD:
+            doc["content"] = text;
+            break;
+        case WEBHOOK_TELEGRAM:
+            doc["chat_id"] = (const char *) target->extra;
+            doc["text"] = text;
+            doc["disable_web_page_preview"] = true;
+            break;
+        case WEBHOOK_NTFY: {
+            char title[96];
+            if (num == 1) {
+                snprintf(title, sizeof(title), "%s: %s", hostname, kind_titles[entries[0]->kind]);
+            } else {
+                snprintf(title, sizeof(title), "%s: %d alerts", hostname, num);
+            }
+            doc["topic"] = (const char *) target->extra;
+            doc["title"] = (const char *) title;
+            doc["message"] = text;
+            JsonArray tags = doc["tags"].to<JsonArray>();
+            int priority = 3;
+            for (int i = 0; i < num; i++) {
+                tags.add(kind_ntfy_tag[entries[i]->kind]);
+                if (entries[i]->kind == ALERT_BLOCK_FOUND) {
+                    priority = 5;
+                } else if (entries[i]->kind == ALERT_WATCHDOG && priority < 4) {
+                    priority = 4;
+                }
+            }
+            doc["priority"] = priority;
+            break;
+        }
+        default:
+            return 0;
+        }
+    }
+
+    if (measureJson(doc) >= len) {
+        return 0;
+    }
+    return serializeJson(doc, buf, len);
+}
+
+void AlertQueue::save(JsonDocument &doc)
+{
+    doc["next"] = m_nextId;
+    JsonArray alerts = doc["alerts"].to<JsonArray>();
+    for (int i = 0; i < m_numEntries; i++) {
+        const alert_entry_t *e = &m_entries[i];
+        JsonObject a = alerts.add<JsonObject>();
+        a["id"] = e->id;
+        a["kind"] = e->kind;
+        a["pending"] = e->pending;
+        a["count"] = e->count;
+        a["time"] = e->time;
+        a["msg"] = (const char *) e->message;
+    }
+}
+
+bool AlertQueue::load(const JsonDocument &doc, uint64_t nowMs)
+{
+    if (!doc["alerts"].is<JsonArrayConst>()) {
+        return false;
+    }
+
+    m_numEntries = 0;
+    for (JsonObjectConst a : doc["alerts"].as<JsonArrayConst>()) {
+        if (m_numEntries == ALERT_QUEUE_LEN) {
+            break;
+        }
+        uint8_t kind = a["kind"] | (uint8_t) ALERT_KIND_MAX;
+        uint8_t pending = (a["pending"] | 0) & allTargets();
+        if (kind >= ALERT_KIND_MAX || !pending) {
+            continue;
+        }
+        alert_entry_t *e = &m_entries[m_numEntries++];
+        memset(e, 0, sizeof(alert_entry_t));
+        e->id = a["id"] | 0u;
+        e->kind = kind;
+        e->pending = pending;
+        e->count = a["count"] | 1;
+        e->time = a["time"] | 0u;
+        e->queuedMs = nowMs;
+        snprintf(e->message, sizeof(e->message), "%s", a["msg"] | "");
+    }
+    m_nextId = doc["next"] | 1u;
+    for (int i = 0; i < m_numEntries; i++) {
+        if (m_entries[i].id >= m_nextId) {
+            m_nextId = m_entries[i].id + 1;
+        }
+    }
+    m_dirty = false;
+    return true;
+}
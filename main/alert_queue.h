@@ -0,0 +1,183 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ArduinoJson.h"
+
+// Pending alerts for up to ALERT_MAX_TARGETS webhooks.
+//
+// - alerts of the same kind are coalesced while they wait (block found
+//   alerts never are), so a streak of best difficulties is one message
+// - each request delivers up to ALERT_MAX_BATCH alerts to one target
+// - per target token bucket and exponential backoff on failures, HTTP 429
+//   Retry-After is honored, other 4xx errors drop the alerts for the target
+// - the queue can be saved as JSON and restored after a reboot
+//
+// No locking and no ESP-IDF dependencies (see host/alert_sim.cpp).
+
+#define ALERT_MAX_TARGETS 4
+#define ALERT_QUEUE_LEN 16
+#define ALERT_MAX_BATCH 5
+#define ALERT_MESSAGE_LEN 160
+#define ALERT_URL_LEN 192
+#define ALERT_EXTRA_LEN 64
+
+typedef enum
+{
+    ALERT_TEST = 0,
+    ALERT_WATCHDOG,
+    ALERT_BLOCK_FOUND,
+    ALERT_BEST_DIFF,
+    ALERT_KIND_MAX
+} alert_kind_t;
+
+typedef enum
+{
+    WEBHOOK_DISCORD = 0, // {"content": ...}
+    WEBHOOK_TELEGRAM,    // bot API sendMessage, extra: chat id
+    WEBHOOK_NTFY,        // JSON publish to the server URL, extra: topic
+    WEBHOOK_GENERIC,     // {"host": {...}, "alerts": [...]}
+    WEBHOOK_TYPE_MAX
+} webhook_type_t;
+
+typedef struct
+{
+    webhook_type_t type;
+    char url[ALERT_URL_LEN];
+    char extra[ALERT_EXTRA_LEN];
+} webhook_target_t;
+
+typedef struct
+{
+    const char *hostname;
+    const char *ip;
+    const char *mac;
+} alert_host_t;
+
+typedef struct
+{
+    uint32_t rateBurst;      // requests a target can send back to back
+    uint32_t rateIntervalMs; // one more request per interval
+    uint32_t retryBaseMs;    // first retry delay, doubled per failure
+    uint32_t retryMaxMs;
+    uint32_t maxAgeMs;       // undelivered alerts are dropped after
+} alert_policy_t;
+
+typedef struct
+{
+    uint32_t id; // changes when the alert is coalesced
+    uint8_t kind;
+    uint8_t pending; // targets still to deliver to
+    uint16_t count;  // coalesced occurrences
+    uint32_t time;   // UTC of the last occurrence, 0 if unknown
+    uint64_t queuedMs;
+    char message[ALERT_MESSAGE_LEN];
+} alert_entry_t;
+
+typedef struct
+{
+    int target;
+    int num;
+    uint32_t ids[ALERT_MAX_BATCH];
+} alert_batch_t;
+
+typedef struct
+{
+    float tokens;
+    uint64_t refillMs;
+    uint64_t retryAtMs;
+    uint8_t failures;
+    uint32_t sent;
+    uint32_t failed;
+    uint32_t dropped;
+} alert_target_state_t;
+
+class AlertQueue {
+  public:
+    static const alert_policy_t DEFAULT_POLICY;
+
+  protected:
+    alert_policy_t m_policy;
+
+    webhook_target_t m_targets[ALERT_MAX_TARGETS];
+    alert_target_state_t m_state[ALERT_MAX_TARGETS];
+    int m_numTargets = 0;
+    int m_lastTarget = -1;
+
+    alert_entry_t m_entries[ALERT_QUEUE_LEN];
+    int m_numEntries = 0;
+    uint32_t m_nextId = 1;
+
+    bool m_dirty = false;
+    uint32_t m_coalesced = 0;
+    uint32_t m_dropped = 0;
+
+    uint8_t allTargets() const;
+    alert_entry_t *findEntry(uint32_t id);
+    void removeEntry(int index);
+    void removeDone(uint64_t nowMs);
+    void refill(int target, uint64_t nowMs);
+
+  public:
+    AlertQueue(const alert_policy_t *policy = nullptr);
+
+    void setPolicy(const alert_policy_t *policy);
+    void setTargets(const webhook_target_t *targets, int num);
+    int getNumTargets() const
+    {
+        return m_numTargets;
+    }
+    const webhook_target_t *getTarget(int target) const
+    {
+        return &m_targets[target];
+    }
+    const alert_target_state_t *getTargetState(int target) const
+    {
+        return &m_state[target];
+    }
+
+    bool push(alert_kind_t kind, const char *message, uint32_t utc, uint64_t nowMs);
+
+    // alerts for the next target that is due, false if none is
+    bool nextBatch(uint64_t nowMs, alert_batch_t *batch);
+
+    // request body (JSON) for the batch, 0 if it doesn't fit
+    size_t buildPayload(const alert_batch_t *batch, const alert_host_t *host, char *buf, size_t len);
+
+    // status: HTTP status, <= 0 for transport errors
+    void complete(const alert_batch_t *batch, int status, uint32_t retryAfterMs, uint64_t nowMs);
+
+    // ms until the next target is due, -1 if nothing is pending
+    int64_t nextDueInMs(uint64_t nowMs);
+
+    int getNumPending() const
+    {
+        return m_numEntries;
+    }
+    bool hasPending(alert_kind_t kind) const;
+    uint32_t getCoalesced() const
+    {
+        return m_coalesced;
+    }
+    uint32_t getDropped() const
+    {
+        return m_dropped;
+    }
+
+    // persistence
+    bool isDirty() const
+    {
+        return m_dirty;
+    }
+    void save(JsonDocument &doc);
+    bool load(const JsonDocument &doc, uint64_t nowMs);
+    void clearDirty()
+    {
+        m_dirty = false;
+    }
+
+    static const char *kindToStr(alert_kind_t kind);
+    static const char *typeToStr(webhook_type_t type);
+    static webhook_type_t typeFromStr(const char *str);
+};
@@ -144,6 +144,33 @@ bool Board::setAsicFrequency(float frequency) {
     return m_asics->setAsicFrequency(frequency);
 }
 
+// all chips to one frequency, each ramped from its own one
+bool Board::setAsicFrequency(float frequency, const float *chipFrequencies) {
+    if (!validateFrequency(frequency)) {
+        return false;
+    }
+
+    // not initialized
+    if (!m_asics) {
+        return false;
+    }
+
+    return m_asics->setAsicFrequency(frequency, chipFrequencies, m_asicCount);
+}
+
+bool Board::setChipFrequency(int chip, float current, float target) {
+    if (chip < 0 || chip >= m_asicCount || !validateFrequency(target)) {
+        return false;
+    }
+
+    // not initialized
+    if (!m_asics) {
+        return false;
+    }
+
+    return m_asics->setChipFrequency(chip, current, target);
+}
+
 // set and get version rolling frequency
 // requires loadSettings to update the variables
 void Board::setVrFrequency(uint32_t freq) {
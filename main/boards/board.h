@@ -6,6 +6,7 @@
 #include "bm1368.h"
 #include "nvs_config.h"
 #include "../pid/PID_v1_bc.h"
+#include "task_plan.h"
 
 class Board {
 public:
@@ -47,6 +48,9 @@ public:
 
     PidSettings m_pidSettings;
 
+    // core, priority and stack of the tasks, boards change single entries
+    TaskPlan m_taskPlan;
+
     // asic settings
     int m_asicJobIntervalMs;
     int m_asicFrequency;
@@ -91,6 +95,10 @@ public:
 
     int m_numFans;
 
+    // chip placement for the thermal model, chips are numbered row by row
+    // 0 means all chips in a single row
+    int m_chipLayoutCols = 0;
+
     bool m_shutdown = false;
 
     // display m_theme
@@ -117,6 +125,8 @@ public:
     uint32_t getInitialASICDifficulty();
 
     virtual bool setAsicFrequency(float f);
+    bool setAsicFrequency(float f, const float *chipFrequencies);
+    virtual bool setChipFrequency(int chip, float current, float target);
     bool validateFrequency(float frequency);
     bool validateVoltage(float core_voltage);
 
@@ -165,6 +175,18 @@ public:
 
     virtual bool selfTest();
 
+    // in-field two-point calibration of the temp sensors
+    virtual bool calibrateTempSensor(int sensor, int point, float reference)
+    {
+        return false;
+    }
+    virtual void resetTempCalibration() {}
+
+    TaskPlan *getTaskPlan()
+    {
+        return &m_taskPlan;
+    };
+
     Theme *getTheme()
     {
         return m_theme;
@@ -283,11 +305,21 @@ public:
         return m_vr_maxTemp;
     }
 
+    int getChipsDetected()
+    {
+        return m_chipsDetected;
+    }
+
     int getNumTempSensors()
     {
         return m_numTempSensors;
     }
 
+    int getChipLayoutCols()
+    {
+        return m_chipLayoutCols ? m_chipLayoutCols : m_asicCount;
+    }
+
     bool isFlipScreenEnabled()
     {
         return m_flipScreen;
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "nvs_config.h"
+#include "temp_filter.h"
+
+static const char *TAG = "temp_filter";
+
+// plausible sensor range, the TMP1075 reads up to 125°C and 127.94°C
+// is the all-ones value of a failed bus transfer
+#define TEMP_MIN_VALID -20.0f
+#define TEMP_MAX_VALID 125.0f
+
+// failed reads until the last value isn't held anymore
+#define TEMP_MAX_FAILS 5
+
+// readings further away from the median are outliers
+// unless they persist on the same level (real step change)
+#define TEMP_OUTLIER_DELTA 8.0f
+#define TEMP_OUTLIER_CONFIRM 3
+
+// identical raw readings until a sensor is considered stuck
+// (the sensors have 1/16 °C resolution and always have some noise)
+#define TEMP_STUCK_SAMPLES 100
+
+#define TEMP_EMA_ALPHA 0.5f
+
+// calibration points need some distance to give a usable slope
+#define TEMP_CAL_MIN_SPAN 5.0f
+
+void TempFilter::reset()
+{
+    m_count = 0;
+    m_pos = 0;
+    m_value = NAN;
+    m_lastRaw = NAN;
+    m_sameCount = 0;
+    m_outlierRun = 0;
+    m_outlierLast = NAN;
+    m_failRun = 0;
+}
+
+float TempFilter::median()
+{
+    float sorted[TEMP_FILTER_WINDOW];
+    memcpy(sorted, m_window, sizeof(float) * m_count);
+    std::sort(sorted, sorted + m_count);
+    return sorted[m_count / 2];
+}
+
+void TempFilter::push(float raw)
+{
+    m_window[m_pos] = raw;
+    m_pos = (m_pos + 1) % TEMP_FILTER_WINDOW;
+    m_count = std::min(m_count + 1, TEMP_FILTER_WINDOW);
+}
+
+bool TempFilter::isStuck()
+{
+    return m_sameCount >= TEMP_STUCK_SAMPLES;
+}
+
+float TempFilter::update(float raw)
+{
+    if (isnan(raw) || raw < TEMP_MIN_VALID || raw > TEMP_MAX_VALID) {
+        m_rejected++;
+        if (++m_failRun >= TEMP_MAX_FAILS) {
+            m_value = NAN;
+        }
+        return m_value;
+    }
+    m_failRun = 0;
+
+    m_sameCount = (raw == m_lastRaw) ? m_sameCount + 1 : 0;
+    m_lastRaw = raw;
+
+    if (m_count && fabsf(raw - median()) > TEMP_OUTLIER_DELTA) {
+        // glitches scatter, a step keeps the new level
+        if (m_outlierRun && fabsf(raw - m_outlierLast) > TEMP_OUTLIER_DELTA) {
+            m_outlierRun = 0;
+        }
+        m_outlierLast = raw;
+        if (++m_outlierRun < TEMP_OUTLIER_CONFIRM) {
+            m_rejected++;
+            return m_value;
+        }
+        // the jump persisted, start over from the new level
+        m_count = 0;
+        m_pos = 0;
+        m_value = NAN;
+    }
+    m_outlierRun = 0;
+
+    push(raw);
+
+    float med = median();
+    m_value = isnan(m_value) ? med : m_value + TEMP_EMA_ALPHA * (med - m_value);
+    return m_value;
+}
+
+TempCalibration::TempCalibration(const char *nvsKey, int channels, float defaultScale, float defaultOffset)
+    : m_nvsKey(nvsKey), m_channels(std::min(channels, TEMP_CAL_MAX_CHANNELS)), m_defaultScale(defaultScale),
+      m_defaultOffset(defaultOffset)
+{
+    for (int i = 0; i < TEMP_CAL_MAX_CHANNELS; i++) {
+        m_scale[i] = defaultScale;
+        m_offset[i] = defaultOffset;
+        m_pointRaw[i][0] = m_pointRaw[i][1] = NAN;
+        m_pointRef[i][0] = m_pointRef[i][1] = NAN;
+    }
+}
+
+// format: "scale,offset;scale,offset;..."
+void TempCalibration::load()
+{
+    char *str = Config::getTempCalibration(m_nvsKey);
+    char *p = str;
+
+    for (int ch = 0; ch < m_channels && *p; ch++) {
+        char *end = nullptr;
+        float scale = strtof(p, &end);
+        if (end == p || *end != ',') {
+            break;
+        }
+        p = end + 1;
+        float offset = strtof(p, &end);
+        if (end == p || scale <= 0.0f) {
+            break;
+        }
+        m_scale[ch] = scale;
+        m_offset[ch] = offset;
+        ESP_LOGI(TAG, "%s ch%d: scale %.4f offset %.2f", m_nvsKey, ch, scale, offset);
+        p = (*end == ';') ? end + 1 : end;
+    }
+    free(str);
+}
+
+void TempCalibration::save()
+{
+    char buf[TEMP_CAL_MAX_CHANNELS * 24 + 1] = {0};
+    size_t offset = 0;
+
+    for (int ch = 0; ch < m_channels; ch++) {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, ch ? ";%.4f,%.2f" : "%.4f,%.2f", m_scale[ch], m_offset[ch]);
+    }
+    Config::setTempCalibration(m_nvsKey, buf);
+}
+
+void TempCalibration::reset()
+{
+    for (int ch = 0; ch < m_channels; ch++) {
+        m_scale[ch] = m_defaultScale;
+        m_offset[ch] = m_defaultOffset;
+        m_pointRaw[ch][0] = m_pointRaw[ch][1] = NAN;
+        m_pointRef[ch][0] = m_pointRef[ch][1] = NAN;
+    }
+    Config::setTempCalibration(m_nvsKey, "");
+    ESP_LOGI(TAG, "%s calibration reset", m_nvsKey);
+}
+
+float TempCalibration::apply(int channel, float raw)
+{
+    if (channel < 0 || channel >= m_channels || isnan(raw)) {
+        return NAN;
+    }
+    return raw * m_scale[channel] + m_offset[channel];
+}
+
+bool TempCalibration::setPoint(int channel, int point, float raw, float reference)
+{
+    if (channel < 0 || channel >= m_channels || point < 0 || point > 1 || isnan(raw) || isnan(reference)) {
+        return false;
+    }
+
+    m_pointRaw[channel][point] = raw;
+    m_pointRef[channel][point] = reference;
+    ESP_LOGI(TAG, "%s ch%d point %d: raw %.2f reference %.2f", m_nvsKey, channel, point, raw, reference);
+
+    float r0 = m_pointRaw[channel][0];
+    float r1 = m_pointRaw[channel][1];
+    if (isnan(r0) || isnan(r1)) {
+        // wait for the other point
+        return true;
+    }
+
+    float scale = (m_pointRef[channel][1] - m_pointRef[channel][0]) / (r1 - r0);
+    float offset = m_pointRef[channel][0] - r0 * scale;
+
+    // both points are used up, a rejected pair starts over
+    m_pointRaw[channel][0] = m_pointRaw[channel][1] = NAN;
+    m_pointRef[channel][0] = m_pointRef[channel][1] = NAN;
+
+    if (fabsf(r1 - r0) < TEMP_CAL_MIN_SPAN) {
+        ESP_LOGE(TAG, "calibration points too close (%.2f / %.2f)", r0, r1);
+        return false;
+    }
+
+    if (scale <= 0.0f) {
+        ESP_LOGE(TAG, "invalid calibration slope %.4f", scale);
+        return false;
+    }
+
+    m_scale[channel] = scale;
+    m_offset[channel] = offset;
+
+    ESP_LOGI(TAG, "%s ch%d calibrated: scale %.4f offset %.2f", m_nvsKey, channel, scale, m_offset[channel]);
+    save();
+    return true;
+}
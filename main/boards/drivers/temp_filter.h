@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+#define TEMP_FILTER_WINDOW 5
+#define TEMP_CAL_MAX_CHANNELS 4
+
+// Filter for a single temperature sensor
+//
+// - readings outside of the plausible range or failed reads (NAN) are dropped,
+//   the last value is held for a few samples before the sensor is invalid
+// - jumps far away from the median are rejected unless they persist
+// - median over the last readings followed by an EMA
+// - a sensor that keeps returning the exact same raw value is flagged as stuck
+class TempFilter {
+  protected:
+    float m_window[TEMP_FILTER_WINDOW];
+    int m_count = 0;
+    int m_pos = 0;
+
+    float m_value = NAN;
+    float m_lastRaw = NAN;
+    int m_sameCount = 0;
+    int m_outlierRun = 0;
+    float m_outlierLast = NAN;
+    int m_failRun = 0;
+    uint32_t m_rejected = 0;
+
+    float median();
+    void push(float raw);
+
+  public:
+    // feeds a raw reading (NAN for a failed read), returns the filtered value
+    // or NAN if the sensor has no valid value
+    float update(float raw);
+
+    void reset();
+
+    float get()
+    {
+        return m_value;
+    }
+
+    bool isValid()
+    {
+        return !isnan(m_value) && !isStuck();
+    }
+
+    bool isStuck();
+
+    uint32_t getRejected()
+    {
+        return m_rejected;
+    }
+};
+
+// Linear two-point calibration per channel persisted to NVS
+// corrected = raw * scale + offset
+class TempCalibration {
+  protected:
+    const char *m_nvsKey;
+    int m_channels;
+    float m_defaultScale;
+    float m_defaultOffset;
+
+    float m_scale[TEMP_CAL_MAX_CHANNELS];
+    float m_offset[TEMP_CAL_MAX_CHANNELS];
+
+    // captured calibration points, NAN if not set
+    float m_pointRaw[TEMP_CAL_MAX_CHANNELS][2];
+    float m_pointRef[TEMP_CAL_MAX_CHANNELS][2];
+
+    void save();
+
+  public:
+    TempCalibration(const char *nvsKey, int channels, float defaultScale = 1.0f, float defaultOffset = 0.0f);
+
+    void load();
+    void reset();
+
+    float apply(int channel, float raw);
+
+    // captures calibration point 0 or 1. When both points of a channel are
+    // captured the coefficients are computed and saved.
+    bool setPoint(int channel, int point, float raw, float reference);
+
+    float getScale(int channel)
+    {
+        return (channel >= 0 && channel < m_channels) ? m_scale[channel] : NAN;
+    }
+
+    float getOffset(int channel)
+    {
+        return (channel >= 0 && channel < m_channels) ? m_offset[channel] : NAN;
+    }
+};
@@ -1,25 +1,16 @@
 #include "tmp451_mux.h"
 #include "i2c_master.h"
+#include "nvs_config.h"
+#include "esp_timer.h"
 #include <esp_check.h>
 
-struct TempCal
-{
-    float scale;
-    float off[4];
-};
-
-static TempCal gCal{1.09f, {-29.5f, -29.5f, -29.5f, -29.5f}};
-
-float Tmp451Mux::temp_correct(int ch, float t_meas)
-{
-    if (ch < 0 || ch >= 4) {
-        return NAN;
-    }
-    return ((t_meas - 30.0f) * gCal.scale + 30.0f) + gCal.off[ch];
-}
+// default correction: ((t - 30) * 1.09 + 30) - 29.5
+static constexpr float DEFAULT_CAL_SCALE  = 1.09f;
+static constexpr float DEFAULT_CAL_OFFSET = 30.0f - 30.0f * DEFAULT_CAL_SCALE - 29.5f;
 
 Tmp451Mux::Tmp451Mux(gpio_num_t mux_a0, gpio_num_t mux_a1, uint8_t i2c_addr, bool mux_active_high)
-    : m_mux_a0(mux_a0), m_mux_a1(mux_a1), m_addr(i2c_addr), m_mux_active_high(mux_active_high)
+    : m_mux_a0(mux_a0), m_mux_a1(mux_a1), m_addr(i2c_addr), m_mux_active_high(mux_active_high),
+      m_cal(NVS_CONFIG_TEMP_CAL_TMUX, TMP451_MUX_CHANNELS, DEFAULT_CAL_SCALE, DEFAULT_CAL_OFFSET)
 {}
 
 esp_err_t Tmp451Mux::init()
@@ -51,7 +42,12 @@ esp_err_t Tmp451Mux::init()
     ESP_RETURN_ON_ERROR(write_reg(REG_RTOFFS_MSB, 0x00), TAG, "offset msb");
     ESP_RETURN_ON_ERROR(write_reg(REG_RTOFFS_LSB, 0x00), TAG, "offset lsb");
 
+    // load in-field calibration
+    m_cal.load();
+
     // Default: select channel 0
+    m_selected = 0;
+    m_selected_us = esp_timer_get_time();
     return select_channel(0);
 }
 
@@ -68,15 +64,77 @@ float Tmp451Mux::get_temperature(int channel)
     if (select_channel(channel) != ESP_OK) {
         return NAN;
     }
-    vTaskDelay(pdMS_TO_TICKS(m_wait_after_switch_ms));
+    m_selected = channel;
+    m_selected_us = esp_timer_get_time();
+
+    // also apply the ideality factor and offset
+    return m_cal.apply(channel, read_channel_raw(channel));
+}
+
+// reads the selected channel, only waits for the part of the settle
+// time that hasn't passed yet
+float Tmp451Mux::read_channel_raw(int channel)
+{
+    int64_t elapsed_ms = (esp_timer_get_time() - m_selected_us) / 1000;
+    if (elapsed_ms < (int64_t) m_wait_after_switch_ms) {
+        vTaskDelay(pdMS_TO_TICKS(m_wait_after_switch_ms - elapsed_ms));
+    }
 
     // start conversion but throw-away the first one
     (void) read_remote_celsius();
 
     // wait a little and do the real measurement
-    // also apply the ideality factor and offset
     vTaskDelay(pdMS_TO_TICKS(m_wait_before_read_ms));
-    return temp_correct(channel, read_remote_celsius());
+    return read_remote_celsius();
+}
+
+void Tmp451Mux::poll(int count)
+{
+    for (int i = 0; i < count; i++) {
+        int channel = m_selected;
+        float raw = read_channel_raw(channel);
+
+        float before = m_filter[channel].get();
+        m_filter[channel].update(raw);
+        if (!isnan(before) && isnan(m_filter[channel].get())) {
+            ESP_LOGE(TAG, "channel %d: no valid readings", channel);
+        }
+
+        // select the next channel now so it settles until the next read
+        m_selected = (channel + 1) % TMP451_MUX_CHANNELS;
+        if (select_channel(m_selected) == ESP_OK) {
+            m_selected_us = esp_timer_get_time();
+        }
+    }
+}
+
+float Tmp451Mux::get_filtered_temperature(int channel)
+{
+    if (channel < 0 || channel >= TMP451_MUX_CHANNELS || !m_filter[channel].isValid()) {
+        return NAN;
+    }
+    return m_cal.apply(channel, m_filter[channel].get());
+}
+
+bool Tmp451Mux::is_stuck(int channel)
+{
+    if (channel < 0 || channel >= TMP451_MUX_CHANNELS) {
+        return false;
+    }
+    return m_filter[channel].isStuck();
+}
+
+bool Tmp451Mux::calibrate(int channel, int point, float reference)
+{
+    if (channel < 0 || channel >= TMP451_MUX_CHANNELS || !m_filter[channel].isValid()) {
+        return false;
+    }
+    return m_cal.setPoint(channel, point, m_filter[channel].get(), reference);
+}
+
+void Tmp451Mux::reset_calibration()
+{
+    m_cal.reset();
 }
 
 esp_err_t Tmp451Mux::select_channel(int channel)
@@ -6,6 +6,9 @@
 #include "esp_log.h"
 #include <stdint.h>
 #include <math.h>
+#include "temp_filter.h"
+
+#define TMP451_MUX_CHANNELS 4
 
 class Tmp451Mux {
 public:
@@ -18,8 +21,22 @@ public:
     esp_err_t init();
 
     // Read remote temperature (°C) on MUX channel 0..3; returns NAN on error.
+    // Blocking one-shot measurement without filtering.
     float get_temperature(int channel);
 
+    // Measure the next `count` channels round robin and feed the filters.
+    // The following channel is selected right after a read so it settles
+    // until the next poll and the switch wait is usually skipped.
+    void poll(int count);
+
+    // Filtered and calibrated temperature of a channel; NAN if not valid.
+    float get_filtered_temperature(int channel);
+    bool is_stuck(int channel);
+
+    // Two-point calibration from the current filtered raw reading.
+    bool calibrate(int channel, int point, float reference);
+    void reset_calibration();
+
     // Select MUX channel 0..3.
     esp_err_t select_channel(int channel);
 
@@ -59,7 +76,7 @@ private:
     esp_err_t read_reg(uint8_t reg, uint8_t* out);
     esp_err_t write_reg(uint8_t reg, uint8_t val);
 
-    float temp_correct(int ch, float t_meas);
+    float read_channel_raw(int channel);
 
     static inline float make_temp_c(int8_t msb, uint8_t lsb_nibble) {
         return static_cast<float>(msb) + static_cast<float>(lsb_nibble) * 0.0625f;
@@ -73,4 +90,11 @@ private:
 
     uint32_t   m_wait_after_switch_ms = 50;
     uint32_t   m_wait_before_read_ms  = 75;
+
+    // round robin scheduling
+    int        m_selected = 0;
+    int64_t    m_selected_us = 0;
+
+    TempFilter      m_filter[TMP451_MUX_CHANNELS];
+    TempCalibration m_cal;
 };
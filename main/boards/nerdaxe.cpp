@@ -11,6 +11,7 @@
 #include "nerdaxe.h"
 #include "nvs_config.h"
 #include "../displays/displayDriver.h"
+#include "../self_test/self_test.h"
 
 #include "drivers/nerdaxe/DS4432U.h"
 #include "drivers/nerdaxe/EMC2101.h"
@@ -262,40 +263,23 @@ bool NerdAxe::selfTest(){
     #define CORE_VOLTAGE_TARGET_MIN 1.0 //mV
     #define CORE_VOLTAGE_TARGET_MAX 1.35 //mV
 
-    char logString[300];
-
     // Initialize the display
     DisplayDriver *temp_display;
     temp_display = new DisplayDriver();
     temp_display->init(this);
 
-    temp_display->logMessage("\nSelfTest initiated, wait...\r\n\n\n\n\n\n"
-                             "[Warning] This test only ensures Asic is properly soldered\nHashrate is not checked");
+    temp_display->logMessage("\nSelfTest initiated, wait...\r\n\n\n\n\n\n");
 
     //Init Asics
     initAsics();
-    float power = getPin();
-    float Vout = getVout();
-    bool powerOK = (power > m_minPin) && (power < m_maxPin);
-    bool VrOK = (Vout > CORE_VOLTAGE_TARGET_MIN) && (Vout < CORE_VOLTAGE_TARGET_MAX);
-    bool allAsicsDetected = (m_chipsDetected == m_asicCount); // Verifica que todos los ASICs se han detectado
-
-    //Warning! This test only ensures Asic is properly soldered
-    snprintf(logString, sizeof(logString),  "\nTest result:\r\n"
-                                            "- Asics detected [%d/%d]\n"
-                                            "- Power status: %s (%.2f W)\n"
-                                            "- Asic voltage: %s (%.2f V)\r\n\n"
-                                            "%s", // Final result
-                                            m_chipsDetected, m_asicCount,
-                                            powerOK ? "OK" : "Warning", power,
-                                            VrOK ? "OK" : "Warning", Vout,
-                                            (allAsicsDetected) ? "OOOOOOOO TEST OK!!! OOOOOOO" : "XXXXXXXXX TEST KO XXXXXXXXX");
-    temp_display->logMessage(logString);
+
+    SelfTest test(this, temp_display, CORE_VOLTAGE_TARGET_MIN, CORE_VOLTAGE_TARGET_MAX);
+    bool passed = test.run(Config::isSelfTestField());
 
     //Update SelfTest flag
-    if(allAsicsDetected) {
+    if(passed) {
         Config::setSelfTest(false);
     }
 
-    return allAsicsDetected;
+    return passed;
 }
@@ -9,6 +9,7 @@ NerdHaxeGamma::NerdHaxeGamma() : NerdQaxePlus2() {
     m_miningAgent = m_deviceModel;
     m_asicModel = "BM1370";
     m_asicCount = 6;
+    m_chipLayoutCols = 3; // 2 rows of 3
     m_numPhases = 4;
     m_imax = 120;
     m_ifault = 105.0;
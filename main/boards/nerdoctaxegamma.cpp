@@ -14,6 +14,7 @@ NerdOctaxeGamma::NerdOctaxeGamma() : NerdQaxePlus2() {
     m_miningAgent = m_deviceModel;
     m_asicModel = "BM1370";
     m_asicCount = 8;
+    m_chipLayoutCols = 4; // 2 rows of 4
 
     m_asicMaxDifficulty = 4096;
     m_asicMinDifficulty = 1024;
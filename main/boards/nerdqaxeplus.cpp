@@ -13,6 +13,7 @@
 #include "nerdqaxeplus.h"
 #include "nvs_config.h"
 #include "../displays/displayDriver.h"
+#include "../self_test/self_test.h"
 
 #include "EMC2302.h"
 #include "TMP1075.h"
@@ -24,12 +25,13 @@ static const char* TAG="nerdqaxe+";
 
 #define VR_TEMP1075_ADDR   0x1
 
-NerdQaxePlus::NerdQaxePlus() : Board() {
+NerdQaxePlus::NerdQaxePlus() : Board(), m_tempCal(NVS_CONFIG_TEMP_CAL_TMP1075, NQ_MAX_TEMP_SENSORS) {
     m_deviceModel = "NerdQAxe+";
     m_miningAgent = m_deviceModel;
     m_version = 501;
     m_asicModel = "BM1368";
     m_asicCount = 4;
+    m_chipLayoutCols = 2; // 2 rows of 2
     m_asicJobIntervalMs = 1200;
     m_asicFrequencies = {400, 425, 450, 475, 490, 500, 525, 550, 575};
     m_asicVoltages = {1100, 1150, 1200, 1250, 1300, 1350};
@@ -92,6 +94,8 @@ bool NerdQaxePlus::initBoard()
 
     ESP_LOGI(TAG, "found %d ASIC temp measuring sensors", m_numTempSensors);
 
+    m_tempCal.load();
+
     EMC2302_init(m_fanInvertPolarity);
     setFanSpeed(m_fanPerc);
     setFanSpeed(m_fanPerc);
@@ -189,6 +193,8 @@ void NerdQaxePlus::requestBuckTelemtry() {
 }
 
 void NerdQaxePlus::requestChipTemps() {
+    sampleTemperatures();
+
     if (!m_asics) {
         return;
     }
@@ -263,13 +269,43 @@ int NerdQaxePlus::detectNumTempSensors() {
     return found;
 }
 
+// feeds one reading of each sensor into its filter, called once per
+// power management loop (or self-test poll) from requestChipTemps
+void NerdQaxePlus::sampleTemperatures() {
+    for (int i = 0; i < getNumTempSensors(); i++) {
+        // read temp and skip index 1
+        // the driver returns 0.0 on errors
+        float raw = TMP1075_read_temperature(i + !!i);
+        m_tempFilter[i].update(raw != 0.0f ? raw : NAN);
+
+        if (m_tempFilter[i].isStuck()) {
+            ESP_LOGE(TAG, "temp sensor %d stuck", i);
+        }
+    }
+}
+
 float NerdQaxePlus::getTemperature(int index) {
-    if (index >= getNumTempSensors()) {
+    if (index < 0 || index >= getNumTempSensors()) {
         return 0.0;
     }
 
-    // read temp and skip index 1
-    return TMP1075_read_temperature(index + !!index);
+    // 0 means not available
+    TempFilter &filter = m_tempFilter[index];
+    if (!filter.isValid()) {
+        return 0.0;
+    }
+    return m_tempCal.apply(index, filter.get());
+}
+
+bool NerdQaxePlus::calibrateTempSensor(int sensor, int point, float reference) {
+    if (sensor < 0 || sensor >= getNumTempSensors() || !m_tempFilter[sensor].isValid()) {
+        return false;
+    }
+    return m_tempCal.setPoint(sensor, point, m_tempFilter[sensor].get(), reference);
+}
+
+void NerdQaxePlus::resetTempCalibration() {
+    m_tempCal.reset();
 }
 
 float NerdQaxePlus::getVRTemp() {
@@ -374,40 +410,23 @@ bool NerdQaxePlus::selfTest(){
     #define CORE_VOLTAGE_TARGET_MIN 1.1 //mV
     #define CORE_VOLTAGE_TARGET_MAX 1.4 //mV
 
-    char logString[300];
-
     // Initialize the display
     DisplayDriver *temp_display;
     temp_display = new DisplayDriver();
     temp_display->init(this);
 
-    temp_display->logMessage("\nSelfTest initiated, wait...\r\n\n\n\n\n\n"
-                             "[Warning] This test only ensures Asic is properly soldered\nHashrate is not checked");
+    temp_display->logMessage("\nSelfTest initiated, wait...\r\n\n\n\n\n\n");
 
     //Init Asics
     initAsics();
-    float power = getPin();
-    float Vout = getVout();
-    bool powerOK = (power > m_minPin) && (power < m_maxPin);
-    bool VrOK = (Vout > CORE_VOLTAGE_TARGET_MIN) && (Vout < CORE_VOLTAGE_TARGET_MAX);
-    bool allAsicsDetected = (m_chipsDetected == m_asicCount); // Verifica que todos los ASICs se han detectado
-
-    //Warning! This test only ensures Asic is properly soldered
-    snprintf(logString, sizeof(logString),  "\nTest result:\r\n"
-                                            "- Asics detected [%d/%d]\n"
-                                            "- Power status: %s (%.2f W)\n"
-                                            "- Asic voltage: %s (%.2f V)\r\n\n"
-                                            "%s", // Final result
-                                            m_chipsDetected, m_asicCount,
-                                            powerOK ? "OK" : "Warning", power,
-                                            VrOK ? "OK" : "Warning", Vout,
-                                            (allAsicsDetected) ? "OOOOOOOO TEST OK!!! OOOOOOO" : "XXXXXXXXX TEST KO XXXXXXXXX");
-    temp_display->logMessage(logString);
+
+    SelfTest test(this, temp_display, CORE_VOLTAGE_TARGET_MIN, CORE_VOLTAGE_TARGET_MAX);
+    bool passed = test.run(Config::isSelfTestField());
 
     //Update SelfTest flag
-    if(allAsicsDetected) {
+    if(passed) {
         Config::setSelfTest(false);
     }
 
-    return true;
+    return passed;
 }
@@ -4,6 +4,10 @@
 #include "bm1368.h"
 #include "board.h"
 #include "./drivers/TPS53647.h"
+#include "./drivers/temp_filter.h"
+
+// max number of TMP1075 asic temp sensors
+#define NQ_MAX_TEMP_SENSORS 3
 
 class NerdQaxePlus : public Board {
   protected:
@@ -16,9 +20,13 @@ class NerdQaxePlus : public Board {
     void LDO_disable();
 
     int detectNumTempSensors();
+    void sampleTemperatures();
 
     TPS53647 *m_tps;
 
+    TempFilter m_tempFilter[NQ_MAX_TEMP_SENSORS];
+    TempCalibration m_tempCal;
+
   public:
     NerdQaxePlus();
 
@@ -48,4 +56,7 @@ class NerdQaxePlus : public Board {
 
     virtual Board::Error getFault(uint32_t *status);
     virtual bool selfTest();
+
+    virtual bool calibrateTempSensor(int sensor, int point, float reference);
+    virtual void resetTempCalibration();
 };
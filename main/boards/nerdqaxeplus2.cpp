@@ -8,6 +8,7 @@ NerdQaxePlus2::NerdQaxePlus2() : NerdQaxePlus() {
     m_miningAgent = m_deviceModel;
     m_asicModel = "BM1370";
     m_asicCount = 4;
+    m_chipLayoutCols = 2; // 2 rows of 2
     m_numPhases = 3;
     m_imax = m_numPhases * 30;
     m_ifault = (float) (m_imax + 5);
@@ -55,5 +56,6 @@ float NerdQaxePlus2::getTemperature(int index) {
 }
 
 void NerdQaxePlus2::requestChipTemps() {
-    // NOP
+    // no chip temps, only the board sensors
+    sampleTemperatures();
 }
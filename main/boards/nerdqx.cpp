@@ -1,9 +1,13 @@
+#include <algorithm>
 #include "board.h"
 #include "nerdqx.h"
 #include "nerdqaxeplus2.h"
 
 static const char* TAG="NerdQX";
 
+// channels measured per call, all 4 chips are updated every 2 calls
+#define TMUX_CHANNELS_PER_POLL 2
+
 // Carefully calibrated and tested settings for all operating modes.
 // >> Do NOT touch or change! <<
 static int __attribute__((noinline))
@@ -110,11 +114,45 @@ void NerdQX::requestChipTemps() {
         return;
     }
 
-    for (int i=0;i<m_asicCount;i++) {
-        float temp = m_tmp451.get_temperature(i);
-        // ESP_LOGI(TAG, "temperature of chip %d: %.3f", i, temp);
+    m_tmp451.poll(TMUX_CHANNELS_PER_POLL);
+
+    int channels = std::min(m_asicCount, TMP451_MUX_CHANNELS);
+
+    // the hottest valid chip is used for failed sensors so
+    // the PID and overheat protection stay on the safe side
+    float maxValid = 0.0f;
+    for (int i=0;i<channels;i++) {
+        float temp = m_tmp451.get_filtered_temperature(i);
         if (!isnan(temp)) {
-            setChipTemp(i, temp);
+            maxValid = std::max(maxValid, temp);
+        }
+    }
+
+    for (int i=0;i<channels;i++) {
+        float temp = m_tmp451.get_filtered_temperature(i);
+        // ESP_LOGI(TAG, "temperature of chip %d: %.3f", i, temp);
+        if (isnan(temp)) {
+            if (m_tmp451.is_stuck(i)) {
+                ESP_LOGE(TAG, "temp sensor of chip %d stuck, using %.2f", i, maxValid);
+            }
+            if (maxValid) {
+                setChipTemp(i, maxValid);
+            }
+            continue;
         }
+        setChipTemp(i, temp);
+    }
+}
+
+bool NerdQX::calibrateTempSensor(int sensor, int point, float reference) {
+    if (!m_hasTMux) {
+        return false;
+    }
+    return m_tmp451.calibrate(sensor, point, reference);
+}
+
+void NerdQX::resetTempCalibration() {
+    if (m_hasTMux) {
+        m_tmp451.reset_calibration();
     }
 }
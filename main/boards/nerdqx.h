@@ -18,4 +18,7 @@ class NerdQX : public NerdQaxePlus2 {
     NerdQX();
     virtual bool initBoard();
     virtual void requestChipTemps();
+
+    virtual bool calibrateTempSensor(int sensor, int point, float reference);
+    virtual void resetTempCalibration();
 };
\ No newline at end of file
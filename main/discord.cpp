@@ -1,27 +1,37 @@
 #include <cstdlib>
 #include <cstring>
 #include <string>
+#include <strings.h>
 
 #include "connect.h"
 #include "esp_crt_bundle.h"
 #include "esp_http_client.h"
 #include "esp_log.h"
+#include "esp_memory_utils.h"
+#include "esp_timer.h"
 #include "nvs_config.h"
 
 #include "global_state.h"
 #include "macros.h"
+#include "psram_allocator.h"
+#include "task_monitor.h"
 #include "utils.h"
 
 static const char *TAG = "discord";
 
-#define ALERTER_QUEUE_LEN 4
-
-#define DISCORD_TASK_PRIO 5
+// the queue is written to flash at most every 30s, at once if it contains
+// alerts that must survive a reboot (block found, watchdog)
+#define ALERTER_SAVE_INTERVAL_MS (30 * 1000)
 
 #ifndef DIFF_STRING_SIZE
 #define DIFF_STRING_SIZE 12
 #endif
 
+static uint64_t uptime_ms()
+{
+    return esp_timer_get_time() / 1000ull;
+}
+
 Alerter::Alerter() : m_payloadBuffer(nullptr)
 {
     // NOP
@@ -35,26 +45,94 @@ bool Alerter::init()
         return false;
     }
 
-    m_msgQueue = xQueueCreate(ALERTER_QUEUE_LEN, sizeof(alerter_msg_t));
-    if (!m_msgQueue) {
-        ESP_LOGE(TAG, "Failed to create queue");
-        return false;
-    }
-
     loadConfig();
+
+    // alerts that couldn't be delivered before the reboot
+    char *saved = Config::getAlertQueue();
+    if (saved && *saved) {
+        PSRAMAllocator allocator;
+        JsonDocument doc(&allocator);
+        if (!deserializeJson(doc, saved)) {
+            PThreadGuard lock(m_mutex);
+            m_queue.load(doc, uptime_ms());
+            if (m_queue.getNumPending()) {
+                ESP_LOGI(TAG, "%d undelivered alerts restored", m_queue.getNumPending());
+            }
+        }
+    }
+    free(saved);
     return true;
 }
 
 void Alerter::loadConfig()
 {
-    safe_free(m_webhookUrl);
+    webhook_target_t *targets = (webhook_target_t *) CALLOC(ALERT_MAX_TARGETS, sizeof(webhook_target_t));
+    if (!targets) {
+        ESP_LOGE(TAG, "no memory for alert targets");
+        return;
+    }
+    int num = 0;
+
+    // the discord webhook is the first target
+    char *webhook = Config::getDiscordWebhook();
+    if (webhook && *webhook) {
+        targets[num].type = WEBHOOK_DISCORD;
+        strlcpy(targets[num].url, webhook, sizeof(targets[num].url));
+        num++;
+    }
+    free(webhook);
+
+    char *json = Config::getAlertTargets();
+    {
+        PSRAMAllocator allocator;
+        JsonDocument doc(&allocator);
+        if (json && !deserializeJson(doc, json)) {
+            for (JsonObject t : doc.as<JsonArray>()) {
+                webhook_type_t type = AlertQueue::typeFromStr(t["type"] | "");
+                const char *url = t["url"] | "";
+                if (type == WEBHOOK_TYPE_MAX || !*url || num == ALERT_MAX_TARGETS) {
+                    continue;
+                }
+                targets[num].type = type;
+                strlcpy(targets[num].url, url, sizeof(targets[num].url));
+                strlcpy(targets[num].extra, t["extra"] | "", sizeof(targets[num].extra));
+                num++;
+            }
+        }
+    }
+    free(json);
+
+    PThreadGuard lock(m_mutex);
     safe_free(m_host);
 
     m_host = Config::getHostname();
-    m_webhookUrl = Config::getDiscordWebhook();
     m_wdtAlertEnabled = Config::isDiscordWatchdogAlertEnabled();
     m_blockFoundAlertEnabled = Config::isDiscordBlockFoundAlertEnabled();
     m_bestDiffAlertEnabled = Config::isDiscordBestDiffAlertEnabled();
+
+    m_queue.setTargets(targets, num);
+    FREE(targets);
+}
+
+void Alerter::getTargets(JsonArray targets)
+{
+    PThreadGuard lock(m_mutex);
+    for (int i = 0; i < m_queue.getNumTargets(); i++) {
+        const webhook_target_t *t = m_queue.getTarget(i);
+        const alert_target_state_t *s = m_queue.getTargetState(i);
+        JsonObject obj = targets.add<JsonObject>();
+        obj["type"] = AlertQueue::typeToStr(t->type);
+        obj["extra"] = (const char *) t->extra;
+        obj["sent"] = s->sent;
+        obj["failed"] = s->failed;
+        obj["dropped"] = s->dropped;
+    }
+}
+
+int Alerter::getNumPending()
+{
+    PThreadGuard lock(m_mutex);
+    return m_queue.getNumPending();
 }
 
 DiscordAlerter::DiscordAlerter() : Alerter()
@@ -68,73 +146,76 @@ bool DiscordAlerter::init()
     return Alerter::init();
 }
 
-bool DiscordAlerter::httpPost(const char *message)
+static esp_err_t http_event_handler(esp_http_client_event_t *evt)
 {
-    if (m_webhookUrl == nullptr || message == nullptr) {
-        ESP_LOGE(TAG, "Webhook URL or message is null");
-        return false;
+    // Discord and others tell how long to back off on 429
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && !strcasecmp(evt->header_key, "Retry-After")) {
+        uint32_t *retryAfterMs = (uint32_t *) evt->user_data;
+        *retryAfterMs = (uint32_t) (strtod(evt->header_value, nullptr) * 1000.0);
     }
+    return ESP_OK;
+}
 
-    if (!m_payloadBuffer) {
-        ESP_LOGE(TAG, "payload buffer is nullptr");
-        return false;
-    }
-
-    ESP_LOGI(TAG, "discord message: %s", message);
-
-    snprintf(m_payloadBuffer, payloadBufferSize - 1, "{\"content\": \"%s\"}", message);
+int DiscordAlerter::httpPost(const webhook_target_t *target, const char *payload, uint32_t *retryAfterMs)
+{
+    ESP_LOGD(TAG, "%s payload: '%s'", AlertQueue::typeToStr(target->type), payload);
 
-    ESP_LOGD(TAG, "discord payload: '%s'", m_payloadBuffer);
+    *retryAfterMs = 0;
 
     esp_http_client_config_t config = {};
-    config.url = m_webhookUrl;
+    config.url = target->url;
     config.method = HTTP_METHOD_POST;
     config.timeout_ms = 5000;
     config.crt_bundle_attach = esp_crt_bundle_attach;
+    config.event_handler = http_event_handler;
+    config.user_data = retryAfterMs;
 
     esp_http_client_handle_t client = esp_http_client_init(&config);
     if (client == nullptr) {
         ESP_LOGE(TAG, "Failed to init HTTP client");
-        return false;
+        return -1;
     }
 
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
     esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, m_payloadBuffer, strlen(m_payloadBuffer));
+    esp_http_client_set_post_field(client, payload, strlen(payload));
 
     esp_err_t err = esp_http_client_perform(client);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "HTTP POST failed: %s", esp_err_to_name(err));
         esp_http_client_cleanup(client);
-        return false;
+        return -1;
     }
 
     int status = esp_http_client_get_status_code(client);
     esp_http_client_cleanup(client);
 
     if (status >= 200 && status < 300) {
-        ESP_LOGI(TAG, "Discord message sent successfully (HTTP %d)", status);
-        return true;
+        ESP_LOGI(TAG, "%s message sent successfully (HTTP %d)", AlertQueue::typeToStr(target->type), status);
     } else {
-        ESP_LOGE(TAG, "Discord responded with HTTP %d", status);
-        return false;
+        ESP_LOGE(TAG, "%s responded with HTTP %d", AlertQueue::typeToStr(target->type), status);
     }
+    return status;
 }
 
-bool DiscordAlerter::enqueueMessage(const char *message)
+bool DiscordAlerter::enqueueMessage(alert_kind_t kind, const char *message)
 {
-    char ip[20] = {0};
-    connect_get_ip_addr(ip, sizeof(ip));
-    const char *mac = SYSTEM_MODULE.getMacAddress();
-
-    alerter_msg_t msg = {};
+    bool queued;
+    {
+        PThreadGuard lock(m_mutex);
+        queued = m_queue.push(kind, message, is_time_synced() ? now() : 0, uptime_ms());
+    }
 
-    snprintf(msg.message, sizeof(msg.message) - 1, "%s\\n```\\nHostname: %s\\nIP:       %s\\nMAC:      %s\\n```", message,
-             m_host ? m_host : "unknown", ip, mac ? mac : "unknown");
+    if (!queued) {
+        ESP_LOGW(TAG, "no alert target configured");
+        return false;
+    }
 
-    ESP_LOGW(TAG, "enqueued: %s", msg.message);
+    ESP_LOGW(TAG, "enqueued: %s", message);
 
-    return xQueueSend(m_msgQueue, &msg, 0) == pdTRUE;
+    if (m_task) {
+        xTaskNotifyGive(m_task);
+    }
+    return true;
 }
 
 bool DiscordAlerter::sendWatchdogAlert()
@@ -144,7 +225,7 @@ bool DiscordAlerter::sendWatchdogAlert()
         return false;
     }
 
-    return enqueueMessage("Device rebooted because there was no share for more than 1h!");
+    return enqueueMessage(ALERT_WATCHDOG, "Device rebooted because there was no share for more than 1h!");
 }
 
 bool DiscordAlerter::sendBlockFoundAlert(double diff, double networkDiff)
@@ -159,10 +240,10 @@ bool DiscordAlerter::sendBlockFoundAlert(double diff, double networkDiff)
     suffixString((uint64_t) diff, diffStr, DIFF_STRING_SIZE, 0);
     suffixString((uint64_t) networkDiff, netStr, DIFF_STRING_SIZE, 0);
 
-    char base[192];
-    snprintf(base, sizeof(base) - 1, ":tada: Block found!\\nDiff: %s (network: %s)", diffStr, netStr);
+    char base[ALERT_MESSAGE_LEN];
+    snprintf(base, sizeof(base), "Block found!\nDiff: %s (network: %s)", diffStr, netStr);
 
-    return enqueueMessage(base);
+    return enqueueMessage(ALERT_BLOCK_FOUND, base);
 }
 
 bool DiscordAlerter::sendBestDifficultyAlert(double diff, double networkDiff)
@@ -177,18 +258,55 @@ bool DiscordAlerter::sendBestDifficultyAlert(double diff, double networkDiff)
     suffixString((uint64_t) diff, bestStr, DIFF_STRING_SIZE, 0);
     suffixString((uint64_t) networkDiff, netStr, DIFF_STRING_SIZE, 0);
 
-    char base[160];
-    snprintf(base, sizeof(base) - 1,
-             ":chart_with_upwards_trend: New *best difficulty* found!\\n"
-             "Diff: %s (network: %s)",
-             bestStr, netStr);
+    char base[ALERT_MESSAGE_LEN];
+    snprintf(base, sizeof(base), "New best difficulty found!\nDiff: %s (network: %s)", bestStr, netStr);
 
-    return enqueueMessage(base);
+    return enqueueMessage(ALERT_BEST_DIFF, base);
 }
 
 bool DiscordAlerter::sendTestMessage()
 {
-    return enqueueMessage("This is a test message!");
+    return enqueueMessage(ALERT_TEST, "This is a test message!");
+}
+
+void DiscordAlerter::saveQueue(bool force)
+{
+    // the cache and the PSRAM are off while the flash is written, the
+    // flash driver aborts if the calling task's stack is in PSRAM. The queue
+    // stays in RAM then.
+    uint8_t stackProbe;
+    if (esp_ptr_external_ram(&stackProbe)) {
+        static bool warned = false;
+        if (!warned) {
+            ESP_LOGE(TAG, "alerter task has a PSRAM stack, queue not saved");
+            warned = true;
+        }
+        return;
+    }
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+    {
+        PThreadGuard lock(m_mutex);
+        if (!m_queue.isDirty()) {
+            return;
+        }
+        force |= m_queue.hasPending(ALERT_BLOCK_FOUND) || m_queue.hasPending(ALERT_WATCHDOG);
+        if (!force && uptime_ms() - m_lastSaveMs < ALERTER_SAVE_INTERVAL_MS) {
+            return;
+        }
+        if (m_queue.getNumPending()) {
+            m_queue.save(doc);
+        }
+        m_queue.clearDirty();
+        m_lastSaveMs = uptime_ms();
+    }
+
+    std::string json;
+    if (!doc.isNull()) {
+        serializeJson(doc, json);
+    }
+    Config::setAlertQueue(json.c_str());
 }
 
 void DiscordAlerter::taskWrapper(void *pv) {
@@ -199,11 +317,60 @@ void DiscordAlerter::taskWrapper(void *pv) {
 void DiscordAlerter::task() {
     ESP_LOGI(TAG, "Discord alerter started");
 
-    alerter_msg_t msg;
+    char ip[20];
+    char host[64];
+    const char *mac = SYSTEM_MODULE.getMacAddress();
+
     while (1) {
-        if (xQueueReceive(m_msgQueue, &msg, portMAX_DELAY) == pdTRUE) {
-            httpPost(msg.message);
+        alert_batch_t batch;
+        webhook_target_t target;
+        size_t len = 0;
+        bool due;
+        {
+            PThreadGuard lock(m_mutex);
+            due = m_queue.nextBatch(uptime_ms(), &batch);
+            if (due) {
+                target = *m_queue.getTarget(batch.target);
+
+                ip[0] = 0;
+                connect_get_ip_addr(ip, sizeof(ip));
+                strlcpy(host, m_host ? m_host : "unknown", sizeof(host));
+                alert_host_t info = {host, ip, mac ? mac : "unknown"};
+                len = m_queue.buildPayload(&batch, &info, m_payloadBuffer, payloadBufferSize);
+            }
+        }
+
+        if (due) {
+            uint32_t retryAfterMs = 0;
+            int status;
+            if (len) {
+                status = httpPost(&target, m_payloadBuffer, &retryAfterMs);
+            } else {
+                ESP_LOGE(TAG, "alert payload too large, dropped");
+                status = 400;
+            }
+
+            PThreadGuard lock(m_mutex);
+            m_queue.complete(&batch, status, retryAfterMs, uptime_ms());
+        }
+
+        saveQueue(false);
+
+        if (due) {
+            continue;
         }
+
+        // sleep until the next target is due or a new alert arrives
+        int64_t wait;
+        {
+            PThreadGuard lock(m_mutex);
+            wait = m_queue.nextDueInMs(uptime_ms());
+        }
+        if (wait < 0 || wait > ALERTER_SAVE_INTERVAL_MS) {
+            // wake up for the deferred save
+            wait = ALERTER_SAVE_INTERVAL_MS;
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait) + 1);
     }
 }
 
@@ -214,7 +381,7 @@ void DiscordAlerter::start()
         return;
     }
 
-    xTaskCreatePSRAM(DiscordAlerter::taskWrapper, "discord_task", 8192, (void*) this, DISCORD_TASK_PRIO, NULL);
+    task_create(TASK_ALERTER, DiscordAlerter::taskWrapper, (void*) this, &m_task);
 
     ESP_LOGI(TAG, "Discord task started");
-}
\ No newline at end of file
+}
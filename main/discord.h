@@ -1,20 +1,24 @@
 #pragma once
 
-#define ALERTER_MESSAGE_LEN 256
+#include <pthread.h>
 
-typedef struct {
-    char message[ALERTER_MESSAGE_LEN];
-} alerter_msg_t;
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "ArduinoJson.h"
+#include "alert_queue.h"
 
 class Alerter {
   protected:
-    static constexpr uint32_t payloadBufferSize = 768;
+    static constexpr uint32_t payloadBufferSize = 1536;
 
     char* m_payloadBuffer = nullptr;
 
-    QueueHandle_t m_msgQueue = nullptr;
+    AlertQueue m_queue;
+    pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+    TaskHandle_t m_task = nullptr;
+    uint64_t m_lastSaveMs = 0;
 
-    char *m_webhookUrl = nullptr;
     char *m_host = nullptr;
     bool m_wdtAlertEnabled = false;
     bool m_blockFoundAlertEnabled = false;
@@ -22,8 +26,9 @@ class Alerter {
 
     virtual bool init();
 
-    virtual bool httpPost(const char* message) = 0;
-    virtual bool enqueueMessage(const char *message) = 0;
+    // returns the HTTP status, -1 on transport errors
+    virtual int httpPost(const webhook_target_t *target, const char *payload, uint32_t *retryAfterMs) = 0;
+    virtual bool enqueueMessage(alert_kind_t kind, const char *message) = 0;
   public:
     Alerter();
     virtual void start() = 0;
@@ -33,8 +38,13 @@ class Alerter {
     virtual bool sendBlockFoundAlert(double diff, double networkDiff) = 0;
     virtual bool sendBestDifficultyAlert(double diff, double networkDiff) = 0;
 
+    // configured targets (without URLs) and their delivery counters
+    void getTargets(JsonArray targets);
+    int getNumPending();
 };
 
+// Webhook alerter. Discord is the original target, Telegram, ntfy and
+// generic JSON webhooks can be added (see AlertQueue)
 class DiscordAlerter : public Alerter {
   protected:
 
@@ -42,9 +52,12 @@ class DiscordAlerter : public Alerter {
 
     static void taskWrapper(void *pv);
     void task();
+    // writes the NVS, TaskPlan::writesFlash() keeps the stack internal,
+    // skipped anyway if a board plan put it in PSRAM
+    void saveQueue(bool force);
 
-    virtual bool httpPost(const char* message);
-    virtual bool enqueueMessage(const char *message);
+    virtual int httpPost(const webhook_target_t *target, const char *payload, uint32_t *retryAfterMs);
+    virtual bool enqueueMessage(alert_kind_t kind, const char *message);
   public:
     DiscordAlerter();
 
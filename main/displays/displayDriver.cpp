@@ -21,6 +21,7 @@
 #include "system.h"
 #include "macros.h"
 #include "button.h"
+#include "task_monitor.h"
 
 #include "nvs_config.h"
 #include "displayDriver.h"
@@ -665,7 +666,7 @@ void DisplayDriver::enableLvglAnimations(bool enable)
 
 void DisplayDriver::mainCreatSysteTasks(void)
 {
-    xTaskCreatePinnedToCore(lvglTimerTaskWrapper, "lvgl Timer", 6000, (void*) this, 4, NULL, 1); // Antes 10000
+    task_create(TASK_LVGL, lvglTimerTaskWrapper, (void*) this);
 }
 
 lv_obj_t *DisplayDriver::initTDisplayS3(void)
@@ -813,14 +814,11 @@ void DisplayDriver::updateHashrate(System *module, StratumManager* manager, floa
     lv_label_set_text(m_ui->ui_lbHashrate, strData);    // Update hashrate
 
     // let it toggle on the pool view page
-    if (manager->isDualPool()) {
-        auto *m = static_cast<StratumManagerDualPool*>(manager);
-        float activeHashrate = m->getActivePoolHashrate(pool);
+    if (manager->isMultiPool()) {
+        float activeHashrate = manager->getActivePoolHashrate(pool);
         formatHashrate(strDataActive, sizeof(strDataActive), activeHashrate);
         lv_label_set_text(m_ui->ui_lbHashrateSet, strDataActive); // Update hashrate
-    }
-
-    if (manager->isFallback()) {
+    } else {
         lv_label_set_text(m_ui->ui_lbHashrateSet, strData); // Update hashrate
     }
 
@@ -837,17 +835,12 @@ void DisplayDriver::updateShares(StratumManager *manager, int pool)
 {
     char strData[20];
 
-    if (manager->isDualPool()) {
-        auto *manager = static_cast<StratumManagerDualPool*>(STRATUM_MANAGER);
+    if (manager->isMultiPool()) {
         snprintf(strData, sizeof(strData), "%lld/%lld", manager->getSharesAccepted(pool), manager->getSharesRejected(pool));
-        lv_label_set_text(m_ui->ui_lbShares, strData); // Update shares
-    }
-
-    if (manager->isFallback()) {
-        auto *manager = static_cast<StratumManagerFallback*>(STRATUM_MANAGER);
+    } else {
         snprintf(strData, sizeof(strData), "%lld/%lld", manager->getSharesAccepted(), manager->getSharesRejected());
-        lv_label_set_text(m_ui->ui_lbShares, strData); // Update shares
     }
+    lv_label_set_text(m_ui->ui_lbShares, strData); // Update shares
 
     lv_label_set_text(m_ui->ui_lbBestDifficulty, manager->getBestDiffString());    // Update Bestdifficulty
     lv_label_set_text(m_ui->ui_lbBestDifficultySet, manager->getBestDiffString()); // Update Bestdifficulty
@@ -879,23 +872,16 @@ void DisplayDriver::updateCurrentSettings(int pool)
 
     Board *board = SYSTEM_MODULE.getBoard();
 
-    if (STRATUM_MANAGER->isDualPool()) {
-        auto *manager = static_cast<StratumManagerDualPool*>(STRATUM_MANAGER);
-        snprintf(strData, sizeof(strData), "%s", manager->getPoolHost(pool));
-        lv_label_set_text(m_ui->ui_lbPoolSet, strData); // Update label
-        snprintf(strData, sizeof(strData), "%d", manager->getPoolPort(pool));
-        lv_label_set_text(m_ui->ui_lbPortSet, strData); // Update label
+    // pool is the selected one in the single pool modes
+    snprintf(strData, sizeof(strData), "%s", STRATUM_MANAGER->getPoolHost(pool));
+    lv_label_set_text(m_ui->ui_lbPoolSet, strData); // Update label
+    snprintf(strData, sizeof(strData), "%d", STRATUM_MANAGER->getPoolPort(pool));
+    lv_label_set_text(m_ui->ui_lbPortSet, strData); // Update label
+    if (STRATUM_MANAGER->isMultiPool()) {
         snprintf(strData, sizeof(strData), "%d", pool + 1);
         lv_label_set_text(m_ui->ui_lbPoolNr, strData);
     }
 
-    if (STRATUM_MANAGER->isFallback()) {
-        auto *manager = static_cast<StratumManagerFallback*>(STRATUM_MANAGER);
-        lv_label_set_text(m_ui->ui_lbPoolSet, manager->getCurrentPoolHost()); // Update label
-        snprintf(strData, sizeof(strData), "%d", manager->getCurrentPoolPort());
-        lv_label_set_text(m_ui->ui_lbPortSet, strData); // Update label
-    }
-
     snprintf(strData, sizeof(strData), "%d", board->getAsicFrequency());
     lv_label_set_text(m_ui->ui_lbFreqSet, strData); // Update label
 
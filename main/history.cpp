@@ -10,6 +10,7 @@
 
 #include "global_state.h"
 #include "history.h"
+#include "json_stream.h"
 #include "macros.h"
 
 #pragma GCC diagnostic error "-Wall"
@@ -342,20 +343,58 @@ int History::searchNearestTimestamp(int64_t timestamp)
     return current;
 }
 
+void History::setUtcOffset(int64_t utcOffsetMs, int64_t stepMs)
+{
+    lock();
+    m_utcOffsetMs = utcOffsetMs;
+    m_utcOffsetValid = true;
+    unlock();
+
+    // the averages use the monotonic timestamps and aren't affected
+    if (stepMs) {
+        ESP_LOGI(TAG, "clock stepped by %lld ms, history rebased", stepMs);
+    }
+}
+
 // Helper: fills a JsonObject with history data using ArduinoJson
-void History::exportHistoryData(JsonObject &json_history, uint64_t start_timestamp, uint64_t end_timestamp,
-                                uint64_t current_timestamp, uint32_t limit)
+// samples are copied so the lock isn't held while sending
+typedef struct
+{
+    int32_t hashrate1m;
+    int32_t hashrate10m;
+    int32_t hashrate1h;
+    int32_t hashrate1d;
+    int32_t vregTemp;
+    int32_t asicTemp;
+    int64_t timestamp;
+} history_export_t;
+
+void History::exportHistoryData(JsonStream &json, uint64_t start_timestamp, uint64_t end_timestamp, uint64_t current_timestamp,
+                                uint32_t limit)
 {
+    history_export_t *samples = nullptr;
+    int count = 0;
+    bool hasMore = false;
+
     // Ensure consistency
     lock();
 
-    int64_t rel_start = (int64_t) start_timestamp - (int64_t) current_timestamp;
-    int64_t rel_end = (int64_t) end_timestamp - (int64_t) current_timestamp;
+    int64_t sys_start;
+    int64_t sys_end;
+
+    if (!current_timestamp && m_utcOffsetValid) {
+        // no client time, the range is UTC
+        sys_start = (int64_t) start_timestamp - m_utcOffsetMs;
+        sys_end = (int64_t) end_timestamp - m_utcOffsetMs;
+    } else {
+        int64_t rel_start = (int64_t) start_timestamp - (int64_t) current_timestamp;
+        int64_t rel_end = (int64_t) end_timestamp - (int64_t) current_timestamp;
 
-    // Get current system timestamp (in ms)
-    uint64_t sys_timestamp = esp_timer_get_time() / 1000ULL;
-    int64_t sys_start = (int64_t) sys_timestamp + rel_start;
-    int64_t sys_end = (int64_t) sys_timestamp + rel_end;
+        // Get current system timestamp (in ms)
+        uint64_t sys_timestamp = esp_timer_get_time() / 1000ULL;
+        sys_start = (int64_t) sys_timestamp + rel_start;
+        sys_end = (int64_t) sys_timestamp + rel_end;
+    }
 
     int start_index = searchNearestTimestamp(sys_start);
     int end_index = searchNearestTimestamp(sys_end);
@@ -367,18 +406,16 @@ void History::exportHistoryData(JsonObject &json_history, uint64_t start_timesta
         num_samples = 0;
     }
 
-    // Create arrays for history samples using the new method
-    JsonArray hashrate_1m = json_history["hashrate_1m"].to<JsonArray>();
-    JsonArray hashrate_10m = json_history["hashrate_10m"].to<JsonArray>();
-    JsonArray hashrate_1h = json_history["hashrate_1h"].to<JsonArray>();
-    JsonArray hashrate_1d = json_history["hashrate_1d"].to<JsonArray>();
-    JsonArray timestamps = json_history["timestamps"].to<JsonArray>();
-    JsonArray vregTemps = json_history["vregTemp"].to<JsonArray>();
-    JsonArray asicTemps = json_history["asicTemp"].to<JsonArray>();
+    if (num_samples) {
+        samples = (history_export_t *) MALLOC(sizeof(history_export_t) * ((limit && limit < (uint32_t) num_samples) ? limit : num_samples));
+        if (!samples) {
+            ESP_LOGE(TAG, "no memory for history export");
+            num_samples = 0;
+        }
+    }
 
     int64_t lastTimestamp = 0;
     int left = limit;
-    bool hasMore = false;
     for (int i = start_index; i < start_index + num_samples; i++) {
         if (limit && left == 0) {
             ESP_LOGW(TAG, "history response limited to %lu points. Last timestamp %lld", limit, lastTimestamp);
@@ -390,20 +427,59 @@ void History::exportHistoryData(JsonObject &json_history, uint64_t start_timesta
         if ((int64_t) sample_timestamp < sys_start) {
             continue;
         }
-        hashrate_1m.add((int) (getHashrate1mSample(i) * 100.0f));
-        hashrate_10m.add((int) (getHashrate10mSample(i) * 100.0f));
-        hashrate_1h.add((int) (getHashrate1hSample(i) * 100.0f));
-        hashrate_1d.add((int) (getHashrate1dSample(i) * 100.0f));
-        vregTemps.add((int) (getVregTempSample(i) * 100.0f));
-        asicTemps.add((int) (getAsicTempSample(i) * 100.0f));
-        timestamps.add((int64_t) sample_timestamp - sys_start);
+        history_export_t *sample = &samples[count++];
+        sample->hashrate1m = (int) (getHashrate1mSample(i) * 100.0f);
+        sample->hashrate10m = (int) (getHashrate10mSample(i) * 100.0f);
+        sample->hashrate1h = (int) (getHashrate1hSample(i) * 100.0f);
+        sample->hashrate1d = (int) (getHashrate1dSample(i) * 100.0f);
+        sample->vregTemp = (int) (getVregTempSample(i) * 100.0f);
+        sample->asicTemp = (int) (getAsicTempSample(i) * 100.0f);
+        sample->timestamp = (int64_t) sample_timestamp - sys_start;
         left--;
         lastTimestamp = sample_timestamp;
     }
 
+    unlock();
+
+    // same order as the arrays were created in the JsonDocument
+    static const char *keys[] = {"hashrate_1m", "hashrate_10m", "hashrate_1h", "hashrate_1d", "timestamps", "vregTemp", "asicTemp"};
+
+    json.beginObject("history");
+    for (int k = 0; k < 7; k++) {
+        json.beginArray(keys[k]);
+        for (int i = 0; i < count; i++) {
+            const history_export_t *sample = &samples[i];
+            switch (k) {
+            case 0:
+                json.item(sample->hashrate1m);
+                break;
+            case 1:
+                json.item(sample->hashrate10m);
+                break;
+            case 2:
+                json.item(sample->hashrate1h);
+                break;
+            case 3:
+                json.item(sample->hashrate1d);
+                break;
+            case 4:
+                json.item(sample->timestamp);
+                break;
+            case 5:
+                json.item(sample->vregTemp);
+                break;
+            case 6:
+                json.item(sample->asicTemp);
+                break;
+            }
+        }
+        json.endArray();
+    }
+
     // Add base timestamp for reference
-    json_history["timestampBase"] = start_timestamp;
-    json_history["hasMore"] = hasMore;
+    json.add("timestampBase", start_timestamp);
+    json.add("hasMore", hasMore);
+    json.endObject();
 
-    unlock();
+    FREE(samples);
 }
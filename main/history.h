@@ -15,6 +15,7 @@
 #define HISTORY_MAX_SAMPLES NEXT_POWER_OF_TWO(HISTORY_RAW)
 
 class History;
+class JsonStream;
 
 class NonceDistribution {
   protected:
@@ -77,6 +78,10 @@ class History {
 
     pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+    // samples are timestamped with esp_timer (ms), UTC = timestamp + offset
+    int64_t m_utcOffsetMs = 0;
+    bool m_utcOffsetValid = false;
+
     HistoryAvg m_avg1m;   // 1-minute average for real-time monitoring
     HistoryAvg m_avg10m;
     HistoryAvg m_avg1h;
@@ -109,7 +114,12 @@ class History {
     uint32_t getRateSample(int index);
     int searchNearestTimestamp(int64_t timestamp);
 
-    void exportHistoryData(JsonObject &json_history, uint64_t start_timestamp, uint64_t end_timestamp, uint64_t current_timestamp, uint32_t limit);
+    // called by the time service after each sync, rebases the UTC view
+    void setUtcOffset(int64_t utcOffsetMs, int64_t stepMs);
+
+    // writes the "history" object, samples between start and end timestamp
+    // (client time, UTC if current_timestamp is 0)
+    void exportHistoryData(JsonStream &json, uint64_t start_timestamp, uint64_t end_timestamp, uint64_t current_timestamp, uint32_t limit);
 
     int getNumSamples()
     {
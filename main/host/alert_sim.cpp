@@ -0,0 +1,233 @@
+// Host test of AlertQueue against host/mock_webhook.py.
+//
+//   c++ -O2 -std=gnu++17 -I.. -I../../components/arduinojson -o alert_sim alert_sim.cpp ../alert_queue.cpp
+//   python3 mock_webhook.py --port 8099 --fail-rate 0.3 --latency 100 --limit 4 --retry-after 0.5 --down 2 &
+//   ./alert_sim 8099
+//
+// Sends a burst of best difficulty, watchdog and block found alerts to one
+// target of each type with a time scaled policy, "reboots" halfway through
+// by saving and restoring the queue, and checks what the mock received:
+// every found block and the last best difficulty on every target, no
+// invalid payloads and no request before a Retry-After ran out.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "alert_queue.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                         \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__);                                                                          \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+static uint64_t now_ms()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (uint64_t) tv.tv_sec * 1000ull + tv.tv_usec / 1000;
+}
+
+// minimal HTTP/1.1 client, returns the status (-1 on errors)
+static int http_request(int port, const char *method, const char *path, const char *body, uint32_t *retryAfterMs,
+                        std::string *response = nullptr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    struct timeval tv = {2, 0}; // like the 5s of the firmware, scaled
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr))) {
+        close(fd);
+        return -1;
+    }
+
+    char header[256];
+    size_t len = body ? strlen(body) : 0;
+    snprintf(header, sizeof(header),
+             "%s %s HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/json\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+             method, path, len);
+    std::string req = std::string(header) + (body ? body : "");
+    if (write(fd, req.data(), req.size()) != (ssize_t) req.size()) {
+        close(fd);
+        return -1;
+    }
+
+    std::string resp;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        resp.append(buf, n);
+    }
+    close(fd);
+
+    int status = -1;
+    if (sscanf(resp.c_str(), "HTTP/1.%*d %d", &status) != 1) {
+        return -1;
+    }
+    if (retryAfterMs) {
+        *retryAfterMs = 0;
+        const char *ra = strcasestr(resp.c_str(), "\r\nRetry-After:");
+        if (ra) {
+            *retryAfterMs = (uint32_t) (strtod(ra + 14, nullptr) * 1000.0);
+        }
+    }
+    if (response) {
+        size_t p = resp.find("\r\n\r\n");
+        *response = (p == std::string::npos) ? "" : resp.substr(p + 4);
+    }
+    return status;
+}
+
+static const alert_policy_t policy = {
+    .rateBurst = 3,
+    .rateIntervalMs = 200,
+    .retryBaseMs = 50,
+    .retryMaxMs = 2000,
+    .maxAgeMs = 60 * 1000,
+};
+
+static int port;
+static uint32_t requests = 0;
+static const alert_host_t host = {"nerdqaxe-sim", "192.168.1.50", "aa:bb:cc:dd:ee:ff"};
+
+static const char *target_paths[ALERT_MAX_TARGETS];
+
+// one iteration of the alerter task
+static void process(AlertQueue &q)
+{
+    alert_batch_t batch;
+    char payload[1536];
+    while (q.nextBatch(now_ms(), &batch)) {
+        size_t len = q.buildPayload(&batch, &host, payload, sizeof(payload));
+        CHECK(len, "payload doesn't fit");
+        uint32_t retryAfter = 0;
+        int status = http_request(port, "POST", target_paths[batch.target], payload, &retryAfter);
+        requests++;
+        q.complete(&batch, status, retryAfter, now_ms());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    port = (argc > 1) ? atoi(argv[1]) : 8099;
+    if (http_request(port, "POST", "/reset", "", nullptr) != 200) {
+        printf("mock webhook not running on port %d\n", port);
+        return 2;
+    }
+
+    webhook_target_t targets[ALERT_MAX_TARGETS] = {};
+    const webhook_type_t types[ALERT_MAX_TARGETS] = {WEBHOOK_DISCORD, WEBHOOK_TELEGRAM, WEBHOOK_NTFY, WEBHOOK_GENERIC};
+    for (int i = 0; i < ALERT_MAX_TARGETS; i++) {
+        targets[i].type = types[i];
+        snprintf(targets[i].url, sizeof(targets[i].url), "http://127.0.0.1:%d/%s", port, AlertQueue::typeToStr(types[i]));
+        snprintf(targets[i].extra, sizeof(targets[i].extra), "%s", (i == 1) ? "-100123" : "miner");
+        target_paths[i] = strstr(strstr(targets[i].url, "//") + 2, "/");
+    }
+
+    AlertQueue *q = new AlertQueue(&policy);
+    q->setTargets(targets, ALERT_MAX_TARGETS);
+
+    // burst: best diff streak, watchdog loop, three blocks, over ~3s
+    int pushed = 0;
+    char msg[ALERT_MESSAGE_LEN];
+    uint64_t start = now_ms();
+    int best = 0;
+    for (int step = 0; step < 60; step++) {
+        if (step % 2 == 0) {
+            snprintf(msg, sizeof(msg), "New best difficulty found!\nDiff: %dM (network: 126T)", ++best);
+            q->push(ALERT_BEST_DIFF, msg, 1760000000 + step, now_ms());
+            pushed++;
+        }
+        if (step % 12 == 5) {
+            q->push(ALERT_WATCHDOG, "Device rebooted because there was no share for more than 1h!", 0, now_ms());
+            pushed++;
+        }
+        if (step == 10 || step == 11 || step == 40) {
+            snprintf(msg, sizeof(msg), "Block found!\nDiff: %dT (network: 126T) #%d", 130 + step, step);
+            q->push(ALERT_BLOCK_FOUND, msg, 1760000000 + step, now_ms());
+            pushed++;
+        }
+        if (step == 30) {
+            // reboot: the pending alerts survive
+            JsonDocument doc;
+            q->save(doc);
+            std::string saved;
+            serializeJson(doc, saved);
+            printf("reboot with %d pending alerts (%zu bytes saved)\n", q->getNumPending(), saved.size());
+            delete q;
+
+            q = new AlertQueue(&policy);
+            q->setTargets(targets, ALERT_MAX_TARGETS);
+            JsonDocument restored;
+            CHECK(!deserializeJson(restored, saved), "saved queue isn't JSON");
+            CHECK(q->load(restored, now_ms()), "queue not restored");
+        }
+        process(*q);
+        usleep(50 * 1000);
+    }
+
+    // drain
+    while (q->getNumPending() && now_ms() - start < 60000) {
+        process(*q);
+        int64_t due = q->nextDueInMs(now_ms());
+        usleep((useconds_t) ((due > 0 && due < 200) ? due : 20) * 1000);
+    }
+
+    printf("%d alerts pushed, %u coalesced, %u requests, %.1fs, %d still pending\n", pushed, q->getCoalesced(), requests,
+           (now_ms() - start) / 1000.0, q->getNumPending());
+    CHECK(!q->getNumPending(), "alerts left in the queue");
+    CHECK(!q->getDropped(), "%u alerts dropped", q->getDropped());
+
+    std::string body;
+    CHECK(http_request(port, "GET", "/stats", nullptr, nullptr, &body) == 200, "no stats");
+    JsonDocument stats;
+    CHECK(!deserializeJson(stats, body), "stats aren't JSON");
+
+    snprintf(msg, sizeof(msg), "Diff: %dM", best);
+    for (int i = 0; i < ALERT_MAX_TARGETS; i++) {
+        const char *type = AlertQueue::typeToStr(types[i]);
+        JsonObject s = stats[type];
+        static const char *block_tags[] = {"#10", "#11", "#40"};
+        int blocks = 0;
+        for (const char *tag : block_tags) {
+            bool found = false;
+            for (const char *m : s["messages"].as<JsonArray>()) {
+                found |= strstr(m, tag) != nullptr;
+            }
+            blocks += found;
+        }
+        bool lastBest = false;
+        for (const char *m : s["messages"].as<JsonArray>()) {
+            lastBest |= strstr(m, msg) != nullptr;
+        }
+        const alert_target_state_t *st = q->getTargetState(i);
+        printf("  %-8s requests %d ok %d failed %d limited %d early %d invalid %d, sent %lu alerts\n", type,
+               s["requests"].as<int>(), s["ok"].as<int>(), s["failed"].as<int>(), s["limited"].as<int>(), s["early"].as<int>(),
+               s["invalid"].as<int>(), (unsigned long) st->sent);
+        CHECK(blocks == 3, "%s: %d of 3 blocks", type, blocks);
+        CHECK(lastBest, "%s: last best difficulty missing", type);
+        CHECK(s["invalid"].as<int>() == 0, "%s: invalid payloads", type);
+        CHECK(s["early"].as<int>() == 0, "%s: Retry-After not honored", type);
+    }
+    delete q;
+
+    printf(failures ? "%d check(s) failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,1063 @@
+// Linux replay of a traffic capture (GET /api/capture) through the host
+// buildable parts of the mining path.
+//
+//   c++ -O2 -std=gnu++17 -Istubs -I.. -I../stratum -I../tasks -I../../components/bm1397/include \
+//       -I../../components/arduinojson -o capture_replay capture_replay.cpp ../../components/bm1397/capture.cpp \
+//       ../../components/bm1397/crc.cpp ../../components/bm1397/mining.cpp ../../components/bm1397/mining_utils.cpp \
+//       ../stratum/mining_notify.cpp ../stratum/notify_pool.cpp ../tasks/extranonce2.cpp ../tasks/job_slots.cpp \
+//       -lcrypto -lpthread
+//   ./capture_replay                     # self-check on a synthetic capture
+//   ./capture_replay capture.bin [--asic bm1366|bm1368|bm1370] [--speed 1] [--asic-diff 256]
+//
+// The records are fed in order, by default as fast as possible, with
+// --speed at the recorded pace (1 = real time, 10 = ten times faster):
+//
+// - stratum-rx: lines are reassembled and parsed with ArduinoJson like
+//   StratumApi::parseMethods, mining.notify goes into a NotifyPool block and
+//   starts a job of the Extranonce2Allocator like create_job_mining_notify
+// - uart-tx: a job packet is where create_jobs_task made a job. It is made
+//   again (Extranonce2Allocator::next, create_bm_job) and compared with the
+//   merkle root sent to the ASICs, the job from the packet goes into
+//   AsicJobs. A ticket mask write sets the ASIC difficulty
+// - uart-rx: results are resynced on the preamble and verified like
+//   ASIC_result_task, test_nonce_value against the job in the slot and the
+//   one before, AsicJobs::classify
+// - stratum-tx: mining.submit is matched to its result and its response
+//
+// Per record type it reports the CPU time, the processing time percentiles
+// and the heap allocations (malloc is counted). From the recorded
+// timestamps it reports the latencies of the device: notify -> first job,
+// result -> submit, submit -> response.
+//
+// The loops of the FreeRTOS tasks, StratumManager and the transports need
+// ESP-IDF and are not built, the replay calls the modules they use.
+//
+// Without a file a synthetic capture is recorded with the firmware recorder
+// (capture.cpp): 60 s, a notify every 15 s, a job every 100 ms with 2
+// results found on the host, one in 50 delivered after its slot was
+// reused, 1% hardware errors, register replies, partial reads and submits.
+// The replay has to reproduce every job, classify every result as
+// generated and find the latencies, the pool password must not be in the
+// capture. A second capture into a 16 KB ring drops its oldest records.
+//
+// Result on a x86 Linux box (synthetic capture, as fast as possible):
+//   type         records    bytes   cpu ms   p50 us   p99 us   max us  allocs/record
+//   stratum-rx       131     9785     0.34     2.29    22.17    25.39   10.22
+//   uart-tx          603    52987     6.25    10.64    12.97    85.58    3.00
+//   uart-rx         1397    13398     1.33     1.39     2.34    34.03    3.50
+//   (stratum-rx: the JSON document of every line, uart-tx: the job from
+//   create_bm_job with its two strings, uart-rx: AsicJobs clones the job
+//   and its strings for every lookup)
+//   jobs 602 (602 reproduced), results: current 1180, late 12, invalid 12
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ArduinoJson.h"
+
+#include "capture.h"
+#include "crc.h"
+#include "esp_timer.h"
+#include "mining.h"
+#include "mining_utils.h"
+
+#include "asic_jobs.h"
+#include "extranonce2.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                         \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__);                                                                          \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+// heap allocations of the process, the replay takes the difference per record
+static uint64_t s_allocs = 0;
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    s_allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    s_allocs++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    s_allocs++;
+    return __libc_realloc(ptr, size);
+}
+}
+
+// packets of asic.cpp
+#define JOB_PACKET_HEADER 0x21 // TYPE_JOB | GROUP_SINGLE | CMD_WRITE
+#define JOB_PACKET_LEN 88      // preamble, header, length, BM1368_job, crc16
+#define CMD_WRITE_ALL 0x51
+#define TICKET_MASK 0x14
+#define RESULT_LEN 11
+
+// offsets in BM1368_job
+#define JOB_NBITS 6
+#define JOB_NTIME 10
+#define JOB_MERKLE_ROOT 14
+#define JOB_PREV_BLOCK_HASH 46
+#define JOB_VERSION 78
+
+// request IDs of StratumApi
+#define ID_SUBSCRIBE 1
+#define ID_CONFIGURE 2
+
+struct AsicModel
+{
+    const char *name;
+    uint8_t (*asicToJobId)(uint8_t id);
+};
+
+static uint8_t bm1366_job_id(uint8_t id)
+{
+    return id & 0xf8;
+}
+
+static uint8_t bm1370_job_id(uint8_t id)
+{
+    return (id & 0xf0) >> 1;
+}
+
+static const AsicModel s_asics[] = {
+    {"bm1366", bm1366_job_id},
+    {"bm1368", bm1370_job_id},
+    {"bm1370", bm1370_job_id},
+};
+
+static uint16_t reverse16(uint16_t v)
+{
+    return (v >> 8) | (v << 8);
+}
+
+static uint8_t reverse_bits(uint8_t v)
+{
+    uint8_t r = 0;
+    for (int i = 0; i < 8; i++) {
+        r = (r << 1) | ((v >> i) & 1);
+    }
+    return r;
+}
+
+static double percentile(std::vector<double> v, double p)
+{
+    if (v.empty()) {
+        return 0.0;
+    }
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t) (p * v.size()))];
+}
+
+static int64_t cpu_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+struct Record
+{
+    int64_t timeUs;
+    uint8_t type;
+    const uint8_t *data;
+    size_t len;
+};
+
+static const char *type_name(int type)
+{
+    static const char *names[] = {"uart-tx", "uart-rx", "stratum-tx", "stratum-rx"};
+    return type < 4 ? names[type] : "?";
+}
+
+// records of a download, false if the file is broken
+static bool decode(const std::vector<uint8_t> &file, capture_file_header_t *hdr, std::vector<Record> *out)
+{
+    if (file.size() < sizeof(*hdr)) {
+        return false;
+    }
+    memcpy(hdr, file.data(), sizeof(*hdr));
+    if (memcmp(hdr->magic, CAPTURE_MAGIC, sizeof(hdr->magic)) || hdr->version != CAPTURE_VERSION) {
+        return false;
+    }
+
+    size_t pos = sizeof(*hdr);
+    int64_t t = hdr->base_time_us;
+    auto varint = [&](uint64_t *v) {
+        *v = 0;
+        for (int shift = 0; pos < file.size() && shift < 64; shift += 7) {
+            uint8_t b = file[pos++];
+            *v |= (uint64_t) (b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    while (pos < file.size()) {
+        uint64_t delta, len;
+        if (!varint(&delta) || pos >= file.size()) {
+            return false;
+        }
+        uint8_t type = file[pos++];
+        if (!varint(&len) || pos + len > file.size()) {
+            return false;
+        }
+        t += delta;
+        out->push_back({t, type, file.data() + pos, (size_t) len});
+        pos += len;
+    }
+    return true;
+}
+
+class Replay {
+  public:
+    struct Options
+    {
+        const AsicModel *asic = &s_asics[2];
+        double speed = 0.0;    // 0 = as fast as possible
+        double asicDiff = 0.0; // 0 = from the ticket mask
+    };
+
+    struct Stage
+    {
+        uint64_t records = 0;
+        uint64_t bytes = 0;
+        uint64_t allocs = 0;
+        int64_t cpuNs = 0;
+        std::vector<double> us;
+    };
+
+    Stage stages[4];
+
+    int notifies = 0;
+    int parseErrors = 0;
+    int jobs = 0;
+    int jobsReproduced = 0;
+    uint32_t maskDiff = 0;
+    int otherTx = 0;
+    uint32_t results[4] = {}; // by job_result_t
+    int registerReplies = 0;
+    int skippedBytes = 0;
+    int submits = 0;
+
+    std::vector<double> notifyToJobMs;
+    std::vector<double> resultToSubmitMs;
+    std::vector<double> submitToResponseMs;
+    std::vector<double> lagMs;
+
+  protected:
+    Options m_opts;
+
+    NotifyPool m_pool;
+    mining_notify *m_notify = nullptr;
+    char *m_enonce1 = nullptr;
+    int m_enonce2Len = 0;
+    uint32_t m_versionMask = 0;
+    uint32_t m_difficulty = 0;
+    uint32_t m_activeDifficulty = 0;
+    Extranonce2Allocator m_enonce2;
+
+    int64_t m_notifyUs = 0;
+    bool m_notifyPending = false;
+
+    AsicJobs m_asicJobs;
+
+    std::string m_rxLines;
+    std::string m_txLines;
+    std::vector<uint8_t> m_uartRx;
+
+    std::unordered_map<uint32_t, int64_t> m_resultUs; // by nonce
+    std::unordered_map<int, int64_t> m_submitUs;      // by request ID
+
+    double asicDiff() const
+    {
+        return m_opts.asicDiff > 0.0 ? m_opts.asicDiff : (double) maskDiff;
+    }
+
+    void notify(JsonDocument &doc, int64_t t)
+    {
+        JsonArray params = doc["params"].as<JsonArray>();
+        JsonArray branches = params[4].as<JsonArray>();
+        if (!params[4].is<JsonArray>() || branches.size() > MAX_MERKLE_BRANCHES) {
+            parseErrors++;
+            return;
+        }
+
+        mining_notify *n = mining_notify_alloc(&m_pool, params[0].as<const char *>(), params[2].as<const char *>(),
+                                               params[3].as<const char *>(), branches.size());
+        if (!n) {
+            parseErrors++;
+            return;
+        }
+        bool ok = mining_notify_hex2bin(params[1].as<const char *>(), n->_prev_block_hash, HASH_SIZE);
+        for (size_t i = 0; ok && i < n->n_merkle_branches; i++) {
+            ok = mining_notify_hex2bin(branches[i].as<const char *>(), n->_merkle_branches[i], HASH_SIZE);
+        }
+        if (!ok) {
+            m_pool.release(n);
+            parseErrors++;
+            return;
+        }
+        n->version = strtoul(params[5].as<const char *>(), NULL, 16);
+        n->target = strtoul(params[6].as<const char *>(), NULL, 16);
+        n->ntime = strtoul(params[7].as<const char *>(), NULL, 16);
+        notifies++;
+
+        // create_job_mining_notify
+        bool clean = params[params.size() - 1].as<bool>();
+        if (clean) {
+            m_asicJobs.cleanJobs(0);
+        }
+        if (m_notify) {
+            m_pool.release(m_notify);
+        }
+        m_notify = n;
+        m_activeDifficulty = m_difficulty;
+        m_notifyUs = t;
+        m_notifyPending = true;
+        m_enonce2.newJob(t, n->ntime, clean);
+    }
+
+    void stratumRxLine(const char *line, size_t len, int64_t t)
+    {
+        JsonDocument doc;
+        if (deserializeJson(doc, line, len)) {
+            parseErrors++;
+            return;
+        }
+
+        const char *method = doc["method"];
+        if (method) {
+            if (!strcmp(method, "mining.notify")) {
+                notify(doc, t);
+            } else if (!strcmp(method, "mining.set_difficulty")) {
+                m_difficulty = doc["params"][0].as<uint32_t>();
+            } else if (!strcmp(method, "mining.set_version_mask")) {
+                m_versionMask = strtoul(doc["params"][0].as<const char *>(), NULL, 16);
+            } else if (!strcmp(method, "mining.set_extranonce") && doc["params"][0].is<const char *>()) {
+                free(m_enonce1);
+                m_enonce1 = strdup(doc["params"][0].as<const char *>());
+                m_enonce2Len = doc["params"][1].as<int>();
+                m_enonce2.setLength(m_enonce2Len);
+            }
+            return;
+        }
+
+        int id = doc["id"] | -1;
+        if (id == ID_SUBSCRIBE && doc["result"][1].is<const char *>()) {
+            free(m_enonce1);
+            m_enonce1 = strdup(doc["result"][1].as<const char *>());
+            m_enonce2Len = doc["result"][2].as<int>();
+            m_enonce2.setLength(m_enonce2Len);
+        } else if (id == ID_CONFIGURE && doc["result"]["version-rolling.mask"].is<const char *>()) {
+            m_versionMask = strtoul(doc["result"]["version-rolling.mask"].as<const char *>(), NULL, 16);
+        } else {
+            auto it = m_submitUs.find(id);
+            if (it != m_submitUs.end()) {
+                submitToResponseMs.push_back((t - it->second) / 1000.0);
+                m_submitUs.erase(it);
+            }
+        }
+    }
+
+    void stratumTxLine(const char *line, size_t len, int64_t t)
+    {
+        JsonDocument doc;
+        if (deserializeJson(doc, line, len) || !doc["method"].is<const char *>() ||
+            strcmp(doc["method"].as<const char *>(), "mining.submit")) {
+            return;
+        }
+        submits++;
+        m_submitUs[doc["id"] | -1] = t;
+
+        uint32_t nonce = strtoul(doc["params"][4] | "", NULL, 16);
+        auto it = m_resultUs.find(nonce);
+        if (it != m_resultUs.end()) {
+            resultToSubmitMs.push_back((t - it->second) / 1000.0);
+            m_resultUs.erase(it);
+        }
+    }
+
+    template <typename F> void lines(std::string &buf, const uint8_t *data, size_t len, F handle)
+    {
+        buf.append((const char *) data, len);
+        size_t start = 0, nl;
+        while ((nl = buf.find('\n', start)) != std::string::npos) {
+            handle(buf.data() + start, nl - start);
+            start = nl + 1;
+        }
+        buf.erase(0, start);
+    }
+
+    void job(const uint8_t *packet, int64_t t)
+    {
+        const uint8_t *j = packet + 4;
+        uint8_t slot = j[0] & 0x7f;
+        jobs++;
+
+        // the job creation, the ntime is rolled after a wrap of the extranonce2
+        bm_job *job = nullptr;
+        uint64_t enonce2;
+        uint32_t ntimeRoll;
+        if (m_notify && m_enonce1 && m_enonce2.next(t, &enonce2, &ntimeRoll)) {
+            char enonce2Str[m_enonce2Len * 2 + 1];
+            snprintf(enonce2Str, sizeof(enonce2Str), "%0*llx", m_enonce2Len * 2, (unsigned long long) enonce2);
+            job = create_bm_job(m_notify, m_enonce1, enonce2Str, m_versionMask);
+            job->ntime += ntimeRoll;
+            job->pool_diff = m_activeDifficulty;
+            job->pool_id = 0;
+            jobsReproduced += !memcmp(job->merkle_root_be, j + JOB_MERKLE_ROOT, 32);
+        } else {
+            job = (bm_job *) calloc(1, sizeof(bm_job));
+            job->jobid = strdup("");
+            job->extranonce2 = strdup("");
+        }
+
+        // verified against what the ASICs got
+        uint8_t tmp[32];
+        memcpy(&job->target, j + JOB_NBITS, 4);
+        memcpy(&job->ntime, j + JOB_NTIME, 4);
+        memcpy(&job->version, j + JOB_VERSION, 4);
+        memcpy(job->merkle_root_be, j + JOB_MERKLE_ROOT, 32);
+        memcpy(tmp, job->merkle_root_be, 32);
+        reverse_bytes(tmp, 32);
+        swap_endian_words_bin(tmp, job->merkle_root, 32);
+        memcpy(job->prev_block_hash_be, j + JOB_PREV_BLOCK_HASH, 32);
+        memcpy(tmp, job->prev_block_hash_be, 32);
+        reverse_bytes(tmp, 32);
+        swap_endian_words_bin(tmp, job->prev_block_hash, 32);
+        job->asic_diff = maskDiff;
+
+        m_asicJobs.storeJob(job, slot, t);
+
+        if (m_notifyPending) {
+            notifyToJobMs.push_back((t - m_notifyUs) / 1000.0);
+            m_notifyPending = false;
+        }
+    }
+
+    void uartTx(const uint8_t *d, size_t len, int64_t t)
+    {
+        if (len == JOB_PACKET_LEN && d[0] == 0x55 && d[1] == 0xaa && d[2] == JOB_PACKET_HEADER) {
+            job(d, t);
+        } else if (len == 11 && d[0] == 0x55 && d[1] == 0xaa && d[2] == CMD_WRITE_ALL && d[5] == TICKET_MASK) {
+            // setJobDifficultyMask, bytes reversed and bit reversed
+            uint32_t mask = 0;
+            for (int i = 0; i < 4; i++) {
+                mask |= (uint32_t) reverse_bits(d[4 + 5 - i]) << (8 * i);
+            }
+            maskDiff = mask + 1;
+        } else {
+            otherTx++;
+        }
+    }
+
+    bool belongs(double nonceDiff)
+    {
+        return nonceDiff >= asicDiff() / 4.0;
+    }
+
+    void result(const uint8_t *f, int64_t t)
+    {
+        uint32_t nonce;
+        uint16_t version;
+        memcpy(&nonce, f + 2, 4);
+        memcpy(&version, f + 8, 2);
+
+        if (!(f[10] & 0x80)) {
+            registerReplies++;
+            return;
+        }
+
+        uint8_t slot = m_opts.asic->asicToJobId(f[7]);
+        if (slot >= MAX_ASIC_JOBS) {
+            results[JOB_RESULT_INVALID]++;
+            return;
+        }
+        uint32_t rolled = (uint32_t) reverse16(version) << 13;
+
+        bm_job *job = m_asicJobs.getClone(slot);
+        double diff = job ? test_nonce_value(job, nonce, rolled | job->version) : 0.0;
+        bool matchCurrent = job && belongs(diff);
+
+        bm_job *prev = matchCurrent ? NULL : m_asicJobs.getPrevClone(slot);
+        double prevDiff = prev ? test_nonce_value(prev, nonce, rolled | prev->version) : 0.0;
+        bool matchPrev = prev && belongs(prevDiff);
+
+        job_result_t kind = m_asicJobs.classify(slot, matchCurrent, matchPrev, prev != NULL, t);
+        results[kind]++;
+        if (kind == JOB_RESULT_CURRENT || kind == JOB_RESULT_LATE) {
+            m_resultUs[nonce] = t;
+        }
+
+        if (job) {
+            free_bm_job(job);
+        }
+        if (prev) {
+            free_bm_job(prev);
+        }
+    }
+
+    void uartRx(const uint8_t *d, size_t len, int64_t t)
+    {
+        m_uartRx.insert(m_uartRx.end(), d, d + len);
+        size_t pos = 0;
+        while (m_uartRx.size() - pos >= RESULT_LEN) {
+            if (m_uartRx[pos] != 0xaa || m_uartRx[pos + 1] != 0x55) {
+                skippedBytes++;
+                pos++;
+                continue;
+            }
+            result(&m_uartRx[pos], t);
+            pos += RESULT_LEN;
+        }
+        m_uartRx.erase(m_uartRx.begin(), m_uartRx.begin() + pos);
+    }
+
+  public:
+    explicit Replay(const Options &opts) : m_opts(opts)
+    {
+        m_pool.init(calloc, free);
+        m_rxLines.reserve(16384);
+        m_txLines.reserve(16384);
+        m_uartRx.reserve(1024);
+    }
+
+    ~Replay()
+    {
+        if (m_notify) {
+            m_pool.release(m_notify);
+        }
+        free(m_enonce1);
+    }
+
+    void run(const std::vector<Record> &records)
+    {
+        if (records.empty()) {
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        int64_t first = records.front().timeUs;
+
+        for (const Record &r : records) {
+            if (m_opts.speed > 0.0) {
+                auto due = start + std::chrono::microseconds((int64_t) ((r.timeUs - first) / m_opts.speed));
+                std::this_thread::sleep_until(due);
+                lagMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - due).count());
+            }
+            host_time_us = r.timeUs;
+
+            auto w0 = std::chrono::steady_clock::now();
+            int64_t c0 = cpu_ns();
+            uint64_t a0 = s_allocs;
+
+            switch (r.type) {
+            case CAPTURE_UART_TX:
+                uartTx(r.data, r.len, r.timeUs);
+                break;
+            case CAPTURE_UART_RX:
+                uartRx(r.data, r.len, r.timeUs);
+                break;
+            case CAPTURE_STRATUM_TX:
+                lines(m_txLines, r.data, r.len, [&](const char *l, size_t n) { stratumTxLine(l, n, r.timeUs); });
+                break;
+            case CAPTURE_STRATUM_RX:
+                lines(m_rxLines, r.data, r.len, [&](const char *l, size_t n) { stratumRxLine(l, n, r.timeUs); });
+                break;
+            default:
+                continue;
+            }
+
+            Stage &s = stages[r.type];
+            s.cpuNs += cpu_ns() - c0;
+            s.allocs += s_allocs - a0;
+            s.us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - w0).count());
+            s.records++;
+            s.bytes += r.len;
+        }
+    }
+
+    void report()
+    {
+        printf("  type         records    bytes   cpu ms   p50 us   p99 us   max us  allocs/record\n");
+        const int order[] = {CAPTURE_STRATUM_RX, CAPTURE_UART_TX, CAPTURE_UART_RX};
+        for (int type : order) {
+            Stage &s = stages[type];
+            printf("  %-10s  %8llu %8llu %8.2f %8.2f %8.2f %8.2f %7.2f\n", type_name(type), (unsigned long long) s.records,
+                   (unsigned long long) s.bytes, s.cpuNs / 1e6, percentile(s.us, 0.5), percentile(s.us, 0.99),
+                   percentile(s.us, 1.0), s.records ? (double) s.allocs / s.records : 0.0);
+        }
+        printf("  stratum-tx  %8llu %8llu (matched only)\n", (unsigned long long) stages[CAPTURE_STRATUM_TX].records,
+               (unsigned long long) stages[CAPTURE_STRATUM_TX].bytes);
+
+        printf("  notifies %d (%d parse errors), jobs %d (%d reproduced), ASIC difficulty %g\n", notifies, parseErrors, jobs,
+               jobsReproduced, asicDiff());
+        printf("  results: current %u, late %u, stale %u, invalid %u, register replies %d, %d bytes skipped, %d submits\n",
+               results[JOB_RESULT_CURRENT], results[JOB_RESULT_LATE], results[JOB_RESULT_STALE], results[JOB_RESULT_INVALID],
+               registerReplies, skippedBytes, submits);
+
+        printf("  device latency ms        p50      p90      p99      max\n");
+        auto row = [](const char *name, const std::vector<double> &v) {
+            printf("  %-20s %8.2f %8.2f %8.2f %8.2f  (%zu)\n", name, percentile(v, 0.5), percentile(v, 0.9), percentile(v, 0.99),
+                   percentile(v, 1.0), v.size());
+        };
+        row("notify -> first job", notifyToJobMs);
+        row("result -> submit", resultToSubmitMs);
+        row("submit -> response", submitToResponseMs);
+        if (!lagMs.empty()) {
+            row("replay lag", lagMs);
+        }
+    }
+};
+
+// synthetic capture ----------------------------------------------------------
+
+struct Event
+{
+    int64_t timeUs;
+    capture_type_t type;
+    std::vector<uint8_t> data;
+};
+
+struct Expected
+{
+    int notifies = 0;
+    int jobs = 0;
+    int current = 0;
+    int late = 0;
+    int hwErrors = 0;
+    int registerReplies = 0;
+    int submits = 0;
+    int skippedBytes = 0;
+};
+
+#define SYN_DURATION_US 60000000LL
+#define SYN_NOTIFY_US 15000000LL
+#define SYN_JOB_US 100000LL
+#define SYN_NONCE_DIFF (1.0 / (1 << 20))   // 4096 tries, a wrong job matches 1 in 4096
+#define SYN_ASIC_DIFF (4 * SYN_NONCE_DIFF) // belongs_to_job takes a quarter
+#define SYN_LATE_US 1750000LL              // after 16 slots at 100 ms
+#define SYN_VERSION_MASK 0x1fffe000
+
+static std::mt19937 rng(11);
+
+static std::string hex(int bytes)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string s;
+    for (int i = 0; i < bytes * 2; i++) {
+        s += digits[rng() & 15];
+    }
+    return s;
+}
+
+static void add(std::vector<Event> &events, int64_t t, capture_type_t type, const std::string &s)
+{
+    events.push_back({t, type, std::vector<uint8_t>(s.begin(), s.end())});
+}
+
+static std::vector<uint8_t> job_packet(const bm_job *job, uint8_t asicId)
+{
+    std::vector<uint8_t> p(JOB_PACKET_LEN);
+    p[0] = 0x55;
+    p[1] = 0xaa;
+    p[2] = JOB_PACKET_HEADER;
+    p[3] = JOB_PACKET_LEN - 2;
+    uint8_t *j = &p[4];
+    j[0] = asicId;
+    j[1] = 0x01;
+    memcpy(j + 2, &job->starting_nonce, 4);
+    memcpy(j + JOB_NBITS, &job->target, 4);
+    memcpy(j + JOB_NTIME, &job->ntime, 4);
+    memcpy(j + JOB_MERKLE_ROOT, job->merkle_root_be, 32);
+    memcpy(j + JOB_PREV_BLOCK_HASH, job->prev_block_hash_be, 32);
+    memcpy(j + JOB_VERSION, &job->version, 4);
+    uint16_t crc = crc16_false(&p[2], JOB_PACKET_LEN - 4);
+    p[JOB_PACKET_LEN - 2] = crc >> 8;
+    p[JOB_PACKET_LEN - 1] = crc & 0xff;
+    return p;
+}
+
+static std::vector<uint8_t> ticket_mask_packet(uint32_t mask)
+{
+    std::vector<uint8_t> p = {0x55, 0xaa, CMD_WRITE_ALL, 0x09, 0x00, TICKET_MASK, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+        p[4 + 5 - i] = reverse_bits((mask >> (8 * i)) & 0xff);
+    }
+    p[10] = crc5(&p[2], 8);
+    return p;
+}
+
+static std::vector<uint8_t> result_frame(uint32_t nonce, uint8_t jobId, uint16_t version, uint8_t crc)
+{
+    std::vector<uint8_t> f(RESULT_LEN);
+    f[0] = 0xaa;
+    f[1] = 0x55;
+    memcpy(&f[2], &nonce, 4);
+    f[6] = 0;
+    f[7] = jobId;
+    memcpy(&f[8], &version, 2);
+    f[10] = crc;
+    return f;
+}
+
+// a nonce of the job above the difficulty, brute force
+static uint32_t find_nonce(const bm_job *job, uint32_t rolled)
+{
+    uint32_t nonce = rng();
+    while (test_nonce_value(job, nonce, rolled | job->version) < SYN_NONCE_DIFF) {
+        nonce++;
+    }
+    return nonce;
+}
+
+static std::vector<Event> synthetic_events(Expected *exp)
+{
+    std::vector<Event> events;
+    std::exponential_distribution<double> delay(1.0 / 5000.0);
+    std::uniform_int_distribution<int> submitDelay(3000, 8000);
+    std::uniform_int_distribution<int> responseDelay(30000, 80000);
+
+    NotifyPool pool;
+    pool.init(calloc, free);
+    Extranonce2Allocator enonce2;
+    enonce2.setLength(4);
+    const char *enonce1 = "a1b2c3d4";
+
+    add(events, 0, CAPTURE_STRATUM_TX, "{\"id\": 1, \"method\": \"mining.subscribe\", \"params\": [\"NerdQAxe+/1.0\"]}\n");
+    add(events, 1000, CAPTURE_STRATUM_TX,
+        "{\"id\": 2, \"method\": \"mining.configure\", \"params\": [[\"version-rolling\"], {\"version-rolling.mask\": "
+        "\"ffffffff\"}]}\n");
+    add(events, 30000, CAPTURE_STRATUM_RX,
+        "{\"id\":1,\"result\":[[[\"mining.notify\",\"ae6812eb4cd7735a\"]],\"a1b2c3d4\",4],\"error\":null}\n"
+        "{\"id\":2,\"result\":{\"version-rolling\":true,\"version-rolling.mask\":\"1fffe000\"},\"error\":null}\n");
+    // the password continues in the second write
+    add(events, 40000, CAPTURE_STRATUM_TX, "{\"id\": 3, \"method\": \"mining.authorize\", \"params\": [\"bc1qworker.nerd\", \"sec");
+    add(events, 41000, CAPTURE_STRATUM_TX,
+        "ret-pass\"]}\n{\"id\": 4, \"method\": \"mining.suggest_difficulty\", \"params\": [512]}\n");
+    add(events, 80000, CAPTURE_STRATUM_RX,
+        "{\"id\":3,\"result\":true,\"error\":null}\n{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[512]}\n");
+    events.push_back({100000, CAPTURE_UART_TX, ticket_mask_packet(255)});
+
+    std::vector<int64_t> notifyTimes;
+    mining_notify *notify = nullptr;
+    int64_t nextNotify = 200000;
+    int64_t nextTimer = 250000;
+    int jobCounter = 0;
+    int submitId = 10;
+    int resultCount = 0;
+
+    while (nextTimer < SYN_DURATION_US) {
+        int64_t t;
+        if (nextNotify < nextTimer) {
+            // a notify in two reads, effective when the line is complete
+            int k = (int) notifyTimes.size();
+            std::string branches;
+            for (int i = 0; i < 12; i++) {
+                branches += (i ? ",\"" : "\"") + hex(32) + "\"";
+            }
+            char ntime[9];
+            snprintf(ntime, sizeof(ntime), "%08x", 0x6712ab00 + k * 15);
+            std::string jobId = "1a" + std::to_string(k);
+            std::string coinb1 = hex(60), coinb2 = hex(80), prev = hex(32);
+            bool clean = k % 2 == 0;
+            std::string line = "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"" + jobId + "\",\"" + prev + "\",\"" + coinb1 +
+                               "\",\"" + coinb2 + "\",[" + branches + "],\"20000000\",\"17034219\",\"" + ntime + "\"," +
+                               (clean ? "true" : "false") + "]}\n";
+            add(events, nextNotify, CAPTURE_STRATUM_RX, line.substr(0, 300));
+            t = nextNotify + 300;
+            add(events, t, CAPTURE_STRATUM_RX, line.substr(300));
+            notifyTimes.push_back(t);
+            exp->notifies++;
+
+            if (notify) {
+                pool.release(notify);
+            }
+            notify = mining_notify_alloc(&pool, jobId.c_str(), coinb1.c_str(), coinb2.c_str(), 12);
+            JsonDocument doc;
+            deserializeJson(doc, line);
+            mining_notify_hex2bin(prev.c_str(), notify->_prev_block_hash, HASH_SIZE);
+            for (int i = 0; i < 12; i++) {
+                mining_notify_hex2bin(doc["params"][4][i].as<const char *>(), notify->_merkle_branches[i], HASH_SIZE);
+            }
+            notify->version = 0x20000000;
+            notify->target = 0x17034219;
+            notify->ntime = strtoul(ntime, NULL, 16);
+            enonce2.newJob(t, notify->ntime, clean);
+
+            nextNotify += SYN_NOTIFY_US;
+            // the new job goes out right away
+            t += 2000;
+        } else {
+            t = nextTimer;
+            nextTimer += SYN_JOB_US;
+        }
+
+        // create_jobs_task
+        uint64_t value;
+        uint32_t roll;
+        enonce2.next(t, &value, &roll);
+        char enonce2Str[9];
+        snprintf(enonce2Str, sizeof(enonce2Str), "%08llx", (unsigned long long) value);
+        bm_job *job = create_bm_job(notify, enonce1, enonce2Str, SYN_VERSION_MASK);
+        job->ntime += roll;
+        uint8_t asicId = (jobCounter++ * 24) & 0x7f;
+        events.push_back({t, CAPTURE_UART_TX, job_packet(job, asicId)});
+        exp->jobs++;
+
+        for (int i = 0; i < 2; i++) {
+            int64_t at = t + 1000 + std::min((int64_t) delay(rng), (int64_t) 40000);
+            resultCount++;
+            uint32_t rolled = (rng() << 13) & SYN_VERSION_MASK;
+            uint16_t version = reverse16(rolled >> 13);
+
+            if (resultCount % 100 == 0) {
+                // hardware error
+                events.push_back({at, CAPTURE_UART_RX, result_frame(rng(), asicId << 1, version, 0x80)});
+                exp->hwErrors++;
+                continue;
+            }
+
+            uint32_t nonce = find_nonce(job, rolled);
+            bool late = false;
+            if (jobCounter % 50 == 25 && i == 1) {
+                // no notify in between, the slot got exactly one new job
+                int64_t lateAt = t + SYN_LATE_US;
+                late = lateAt < SYN_DURATION_US && nextNotify > lateAt;
+                if (late) {
+                    at = lateAt;
+                }
+            }
+            exp->late += late;
+            exp->current += !late;
+
+            std::vector<uint8_t> frame = result_frame(nonce, asicId << 1, version, 0x80 | (rng() & 0x1f));
+            if (resultCount % 7 == 0) {
+                // partial read
+                events.push_back({at, CAPTURE_UART_RX, std::vector<uint8_t>(frame.begin(), frame.begin() + 5)});
+                events.push_back({at + 10, CAPTURE_UART_RX, std::vector<uint8_t>(frame.begin() + 5, frame.end())});
+            } else {
+                events.push_back({at, CAPTURE_UART_RX, frame});
+            }
+
+            if (!late && resultCount % 10 == 3) {
+                int64_t submitAt = at + submitDelay(rng);
+                char line[256];
+                snprintf(line, sizeof(line),
+                         "{\"id\": %d, \"method\": \"mining.submit\", \"params\": [\"bc1qworker.nerd\", \"%s\", \"%s\", "
+                         "\"%08lx\", \"%08lx\", \"%08lx\"]}\n",
+                         submitId, job->jobid, job->extranonce2, (unsigned long) job->ntime, (unsigned long) nonce,
+                         (unsigned long) (rolled ^ job->version));
+                add(events, submitAt, CAPTURE_STRATUM_TX, line);
+                snprintf(line, sizeof(line), "{\"id\":%d,\"result\":true,\"error\":null}\n", submitId++);
+                add(events, submitAt + responseDelay(rng), CAPTURE_STRATUM_RX, line);
+                exp->submits++;
+            }
+        }
+        free_bm_job(job);
+
+        if (t % 5000000 < SYN_JOB_US) {
+            // temperature register reply and line noise
+            events.push_back({t + 500, CAPTURE_UART_RX, result_frame(0x8000a123, 0xb4, 0, 0x1f)});
+            events.push_back({t + 600, CAPTURE_UART_RX, {0x00, 0x12, 0x34}});
+            exp->registerReplies++;
+            exp->skippedBytes += 3;
+        }
+    }
+    pool.release(notify);
+
+    std::stable_sort(events.begin(), events.end(), [](const Event &a, const Event &b) { return a.timeUs < b.timeUs; });
+    return events;
+}
+
+// records the events with the firmware recorder and downloads the ring
+static std::vector<uint8_t> record(const std::vector<Event> &events, size_t ringSize)
+{
+    host_time_us = 0;
+    CAPTURE_start(ringSize, CAPTURE_SRC_UART | CAPTURE_SRC_STRATUM);
+    for (const Event &e : events) {
+        host_time_us = e.timeUs;
+        CAPTURE_record(e.type, e.data.data(), e.data.size());
+    }
+
+    capture_info_t info;
+    CAPTURE_get_info(&info);
+    capture_file_header_t hdr = {};
+    memcpy(hdr.magic, CAPTURE_MAGIC, sizeof(hdr.magic));
+    hdr.version = CAPTURE_VERSION;
+    hdr.sources = info.sources;
+    hdr.base_time_us = info.base_time_us;
+    hdr.frames = info.frames;
+    hdr.dropped = info.dropped;
+
+    std::vector<uint8_t> file((uint8_t *) &hdr, (uint8_t *) &hdr + sizeof(hdr));
+    file.resize(sizeof(hdr) + info.used);
+    CAPTURE_read(0, file.data() + sizeof(hdr), info.used);
+    CAPTURE_stop();
+    return file;
+}
+
+static bool contains(const std::vector<uint8_t> &file, const char *s)
+{
+    return std::search(file.begin(), file.end(), s, s + strlen(s)) != file.end();
+}
+
+static void self_check()
+{
+    printf("synthetic capture\n");
+
+    Expected exp;
+    std::vector<Event> events = synthetic_events(&exp);
+    std::vector<uint8_t> file = record(events, 4 * 1024 * 1024);
+
+    CHECK(!contains(file, "secret") && !contains(file, "ret-pass"), "pool password in the capture");
+    CHECK(contains(file, "\"<redacted>\"]}") && contains(file, "mining.suggest_difficulty"), "authorize not redacted");
+
+    capture_file_header_t hdr;
+    std::vector<Record> records;
+    CHECK(decode(file, &hdr, &records), "capture not decoded");
+    CHECK(records.size() == hdr.frames && hdr.dropped == 0, "%zu records of %u, %u dropped", records.size(), hdr.frames,
+          hdr.dropped);
+
+    Replay::Options opts;
+    opts.asicDiff = SYN_ASIC_DIFF;
+    Replay replay(opts);
+    replay.run(records);
+    replay.report();
+
+    CHECK(replay.maskDiff == 256, "ticket mask decoded as %u", replay.maskDiff);
+    CHECK(replay.notifies == exp.notifies && !replay.parseErrors, "%d notifies of %d, %d parse errors", replay.notifies,
+          exp.notifies, replay.parseErrors);
+    CHECK(replay.jobs == exp.jobs && replay.jobsReproduced == exp.jobs, "%d jobs, %d reproduced of %d", replay.jobs,
+          replay.jobsReproduced, exp.jobs);
+    CHECK((int) replay.results[JOB_RESULT_CURRENT] == exp.current, "%u current of %d", replay.results[JOB_RESULT_CURRENT],
+          exp.current);
+    CHECK((int) replay.results[JOB_RESULT_LATE] == exp.late && exp.late > 0, "%u late of %d", replay.results[JOB_RESULT_LATE],
+          exp.late);
+    CHECK((int) (replay.results[JOB_RESULT_STALE] + replay.results[JOB_RESULT_INVALID]) == exp.hwErrors,
+          "%u stale + %u invalid, %d hardware errors", replay.results[JOB_RESULT_STALE], replay.results[JOB_RESULT_INVALID],
+          exp.hwErrors);
+    CHECK(replay.registerReplies == exp.registerReplies && replay.skippedBytes == exp.skippedBytes,
+          "%d register replies of %d, %d bytes skipped of %d", replay.registerReplies, exp.registerReplies, replay.skippedBytes,
+          exp.skippedBytes);
+    CHECK(replay.submits == exp.submits && (int) replay.resultToSubmitMs.size() == exp.submits &&
+              (int) replay.submitToResponseMs.size() == exp.submits,
+          "%d submits of %d, %zu matched, %zu responses", replay.submits, exp.submits, replay.resultToSubmitMs.size(),
+          replay.submitToResponseMs.size());
+
+    double notifyMs = percentile(replay.notifyToJobMs, 0.5);
+    double submitMs = percentile(replay.resultToSubmitMs, 0.5);
+    double responseMs = percentile(replay.submitToResponseMs, 0.5);
+    CHECK((int) replay.notifyToJobMs.size() == exp.notifies && notifyMs > 1.9 && notifyMs < 2.1, "notify -> job %.2f ms",
+          notifyMs);
+    CHECK(submitMs >= 3.0 && submitMs <= 8.0, "result -> submit %.2f ms", submitMs);
+    CHECK(responseMs >= 30.0 && responseMs <= 80.0, "submit -> response %.2f ms", responseMs);
+
+    printf("small ring\n");
+    file = record(events, 16 * 1024);
+    records.clear();
+    CHECK(decode(file, &hdr, &records), "capture not decoded");
+    printf("  %u records, %u dropped\n", hdr.frames, hdr.dropped);
+    CHECK(records.size() == hdr.frames && hdr.dropped > 0, "%zu records of %u, %u dropped", records.size(), hdr.frames,
+          hdr.dropped);
+
+    // starts in the middle of the session, nothing to reproduce
+    Replay partial(opts);
+    partial.run(records);
+    CHECK(partial.results[JOB_RESULT_CURRENT] > 0, "no result verified after the wrap");
+}
+
+static int usage()
+{
+    printf("usage: capture_replay [capture.bin [--asic bm1366|bm1368|bm1370] [--speed x] [--asic-diff d]]\n");
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        self_check();
+        if (failures) {
+            printf("%d checks failed\n", failures);
+            return 1;
+        }
+        printf("all checks passed\n");
+        return 0;
+    }
+
+    Replay::Options opts;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "--speed") && i + 1 < argc) {
+            opts.speed = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--asic-diff") && i + 1 < argc) {
+            opts.asicDiff = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--asic") && i + 1 < argc) {
+            const char *name = argv[++i];
+            auto it = std::find_if(std::begin(s_asics), std::end(s_asics), [&](const AsicModel &a) { return !strcmp(a.name, name); });
+            if (it == std::end(s_asics)) {
+                return usage();
+            }
+            opts.asic = it;
+        } else {
+            return usage();
+        }
+    }
+
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        printf("can't open %s\n", argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> file;
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        file.insert(file.end(), buf, buf + n);
+    }
+    fclose(f);
+
+    capture_file_header_t hdr;
+    std::vector<Record> records;
+    bool ok = decode(file, &hdr, &records);
+    if (records.empty()) {
+        printf("%s: not a capture or empty\n", argv[1]);
+        return 1;
+    }
+    printf("%s: %zu records, %u dropped on the device, %.1f s%s\n", argv[1], records.size(), hdr.dropped,
+           (records.back().timeUs - records.front().timeUs) / 1e6, ok ? "" : ", truncated");
+
+    Replay replay(opts);
+    replay.run(records);
+    replay.report();
+    return 0;
+}
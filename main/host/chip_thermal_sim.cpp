@@ -0,0 +1,216 @@
+// Host test of the per-chip frequency balancing on a simulated multi-chip
+// board.
+//
+//   c++ -O2 -std=gnu++17 -Istubs -I.. -o chip_thermal_sim chip_thermal_sim.cpp ../tasks/chip_thermal_model.cpp
+//   ./chip_thermal_sim            # the layouts of the boards
+//   ./chip_thermal_sim 3x4 1x6    # rows x cols
+//
+// Each chip draws 0.02 W/MHz through its own thermal resistance and gets
+// 30% of the power of its direct neighbors (the model assumes 25%). The
+// resistance grows by 12% per row along the airflow and varies by +-10%
+// per chip. Temps follow with a time constant of 15 s, the fan is fixed
+// at 60%, the ambient is 30 °C (set through setAmbientTemp). A step is
+// 2 s like the power management loop: the model learns every step and
+// allocates every 30 s with a boost of 50 MHz, like
+// balanceChipFrequencies.
+//
+// Reference is the highest frequency on the 6.25 MHz grid that keeps the
+// hottest chip below the cap with all chips on it. From there the
+// balancing runs for 30 min with the neighbors from the layout.
+//
+// Result on a x86 Linux box (cap 68 °C):
+//   layout  uniform MHz  max °C  |  balanced sum MHz  max °C (last 10 min)
+//   2x2          387.5    67.5   |            +8.1%    67.8
+//   2x3          343.8    67.7   |            +9.4%    67.8
+//   2x4          306.2    67.3   |           +12.2%    67.8
+//   3x4          300.0    67.7   |            +9.5%    67.9
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "tasks/chip_thermal_model.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                         \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__);                                                                          \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+#define WATTS_PER_MHZ 0.02f
+#define COUPLING 0.30f
+#define AMBIENT 30.0f
+#define CAP 68.0f
+#define FAN_PERC 60
+#define BOOST 50.0f
+#define TAU_S 15.0f
+#define STEP_S 2
+
+struct Chips
+{
+    int rows, cols;
+    std::vector<float> res;
+
+    int count() const
+    {
+        return rows * cols;
+    }
+
+    // steady state temps for the given frequencies
+    std::vector<float> temps(const std::vector<float> &freq) const
+    {
+        std::vector<float> t(count());
+        for (int i = 0; i < count(); i++) {
+            int r = i / cols, c = i % cols;
+            float p = freq[i] * WATTS_PER_MHZ;
+            const int dr[] = {-1, 1, 0, 0};
+            const int dc[] = {0, 0, -1, 1};
+            for (int n = 0; n < 4; n++) {
+                int nr = r + dr[n], nc = c + dc[n];
+                if (nr < 0 || nc < 0 || nr >= rows || nc >= cols) {
+                    continue;
+                }
+                p += COUPLING * freq[nr * cols + nc] * WATTS_PER_MHZ;
+            }
+            t[i] = AMBIENT + res[i] * p;
+        }
+        return t;
+    }
+};
+
+static Chips make_chips(int rows, int cols)
+{
+    std::mt19937 rng(rows * 100 + cols);
+    std::uniform_real_distribution<float> spread(0.9f, 1.1f);
+
+    Chips chips{rows, cols, {}};
+    for (int i = 0; i < rows * cols; i++) {
+        chips.res.push_back(2.6f * (1.0f + 0.12f * (i / cols)) * spread(rng));
+    }
+    return chips;
+}
+
+static float max_of(const std::vector<float> &v)
+{
+    return *std::max_element(v.begin(), v.end());
+}
+
+struct Balanced
+{
+    float sum;
+    float maxTemp;
+};
+
+static Balanced balance(const Chips &chips, float base)
+{
+    Board board;
+    board.asicCount = chips.count();
+    board.chipLayoutCols = chips.cols;
+
+    ChipThermalModel model;
+    model.init(&board);
+    model.setAmbientTemp(AMBIENT);
+    model.reset(base);
+
+    std::vector<float> freq(chips.count(), base);
+    std::vector<float> temp = chips.temps(freq);
+    float maxTemp = 0.0f;
+
+    const int steps = 30 * 60 / STEP_S;
+    for (int step = 0; step < steps; step++) {
+        std::vector<float> steady = chips.temps(freq);
+        float power = 0.0f;
+        for (int i = 0; i < chips.count(); i++) {
+            temp[i] += (steady[i] - temp[i]) * (1.0f - expf(-STEP_S / TAU_S));
+            board.chipTemps[i] = temp[i];
+            power += freq[i] * WATTS_PER_MHZ;
+        }
+
+        if (step >= steps - 10 * 60 / STEP_S) {
+            maxTemp = std::max(maxTemp, max_of(temp));
+        }
+
+        model.learn(&board, FAN_PERC, power);
+        if (step % (30 / STEP_S) || !model.allocate(base - 100.0f, base + BOOST, CAP, FAN_PERC, power)) {
+            continue;
+        }
+        for (int i = 0; i < chips.count(); i++) {
+            freq[i] = model.getTargetFrequency(i);
+            model.setChipFrequency(i, freq[i]);
+        }
+    }
+
+    Balanced b{0.0f, maxTemp};
+    for (float f : freq) {
+        b.sum += f;
+    }
+    return b;
+}
+
+// all chips on one frequency, hottest chip below the cap
+static float uniform_frequency(const Chips &chips)
+{
+    float f = 100.0f;
+    while (max_of(chips.temps(std::vector<float>(chips.count(), f + 6.25f))) <= CAP) {
+        f += 6.25f;
+    }
+    return f;
+}
+
+static void run_layout(int rows, int cols)
+{
+    Chips chips = make_chips(rows, cols);
+
+    float base = uniform_frequency(chips);
+    float uniformSum = base * chips.count();
+    float uniformMax = max_of(chips.temps(std::vector<float>(chips.count(), base)));
+
+    Balanced b = balance(chips, base);
+
+    printf("  %dx%d          %5.1f    %4.1f   |           %+5.1f%%    %4.1f\n", rows, cols, base, uniformMax,
+           100.0f * (b.sum / uniformSum - 1.0f), b.maxTemp);
+
+    CHECK(b.sum > uniformSum, "%dx%d: balanced %.1f MHz not above uniform %.1f MHz", rows, cols, b.sum, uniformSum);
+    CHECK(b.maxTemp <= CAP + 1.0f, "%dx%d: %.1f °C over the cap", rows, cols, b.maxTemp);
+}
+
+int main(int argc, char **argv)
+{
+    printf("cap %.0f °C\n", CAP);
+    printf("  layout  uniform MHz  max °C  |  balanced sum MHz  max °C (last 10 min)\n");
+
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            int rows, cols;
+            if (sscanf(argv[i], "%dx%d", &rows, &cols) != 2 || rows < 1 || cols < 1 || rows * cols > 64) {
+                printf("bad layout %s, expected rows x cols like 2x4\n", argv[i]);
+                return 2;
+            }
+            run_layout(rows, cols);
+        }
+    } else {
+        // nerdqaxe++, nerdhaxe gamma, nerdoctaxe, nerdeko
+        const int layouts[][2] = {{2, 2}, {2, 3}, {2, 4}, {3, 4}};
+        for (auto &l : layouts) {
+            run_layout(l[0], l[1]);
+        }
+    }
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,328 @@
+// Host test of the suggested difficulty against a vardiff mock pool.
+//
+//   c++ -O2 -std=gnu++17 -I../stratum -o diff_suggest_sim diff_suggest_sim.cpp ../stratum/diff_suggest.cpp
+//   ./diff_suggest_sim
+//
+// Checks the DiffSuggester rules, then simulates sessions of a 5 TH/s miner
+// with Poisson distributed shares (10 ms steps, 200 seeds per case):
+//
+// - mock pool: starts at the suggested difficulty, retargets after 12
+//   shares or 300 s to its target share interval, at most x4 per step and
+//   only when off by more than x2 (the vardiff of ckpool and public-pool
+//   works alike)
+// - A: pool targets 10 s, like the default share interval. Fixed suggestion
+//   1000 (like before) against the suggestion from the hashrate
+// - B: pool targets 30 s. Reconnect after the first session converged,
+//   suggested from the hashrate only against the remembered difficulty
+// - C: pool without vardiff, takes the suggestion. The hashrate drops to
+//   half after 10 minutes (throttling), with and without re-suggesting
+//
+// Measured are the time until the pool difficulty is within x2 of what its
+// vardiff converges to (where it stops retargeting), the set_difficulty
+// count and the shares sent in the first 5 minutes (ideal: 30 for A).
+//
+// Result on a x86 Linux box:
+//   A fixed:  stable after 55 s avg (max 193 s), 2.3 retargets, 49 shares
+//             in 5 min
+//   A auto:   stable after 0 s, 0.1 retargets (vardiff noise), 30 shares
+//   B auto:   stable after 125 s avg (max 538 s), 1.1 retargets on the
+//             reconnect
+//   B memory: stable after 14 s avg, 0.3 retargets on the reconnect
+//   C fixed:  share interval 20.0 s after the hashrate dropped
+//   C update: share interval 10.0 s after the hashrate dropped
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <random>
+
+#include "diff_suggest.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                         \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__);                                                                          \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+static const double TWO32 = 4294967296.0;
+static const int STEP_MS = 10;
+static const int SEEDS = 200;
+
+// ------------ rules
+
+static void test_rules()
+{
+    printf("rules\n");
+
+    // 5 TH/s at 10 s
+    CHECK(DiffSuggester::fromHashrate(5000.0, 10) == 11641, "fromHashrate %u", DiffSuggester::fromHashrate(5000.0, 10));
+    CHECK(DiffSuggester::fromHashrate(0.0, 10) == 0, "unknown hashrate");
+    CHECK(DiffSuggester::fromHashrate(0.001, 10) == 1, "not clamped to 1");
+    CHECK(DiffSuggester::fromHashrate(5000.0, 0) == 0, "disabled");
+
+    DiffSuggester d;
+
+    // disabled: the fixed difficulty like before
+    d.configure(1000, 0);
+    d.setPool("pool", 3333);
+    CHECK(d.onConnect(5000.0, 0) == 1000, "fixed not used when disabled");
+    uint32_t diff = 0;
+    CHECK(!d.needsUpdate(1000.0, 3600 * 1000, &diff), "updated when disabled");
+
+    // no hashrate yet
+    d.configure(1000, 10);
+    CHECK(d.onConnect(0.0, 0) == 1000, "fixed not used without hashrate");
+    CHECK(d.onConnect(5000.0, 0) == 11641, "not from hashrate");
+
+    // remembered while the hashrate is about the same, even when the pool's
+    // vardiff aims for another interval
+    d.setPoolDifficulty(30000);
+    CHECK(d.onConnect(0.0, 0) == 30000, "remembered not used without hashrate");
+    CHECK(d.onConnect(4000.0, 0) == 30000, "remembered not used");
+    CHECK(d.onConnect(2000.0, 0) == 4656, "remembered used although the hashrate dropped x2.5");
+    d.setPoolDifficulty(20000);
+    CHECK(d.onConnect(5000.0, 0) == 11641, "remembered used although the hashrate rose x2.5");
+    d.setPoolDifficulty(20000);
+
+    // another pool forgets it, the same keeps it
+    d.setPool("pool", 3333);
+    CHECK(d.getPoolDifficulty() == 20000, "forgotten on the same pool");
+    d.setPool("pool", 3334);
+    CHECK(d.getPoolDifficulty() == 0, "kept for another port");
+    CHECK(d.onConnect(5000.0, 0) == 11641, "remembered of another pool");
+
+    // re-suggest only on a x2 change and not more often than every 5 min
+    d.setPoolDifficulty(11641);
+    CHECK(!d.needsUpdate(2500.0, DiffSuggester::RESUGGEST_MIN_MS - 1, &diff), "updated too early");
+    CHECK(!d.needsUpdate(3000.0, DiffSuggester::RESUGGEST_MIN_MS, &diff), "updated on a small change");
+    CHECK(d.needsUpdate(2500.0, DiffSuggester::RESUGGEST_MIN_MS, &diff) && diff == 5820, "not updated, %u", diff);
+    CHECK(!d.needsUpdate(1000.0, DiffSuggester::RESUGGEST_MIN_MS + 1000, &diff), "updated twice within 5 min");
+    CHECK(!d.needsUpdate(0.0, 3 * DiffSuggester::RESUGGEST_MIN_MS, &diff), "updated without hashrate");
+}
+
+// ------------ mock pool
+
+struct Pool
+{
+    double target;    // share interval the vardiff aims for, 0 no vardiff
+    double diff = 0;
+    int retargets = 0;
+    int windowShares = 0;
+    double windowStart = 0;
+
+    void start(uint32_t suggested, double t)
+    {
+        diff = suggested;
+        windowShares = 0;
+        windowStart = t;
+    }
+
+    // true on set_difficulty
+    bool share(double t)
+    {
+        windowShares++;
+        return retarget(t);
+    }
+
+    bool retarget(double t)
+    {
+        double elapsed = t - windowStart;
+        if (!target || (windowShares < 12 && elapsed < 300.0)) {
+            return false;
+        }
+        double ratio = windowShares * target / elapsed;
+        windowShares = 0;
+        windowStart = t;
+        if (ratio > 0.5 && ratio < 2.0) {
+            return false;
+        }
+        ratio = fmin(fmax(ratio, 0.25), 4.0);
+        diff = fmax(1.0, round(diff * ratio));
+        retargets++;
+        return true;
+    }
+};
+
+struct SessionResult
+{
+    double stableS = -1; // first time within x2 of the converged value
+    int retargets = 0;
+    int sharesFirst5m = 0;
+    double intervalAfterS = 0; // share interval in the second half (case C)
+};
+
+// one session of `lengthS`, the hashrate drops to `ghsAfter` at `dropS`
+static SessionResult run_session(DiffSuggester &d, Pool &pool, double ghs, double ghsAfter, double dropS, double lengthS,
+                                 std::mt19937_64 &rng, bool resuggest)
+{
+    SessionResult r;
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+
+    pool.retargets = 0;
+    pool.start(d.onConnect(ghs, 0), 0.0);
+    d.setPoolDifficulty((uint32_t) pool.diff);
+
+    int sharesAfter = 0;
+    double lastCheck = 0.0;
+
+    for (int64_t ms = 0; ms < (int64_t) (lengthS * 1000); ms += STEP_MS) {
+        double t = ms / 1000.0;
+        double rate = t < dropS ? ghs : ghsAfter;
+
+        double converged = pool.target ? rate * 1e9 * pool.target / TWO32 : pool.diff;
+        if (r.stableS < 0 && pool.diff < converged * 2.0 && pool.diff > converged / 2.0) {
+            r.stableS = t;
+        }
+
+        // shares in the step
+        double p = rate * 1e9 * STEP_MS / 1000.0 / (pool.diff * TWO32);
+        if (uni(rng) < p) {
+            if (t < 300.0) {
+                r.sharesFirst5m++;
+            }
+            if (t >= dropS + 600.0) {
+                sharesAfter++;
+            }
+            if (pool.share(t)) {
+                d.setPoolDifficulty((uint32_t) pool.diff);
+            }
+        }
+
+        // the check of StratumTask::waitForPool(), every 30 s
+        uint32_t diff;
+        if (resuggest && t - lastCheck >= 30.0) {
+            lastCheck = t;
+            if (d.needsUpdate(rate, ms, &diff)) {
+                pool.start(diff, t);
+                d.setPoolDifficulty(diff);
+            }
+        }
+    }
+
+    r.retargets = pool.retargets;
+    if (sharesAfter) {
+        r.intervalAfterS = (lengthS - dropS - 600.0) / sharesAfter;
+    }
+    return r;
+}
+
+struct Summary
+{
+    double stableSum = 0, stableMax = 0, retargets = 0, shares = 0, interval = 0;
+    int n = 0;
+
+    void add(const SessionResult &r)
+    {
+        stableSum += r.stableS;
+        stableMax = fmax(stableMax, r.stableS);
+        retargets += r.retargets;
+        shares += r.sharesFirst5m;
+        interval += r.intervalAfterS;
+        n++;
+    }
+    double stableAvg() const { return stableSum / n; }
+    double retargetsAvg() const { return retargets / n; }
+    double sharesAvg() const { return shares / n; }
+    double intervalAvg() const { return interval / n; }
+};
+
+static const double GHS = 5000.0;
+
+// A: pool vardiff aims for the same interval
+static Summary case_a(bool fromHashrate)
+{
+    Summary s;
+    for (int seed = 0; seed < SEEDS; seed++) {
+        std::mt19937_64 rng(seed);
+        DiffSuggester d;
+        d.configure(1000, fromHashrate ? 10 : 0);
+        d.setPool("pool", 3333);
+        Pool pool{10.0};
+        s.add(run_session(d, pool, GHS, GHS, 1e9, 600.0, rng, true));
+    }
+    return s;
+}
+
+// B: pool vardiff aims for 30 s, the reconnect session is measured
+static Summary case_b(bool memory)
+{
+    Summary s;
+    for (int seed = 0; seed < SEEDS; seed++) {
+        std::mt19937_64 rng(seed);
+        DiffSuggester d;
+        d.configure(1000, 10);
+        d.setPool("pool", 3333);
+        Pool pool{30.0};
+        run_session(d, pool, GHS, GHS, 1e9, 1800.0, rng, true);
+        if (!memory) {
+            d.setPool("other", 1);
+            d.setPool("pool", 3333);
+        }
+        s.add(run_session(d, pool, GHS, GHS, 1e9, 600.0, rng, true));
+    }
+    return s;
+}
+
+// C: pool without vardiff, hashrate halves after 10 min
+static Summary case_c(bool resuggest)
+{
+    Summary s;
+    for (int seed = 0; seed < SEEDS; seed++) {
+        std::mt19937_64 rng(seed);
+        DiffSuggester d;
+        d.configure(1000, 10);
+        d.setPool("pool", 3333);
+        Pool pool{0.0};
+        s.add(run_session(d, pool, GHS, GHS / 2, 600.0, 7200.0, rng, resuggest));
+    }
+    return s;
+}
+
+int main()
+{
+    test_rules();
+
+    printf("vardiff mock pool, %.0f GH/s, %d seeds\n", GHS, SEEDS);
+
+    Summary aFixed = case_a(false);
+    Summary aAuto = case_a(true);
+    printf("A fixed:  stable after %.0f s avg (max %.0f s), %.1f retargets, %.0f shares in 5 min\n", aFixed.stableAvg(),
+           aFixed.stableMax, aFixed.retargetsAvg(), aFixed.sharesAvg());
+    printf("A auto:   stable after %.0f s avg (max %.0f s), %.1f retargets, %.0f shares in 5 min\n", aAuto.stableAvg(),
+           aAuto.stableMax, aAuto.retargetsAvg(), aAuto.sharesAvg());
+
+    Summary bAuto = case_b(false);
+    Summary bMemory = case_b(true);
+    printf("B auto:   stable after %.0f s avg (max %.0f s), %.1f retargets on the reconnect\n", bAuto.stableAvg(),
+           bAuto.stableMax, bAuto.retargetsAvg());
+    printf("B memory: stable after %.0f s avg (max %.0f s), %.1f retargets on the reconnect\n", bMemory.stableAvg(),
+           bMemory.stableMax, bMemory.retargetsAvg());
+
+    Summary cFixed = case_c(false);
+    Summary cUpdate = case_c(true);
+    printf("C fixed:  share interval %.1f s after the hashrate dropped\n", cFixed.intervalAvg());
+    printf("C update: share interval %.1f s after the hashrate dropped\n", cUpdate.intervalAvg());
+
+    CHECK(aAuto.stableAvg() < 1.0 && aAuto.retargetsAvg() < aFixed.retargetsAvg() / 5, "auto not stable from the start");
+    CHECK(aFixed.stableAvg() > 30.0, "fixed reference converged too fast, pool too lax");
+    CHECK(aAuto.sharesAvg() < aFixed.sharesAvg() * 0.7, "no less share burst");
+    CHECK(bMemory.stableAvg() < bAuto.stableAvg() / 4 && bMemory.retargetsAvg() < bAuto.retargetsAvg() / 3,
+          "remembered difficulty not reused");
+    CHECK(bAuto.retargetsAvg() >= 0.9, "reference didn't retarget");
+    CHECK(fabs(cUpdate.intervalAvg() - 10.0) < 1.5, "not re-suggested, interval %.1f s", cUpdate.intervalAvg());
+    CHECK(cFixed.intervalAvg() > 17.0, "reference interval %.1f s", cFixed.intervalAvg());
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,271 @@
+// Host test of the per-pool extranonce2 allocation with small extranonce2
+// sizes.
+//
+//   c++ -O2 -std=gnu++17 -I../tasks -o extranonce2_sim extranonce2_sim.cpp ../tasks/extranonce2.cpp
+//   ./extranonce2_sim
+//
+// Checks the allocator rules, then runs 12 h of dual pool mining (jobs
+// alternate between the pools) for extranonce2 sizes of 0-4 bytes at 10 ms
+// and 500 ms job intervals. A notify comes every 5-60 s per pool, one in
+// ten is a resend of the last job with the same content and ntime.
+// Counted as repeated work is a job sent twice with the same content,
+// extranonce2 and ntime. The ntime must never be more than
+// ENONCE2_NTIME_AHEAD_S ahead of the pool time.
+//
+// Before: one 32 bit counter for both pools, printed with "%0*lx" into a
+// buffer of 2 * size digits. Above the size the string is cut off and 16
+// consecutive values give the same extranonce2 (2 bytes: after 9 h at
+// 500 ms).
+//
+// Result on a x86 Linux box:
+//   size  interval |  before: repeated  |  per pool: repeated  wraps  exhausted  max ntime roll
+//     0    10 ms   |           99.9%    |              0.0%     86518   4233480       231
+//     1    10 ms   |           99.9%    |              0.0%     15678         0        33
+//     2    10 ms   |           95.0%    |              0.0%         0         0         0
+//     2   500 ms   |           20.5%    |              0.0%         0         0         0
+//     3    10 ms   |            0.0%    |              0.0%         0         0         0
+//     4    10 ms   |            0.0%    |              0.0%         0         0         0
+//   (repeated: share of the jobs, exhausted: jobs not created, max ntime
+//   roll: over the ntime of the job, large for resends of old jobs)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <set>
+#include <string>
+#include <tuple>
+
+#include "extranonce2.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                         \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__);                                                                          \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+#define SEC 1000000LL
+
+// ------------ rules
+
+static void test_rules()
+{
+    printf("rules\n");
+
+    Extranonce2Allocator a;
+    enonce2_stats_t st;
+    uint64_t v;
+    uint32_t roll;
+
+    // 1 byte: 256 values, then the ntime rolls
+    a.setLength(1);
+    a.newJob(0, 1000);
+    for (int i = 0; i < 256; i++) {
+        CHECK(a.next(0, &v, &roll) && v == (uint64_t) i && roll == 0, "value %d: %llu roll %u", i,
+              (unsigned long long) v, roll);
+    }
+    CHECK(a.next(0, &v, &roll) && v == 0 && roll == 1, "after the wrap %llu roll %u", (unsigned long long) v, roll);
+    a.getStats(&st);
+    CHECK(st.wraps == 1 && st.maxNtimeRoll == 1, "wraps %u", st.wraps);
+
+    // a new job with a newer ntime continues the values without a roll
+    a.newJob(2 * SEC, 1002);
+    CHECK(a.next(2 * SEC, &v, &roll) && v == 1 && roll == 0, "new job %llu roll %u", (unsigned long long) v, roll);
+
+    // a resend with the old ntime continues on the rolled one
+    a.newJob(3 * SEC, 1000);
+    CHECK(a.next(3 * SEC, &v, &roll) && v == 2 && roll == 2, "resend %llu roll %u", (unsigned long long) v, roll);
+
+    // the ntime doesn't run ahead of the pool time
+    Extranonce2Allocator z;
+    z.setLength(0);
+    z.newJob(0, 1000);
+    int sent = 0;
+    while (z.next(0, &v, &roll)) {
+        CHECK(v == 0, "value %llu with 0 bytes", (unsigned long long) v);
+        sent++;
+    }
+    CHECK(sent == ENONCE2_NTIME_AHEAD_S + 1, "%d jobs without extranonce2", sent);
+    CHECK(z.next(SEC, &v, &roll) && roll == ENONCE2_NTIME_AHEAD_S + 1, "no roll a second later");
+    z.getStats(&st);
+    CHECK(st.exhausted == 1, "exhausted %u", st.exhausted);
+
+    // a job with a far future ntime shifts the roll only until the next
+    // clean_jobs notify
+    Extranonce2Allocator f;
+    f.setLength(0);
+    f.newJob(0, 1000, true);
+    f.newJob(SEC, 5000);
+    f.newJob(2 * SEC, 1002, true);
+    CHECK(f.next(2 * SEC, &v, &roll) && roll == 0, "roll %u after the far future job", roll);
+    sent = 1;
+    while (f.next(2 * SEC, &v, &roll)) {
+        sent++;
+    }
+    CHECK(sent == ENONCE2_NTIME_AHEAD_S + 1, "%d jobs after the far future job", sent);
+
+    // a length change starts over
+    a.setLength(2);
+    a.newJob(4 * SEC, 1004);
+    CHECK(a.next(4 * SEC, &v, &roll) && v == 0 && roll == 0, "after the length change %llu", (unsigned long long) v);
+    CHECK(a.getLength() == 2, "length");
+
+    // 8 bytes and more never wrap
+    Extranonce2Allocator big;
+    big.setLength(12);
+    big.newJob(0, 1000);
+    for (int i = 0; i < 1000; i++) {
+        big.next(0, &v, &roll);
+    }
+    big.getStats(&st);
+    CHECK(v == 999 && st.wraps == 0, "12 bytes");
+}
+
+// ------------ dual pool mining
+
+struct Pool
+{
+    int64_t nextNotify;
+    int64_t content;  // job content, a resend keeps it
+    uint32_t ntime;
+    Extranonce2Allocator enonce2;
+    std::set<std::tuple<int64_t, std::string, uint32_t>> work;
+};
+
+struct Result
+{
+    double repeated;
+    enonce2_stats_t stats;
+    bool ntimeAhead;
+};
+
+static std::string format(uint64_t value, int len)
+{
+    char buf[len * 2 + 1];
+    snprintf(buf, sizeof(buf), "%0*llx", len * 2, (unsigned long long) value);
+    return buf;
+}
+
+// before: one counter, cut off at the length
+static std::string format_before(uint32_t value, int len)
+{
+    char buf[len * 2 + 1];
+    snprintf(buf, sizeof(buf), "%0*lx", len * 2, (unsigned long) value);
+    return buf;
+}
+
+static Result run(int len, int intervalMs, bool before)
+{
+    std::mt19937 rng(11);
+    auto uni = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+
+    Pool pools[2]{};
+    int64_t contentSeq = 0;
+    for (auto &p : pools) {
+        p.enonce2.setLength(len);
+    }
+
+    uint32_t counter = 0;
+    uint64_t jobs = 0, repeated = 0;
+    bool ntimeAhead = false;
+    int active = 0;
+
+    for (int64_t us = 0; us < 12 * 3600 * SEC; us += intervalMs * 1000LL) {
+        for (auto &p : pools) {
+            if (us < p.nextNotify) {
+                continue;
+            }
+            p.nextNotify = us + uni(5, 60) * SEC;
+            // a resend keeps content and ntime, only the same content can
+            // repeat work
+            if (p.content == 0 || uni(0, 9)) {
+                p.content = ++contentSeq;
+                p.ntime = (uint32_t) (us / SEC);
+                p.work.clear();
+            }
+            p.enonce2.newJob(us, p.ntime);
+        }
+
+        Pool &p = pools[active];
+        active ^= 1;
+
+        std::string en2;
+        uint32_t ntime = p.ntime;
+        if (before) {
+            en2 = format_before(counter++, len);
+        } else {
+            uint64_t v;
+            uint32_t roll;
+            if (!p.enonce2.next(us, &v, &roll)) {
+                continue;
+            }
+            en2 = format(v, len);
+            ntime += roll;
+            ntimeAhead |= ntime > (uint32_t) (us / SEC) + ENONCE2_NTIME_AHEAD_S;
+        }
+
+        jobs++;
+        repeated += !p.work.insert({p.content, en2, ntime}).second;
+    }
+
+    Result r{};
+    r.repeated = 100.0 * repeated / (jobs ? jobs : 1);
+    r.ntimeAhead = ntimeAhead;
+    pools[0].enonce2.getStats(&r.stats);
+    enonce2_stats_t s1;
+    pools[1].enonce2.getStats(&s1);
+    r.stats.wraps += s1.wraps;
+    r.stats.exhausted += s1.exhausted;
+    if (s1.maxNtimeRoll > r.stats.maxNtimeRoll) {
+        r.stats.maxNtimeRoll = s1.maxNtimeRoll;
+    }
+    return r;
+}
+
+static void test_mining()
+{
+    printf("12 h dual pool\n");
+    printf("  size  interval |  before: repeated  |  per pool: repeated  wraps  exhausted  max ntime roll\n");
+
+    struct
+    {
+        int len;
+        int intervalMs;
+    } cases[] = {{0, 10}, {1, 10}, {2, 10}, {2, 500}, {3, 10}, {4, 10}};
+
+    for (auto &c : cases) {
+        Result before = run(c.len, c.intervalMs, true);
+        Result after = run(c.len, c.intervalMs, false);
+        printf("    %d   %3d ms   |          %5.1f%%    |            %5.1f%%  %8u  %8u      %4u\n", c.len, c.intervalMs,
+               before.repeated, after.repeated, after.stats.wraps, after.stats.exhausted, after.stats.maxNtimeRoll);
+
+        CHECK(after.repeated == 0.0, "size %d at %d ms: %.2f%% repeated", c.len, c.intervalMs, after.repeated);
+        CHECK(!after.ntimeAhead, "size %d at %d ms: ntime ahead", c.len, c.intervalMs);
+        if (c.len >= 2) {
+            CHECK(after.stats.exhausted == 0, "size %d exhausted", c.len);
+        }
+        if (c.len == 2 && c.intervalMs == 10) {
+            CHECK(before.repeated > 10.0, "reference without repeated work");
+        }
+    }
+}
+
+int main()
+{
+    test_rules();
+    test_mining();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,384 @@
+// Host test of the fan controller on a simulated fan and a hashing board.
+//
+//   c++ -O2 -std=gnu++17 -Istubs -I.. -o fan_controller_sim fan_controller_sim.cpp ../tasks/fan_controller.cpp
+//   ./fan_controller_sim
+//
+// stubs/ has minimal stand-ins for the ESP-IDF log and timer, the NVS
+// config and the board.
+//
+// The fan spins 900 rpm + 51 rpm per % above 8% PWM and follows a change
+// with a lag. The chips are 80 W through a thermal resistance of
+// 0.15-0.60 °C/W depending on the fan rpm, with a time constant of 15 s.
+// The fan speed is requested by a PI controller on 55 °C like the PID of
+// the power management (15-100%). A step is 2 s like the power management
+// loop.
+//
+// - first boot while hashing: the sweep stays at or above the requested
+//   speed and 20%, the temp stays below the abort margin, the curve is
+//   saved with the low points extrapolated below the real rpm
+// - the sweep without the floor like before: down to 10% while hashing
+// - manual fan speed: no sweep, it starts once the control is automatic
+// - not hashing: the full sweep down to 10%
+// - 2 h of operation at 20-35 °C ambient without a false degraded or
+//   stalled fan, then a worn fan is flagged degraded and a stopped one
+//   stalled with the output at 100%
+// - noise limit: the rpm stays below the limit, when hot the frequency is
+//   stepped down. A manual fan speed is neither capped nor throttled
+//
+// Result on a x86 Linux box:
+//   first boot sweep (25 °C)   min fan  peak temp  points measured  curve saved
+//   before: down to 10%            10%     60.5 °C          9           no (aborted)
+//   floor while hashing            20%     57.4 °C          8           yes
+//   not hashing                    10%     25.9 °C         10           yes
+//   (peak temp: during the sweep, the abort margin is 60 °C)
+//   worn fan (60% rpm) flagged after 54 s, stopped fan after 22 s, max
+//   3450 rpm at a 3500 rpm limit with 8 frequency steps down at 35 °C
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "esp_timer.h"
+#include "nvs_config.h"
+#include "tasks/fan_controller.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                         \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__);                                                                          \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+#define STEP_US 2000000LL
+#define TARGET 55.0f
+#define POWER 80.0f
+
+// ------------ models
+
+struct Fan
+{
+    float rpm = 6000.0f; // 100% at boot
+    float wear = 1.0f; // share of the rpm a worn fan reaches
+    bool stopped = false;
+
+    static float trueRPM(float perc)
+    {
+        return perc < 8.0f ? 0.0f : 900.0f + 51.0f * perc;
+    }
+
+    void step(uint16_t perc)
+    {
+        float target = stopped ? 0.0f : trueRPM(perc) * wear;
+        rpm += 0.6f * (target - rpm);
+    }
+};
+
+struct Chips
+{
+    float ambient = 25.0f;
+    float temp = 25.0f;
+
+    void step(float rpm, float power)
+    {
+        float res = 0.15f + 0.45f * (1.0f - std::min(rpm, 6000.0f) / 6000.0f);
+        float steady = ambient + res * power;
+        temp += (steady - temp) * (1.0f - expf(-2.0f / 15.0f));
+    }
+};
+
+// the PID of the power management, reverse acting, 15-100%
+struct Control
+{
+    float out = 100.0f;
+
+    uint16_t step(float temp)
+    {
+        out = std::clamp(out + 1.5f * (temp - TARGET), 15.0f, 100.0f);
+        return (uint16_t) roundf(out);
+    }
+};
+
+struct Run
+{
+    Board board;
+    FanController fans;
+    Fan fan;
+    Chips chips;
+    Control control;
+    uint16_t out = 100;
+    uint16_t lastRPM[FAN_MAX_CHANNELS]{};
+
+    // results of the sweep
+    uint16_t minDuringSweep = 100;
+    uint16_t minFloorViolation = 0; // output below the request while hashing
+    float peakTemp = 0.0f;
+
+    void init()
+    {
+        board.numFans = 1;
+        fans.init(&board);
+    }
+
+    // one power management loop. simulateHashing is the board, hashing what
+    // the controller is told
+    void step(bool simulateHashing, bool hashing, uint16_t manualPerc = 0)
+    {
+        host_time_us += STEP_US;
+        fan.step(out);
+        chips.step(fan.rpm, simulateHashing ? POWER : 2.0f);
+
+        lastRPM[0] = (uint16_t) fan.rpm;
+        uint16_t requested = control.step(chips.temp);
+        if (manualPerc) {
+            requested = manualPerc;
+        }
+
+        fans.loadSettings();
+        bool sweeping = fans.isCharacterizing();
+        out = fans.process(requested, lastRPM, chips.temp, simulateHashing ? POWER : 2.0f, TARGET, hashing);
+        if (sweeping || fans.isCharacterizing()) {
+            peakTemp = std::max(peakTemp, chips.temp);
+            minDuringSweep = std::min(minDuringSweep, out);
+            if (simulateHashing && out < requested) {
+                minFloorViolation++;
+            }
+        }
+    }
+};
+
+static int parse_curve(uint16_t *curve)
+{
+    char *str = Config::getFanCurve(0);
+    int n = 0;
+    for (char *p = str; *p && n < FAN_CURVE_POINTS;) {
+        char *end;
+        curve[n++] = (uint16_t) strtol(p, &end, 10);
+        p = (*end == ',') ? end + 1 : end;
+    }
+    free(str);
+    return n;
+}
+
+static void reset_nvs(uint16_t mode)
+{
+    host_nvs.clear();
+    Config::setTempControlMode(mode);
+}
+
+// ------------ first boot sweep
+
+static int measured_points(const uint16_t *curve)
+{
+    // extrapolated points are exactly on the line through 0 of the lowest
+    // measured point, measured ones of this fan aren't
+    int n = 0;
+    for (int i = 0; i < FAN_CURVE_POINTS; i++) {
+        if (fabsf((float) curve[i] - Fan::trueRPM((i + 1) * 10)) < 60.0f) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static void sweep_case(const char *name, bool simulateHashing, bool hashing, bool expectFloor)
+{
+    reset_nvs(2);
+    Run r;
+    r.init();
+
+    for (int i = 0; i < 450; i++) {
+        r.step(simulateHashing, hashing);
+    }
+
+    uint16_t curve[FAN_CURVE_POINTS]{};
+    bool saved = parse_curve(curve) == FAN_CURVE_POINTS;
+
+    int measured = saved ? measured_points(curve) : 0;
+
+    // points measured before the abort
+    if (!saved) {
+        measured = (100 - r.minDuringSweep) / 10 + 1;
+        measured = std::max(0, measured - 1);
+    }
+
+    printf("  %-26s %6u%%   %6.1f °C      %5d           %s\n", name, r.minDuringSweep, r.peakTemp, measured,
+           saved ? "yes" : "no (aborted)");
+
+    if (!expectFloor) {
+        return;
+    }
+
+    CHECK(saved, "%s: curve not saved", name);
+    CHECK(r.peakTemp < TARGET + 5.0f, "%s: %.1f °C", name, r.peakTemp);
+    if (hashing) {
+        CHECK(r.minDuringSweep >= 20 && !r.minFloorViolation, "%s: fan at %u%%, %u times below the request", name,
+              r.minDuringSweep, r.minFloorViolation);
+        // the extrapolation is below the real fan, no false degraded
+        for (int i = 0; i < FAN_CURVE_POINTS; i++) {
+            CHECK(curve[i] <= Fan::trueRPM((i + 1) * 10) + 60.0f, "%s: point %d %u rpm above the fan", name, i, curve[i]);
+        }
+    } else {
+        CHECK(measured == FAN_CURVE_POINTS, "%s: %d points measured", name, measured);
+    }
+}
+
+static void test_sweep()
+{
+    printf("first boot sweep (25 °C)   min fan  peak temp  points measured  curve saved\n");
+    sweep_case("before: down to 10%", true, false, false);
+    sweep_case("floor while hashing", true, true, true);
+    sweep_case("not hashing", false, false, true);
+}
+
+// ------------ manual fan speed
+
+static void test_manual()
+{
+    printf("manual fan speed\n");
+
+    reset_nvs(0);
+    Run r;
+    r.init();
+
+    bool changed = false;
+    for (int i = 0; i < 300; i++) {
+        r.step(true, true, 40);
+        changed |= r.out != 40 || r.fans.isCharacterizing();
+    }
+    uint16_t curve[FAN_CURVE_POINTS];
+    CHECK(!changed, "sweep in manual mode");
+    CHECK(parse_curve(curve) == 0, "curve saved in manual mode");
+
+    // automatic control, the scheduled sweep runs now
+    Config::setTempControlMode(2);
+    bool swept = false;
+    for (int i = 0; i < 300; i++) {
+        r.step(true, true);
+        swept |= r.fans.isCharacterizing();
+    }
+    CHECK(swept && parse_curve(curve) == FAN_CURVE_POINTS, "no sweep after switching to automatic");
+
+    // switching to manual during a sweep aborts it
+    reset_nvs(2);
+    Run m;
+    m.init();
+    for (int i = 0; i < 10; i++) {
+        m.step(true, true);
+    }
+    CHECK(m.fans.isCharacterizing(), "sweep not running");
+    Config::setTempControlMode(0);
+    m.step(true, true, 40);
+    CHECK(!m.fans.isCharacterizing() && m.out == 40, "sweep not aborted, fan at %u%%", m.out);
+}
+
+// ------------ health and noise limit
+
+static void test_health()
+{
+    printf("health\n");
+
+    reset_nvs(2);
+    Run r;
+    r.init();
+    for (int i = 0; i < 300; i++) {
+        r.step(true, true);
+    }
+
+    // 2 h at changing ambient temps
+    bool falseAlarm = false;
+    for (int i = 0; i < 3600; i++) {
+        r.chips.ambient = 27.5f + 7.5f * sinf((float) i / 600.0f);
+        r.step(true, true);
+        falseAlarm |= r.fans.getHealth(0) != FanController::FAN_OK;
+    }
+    CHECK(!falseAlarm, "healthy fan flagged");
+
+    // worn fan
+    r.fan.wear = 0.6f;
+    int samples = 0;
+    while (r.fans.getHealth(0) != FanController::FAN_DEGRADED && samples < 600) {
+        r.step(true, true);
+        samples++;
+    }
+    CHECK(r.fans.getHealth(0) == FanController::FAN_DEGRADED, "worn fan not flagged");
+    printf("  worn fan flagged after %d s\n", samples * 2);
+
+    // stopped fan
+    r.fan.stopped = true;
+    samples = 0;
+    while (r.fans.getHealth(0) != FanController::FAN_STALLED && samples < 20) {
+        r.step(true, true);
+        samples++;
+    }
+    CHECK(r.fans.getHealth(0) == FanController::FAN_STALLED, "stopped fan not flagged");
+    r.step(true, true);
+    CHECK(r.out == 100, "output %u%% with a stalled fan", r.out);
+    printf("  stopped fan flagged after %d s\n", samples * 2);
+}
+
+static void test_noise_limit()
+{
+    printf("noise limit\n");
+
+    reset_nvs(2);
+    Run r;
+    r.init();
+    for (int i = 0; i < 300; i++) {
+        r.step(true, true);
+    }
+
+    Config::setFanMaxRPM(3500);
+    r.chips.ambient = 35.0f;
+    float maxRPM = 0.0f;
+    int maxSteps = 0;
+    for (int i = 0; i < 900; i++) {
+        r.step(true, true);
+        if (i > 10) {
+            maxRPM = std::max(maxRPM, r.fan.rpm);
+        }
+        maxSteps = std::max(maxSteps, r.fans.getThrottleSteps());
+    }
+    CHECK(maxRPM <= 3500.0f, "%.0f rpm above the limit", maxRPM);
+    CHECK(maxSteps > 0, "hot without a frequency step down");
+    printf("  max %.0f rpm at a 3500 rpm limit, %d frequency steps down\n", maxRPM, maxSteps);
+
+    // limit removed, the frequency is restored
+    Config::setFanMaxRPM(0);
+    r.step(true, true);
+    CHECK(r.fans.getThrottleSteps() == 0, "throttle kept without a limit");
+
+    // a manual fan speed above the limit is kept, throttling ends
+    Config::setFanMaxRPM(3500);
+    for (int i = 0; i < 300; i++) {
+        r.step(true, true);
+    }
+    CHECK(r.fans.getThrottleSteps() > 0, "not throttled before manual mode");
+    Config::setTempControlMode(0);
+    r.step(true, true, 90);
+    CHECK(r.out == 90, "manual fan speed capped to %u%%", r.out);
+    CHECK(r.fans.getThrottleSteps() == 0, "throttle kept in manual mode");
+}
+
+int main()
+{
+    test_sweep();
+    test_manual();
+    test_health();
+    test_noise_limit();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,323 @@
+// Host test of the ASIC job slot bookkeeping against a simulated ASIC chain.
+//
+//   c++ -O2 -std=gnu++17 -I../tasks -o job_slots_sim job_slots_sim.cpp ../tasks/job_slots.cpp
+//   ./job_slots_sim
+//
+// Checks the JobSlots rules and the interval policy, then runs 120 s of a
+// simulated BM1370 chain (16 job slots, job ID = extranonce2 * 24 & 0x7f)
+// at several job intervals:
+//
+// - results of the job running on the ASICs, 400/s (Poisson)
+// - delivery after 1 ms UART plus 5 ms avg queueing, about every 5 s the
+//   result task is blocked for 100-400 ms (flash writes, HTTP, logging) and
+//   the results arrive afterwards in one go
+// - a clean_jobs notify every 30 s drops all jobs
+// - a result verified against the wrong job passes the ASIC difficulty
+//   with 4/256
+//
+// Compared are the lookup like before (the job in the slot only) and the
+// slot bookkeeping without and with the interval policy. Counted as lost
+// are results of valid jobs that weren't verified.
+//
+// Result on a x86 Linux box:
+//   interval  before: lost  hw-err | slots: late  stale  hw-err | policy: interval  lost
+//     10 ms           1.7%   1.6%  |        1.5%   0.0%   0.2%  |          42 ms    0.1%
+//     20 ms           0.3%   0.3%  |        0.3%   0.0%   0.0%  |          45 ms    0.0%
+//     50 ms           0.0%   0.0%  |        0.0%   0.0%   0.0%  |          50 ms    0.0%
+//    100 ms           0.0%   0.0%  |        0.0%   0.0%   0.0%  |         100 ms    0.0%
+//    500 ms           0.0%   0.0%  |        0.0%   0.0%   0.0%  |         500 ms    0.0%
+// (hw-err: results of valid jobs counted as hardware errors, late: verified
+// against the previous job of the slot)
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "job_slots.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                         \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__);                                                                          \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+// ------------ rules
+
+static uint8_t bm1370_job_id(uint32_t extranonce2)
+{
+    return (uint8_t) ((extranonce2 * 24) & 0x7f);
+}
+
+static void test_rules()
+{
+    printf("rules\n");
+
+    JobSlots s;
+
+    // slot 0 twice, 15 others in between
+    s.dispatch(0, 0);
+    for (int i = 1; i < 16; i++) {
+        s.dispatch(bm1370_job_id(i), i * 1000);
+    }
+    CHECK(s.getGeneration(0) == 1, "generation %u", s.getGeneration(0));
+    s.dispatch(0, 16000);
+    CHECK(s.getGeneration(0) == 2, "generation %u", s.getGeneration(0));
+
+    // current, no lateness while the job runs
+    CHECK(s.classify(0, true, false, true, 16500) == JOB_RESULT_CURRENT, "not current");
+    CHECK(s.getLateUs() == JOB_SLOTS_MIN_LATE_US, "lateness without late result");
+
+    // result of the first job, retired at 1000 us, arriving at 17000 us
+    CHECK(s.classify(0, false, true, true, 17000) == JOB_RESULT_LATE, "not late");
+    CHECK(s.getLateUs() == JOB_SLOTS_MIN_LATE_US, "below the floor");
+    CHECK(s.classify(0, false, true, true, 101000) == JOB_RESULT_LATE, "not late");
+    CHECK(s.getLateUs() == 100000, "lateness %lld", (long long) s.getLateUs());
+
+    // nothing verified: stale while the slot is fresh and the previous job
+    // is gone, a hardware error otherwise
+    CHECK(s.classify(0, false, false, false, 116000) == JOB_RESULT_STALE, "not stale");
+    CHECK(s.classify(0, false, false, true, 116000) == JOB_RESULT_INVALID, "known job not invalid");
+    CHECK(s.classify(0, false, false, false, 16000 + 200001) == JOB_RESULT_INVALID, "old slot stale");
+
+    // a running job that gets a result after it was retired
+    s.dispatch(1, 300000);
+    CHECK(s.classify(0, true, false, true, 450000) == JOB_RESULT_CURRENT, "not current");
+    CHECK(s.getLateUs() == 150000, "lateness %lld", (long long) s.getLateUs());
+
+    job_slot_stats_t st;
+    s.getStats(&st);
+    CHECK(st.dispatched == 18 && st.current == 2 && st.late == 2 && st.stale == 1 && st.invalid == 2,
+          "stats %u %u %u %u %u", st.dispatched, st.current, st.late, st.stale, st.invalid);
+    CHECK(st.maxLateUs == 150000, "max late %lld", (long long) st.maxLateUs);
+
+    // the lateness peak fades
+    for (int i = 0; i < 1000; i++) {
+        s.dispatch(2, 500000 + i);
+    }
+    CHECK(s.getLateUs() < 60000, "lateness didn't fade, %lld", (long long) s.getLateUs());
+
+    // policy: 16 slots, 300 ms late -> 40 ms
+    CHECK(JobSlots::minIntervalMs(16, 300000) == 40, "min %d", JobSlots::minIntervalMs(16, 300000));
+    CHECK(JobSlots::minIntervalMs(1, 300000) == 0, "min for one slot");
+    // 5 TH/s without version rolling: 0.43 ms, with 16 bits: 28 s
+    CHECK(JobSlots::maxIntervalMs(5000.0, 0) == 0, "max %d", JobSlots::maxIntervalMs(5000.0, 0));
+    CHECK(JobSlots::maxIntervalMs(5000.0, 16) == 28147, "max %d", JobSlots::maxIntervalMs(5000.0, 16));
+    CHECK(JobSlots::policyIntervalMs(10, 16, 300000, 5000.0, 16) == 40, "not raised");
+    CHECK(JobSlots::policyIntervalMs(500, 16, 300000, 5000.0, 16) == 500, "changed");
+    CHECK(JobSlots::policyIntervalMs(60000, 16, 300000, 5000.0, 16) == 28147, "not lowered");
+    CHECK(JobSlots::policyIntervalMs(500, 16, 300000, 5000.0, 0) == 500, "lowered below the slot minimum");
+}
+
+// ------------ simulated ASIC chain
+
+static const double RESULTS_PER_S = 400.0;
+static const double RUN_S = 120.0;
+static const double FALSE_MATCH = 4.0 / 256.0;
+
+struct Event
+{
+    double t;
+    int type; // 0 dispatch, 1 result found, 2 result delivered
+    int64_t job;
+    bool operator>(const Event &o) const
+    {
+        return t > o.t || (t == o.t && type > o.type);
+    }
+};
+
+struct RunResult
+{
+    uint32_t results = 0;  // delivered results of valid jobs
+    uint32_t lost = 0;     // of them not verified
+    uint32_t hwErrors = 0; // of them counted as hardware errors
+    uint32_t late = 0;
+    uint32_t stale = 0;
+    int intervalMs = 0; // at the end
+};
+
+// mode 0: lookup like before, 1: slots, 2: slots and policy
+static RunResult run(int configuredMs, int mode, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+    std::exponential_distribution<double> gap(RESULTS_PER_S);
+    std::exponential_distribution<double> queueing(1.0 / 0.005);
+
+    // result task stalls
+    std::vector<std::pair<double, double>> stalls;
+    for (double t = 0.0; t < RUN_S;) {
+        t += 2.0 + uni(rng) * 6.0;
+        stalls.push_back({t, t + 0.1 + uni(rng) * 0.3});
+    }
+    auto deliver_at = [&](double t) {
+        for (auto &s : stalls) {
+            if (t >= s.first && t < s.second) {
+                return s.second;
+            }
+        }
+        return t;
+    };
+
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> q;
+
+    JobSlots slots;
+    int64_t active[JOB_SLOTS_MAX];
+    int64_t prev[JOB_SLOTS_MAX];
+    for (int i = 0; i < JOB_SLOTS_MAX; i++) {
+        active[i] = prev[i] = -1;
+    }
+    std::vector<bool> valid;      // job not dropped by clean_jobs
+    std::vector<uint8_t> slotOf;  // job -> slot
+
+    RunResult r;
+    int64_t running = -1;
+    int intervalMs = configuredMs;
+    double nextClean = 30.0;
+
+    q.push({0.0, 0, 0});
+
+    while (!q.empty()) {
+        Event e = q.top();
+        q.pop();
+        if (e.t > RUN_S) {
+            break;
+        }
+
+        if (e.type == 0) {
+            if (e.t >= nextClean) {
+                // clean_jobs: cleanJobs() drops everything of the pool
+                nextClean += 30.0;
+                for (size_t j = 0; j < valid.size(); j++) {
+                    valid[j] = false;
+                }
+                for (int i = 0; i < JOB_SLOTS_MAX; i++) {
+                    active[i] = prev[i] = -1;
+                }
+            }
+
+            int64_t job = (int64_t) valid.size();
+            uint8_t slot = bm1370_job_id((uint32_t) job);
+            valid.push_back(true);
+            slotOf.push_back(slot);
+
+            int64_t us = (int64_t) (e.t * 1e6);
+            prev[slot] = active[slot];
+            active[slot] = job;
+            slots.dispatch(slot, us);
+            running = job;
+
+            // first result of the new job
+            q.push({e.t + gap(rng), 1, job});
+
+            if (mode == 2) {
+                intervalMs = JobSlots::policyIntervalMs(configuredMs, 16, slots.getLateUs(), 5000.0, 16);
+            }
+            q.push({e.t + intervalMs / 1000.0, 0, 0});
+            continue;
+        }
+
+        if (e.type == 1) {
+            // the chips moved on to the next job
+            if (e.job != running) {
+                continue;
+            }
+            q.push({deliver_at(e.t + 0.001 + queueing(rng)), 2, e.job});
+            q.push({e.t + gap(rng), 1, e.job});
+            continue;
+        }
+
+        // delivered
+        int64_t job = e.job;
+        uint8_t slot = slotOf[job];
+        bool isValid = valid[job];
+        if (isValid) {
+            r.results++;
+        }
+
+        auto matches = [&](int64_t candidate) {
+            return candidate >= 0 && (candidate == job || uni(rng) < FALSE_MATCH);
+        };
+
+        if (mode == 0) {
+            // job in the slot only, a wrong job is a hardware error
+            int64_t cur = active[slot];
+            if (cur < 0) {
+                r.lost += isValid;
+            } else if (cur != job) {
+                r.lost += isValid;
+                r.hwErrors += isValid && !matches(cur);
+            }
+            continue;
+        }
+
+        bool matchCurrent = matches(active[slot]);
+        bool matchPrev = !matchCurrent && matches(prev[slot]);
+        job_result_t kind = slots.classify(slot, matchCurrent, matchPrev, prev[slot] >= 0, (int64_t) (e.t * 1e6));
+
+        bool verified = (matchCurrent && active[slot] == job) || (matchPrev && prev[slot] == job);
+        if (isValid && !verified) {
+            r.lost++;
+            r.hwErrors += kind == JOB_RESULT_INVALID;
+        }
+        r.late += kind == JOB_RESULT_LATE;
+        r.stale += kind == JOB_RESULT_STALE;
+    }
+
+    r.intervalMs = intervalMs;
+    return r;
+}
+
+static double pct(uint32_t n, uint32_t total)
+{
+    return total ? 100.0 * n / total : 0.0;
+}
+
+int main()
+{
+    test_rules();
+
+    printf("simulated BM1370 chain, %.0f results/s, %.0f s\n", RESULTS_PER_S, RUN_S);
+    printf("interval  before: lost  hw-err | slots: late  stale  hw-err | policy: interval  lost\n");
+
+    const int intervals[] = {10, 20, 50, 100, 500};
+    RunResult before[5], withSlots[5], withPolicy[5];
+
+    for (int i = 0; i < 5; i++) {
+        before[i] = run(intervals[i], 0, 1);
+        withSlots[i] = run(intervals[i], 1, 1);
+        withPolicy[i] = run(intervals[i], 2, 1);
+        printf("  %3d ms          %4.1f%%  %4.1f%%  |       %4.1f%%  %4.1f%%  %4.1f%%   |        %4d ms    %4.1f%%\n",
+               intervals[i], pct(before[i].lost, before[i].results), pct(before[i].hwErrors, before[i].results),
+               pct(withSlots[i].late, withSlots[i].results), pct(withSlots[i].stale, withSlots[i].results),
+               pct(withSlots[i].hwErrors, withSlots[i].results), withPolicy[i].intervalMs,
+               pct(withPolicy[i].lost, withPolicy[i].results));
+    }
+
+    // at 10 ms the slots are reused within a stall
+    CHECK(pct(before[0].hwErrors, before[0].results) > 1.0, "reference without hardware errors");
+    CHECK(withSlots[0].hwErrors < before[0].hwErrors / 2, "late results still hardware errors");
+    CHECK(withSlots[0].late > 0, "no late results recovered");
+    CHECK(pct(withPolicy[0].lost, withPolicy[0].results) < 0.1, "policy didn't help");
+    CHECK(withPolicy[0].intervalMs > 10, "interval not raised");
+
+    // nothing changes at the usual intervals
+    CHECK(withPolicy[4].intervalMs == 500, "500 ms changed to %d", withPolicy[4].intervalMs);
+    CHECK(before[4].lost == 0 && withSlots[4].lost == 0, "results lost at 500 ms");
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""
+Minimal stratum+ssl pool for testing the TLS transport.
+
+  python3 mock_tls_pool.py --port 3334 [--tls12] [--no-tickets] [--ecdsa]
+
+On start a throwaway CA and a leaf for "localhost" are generated with the
+openssl CLI (into --dir, default a temp dir). The CA PEM is what goes into
+stratumTLSCert to test pinning, a self signed leaf can be pinned the same
+way. Every connection gets canned answers to mining.subscribe,
+mining.authorize, mining.configure and mining.suggest_difficulty followed
+by one mining.notify, submits are accepted.
+
+The log shows per connection the negotiated version, suite, whether the
+session was resumed and the max fragment length the client asked for.
+Only the Python 3 standard library and the openssl CLI are needed.
+"""
+
+import argparse
+import json
+import os
+import socketserver
+import ssl
+import subprocess
+import tempfile
+import threading
+
+args = None
+lock = threading.Lock()
+stats = {"connections": 0, "resumed": 0, "submits": 0}
+
+NOTIFY = {
+    "id": None,
+    "method": "mining.notify",
+    "params": [
+        "1f",
+        "4d16b6f85af6e2198f44ae2a6de67f78487ae5611b77c6c0440b921e00000000",
+        "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff20020862062f503253482f04b8864e5008",
+        "072f736c7573682f000000000100f2052a010000001976a914d23fcdf86f7e756a64a7a9688ef9903327048ed988ac00000000",
+        [],
+        "00000002",
+        "1c2ac4af",
+        "504e86b9",
+        True,
+    ],
+}
+
+
+def openssl(*cmd):
+    subprocess.run(["openssl", *cmd], check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+
+def make_certs(d, ecdsa):
+    ca_key, ca_crt = os.path.join(d, "ca.key"), os.path.join(d, "ca.pem")
+    key, csr, crt = os.path.join(d, "pool.key"), os.path.join(d, "pool.csr"), os.path.join(d, "pool.pem")
+    ext = os.path.join(d, "ext.cnf")
+    keyargs = ["-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:P-256"] if ecdsa else ["-newkey", "rsa:2048"]
+
+    openssl("req", "-x509", *keyargs, "-nodes", "-keyout", ca_key, "-out", ca_crt,
+            "-days", "30", "-subj", "/CN=mock pool CA")
+    openssl("req", *keyargs, "-nodes", "-keyout", key, "-out", csr, "-subj", "/CN=localhost")
+    with open(ext, "w") as f:
+        f.write("subjectAltName=DNS:localhost,IP:127.0.0.1\n")
+    openssl("x509", "-req", "-in", csr, "-CA", ca_crt, "-CAkey", ca_key, "-CAcreateserial",
+            "-out", crt, "-days", "30", "-extfile", ext)
+    return ca_crt, crt, key
+
+
+def reply(msg):
+    method = msg.get("method")
+    mid = msg.get("id")
+    if method == "mining.subscribe":
+        return [{"id": mid, "result": [[["mining.notify", "ae6812eb4cd7735a302a8a9dd95cf71f"]], "08000002", 4], "error": None},
+                {"id": None, "method": "mining.set_difficulty", "params": [512]},
+                NOTIFY]
+    if method == "mining.submit":
+        with lock:
+            stats["submits"] += 1
+    if method == "mining.configure":
+        return [{"id": mid, "result": {"version-rolling": True, "version-rolling.mask": "1fffe000"}, "error": None}]
+    return [{"id": mid, "result": True, "error": None}]
+
+
+class Handler(socketserver.StreamRequestHandler):
+    def handle(self):
+        conn = self.request
+        resumed = conn.session_reused
+        with lock:
+            stats["connections"] += 1
+            stats["resumed"] += int(resumed)
+            n = stats["connections"]
+        print(f"#{n} {self.client_address[0]} {conn.version()} {conn.cipher()[0]} "
+              f"{'resumed' if resumed else 'full handshake'}", flush=True)
+
+        for line in self.rfile:
+            line = line.strip()
+            if not line:
+                continue
+            try:
+                msg = json.loads(line)
+            except ValueError:
+                print(f"#{n} bad json: {line[:80]!r}", flush=True)
+                continue
+            for r in reply(msg):
+                self.wfile.write((json.dumps(r) + "\n").encode())
+            self.wfile.flush()
+        print(f"#{n} closed", flush=True)
+
+
+class Server(socketserver.ThreadingMixIn, socketserver.TCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+    def __init__(self, addr, ctx):
+        super().__init__(addr, Handler)
+        self.ctx = ctx
+
+    def get_request(self):
+        sock, addr = self.socket.accept()
+        return self.ctx.wrap_socket(sock, server_side=True), addr
+
+    def handle_error(self, request, client_address):
+        # failed handshakes (wrong pin, unsupported suites) are expected
+        print(f"error from {client_address[0]}", flush=True)
+
+
+def main():
+    global args
+    p = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    p.add_argument("--port", type=int, default=3334)
+    p.add_argument("--bind", default="0.0.0.0")
+    p.add_argument("--dir", help="where to put the generated certificates")
+    p.add_argument("--tls12", action="store_true", help="limit to TLS 1.2")
+    p.add_argument("--no-tickets", action="store_true", help="no session tickets (TLS 1.2 falls back to session IDs)")
+    p.add_argument("--ecdsa", action="store_true", help="P-256 keys instead of RSA 2048")
+    args = p.parse_args()
+
+    d = args.dir or tempfile.mkdtemp(prefix="mock_tls_pool_")
+    os.makedirs(d, exist_ok=True)
+    ca, crt, key = make_certs(d, args.ecdsa)
+
+    ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    ctx.load_cert_chain(crt, key)
+    if args.tls12:
+        ctx.maximum_version = ssl.TLSVersion.TLSv1_2
+    if args.no_tickets:
+        ctx.options |= ssl.OP_NO_TICKET
+        ctx.num_tickets = 0
+
+    print(f"CA (pin this): {ca}", flush=True)
+    print(f"listening on {args.bind}:{args.port}", flush=True)
+    Server((args.bind, args.port), ctx).serve_forever()
+
+
+if __name__ == "__main__":
+    main()
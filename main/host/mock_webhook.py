@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""
+Mock webhook server for the alerter, injects failures and latency.
+
+  python3 mock_webhook.py --port 8099 --fail-rate 0.3 --latency 200 --limit 5
+
+Paths select the expected payload format:
+
+  /discord/...        {"content": ...}
+  /telegram/...       {"chat_id": ..., "text": ...}
+  /ntfy               {"topic": ..., "message": ..., "title": ..., "tags": [...]}
+  /generic/...        {"host": {...}, "alerts": [{"kind": ..., "message": ...}]}
+
+Point the miner (or host/alert_sim) at http://<this host>:<port>/<type>.
+GET /stats returns what was received per type, POST /reset clears it.
+Only the Python 3 standard library is needed.
+"""
+
+import argparse
+import json
+import random
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+lock = threading.Lock()
+stats = {}
+args = None
+start_time = time.time()
+
+
+def type_stats(kind):
+    return stats.setdefault(kind, {
+        "requests": 0, "ok": 0, "failed": 0, "limited": 0, "early": 0, "invalid": 0,
+        "window": [], "retry_at": 0.0, "messages": [],
+    })
+
+
+def validate(kind, body):
+    try:
+        doc = json.loads(body)
+    except ValueError:
+        return None, "no JSON"
+    if kind == "discord":
+        if not isinstance(doc.get("content"), str) or len(doc["content"]) > 2000:
+            return None, "content"
+        return doc["content"], None
+    if kind == "telegram":
+        if "chat_id" not in doc or not isinstance(doc.get("text"), str):
+            return None, "chat_id/text"
+        return doc["text"], None
+    if kind == "ntfy":
+        if not doc.get("topic") or not isinstance(doc.get("message"), str) or not isinstance(doc.get("tags"), list):
+            return None, "topic/message/tags"
+        return doc["message"], None
+    if kind == "generic":
+        alerts = doc.get("alerts")
+        if not isinstance(doc.get("host"), dict) or not isinstance(alerts, list) or not alerts:
+            return None, "host/alerts"
+        if any(not isinstance(a.get("message"), str) or "kind" not in a for a in alerts):
+            return None, "alert"
+        return "\n".join(a["message"] for a in alerts), None
+    return None, "unknown path"
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *a):
+        if args.verbose:
+            BaseHTTPRequestHandler.log_message(self, fmt, *a)
+
+    def reply(self, status, body=b"", headers=None):
+        self.send_response(status)
+        for k, v in (headers or {}).items():
+            self.send_header(k, v)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_GET(self):
+        if self.path != "/stats":
+            return self.reply(404)
+        with lock:
+            out = {k: {kk: vv for kk, vv in v.items() if kk not in ("window", "retry_at")} for k, v in stats.items()}
+        self.reply(200, json.dumps(out).encode(), {"Content-Type": "application/json"})
+
+    def do_POST(self):
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        if self.path == "/reset":
+            with lock:
+                stats.clear()
+            return self.reply(200)
+
+        kind = self.path.strip("/").split("/")[0]
+        now = time.time()
+
+        if args.latency:
+            time.sleep(random.uniform(0, args.latency / 1000.0))
+
+        with lock:
+            s = type_stats(kind)
+            s["requests"] += 1
+            # requests before the Retry-After of the last 429 ran out
+            if now < s["retry_at"]:
+                s["early"] += 1
+
+            if now - start_time < args.down:
+                s["failed"] += 1
+                status = 503
+            elif args.limit and len([t for t in s["window"] if now - t < 1.0]) >= args.limit:
+                s["limited"] += 1
+                s["retry_at"] = now + args.retry_after
+                status = 429
+            elif random.random() < args.fail_rate:
+                s["failed"] += 1
+                status = random.choice([500, 502, 503])
+            else:
+                text, error = validate(kind, body)
+                if error:
+                    s["invalid"] += 1
+                    print("invalid %s payload (%s): %r" % (kind, error, body[:200]))
+                    status = 400
+                else:
+                    s["ok"] += 1
+                    s["messages"].append(text)
+                    s["window"] = [t for t in s["window"] if now - t < 1.0] + [now]
+                    status = 200 if kind != "discord" else 204
+
+        if status == 429:
+            retry = "%.3f" % args.retry_after
+            self.reply(429, json.dumps({"retry_after": args.retry_after}).encode(), {"Retry-After": retry})
+        else:
+            self.reply(status)
+
+
+def main():
+    global args
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8099)
+    parser.add_argument("--fail-rate", type=float, default=0.0, help="share of requests answered with 5xx")
+    parser.add_argument("--latency", type=int, default=0, help="max random response delay (ms)")
+    parser.add_argument("--limit", type=int, default=0, help="accepted requests per second and type, 429 above")
+    parser.add_argument("--retry-after", type=float, default=1.0, help="Retry-After of 429 responses (s)")
+    parser.add_argument("--down", type=float, default=0.0, help="answer 503 for the first seconds")
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(("", args.port), Handler)
+    print("mock webhook listening on port %d" % args.port)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    with lock:
+        for kind, s in sorted(stats.items()):
+            print("%-8s requests %d ok %d failed %d limited %d early %d invalid %d" % (
+                kind, s["requests"], s["ok"], s["failed"], s["limited"], s["early"], s["invalid"]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,265 @@
+// Host test of the TOTP window and the rate limit of failed OTP attempts.
+//
+//   c++ -O2 -std=gnu++17 -Istubs -I../otp -I../http_server -o otp_sim otp_sim.cpp ../otp/totp.cpp ../http_server/rate_limit.cpp -lcrypto
+//   ./otp_sim
+//
+// - RFC 6238 test vectors and the parser of the 6 digit codes
+// - window rules: step-1 .. step+1 are accepted once, the window stays
+//   anchored at the first accepted step until the time moves past it
+// - rate limit of one client: blocked after 5 failures in a burst, not
+//   at 1 failure every 12 s, other clients aren't affected and the block
+//   ends after 5 minutes
+// - an attacker with one guess per second for an hour that moves to a new
+//   address whenever one is blocked: guesses that reached the OTP check,
+//   against the table before that evicted blocked entries
+//
+// Result on a x86 Linux box:
+//   rotating addresses, 1 guess/s for 1 h:
+//     evicting blocked entries   3600 guesses checked (before)
+//     table full of blocked      480 guesses checked
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "rate_limit.h"
+#include "totp.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                         \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__);                                                                          \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+#define PERIOD 30
+
+static const uint8_t KEY[] = "12345678901234567890";
+static const size_t KEY_LEN = 20;
+
+static uint32_t hotp(uint64_t counter, int digits = 6)
+{
+    uint32_t code = 0;
+    hotp_sha1(KEY, KEY_LEN, counter, code, digits);
+    return code;
+}
+
+// OTP::validate without the NVS and the clock
+struct Validator
+{
+    int64_t base = 0;
+    uint8_t mask = 0;
+
+    bool verify(int64_t now, uint32_t code)
+    {
+        int64_t step = now / PERIOD;
+        uint32_t codes[3] = {hotp(step - 1), hotp(step), hotp(step + 1)};
+        int64_t b = base;
+        uint8_t m = mask;
+        if (!totp_verify_window(codes, step, code, b, m)) {
+            return false;
+        }
+        base = b;
+        mask = m;
+        return true;
+    }
+};
+
+static void test_codes()
+{
+    printf("codes\n");
+
+    const struct
+    {
+        int64_t time;
+        uint32_t code;
+    } vectors[] = {{59, 94287082}, {1111111109, 7081804}, {1111111111, 14050471}, {1234567890, 89005924}, {2000000000, 69279037}};
+    for (auto &v : vectors) {
+        CHECK(hotp(v.time / PERIOD, 8) == v.code, "RFC 6238 at %lld: %u", (long long) v.time, hotp(v.time / PERIOD, 8));
+    }
+
+    uint32_t code;
+    CHECK(totp_parse_code("123456", code) && code == 123456, "123456");
+    CHECK(totp_parse_code("123 456", code) && code == 123456, "with a space");
+    CHECK(totp_parse_code("000042", code) && code == 42, "leading zeros");
+    CHECK(!totp_parse_code("12345", code), "5 digits accepted");
+    CHECK(!totp_parse_code("1234567", code), "7 digits accepted");
+    CHECK(!totp_parse_code("12a456", code), "letter accepted");
+    CHECK(!totp_parse_code("", code), "empty accepted");
+}
+
+static void test_window()
+{
+    printf("window\n");
+
+    const int64_t t = 1111111109; // 1 s before a step boundary
+    const int64_t s = t / PERIOD;
+
+    Validator w;
+    CHECK(w.verify(t, hotp(s)), "current step");
+    CHECK(!w.verify(t, hotp(s)), "replay in the same step");
+    CHECK(!w.verify(t + 1, hotp(s)), "replay across the boundary");
+    CHECK(w.verify(t + 1, hotp(s + 1)), "new step");
+    // base+2 is outside even though it's step+1
+    CHECK(!w.verify(t + 1, hotp(s + 2)), "base+2 accepted");
+    CHECK(w.verify(t + 1 + PERIOD, hotp(s + 2)), "window didn't slide");
+    CHECK(!w.verify(t + 1 + PERIOD, hotp(s + 4)), "two steps ahead accepted");
+
+    Validator v;
+    CHECK(v.verify(t, hotp(s - 1)), "one step behind");
+    CHECK(!v.verify(t, hotp(s - 2)), "two steps behind accepted");
+    CHECK(v.verify(t, hotp(s + 1)), "one step ahead");
+    CHECK(v.verify(t, hotp(s)), "current after the neighbours");
+
+    Validator x;
+    CHECK(x.verify(t, hotp(s)), "current step");
+    CHECK(!x.verify(t + 3 * PERIOD, hotp(s)), "old code after the window moved on");
+
+    // a rejected code leaves the replay state alone
+    Validator y;
+    CHECK(!y.verify(t, hotp(s) ^ 1) && !y.base && !y.mask, "state changed by a wrong code");
+}
+
+static void addr_of(uint32_t n, uint32_t addr[4])
+{
+    // IPv4-mapped like esp_http_server reports them
+    addr[0] = 0;
+    addr[1] = 0;
+    addr[2] = 0xffff0000;
+    addr[3] = n;
+}
+
+static void test_client()
+{
+    printf("single client\n");
+
+    OtpRateLimit rl;
+    uint32_t a[4], b[4];
+    addr_of(1, a);
+    addr_of(2, b);
+    uint64_t ts = 1000;
+
+    int allowed = 0;
+    while (rl.fail(a, ts)) {
+        allowed++;
+        ts += 100;
+    }
+    CHECK(allowed == RL_FAIL_LIMIT - 1, "blocked after %d failures", allowed + 1);
+    CHECK(rl.isBlocked(a, ts), "not blocked");
+    CHECK(!rl.isBlocked(b, ts), "other client blocked");
+    CHECK(rl.isBlocked(a, ts + RL_BLOCK_SEC * 1000ull - 1), "block ended early");
+    CHECK(!rl.isBlocked(a, ts + RL_BLOCK_SEC * 1000ull), "block didn't end");
+
+    // a slow user never gets blocked
+    OtpRateLimit slow;
+    bool blocked = false;
+    for (int i = 0; i < 100; i++) {
+        blocked |= !slow.fail(a, 1000 + i * 12000ull);
+    }
+    CHECK(!blocked, "1 failure per 12 s blocked");
+}
+
+// the table before: when all entries were blocked the least recently seen
+// one was evicted, so a new address always got a fresh bucket
+class EvictingRateLimit : public OtpRateLimit {
+  protected:
+    Client *entry(const uint32_t addr[4])
+    {
+        for (auto &c : m_clients) {
+            if (c.used && !memcmp(c.addr, addr, sizeof(c.addr))) {
+                return &c;
+            }
+        }
+        return nullptr;
+    }
+
+  public:
+    bool isBlocked(const uint32_t addr[4], uint64_t ts)
+    {
+        Client *c = entry(addr);
+        return c && c->block_exp > ts;
+    }
+
+    bool fail(const uint32_t addr[4], uint64_t ts)
+    {
+        if (!entry(addr) && OtpRateLimit::isBlocked(addr, ts)) {
+            Client *victim = &m_clients[0];
+            for (auto &c : m_clients) {
+                if (c.last_ms < victim->last_ms) {
+                    victim = &c;
+                }
+            }
+            victim->used = false;
+        }
+        return OtpRateLimit::fail(addr, ts);
+    }
+};
+
+// one guess per second, each address until it gets blocked, returns the
+// guesses that reached the OTP check
+template <typename T> static int rotating_guesses(T &rl, uint64_t start, uint64_t seconds)
+{
+    int checked = 0;
+    uint32_t n = 100;
+    uint32_t addr[4];
+    for (uint64_t sec = 0; sec < seconds; sec++) {
+        uint64_t ts = start + sec * 1000;
+        addr_of(n, addr);
+        if (rl.isBlocked(addr, ts)) {
+            n++;
+            continue;
+        }
+        checked++;
+        if (!rl.fail(addr, ts)) {
+            n++;
+        }
+    }
+    return checked;
+}
+
+static void test_rotating()
+{
+    printf("rotating addresses, 1 guess/s for 1 h\n");
+
+    EvictingRateLimit evicting;
+    OtpRateLimit rl;
+    int before = rotating_guesses(evicting, 1000, 3600);
+    int now = rotating_guesses(rl, 1000, 3600);
+    printf("  evicting blocked entries %5d guesses checked\n", before);
+    printf("  table full of blocked    %5d guesses checked\n", now);
+
+    // every block period lets at most a full table of buckets through
+    int limit = RL_CLIENTS * RL_FAIL_LIMIT * (3600 / RL_BLOCK_SEC + 1);
+    CHECK(now <= limit, "%d guesses, limit %d", now, limit);
+    CHECK(before == 3600, "reference blocked the rotation: %d", before);
+
+    // everybody is locked out during the attack, but not for longer than
+    // a block after it stopped
+    uint32_t user[4];
+    addr_of(1, user);
+    uint64_t end = 1000 + 3600 * 1000ull;
+    CHECK(rl.isBlocked(user, end), "new client not blocked by a full table");
+    CHECK(!rl.isBlocked(user, end + RL_BLOCK_SEC * 1000ull), "still blocked after the attack");
+}
+
+int main()
+{
+    test_codes();
+    test_window();
+    test_client();
+    test_rotating();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,491 @@
+// Host test of the pool strategies with mock pools and scripted outages.
+//
+//   c++ -O2 -std=gnu++17 -I../stratum -o pool_selector_sim pool_selector_sim.cpp ../stratum/pool_selector.cpp
+//   ./pool_selector_sim
+//
+// Every pool gets a model of its StratumTask: a stopped task polls every
+// 10 s, a failed connect retries after 10 s, the first notify arrives 1 s
+// after connecting, the reconnect timer rebalances every 30 s and the ping
+// task measures every 60 s. The job loop asks for 10 jobs per second. The
+// pools go down and come back per script and the checks look at which
+// pools hold connections, where the jobs go and how long the ASIC had no
+// work.
+//
+// Results (1 s steps, the tasks poll 3 s apart):
+//   failover 4 pools   P0 down 100-400 s, P1 down 50-600 s: P1 fails, P2 takes
+//                      over after 7 s without work, P3 never connects, P0 is
+//                      back at 400 s and P2 disconnects
+//   all down           P2 back first (206 s) carries the work, P0 at 300 s
+//   weighted 50/30/20  50.0/30.0/20.0 %, no bursts, 62.5/37.5 % while P2 is down
+//   latency            80/40/45/200 ms: P1 at 330 s (5 min dwell), P2 at 720 s
+//                      after it drops to 30 ms, 27 ms vs 30 ms stays below the
+//                      margin, the outage of P2 switches in the same second
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "pool_selector.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                         \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__);                                                                          \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+#define JOBS_PER_SEC 10
+
+typedef struct
+{
+    int from;
+    int to;
+} outage_t;
+
+typedef struct
+{
+    int at;
+    float ms;
+} latency_step_t;
+
+struct MockPool {
+    bool configured = true;
+    uint16_t weight = 0;
+    std::vector<outage_t> outages;
+    std::vector<latency_step_t> latency;
+
+    bool isUp(int t) const
+    {
+        for (auto &o : outages) {
+            if (t >= o.from && t < o.to) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    float latencyAt(int t) const
+    {
+        float ms = 0;
+        for (auto &l : latency) {
+            if (t >= l.at) {
+                ms = l.ms;
+            }
+        }
+        return ms;
+    }
+};
+
+// what the firmware task of a pool is doing
+struct TaskModel {
+    bool connected = false;
+    int nextAttempt = 0;
+    int notifyAt = 0;
+    int connects = 0;
+};
+
+struct Sim {
+    PoolSelector sel;
+    std::vector<MockPool> pools;
+    TaskModel tasks[STRATUM_MAX_POOLS];
+
+    // results
+    long jobs[STRATUM_MAX_POOLS]{};
+    long jobsDead = 0;     // job for a pool without valid work
+    long idleSeconds = 0;  // no pool had valid work
+    int maxIdleRun = 0;
+    int maxConnected = 0;
+    int maxBurst = 0;
+    int switches = 0;
+    std::vector<int> switchTimes;
+
+    int idleRun = 0;
+    int lastJobPool = -1;
+    int burst = 0;
+    int lastSelected = -1;
+
+    Sim(pool_mode_t mode, std::vector<MockPool> p) : sel(mode, (int) p.size()), pools(p)
+    {
+        for (int i = 0; i < (int) pools.size(); i++) {
+            sel.setConfigured(i, pools[i].configured, pools[i].weight);
+            // the tasks don't poll in lockstep
+            tasks[i].nextAttempt = i * 3;
+        }
+        sel.rebalance(0);
+    }
+
+    void rebalance(int t)
+    {
+        sel.rebalance((uint64_t) t * 1000);
+    }
+
+    void stepTasks(int t)
+    {
+        for (int i = 0; i < (int) pools.size(); i++) {
+            TaskModel &task = tasks[i];
+            MockPool &pool = pools[i];
+
+            if (task.connected) {
+                if (!pool.isUp(t)) {
+                    task.connected = false;
+                    task.nextAttempt = t + 10;
+                    sel.disconnected(i, true);
+                    rebalance(t);
+                } else if (!sel.isWanted(i)) {
+                    task.connected = false;
+                    task.nextAttempt = t + 10;
+                    sel.disconnected(i, false);
+                    rebalance(t);
+                } else if (!sel.get(i)->validNotify && t >= task.notifyAt) {
+                    sel.setValidNotify(i, true);
+                    rebalance(t);
+                }
+                continue;
+            }
+
+            if (t < task.nextAttempt || !pool.configured) {
+                continue;
+            }
+
+            if (!sel.isWanted(i)) {
+                task.nextAttempt = t + 10;
+            } else if (pool.isUp(t)) {
+                task.connected = true;
+                task.notifyAt = t + 1;
+                task.connects++;
+                sel.connected(i);
+                rebalance(t);
+            } else {
+                task.nextAttempt = t + 10;
+                sel.connectFailed(i);
+                rebalance(t);
+            }
+        }
+    }
+
+    int numWanted() const
+    {
+        int num = 0;
+        for (int i = 0; i < (int) pools.size(); i++) {
+            num += sel.isWanted(i);
+        }
+        return num;
+    }
+
+    int numValid() const
+    {
+        int num = 0;
+        for (int i = 0; i < (int) pools.size(); i++) {
+            num += sel.get(i)->validNotify;
+        }
+        return num;
+    }
+
+    void stepJobs(int t)
+    {
+        bool any = false;
+        for (int j = 0; j < JOBS_PER_SEC; j++) {
+            int pool = sel.getNextActivePool();
+            if (!sel.get(pool)->validNotify) {
+                // the job task skips the round, count it only if someone had work
+                for (int i = 0; i < (int) pools.size(); i++) {
+                    if (sel.get(i)->validNotify && sel.acceptsNotifyFrom(i)) {
+                        jobsDead++;
+                        break;
+                    }
+                }
+                continue;
+            }
+            CHECK(sel.acceptsNotifyFrom(pool), "t=%d job for pool %d which doesn't deliver notifies", t, pool);
+            any = true;
+            jobs[pool]++;
+            if (pool == lastJobPool) {
+                burst++;
+            } else {
+                burst = 1;
+                lastJobPool = pool;
+            }
+            if (numValid() == numWanted() && burst > maxBurst) {
+                maxBurst = burst;
+            }
+        }
+        if (!any) {
+            idleSeconds++;
+            idleRun++;
+            if (idleRun > maxIdleRun) {
+                maxIdleRun = idleRun;
+            }
+        } else {
+            idleRun = 0;
+        }
+    }
+
+    void step(int t)
+    {
+        if (t && !(t % 30)) {
+            rebalance(t);
+        }
+        if (!(t % 60)) {
+            for (int i = 0; i < (int) pools.size(); i++) {
+                if (tasks[i].connected) {
+                    sel.setLatency(i, pools[i].latencyAt(t));
+                }
+            }
+            rebalance(t);
+        }
+
+        stepTasks(t);
+
+        int connected = sel.getNumConnected();
+        if (connected > maxConnected) {
+            maxConnected = connected;
+        }
+
+        if (sel.getSelected() != lastSelected) {
+            if (lastSelected >= 0) {
+                switches++;
+                switchTimes.push_back(t);
+            }
+            lastSelected = sel.getSelected();
+        }
+
+        stepJobs(t);
+    }
+
+    void run(int from, int to)
+    {
+        for (int t = from; t < to; t++) {
+            step(t);
+        }
+    }
+
+    void resetJobs()
+    {
+        for (auto &j : jobs) {
+            j = 0;
+        }
+    }
+
+    long totalJobs() const
+    {
+        long total = 0;
+        for (auto j : jobs) {
+            total += j;
+        }
+        return total;
+    }
+
+    double pct(int pool) const
+    {
+        long total = totalJobs();
+        return total ? 100.0 * jobs[pool] / total : 0.0;
+    }
+};
+
+static MockPool pool(std::vector<outage_t> outages = {}, uint16_t weight = 0, std::vector<latency_step_t> latency = {})
+{
+    MockPool p;
+    p.outages = outages;
+    p.weight = weight;
+    p.latency = latency;
+    return p;
+}
+
+static void test_failover_cascade()
+{
+    Sim s(POOL_MODE_FAILOVER, {pool({{100, 400}}), pool({{50, 600}}), pool(), pool()});
+
+    s.run(0, 100);
+    CHECK(s.sel.getSelected() == 0, "primary not selected");
+    CHECK(s.maxConnected == 1, "%d pools connected while the primary is fine", s.maxConnected);
+    CHECK(s.tasks[1].connects == 0 && s.tasks[2].connects == 0, "backup pools connected");
+
+    s.run(100, 200);
+    CHECK(s.sel.getSelected() == 2, "pool 2 not selected with pools 0 and 1 down (selected %d)", s.sel.getSelected());
+    CHECK(!s.tasks[3].connects, "pool 3 connected although pool 2 is up");
+    CHECK(s.sel.isWanted(0) && s.sel.isWanted(1), "failed pools before the selected don't retry");
+    int failoverIdle = s.maxIdleRun;
+
+    s.run(200, 500);
+    CHECK(s.sel.getSelected() == 0, "not back on the primary (selected %d)", s.sel.getSelected());
+    CHECK(!s.tasks[2].connected, "pool 2 still connected after the primary is back");
+    CHECK(!s.sel.isWanted(1) && !s.sel.isWanted(2), "backup pools still wanted");
+    CHECK(s.switchTimes.size() == 2 && s.switchTimes[1] - 400 <= 10, "primary took %d s to take over",
+          s.switchTimes.empty() ? -1 : s.switchTimes.back() - 400);
+
+    s.run(500, 900);
+    CHECK(!s.tasks[3].connects, "pool 3 connected");
+    CHECK(s.maxConnected <= 2, "%d pools connected at once", s.maxConnected);
+    CHECK(s.jobsDead == 0, "%ld jobs for dead pools", s.jobsDead);
+    CHECK(failoverIdle <= 20, "%d s without work on failover", failoverIdle);
+    CHECK(s.sel.get(1)->failures == 0, "stopped pool keeps its failures");
+
+    printf("failover 4 pools: %d s without work on failover, switches at", failoverIdle);
+    for (int t : s.switchTimes) {
+        printf(" %d", t);
+    }
+    printf(" s, connects %d/%d/%d/%d\n", s.tasks[0].connects, s.tasks[1].connects, s.tasks[2].connects,
+           s.tasks[3].connects);
+}
+
+static void test_failover_all_down()
+{
+    Sim s(POOL_MODE_FAILOVER, {pool({{100, 300}}), pool({{100, 300}}), pool({{100, 200}})});
+
+    s.run(0, 190);
+    for (int i = 0; i < 3; i++) {
+        CHECK(s.sel.isWanted(i), "pool %d gave up while all are down", i);
+    }
+
+    s.run(190, 260);
+    CHECK(s.sel.getSelected() == 2, "first pool back not selected (%d)", s.sel.getSelected());
+    CHECK(s.sel.isWanted(0) && s.sel.isWanted(1), "better pools don't retry");
+
+    s.run(260, 400);
+    CHECK(s.sel.getSelected() == 0, "primary not back (%d)", s.sel.getSelected());
+    CHECK(!s.tasks[2].connected && !s.tasks[1].connected, "backup pools still connected");
+    CHECK(s.jobsDead == 0, "%ld jobs for dead pools", s.jobsDead);
+    printf("all down: idle %ld s (100 s outage), switches at", s.idleSeconds);
+    for (int t : s.switchTimes) {
+        printf(" %d", t);
+    }
+    printf(" s\n");
+}
+
+static void test_weighted()
+{
+    Sim s(POOL_MODE_WEIGHTED, {pool({}, 50), pool({}, 30), pool({{200, 400}}, 20), pool({}, 0)});
+
+    s.run(0, 20);
+    s.resetJobs();
+    s.run(20, 200);
+    double p0 = s.pct(0), p1 = s.pct(1), p2 = s.pct(2);
+    CHECK(p0 > 49.0 && p0 < 51.0 && p1 > 29.0 && p1 < 31.0 && p2 > 19.0 && p2 < 21.0, "distribution %.1f/%.1f/%.1f", p0,
+          p1, p2);
+    CHECK(!s.tasks[3].connects, "pool with weight 0 connected");
+    CHECK(s.maxBurst <= 2, "burst of %d jobs for one pool", s.maxBurst);
+    CHECK(s.sel.getShare(0) == 50 && s.sel.getShare(1) == 30 && s.sel.getShare(2) == 20, "shares %d/%d/%d",
+          s.sel.getShare(0), s.sel.getShare(1), s.sel.getShare(2));
+    printf("weighted 50/30/20/0: %.1f/%.1f/%.1f %%, max burst %d", p0, p1, p2, s.maxBurst);
+
+    s.run(200, 210);
+    s.resetJobs();
+    s.run(210, 390);
+    p0 = s.pct(0);
+    p1 = s.pct(1);
+    CHECK(p0 > 61.5 && p0 < 63.5 && s.jobs[2] == 0, "during outage %.1f/%.1f/%ld", p0, p1, s.jobs[2]);
+    CHECK(s.sel.getShare(2) == 0, "dead pool has a share");
+    printf(", P2 down %.1f/%.1f %%", p0, p1);
+
+    s.run(390, 420);
+    s.resetJobs();
+    s.run(420, 600);
+    CHECK(s.pct(2) > 19.0 && s.pct(2) < 21.0, "pool 2 not back to 20%% (%.1f)", s.pct(2));
+    CHECK(s.jobsDead == 0, "%ld jobs for dead pools", s.jobsDead);
+    CHECK(s.sel.getSelected() == 0, "heaviest pool not the main pool");
+    printf(", back %.1f %%\n", s.pct(2));
+
+    // dual pool defaults, pool balance 70
+    Sim d(POOL_MODE_WEIGHTED, {pool({}, 70), pool({}, 30)});
+    d.run(0, 20);
+    d.resetJobs();
+    d.run(20, 120);
+    CHECK(d.pct(0) > 69.0 && d.pct(0) < 71.0, "balance 70 gives %.1f", d.pct(0));
+
+    // all weights 0: equal split
+    Sim e(POOL_MODE_WEIGHTED, {pool({}, 0), pool({}, 0)});
+    e.run(0, 20);
+    e.resetJobs();
+    e.run(20, 120);
+    CHECK(e.pct(0) > 49.0 && e.pct(0) < 51.0, "equal split gives %.1f", e.pct(0));
+}
+
+static void test_latency()
+{
+    Sim s(POOL_MODE_LATENCY, {pool({}, 0, {{0, 80}}), pool({}, 0, {{0, 40}, {1100, 27}}), pool({{1300, 1500}}, 0, {{0, 45}, {700, 30}}),
+                              pool({}, 0, {{0, 200}, {1000, 36}})});
+
+    s.run(0, 290);
+    CHECK(s.maxConnected == 4, "latency mode keeps %d pools connected", s.maxConnected);
+    CHECK(s.sel.getSelected() == 0, "switched before the dwell time (%d)", s.sel.getSelected());
+
+    s.run(290, 700);
+    CHECK(s.sel.getSelected() == 1, "fastest pool not selected (%d)", s.sel.getSelected());
+    CHECK(!s.switchTimes.empty() && s.switchTimes[0] >= 300, "switch at %d s", s.switchTimes.empty() ? -1 : s.switchTimes[0]);
+
+    // 30 ms vs 40 ms: 25% faster
+    s.run(700, 1000);
+    CHECK(s.sel.getSelected() == 2, "faster pool not taken (%d)", s.sel.getSelected());
+
+    // 36 ms and 27 ms (10% better) don't pass the margin
+    int before = s.switches;
+    s.run(1000, 1300);
+    CHECK(s.switches == before, "switched on jitter");
+    CHECK(s.sel.getSelected() == 2, "selection changed (%d)", s.sel.getSelected());
+
+    // outage of the selected pool switches right away
+    s.maxIdleRun = 0;
+    s.run(1300, 1310);
+    CHECK(s.sel.getSelected() == 1, "no immediate switch on outage (%d)", s.sel.getSelected());
+    CHECK(s.switchTimes.back() == 1300, "switch at %d", s.switchTimes.back());
+
+    s.run(1310, 1600);
+    CHECK(s.jobsDead == 0, "%ld jobs for dead pools", s.jobsDead);
+    CHECK(s.maxIdleRun == 0, "%d s without work", s.maxIdleRun);
+
+    printf("latency 80/40/45/200 ms: switches at");
+    for (int t : s.switchTimes) {
+        printf(" %d", t);
+    }
+    printf(" s, selected P%d\n", s.sel.getSelected());
+}
+
+static void test_asic_diff()
+{
+    PoolSelector w(POOL_MODE_WEIGHTED, 3);
+    for (int i = 0; i < 3; i++) {
+        w.setConfigured(i, true, 10);
+        w.connected(i);
+    }
+    CHECK(w.selectAsicDiff(0, 4096, 256, 2048) == 2048, "not clamped to max");
+    CHECK(w.selectAsicDiff(1, 512, 256, 2048) == 512, "min of the pools not used");
+    CHECK(w.selectAsicDiff(0, 4096, 256, 2048) == 512, "other pool's diff ignored");
+    CHECK(w.selectAsicDiff(2, 100, 256, 2048) == 256 && w.get(2)->diffErr, "low diff not flagged");
+    w.disconnected(2, true);
+    CHECK(w.selectAsicDiff(0, 4096, 256, 2048) == 512, "disconnected pool still counts");
+
+    PoolSelector f(POOL_MODE_FAILOVER, 2);
+    f.setConfigured(0, true, 0);
+    f.setConfigured(1, true, 0);
+    f.connected(0);
+    f.connected(1);
+    CHECK(f.selectAsicDiff(0, 4096, 256, 2048) == 2048, "not clamped to max");
+    CHECK(f.selectAsicDiff(1, 512, 256, 2048) == 512, "single pool diff");
+    CHECK(f.selectAsicDiff(0, 1024, 256, 2048) == 1024, "failover mixes pool diffs");
+    CHECK(f.selectAsicDiff(0, 100, 256, 2048) == 256, "not clamped to min");
+
+    PoolSelector bad((pool_mode_t) 7, 9);
+    CHECK(bad.getMode() == POOL_MODE_FAILOVER && bad.getNumPools() == STRATUM_MAX_POOLS, "invalid args not fixed");
+}
+
+int main(int argc, char **argv)
+{
+    test_failover_cascade();
+    test_failover_all_down();
+    test_weighted();
+    test_latency();
+    test_asic_diff();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,323 @@
+// Host test of the self-test logic against a simulated BM1370 chain.
+//
+//   c++ -O2 -std=gnu++17 -I../self_test -o self_test_sim self_test_sim.cpp ../self_test/self_test_eval.cpp
+//   ./self_test_sim
+//
+// The chain is the one of job_slots_sim.cpp: a job every 500 ms (QAxe+2),
+// 16 job IDs (extranonce2 * 24 & 0x7f) looked up in the 128 entry table of
+// SelfTest, result delivery after 1 ms UART plus 5 ms avg queueing and
+// about every 5 s the receive loop is blocked for 100-400 ms. A result
+// verified against the wrong job passes the difficulty with 4/256.
+//
+// Each chip returns nonces of the running job at the test difficulty
+// (Poisson, frequency * 2040 small cores / (difficulty * 2^32) per second,
+// 35.6/s at 600 MHz and difficulty 8). The run follows
+// SelfTest::testHashing: eco, default and configured frequency
+// (400/490/600 MHz), 3 s settle and a 20 s window each, nonces counted by
+// arrival time.
+//
+// - a board with one fault per chip: dead, half the cores, half of the
+//   nonces corrupted, late start. Every fault fails, the healthy chips
+//   pass, fan, temp sensor and VR findings follow their limits
+// - 1000 runs of a 4 chip board per chip speed: share of the chips that
+//   fail, for the false fails of good chips and the detection of slow ones
+//
+// Result on a x86 Linux box (threshold 70% of the expected hashrate):
+//   chip speed   fail rate at difficulty 32 (before)   8
+//      100%                 0.10%                      0.00%
+//       90%                 1.45%                      0.00%
+//       80%                24.27%                      0.80%
+//       75%                56.42%                     21.40%
+//       65%                98.80%                     99.97%
+//       60%                99.95%                    100.00%
+//       50%               100.00%                    100.00%
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "self_test_eval.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                         \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__);                                                                          \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+#define SEC 1000000LL
+#define SMALL_CORES 2040
+#define JOB_INTERVAL_US (500 * 1000LL)
+#define TABLE_SLOTS 128
+#define SETTLE_US (3 * SEC)
+#define WINDOW_US (20 * SEC)
+#define FALSE_MATCH (4.0 / 256.0)
+
+static const float FREQS[] = {490.0f, 400.0f, 600.0f, 490.0f};
+
+struct ChipModel
+{
+    double speed = 1.0;       // share of the expected hashrate
+    double corrupted = 0.0;   // share of the nonces that don't verify
+    int64_t startUs = 0;      // no results before (since hashing start)
+};
+
+struct Result
+{
+    int64_t arrivalUs;
+    int chip;
+    uint8_t jobId;
+    uint32_t generation;
+    bool corrupted;
+
+    bool operator>(const Result &o) const
+    {
+        return arrivalUs > o.arrivalUs;
+    }
+};
+
+static uint8_t bm1370_job_id(uint32_t counter)
+{
+    return (uint8_t) ((counter * 24) & 0x7f);
+}
+
+static SelfTestEval::Limits limits()
+{
+    SelfTestEval::Limits l;
+    l.smallCoreCount = SMALL_CORES;
+    l.minVout = 1.0f;
+    l.maxVout = 1.4f;
+    l.minPin = 20.0f;
+    l.maxPin = 120.0f;
+    return l;
+}
+
+// hashing part of the self-test against the chain
+static void run_hashing(SelfTestEval &eval, const std::vector<ChipModel> &chips, std::mt19937_64 &rng)
+{
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+    auto expo = [&](double mean) { return -mean * log(1.0 - uni(rng)); };
+
+    for (float f : FREQS) {
+        eval.addFrequency(f);
+    }
+    eval.sortFrequencies();
+
+    // job table of SelfTest, generation of the job in each entry
+    uint32_t table[TABLE_SLOTS] = {};
+    bool tableValid[TABLE_SLOTS] = {};
+
+    int64_t now = 0;
+    eval.startHashing(now);
+
+    uint32_t counter = 0;
+    int64_t nextJob = 0;
+    uint8_t runningId = 0;
+    uint32_t runningGen = 0;
+
+    int64_t blockedUntil = 0;
+    int64_t nextBlock = (int64_t) (expo(5.0) * SEC);
+
+    std::vector<int64_t> nextNonce(chips.size());
+    std::priority_queue<Result, std::vector<Result>, std::greater<Result>> inflight;
+
+    for (int f = 0; f < eval.getNumFreqs(); f++) {
+        double hashesPerUs = eval.getFrequency(f) * SMALL_CORES;
+        double meanNonceUs = SELF_TEST_DIFFICULTY * 4294967296.0 / hashesPerUs;
+        for (size_t c = 0; c < chips.size(); c++) {
+            double rate = meanNonceUs / std::max(chips[c].speed, 1e-9);
+            nextNonce[c] = std::max(now, chips[c].startUs) + (int64_t) expo(rate);
+        }
+
+        int64_t settleEnd = now + SETTLE_US;
+        int64_t windowStart = settleEnd;
+        int64_t windowEnd = windowStart + WINDOW_US;
+        bool windowStarted = false;
+
+        while (now < windowEnd) {
+            // next event: job, nonce, arrival or the window start
+            int64_t next = std::min(nextJob, windowEnd);
+            if (!windowStarted) {
+                next = std::min(next, windowStart);
+            }
+            for (size_t c = 0; c < chips.size(); c++) {
+                if (chips[c].speed > 0.0) {
+                    next = std::min(next, nextNonce[c]);
+                }
+            }
+            if (!inflight.empty()) {
+                next = std::min(next, std::max(inflight.top().arrivalUs, blockedUntil));
+            }
+            now = next;
+
+            if (!windowStarted && now >= windowStart) {
+                eval.startWindow();
+                windowStarted = true;
+            }
+
+            if (now >= nextJob) {
+                runningId = bm1370_job_id(counter++);
+                table[runningId % TABLE_SLOTS] = ++runningGen;
+                tableValid[runningId % TABLE_SLOTS] = true;
+                nextJob = now + JOB_INTERVAL_US;
+            }
+
+            for (size_t c = 0; c < chips.size(); c++) {
+                if (chips[c].speed <= 0.0 || now < nextNonce[c]) {
+                    continue;
+                }
+                Result r;
+                r.arrivalUs = now + 1000 + (int64_t) expo(5000.0);
+                r.chip = (int) c;
+                r.jobId = runningId;
+                r.generation = runningGen;
+                r.corrupted = uni(rng) < chips[c].corrupted;
+                inflight.push(r);
+                nextNonce[c] = now + (int64_t) expo(meanNonceUs / chips[c].speed);
+            }
+
+            // the receive loop is blocked now and then
+            if (now >= nextBlock) {
+                blockedUntil = now + 100000 + (int64_t) (uni(rng) * 300000);
+                nextBlock = now + (int64_t) (expo(5.0) * SEC);
+            }
+            if (now < blockedUntil) {
+                continue;
+            }
+
+            while (!inflight.empty() && inflight.top().arrivalUs <= now) {
+                Result r = inflight.top();
+                inflight.pop();
+
+                int slot = r.jobId % TABLE_SLOTS;
+                if (!tableValid[slot]) {
+                    continue;
+                }
+                // verified against the job in the table
+                bool verifies = table[slot] == r.generation ? !r.corrupted : uni(rng) < FALSE_MATCH;
+                double diff = verifies ? SELF_TEST_DIFFICULTY / (1.0 - uni(rng)) : SELF_TEST_DIFFICULTY * uni(rng);
+                eval.addNonce(r.chip, diff, now, windowStarted);
+            }
+        }
+        eval.endWindow(f, (float) WINDOW_US / SEC);
+    }
+}
+
+static void test_faults()
+{
+    printf("one fault per chip\n");
+
+    std::vector<ChipModel> chips(6);
+    chips[1].speed = 0.0;        // dead
+    chips[2].speed = 0.5;        // half the cores
+    chips[3].corrupted = 0.5;    // half the nonces corrupted
+    chips[4].startUs = 8 * SEC;  // late start
+
+    std::mt19937_64 rng(79);
+    SelfTestEval eval((int) chips.size(), 2, 2, limits());
+    run_hashing(eval, chips, rng);
+
+    CHECK(eval.getNumFreqs() == 3 && eval.getFrequency(0) == 400.0f && eval.getFrequency(2) == 600.0f,
+          "frequencies %d", eval.getNumFreqs());
+
+    const char *names[] = {"healthy", "dead", "half cores", "corrupted", "late start", "healthy"};
+    bool expectOk[] = {true, false, false, false, false, true};
+    for (int i = 0; i < (int) chips.size(); i++) {
+        const SelfTestEval::ChipResult &r = eval.getChip(i);
+        printf("  chip %d %-10s valid %4u invalid %4u first %5.2f s  %6.1f %6.1f %6.1f GH/s  %s\n", i, names[i], r.valid,
+               r.invalid, r.firstNonceUs / 1e6, r.hashrate[0], r.hashrate[1], r.hashrate[2], eval.chipOk(i) ? "ok" : "fail");
+        CHECK(eval.chipOk(i) == expectOk[i], "chip %d (%s) ok %d", i, names[i], eval.chipOk(i));
+    }
+    CHECK(eval.getChip(3).invalid > eval.getChip(3).valid / 2, "corrupted nonces not counted");
+    CHECK(eval.getChip(0).invalid < 5, "healthy chip with %u invalid", eval.getChip(0).invalid);
+
+    // a measured hashrate close to the expected one
+    float expected = eval.expectedHashrate(600.0f);
+    CHECK(fabsf(eval.getChip(0).hashrate[2] / expected - 1.0f) < 0.25f, "healthy chip at %.1f of %.1f GH/s",
+          eval.getChip(0).hashrate[2], expected);
+
+    CHECK(!eval.passed(6, false), "board with faults passed");
+
+    // fans, temp sensors, VR
+    eval.setFan(0, 5200, 2100);
+    eval.setFan(1, 5200, 5100); // doesn't slow down
+    CHECK(eval.fanOk(0) && !eval.fanOk(1), "fans");
+    eval.setTemp(0, false, 32.0f);
+    eval.setTemp(0, true, 55.0f);
+    eval.setTemp(1, false, 32.0f);
+    eval.setTemp(1, true, 32.5f); // doesn't follow the load
+    CHECK(eval.tempOk(0) && !eval.tempOk(1), "temp sensors");
+    eval.setPower(false, 12.0f, 0.0f);
+    eval.setPower(true, 60.0f, 1.2f);
+    CHECK(eval.voutOk() && eval.powerOk(), "vr");
+    eval.setPower(true, 60.0f, 0.8f);
+    CHECK(!eval.voutOk(), "low vout accepted");
+
+    // a healthy board passes, fan and temp findings are warnings only
+    std::vector<ChipModel> good(4);
+    SelfTestEval ok((int) good.size(), 1, 1, limits());
+    run_hashing(ok, good, rng);
+    ok.setFan(0, 5200, 5100);
+    ok.setTemp(0, false, 30.0f);
+    ok.setTemp(0, true, 30.0f);
+    ok.setPower(true, 60.0f, 1.2f);
+    CHECK(ok.passed(4, false), "healthy board failed");
+    CHECK(!ok.passed(3, false), "missing chip passed");
+    CHECK(!ok.passed(4, true), "overheated board passed");
+}
+
+static void test_rates()
+{
+    printf("fail rate per chip speed, 1000 runs of 4 chips\n");
+
+    const double speeds[] = {1.0, 0.9, 0.8, 0.75, 0.65, 0.6, 0.5};
+    std::mt19937_64 rng(7);
+
+    for (double speed : speeds) {
+        int chipsFailed = 0, chipsTotal = 0;
+        for (int run = 0; run < 1000; run++) {
+            std::vector<ChipModel> chips(4);
+            for (auto &c : chips) {
+                c.speed = speed;
+            }
+            SelfTestEval eval(4, 1, 1, limits());
+            run_hashing(eval, chips, rng);
+            for (int i = 0; i < 4; i++) {
+                chipsFailed += !eval.chipOk(i);
+                chipsTotal++;
+            }
+        }
+        double rate = 100.0 * chipsFailed / chipsTotal;
+        printf("  %4.0f%%  %7.2f%%\n", speed * 100.0, rate);
+
+        if (speed >= 0.9) {
+            CHECK(rate == 0.0, "good chips fail at %.0f%%: %.2f%%", speed * 100.0, rate);
+        }
+        if (speed <= 0.6) {
+            CHECK(rate > 99.0, "slow chips pass at %.0f%%: %.2f%% fail", speed * 100.0, rate);
+        }
+    }
+}
+
+int main()
+{
+    test_faults();
+    test_rates();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// host stand-in for the board, only what the modules under test read
+
+#include <stdint.h>
+
+class Board {
+  public:
+    int numFans = 1;
+    int asicCount = 1;
+    int chipLayoutCols = 0;
+    float chipTemps[64]{};
+
+    int getNumFans()
+    {
+        return numFans;
+    }
+
+    int getAsicCount()
+    {
+        return asicCount;
+    }
+
+    int getChipLayoutCols()
+    {
+        return chipLayoutCols ? chipLayoutCols : asicCount;
+    }
+
+    float getChipTemp(int chip)
+    {
+        return chipTemps[chip];
+    }
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+// host stand-in for the ESP-IDF log, quiet unless HOST_LOG is defined
+
+#include <stdio.h>
+
+#ifdef HOST_LOG
+#define HOST_LOG_PRINT(level, tag, fmt, ...) printf("%s (%s): " fmt "\n", level, tag, ##__VA_ARGS__)
+#else
+#define HOST_LOG_PRINT(level, tag, fmt, ...)                                                                                       \
+    do {                                                                                                                           \
+        if (0) {                                                                                                                   \
+            printf("%s" fmt, tag, ##__VA_ARGS__);                                                                                          \
+        }                                                                                                                          \
+    } while (0)
+#endif
+
+#define ESP_LOGE(tag, fmt, ...) HOST_LOG_PRINT("E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) HOST_LOG_PRINT("W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) HOST_LOG_PRINT("I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) HOST_LOG_PRINT("D", tag, fmt, ##__VA_ARGS__)
@@ -0,0 +1,12 @@
+#pragma once
+
+// host stand-in for esp_timer, the simulation sets the clock
+
+#include <stdint.h>
+
+inline int64_t host_time_us = 0;
+
+static inline int64_t esp_timer_get_time()
+{
+    return host_time_us;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// host stand-in for FreeRTOS, tasks are pthreads
+
+#include <pthread.h>
+#include <stdint.h>
+
+typedef void *TaskHandle_t;
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+static inline TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return (TaskHandle_t) pthread_self();
+}
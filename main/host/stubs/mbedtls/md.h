@@ -0,0 +1,25 @@
+#pragma once
+
+// host stand-in for the mbedtls HMAC, backed by OpenSSL (-lcrypto)
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+typedef enum
+{
+    MBEDTLS_MD_SHA1,
+    MBEDTLS_MD_SHA256,
+} mbedtls_md_type_t;
+
+typedef EVP_MD mbedtls_md_info_t;
+
+static inline const mbedtls_md_info_t *mbedtls_md_info_from_type(mbedtls_md_type_t type)
+{
+    return type == MBEDTLS_MD_SHA1 ? EVP_sha1() : EVP_sha256();
+}
+
+static inline int mbedtls_md_hmac(const mbedtls_md_info_t *info, const unsigned char *key, size_t keylen,
+                                  const unsigned char *input, size_t ilen, unsigned char *output)
+{
+    return HMAC(info, key, (int) keylen, input, ilen, output, NULL) ? 0 : -1;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+// host stand-in for the one-shot mbedtls hash, backed by OpenSSL (-lcrypto).
+// The low level calls, the one-shot SHA256() of OpenSSL 3 fetches the
+// algorithm on every call
+
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include <openssl/sha.h>
+
+static inline int mbedtls_sha256(const unsigned char *input, size_t ilen, unsigned char *output, int is224)
+{
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, input, ilen);
+    SHA256_Final(output, &ctx);
+    return 0;
+}
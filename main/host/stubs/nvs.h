@@ -0,0 +1,148 @@
+#pragma once
+
+// host stand-in for NVS, in memory
+//
+// Like on the ESP32 every set and erase is written to flash when it
+// returns, nvs_commit() only gets counted. Thread safe like NVS. host_flash_writes_left
+// simulates a power loss: when it reaches 0 the next write throws
+// HostPowerLoss before it changes anything.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle;
+typedef nvs_handle nvs_handle_t;
+
+typedef enum
+{
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+struct HostNvsValue
+{
+    int type; // 1 str, 2 u16, 3 u64, 4 blob
+    std::string data;
+};
+
+struct HostPowerLoss
+{};
+
+inline std::map<std::string, HostNvsValue> host_flash;
+inline std::mutex host_flash_mutex;
+inline int host_flash_writes = 0;
+inline int host_flash_commits = 0;
+inline int host_flash_writes_left = -1; // < 0: no power loss
+
+static inline void host_flash_write()
+{
+    if (host_flash_writes_left == 0) {
+        throw HostPowerLoss();
+    }
+    if (host_flash_writes_left > 0) {
+        host_flash_writes_left--;
+    }
+    host_flash_writes++;
+}
+
+static inline esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle *handle)
+{
+    *handle = 1;
+    return ESP_OK;
+}
+
+static inline void nvs_close(nvs_handle handle) {}
+
+static inline esp_err_t nvs_commit(nvs_handle handle)
+{
+    std::lock_guard<std::mutex> lock(host_flash_mutex);
+    host_flash_commits++;
+    return ESP_OK;
+}
+
+static inline esp_err_t host_flash_set(const char *key, int type, const void *data, size_t len)
+{
+    std::lock_guard<std::mutex> lock(host_flash_mutex);
+    host_flash_write();
+    host_flash[key] = HostNvsValue{type, std::string((const char *) data, len)};
+    return ESP_OK;
+}
+
+static inline esp_err_t host_flash_get(const char *key, int type, void *out, size_t *len)
+{
+    std::lock_guard<std::mutex> lock(host_flash_mutex);
+    auto it = host_flash.find(key);
+    if (it == host_flash.end() || it->second.type != type) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    size_t size = it->second.data.size();
+    if (!out) {
+        *len = size;
+        return ESP_OK;
+    }
+    if (*len < size) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out, it->second.data.data(), size);
+    *len = size;
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_set_str(nvs_handle handle, const char *key, const char *value)
+{
+    return host_flash_set(key, 1, value, strlen(value) + 1);
+}
+
+static inline esp_err_t nvs_set_u16(nvs_handle handle, const char *key, uint16_t value)
+{
+    return host_flash_set(key, 2, &value, sizeof(value));
+}
+
+static inline esp_err_t nvs_set_u64(nvs_handle handle, const char *key, uint64_t value)
+{
+    return host_flash_set(key, 3, &value, sizeof(value));
+}
+
+static inline esp_err_t nvs_set_blob(nvs_handle handle, const char *key, const void *value, size_t len)
+{
+    return host_flash_set(key, 4, value, len);
+}
+
+static inline esp_err_t nvs_get_str(nvs_handle handle, const char *key, char *out, size_t *len)
+{
+    return host_flash_get(key, 1, out, len);
+}
+
+static inline esp_err_t nvs_get_u16(nvs_handle handle, const char *key, uint16_t *out)
+{
+    size_t len = sizeof(*out);
+    return host_flash_get(key, 2, out, &len);
+}
+
+static inline esp_err_t nvs_get_u64(nvs_handle handle, const char *key, uint64_t *out)
+{
+    size_t len = sizeof(*out);
+    return host_flash_get(key, 3, out, &len);
+}
+
+static inline esp_err_t nvs_get_blob(nvs_handle handle, const char *key, void *out, size_t *len)
+{
+    return host_flash_get(key, 4, out, len);
+}
+
+static inline esp_err_t nvs_erase_key(nvs_handle handle, const char *key)
+{
+    std::lock_guard<std::mutex> lock(host_flash_mutex);
+    if (!host_flash.count(key)) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    host_flash_write();
+    host_flash.erase(key);
+    return ESP_OK;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// host stand-in for the NVS config, the keys used by the modules under test
+// in memory
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+
+inline std::map<std::string, std::string> host_nvs;
+
+namespace Config {
+
+inline char *getString(const std::string &key, const char *def)
+{
+    auto it = host_nvs.find(key);
+    return strdup(it != host_nvs.end() ? it->second.c_str() : def);
+}
+
+inline uint16_t getU16(const std::string &key, uint16_t def)
+{
+    auto it = host_nvs.find(key);
+    return it != host_nvs.end() ? (uint16_t) atoi(it->second.c_str()) : def;
+}
+
+inline void setU16(const std::string &key, uint16_t value)
+{
+    host_nvs[key] = std::to_string(value);
+}
+
+inline char *getFanCurve(int ch) { return getString(ch ? "fan_curve1" : "fan_curve0", ""); }
+inline void setFanCurve(int ch, const char *value) { host_nvs[ch ? "fan_curve1" : "fan_curve0"] = value; }
+inline uint16_t getFanMaxRPM() { return getU16("fan_max_rpm", 0); }
+inline void setFanMaxRPM(uint16_t value) { setU16("fan_max_rpm", value); }
+inline uint16_t getAmbientTemp() { return getU16("ambient_temp", 25); }
+inline void setAmbientTemp(uint16_t value) { setU16("ambient_temp", value); }
+inline char *getTempCalibration(const char *key) { return getString(key, ""); }
+inline void setTempCalibration(const char *key, const char *value) { host_nvs[key] = value; }
+inline uint16_t getTempControlMode() { return getU16("autofanspeed", 2); }
+inline void setTempControlMode(uint16_t value) { setU16("autofanspeed", value); }
+
+} // namespace Config
@@ -0,0 +1,9 @@
+#pragma once
+
+// host stand-in, mining.h only needs the notify (-I../stratum)
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mining_notify.h"
@@ -0,0 +1,405 @@
+// Host test of the task placement plan.
+//
+//   c++ -O2 -std=gnu++17 -I.. -o task_plan_sim task_plan_sim.cpp ../task_plan.cpp
+//   ./task_plan_sim [seconds]
+//
+// Checks TaskPlan::resolve() and the default plan (no PSRAM stack for a
+// task that writes the flash), then runs the plan on a model of the dual
+// core FreeRTOS scheduler of ESP-IDF: fixed priority preemption, a woken
+// task takes an idle core or preempts the lowest priority task of a core
+// it may run on, a preempted task waits in the ready list until a core
+// reschedules (block or tick), equal priorities are time sliced on the
+// tick. WiFi (core 0), the unpinned lwIP task and
+// the HTTP server are added as load.
+//
+// The notify to ASIC latency (WiFi rx -> lwIP -> stratum parse -> job
+// creation) is compared between the default plan and the unpinned setup
+// the firmware used before, both with the same load.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "latency_histogram.h"
+#include "task_plan.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                         \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__);                                                                          \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+static const int NUM_CORES = 2;
+static const int MAX_PRIORITIES = 25;
+static const int64_t STEP_US = 10;
+static const int64_t TICK_US = 10000; // CONFIG_FREERTOS_HZ=100
+
+enum
+{
+    BLOCKED,
+    READY,
+    RUNNING
+};
+
+struct Work
+{
+    int64_t duration;
+    int64_t stamp; // notify arrival, 0 for other work
+};
+
+struct SimTask
+{
+    const char *name;
+    int prio;
+    int core; // TASK_CORE_ANY for no affinity
+    int state = BLOCKED;
+    int64_t readySeq = 0;
+    int next = -1;      // task that gets stamped work when it's done
+    int64_t pathUs = 0; // its work for a notify
+    std::deque<Work> work;
+    int64_t done = 0; // progress of the current work
+};
+
+class Scheduler {
+  public:
+    std::vector<SimTask> tasks;
+    int running[NUM_CORES] = {-1, -1};
+    int64_t busy[NUM_CORES] = {0, 0};
+    int64_t seq = 0;
+    LatencyHistogram latency;
+    std::vector<uint32_t> samples;
+    int sink = -1; // stamped work done here is measured
+
+    int add(const char *name, int prio, int core)
+    {
+        SimTask t;
+        t.name = name;
+        t.prio = prio;
+        t.core = core;
+        tasks.push_back(t);
+        return (int) tasks.size() - 1;
+    }
+
+    int add(const TaskPlan &plan, task_id_t id)
+    {
+        const task_placement_t *p = plan.get(id);
+        return add(p->name, p->priority, p->core);
+    }
+
+    bool allowed(int t, int core)
+    {
+        return tasks[t].core == TASK_CORE_ANY || tasks[t].core == core;
+    }
+
+    void makeReady(int t)
+    {
+        tasks[t].state = READY;
+        tasks[t].readySeq = seq++;
+    }
+
+    void run(int core, int t)
+    {
+        running[core] = t;
+        tasks[t].state = RUNNING;
+    }
+
+    // highest priority ready task for the core, oldest first
+    int pick(int core)
+    {
+        int best = -1;
+        for (int i = 0; i < (int) tasks.size(); i++) {
+            if (tasks[i].state != READY || !allowed(i, core)) {
+                continue;
+            }
+            if (best < 0 || tasks[i].prio > tasks[best].prio ||
+                (tasks[i].prio == tasks[best].prio && tasks[i].readySeq < tasks[best].readySeq)) {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    void wake(int t)
+    {
+        makeReady(t);
+        // idle core first
+        for (int c = 0; c < NUM_CORES; c++) {
+            if (running[c] < 0 && allowed(t, c)) {
+                run(c, t);
+                return;
+            }
+        }
+        // preempt the lowest priority task it may replace
+        int victim = -1;
+        for (int c = 0; c < NUM_CORES; c++) {
+            if (!allowed(t, c) || tasks[running[c]].prio >= tasks[t].prio) {
+                continue;
+            }
+            if (victim < 0 || tasks[running[c]].prio < tasks[running[victim]].prio) {
+                victim = c;
+            }
+        }
+        if (victim >= 0) {
+            makeReady(running[victim]);
+            run(victim, t);
+        }
+    }
+
+    void submit(int t, Work w)
+    {
+        tasks[t].work.push_back(w);
+        if (tasks[t].state == BLOCKED) {
+            wake(t);
+        }
+    }
+
+    void step(int64_t now)
+    {
+        for (int c = 0; c < NUM_CORES; c++) {
+            int t = running[c];
+            if (t < 0) {
+                continue;
+            }
+            busy[c] += STEP_US;
+            SimTask &task = tasks[t];
+            task.done += STEP_US;
+            if (task.done < task.work.front().duration) {
+                continue;
+            }
+
+            Work w = task.work.front();
+            task.work.pop_front();
+            task.done = 0;
+            if (t == sink && w.stamp) {
+                latency.add((uint32_t) (now - w.stamp));
+                samples.push_back((uint32_t) (now - w.stamp));
+            }
+            if (task.work.empty()) {
+                task.state = BLOCKED;
+                running[c] = -1;
+            }
+            // the next task may take the core that just got free
+            if (task.next >= 0 && w.stamp) {
+                submit(task.next, {tasks[task.next].pathUs, w.stamp});
+            }
+            if (running[c] < 0) {
+                int n = pick(c);
+                if (n >= 0) {
+                    run(c, n);
+                }
+            }
+        }
+
+        // both cores reschedule on their tick
+        if (now % TICK_US == 0) {
+            for (int c = 0; c < NUM_CORES; c++) {
+                int n = pick(c);
+                if (n < 0) {
+                    continue;
+                }
+                int t = running[c];
+                if (t < 0 || tasks[n].prio >= tasks[t].prio) {
+                    if (t >= 0) {
+                        makeReady(t);
+                    }
+                    run(c, n);
+                }
+            }
+        }
+    }
+};
+
+struct Result
+{
+    uint32_t p50, p99, max, avg;
+    uint32_t count;
+    uint32_t histP99;
+    double load[NUM_CORES];
+};
+
+// periodic or random load source
+struct Source
+{
+    int task;
+    int64_t meanIntervalUs;
+    int64_t minWorkUs, maxWorkUs;
+    bool random;
+    int64_t nextUs;
+};
+
+static Result simulate(const TaskPlan &plan, int seconds, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    Scheduler s;
+
+    int wifi = s.add("wifi", 23, TaskPlan::WIFI_CORE);
+    int tcpip = s.add("tcpip", 18, TASK_CORE_ANY);
+    int httpd = s.add("httpd", 5, TASK_CORE_ANY);
+    int stratum = s.add(plan, TASK_STRATUM);
+    int jobs = s.add(plan, TASK_CREATE_JOBS);
+    int result = s.add(plan, TASK_ASIC_RESULT);
+    int power = s.add(plan, TASK_POWER_MANAGEMENT);
+    int hr = s.add(plan, TASK_HASHRATE_MONITOR);
+    int lvgl = s.add(plan, TASK_LVGL);
+    int apis = s.add(plan, TASK_APIS);
+    int system = s.add(plan, TASK_SYSTEM);
+
+    // notify path: rx, lwIP, JSON parse, merkle root and the UART job
+    s.tasks[wifi].next = tcpip;
+    s.tasks[tcpip].next = stratum;
+    s.tasks[stratum].next = jobs;
+    s.tasks[tcpip].pathUs = 150;
+    s.tasks[stratum].pathUs = 800;
+    s.tasks[jobs].pathUs = 600;
+    s.sink = jobs;
+
+    std::vector<Source> sources = {
+        {wifi, 1500, 100, 400, true, 0},       // background traffic
+        {tcpip, 1500, 100, 300, true, 0},
+        {httpd, 50000, 1000, 6000, true, 0},   // API polling, websocket
+        {jobs, 20000, 400, 800, false, 0},     // job interval
+        {result, 2000, 50, 150, true, 0},      // nonces
+        {power, 100000, 1000, 3000, false, 0}, // I2C polling
+        {hr, 100000, 500, 1000, false, 0},
+        {lvgl, 10000, 4000, 8000, false, 0},   // rendering
+        {apis, 500000, 2000, 5000, true, 0},
+        {system, 1000000, 1000, 2000, false, 0},
+    };
+
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+    std::exponential_distribution<double> notifyGap(1.0 / 200000.0); // compressed, one per 30s on mainnet
+    int64_t nextNotify = 100000;
+
+    for (int64_t now = STEP_US; now <= (int64_t) seconds * 1000000; now += STEP_US) {
+        for (Source &src : sources) {
+            if (now < src.nextUs) {
+                continue;
+            }
+            int64_t work = src.minWorkUs + (int64_t) (uni(rng) * (src.maxWorkUs - src.minWorkUs));
+            s.submit(src.task, {work, 0});
+            double gap = src.random ? -log(1.0 - uni(rng)) * src.meanIntervalUs : src.meanIntervalUs;
+            src.nextUs = now + (int64_t) gap;
+        }
+        if (now >= nextNotify) {
+            s.submit(wifi, {200, now});
+            nextNotify = now + (int64_t) notifyGap(rng) + 1000;
+        }
+        s.step(now);
+    }
+
+    Result r = {};
+    std::vector<uint32_t> &v = s.samples;
+    std::sort(v.begin(), v.end());
+    if (!v.empty()) {
+        r.p50 = v[v.size() / 2];
+        r.p99 = v[std::min(v.size() - 1, v.size() * 99 / 100)];
+    }
+    r.histP99 = s.latency.percentile(99.0f);
+    r.max = s.latency.getMax();
+    r.avg = s.latency.getAvg();
+    r.count = s.latency.getCount();
+    for (int c = 0; c < NUM_CORES; c++) {
+        r.load[c] = 100.0 * s.busy[c] / ((double) seconds * 1000000.0);
+    }
+    return r;
+}
+
+static void check_resolve()
+{
+    TaskPlan plan;
+    CHECK(plan.resolve(NUM_CORES, MAX_PRIORITIES) == 0, "default plan changed on the ESP32-S3");
+    CHECK(plan.numWifiCoreConflicts() == 0, "mining critical task on the WiFi core");
+
+    // hot path ordering: results before new jobs before stratum before the UI
+    CHECK(plan.get(TASK_ASIC_RESULT)->priority > plan.get(TASK_CREATE_JOBS)->priority, "asic result <= create jobs");
+    CHECK(plan.get(TASK_CREATE_JOBS)->priority > plan.get(TASK_STRATUM)->priority, "create jobs <= stratum");
+    CHECK(plan.get(TASK_STRATUM)->priority > plan.get(TASK_LVGL)->priority, "stratum <= lvgl");
+    for (int i = 0; i < TASK_MAX; i++) {
+        CHECK(plan.get((task_id_t) i)->name != nullptr, "entry %d without name", i);
+        if (TaskPlan::isMiningCritical((task_id_t) i)) {
+            CHECK(plan.get((task_id_t) i)->stack == TASK_STACK_INTERNAL, "%s stack in PSRAM", plan.get((task_id_t) i)->name);
+        }
+        if (TaskPlan::writesFlash((task_id_t) i)) {
+            CHECK(plan.get((task_id_t) i)->stack == TASK_STACK_INTERNAL, "%s writes the flash from PSRAM",
+                  plan.get((task_id_t) i)->name);
+        }
+    }
+
+    // single core: everything unpinned
+    TaskPlan single;
+    CHECK(single.resolve(1, MAX_PRIORITIES) > 0, "nothing changed on a single core");
+    for (int i = 0; i < TASK_MAX; i++) {
+        CHECK(single.get((task_id_t) i)->core == TASK_CORE_ANY, "%s still pinned", single.get((task_id_t) i)->name);
+    }
+    CHECK(single.numWifiCoreConflicts() == 2, "single core conflicts %d", single.numWifiCoreConflicts());
+
+    // board overrides out of range
+    TaskPlan board;
+    board.set(TASK_ASIC_RESULT, 2, 30);
+    board.set(TASK_INFLUX, 0, 0);
+    board.setStack(TASK_PING, 1000, TASK_STACK_PSRAM);
+    CHECK(board.resolve(NUM_CORES, MAX_PRIORITIES) == 3, "3 entries should be fixed");
+    CHECK(board.get(TASK_ASIC_RESULT)->core == TASK_CORE_ANY, "core 2 not unpinned");
+    CHECK(board.get(TASK_ASIC_RESULT)->priority == MAX_PRIORITIES - 1, "priority not clamped");
+    CHECK(board.get(TASK_INFLUX)->priority == 1, "idle priority not raised");
+    CHECK(board.get(TASK_PING)->stackBytes == TaskPlan::MIN_STACK_BYTES, "stack not raised");
+    CHECK(board.numWifiCoreConflicts() == 1, "unpinned asic result not reported");
+
+    // a board moving a flash writer to PSRAM gets it back in internal RAM
+    TaskPlan psram;
+    psram.setStack(TASK_ALERTER, 8192, TASK_STACK_PSRAM);
+    psram.setStack(TASK_INFLUX, 8192, TASK_STACK_PSRAM);
+    CHECK(psram.resolve(NUM_CORES, MAX_PRIORITIES) == 1, "1 entry should be fixed");
+    CHECK(psram.get(TASK_ALERTER)->stack == TASK_STACK_INTERNAL, "alerter stack left in PSRAM");
+    CHECK(psram.get(TASK_INFLUX)->stack == TASK_STACK_PSRAM, "influx stack moved");
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = (argc > 1) ? atoi(argv[1]) : 120;
+
+    check_resolve();
+
+    // the placement before the plan: only LVGL pinned
+    TaskPlan unpinned;
+    for (int i = 0; i < TASK_MAX; i++) {
+        const task_placement_t *t = unpinned.get((task_id_t) i);
+        if (i != TASK_LVGL) {
+            unpinned.set((task_id_t) i, TASK_CORE_ANY, t->priority);
+        }
+    }
+    CHECK(unpinned.numWifiCoreConflicts() == 2, "unpinned conflicts %d", unpinned.numWifiCoreConflicts());
+
+    TaskPlan planned;
+    planned.resolve(NUM_CORES, MAX_PRIORITIES);
+
+    uint32_t worseP99 = 0;
+    for (uint32_t seed = 1; seed <= 3; seed++) {
+        Result a = simulate(unpinned, seconds, seed);
+        Result b = simulate(planned, seconds, seed);
+        printf("seed %u, %ds, %u notifies\n", seed, seconds, b.count);
+        printf("  unpinned  p50 %6uus p99 %6uus max %6uus avg %6uus  load %.1f%% / %.1f%%\n", a.p50, a.p99, a.max, a.avg,
+               a.load[0], a.load[1]);
+        printf("  planned   p50 %6uus p99 %6uus max %6uus avg %6uus  load %.1f%% / %.1f%%\n", b.p50, b.p99, b.max, b.avg,
+               b.load[0], b.load[1]);
+        CHECK(a.count > 0 && b.count > 0, "no notifies measured");
+        // the histogram reports the upper bound of the bucket
+        CHECK(b.histP99 >= b.p99 && b.histP99 <= 2 * b.p99, "histogram p99 %u, exact %u", b.histP99, b.p99);
+        worseP99 += b.p99 > a.p99;
+    }
+    CHECK(!worseP99, "planned p99 worse than unpinned in %u runs", worseP99);
+
+    printf(failures ? "%d check(s) failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
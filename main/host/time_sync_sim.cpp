@@ -0,0 +1,198 @@
+// Host simulation of TimeSync with simulated SNTP responses and clock drift.
+//
+//   c++ -O2 -std=c++17 -I.. -o time_sync_sim time_sync_sim.cpp ../time_sync.cpp
+//   ./time_sync_sim
+//
+// The monotonic clock runs with a configurable frequency error against the
+// true time, SNTP responses have a random network delay. Checks that the
+// drift is learned, the mapped time stays close to the true time and never
+// runs backwards, single bad responses are ignored and real jumps are stepped.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <random>
+
+#include "time_sync.h"
+
+static const int64_t EPOCH_US = 1760000000ll * 1000000ll;
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                         \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__);                                                                          \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+class Sim {
+  public:
+    TimeSync ts;
+    double crystalPpm;     // how much faster the monotonic clock runs
+    int64_t jitterUs;      // max one-way delay error of a response
+    int64_t serverErrorUs = 0;
+    int64_t trueUs = 0;    // true time since start
+    int64_t nextPollUs = 0;
+    int64_t lastUtc = 0;
+    int64_t maxErrorUs = 0;
+    bool backwards = false;
+    std::mt19937 rng;
+
+    Sim(double ppm, int64_t jitter, uint32_t seed) : crystalPpm(ppm), jitterUs(jitter), rng(seed) {}
+
+    int64_t mono() const
+    {
+        return 5000000 + (int64_t) ((double) trueUs * (1.0 + crystalPpm / 1e6));
+    }
+
+    int64_t response()
+    {
+        std::uniform_int_distribution<int64_t> d(-jitterUs, jitterUs);
+        return EPOCH_US + trueUs + serverErrorUs + d(rng);
+    }
+
+    TimeSync::Result poll(int64_t *step = nullptr)
+    {
+        int64_t s = 0;
+        TimeSync::Result r = ts.sample(mono(), response(), &s);
+        nextPollUs = trueUs + (int64_t) ts.getPollIntervalMs() * 1000;
+        if (step) {
+            *step = s;
+        }
+        return r;
+    }
+
+    // runs the clock, polls when due, checks the mapped time every 100ms
+    void run(int64_t durationUs, int64_t trackErrorAfterUs = -1)
+    {
+        int64_t end = trueUs + durationUs;
+        while (trueUs < end) {
+            trueUs += 100000;
+            if (trueUs >= nextPollUs) {
+                poll();
+            }
+            int64_t utc = ts.toUtc(mono());
+            if (lastUtc && utc < lastUtc) {
+                backwards = true;
+            }
+            lastUtc = utc;
+            int64_t err = llabs(utc - (EPOCH_US + trueUs + serverErrorUs));
+            if (trackErrorAfterUs >= 0 && trueUs >= trackErrorAfterUs && err > maxErrorUs) {
+                maxErrorUs = err;
+            }
+        }
+    }
+};
+
+static void test_drift(double ppm, int64_t jitter)
+{
+    printf("drift %+.1f ppm, jitter %lld ms\n", ppm, (long long) jitter / 1000);
+    Sim sim(ppm, jitter, 1234 + (int) ppm);
+    CHECK(sim.poll() == TimeSync::Result::First, "first sample");
+    sim.run(2ll * 3600 * 1000000);
+    sim.run(24ll * 3600 * 1000000, sim.trueUs);
+
+    double expected = (1.0 / (1.0 + ppm / 1e6) - 1.0) * 1e6;
+    printf("  estimate %+.2f ppm (expected %+.2f), max error %.1f ms, %u samples\n", sim.ts.getDriftPpm(), expected,
+           sim.maxErrorUs / 1000.0, sim.ts.getNumSamples());
+    CHECK(sim.ts.isDriftLocked(), "drift not locked");
+    CHECK(fabs(sim.ts.getDriftPpm() - expected) < 5.0, "drift estimate off");
+    CHECK(sim.maxErrorUs < 2 * jitter + 20000, "time error %lld us", (long long) sim.maxErrorUs);
+    CHECK(!sim.backwards, "time ran backwards");
+    CHECK(sim.ts.getNumSteps() == 0, "unexpected step");
+}
+
+static void test_outlier()
+{
+    printf("single bad response\n");
+    Sim sim(20.0, 10000, 42);
+    sim.poll();
+    sim.run(3ll * 3600 * 1000000);
+
+    int64_t before = sim.ts.toUtc(sim.mono());
+    sim.serverErrorUs = 30ll * 1000000;
+    CHECK(sim.poll() == TimeSync::Result::Pending, "outlier not held back");
+    CHECK(sim.ts.getPollIntervalMs() == TimeSync::POLL_CONFIRM_MS, "no fast confirmation poll");
+    CHECK(llabs(sim.ts.toUtc(sim.mono()) - before) < 1000, "outlier moved the clock");
+
+    sim.serverErrorUs = 0;
+    sim.run(TimeSync::POLL_CONFIRM_MS * 1000ll + 100000);
+    CHECK(sim.ts.getNumSteps() == 0, "outlier stepped the clock");
+    CHECK(!sim.backwards, "time ran backwards");
+}
+
+static void test_step()
+{
+    printf("server time jumps by 2.5s\n");
+    Sim sim(-15.0, 10000, 7);
+    sim.poll();
+    sim.run(3ll * 3600 * 1000000);
+    double drift = sim.ts.getDriftPpm();
+
+    sim.serverErrorUs = 2500000;
+    CHECK(sim.poll() == TimeSync::Result::Pending, "first large offset not held back");
+    sim.trueUs += TimeSync::POLL_CONFIRM_MS * 1000ll;
+    int64_t step = 0;
+    CHECK(sim.poll(&step) == TimeSync::Result::Step, "confirmed offset not stepped");
+    printf("  step %.1f ms\n", step / 1000.0);
+    CHECK(llabs(step - 2500000) < 30000, "step size %lld us", (long long) step);
+    CHECK(sim.ts.getDriftPpm() == drift, "step changed the drift estimate");
+
+    sim.lastUtc = 0;
+    sim.maxErrorUs = 0;
+    sim.run(6ll * 3600 * 1000000, sim.trueUs);
+    CHECK(sim.ts.getNumSteps() == 1, "%u steps", sim.ts.getNumSteps());
+    CHECK(sim.maxErrorUs < 50000, "time error after step %lld us", (long long) sim.maxErrorUs);
+}
+
+static void test_slew()
+{
+    printf("100ms offset is slewed\n");
+    Sim sim(0.0, 0, 1);
+    sim.poll();
+    sim.run(3ll * 3600 * 1000000);
+
+    sim.serverErrorUs = 100000;
+    sim.trueUs = sim.nextPollUs;
+    CHECK(sim.poll() == TimeSync::Result::Slew, "small offset not slewed");
+
+    // at 500ppm 100ms take 200s
+    int64_t start = sim.trueUs;
+    sim.run(199ll * 1000000);
+    CHECK(sim.ts.getSlewRemaining(sim.mono()) > 0, "slewed too fast");
+    sim.run(2ll * 1000000);
+    CHECK(llabs(sim.ts.getSlewRemaining(sim.mono())) < 1000, "slew not done after %llds",
+          (long long) (sim.trueUs - start) / 1000000);
+    CHECK(!sim.backwards, "time ran backwards");
+    CHECK(sim.ts.getNumSteps() == 0, "unexpected step");
+}
+
+static void test_reject()
+{
+    printf("implausible responses\n");
+    TimeSync ts;
+    CHECK(ts.sample(1000000, 0, nullptr) == TimeSync::Result::Rejected, "epoch 0 accepted");
+    CHECK(!ts.isSynced(), "synced by rejected sample");
+    CHECK(ts.sample(2000000, EPOCH_US, nullptr) == TimeSync::Result::First, "valid sample");
+    CHECK(ts.sample(1000000, EPOCH_US, nullptr) == TimeSync::Result::Rejected, "older monotonic time accepted");
+}
+
+int main()
+{
+    test_drift(0.0, 5000);
+    test_drift(40.0, 15000);
+    test_drift(-80.0, 30000);
+    test_drift(250.0, 15000);
+    test_outlier();
+    test_step();
+    test_slew();
+    test_reject();
+
+    printf(failures ? "%d check(s) failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}
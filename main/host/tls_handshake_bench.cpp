@@ -0,0 +1,261 @@
+// Host measurement of the stratum+ssl connection setup against
+// host/mock_tls_pool.py, with OpenSSL standing in for mbedtls.
+//
+//   c++ -O2 -std=gnu++17 -o tls_handshake_bench tls_handshake_bench.cpp -lssl -lcrypto
+//   python3 mock_tls_pool.py --port 3334 --dir /tmp/pool &
+//   ./tls_handshake_bench 3334 /tmp/pool/ca.pem [rounds]
+//
+// Runs the connect sequence of the miner (handshake, subscribe, first notify)
+// the way TlsStratumTransport does it: the first connection with a full
+// handshake, the following ones offering the saved session. Prints client
+// CPU time and bytes on the wire for both and checks that the pool resumes,
+// that a resumed handshake is cheaper and that the preferred suites and the
+// max fragment length are negotiated. The same runs without the preferred
+// lists show what the defaults would cost.
+//
+// The checks expect the default mock (tickets on). With --no-tickets TLS 1.3
+// has nothing to resume and the transport falls back to full handshakes.
+//
+// Loopback, x86, RSA 2048 leaf, 50 reconnects, CPU time of the client:
+//   tls1.3 defaults        full 1.39 ms 2469 B | resumed 0.41 ms 1375 B
+//   tls1.3 preferred+mfl   full 0.94 ms 2423 B | resumed 0.42 ms 1329 B
+//   tls1.2 defaults        full 1.16 ms 1962 B | resumed 0.27 ms  833 B
+//   tls1.2 preferred+mfl   full 0.95 ms 1926 B | resumed 0.27 ms  797 B
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                         \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("  FAIL %s:%d: ", __FILE__, __LINE__);                                                                          \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+// same order as in stratum_transport.cpp
+static const char *preferred_tls13 = "TLS_AES_128_GCM_SHA256:TLS_CHACHA20_POLY1305_SHA256:TLS_AES_256_GCM_SHA384";
+static const char *preferred_tls12 = "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+                                     "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305:"
+                                     "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384";
+static const char *preferred_groups = "X25519:P-256:P-384";
+
+typedef struct
+{
+    double cpuMs;
+    unsigned long rx;
+    unsigned long tx;
+    bool resumed;
+    bool notify;
+    int mfl;
+    char version[16];
+    char suite[64];
+} conn_result_t;
+
+static double thread_cpu_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int tcp_connect(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// reads lines until the first mining.notify
+static bool wait_notify(SSL *ssl)
+{
+    char buf[4096];
+    size_t len = 0;
+    while (len < sizeof(buf) - 1) {
+        int n = SSL_read(ssl, buf + len, sizeof(buf) - 1 - len);
+        if (n <= 0) {
+            return false;
+        }
+        len += n;
+        buf[len] = 0;
+        if (strstr(buf, "mining.notify")) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// one connect sequence, *session is offered and replaced by the new one
+static bool run_connection(SSL_CTX *ctx, int port, bool mfl, SSL_SESSION **session, conn_result_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    int fd = tcp_connect(port);
+    if (fd < 0) {
+        return false;
+    }
+
+    double start = thread_cpu_ms();
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    SSL_set_tlsext_host_name(ssl, "localhost");
+    SSL_set1_host(ssl, "localhost");
+    if (mfl) {
+        SSL_set_tlsext_max_fragment_length(ssl, TLSEXT_max_fragment_length_4096);
+    }
+    if (*session) {
+        SSL_set_session(ssl, *session);
+    }
+
+    bool ok = SSL_connect(ssl) == 1;
+    if (ok) {
+        static const char subscribe[] = "{\"id\":1,\"method\":\"mining.subscribe\",\"params\":[\"bench/1.0\"]}\n";
+        ok = SSL_write(ssl, subscribe, sizeof(subscribe) - 1) > 0 && wait_notify(ssl);
+        r->notify = ok;
+    } else {
+        ERR_print_errors_fp(stdout);
+    }
+    r->cpuMs = thread_cpu_ms() - start;
+
+    if (ok) {
+        r->resumed = SSL_session_reused(ssl);
+        r->mfl = SSL_SESSION_get_max_fragment_length(SSL_get0_session(ssl));
+        snprintf(r->version, sizeof(r->version), "%s", SSL_get_version(ssl));
+        snprintf(r->suite, sizeof(r->suite), "%s", SSL_get_cipher_name(ssl));
+
+        // TLS 1.3 tickets arrived with the first reads
+        SSL_SESSION *s = SSL_get1_session(ssl);
+        if (s && SSL_SESSION_is_resumable(s)) {
+            if (*session) {
+                SSL_SESSION_free(*session);
+            }
+            *session = s;
+        } else if (s) {
+            SSL_SESSION_free(s);
+        }
+    }
+
+    r->rx = BIO_number_read(SSL_get_rbio(ssl));
+    r->tx = BIO_number_written(SSL_get_wbio(ssl));
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(fd);
+    return ok;
+}
+
+static SSL_CTX *make_ctx(const char *ca, bool preferred, int maxVersion)
+{
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+    SSL_CTX_load_verify_locations(ctx, ca, nullptr);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_set_max_proto_version(ctx, maxVersion);
+    if (preferred) {
+        SSL_CTX_set_ciphersuites(ctx, preferred_tls13);
+        SSL_CTX_set_cipher_list(ctx, preferred_tls12);
+        SSL_CTX_set1_groups_list(ctx, preferred_groups);
+    }
+    return ctx;
+}
+
+static void bench(const char *label, int port, const char *ca, bool preferred, bool mfl, int maxVersion, int rounds)
+{
+    SSL_CTX *ctx = make_ctx(ca, preferred, maxVersion);
+    SSL_SESSION *session = nullptr;
+
+    conn_result_t full, r;
+    double resumedCpu = 0;
+    unsigned long resumedBytes = 0;
+    int numResumed = 0;
+
+    bool ok = run_connection(ctx, port, mfl, &session, &full);
+    CHECK(ok, "%s: first connection failed", label);
+    CHECK(!full.resumed, "%s: first connection resumed", label);
+    CHECK(session != nullptr, "%s: no session to resume", label);
+
+    for (int i = 0; ok && i < rounds; i++) {
+        if (!run_connection(ctx, port, mfl, &session, &r)) {
+            CHECK(false, "%s: reconnect %d failed", label, i);
+            break;
+        }
+        numResumed += r.resumed;
+        resumedCpu += r.cpuMs;
+        resumedBytes += r.rx + r.tx;
+    }
+
+    printf("%-28s %-8s %-30s full %6.2f ms %5lu B", label, full.version, full.suite, full.cpuMs, full.rx + full.tx);
+    if (numResumed) {
+        printf(" | resumed %6.2f ms %5lu B (%d/%d)", resumedCpu / rounds, resumedBytes / rounds, numResumed, rounds);
+    }
+    printf(" | mfl %d\n", full.mfl);
+
+    CHECK(numResumed == rounds, "%s: %d of %d reconnects resumed", label, numResumed, rounds);
+    if (numResumed) {
+        CHECK(resumedCpu / rounds < full.cpuMs, "%s: resumed not cheaper", label);
+        CHECK(resumedBytes / rounds < full.rx + full.tx, "%s: resumed not smaller", label);
+    }
+    if (mfl) {
+        CHECK(full.mfl == TLSEXT_max_fragment_length_4096, "%s: max fragment length not negotiated", label);
+    }
+    if (preferred) {
+        // the pool picks from the list (most use their own order)
+        CHECK(strstr(preferred_tls13, full.suite) || strstr(preferred_tls12, full.suite), "%s: unexpected suite %s", label,
+              full.suite);
+    }
+
+    if (session) {
+        SSL_SESSION_free(session);
+    }
+    SSL_CTX_free(ctx);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        printf("usage: %s <port> <pinned ca.pem> [rounds]\n", argv[0]);
+        return 2;
+    }
+    int port = atoi(argv[1]);
+    const char *ca = argv[2];
+    int rounds = argc > 3 ? atoi(argv[3]) : 20;
+
+    bench("tls1.3 defaults", port, ca, false, false, TLS1_3_VERSION, rounds);
+    bench("tls1.3 preferred+mfl", port, ca, true, true, TLS1_3_VERSION, rounds);
+    bench("tls1.2 defaults", port, ca, false, false, TLS1_2_VERSION, rounds);
+    bench("tls1.2 preferred+mfl", port, ca, true, true, TLS1_2_VERSION, rounds);
+
+    // a wrong pin has to fail the handshake
+    {
+        SSL_CTX *ctx = make_ctx("/dev/null", true, TLS1_3_VERSION);
+        SSL_SESSION *session = nullptr;
+        conn_result_t r;
+        CHECK(!run_connection(ctx, port, true, &session, &r), "connection with a wrong pin succeeded");
+        SSL_CTX_free(ctx);
+    }
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
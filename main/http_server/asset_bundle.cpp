@@ -0,0 +1,219 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#include "asset_bundle.h"
+
+static const char *TAG = "asset_bundle";
+
+static esp_partition_mmap_handle_t s_handle;
+static const uint8_t *s_base = NULL;
+static size_t s_size = 0;
+static uint16_t s_count = 0;
+
+// assets are sent from the mapping by the async workers, it must not be
+// unmapped under them
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static int s_refs = 0;
+static bool s_closing = false;
+
+static const asset_bundle_entry_t *entry(int i)
+{
+    return (const asset_bundle_entry_t *) (s_base + sizeof(asset_bundle_header_t)) + i;
+}
+
+// strings must be terminated inside of the mapped bundle
+static const char *string_at(uint32_t offset)
+{
+    if (offset >= s_size || !memchr(s_base + offset, 0, s_size - offset)) {
+        return NULL;
+    }
+    return (const char *) (s_base + offset);
+}
+
+static bool validate(void)
+{
+    for (int i = 0; i < s_count; i++) {
+        const asset_bundle_entry_t *e = entry(i);
+        if (!string_at(e->path_offset) || !string_at(e->mime_offset)) {
+            ESP_LOGE(TAG, "invalid string in entry %d", i);
+            return false;
+        }
+        if (e->offset > s_size || e->size > s_size - e->offset) {
+            ESP_LOGE(TAG, "entry %d out of bounds", i);
+            return false;
+        }
+        // binary search depends on the order
+        if (i && strcmp(string_at(entry(i - 1)->path_offset), string_at(e->path_offset)) >= 0) {
+            ESP_LOGE(TAG, "index not sorted at entry %d", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+esp_err_t asset_bundle_init(void)
+{
+    esp_err_t err = asset_bundle_release(0);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, "www");
+    if (!part) {
+        ESP_LOGE(TAG, "www partition not found");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    asset_bundle_header_t header;
+    err = esp_partition_read(part, 0, &header, sizeof(header));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (memcmp(header.magic, ASSET_BUNDLE_MAGIC, sizeof(header.magic)) || header.version != ASSET_BUNDLE_VERSION) {
+        ESP_LOGI(TAG, "no asset bundle in www partition");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (header.total_size > part->size ||
+        header.total_size < sizeof(header) + (size_t) header.count * sizeof(asset_bundle_entry_t)) {
+        ESP_LOGE(TAG, "invalid bundle size %lu", (unsigned long) header.total_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const void *ptr = NULL;
+    esp_partition_mmap_handle_t handle;
+    err = esp_partition_mmap(part, 0, header.total_size, ESP_PARTITION_MMAP_DATA, &ptr, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "failed to map www partition (%s)", esp_err_to_name(err));
+        return err;
+    }
+
+    // nobody can see it before it's validated
+    pthread_mutex_lock(&s_lock);
+    s_handle = handle;
+    s_base = (const uint8_t *) ptr;
+    s_size = header.total_size;
+    s_count = header.count;
+    s_closing = true;
+    pthread_mutex_unlock(&s_lock);
+
+    if (!validate()) {
+        asset_bundle_release(0);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    pthread_mutex_lock(&s_lock);
+    s_closing = false;
+    pthread_mutex_unlock(&s_lock);
+
+    ESP_LOGI(TAG, "asset bundle mapped: %d files, %d bytes", s_count, (int) s_size);
+    return ESP_OK;
+}
+
+esp_err_t asset_bundle_release(int timeout_ms)
+{
+    pthread_mutex_lock(&s_lock);
+    if (!s_base) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_OK;
+    }
+    s_closing = true;
+
+    // wait for the assets being sent
+    int waited = 0;
+    while (s_refs > 0 && waited < timeout_ms) {
+        pthread_mutex_unlock(&s_lock);
+        vTaskDelay(pdMS_TO_TICKS(10));
+        waited += 10;
+        pthread_mutex_lock(&s_lock);
+    }
+    if (s_refs > 0) {
+        ESP_LOGW(TAG, "bundle still in use by %d requests", s_refs);
+        s_closing = false;
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    s_base = NULL;
+    s_size = 0;
+    s_count = 0;
+    s_closing = false;
+    esp_partition_munmap(s_handle);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+bool asset_bundle_available(void)
+{
+    return s_base != NULL && !s_closing;
+}
+
+bool asset_bundle_ref(void)
+{
+    pthread_mutex_lock(&s_lock);
+    bool ok = s_base && !s_closing;
+    if (ok) {
+        s_refs++;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ok;
+}
+
+void asset_bundle_unref(void)
+{
+    pthread_mutex_lock(&s_lock);
+    s_refs--;
+    pthread_mutex_unlock(&s_lock);
+}
+
+bool asset_bundle_find(const char *path, asset_t *asset)
+{
+    if (!s_base) {
+        return false;
+    }
+
+    int lo = 0;
+    int hi = s_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const asset_bundle_entry_t *e = entry(mid);
+        int cmp = strcmp(path, (const char *) (s_base + e->path_offset));
+        if (cmp == 0) {
+            asset->data = s_base + e->offset;
+            asset->size = e->size;
+            asset->mime = (const char *) (s_base + e->mime_offset);
+            asset->hash = e->hash;
+            asset->gzip = e->flags & ASSET_FLAG_GZIP;
+            return true;
+        }
+        if (cmp < 0) {
+            hi = mid - 1;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return false;
+}
+
+void asset_bundle_etag(const asset_t *asset, char *etag, size_t len)
+{
+    if (len < ASSET_BUNDLE_ETAG_LEN) {
+        etag[0] = 0;
+        return;
+    }
+    char *p = etag;
+    *p++ = '"';
+    for (int i = 0; i < ASSET_BUNDLE_HASH_LEN; i++) {
+        p += sprintf(p, "%02x", asset->hash[i]);
+    }
+    *p++ = '"';
+    *p = 0;
+}
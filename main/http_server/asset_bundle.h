@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define ASSET_BUNDLE_MAGIC "NQAB"
+#define ASSET_BUNDLE_VERSION 1
+#define ASSET_BUNDLE_HASH_LEN 16
+
+// ETag is the hex content hash in quotes
+#define ASSET_BUNDLE_ETAG_LEN (ASSET_BUNDLE_HASH_LEN * 2 + 3)
+
+#define ASSET_FLAG_GZIP 0x01
+
+// Read-only asset bundle in the www partition
+//
+// The bundle is built by python-asset-bundle/build_asset_bundle.py and
+// memory mapped, assets are sent directly from flash without going
+// through a filesystem.
+//
+// header | sorted index | string table | data
+typedef struct __attribute__((packed))
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t count;
+    uint32_t total_size;
+    uint32_t strings_offset;
+    uint32_t data_offset;
+    uint32_t reserved;
+} asset_bundle_header_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t path_offset;
+    uint32_t mime_offset;
+    uint32_t offset;
+    uint32_t size;
+    uint8_t hash[ASSET_BUNDLE_HASH_LEN];
+    uint32_t flags;
+} asset_bundle_entry_t;
+
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    const char *mime;
+    const uint8_t *hash;
+    bool gzip;
+} asset_t;
+
+// maps the www partition, fails if it doesn't contain a valid bundle
+esp_err_t asset_bundle_init(void);
+
+// unmaps the bundle (before the partition is overwritten). New references
+// fail right away, the assets still being sent are waited for. On
+// ESP_ERR_TIMEOUT the bundle stays mapped
+esp_err_t asset_bundle_release(int timeout_ms);
+
+bool asset_bundle_available(void);
+
+// keeps the mapping until asset_bundle_unref(), false if there is no bundle
+bool asset_bundle_ref(void);
+void asset_bundle_unref(void);
+
+// looks up an asset by its url path (e.g. "/index.html"), the data is
+// valid while a reference is held
+bool asset_bundle_find(const char *path, asset_t *asset);
+
+// writes the quoted ETag of an asset
+void asset_bundle_etag(const asset_t *asset, char *etag, size_t len);
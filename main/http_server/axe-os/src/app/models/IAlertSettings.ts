@@ -1,7 +1,18 @@
+export interface IAlertTarget {
+  type: 'discord' | 'telegram' | 'ntfy' | 'generic';
+  url?: string;
+  extra?: string;
+  sent?: number;
+  failed?: number;
+  dropped?: number;
+}
+
 export interface IAlertSettings {
   alertDiscordWebhook: string;
   alertDiscordWatchdogEnable: boolean;
   alertDiscordBlockFoundEnable: boolean;
   alertDiscordBestDiffEnable: boolean;
   showBlockFoundScreenEnable: boolean;
+  alertTargets?: IAlertTarget[];
+  alertPending?: number;
 }
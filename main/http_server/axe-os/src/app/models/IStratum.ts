@@ -1,4 +1,5 @@
 export interface IPool {
+    configured?: boolean,
     connected: boolean,
     poolDiffErr: boolean,
     poolDifficulty: number,
@@ -7,6 +8,9 @@ export interface IPool {
     bestDiff: number,
     pingRtt: number,
     pingLoss: number,
+    weight?: number,      // weighted mode
+    share?: number,       // expected share of the work in percent
+    responseMs?: number,  // submit -> response
     // for compatibility reasons only transient here
     // to not have duplicated data in the info endpoint
     host?: string,
@@ -19,6 +23,7 @@ export interface IStratum {
     activePoolMode: number,
     poolBalance?: number, // dual-pool only
     usingFallback?: boolean, // prim/fb only
+    selected?: number,       // pool with the work in single pool modes
     totalBestDiff: number,
     pools: IPool[],
 }
@@ -28,6 +28,12 @@ export interface ISystemInfo {
     bestSessionDiff: number,
     freeHeap: number,
     freeHeapInt: number,
+    largestFreeBlock?: number,
+    largestFreeBlockInt?: number,
+    minFreeHeapInt?: number,
+    notifyPoolUsed?: number,
+    notifyPoolPeak?: number,
+    notifyPoolFallbacks?: number,
     coreVoltage: number,
     defaultCoreVoltage: number,
     hostname: string,
@@ -49,12 +55,31 @@ export interface ISystemInfo {
     stratumUser: string,
     stratumEnonceSubscribe: number,
     stratumTLS: number,
+    stratumTLSCert?: string,
     fallbackStratumURL: string,
     fallbackStratumPort: number,
     fallbackStratumUser: string,
     fallbackStratumEnonceSubscribe: number,
     fallbackStratumTLS: number,
+    fallbackStratumTLSCert?: string,
+    pool3URL?: string,
+    pool3Port?: number,
+    pool3User?: string,
+    pool3EnonceSubscribe?: number,
+    pool3TLS?: number,
+    pool3TLSCert?: string,
+    pool4URL?: string,
+    pool4Port?: number,
+    pool4User?: string,
+    pool4EnonceSubscribe?: number,
+    pool4TLS?: number,
+    pool4TLSCert?: string,
+    pool1Weight?: number,
+    pool2Weight?: number,
+    pool3Weight?: number,
+    pool4Weight?: number,
     stratumDifficulty: number,
+    shareInterval?: number,
     poolDifficulty: number,
     frequency: number,
     defaultFrequency: number,
@@ -63,6 +63,7 @@ export class EditComponent implements OnInit {
     'wifiStatus',
     'invertfanpolarity',
     'stratumDifficulty',
+    'shareInterval',
     'stratum_keep',
     'poolMode',
   ]);
@@ -175,6 +176,34 @@ export class EditComponent implements OnInit {
           fallbackStratumEnonceSubscribe: [info.fallbackStratumEnonceSubscribe == 1],
           fallbackStratumTLS: [info.fallbackStratumTLS == 1],
 
+          pool3URL: [info.pool3URL ?? '', [
+            Validators.pattern(/^(?!.*stratum\+tcp:\/\/).*$/),
+            Validators.pattern(/^[^:]*$/),
+          ]],
+          pool3Port: [info.pool3Port ?? 3333, [
+            Validators.pattern(/^[^:]*$/),
+            Validators.min(0),
+            Validators.max(65353)
+          ]],
+          pool3User: [info.pool3User ?? ''],
+          pool3Password: ['*****'],
+          pool3EnonceSubscribe: [info.pool3EnonceSubscribe == 1],
+          pool3TLS: [info.pool3TLS == 1],
+
+          pool4URL: [info.pool4URL ?? '', [
+            Validators.pattern(/^(?!.*stratum\+tcp:\/\/).*$/),
+            Validators.pattern(/^[^:]*$/),
+          ]],
+          pool4Port: [info.pool4Port ?? 3333, [
+            Validators.pattern(/^[^:]*$/),
+            Validators.min(0),
+            Validators.max(65353)
+          ]],
+          pool4User: [info.pool4User ?? ''],
+          pool4Password: ['*****'],
+          pool4EnonceSubscribe: [info.pool4EnonceSubscribe == 1],
+          pool4TLS: [info.pool4TLS == 1],
+
           hostname: [info.hostname, [Validators.required]],
           ssid: [info.ssid, [Validators.required]],
           wifiPass: ['*****'],
@@ -183,13 +212,13 @@ export class EditComponent implements OnInit {
           frequency: [info.frequency, [Validators.required]],
           jobInterval: [info.jobInterval, [Validators.required]],
           stratumDifficulty: [info.stratumDifficulty, [Validators.required, Validators.min(1)]],
+          shareInterval: [info.shareInterval ?? 0, [Validators.required, Validators.min(0), Validators.max(3600)]],
 
-          poolMode: [info.stratum?.poolMode ?? 0, [Validators.required]],        // 0 = Failover, 1 = Dual
-          poolBalance: [info.stratum?.poolBalance ?? 50, [                  // Anteil PRIMARY in %
-            Validators.required,
-            Validators.min(0),
-            Validators.max(100),
-          ]],
+          poolMode: [info.stratum?.poolMode ?? 0, [Validators.required]],        // 0 = Failover, 1 = Weighted, 2 = Latency
+          pool1Weight: [info.pool1Weight ?? info.stratum?.poolBalance ?? 50, [Validators.min(0), Validators.max(100)]],
+          pool2Weight: [info.pool2Weight ?? 100 - (info.stratum?.poolBalance ?? 50), [Validators.min(0), Validators.max(100)]],
+          pool3Weight: [info.pool3Weight ?? 0, [Validators.min(0), Validators.max(100)]],
+          pool4Weight: [info.pool4Weight ?? 0, [Validators.min(0), Validators.max(100)]],
 
           autofanspeed: [info.autofanspeed ?? 0, [Validators.required]],
           pidTargetTemp: [info.pidTargetTemp ?? 55, [
@@ -293,6 +322,8 @@ export class EditComponent implements OnInit {
     if (form.wifiPass === '*****') delete form.wifiPass;
     if (form.stratumPassword === '*****') delete form.stratumPassword;
     if (form.fallbackStratumPassword === '*****') delete form.fallbackStratumPassword;
+    if (form.pool3Password === '*****') delete form.pool3Password;
+    if (form.pool4Password === '*****') delete form.pool4Password;
 
     form.stratum_keep = form.stratum_keep ? 1 : 0;
 
@@ -347,6 +378,12 @@ export class EditComponent implements OnInit {
     this.showFallbackStratumPassword = !this.showFallbackStratumPassword;
   }
 
+  // pools 3 and 4
+  showPoolPassword: { [pool: number]: boolean } = {};
+  togglePoolPasswordVisibility(pool: number) {
+    this.showPoolPassword[pool] = !this.showPoolPassword[pool];
+  }
+
   showWifiPassword: boolean = false;
   toggleWifiPasswordVisibility() {
     this.showWifiPassword = !this.showWifiPassword;
@@ -493,12 +530,14 @@ export class EditComponent implements OnInit {
       });
   }
 
-  public poolTabHeader(i: 0 | 1) {
+  public poolTabHeader(i: number) {
     if (this.form?.get("poolMode")?.value == 0) {
       if (i == 0) {
         return this.translate.instant('SETTINGS.PRIMARY_STRATUM_POOL');
       }
-      return this.translate.instant('SETTINGS.FALLBACK_STRATUM_POOL');
+      if (i == 1) {
+        return this.translate.instant('SETTINGS.FALLBACK_STRATUM_POOL');
+      }
     }
     return `Pool ${i + 1}`;
   }
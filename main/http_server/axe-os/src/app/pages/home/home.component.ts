@@ -64,6 +64,10 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
   private legendVisibilityKey = 'chartLegendVisibility';
 
   public isDualPool: boolean = false;
+  // single pool modes: the pool that gets the work
+  public selectedPool: number = 0;
+  // weighted mode: the pools that get a share of the work
+  public activePools: number[] = [0, 1];
 
   ngAfterViewChecked(): void {
     // Ensure chart is initialized only once when the canvas becomes available
@@ -319,6 +323,11 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
         info.overheat_temp = parseFloat(info.overheat_temp.toFixed(1));
 
         this.isDualPool = (info.stratum?.activePoolMode ?? 0) === 1;
+        this.selectedPool = info.stratum?.selected ?? 0;
+        this.activePools = (info.stratum?.pools ?? [])
+          .map((p, i) => ({ p, i }))
+          .filter(({ p, i }) => p.configured ?? i < 2)
+          .map(({ i }) => i);
         const chipTemps = info?.asicTemps ?? [];
         this.hasChipTemps =
           Array.isArray(chipTemps) &&
@@ -671,9 +680,9 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
       return "warning";
     }
 
-    const pool = stratum.pools[0];
+    const pool = stratum.pools[this.selectedPool];
 
-    if (!pool.connected) {
+    if (!pool?.connected) {
       return 'danger';
     }
 
@@ -681,12 +690,11 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
     return stratum.usingFallback ? 'warning' : 'success';
   }
 
-  public getPoolPercent(idx: 0 | 1): number {
-    const balance = this._info.stratum.poolBalance ?? 50;
-    return idx === 0 ? balance : 100 - balance;
+  public getPoolPercent(idx: number): number {
+    return this._info.stratum.pools[idx]?.weight ?? 0;
   }
 
-  public showPoolBadge(idx: 0 | 1): boolean {
+  public showPoolBadge(idx: number): boolean {
     return this.getPoolPercent(idx) > 0;
   }
 
@@ -696,9 +704,9 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
     if (stratum === undefined) {
       return this.translateService.instant('HOME.DISCONNECTED');
     }
-    const pool = stratum.pools[0];
+    const pool = stratum.pools[this.selectedPool];
 
-    if (!pool.connected) {
+    if (!pool?.connected) {
       return this.translateService.instant('HOME.DISCONNECTED');
     }
     return stratum.usingFallback
@@ -706,12 +714,12 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
       : this.translateService.instant('HOME.PRIMARY_POOL');
   }
 
-  public dualPoolBadgeLabel(i: 0 | 1) {
+  public dualPoolBadgeLabel(i: number) {
     const percent = this.getActiveBalance(i);
     return `Pool ${i + 1} (${percent} %)`;
   }
 
-  public dualPoolBadgeTooltip(i: 0 | 1) {
+  public dualPoolBadgeTooltip(i: number) {
     const stratum = this._info.stratum;
     const pool = stratum.pools[i];
     const connected = pool.connected;
@@ -728,7 +736,7 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
     return this.translateService.instant('HOME.DISCONNECTED');;
   }
 
-  public dualPoolBadgeStatus(i: 0 | 1) {
+  public dualPoolBadgeStatus(i: number) {
     const pool = this._info.stratum.pools[i];
     const connected = pool.connected;
     const diffErr = pool.poolDiffErr;
@@ -744,60 +752,38 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
     return "danger";
   }
 
-  public getPoolHashrate(i: 0 | 1) {
+  public getPoolHashrate(i: number) {
     const balance = this.getActiveBalance(i);
     return this._info.hashRate * balance / 100.0;
   }
 
-  public getActiveBalance(i: 0 | 1) {
-    const stratum = this._info.stratum;
-    const connected = stratum.pools.map(p => p.connected);
-    const balance = stratum.poolBalance;
-
-    // If neither pool is connected
-    if (!connected[0] && !connected[1]) {
-      return 0;
-    }
-
-    // If both pools are connected
-    if (connected[0] && connected[1]) {
-      return i === 0 ? balance : 100 - balance;
-    }
-
-    // Only one pool is connected → return 100 for that pool, 0 for the other
-    return connected[i] ? 100 : 0;
+  // share of the work in percent, the firmware redistributes the weights of
+  // disconnected pools
+  public getActiveBalance(i: number) {
+    return this._info.stratum.pools[i]?.share ?? 0;
   }
 
 
-  public getPoolInfo(i?: 0 | 1): IPool {
+  public getPoolInfo(i?: number): IPool {
     const stratum = this._info.stratum;
 
-    // failover logic, "current" pool
-    if (i === undefined) {
-      const useFallback = stratum?.usingFallback ?? false;
-      const base = stratum?.pools[useFallback ? 1 : 0] ?? {};
+    // single pool modes, "current" pool
+    const idx = i ?? this.selectedPool;
+    const base: Partial<IPool> = stratum?.pools[idx] ?? {};
 
-      return {
-        ...base,
-        host: useFallback ? this._info.fallbackStratumURL : this._info.stratumURL,
-        port: useFallback ? this._info.fallbackStratumPort : this._info.stratumPort,
-        user: useFallback ? this._info.fallbackStratumUser : this._info.stratumUser,
-      };
-    }
-
-    // explicit pool 0 / 1 (dual pool)
-    const base = stratum.pools[i];
+    // primary and secondary user are only in the settings
+    const users = [this._info.stratumUser, this._info.fallbackStratumUser, this._info.pool3User, this._info.pool4User];
 
     return {
       ...base,
-      host: i === 0 ? this._info.stratumURL : this._info.fallbackStratumURL,
-      port: i === 0 ? this._info.stratumPort : this._info.fallbackStratumPort,
-      user: i === 0 ? this._info.stratumUser : this._info.fallbackStratumUser,
-    };
+      host: base.host ?? (idx === 0 ? this._info.stratumURL : this._info.fallbackStratumURL),
+      port: base.port ?? (idx === 0 ? this._info.stratumPort : this._info.fallbackStratumPort),
+      user: users[idx] ?? '',
+    } as IPool;
   }
 
-  public getPoolCardIndices(): (0 | 1 | undefined)[] {
-    return (this._info.stratum?.activePoolMode ?? 0) === 0 ? [undefined] : [0, 1];
+  public getPoolCardIndices(): (number | undefined)[] {
+    return this.isDualPool ? this.activePools : [undefined];
   }
 
 
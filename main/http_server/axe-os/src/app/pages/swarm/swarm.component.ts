@@ -434,6 +434,12 @@ export class SwarmComponent implements OnInit, OnDestroy {
 
   public getActiveBalance(axe, i: 0 | 1) {
     const stratum = axe.stratum;
+
+    // newer firmware reports the share per pool
+    if (stratum.pools[i]?.share !== undefined) {
+      return stratum.pools[i].share;
+    }
+
     const connected = stratum.pools.map(p => p.connected);
     const balance = stratum.poolBalance;
 
@@ -33,6 +33,12 @@ const defaultInfo: ISystemInfo = {
   bestSessionDiff: 0,
   freeHeap: 8388608,
   freeHeapInt: 102400,
+  largestFreeBlock: 7340032,
+  largestFreeBlockInt: 61440,
+  minFreeHeapInt: 81920,
+  notifyPoolUsed: 2,
+  notifyPoolPeak: 3,
+  notifyPoolFallbacks: 0,
   coreVoltage: 1200,
   defaultCoreVoltage: 1200,
   coreVoltageActual: 1200,
@@ -74,6 +80,7 @@ const defaultInfo: ISystemInfo = {
   lastResetReason: "Unknown",
   jobInterval: 1200,
   stratumDifficulty: 1000,
+  shareInterval: 0,
   lastpingrtt: 0.00,
   recentpingloss: 0.00,
   poolDifficulty: 0,
@@ -87,6 +94,7 @@ const defaultInfo: ISystemInfo = {
     activePoolMode: 0,
     //poolBalance: 100,
     usingFallback: false,
+    selected: 0,
     totalBestDiff: 0,
     pools: [{
       connected: false,
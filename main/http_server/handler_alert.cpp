@@ -1,3 +1,6 @@
+#include <string.h>
+#include <string>
+
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "ArduinoJson.h"
@@ -39,6 +42,10 @@ esp_err_t GET_alert_info(httpd_req_t *req)
     doc["alertDiscordBestDiffEnable"] = Config::isDiscordBestDiffAlertEnabled() ? 1 : 0;
     doc["showBlockFoundScreenEnable"] = Config::isShowBlockFoundEnabled() ? 1 : 0;
 
+    // active webhooks with delivery counters, URLs aren't sent either
+    discordAlerter.getTargets(doc["alertTargets"].to<JsonArray>());
+    doc["alertPending"] = discordAlerter.getNumPending();
+
     esp_err_t ret = sendJsonResponse(req, doc);
 
     doc.clear();
@@ -48,6 +55,70 @@ esp_err_t GET_alert_info(httpd_req_t *req)
 }
 
 
+// checks the additional webhooks and stores them, targets sent without URL
+// keep the stored one (the URLs aren't returned by GET)
+static esp_err_t update_alert_targets(httpd_req_t *req, JsonArray targets)
+{
+    if (targets.size() > ALERT_MAX_TARGETS - 1) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Too many alert targets");
+        return ESP_FAIL;
+    }
+
+    PSRAMAllocator allocator;
+    JsonDocument stored(&allocator);
+    char *json = Config::getAlertTargets();
+    if (json) {
+        deserializeJson(stored, json);
+    }
+    free(json);
+
+    JsonDocument out(&allocator);
+    JsonArray arr = out.to<JsonArray>();
+
+    for (size_t i = 0; i < targets.size(); i++) {
+        JsonObject t = targets[i];
+        const char *typeStr = t["type"] | "";
+        webhook_type_t type = AlertQueue::typeFromStr(typeStr);
+        if (type == WEBHOOK_TYPE_MAX) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid alert target type");
+            return ESP_FAIL;
+        }
+
+        const char *url = t["url"] | "";
+        if (!*url && !strcmp(stored[i]["type"] | "", typeStr)) {
+            url = stored[i]["url"] | "";
+        }
+        if (strncmp(url, "http://", 7) && strncmp(url, "https://", 8)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid alert target URL");
+            return ESP_FAIL;
+        }
+        if (strlen(url) >= ALERT_URL_LEN) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Alert target URL too long");
+            return ESP_FAIL;
+        }
+
+        const char *extra = t["extra"] | "";
+        if ((type == WEBHOOK_TELEGRAM || type == WEBHOOK_NTFY) && !*extra) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Chat id or topic missing");
+            return ESP_FAIL;
+        }
+        if (strlen(extra) >= ALERT_EXTRA_LEN) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Chat id or topic too long");
+            return ESP_FAIL;
+        }
+
+        JsonObject o = arr.add<JsonObject>();
+        o["type"] = typeStr;
+        o["url"] = url;
+        o["extra"] = extra;
+    }
+
+    std::string value;
+    serializeJson(out, value);
+    Config::setAlertTargets(value.c_str());
+    return ESP_OK;
+}
+
 esp_err_t POST_update_alert(httpd_req_t *req)
 {
     // close connection when out of scope
@@ -74,6 +145,13 @@ esp_err_t POST_update_alert(httpd_req_t *req)
         return err;
     }
 
+    // first, nothing is saved if the targets are invalid
+    if (doc["alertTargets"].is<JsonArray>()) {
+        if (update_alert_targets(req, doc["alertTargets"].as<JsonArray>()) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+
     if (doc["alertDiscordWebhook"].is<const char*>()) {
         Config::setDiscordWebhook(doc["alertDiscordWebhook"].as<const char*>());
     }
@@ -94,7 +172,7 @@ esp_err_t POST_update_alert(httpd_req_t *req)
 
     httpd_resp_send_chunk(req, NULL, 0);
 
-    // reload discord alerter config
+    // reload alerter config
     discordAlerter.loadConfig();
 
     // reload config
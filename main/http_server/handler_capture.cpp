@@ -0,0 +1,182 @@
+#include <string.h>
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+
+#include "ArduinoJson.h"
+
+#include "capture.h"
+#include "global_state.h"
+#include "http_cors.h"
+#include "http_utils.h"
+#include "http_async.h"
+#include "macros.h"
+#include "psram_allocator.h"
+
+static const char *TAG = "http_capture";
+
+#define CAPTURE_DEFAULT_KB 1024
+#define CAPTURE_MAX_KB 4096
+#define CAPTURE_CHUNK_SIZE 4096
+
+esp_err_t GET_capture_info(httpd_req_t *req)
+{
+    // close connection when out of scope
+    ConGuard g(http_server, req);
+
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // CORS
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    capture_info_t info;
+    CAPTURE_get_info(&info);
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    doc["enabled"] = info.size > 0;
+    doc["uart"] = (info.sources & CAPTURE_SRC_UART) != 0;
+    doc["stratum"] = (info.sources & CAPTURE_SRC_STRATUM) != 0;
+    doc["size"] = info.size;
+    doc["used"] = info.used;
+    doc["frames"] = info.frames;
+    doc["dropped"] = info.dropped;
+
+    esp_err_t ret = sendJsonResponse(req, doc);
+    doc.clear();
+    return ret;
+}
+
+static http_async_limit_t capture_download_limit = HTTP_ASYNC_LIMIT("capture download", 1, CAPTURE_CHUNK_SIZE);
+
+esp_err_t GET_capture_download(httpd_req_t *req)
+{
+    if (!http_async_on_worker()) {
+        return http_async_submit(req, GET_capture_download, &capture_download_limit);
+    }
+
+    // close connection when out of scope
+    ConGuard g(http_server, req);
+
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    // the capture contains the pool traffic
+    if (validateOTP(req) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    uint8_t *chunk = (uint8_t *) MALLOC(CAPTURE_CHUNK_SIZE);
+    if (!chunk) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    }
+
+    // the ring must not move while we send it
+    CAPTURE_pause(true);
+
+    capture_info_t info;
+    CAPTURE_get_info(&info);
+
+    capture_file_header_t hdr = {};
+    memcpy(hdr.magic, CAPTURE_MAGIC, sizeof(hdr.magic));
+    hdr.version = CAPTURE_VERSION;
+    hdr.sources = info.sources;
+    hdr.base_time_us = info.base_time_us;
+    hdr.frames = info.frames;
+    hdr.dropped = info.dropped;
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"capture.bin\"");
+
+    esp_err_t err = httpd_resp_send_chunk(req, (const char *) &hdr, sizeof(hdr));
+
+    size_t offset = 0;
+    while (err == ESP_OK && offset < info.used) {
+        size_t len = CAPTURE_read(offset, chunk, CAPTURE_CHUNK_SIZE);
+        if (!len) {
+            break;
+        }
+        err = httpd_resp_send_chunk(req, (const char *) chunk, len);
+        offset += len;
+    }
+
+    CAPTURE_pause(false);
+    FREE(chunk);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send capture");
+        httpd_resp_send_chunk(req, NULL, 0);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "capture sent (%u frames, %u bytes)", (unsigned) info.frames, (unsigned) offset);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t POST_capture(httpd_req_t *req)
+{
+    // close connection when out of scope
+    ConGuard g(http_server, req);
+
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    if (validateOTP(req) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    esp_err_t err = getJsonData(req, doc);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (!doc["enable"].is<bool>()) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "enable required");
+    }
+
+    if (!doc["enable"].as<bool>()) {
+        CAPTURE_stop();
+        return httpd_resp_sendstr(req, "ok");
+    }
+
+    uint8_t sources = 0;
+    if (doc["uart"] | true) {
+        sources |= CAPTURE_SRC_UART;
+    }
+    if (doc["stratum"] | true) {
+        sources |= CAPTURE_SRC_STRATUM;
+    }
+
+    uint32_t sizeKB = doc["sizeKB"] | CAPTURE_DEFAULT_KB;
+    if (!sizeKB || sizeKB > CAPTURE_MAX_KB) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "invalid sizeKB");
+    }
+
+    if (!CAPTURE_start((size_t) sizeKB * 1024, sources)) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    }
+    return httpd_resp_sendstr(req, "ok");
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "esp_http_server.h"
+
+esp_err_t GET_capture_info(httpd_req_t *req);
+esp_err_t GET_capture_download(httpd_req_t *req);
+esp_err_t POST_capture(httpd_req_t *req);
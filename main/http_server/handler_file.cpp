@@ -6,10 +6,13 @@
 #include "esp_vfs.h"
 #include "esp_spiffs.h"
 
+#include "asset_bundle.h"
 #include "http_server.h"
 #include "http_cors.h"
 #include "http_utils.h"
+#include "http_async.h"
 #include "guards.h"
+#include "macros.h"
 
 static const char* TAG="http_file";
 
@@ -17,8 +20,28 @@ static const char* TAG="http_file";
 #define CACHE_POLICY_CACHE       "max-age=2592000"
 #define CACHE_POLICY_IMMUTABLE   "public, max-age=31536000, immutable"
 
+// requests are served in parallel, each one needs its own buffer
+#define FILE_CHUNK_SIZE 4096
+
+// A page load requests its assets in parallel and browsers don't retry a
+// 503 of a subresource, so file requests wait in the queue instead of
+// being limited. The bundle is sent from flash and reserves no memory,
+// SPIFFS needs the chunk buffer.
+static http_async_limit_t bundle_limit = HTTP_ASYNC_LIMIT("bundle", HTTP_ASYNC_QUEUE_SIZE, 0);
+static http_async_limit_t file_limit = HTTP_ASYNC_LIMIT("file", HTTP_ASYNC_QUEUE_SIZE, FILE_CHUNK_SIZE);
+
 esp_err_t init_fs(void)
 {
+    // after a www update, a mounted SPIFFS doesn't see the new image
+    if (esp_spiffs_mounted(NULL)) {
+        esp_vfs_spiffs_unregister(NULL);
+    }
+
+    // prefer the memory mapped bundle, SPIFFS images are still supported
+    if (asset_bundle_init() == ESP_OK) {
+        return ESP_OK;
+    }
+
     esp_vfs_spiffs_conf_t conf = {
         .base_path = "",
         .partition_label = NULL,
@@ -132,9 +155,58 @@ static esp_err_t return_500(httpd_req_t *req, const char* msg)
     return ESP_FAIL;
 }
 
+static esp_err_t send_not_found(httpd_req_t *req, const char *uri, const char *filepath)
+{
+    if (is_asset_request(uri)) {
+        // asset missing -> 404 and no portal redirection
+        ESP_LOGE(TAG, "asset not found: %s", filepath);
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Not found");
+        return ESP_OK;
+    }
+    // portal redirection
+    ESP_LOGE(TAG, "page not found: %s", uri);
+    return redirect_portal(req);
+}
+
+// Send an asset from the mapped bundle, the data is sent directly from flash.
+// The caller holds a reference
+static esp_err_t send_bundle_asset(httpd_req_t *req, const char *uri, const char *path)
+{
+    asset_t asset;
+    if (!asset_bundle_find(path, &asset)) {
+        return send_not_found(req, uri, path);
+    }
+
+    char etag[ASSET_BUNDLE_ETAG_LEN];
+    asset_bundle_etag(&asset, etag, sizeof(etag));
+
+    httpd_resp_set_type(req, asset.mime);
+    (void)set_cache_control(req, path);
+    httpd_resp_set_hdr(req, "X-Content-Type-Options", "nosniff");
+    httpd_resp_set_hdr(req, "ETag", etag);
+
+    char if_none_match[ASSET_BUNDLE_ETAG_LEN + 8];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strstr(if_none_match, etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    if (asset.gzip) {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    }
+
+    ESP_LOGI(TAG, "Sending %s (%d bytes)", path, (int) asset.size);
+    return httpd_resp_send(req, (const char *) asset.data, asset.size);
+}
+
 /* Send HTTP response with the contents of the requested file */
 esp_err_t rest_common_get_handler(httpd_req_t *req)
 {
+    if (!http_async_on_worker()) {
+        return http_async_submit(req, rest_common_get_handler, asset_bundle_available() ? &bundle_limit : &file_limit);
+    }
+
     // close connection when out of scope
     ConGuard g(http_server, req);
 
@@ -171,6 +243,13 @@ esp_err_t rest_common_get_handler(httpd_req_t *req)
         strlcat(filepath, uri_clean, filePathLength);
     }
 
+    // the www update can't unmap the bundle while it's sent
+    if (asset_bundle_ref()) {
+        esp_err_t ret = send_bundle_asset(req, uri_clean, filepath + strlen(rest_context->base_path));
+        asset_bundle_unref();
+        return ret;
+    }
+
     // Set core headers before sending any body
     // MIME type by extension (.html, .js, .css, .json, ...)
     (void)set_content_type_from_file(req, filepath);
@@ -191,16 +270,7 @@ esp_err_t rest_common_get_handler(httpd_req_t *req)
     if (fd < 0) {
         if (errno == ENOENT) {
             // asset vs page
-            if (is_asset_request(uri_clean)) {
-                // asset missing -> 404 and no portal redirection
-                ESP_LOGE(TAG, "Failed to open file: %s, errno: %d", filepath, errno);
-                httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Not found");
-                return ESP_OK;
-            } else {
-                // portal redirection
-                ESP_LOGE(TAG, "page not found: %s", uri_clean);
-                return redirect_portal(req);
-            }
+            return send_not_found(req, uri_clean, filepath);
         } else {
             return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to open file");
         }
@@ -214,14 +284,18 @@ esp_err_t rest_common_get_handler(httpd_req_t *req)
     ESP_LOGI(TAG, "Sending %s", filepath);
 
     // Stream file using chunked transfer and finish with a zero-length chunk
-    char *chunk = rest_context->scratch;
+    char *chunk = (char *) MALLOC(FILE_CHUNK_SIZE);
+    if (!chunk) {
+        return return_500(req, "Out of memory");
+    }
     ssize_t read_bytes;
 
     for (;;) {
-        read_bytes = read(fd, chunk, SCRATCH_BUFSIZE);
+        read_bytes = read(fd, chunk, FILE_CHUNK_SIZE);
         if (read_bytes < 0) {
             ESP_LOGE(TAG, "Read error while sending %s", filepath);
             // Terminate chunked response explicitly before reporting failure
+            FREE(chunk);
             httpd_resp_send_chunk(req, NULL, 0);
             return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Read error");
         }
@@ -234,11 +308,14 @@ esp_err_t rest_common_get_handler(httpd_req_t *req)
         if (httpd_resp_send_chunk(req, chunk, read_bytes) != ESP_OK) {
             ESP_LOGE(TAG, "Failed to send file chunk");
             // Try to terminate chunked response; ignore result
+            FREE(chunk);
             httpd_resp_send_chunk(req, NULL, 0);
             return ESP_FAIL;
         }
     }
 
+    FREE(chunk);
+
     ESP_LOGI(TAG, "File sending complete");
 
     // Final zero-length chunk to end chunked body
@@ -3,4 +3,6 @@
 #include "esp_http_server.h"
 
 esp_err_t rest_common_get_handler(httpd_req_t *req);
-esp_err_t init_fs(void);
\ No newline at end of file
+
+// at boot and after a www update: maps the bundle or mounts a SPIFFS image
+esp_err_t init_fs(void);
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+
+#include "global_state.h"
+#include "http_cors.h"
+#include "http_utils.h"
+#include "live_stats.h"
+
+static const char *TAG = "http_live";
+
+#define LIVE_URI "/api/live"
+
+// common checks, returns false if an error was sent
+static bool prepare(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+        return false;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    // CORS
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return false;
+    }
+    return true;
+}
+
+// GET /api/live, /api/live/pool, /api/live/asic
+esp_err_t GET_live(httpd_req_t *req)
+{
+    // close connection when out of scope
+    ConGuard g(http_server, req);
+
+    if (!prepare(req)) {
+        return ESP_FAIL;
+    }
+
+    const char *sub = req->uri + strlen(LIVE_URI);
+    size_t len = strcspn(sub, "?");
+    LiveStats::Topic topic = LiveStats::LIVE;
+    if (len > 1 && sub[0] == '/') {
+        topic = LiveStats::topicByName(sub + 1, len - 1);
+    }
+    if (topic == LiveStats::NUM_TOPICS) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown topic");
+    }
+
+    char buf[LIVE_STATS_BUF_SIZE];
+    len = LIVE_STATS.get(topic, buf, sizeof(buf));
+    if (!len) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "{}");
+    }
+    return httpd_resp_send(req, buf, len);
+}
+
+// GET /api/live/batch?topics=live,pool,asic
+// all topics in one response for swarm aggregators
+esp_err_t GET_live_batch(httpd_req_t *req)
+{
+    // close connection when out of scope
+    ConGuard g(http_server, req);
+
+    if (!prepare(req)) {
+        return ESP_FAIL;
+    }
+
+    uint32_t mask = (1 << LiveStats::NUM_TOPICS) - 1;
+    char query[64];
+    char topics[48];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "topics", topics, sizeof(topics)) == ESP_OK) {
+        mask = 0;
+        for (const char *p = topics; *p;) {
+            size_t len = strcspn(p, ",");
+            LiveStats::Topic topic = LiveStats::topicByName(p, len);
+            if (topic != LiveStats::NUM_TOPICS) {
+                mask |= 1 << topic;
+            }
+            p += len + (p[len] == ',');
+        }
+    }
+
+    char buf[LIVE_STATS_BUF_SIZE];
+    bool first = true;
+
+    if (httpd_resp_send_chunk(req, "{", 1) != ESP_OK) {
+        ESP_LOGE(TAG, "failed to send batch");
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < LiveStats::NUM_TOPICS; i++) {
+        LiveStats::Topic topic = (LiveStats::Topic) i;
+        if (!(mask & (1 << topic))) {
+            continue;
+        }
+        size_t len = LIVE_STATS.get(topic, buf, sizeof(buf));
+        if (!len) {
+            continue;
+        }
+        char key[16];
+        snprintf(key, sizeof(key), "%s\"%s\":", first ? "" : ",", LiveStats::topicName(topic));
+        if (httpd_resp_send_chunk(req, key, HTTPD_RESP_USE_STRLEN) != ESP_OK ||
+            httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+            ESP_LOGE(TAG, "failed to send batch");
+            httpd_resp_send_chunk(req, NULL, 0);
+            return ESP_FAIL;
+        }
+        first = false;
+    }
+    if (httpd_resp_send_chunk(req, "}", 1) != ESP_OK) {
+        ESP_LOGE(TAG, "failed to send batch");
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
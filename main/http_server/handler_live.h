@@ -0,0 +1,6 @@
+#pragma once
+
+#include "esp_http_server.h"
+
+esp_err_t GET_live(httpd_req_t *req);
+esp_err_t GET_live_batch(httpd_req_t *req);
@@ -4,11 +4,16 @@
 
 #include "global_state.h"
 
+#include "asset_bundle.h"
+#include "handler_file.h"
 #include "http_cors.h"
 #include "http_utils.h"
 
 static const char *TAG = "http_ota";
 
+// longer than the send timeout of a chunk
+#define WWW_RELEASE_TIMEOUT_MS 10000
+
 extern bool enter_recovery;
 
 
@@ -41,6 +46,14 @@ esp_err_t POST_WWW_update(httpd_req_t *req)
         return ESP_FAIL;
     }
 
+    // the bundle is mapped from the partition we are going to erase, the
+    // assets still being sent are waited for
+    if (asset_bundle_release(WWW_RELEASE_TIMEOUT_MS) != ESP_OK) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Web UI busy, try again");
+        return ESP_FAIL;
+    }
+
     // Erase the entire www partition before writing
     {
         // lock the power management module
@@ -88,6 +101,11 @@ esp_err_t POST_WWW_update(httpd_req_t *req)
 
     free(buf);
 
+    // serve the new web UI right away, bundle or legacy SPIFFS image
+    if (init_fs() != ESP_OK) {
+        ESP_LOGE(TAG, "new www image is neither a bundle nor SPIFFS");
+    }
+
     httpd_resp_sendstr(req, "WWW update complete\n");
     return ESP_OK;
 }
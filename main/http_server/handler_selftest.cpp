@@ -0,0 +1,68 @@
+#include "esp_http_server.h"
+#include "esp_log.h"
+
+#include "global_state.h"
+#include "http_cors.h"
+#include "http_utils.h"
+#include "nvs_config.h"
+
+static const char *TAG = "http_selftest";
+
+esp_err_t GET_selftest_report(httpd_req_t *req)
+{
+    // close connection when out of scope
+    ConGuard g(http_server, req);
+
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // CORS
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    // the report is saved as JSON by the self-test
+    char *report = Config::getSelfTestReport();
+    esp_err_t ret = httpd_resp_sendstr(req, (report && *report) ? report : "{\"result\":\"none\"}");
+    free(report);
+    return ret;
+}
+
+esp_err_t POST_selftest(httpd_req_t *req)
+{
+    // close connection when out of scope
+    ConGuard g(http_server, req);
+
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    if (validateOTP(req) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Self-test requested via API, restarting");
+
+    // the self-test runs on boot before mining starts
+    Config::setSelfTest(true);
+    Config::setSelfTestField(true);
+
+    httpd_resp_sendstr(req, "Self-test will start after restart.");
+
+    // Delay to ensure the response is sent
+    vTaskDelay(pdMS_TO_TICKS(1000));
+
+    POWER_MANAGEMENT_MODULE.restart();
+
+    // unreachable
+    return ESP_OK;
+}
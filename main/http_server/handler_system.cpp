@@ -10,8 +10,12 @@
 #include "nvs_config.h"
 #include "http_cors.h"
 #include "http_utils.h"
+#include "http_async.h"
+#include "json_stream.h"
 
 #include "ping_task.h"
+#include "task_monitor.h"
+#include "create_jobs_task.h"
 
 static const char *TAG = "http_system";
 
@@ -19,9 +23,50 @@ static const char *TAG = "http_system";
 
 uint64_t getDuplicateHWNonces();
 
+// field groups selectable with ?fields=a,b,...
+#define INFO_SYSTEM   (1 << 0)
+#define INFO_POWER    (1 << 1)
+#define INFO_HASHRATE (1 << 2)
+#define INFO_FAN      (1 << 3)
+#define INFO_POOL     (1 << 4)
+#define INFO_ASIC     (1 << 5)
+#define INFO_HISTORY  (1 << 6)
+#define INFO_SETTINGS (1 << 7)
+#define INFO_ALL      0xff
+
+static const struct
+{
+    const char *name;
+    uint32_t mask;
+} info_groups[] = {
+    {"system", INFO_SYSTEM}, {"power", INFO_POWER}, {"hashrate", INFO_HASHRATE}, {"fan", INFO_FAN},
+    {"pool", INFO_POOL},     {"asic", INFO_ASIC},   {"history", INFO_HISTORY},   {"settings", INFO_SETTINGS},
+};
+
+static uint32_t parse_info_groups(char *fields)
+{
+    uint32_t groups = 0;
+    char *save = nullptr;
+    for (char *tok = strtok_r(fields, ",", &save); tok; tok = strtok_r(nullptr, ",", &save)) {
+        for (size_t i = 0; i < sizeof(info_groups) / sizeof(info_groups[0]); i++) {
+            if (!strcmp(tok, info_groups[i].name)) {
+                groups |= info_groups[i].mask;
+            }
+        }
+    }
+    return groups;
+}
+
 /* Simple handler for getting system handler */
+// the history can make the response large
+static http_async_limit_t system_info_limit = HTTP_ASYNC_LIMIT("system info", 2, 24 * 1024);
+
 esp_err_t GET_system_info(httpd_req_t *req)
 {
+    if (!http_async_on_worker()) {
+        return http_async_submit(req, GET_system_info, &system_info_limit);
+    }
+
     // close connection when out of scope
     ConGuard g(http_server, req);
 
@@ -42,9 +87,10 @@ esp_err_t GET_system_info(httpd_req_t *req)
     uint64_t current_timestamp = 0;
     uint32_t history_limit = 0;
     bool history_requested = false;
-    char query_str[128];
+    uint32_t groups = INFO_ALL;
+    char query_str[256];
     if (httpd_req_get_url_query_str(req, query_str, sizeof(query_str)) == ESP_OK) {
-        char param[64];
+        char param[128];
         if (httpd_query_key_value(query_str, "ts", param, sizeof(param)) == ESP_OK) {
             start_timestamp = strtoull(param, NULL, 10);
             if (start_timestamp) {
@@ -61,159 +107,418 @@ esp_err_t GET_system_info(httpd_req_t *req)
             current_timestamp = strtoull(param, NULL, 10);
             ESP_LOGI(TAG, "cur: %llu", current_timestamp);
         }
+        if (httpd_query_key_value(query_str, "fields", param, sizeof(param)) == ESP_OK) {
+            groups = parse_info_groups(param);
+        }
     }
 
     Board* board   = SYSTEM_MODULE.getBoard();
     History* history = SYSTEM_MODULE.getHistory();
 
-    PSRAMAllocator allocator;
-    JsonDocument doc(&allocator);
-
     bool shutdown = POWER_MANAGEMENT_MODULE.isShutdown();
 
-    // Get configuration strings from NVS
-    char *ssid               = Config::getWifiSSID();
-    char *hostname           = Config::getHostname();
-    char *stratumURL         = Config::getStratumURL();
-    char *stratumUser        = Config::getStratumUser();
-    char *fallbackStratumURL = Config::getStratumFallbackURL();
-    char *fallbackStratumUser= Config::getStratumFallbackUser();
+    // fields are written as they are read, no document is built
+    HttpdChunkHeapWriter w(req, 2048);
+    if (w.m_failed) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    JsonStream json(w);
+
+    json.beginObject();
 
     // static
-    doc["asicCount"]          = board->getAsicCount();
-    doc["smallCoreCount"]     = (board->getAsics()) ? board->getAsics()->getSmallCoreCount() : 0;
-    doc["deviceModel"]        = board->getDeviceModel();
-    doc["hostip"]             = SYSTEM_MODULE.getIPAddress();
-    doc["macAddr"]            = SYSTEM_MODULE.getMacAddress();
-    doc["wifiRSSI"]           = SYSTEM_MODULE.get_wifi_rssi();
+    if (groups & INFO_SYSTEM) {
+        json.add("asicCount",          board->getAsicCount());
+        json.add("smallCoreCount",     (board->getAsics()) ? board->getAsics()->getSmallCoreCount() : 0);
+        json.add("deviceModel",        board->getDeviceModel());
+        json.add("hostip",             SYSTEM_MODULE.getIPAddress());
+        json.add("macAddr",            SYSTEM_MODULE.getMacAddress());
+        json.add("wifiRSSI",           SYSTEM_MODULE.get_wifi_rssi());
+    }
 
     // dashboard
-    doc["power"]              = POWER_MANAGEMENT_MODULE.getPower();
-    doc["maxPower"]           = board->getMaxPin();
-    doc["minPower"]           = board->getMinPin();
-    doc["maxVoltage"]         = board->getMaxVin();
-    doc["minVoltage"]         = board->getMinVin();
-    doc["current"]            = POWER_MANAGEMENT_MODULE.getCurrent();           // mA (raw)
-    doc["currentA"]           = POWER_MANAGEMENT_MODULE.getCurrent() / 1000.0f; // A (UI)
-    doc["minCurrentA"]        = board->getMinCurrentA(); // A
-    doc["maxCurrentA"]        = board->getMaxCurrentA(); // A
-    doc["temp"]               = POWER_MANAGEMENT_MODULE.getChipTempMax();
-    doc["vrTemp"]             = POWER_MANAGEMENT_MODULE.getVRTemp();
-    doc["hashRateTimestamp"]  = history->getCurrentTimestamp();
-    // set hashrate values to 0 in shutdown
-    doc["hashRate"]           = !shutdown ? SYSTEM_MODULE.getCurrentHashrate() : 0.0;
-    doc["hashRate_1m"]        = !shutdown ? history->getCurrentHashrate1m()    : 0.0;
-    doc["hashRate_10m"]       = !shutdown ? history->getCurrentHashrate10m()   : 0.0;
-    doc["hashRate_1h"]        = !shutdown ? history->getCurrentHashrate1h()    : 0.0;
-    doc["hashRate_1d"]        = !shutdown ? history->getCurrentHashrate1d()    : 0.0;
-    doc["coreVoltage"]        = board->getAsicVoltageMillis();
-    doc["defaultCoreVoltage"] = board->getDefaultAsicVoltageMillis();
-    doc["coreVoltageActual"]  = (int) (board->getVout() * 1000.0f);
-    doc["fanspeed"]           = POWER_MANAGEMENT_MODULE.getFanPerc();
-    doc["manualFanSpeed"]     = Config::getFanSpeed();
-    doc["fanrpm"]             = POWER_MANAGEMENT_MODULE.getFanRPM(0);
-    doc["lastpingrtt"]        = get_last_ping_rtt();
-    doc["recentpingloss"]     = get_recent_ping_loss();
-    doc["shutdown"]           = POWER_MANAGEMENT_MODULE.isShutdown();
-    doc["duplicateHWNonces"]  = getDuplicateHWNonces();
-
-    JsonObject stratum_obj = doc["stratum"].to<JsonObject>();
-
-    // kept for swarm compatibility
-    doc["poolDifficulty"]     = STRATUM_MANAGER->getPoolDifficulty();
-    doc["foundBlocks"]        = STRATUM_MANAGER->getFoundBlocks();
-    doc["totalFoundBlocks"]   = STRATUM_MANAGER->getTotalFoundBlocks();
-    doc["sharesAccepted"]     = STRATUM_MANAGER->getSharesAccepted();
-    doc["sharesRejected"]     = STRATUM_MANAGER->getSharesRejected();
-    doc["bestDiff"]           = STRATUM_MANAGER->getBestDiff();
-    doc["bestSessionDiff"]    = STRATUM_MANAGER->getBestSessionDiff();
-
-    STRATUM_MANAGER->getManagerInfoJson(stratum_obj);
-
-    // asic temps
-    {
-        JsonArray arr = doc["asicTemps"].to<JsonArray>();
+    if (groups & INFO_POWER) {
+        json.add("power",              POWER_MANAGEMENT_MODULE.getPower());
+        json.add("maxPower",           board->getMaxPin());
+        json.add("minPower",           board->getMinPin());
+        json.add("maxVoltage",         board->getMaxVin());
+        json.add("minVoltage",         board->getMinVin());
+        json.add("current",            POWER_MANAGEMENT_MODULE.getCurrent());           // mA (raw)
+        json.add("currentA",           POWER_MANAGEMENT_MODULE.getCurrent() / 1000.0f); // A (UI)
+        json.add("minCurrentA",        board->getMinCurrentA()); // A
+        json.add("maxCurrentA",        board->getMaxCurrentA()); // A
+        json.add("temp",               POWER_MANAGEMENT_MODULE.getChipTempMax());
+        json.add("vrTemp",             POWER_MANAGEMENT_MODULE.getVRTemp());
+    }
+    if (groups & INFO_HASHRATE) {
+        json.add("hashRateTimestamp",  history->getCurrentTimestamp());
+        // set hashrate values to 0 in shutdown
+        json.add("hashRate",           !shutdown ? SYSTEM_MODULE.getCurrentHashrate() : 0.0);
+        json.add("hashRate_1m",        !shutdown ? history->getCurrentHashrate1m()    : 0.0);
+        json.add("hashRate_10m",       !shutdown ? history->getCurrentHashrate10m()   : 0.0);
+        json.add("hashRate_1h",        !shutdown ? history->getCurrentHashrate1h()    : 0.0);
+        json.add("hashRate_1d",        !shutdown ? history->getCurrentHashrate1d()    : 0.0);
+    }
+    if (groups & INFO_POWER) {
+        json.add("coreVoltage",        board->getAsicVoltageMillis());
+        json.add("defaultCoreVoltage", board->getDefaultAsicVoltageMillis());
+        json.add("coreVoltageActual",  (int) (board->getVout() * 1000.0f));
+    }
+    if (groups & INFO_FAN) {
+        json.add("fanspeed",           POWER_MANAGEMENT_MODULE.getFanPerc());
+        json.add("manualFanSpeed",     Config::getFanSpeed());
+        json.add("fanrpm",             POWER_MANAGEMENT_MODULE.getFanRPM(0));
+    }
+    if (groups & INFO_POOL) {
+        json.add("lastpingrtt",        get_last_ping_rtt());
+        json.add("recentpingloss",     get_recent_ping_loss());
+    }
+    if (groups & INFO_SYSTEM) {
+        json.add("shutdown",           POWER_MANAGEMENT_MODULE.isShutdown());
+    }
+    if (groups & INFO_ASIC) {
+        json.add("duplicateHWNonces",  getDuplicateHWNonces());
+
+        job_slot_stats_t slots;
+        asicJobs.getStats(&slots);
+        json.add("lateResults",        slots.late);
+        json.add("staleResults",       slots.stale);
+        json.add("maxResultLateMs",    (uint32_t) (slots.maxLateUs / 1000));
+        json.add("activeJobInterval",  create_job_get_interval_ms());
+    }
+
+    if (groups & INFO_POOL) {
+        // small and filled by the stratum manager
+        PSRAMAllocator allocator;
+        JsonDocument stratum(&allocator);
+        JsonObject stratum_obj = stratum.to<JsonObject>();
+        STRATUM_MANAGER->getManagerInfoJson(stratum_obj);
+        json.add("stratum", stratum);
+
+        // network difficulty, luck and best share of the solo work
+        JsonDocument solo(&allocator);
+        JsonObject solo_obj = solo.to<JsonObject>();
+        STRATUM_MANAGER->getSoloStatsJson(solo_obj, SYSTEM_MODULE.getCurrentHashrate());
+        json.add("solo", solo);
+
+        // kept for swarm compatibility
+        json.add("poolDifficulty",     STRATUM_MANAGER->getPoolDifficulty());
+        json.add("foundBlocks",        STRATUM_MANAGER->getFoundBlocks());
+        json.add("totalFoundBlocks",   STRATUM_MANAGER->getTotalFoundBlocks());
+        json.add("sharesAccepted",     STRATUM_MANAGER->getSharesAccepted());
+        json.add("sharesRejected",     STRATUM_MANAGER->getSharesRejected());
+        json.add("bestDiff",           STRATUM_MANAGER->getBestDiff());
+        json.add("bestSessionDiff",    STRATUM_MANAGER->getBestSessionDiff());
+    }
+
+    // fan health and noise limit
+    if (groups & INFO_FAN) {
+        FanController *fans = POWER_MANAGEMENT_MODULE.getFanController();
+        json.beginArray("fans");
+        for (int i=0;i<board->getNumFans();i++) {
+            json.beginObject();
+            json.add("rpm",      POWER_MANAGEMENT_MODULE.getFanRPM(i));
+            json.add("health",   FanController::healthToStr(fans->getHealth(i)));
+            json.add("rpmRatio", fans->getRPMRatio(i));
+            json.endObject();
+        }
+        json.endArray();
+        json.add("fanCharacterizing",  fans->isCharacterizing());
+        json.add("fanThrottleSteps",   fans->getThrottleSteps());
+    }
+
+    if (groups & INFO_ASIC) {
+        // asic temps
+        json.beginArray("asicTemps");
         for (int i=0;i<board->getAsicCount();i++) {
-            arr.add(board->getChipTemp(i));
+            json.item(board->getChipTemp(i));
         }
+        json.endArray();
+
+        // per-chip frequencies when chip balancing is active
+        ChipThermalModel *chips = POWER_MANAGEMENT_MODULE.getChipModel();
+        json.beginArray("asicFrequencies");
+        for (int i=0;i<board->getAsicCount();i++) {
+            json.item(chips->getChipFrequency(i));
+        }
+        json.endArray();
     }
 
     // If history was requested, add the history data as a nested object
-    if (!shutdown && history_requested) {
+    if ((groups & INFO_HISTORY) && !shutdown && history_requested) {
         uint64_t end_timestamp = start_timestamp + 3600 * 1000ULL; // 1 hour later
-        JsonObject json_history = doc["history"].to<JsonObject>();
-
-        History *history = SYSTEM_MODULE.getHistory();
-        history->exportHistoryData(json_history, start_timestamp, end_timestamp, current_timestamp, history_limit);
+        history->exportHistoryData(json, start_timestamp, end_timestamp, current_timestamp, history_limit);
     }
 
     // settings
-    PidSettings *pid = board->getPidSettings();
-    doc["pidTargetTemp"]      = board->isPIDAvailable() ? pid->targetTemp : -1;
-    doc["pidP"]               = (float) pid->p / 100.0f;
-    doc["pidI"]               = (float) pid->i / 100.0f;
-    doc["pidD"]               = (float) pid->d / 100.0f;
-
-    doc["hostname"]           = hostname;
-    doc["ssid"]               = ssid;
-    doc["stratumURL"]         = stratumURL;
-    doc["stratumPort"]        = Config::getStratumPortNumber();
-    doc["stratumUser"]        = stratumUser;
-    doc["stratumEnonceSubscribe"] = Config::isStratumEnonceSubscribe();
-    doc["stratumTLS"]         = Config::isStratumTLS();
-    doc["fallbackStratumURL"] = fallbackStratumURL;
-    doc["fallbackStratumPort"]= Config::getStratumFallbackPortNumber();
-    doc["fallbackStratumUser"] = fallbackStratumUser;
-    doc["fallbackStratumEnonceSubscribe"] = Config::isStratumFallbackEnonceSubscribe();
-    doc["fallbackStratumTLS"] = Config::isStratumFallbackTLS();
-    doc["voltage"]            = POWER_MANAGEMENT_MODULE.getVoltage();
-    doc["frequency"]          = board->getAsicFrequency();
-    doc["defaultFrequency"]   = board->getDefaultAsicFrequency();
-    doc["jobInterval"]        = board->getAsicJobIntervalMs();
-    doc["stratumDifficulty"] = Config::getStratumDifficulty();
-    doc["overheat_temp"]      = Config::getOverheatTemp();
-    doc["flipscreen"]         = board->isFlipScreenEnabled() ? 1 : 0;
-    doc["invertscreen"]       = Config::isInvertScreenEnabled() ? 1 : 0; // unused?
-    doc["autoscreenoff"]      = Config::isAutoScreenOffEnabled() ? 1 : 0;
-    doc["invertfanpolarity"]  = board->isInvertFanPolarityEnabled() ? 1 : 0;
-    doc["autofanspeed"]       = Config::getTempControlMode();
-    doc["stratum_keep"]       = Config::isStratumKeepaliveEnabled() ? 1 : 0;
+    if (groups & INFO_SETTINGS) {
+        // Get configuration strings from NVS
+        char *ssid               = Config::getWifiSSID();
+        char *hostname           = Config::getHostname();
+        char *stratumURL         = Config::getStratumURL();
+        char *stratumUser        = Config::getStratumUser();
+        char *fallbackStratumURL = Config::getStratumFallbackURL();
+        char *fallbackStratumUser= Config::getStratumFallbackUser();
+        char *stratumTLSCert     = Config::getStratumTLSCert();
+        char *fallbackTLSCert    = Config::getStratumFallbackTLSCert();
+
+        PidSettings *pid = board->getPidSettings();
+        json.add("pidTargetTemp",      board->isPIDAvailable() ? pid->targetTemp : -1);
+        json.add("pidP",               (float) pid->p / 100.0f);
+        json.add("pidI",               (float) pid->i / 100.0f);
+        json.add("pidD",               (float) pid->d / 100.0f);
+
+        json.add("hostname",           hostname);
+        json.add("ssid",               ssid);
+        json.add("stratumURL",         stratumURL);
+        json.add("stratumPort",        Config::getStratumPortNumber());
+        json.add("stratumUser",        stratumUser);
+        json.add("stratumEnonceSubscribe", Config::isStratumEnonceSubscribe());
+        json.add("stratumTLS",         Config::isStratumTLS());
+        json.add("stratumTLSCert",     stratumTLSCert);
+        json.add("fallbackStratumURL", fallbackStratumURL);
+        json.add("fallbackStratumPort",Config::getStratumFallbackPortNumber());
+        json.add("fallbackStratumUser", fallbackStratumUser);
+        json.add("fallbackStratumEnonceSubscribe", Config::isStratumFallbackEnonceSubscribe());
+        json.add("fallbackStratumTLS", Config::isStratumFallbackTLS());
+        json.add("fallbackStratumTLSCert", fallbackTLSCert);
+
+        // pools 3 and 4
+        for (int pool = 2; pool < STRATUM_MAX_POOLS; pool++) {
+            char key[32];
+            char *url  = Config::getExtraPoolURL(pool);
+            char *user = Config::getExtraPoolUser(pool);
+            char *cert = Config::getExtraPoolTLSCert(pool);
+
+            snprintf(key, sizeof(key), "pool%dURL", pool + 1);
+            json.add(key, url);
+            snprintf(key, sizeof(key), "pool%dPort", pool + 1);
+            json.add(key, Config::getExtraPoolPortNumber(pool));
+            snprintf(key, sizeof(key), "pool%dUser", pool + 1);
+            json.add(key, user);
+            snprintf(key, sizeof(key), "pool%dEnonceSubscribe", pool + 1);
+            json.add(key, Config::isExtraPoolEnonceSubscribe(pool));
+            snprintf(key, sizeof(key), "pool%dTLS", pool + 1);
+            json.add(key, Config::isExtraPoolTLS(pool));
+            snprintf(key, sizeof(key), "pool%dTLSCert", pool + 1);
+            json.add(key, cert);
+
+            free(url);
+            free(user);
+            free(cert);
+        }
+        for (int pool = 0; pool < STRATUM_MAX_POOLS; pool++) {
+            char key[16];
+            snprintf(key, sizeof(key), "pool%dWeight", pool + 1);
+            json.add(key, Config::getPoolWeight(pool));
+        }
+        json.add("voltage",            POWER_MANAGEMENT_MODULE.getVoltage());
+        json.add("frequency",          board->getAsicFrequency());
+        json.add("defaultFrequency",   board->getDefaultAsicFrequency());
+        json.add("jobInterval",        board->getAsicJobIntervalMs());
+        json.add("stratumDifficulty",  Config::getStratumDifficulty());
+        json.add("shareInterval",      Config::getShareInterval());
+        json.add("overheat_temp",      Config::getOverheatTemp());
+        json.add("flipscreen",         board->isFlipScreenEnabled() ? 1 : 0);
+        json.add("invertscreen",       Config::isInvertScreenEnabled() ? 1 : 0); // unused?
+        json.add("autoscreenoff",      Config::isAutoScreenOffEnabled() ? 1 : 0);
+        json.add("invertfanpolarity",  board->isInvertFanPolarityEnabled() ? 1 : 0);
+        json.add("autofanspeed",       Config::getTempControlMode());
+        json.add("fanMaxRpm",          Config::getFanMaxRPM());
+        json.add("chipBalance",        Config::isChipBalanceEnabled() ? 1 : 0);
+        json.add("chipBoost",          Config::getChipBoost());
+        json.add("ambientTemp",        Config::getAmbientTemp());
+        json.add("stratum_keep",       Config::isStratumKeepaliveEnabled() ? 1 : 0);
 #ifdef VR_FREQUENCY_ENABLED
-    doc["vrFrequency"]        = board->getVrFrequency();
-    doc["defaultVrFrequency"] = board->getDefaultVrFrequency();
+        json.add("vrFrequency",        board->getVrFrequency());
+        json.add("defaultVrFrequency", board->getDefaultVrFrequency());
 #endif
-    doc["otp"]                = Config::isOTPEnabled(); // flag if otp is enabled
-
-    // system screen
-    doc["ASICModel"]          = board->getAsicModel();
-    doc["uptimeSeconds"]      = (esp_timer_get_time() - SYSTEM_MODULE.getStartTime()) / 1000000;
-    doc["lastResetReason"]    = SYSTEM_MODULE.getLastResetReason();
-    doc["wifiStatus"]         = SYSTEM_MODULE.getWifiStatus();
-    doc["freeHeap"]           = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
-    doc["freeHeapInt"]        = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
-    doc["version"]            = esp_app_get_description()->version;
-    doc["runningPartition"]   = esp_ota_get_running_partition()->label;
+        json.add("otp",                Config::isOTPEnabled()); // flag if otp is enabled
 
-    doc["defaultTheme"]       = board->getDefaultTheme();
+        // Free temporary strings
+        free(ssid);
+        free(hostname);
+        free(stratumURL);
+        free(stratumUser);
+        free(fallbackStratumURL);
+        free(fallbackStratumUser);
+        free(stratumTLSCert);
+        free(fallbackTLSCert);
+    }
 
-    //ESP_LOGI(TAG, "allocs: %d, deallocs: %d, reallocs: %d", allocs, deallocs, reallocs);
+    // system screen
+    if (groups & INFO_SYSTEM) {
+        json.add("ASICModel",          board->getAsicModel());
+        json.add("uptimeSeconds",      (esp_timer_get_time() - SYSTEM_MODULE.getStartTime()) / 1000000);
+        json.add("lastResetReason",    SYSTEM_MODULE.getLastResetReason());
+        json.add("wifiStatus",         SYSTEM_MODULE.getWifiStatus());
+        json.add("freeHeap",           heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+        json.add("freeHeapInt",        heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+        // fragmentation: a TLS reconnect needs large blocks
+        json.add("largestFreeBlock",   heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
+        json.add("largestFreeBlockInt", heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+        json.add("minFreeHeapInt",     heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+
+        notify_pool_stats_t notify;
+        notifyPool.getStats(&notify);
+        json.add("notifyPoolUsed",     notify.used);
+        json.add("notifyPoolPeak",     notify.peakUsed);
+        json.add("notifyPoolFallbacks", notify.fallbacks);
+        json.add("version",            esp_app_get_description()->version);
+        json.add("runningPartition",   esp_ota_get_running_partition()->label);
+
+        json.add("defaultTheme",       board->getDefaultTheme());
+    }
+
+    json.endObject();
+
+    return w.finish();
+}
 
-    // Serialize the JSON document to a String and send it
-    esp_err_t ret = sendJsonResponse(req, doc);
-    doc.clear();
 
-    // Free temporary strings
-    free(ssid);
-    free(hostname);
-    free(stratumURL);
-    free(stratumUser);
-    free(fallbackStratumURL);
-    free(fallbackStratumUser);
+// settings accepted by PATCH_update_settings. The whole patch is checked
+// before anything is written
+typedef enum
+{
+    SETTING_UINT,
+    SETTING_FLOAT,
+    SETTING_BOOL,
+    SETTING_FLAG, // bool or number
+    SETTING_STR,  // min/max is the length
+} setting_kind_t;
+
+static const struct
+{
+    const char *name;
+    setting_kind_t kind;
+    uint32_t min;
+    uint32_t max;
+} setting_rules[] = {
+    {"ssid", SETTING_STR, 1, 32},
+    {"wifiPass", SETTING_STR, 0, 64},
+    {"hostname", SETTING_STR, 1, 32},
+    {"coreVoltage", SETTING_UINT, 0, UINT16_MAX},
+    {"frequency", SETTING_UINT, 0, UINT16_MAX},
+    {"jobInterval", SETTING_UINT, 0, UINT16_MAX},
+    {"stratumDifficulty", SETTING_UINT, 0, UINT32_MAX},
+    {"shareInterval", SETTING_UINT, 0, 3600},
+    {"flipscreen", SETTING_BOOL, 0, 0},
+    {"overheat_temp", SETTING_UINT, 1, UINT16_MAX},
+    {"invertscreen", SETTING_BOOL, 0, 0},
+    {"invertfanpolarity", SETTING_BOOL, 0, 0},
+    {"autofanspeed", SETTING_UINT, 0, 2},
+    {"manualFanSpeed", SETTING_UINT, 0, 100},
+    {"fanMaxRpm", SETTING_UINT, 0, UINT16_MAX},
+    {"chipBalance", SETTING_BOOL, 0, 0},
+    {"chipBoost", SETTING_UINT, 0, UINT16_MAX},
+    {"ambientTemp", SETTING_UINT, 0, 60},
+    {"fanCharacterize", SETTING_BOOL, 0, 0},
+    {"autoscreenoff", SETTING_BOOL, 0, 0},
+    {"stratum_keep", SETTING_FLAG, 0, 0},
+    {"pidTargetTemp", SETTING_UINT, 0, UINT16_MAX},
+    {"pidP", SETTING_FLOAT, 0, UINT16_MAX / 100},
+    {"pidI", SETTING_FLOAT, 0, UINT16_MAX / 100},
+    {"pidD", SETTING_FLOAT, 0, UINT16_MAX / 100},
+    {"vrFrequency", SETTING_UINT, 0, UINT32_MAX},
+    {"poolMode", SETTING_UINT, StratumManager::FAILOVER, StratumManager::LATENCY},
+    {"poolBalance", SETTING_UINT, 0, 100},
+    {"stratumURL", SETTING_STR, 0, 255},
+    {"stratumUser", SETTING_STR, 0, 255},
+    {"stratumPassword", SETTING_STR, 0, 255},
+    {"stratumPort", SETTING_UINT, 0, UINT16_MAX},
+    {"stratumEnonceSubscribe", SETTING_BOOL, 0, 0},
+    {"stratumTLS", SETTING_BOOL, 0, 0},
+    {"stratumTLSCert", SETTING_STR, 0, 3900},
+    {"fallbackStratumURL", SETTING_STR, 0, 255},
+    {"fallbackStratumUser", SETTING_STR, 0, 255},
+    {"fallbackStratumPassword", SETTING_STR, 0, 255},
+    {"fallbackStratumPort", SETTING_UINT, 0, UINT16_MAX},
+    {"fallbackStratumEnonceSubscribe", SETTING_BOOL, 0, 0},
+    {"fallbackStratumTLS", SETTING_BOOL, 0, 0},
+    {"fallbackStratumTLSCert", SETTING_STR, 0, 3900},
+    {"pool3URL", SETTING_STR, 0, 255},
+    {"pool3User", SETTING_STR, 0, 255},
+    {"pool3Password", SETTING_STR, 0, 255},
+    {"pool3Port", SETTING_UINT, 0, UINT16_MAX},
+    {"pool3EnonceSubscribe", SETTING_BOOL, 0, 0},
+    {"pool3TLS", SETTING_BOOL, 0, 0},
+    {"pool3TLSCert", SETTING_STR, 0, 3900},
+    {"pool4URL", SETTING_STR, 0, 255},
+    {"pool4User", SETTING_STR, 0, 255},
+    {"pool4Password", SETTING_STR, 0, 255},
+    {"pool4Port", SETTING_UINT, 0, UINT16_MAX},
+    {"pool4EnonceSubscribe", SETTING_BOOL, 0, 0},
+    {"pool4TLS", SETTING_BOOL, 0, 0},
+    {"pool4TLSCert", SETTING_STR, 0, 3900},
+    {"pool1Weight", SETTING_UINT, 0, 100},
+    {"pool2Weight", SETTING_UINT, 0, 100},
+    {"pool3Weight", SETTING_UINT, 0, 100},
+    {"pool4Weight", SETTING_UINT, 0, 100},
+};
+
+// returns the name of the first invalid setting or nullptr. Unknown keys and
+// null values are ignored like before
+static const char *validate_settings(const JsonDocument &doc)
+{
+    for (size_t i = 0; i < sizeof(setting_rules) / sizeof(setting_rules[0]); i++) {
+        JsonVariantConst v = doc[setting_rules[i].name];
+        if (v.isNull()) {
+            continue;
+        }
 
-    return ret;
+        bool ok = false;
+        switch (setting_rules[i].kind) {
+        case SETTING_UINT:
+            ok = v.is<uint32_t>() && v.as<uint32_t>() >= setting_rules[i].min && v.as<uint32_t>() <= setting_rules[i].max;
+            break;
+        case SETTING_FLOAT:
+            ok = v.is<float>() && v.as<float>() >= setting_rules[i].min && v.as<float>() <= setting_rules[i].max;
+            break;
+        case SETTING_BOOL:
+            ok = v.is<bool>();
+            break;
+        case SETTING_FLAG:
+            ok = v.is<bool>() || v.is<int>();
+            break;
+        case SETTING_STR:
+            ok = v.is<const char *>() && strlen(v.as<const char *>()) >= setting_rules[i].min &&
+                 strlen(v.as<const char *>()) <= setting_rules[i].max;
+            break;
+        }
+        if (!ok) {
+            return setting_rules[i].name;
+        }
+    }
+    return nullptr;
 }
 
-
+// keys read by the loadSettings of the subsystems, only the affected ones are reloaded
+static const char *const board_setting_keys[] = {
+    NVS_CONFIG_FAN_SPEED,         NVS_CONFIG_ASIC_FREQ,  NVS_CONFIG_ASIC_VOLTAGE, NVS_CONFIG_ASIC_JOB_INTERVAL,
+    NVS_CONFIG_FAN_PWM_POLARITY,  NVS_CONFIG_FLIP_SCREEN, NVS_CONFIG_VR_FREQUENCY, NVS_CONFIG_PID_TARGET_TEMP,
+    NVS_CONFIG_PID_P,             NVS_CONFIG_PID_I,      NVS_CONFIG_PID_D,        nullptr,
+};
+
+static const char *const display_setting_keys[] = {
+    NVS_CONFIG_AUTO_SCREEN_OFF, NVS_CONFIG_AUTO_FAN_SPEED, NVS_CONFIG_FAN_SPEED, NVS_CONFIG_SHOW_BLOCK_FOUND_ENABLE, nullptr,
+};
+
+static const char *const stratum_setting_keys[] = {
+    NVS_CONFIG_STRATUM_URL,          NVS_CONFIG_STRATUM_PORT,          NVS_CONFIG_STRATUM_USER,
+    NVS_CONFIG_STRATUM_PASS,         NVS_CONFIG_STRATUM_ENONCE_SUB,    NVS_CONFIG_STRATUM_TLS,
+    NVS_CONFIG_STRATUM_FALLBACK_URL, NVS_CONFIG_STRATUM_FALLBACK_PORT, NVS_CONFIG_STRATUM_FALLBACK_USER,
+    NVS_CONFIG_STRATUM_FALLBACK_PASS, NVS_CONFIG_STRATUM_FALLBACK_ENONCE_SUB, NVS_CONFIG_STRATUM_FALLBACK_TLS,
+    NVS_CONFIG_STRATUM_TLS_CERT,     NVS_CONFIG_STRATUM_FALLBACK_TLS_CERT,
+    NVS_CONFIG_POOL3_URL,            NVS_CONFIG_POOL3_PORT,            NVS_CONFIG_POOL3_USER,
+    NVS_CONFIG_POOL3_PASS,           NVS_CONFIG_POOL3_ENONCE_SUB,      NVS_CONFIG_POOL3_TLS,
+    NVS_CONFIG_POOL3_TLS_CERT,       NVS_CONFIG_POOL4_URL,             NVS_CONFIG_POOL4_PORT,
+    NVS_CONFIG_POOL4_USER,           NVS_CONFIG_POOL4_PASS,            NVS_CONFIG_POOL4_ENONCE_SUB,
+    NVS_CONFIG_POOL4_TLS,            NVS_CONFIG_POOL4_TLS_CERT,        NVS_CONFIG_POOL_MODE_BALANCE,
+    NVS_CONFIG_POOL1_WEIGHT,         NVS_CONFIG_POOL2_WEIGHT,          NVS_CONFIG_POOL3_WEIGHT,
+    NVS_CONFIG_POOL4_WEIGHT,
+    nullptr,
+};
 
 esp_err_t PATCH_update_settings(httpd_req_t *req)
 {
@@ -242,6 +547,16 @@ esp_err_t PATCH_update_settings(httpd_req_t *req)
         return err;
     }
 
+    const char *invalid = validate_settings(doc);
+    if (invalid) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "Invalid value for %s", invalid);
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+    }
+
+    // all setters below are written with one commit
+    Config::Transaction txn;
+
     if (doc["ssid"].is<const char*>()) {
         Config::setWifiSSID(doc["ssid"].as<const char*>());
     }
@@ -272,6 +587,9 @@ esp_err_t PATCH_update_settings(httpd_req_t *req)
     if (doc["stratumDifficulty"].is<uint32_t>()) {
         Config::setStratumDifficulty(doc["stratumDifficulty"].as<uint32_t>());
     }
+    if (doc["shareInterval"].is<uint16_t>()) {
+        Config::setShareInterval(doc["shareInterval"].as<uint16_t>());
+    }
     if (doc["flipscreen"].is<bool>()) {
         Config::setFlipScreen(doc["flipscreen"].as<bool>());
     }
@@ -290,6 +608,18 @@ esp_err_t PATCH_update_settings(httpd_req_t *req)
     if (doc["manualFanSpeed"].is<uint16_t>()) {
         Config::setFanSpeed(doc["manualFanSpeed"].as<uint16_t>());
     }
+    if (doc["fanMaxRpm"].is<uint16_t>()) {
+        Config::setFanMaxRPM(doc["fanMaxRpm"].as<uint16_t>());
+    }
+    if (doc["chipBalance"].is<bool>()) {
+        Config::setChipBalanceEnabled(doc["chipBalance"].as<bool>());
+    }
+    if (doc["chipBoost"].is<uint16_t>()) {
+        Config::setChipBoost(doc["chipBoost"].as<uint16_t>());
+    }
+    if (doc["ambientTemp"].is<uint16_t>()) {
+        Config::setAmbientTemp(doc["ambientTemp"].as<uint16_t>());
+    }
     if (doc["autoscreenoff"].is<bool>()) {
         Config::setAutoScreenOff(doc["autoscreenoff"].as<bool>());
     }
@@ -319,24 +649,87 @@ esp_err_t PATCH_update_settings(httpd_req_t *req)
     // save stratum settings
     STRATUM_MANAGER->saveSettings(doc);
 
+    if (!txn.commit()) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Saving settings failed");
+    }
+
+    if (doc["fanCharacterize"].is<bool>() && doc["fanCharacterize"].as<bool>()) {
+        POWER_MANAGEMENT_MODULE.getFanController()->requestCharacterization();
+    }
+
     doc.clear();
 
     // Signal the end of the response
     httpd_resp_send_chunk(req, NULL, 0);
 
-    // Reload settings after update
-    Board* board = SYSTEM_MODULE.getBoard();
-    board->loadSettings();
+    // Reload settings of the subsystems whose keys changed
+    if (txn.changedAny(board_setting_keys)) {
+        Board* board = SYSTEM_MODULE.getBoard();
+        board->loadSettings();
+    }
 
     // reload settings of system module (and display)
-    SYSTEM_MODULE.loadSettings();
+    if (txn.changedAny(display_setting_keys)) {
+        SYSTEM_MODULE.loadSettings();
+    }
 
     // reload settings, trigger reconnect if stratum config changed
-    STRATUM_MANAGER->loadSettings();
+    if (txn.changedAny(stratum_setting_keys)) {
+        STRATUM_MANAGER->loadSettings();
+    }
 
     return ESP_OK;
 }
 
+// two-point temp sensor calibration
+// {"sensor": 0, "point": 0, "reference": 40.0} captures a point
+// {"reset": true} restores the default calibration
+esp_err_t POST_temp_calibration(httpd_req_t *req)
+{
+    // close connection when out of scope
+    ConGuard g(http_server, req);
+
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    if (validateOTP(req) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    esp_err_t err = getJsonData(req, doc);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    Board* board = SYSTEM_MODULE.getBoard();
+
+    // don't interfere with the sensor polling
+    LockGuard<PowerManagementTask> lock(POWER_MANAGEMENT_MODULE);
+
+    if (doc["reset"].is<bool>() && doc["reset"].as<bool>()) {
+        board->resetTempCalibration();
+        return httpd_resp_sendstr(req, "ok");
+    }
+
+    if (!doc["sensor"].is<int>() || !doc["point"].is<int>() || !doc["reference"].is<float>()) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "sensor, point and reference required");
+    }
+
+    if (!board->calibrateTempSensor(doc["sensor"].as<int>(), doc["point"].as<int>(), doc["reference"].as<float>())) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Calibration failed");
+    }
+    return httpd_resp_sendstr(req, "ok");
+}
+
 esp_err_t GET_system_asic(httpd_req_t *req)
 {
     // close connection when out of scope
@@ -390,3 +783,31 @@ esp_err_t GET_system_asic(httpd_req_t *req)
     doc.clear();
     return ret;
 }
+
+esp_err_t GET_system_tasks(httpd_req_t *req)
+{
+    // close connection when out of scope
+    ConGuard g(http_server, req);
+
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // CORS
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    // usage is measured between two requests
+    task_monitor_get_stats(doc.to<JsonObject>());
+
+    esp_err_t ret = sendJsonResponse(req, doc);
+    doc.clear();
+    return ret;
+}
@@ -2,5 +2,7 @@
 
 esp_err_t GET_system_info(httpd_req_t *req);
 esp_err_t PATCH_update_settings(httpd_req_t *req);
+esp_err_t POST_temp_calibration(httpd_req_t *req);
 
-esp_err_t GET_system_asic(httpd_req_t *req);
\ No newline at end of file
+esp_err_t GET_system_asic(httpd_req_t *req);
+esp_err_t GET_system_tasks(httpd_req_t *req);
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include <pthread.h>
+#include <stdio.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include "http_async.h"
+#include "http_utils.h"
+#include "macros.h"
+#include "task_monitor.h"
+
+static const char *TAG = "http_async";
+
+// JSON documents are allocated in PSRAM. The stack (TASK_HTTP_ASYNC in the
+// task plan) has to be internal because the handlers read from flash (NVS,
+// SPIFFS).
+
+typedef struct
+{
+    httpd_req_t *req;
+    esp_err_t (*handler)(httpd_req_t *req);
+    http_async_limit_t *limit;
+} http_async_job_t;
+
+static QueueHandle_t s_queue = NULL;
+static TaskHandle_t s_workers[HTTP_ASYNC_WORKERS] = {};
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static size_t s_reserved = 0;
+
+static bool reserve(http_async_limit_t *limit)
+{
+    PThreadGuard g(s_mutex);
+
+    if (limit->active >= limit->max_active) {
+        ESP_LOGW(TAG, "%s: too many requests (%d)", limit->name, limit->active);
+        limit->rejected++;
+        return false;
+    }
+
+    // don't rely on the budget alone, PSRAM could be fragmented
+    if (s_reserved + limit->mem > HTTP_ASYNC_MEM_BUDGET ||
+        heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) < limit->mem) {
+        ESP_LOGW(TAG, "%s: memory budget exceeded (%d reserved)", limit->name, (int) s_reserved);
+        limit->rejected++;
+        return false;
+    }
+
+    limit->active++;
+    s_reserved += limit->mem;
+    return true;
+}
+
+static void release(http_async_limit_t *limit)
+{
+    PThreadGuard g(s_mutex);
+    limit->active--;
+    s_reserved -= limit->mem;
+}
+
+static esp_err_t send_busy(httpd_req_t *req)
+{
+    // close connection when out of scope
+    ConGuard g(http_server, req);
+
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    httpd_resp_sendstr(req, "busy");
+    return ESP_OK;
+}
+
+static void worker_task(void *pv)
+{
+    http_async_job_t job;
+
+    while (1) {
+        if (xQueueReceive(s_queue, &job, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        job.handler(job.req);
+
+        if (httpd_req_async_handler_complete(job.req) != ESP_OK) {
+            ESP_LOGE(TAG, "failed to complete async request");
+        }
+        release(job.limit);
+    }
+}
+
+esp_err_t http_async_start(void)
+{
+    s_queue = xQueueCreate(HTTP_ASYNC_QUEUE_SIZE, sizeof(http_async_job_t));
+    if (!s_queue) {
+        ESP_LOGE(TAG, "failed to create queue");
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < HTTP_ASYNC_WORKERS; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "http async %d", i);
+        if (task_create(TASK_HTTP_ASYNC, worker_task, NULL, &s_workers[i], name) != pdPASS) {
+            ESP_LOGE(TAG, "failed to create worker %d", i);
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+bool http_async_on_worker(void)
+{
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < HTTP_ASYNC_WORKERS; i++) {
+        if (s_workers[i] == current) {
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t http_async_submit(httpd_req_t *req, esp_err_t (*handler)(httpd_req_t *req), http_async_limit_t *limit)
+{
+    // workers not running, handle it on the server task
+    if (!s_queue) {
+        return handler(req);
+    }
+
+    // the server task is the only producer, a free slot stays free
+    if (!uxQueueSpacesAvailable(s_queue)) {
+        ESP_LOGW(TAG, "%s: queue full", limit->name);
+        return send_busy(req);
+    }
+
+    if (!reserve(limit)) {
+        return send_busy(req);
+    }
+
+    http_async_job_t job = {.req = NULL, .handler = handler, .limit = limit};
+    if (httpd_req_async_handler_begin(req, &job.req) != ESP_OK) {
+        ESP_LOGE(TAG, "%s: failed to detach request", limit->name);
+        release(limit);
+        return send_busy(req);
+    }
+
+    xQueueSend(s_queue, &job, 0);
+    return ESP_OK;
+}
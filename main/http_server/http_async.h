@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_http_server.h"
+
+#define HTTP_ASYNC_WORKERS 2
+
+// a queued request keeps its socket, one slot per socket the server may
+// have open (max_open_sockets) so the queue itself never rejects
+#define HTTP_ASYNC_QUEUE_SIZE 10
+
+// memory all offloaded requests together may reserve
+#define HTTP_ASYNC_MEM_BUDGET (192 * 1024)
+
+// Limits of one offloaded handler
+//
+// active counts queued and running requests. mem is the estimated peak
+// memory of one request and is reserved from the budget while it is active.
+typedef struct
+{
+    const char *name;
+    uint8_t max_active;
+    size_t mem;
+    uint8_t active;
+    uint32_t rejected;
+} http_async_limit_t;
+
+#define HTTP_ASYNC_LIMIT(name, max_active, mem) {name, max_active, mem, 0, 0}
+
+// starts the worker tasks
+esp_err_t http_async_start(void);
+
+// true if called from an async worker
+bool http_async_on_worker(void);
+
+// Detaches the request from the server task and queues it for a worker that
+// calls handler again with the copied request. Responds 503 if the handler
+// limit or the memory budget is exceeded.
+//
+// usage at the top of a slow handler:
+//   if (!http_async_on_worker()) {
+//       return http_async_submit(req, HANDLER, &limit);
+//   }
+esp_err_t http_async_submit(httpd_req_t *req, esp_err_t (*handler)(httpd_req_t *req), http_async_limit_t *limit);
@@ -12,6 +12,8 @@
 #include "http_cors.h"
 #include "http_utils.h"
 #include "http_websocket.h"
+#include "ws_telemetry.h"
+#include "http_async.h"
 #include "handler_influx.h"
 #include "handler_swarm.h"
 #include "handler_system.h"
@@ -21,6 +23,9 @@
 #include "handler_file.h"
 #include "handler_alert.h"
 #include "handler_otp.h"
+#include "handler_selftest.h"
+#include "handler_capture.h"
+#include "handler_live.h"
 #include "macros.h"
 
 #pragma GCC diagnostic error "-Wall"
@@ -106,6 +111,7 @@ static void http_close_cb(void* hd, int sockfd)
         ESP_LOGI(TAG, "resetting websocket %d", sockfd);
         websocket_reset();
     }
+    ws_telemetry_remove(sockfd);
     ESP_LOGD(TAG, "http_close_cb: %d", sockfd);
     if (sockfd >= 0) {
         (void)close(sockfd);
@@ -144,7 +150,7 @@ esp_err_t start_rest_server(void * pvParameters)
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.uri_match_fn = httpd_uri_match_wildcard;
-    config.max_uri_handlers = 30;
+    config.max_uri_handlers = 44;
     config.lru_purge_enable = true;
     config.max_open_sockets = 10;
     config.stack_size = 12288;
@@ -162,6 +168,11 @@ esp_err_t start_rest_server(void * pvParameters)
         return ESP_FAIL;
     }
 
+    // slow handlers are offloaded, without workers they run on the server task
+    if (http_async_start() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start async workers");
+    }
+
     httpd_uri_t recovery_explicit_get_uri = {
         .uri = "/recovery", .method = HTTP_GET, .handler = rest_recovery_handler, .user_ctx = rest_context};
     httpd_register_uri_handler(http_server, &recovery_explicit_get_uri);
@@ -176,6 +187,26 @@ esp_err_t start_rest_server(void * pvParameters)
         .uri = "/api/system/asic", .method = HTTP_GET, .handler = GET_system_asic, .user_ctx = rest_context};
     httpd_register_uri_handler(http_server, &system_asic_get_uri);
 
+    httpd_uri_t system_tasks_get_uri = {
+        .uri = "/api/system/tasks", .method = HTTP_GET, .handler = GET_system_tasks, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &system_tasks_get_uri);
+
+    /* small endpoints for polling */
+    httpd_uri_t live_batch_get_uri = {
+        .uri = "/api/live/batch", .method = HTTP_GET, .handler = GET_live_batch, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &live_batch_get_uri);
+
+    httpd_uri_t live_get_uri = {.uri = "/api/live", .method = HTTP_GET, .handler = GET_live, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &live_get_uri);
+
+    httpd_uri_t live_pool_get_uri = {
+        .uri = "/api/live/pool", .method = HTTP_GET, .handler = GET_live, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &live_pool_get_uri);
+
+    httpd_uri_t live_asic_get_uri = {
+        .uri = "/api/live/asic", .method = HTTP_GET, .handler = GET_live, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &live_asic_get_uri);
+
     /* URI handler for fetching system info */
     httpd_uri_t influx_info_get_uri = {
         .uri = "/api/influx/info", .method = HTTP_GET, .handler = GET_influx_info, .user_ctx = rest_context};
@@ -224,6 +255,30 @@ esp_err_t start_rest_server(void * pvParameters)
         .uri = "/api/system", .method = HTTP_PATCH, .handler = PATCH_update_settings, .user_ctx = rest_context};
     httpd_register_uri_handler(http_server, &update_system_settings_uri);
 
+    httpd_uri_t temp_calibration_uri = {
+        .uri = "/api/system/tempcal", .method = HTTP_POST, .handler = POST_temp_calibration, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &temp_calibration_uri);
+
+    httpd_uri_t selftest_get_uri = {
+        .uri = "/api/system/selftest", .method = HTTP_GET, .handler = GET_selftest_report, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &selftest_get_uri);
+
+    httpd_uri_t selftest_post_uri = {
+        .uri = "/api/system/selftest", .method = HTTP_POST, .handler = POST_selftest, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &selftest_post_uri);
+
+    httpd_uri_t capture_info_uri = {
+        .uri = "/api/capture/info", .method = HTTP_GET, .handler = GET_capture_info, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &capture_info_uri);
+
+    httpd_uri_t capture_download_uri = {
+        .uri = "/api/capture", .method = HTTP_GET, .handler = GET_capture_download, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &capture_download_uri);
+
+    httpd_uri_t capture_post_uri = {
+        .uri = "/api/capture", .method = HTTP_POST, .handler = POST_capture, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &capture_post_uri);
+
     httpd_uri_t update_influx_settings_uri = {
         .uri = "/api/influx", .method = HTTP_PATCH, .handler = PATCH_update_influx, .user_ctx = rest_context};
     httpd_register_uri_handler(http_server, &update_influx_settings_uri);
@@ -279,6 +334,10 @@ esp_err_t start_rest_server(void * pvParameters)
     httpd_uri_t ws = {.uri = "/api/ws", .method = HTTP_GET, .handler = echo_handler, .user_ctx = NULL, .is_websocket = true};
     httpd_register_uri_handler(http_server, &ws);
 
+    httpd_uri_t ws_telemetry = {
+        .uri = "/api/ws/telemetry", .method = HTTP_GET, .handler = ws_telemetry_handler, .user_ctx = NULL, .is_websocket = true};
+    httpd_register_uri_handler(http_server, &ws_telemetry);
+
     httpd_uri_t update_post_ota_from_url = {
         .uri = "/api/system/OTA/github", .method = HTTP_POST, .handler = POST_OTA_update_from_url, .user_ctx = NULL};
     httpd_register_uri_handler(http_server, &update_post_ota_from_url);
@@ -311,6 +370,7 @@ esp_err_t start_rest_server(void * pvParameters)
     httpd_register_err_handler(http_server, HTTPD_404_NOT_FOUND, http_404_error_handler);
 
     websocket_start();
+    ws_telemetry_start();
 
     // Start the DNS server that will redirect all queries to the softAP IP
     dns_server_config_t dns_config = DNS_SERVER_CONFIG_SINGLE("*" /* all A queries */, "WIFI_AP_DEF" /* softAP netif ID */);
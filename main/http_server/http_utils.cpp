@@ -1,155 +1,60 @@
 #include "esp_log.h"
+#include <pthread.h>
 #include <strings.h>
 
 #include "ArduinoJson.h"
 #include "esp_err.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
 
 #include "http_utils.h"
 #include "macros.h"
+#include "rate_limit.h"
 
 static const char *TAG = "http_utils";
 
 extern OTP otp;
 
 
-#define RL_FAIL_LIMIT      5            // allowed wrong tries in window
-#define RL_WINDOW_SEC      60           // 1 min window
-#define RL_BLOCK_SEC       300          // 5 min blocking time
+static OtpRateLimit rl_limit;
+static pthread_mutex_t rl_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static uint64_t timestamps[RL_FAIL_LIMIT] = {};
-static uint64_t block_exp_time = 0;
+static bool get_client_addr(httpd_req_t *req, uint32_t addr[4])
+{
+    int sockfd = httpd_req_to_sockfd(req);
+    struct sockaddr_in6 sa;     // esp_http_server uses IPv6 addressing
+    socklen_t sa_size = sizeof(sa);
 
-// return true if currently blocked, false otherwise
-static bool isBlocked() {
-    uint64_t ts = now_ms(); // current time in ms
-
-    // if block_exp_time is set and lies in the future -> we are blocked
-    if (block_exp_time && block_exp_time > ts) {
-        // Do NOT extend the block on further failures.
-        // OTP changes after each 30s, so resetting the expiry
-        // on subsequent failures is unnecessary.
-        return true;
+    if (getpeername(sockfd, (struct sockaddr *) &sa, &sa_size) < 0) {
+        ESP_LOGE(TAG, "Error getting client IP");
+        return false;
     }
-    return false;
+    memcpy(addr, sa.sin6_addr.un.u32_addr, sizeof(uint32_t) * 4);
+    return true;
 }
 
-// most pragmatic approach of /some/ bruteforce protection
-static bool rateLimit() {
-    uint64_t ts = now_ms(); // current time in ms
-
-    // If a block existed but has expired, clear it and reset failure history.
-    if (block_exp_time && block_exp_time <= ts) {
-        block_exp_time = 0;
-        memset(timestamps, 0, sizeof(timestamps));
-    }
-
-    // Rotate the timestamps array one position towards the end (keep newest at index 0).
-    // Walk backwards to avoid overwriting values before they are copied.
-    for (int i = RL_FAIL_LIMIT - 1; i > 0; i--) {
-        timestamps[i] = timestamps[i - 1];
-    }
-    timestamps[0] = ts; // store newest failure timestamp at index 0
-
-    // If we have a full buffer of failure timestamps, check the time span
-    // between the newest and the oldest entry. If it's within the window,
-    // set the block expiry and deny further attempts.
-    if (timestamps[RL_FAIL_LIMIT - 1] != 0) {
-        uint64_t delta = timestamps[0] - timestamps[RL_FAIL_LIMIT - 1]; // newest - oldest
-        if (delta < RL_WINDOW_SEC * 1000ull) {
-            // block for RL_BLOCK_SEC (store expiry as ms)
-            block_exp_time = ts + (RL_BLOCK_SEC * 1000ull);
-            // optional: clear history immediately to avoid repeated re-blocking logic
-            memset(timestamps, 0, sizeof(timestamps));
-            return false; // blocked
-        }
-    }
-
-    return true; // allowed
+// return true if currently blocked, false otherwise
+static bool isBlocked(const uint32_t addr[4]) {
+    PThreadGuard lock(rl_mutex);
+    // monotonic, clock steps don't shorten a block
+    return rl_limit.isBlocked(addr, esp_timer_get_time() / 1000ull);
 }
 
+// records a failed attempt, returns false if the client is blocked now
+static bool rateLimit(const uint32_t addr[4]) {
+    PThreadGuard lock(rl_mutex);
+    return rl_limit.fail(addr, esp_timer_get_time() / 1000ull);
+}
 
-
-struct HttpdChunkHeapWriter {
-    httpd_req_t* m_req = nullptr;
-    bool m_failed = false;
-
-    uint8_t* m_buf = nullptr;
-    size_t m_cap = 0;
-    size_t m_pos = 0;
-
-    explicit HttpdChunkHeapWriter(httpd_req_t* req, size_t capacity)
-        : m_req(req), m_cap(capacity) {
-        m_buf = static_cast<uint8_t*>(MALLOC(m_cap));
-        if (!m_buf) {
-            m_failed = true;
-            m_cap = 0;
-        }
-    }
-
-    ~HttpdChunkHeapWriter() {
-        if (m_buf) {
-            FREE(m_buf);
-            m_buf = nullptr;
-        }
-    }
-
-    size_t write(uint8_t c) {
-        if (m_failed) return 0;
-        if (m_pos >= m_cap) {
-            flush();
-            if (m_failed) return 0;
-        }
-        m_buf[m_pos++] = c;
-        return 1;
-    }
-
-    size_t write(const uint8_t* data, size_t len) {
-        if (m_failed) return 0;
-
-        size_t written = 0;
-        while (len > 0 && !m_failed) {
-            const size_t space = m_cap - m_pos;
-            if (space == 0) {
-                flush();
-                continue;
-            }
-
-            const size_t n = (len < space) ? len : space;
-            memcpy(&m_buf[m_pos], data, n);
-            m_pos += n;
-
-            data += n;
-            len -= n;
-            written += n;
-
-            if (m_pos == m_cap) {
-                flush();
-            }
-        }
-        return written;
-    }
-
-    void flush() {
-        if (m_failed || m_pos == 0) return;
-
-        const esp_err_t err = httpd_resp_send_chunk(
-            m_req,
-            reinterpret_cast<const char*>(m_buf),
-            m_pos
-        );
-        if (err != ESP_OK) {
-            m_failed = true;
-            return;
-        }
-        m_pos = 0;
-    }
-
-    esp_err_t finish() {
-        flush();
-        if (m_failed) return ESP_FAIL;
-        return httpd_resp_send_chunk(m_req, nullptr, 0);
+static void format_client_addr(const uint32_t addr[4], char *out, size_t len)
+{
+    // esp_http_server reports IPv4 peers as IPv4-mapped IPv6 (::ffff:a.b.c.d)
+    if (!addr[0] && !addr[1] && addr[2] == htonl(0xffff)) {
+        inet_ntop(AF_INET, &addr[3], out, len);
+    } else {
+        inet_ntop(AF_INET6, addr, out, len);
     }
-};
+}
 
 esp_err_t sendJsonResponse(httpd_req_t* req, JsonDocument& doc)
 {
@@ -260,7 +165,11 @@ static bool check_otp_or_session(httpd_req_t *req, bool force)
 // Bequeme Variante: sendet 401 + WWW-Authenticate bei Failure
 esp_err_t validateOTP(httpd_req_t *req, bool force)
 {
-    if (isBlocked()) {
+    // unknown peers share one bucket
+    uint32_t addr[4] = {};
+    get_client_addr(req, addr);
+
+    if (isBlocked(addr)) {
         httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "blocked for 5 minutes");
         return ESP_FAIL;
     }
@@ -275,8 +184,10 @@ esp_err_t validateOTP(httpd_req_t *req, bool force)
     httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "OTP/Session required");
 
     // record the failed attempt
-    if (!rateLimit()) {
-        ESP_LOGE(TAG, "too many OTP failures. Blocking ...");
+    if (!rateLimit(addr)) {
+        char ipstr[INET6_ADDRSTRLEN];
+        format_client_addr(addr, ipstr, sizeof(ipstr));
+        ESP_LOGE(TAG, "too many OTP failures from %s. Blocking ...", ipstr);
     }
 
     return ESP_FAIL;
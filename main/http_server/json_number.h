@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ArduinoJson.h"
+
+// Formats floats and doubles exactly like serializing a JsonDocument that
+// holds the value, without building the document
+//
+// A document stores a double that is exactly representable as float as a
+// float, so it gets the 6 decimals of a float, other doubles get 9.
+// No ESP-IDF dependencies (see host/json_number_bench.cpp).
+template <typename TWriter> void json_write_number(TWriter &out, float value)
+{
+    ArduinoJson::detail::TextFormatter<TWriter &> fmt(out);
+    fmt.writeFloat(value);
+}
+
+template <typename TWriter> void json_write_number(TWriter &out, double value)
+{
+#if ARDUINOJSON_USE_DOUBLE
+    float asFloat = static_cast<float>(value);
+    if (value == asFloat) {
+        json_write_number(out, asFloat);
+        return;
+    }
+    ArduinoJson::detail::TextFormatter<TWriter &> fmt(out);
+    fmt.writeFloat(value);
+#else
+    json_write_number(out, static_cast<float>(value));
+#endif
+}
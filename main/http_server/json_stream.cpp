@@ -0,0 +1,205 @@
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "json_number.h"
+#include "json_stream.h"
+
+JsonStream::JsonStream(HttpdChunkHeapWriter &out) : m_out(out)
+{
+    m_first[0] = true;
+}
+
+void JsonStream::put(char c)
+{
+    m_out.write((uint8_t) c);
+}
+
+void JsonStream::put(const char *str)
+{
+    m_out.write((const uint8_t *) str, strlen(str));
+}
+
+// same escaping as ArduinoJson
+void JsonStream::string(const char *str)
+{
+    put('"');
+    for (const char *p = str; *p; p++) {
+        char c = *p;
+        switch (c) {
+        case '"':
+            put("\\\"");
+            break;
+        case '\\':
+            put("\\\\");
+            break;
+        case '\b':
+            put("\\b");
+            break;
+        case '\f':
+            put("\\f");
+            break;
+        case '\n':
+            put("\\n");
+            break;
+        case '\r':
+            put("\\r");
+            break;
+        case '\t':
+            put("\\t");
+            break;
+        default:
+            put(c);
+        }
+    }
+    put('"');
+}
+
+void JsonStream::separator()
+{
+    if (!m_first[m_depth]) {
+        put(',');
+    }
+    m_first[m_depth] = false;
+}
+
+void JsonStream::key(const char *key)
+{
+    separator();
+    if (key) {
+        string(key);
+        put(':');
+    }
+}
+
+void JsonStream::open(char c)
+{
+    put(c);
+    if (m_depth < JSON_STREAM_MAX_DEPTH - 1) {
+        m_depth++;
+    }
+    m_first[m_depth] = true;
+}
+
+void JsonStream::close(char c)
+{
+    put(c);
+    if (m_depth > 0) {
+        m_depth--;
+    }
+}
+
+void JsonStream::integer(int64_t value)
+{
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%" PRId64, value);
+    put(buf);
+}
+
+void JsonStream::unsignedInteger(uint64_t value)
+{
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%" PRIu64, value);
+    put(buf);
+}
+
+void JsonStream::number(float value)
+{
+    json_write_number(m_out, value);
+}
+
+void JsonStream::number(double value)
+{
+    json_write_number(m_out, value);
+}
+
+void JsonStream::beginObject(const char *k)
+{
+    key(k);
+    open('{');
+}
+
+void JsonStream::endObject()
+{
+    close('}');
+}
+
+void JsonStream::beginArray(const char *k)
+{
+    key(k);
+    open('[');
+}
+
+void JsonStream::endArray()
+{
+    close(']');
+}
+
+void JsonStream::add(const char *k, const char *value)
+{
+    key(k);
+    if (value) {
+        string(value);
+    } else {
+        put("null");
+    }
+}
+
+void JsonStream::add(const char *k, bool value)
+{
+    key(k);
+    put(value ? "true" : "false");
+}
+
+void JsonStream::add(const char *k, int value)
+{
+    key(k);
+    integer(value);
+}
+
+void JsonStream::add(const char *k, long value)
+{
+    key(k);
+    integer(value);
+}
+
+void JsonStream::add(const char *k, long long value)
+{
+    key(k);
+    integer(value);
+}
+
+void JsonStream::add(const char *k, unsigned int value)
+{
+    key(k);
+    unsignedInteger(value);
+}
+
+void JsonStream::add(const char *k, unsigned long value)
+{
+    key(k);
+    unsignedInteger(value);
+}
+
+void JsonStream::add(const char *k, unsigned long long value)
+{
+    key(k);
+    unsignedInteger(value);
+}
+
+void JsonStream::add(const char *k, float value)
+{
+    key(k);
+    number(value);
+}
+
+void JsonStream::add(const char *k, double value)
+{
+    key(k);
+    number(value);
+}
+
+void JsonStream::add(const char *k, JsonDocument &doc)
+{
+    key(k);
+    serializeJson(doc, m_out);
+}
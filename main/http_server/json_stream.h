@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ArduinoJson.h"
+
+#include "http_utils.h"
+
+#define JSON_STREAM_MAX_DEPTH 8
+
+// Writes JSON tokens directly into the chunk writer
+//
+// Replaces building a JsonDocument for large responses. Commas are inserted
+// automatically, floats are formatted with ArduinoJson's formatter (see
+// json_number.h) so the output is the same as serializing a document.
+class JsonStream {
+  protected:
+    HttpdChunkHeapWriter &m_out;
+    bool m_first[JSON_STREAM_MAX_DEPTH];
+    int m_depth = 0;
+
+    void put(char c);
+    void put(const char *str);
+    void string(const char *str);
+    void separator();
+    void key(const char *key);
+    void open(char c);
+    void close(char c);
+
+    void integer(int64_t value);
+    void unsignedInteger(uint64_t value);
+    void number(float value);
+    void number(double value);
+
+  public:
+    explicit JsonStream(HttpdChunkHeapWriter &out);
+
+    // key is only used inside of objects
+    void beginObject(const char *key = nullptr);
+    void endObject();
+    void beginArray(const char *key = nullptr);
+    void endArray();
+
+    void add(const char *key, const char *value);
+    void add(const char *key, bool value);
+    void add(const char *key, int value);
+    void add(const char *key, long value);
+    void add(const char *key, long long value);
+    void add(const char *key, unsigned int value);
+    void add(const char *key, unsigned long value);
+    void add(const char *key, unsigned long long value);
+    void add(const char *key, float value);
+    void add(const char *key, double value);
+
+    // serializes a (small) document as value
+    void add(const char *key, JsonDocument &doc);
+
+    // array elements
+    template <typename T> void item(T value)
+    {
+        add(nullptr, value);
+    }
+
+    bool failed()
+    {
+        return m_out.m_failed;
+    }
+};
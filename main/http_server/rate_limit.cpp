@@ -0,0 +1,93 @@
+#include <string.h>
+
+#include "rate_limit.h"
+
+void OtpRateLimit::refill(Client *c, uint64_t ts)
+{
+    // a block that expired starts with a full bucket
+    if (c->block_exp && c->block_exp <= ts) {
+        c->block_exp = 0;
+        c->tokens = RL_FAIL_LIMIT;
+    }
+
+    c->tokens += (float) (ts - c->last_ms) * RL_FAIL_LIMIT / (RL_WINDOW_SEC * 1000.0f);
+    if (c->tokens > RL_FAIL_LIMIT) {
+        c->tokens = RL_FAIL_LIMIT;
+    }
+    c->last_ms = ts;
+}
+
+// finds the client entry, creates one if create is set.
+// The least recently seen unblocked client is evicted when the table is
+// full, blocked clients are never evicted before their block expired.
+OtpRateLimit::Client *OtpRateLimit::find(const uint32_t addr[4], uint64_t ts, bool create)
+{
+    Client *victim = nullptr;
+
+    for (int i = 0; i < RL_CLIENTS; i++) {
+        Client *c = &m_clients[i];
+        if (c->used && !memcmp(c->addr, addr, sizeof(c->addr))) {
+            return c;
+        }
+        if (!create || (victim && !victim->used) || c->block_exp > ts) {
+            continue;
+        }
+        if (!c->used || !victim || c->last_ms < victim->last_ms) {
+            victim = c;
+        }
+    }
+
+    if (!victim) {
+        return nullptr;
+    }
+
+    memcpy(victim->addr, addr, sizeof(victim->addr));
+    victim->tokens = RL_FAIL_LIMIT;
+    victim->last_ms = ts;
+    victim->block_exp = 0;
+    victim->used = true;
+    return victim;
+}
+
+bool OtpRateLimit::isBlocked(const uint32_t addr[4], uint64_t ts)
+{
+    Client *c = find(addr, ts, false);
+    if (c) {
+        // Do NOT extend the block on further failures.
+        // OTP changes after each 30s, so resetting the expiry
+        // on subsequent failures is unnecessary.
+        return c->block_exp > ts;
+    }
+
+    // unknown clients are blocked while the table is full of blocked ones
+    for (int i = 0; i < RL_CLIENTS; i++) {
+        if (!m_clients[i].used || m_clients[i].block_exp <= ts) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OtpRateLimit::fail(const uint32_t addr[4], uint64_t ts)
+{
+    Client *c = find(addr, ts, true);
+    if (!c) {
+        // no slot that isn't blocked
+        return false;
+    }
+    if (c->block_exp > ts) {
+        return false;
+    }
+
+    refill(c, ts);
+    c->tokens -= 1.0f;
+
+    if (c->tokens < 1.0f) {
+        // block for RL_BLOCK_SEC (store expiry as ms)
+        c->block_exp = ts + (RL_BLOCK_SEC * 1000ull);
+        c->tokens = 0.0f;
+        return false; // blocked
+    }
+
+    return true; // allowed
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+#define RL_FAIL_LIMIT      5            // bucket size, allowed wrong tries in a burst
+#define RL_WINDOW_SEC      60           // the bucket refills completely within 1 min
+#define RL_BLOCK_SEC       300          // 5 min blocking time
+#define RL_CLIENTS         8            // tracked client addresses
+
+// Rate limit of failed OTP attempts
+//
+// Token bucket per client address, every failed attempt takes a token and
+// a client running out of tokens is blocked. When all tracked clients are
+// blocked, new addresses are blocked as well, so rotating addresses can't
+// get more than RL_CLIENTS buckets of tries.
+//
+// Not thread safe, times are monotonic ms. No ESP-IDF dependencies (see
+// host/otp_sim.cpp).
+class OtpRateLimit {
+  protected:
+    struct Client
+    {
+        uint32_t addr[4]; // IPv6 or IPv4-mapped address
+        float tokens;
+        uint64_t last_ms;
+        uint64_t block_exp;
+        bool used;
+    };
+
+    Client m_clients[RL_CLIENTS] = {};
+
+    void refill(Client *c, uint64_t ts);
+    Client *find(const uint32_t addr[4], uint64_t ts, bool create);
+
+  public:
+    bool isBlocked(const uint32_t addr[4], uint64_t ts);
+
+    // records a failed attempt, returns false if the client is blocked now
+    bool fail(const uint32_t addr[4], uint64_t ts);
+};
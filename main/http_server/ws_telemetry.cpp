@@ -0,0 +1,403 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include "ArduinoJson.h"
+
+#include "http_cors.h"
+#include "http_utils.h"
+#include "macros.h"
+#include "psram_allocator.h"
+#include "ws_telemetry.h"
+
+static const char *TAG = "ws_telemetry";
+
+#define WS_QUEUE_SIZE 16
+#define WS_MAX_RX_LEN 256
+
+// state messages
+#define WS_DEFAULT_INTERVAL_MS 1000
+#define WS_MIN_INTERVAL_MS 250
+
+// events (token bucket)
+#define WS_EVENT_RATE 10.0f
+#define WS_EVENT_BURST 20.0f
+
+#define TOPIC(type) (1u << (type))
+#define STATE_TOPICS (TOPIC(WS_TELEMETRY_LIVE) | TOPIC(WS_TELEMETRY_ASIC))
+
+typedef struct
+{
+    int fd; // -1 = unused
+    uint32_t topics;
+    uint32_t interval_ms;
+    int64_t last_state_ms[WS_TELEMETRY_NUM_TYPES];
+    uint32_t sent_seq[WS_TELEMETRY_NUM_TYPES];
+    uint32_t pending; // state topics that changed during the interval
+    float tokens;
+    int64_t tokens_ms;
+    uint32_t dropped;
+} ws_client_t;
+
+static const char *topic_names[WS_TELEMETRY_NUM_TYPES] = {NULL, "live", "asic", "share", "history"};
+
+static ws_client_t s_clients[WS_TELEMETRY_MAX_CLIENTS];
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static QueueHandle_t s_queue = NULL;
+static volatile uint32_t s_wanted = 0;
+static uint32_t s_seq[WS_TELEMETRY_NUM_TYPES] = {};
+
+// last payload of the state messages to send them only on change
+static uint8_t s_last[WS_TELEMETRY_NUM_TYPES][sizeof(ws_telemetry_asic_t)];
+static size_t s_last_len[WS_TELEMETRY_NUM_TYPES] = {};
+static int64_t s_last_ms[WS_TELEMETRY_NUM_TYPES] = {};
+
+static int64_t now_ms_boot()
+{
+    return esp_timer_get_time() / 1000;
+}
+
+// call with mutex held
+static void update_wanted()
+{
+    uint32_t wanted = 0;
+    for (int i = 0; i < WS_TELEMETRY_MAX_CLIENTS; i++) {
+        if (s_clients[i].fd >= 0) {
+            wanted |= s_clients[i].topics;
+        }
+    }
+    s_wanted = wanted;
+}
+
+static bool add_client(int fd)
+{
+    PThreadGuard g(s_mutex);
+    ws_client_t *free_slot = NULL;
+    for (int i = 0; i < WS_TELEMETRY_MAX_CLIENTS; i++) {
+        if (s_clients[i].fd == fd) {
+            return true;
+        }
+        if (s_clients[i].fd < 0 && !free_slot) {
+            free_slot = &s_clients[i];
+        }
+    }
+    if (!free_slot) {
+        return false;
+    }
+
+    memset(free_slot, 0, sizeof(ws_client_t));
+    free_slot->fd = fd;
+    free_slot->topics = TOPIC(WS_TELEMETRY_LIVE) | TOPIC(WS_TELEMETRY_ASIC) | TOPIC(WS_TELEMETRY_SHARE) |
+                        TOPIC(WS_TELEMETRY_HISTORY);
+    free_slot->interval_ms = WS_DEFAULT_INTERVAL_MS;
+    free_slot->tokens = WS_EVENT_BURST;
+    free_slot->tokens_ms = now_ms_boot();
+    update_wanted();
+
+    // new clients get the current state right away
+    memset(s_last_len, 0, sizeof(s_last_len));
+    return true;
+}
+
+void ws_telemetry_remove(int fd)
+{
+    PThreadGuard g(s_mutex);
+    for (int i = 0; i < WS_TELEMETRY_MAX_CLIENTS; i++) {
+        if (s_clients[i].fd == fd) {
+            ESP_LOGI(TAG, "client %d removed (%lu dropped)", fd, s_clients[i].dropped);
+            s_clients[i].fd = -1;
+        }
+    }
+    update_wanted();
+}
+
+static void subscribe(int fd, const char *json)
+{
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    if (deserializeJson(doc, json)) {
+        ESP_LOGW(TAG, "invalid subscription");
+        return;
+    }
+
+    uint32_t topics = 0;
+    for (JsonVariant t : doc["topics"].as<JsonArray>()) {
+        const char *name = t.as<const char *>();
+        for (int i = 1; name && i < WS_TELEMETRY_NUM_TYPES; i++) {
+            if (!strcmp(name, topic_names[i])) {
+                topics |= TOPIC(i);
+            }
+        }
+    }
+
+    uint32_t interval = doc["interval"] | WS_DEFAULT_INTERVAL_MS;
+
+    PThreadGuard g(s_mutex);
+    for (int i = 0; i < WS_TELEMETRY_MAX_CLIENTS; i++) {
+        if (s_clients[i].fd == fd) {
+            s_clients[i].topics = topics;
+            s_clients[i].interval_ms = (interval < WS_MIN_INTERVAL_MS) ? WS_MIN_INTERVAL_MS : interval;
+            ESP_LOGI(TAG, "client %d: topics %02lx interval %lums", fd, topics, s_clients[i].interval_ms);
+        }
+    }
+    update_wanted();
+    memset(s_last_len, 0, sizeof(s_last_len));
+}
+
+// decides under the mutex whether a client gets the message
+static bool allowed(ws_client_t *c, const ws_telemetry_header_t *header, int64_t now)
+{
+    uint8_t type = header->type;
+    if (c->fd < 0 || !(c->topics & TOPIC(type))) {
+        return false;
+    }
+
+    if (STATE_TOPICS & TOPIC(type)) {
+        if (header->seq <= c->sent_seq[type]) {
+            // already sent by flush_pending()
+            return false;
+        }
+        if (now - c->last_state_ms[type] < (int64_t) c->interval_ms) {
+            // the latest state is sent when the interval is over
+            c->pending |= TOPIC(type);
+            return false;
+        }
+        c->last_state_ms[type] = now;
+        c->sent_seq[type] = header->seq;
+        c->pending &= ~TOPIC(type);
+        return true;
+    }
+
+    c->tokens += (now - c->tokens_ms) * WS_EVENT_RATE / 1000.0f;
+    if (c->tokens > WS_EVENT_BURST) {
+        c->tokens = WS_EVENT_BURST;
+    }
+    c->tokens_ms = now;
+
+    if (c->tokens < 1.0f) {
+        c->dropped++;
+        return false;
+    }
+    c->tokens -= 1.0f;
+    return true;
+}
+
+static uint8_t *new_message(uint8_t type, const void *payload, size_t len, int64_t timestamp_ms)
+{
+    uint8_t *msg = (uint8_t *) MALLOC(sizeof(ws_telemetry_header_t) + len);
+    if (!msg) {
+        return NULL;
+    }
+
+    ws_telemetry_header_t *header = (ws_telemetry_header_t *) msg;
+    header->version = WS_TELEMETRY_VERSION;
+    header->type = type;
+    header->length = len;
+    header->seq = 0;
+    header->timestamp_ms = timestamp_ms;
+    memcpy(msg + sizeof(ws_telemetry_header_t), payload, len);
+    return msg;
+}
+
+static void send_message(uint8_t *msg, const int *fds, int num)
+{
+    ws_telemetry_header_t *header = (ws_telemetry_header_t *) msg;
+
+    httpd_ws_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.type = HTTPD_WS_TYPE_BINARY;
+    frame.payload = msg;
+    frame.len = sizeof(ws_telemetry_header_t) + header->length;
+
+    for (int i = 0; i < num; i++) {
+        if (!http_server || httpd_ws_send_frame_async(http_server, fds[i], &frame) != ESP_OK) {
+            // socket is dead or was reused
+            ws_telemetry_remove(fds[i]);
+        }
+    }
+}
+
+// sends the latest state to the clients that skipped a change during their
+// interval and returns how long to wait for the next one that is due
+static TickType_t flush_pending()
+{
+    int64_t wait_ms = -1;
+
+    for (int type = 0; type < WS_TELEMETRY_NUM_TYPES; type++) {
+        if (!(STATE_TOPICS & TOPIC(type))) {
+            continue;
+        }
+
+        int fds[WS_TELEMETRY_MAX_CLIENTS];
+        int num = 0;
+        uint8_t *msg = NULL;
+        {
+            PThreadGuard g(s_mutex);
+            int64_t now = now_ms_boot();
+            for (int i = 0; i < WS_TELEMETRY_MAX_CLIENTS; i++) {
+                ws_client_t *c = &s_clients[i];
+                if (c->fd < 0 || !(c->pending & TOPIC(type))) {
+                    continue;
+                }
+                int64_t due = c->last_state_ms[type] + c->interval_ms - now;
+                if (due > 0) {
+                    wait_ms = (wait_ms < 0 || due < wait_ms) ? due : wait_ms;
+                    continue;
+                }
+                c->pending &= ~TOPIC(type);
+                // a cleared state is sent to everyone on the next publish
+                if (!(c->topics & TOPIC(type)) || !s_last_len[type] || c->sent_seq[type] >= s_seq[type]) {
+                    continue;
+                }
+                c->last_state_ms[type] = now;
+                c->sent_seq[type] = s_seq[type];
+                fds[num++] = c->fd;
+            }
+            if (num) {
+                msg = new_message(type, s_last[type], s_last_len[type], s_last_ms[type]);
+                if (msg) {
+                    ((ws_telemetry_header_t *) msg)->seq = s_seq[type];
+                }
+            }
+        }
+
+        if (msg) {
+            send_message(msg, fds, num);
+            FREE(msg);
+        }
+    }
+
+    if (wait_ms < 0) {
+        return portMAX_DELAY;
+    }
+    TickType_t ticks = pdMS_TO_TICKS(wait_ms);
+    return ticks ? ticks : 1;
+}
+
+static void sender_task(void *pv)
+{
+    TickType_t wait = portMAX_DELAY;
+    while (1) {
+        uint8_t *msg = NULL;
+        if (xQueueReceive(s_queue, &msg, wait) == pdTRUE && msg) {
+            ws_telemetry_header_t *header = (ws_telemetry_header_t *) msg;
+
+            int fds[WS_TELEMETRY_MAX_CLIENTS];
+            int num = 0;
+            {
+                PThreadGuard g(s_mutex);
+                int64_t now = now_ms_boot();
+                for (int i = 0; i < WS_TELEMETRY_MAX_CLIENTS; i++) {
+                    if (allowed(&s_clients[i], header, now)) {
+                        fds[num++] = s_clients[i].fd;
+                    }
+                }
+            }
+
+            send_message(msg, fds, num);
+            FREE(msg);
+        }
+
+        wait = flush_pending();
+    }
+}
+
+bool ws_telemetry_wanted(uint8_t type)
+{
+    return s_queue && (s_wanted & TOPIC(type));
+}
+
+void ws_telemetry_publish(uint8_t type, const void *payload, size_t len)
+{
+    if (!ws_telemetry_wanted(type) || type >= WS_TELEMETRY_NUM_TYPES || len > sizeof(s_last[0])) {
+        return;
+    }
+
+    uint8_t *msg = new_message(type, payload, len, now_ms_boot());
+    if (!msg) {
+        return;
+    }
+    ws_telemetry_header_t *header = (ws_telemetry_header_t *) msg;
+
+    {
+        PThreadGuard g(s_mutex);
+        if (STATE_TOPICS & TOPIC(type)) {
+            if (s_last_len[type] == len && !memcmp(s_last[type], payload, len)) {
+                FREE(msg);
+                return;
+            }
+            memcpy(s_last[type], payload, len);
+            s_last_len[type] = len;
+            s_last_ms[type] = header->timestamp_ms;
+        }
+        header->seq = ++s_seq[type];
+    }
+
+    if (xQueueSend(s_queue, &msg, 0) != pdTRUE) {
+        FREE(msg);
+    }
+}
+
+esp_err_t ws_telemetry_handler(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    int fd = httpd_req_to_sockfd(req);
+
+    if (req->method == HTTP_GET) {
+        if (!add_client(fd)) {
+            ESP_LOGW(TAG, "too many clients");
+            return ESP_FAIL;
+        }
+        ESP_LOGI(TAG, "client %d connected", fd);
+        return ESP_OK;
+    }
+
+    httpd_ws_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+
+    // header first to get the length
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, 0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (frame.type == HTTPD_WS_TYPE_CLOSE) {
+        ws_telemetry_remove(fd);
+        return ESP_OK;
+    }
+
+    if (frame.type != HTTPD_WS_TYPE_TEXT || !frame.len || frame.len >= WS_MAX_RX_LEN) {
+        return ESP_OK;
+    }
+
+    char buf[WS_MAX_RX_LEN];
+    frame.payload = (uint8_t *) buf;
+    ret = httpd_ws_recv_frame(req, &frame, frame.len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    buf[frame.len] = 0;
+
+    subscribe(fd, buf);
+    return ESP_OK;
+}
+
+void ws_telemetry_start()
+{
+    for (int i = 0; i < WS_TELEMETRY_MAX_CLIENTS; i++) {
+        s_clients[i].fd = -1;
+    }
+
+    s_queue = xQueueCreate(WS_QUEUE_SIZE, sizeof(uint8_t *));
+
+    xTaskCreate(&sender_task, "ws_telemetry", 4096, NULL, 2, NULL);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_http_server.h"
+
+// Binary telemetry over websocket (/api/ws/telemetry)
+//
+// Every message is a header followed by the payload of its type, all
+// values little endian and packed. Clients subscribe by sending a text
+// frame like {"topics":["live","asic","share","history"],"interval":1000}.
+// interval is the minimum time in ms between two state messages (live,
+// asic), a change during the interval is sent with the latest state when
+// it is over. Events (share, history) are limited by a token bucket.
+
+#define WS_TELEMETRY_VERSION 1
+#define WS_TELEMETRY_MAX_CLIENTS 4
+#define WS_TELEMETRY_MAX_ASICS 16
+
+enum ws_telemetry_type_t
+{
+    WS_TELEMETRY_LIVE = 1,
+    WS_TELEMETRY_ASIC = 2,
+    WS_TELEMETRY_SHARE = 3,
+    WS_TELEMETRY_HISTORY = 4,
+    WS_TELEMETRY_NUM_TYPES
+};
+
+typedef struct __attribute__((packed))
+{
+    uint8_t version;
+    uint8_t type;
+    uint16_t length; // payload length
+    uint32_t seq;    // per type
+    uint64_t timestamp_ms;
+} ws_telemetry_header_t;
+
+typedef struct __attribute__((packed))
+{
+    float hashrate;
+    float hashrate_1m;
+    float hashrate_10m;
+    float hashrate_1h;
+    float hashrate_1d;
+    float power;
+    float voltage;
+    float current;
+    float temp;
+    float vr_temp;
+    uint16_t fan_perc;
+    uint16_t fan_rpm;
+    uint32_t shares_accepted;
+    uint32_t shares_rejected;
+} ws_telemetry_live_t;
+
+typedef struct __attribute__((packed))
+{
+    float hashrate;
+    float temp;
+    float frequency;
+} ws_telemetry_chip_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t count;
+    uint8_t reserved[3];
+    ws_telemetry_chip_t chips[WS_TELEMETRY_MAX_ASICS]; // only count are sent
+} ws_telemetry_asic_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t pool;
+    uint8_t accepted;
+    uint16_t reserved;
+    uint32_t shares_accepted;
+    uint32_t shares_rejected;
+} ws_telemetry_share_t;
+
+typedef struct __attribute__((packed))
+{
+    uint64_t timestamp;
+    float hashrate;
+    float hashrate_1m;
+    float hashrate_10m;
+    float hashrate_1h;
+    float hashrate_1d;
+    float vreg_temp;
+    float asic_temp;
+} ws_telemetry_history_t;
+
+esp_err_t ws_telemetry_handler(httpd_req_t *req);
+
+void ws_telemetry_start();
+
+// called when a socket is closed
+void ws_telemetry_remove(int fd);
+
+// true if any client subscribed to the type, producers can skip
+// collecting the data if not
+bool ws_telemetry_wanted(uint8_t type);
+
+// queues a message for all subscribers. State messages (live, asic)
+// with the same payload as the last one are dropped.
+void ws_telemetry_publish(uint8_t type, const void *payload, size_t len);
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Log2 latency histogram in microseconds. Bucket 0 counts values below
+// FIRST_BUCKET_US, every following bucket doubles the upper bound, the
+// last bucket takes everything above. No locking.
+class LatencyHistogram {
+  public:
+    static constexpr int NUM_BUCKETS = 14;
+    static constexpr uint32_t FIRST_BUCKET_US = 128;
+
+  protected:
+    uint32_t m_buckets[NUM_BUCKETS];
+    uint32_t m_count;
+    uint32_t m_max;
+    uint64_t m_sum;
+
+  public:
+    LatencyHistogram()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        memset(m_buckets, 0, sizeof(m_buckets));
+        m_count = 0;
+        m_max = 0;
+        m_sum = 0;
+    }
+
+    void add(uint32_t us)
+    {
+        int b = 0;
+        while (b < NUM_BUCKETS - 1 && us >= upperBound(b)) {
+            b++;
+        }
+        m_buckets[b]++;
+        m_count++;
+        m_sum += us;
+        if (us > m_max) {
+            m_max = us;
+        }
+    }
+
+    // exclusive upper bound of a bucket, UINT32_MAX for the last one
+    static uint32_t upperBound(int bucket)
+    {
+        return (bucket >= NUM_BUCKETS - 1) ? UINT32_MAX : (FIRST_BUCKET_US << bucket);
+    }
+
+    // upper bound of the bucket containing the percentile (0..100),
+    // the maximum if that is the last bucket
+    uint32_t percentile(float p) const
+    {
+        if (!m_count) {
+            return 0;
+        }
+        uint64_t rank = (uint64_t) ((p / 100.0f) * m_count + 0.5f);
+        if (rank < 1) {
+            rank = 1;
+        }
+        uint64_t seen = 0;
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            seen += m_buckets[b];
+            if (seen >= rank) {
+                uint32_t bound = upperBound(b);
+                return (bound > m_max) ? m_max : bound;
+            }
+        }
+        return m_max;
+    }
+
+    uint32_t getBucket(int bucket) const
+    {
+        return m_buckets[bucket];
+    }
+
+    uint32_t getCount() const
+    {
+        return m_count;
+    }
+
+    uint32_t getMax() const
+    {
+        return m_max;
+    }
+
+    uint32_t getAvg() const
+    {
+        return m_count ? (uint32_t) (m_sum / m_count) : 0;
+    }
+};
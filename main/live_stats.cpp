@@ -0,0 +1,157 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "global_state.h"
+#include "live_stats.h"
+#include "macros.h"
+#include "ws_telemetry.h"
+
+static const char *TAG = "live_stats";
+
+static const char *topicNames[LiveStats::NUM_TOPICS] = {"live", "pool", "asic"};
+
+char *LiveStats::back(Topic topic)
+{
+    return m_buffers[topic].data[1 - m_buffers[topic].front];
+}
+
+void LiveStats::publish(Topic topic, int len)
+{
+    if (len <= 0 || len >= LIVE_STATS_BUF_SIZE) {
+        ESP_LOGE(TAG, "%s: buffer too small (%d)", topicNames[topic], len);
+        return;
+    }
+
+    PThreadGuard g(m_mutex);
+    Buffer *b = &m_buffers[topic];
+    b->len[1 - b->front] = len;
+    b->front = 1 - b->front;
+}
+
+void LiveStats::updateLive()
+{
+    History *history = SYSTEM_MODULE.getHistory();
+    bool shutdown = POWER_MANAGEMENT_MODULE.isShutdown();
+
+    int len = snprintf(back(LIVE), LIVE_STATS_BUF_SIZE,
+                       "{\"timestamp\":%llu,\"uptimeSeconds\":%lld,\"shutdown\":%s,"
+                       "\"hashRate\":%.2f,\"hashRate_1m\":%.2f,\"hashRate_10m\":%.2f,\"hashRate_1h\":%.2f,\"hashRate_1d\":%.2f,"
+                       "\"power\":%.2f,\"voltage\":%.2f,\"current\":%.2f,\"temp\":%.1f,\"vrTemp\":%.1f,"
+                       "\"fanspeed\":%u,\"fanrpm\":%u,"
+                       "\"sharesAccepted\":%llu,\"sharesRejected\":%llu,\"bestDiff\":%llu,\"bestSessionDiff\":%llu,"
+                       "\"foundBlocks\":%lu}",
+                       history->getCurrentTimestamp(), (esp_timer_get_time() - SYSTEM_MODULE.getStartTime()) / 1000000,
+                       shutdown ? "true" : "false",
+                       !shutdown ? SYSTEM_MODULE.getCurrentHashrate() : 0.0, !shutdown ? history->getCurrentHashrate1m() : 0.0,
+                       !shutdown ? history->getCurrentHashrate10m() : 0.0, !shutdown ? history->getCurrentHashrate1h() : 0.0,
+                       !shutdown ? history->getCurrentHashrate1d() : 0.0, POWER_MANAGEMENT_MODULE.getPower(),
+                       POWER_MANAGEMENT_MODULE.getVoltage(), POWER_MANAGEMENT_MODULE.getCurrent(),
+                       POWER_MANAGEMENT_MODULE.getChipTempMax(), POWER_MANAGEMENT_MODULE.getVRTemp(),
+                       POWER_MANAGEMENT_MODULE.getFanPerc(), POWER_MANAGEMENT_MODULE.getFanRPM(0),
+                       STRATUM_MANAGER->getSharesAccepted(), STRATUM_MANAGER->getSharesRejected(),
+                       STRATUM_MANAGER->getBestDiff(), STRATUM_MANAGER->getBestSessionDiff(),
+                       STRATUM_MANAGER->getFoundBlocks());
+    publish(LIVE, len);
+
+    if (ws_telemetry_wanted(WS_TELEMETRY_LIVE)) {
+        ws_telemetry_live_t live = {
+            .hashrate = !shutdown ? SYSTEM_MODULE.getCurrentHashrate() : 0.0f,
+            .hashrate_1m = !shutdown ? (float) history->getCurrentHashrate1m() : 0.0f,
+            .hashrate_10m = !shutdown ? (float) history->getCurrentHashrate10m() : 0.0f,
+            .hashrate_1h = !shutdown ? (float) history->getCurrentHashrate1h() : 0.0f,
+            .hashrate_1d = !shutdown ? (float) history->getCurrentHashrate1d() : 0.0f,
+            .power = POWER_MANAGEMENT_MODULE.getPower(),
+            .voltage = POWER_MANAGEMENT_MODULE.getVoltage(),
+            .current = POWER_MANAGEMENT_MODULE.getCurrent(),
+            .temp = POWER_MANAGEMENT_MODULE.getChipTempMax(),
+            .vr_temp = POWER_MANAGEMENT_MODULE.getVRTemp(),
+            .fan_perc = POWER_MANAGEMENT_MODULE.getFanPerc(),
+            .fan_rpm = POWER_MANAGEMENT_MODULE.getFanRPM(0),
+            .shares_accepted = (uint32_t) STRATUM_MANAGER->getSharesAccepted(),
+            .shares_rejected = (uint32_t) STRATUM_MANAGER->getSharesRejected(),
+        };
+        ws_telemetry_publish(WS_TELEMETRY_LIVE, &live, sizeof(live));
+    }
+}
+
+void LiveStats::updatePool()
+{
+    int len = snprintf(back(POOL), LIVE_STATS_BUF_SIZE,
+                       "{\"connected\":%d,\"poolDifficulty\":%lu,\"poolErrors\":%d,\"sharesAccepted\":%llu,"
+                       "\"sharesRejected\":%llu,\"foundBlocks\":%lu,\"totalFoundBlocks\":%lu,"
+                       "\"lastpingrtt\":%.2f,\"recentpingloss\":%.2f,\"usingFallback\":%s,\"selectedPool\":%d}",
+                       STRATUM_MANAGER->getNumConnectedPools(), STRATUM_MANAGER->getPoolDifficulty(),
+                       STRATUM_MANAGER->getPoolErrors(), STRATUM_MANAGER->getSharesAccepted(),
+                       STRATUM_MANAGER->getSharesRejected(), STRATUM_MANAGER->getFoundBlocks(),
+                       STRATUM_MANAGER->getTotalFoundBlocks(), get_last_ping_rtt(), get_recent_ping_loss(),
+                       STRATUM_MANAGER->isUsingFallback() ? "true" : "false", STRATUM_MANAGER->getSelectedPool());
+    publish(POOL, len);
+}
+
+void LiveStats::updateAsic()
+{
+    Board *board = SYSTEM_MODULE.getBoard();
+    ChipThermalModel *chips = POWER_MANAGEMENT_MODULE.getChipModel();
+    char *buf = back(ASIC);
+    size_t size = LIVE_STATS_BUF_SIZE;
+    int count = board->getAsicCount();
+
+    int len = snprintf(buf, size, "{\"asicCount\":%d,\"asicTemps\":[", count);
+    for (int i = 0; i < count && len < (int) size; i++) {
+        len += snprintf(buf + len, size - len, i ? ",%.1f" : "%.1f", board->getChipTemp(i));
+    }
+    if (len < (int) size) {
+        len += snprintf(buf + len, size - len, "],\"asicFrequencies\":[");
+    }
+    for (int i = 0; i < count && len < (int) size; i++) {
+        len += snprintf(buf + len, size - len, i ? ",%.0f" : "%.0f", chips->getChipFrequency(i));
+    }
+    if (len < (int) size) {
+        len += snprintf(buf + len, size - len, "],\"frequency\":%d,\"coreVoltage\":%d}", board->getAsicFrequency(),
+                        board->getAsicVoltageMillis());
+    }
+    publish(ASIC, len);
+
+    if (ws_telemetry_wanted(WS_TELEMETRY_ASIC)) {
+        ws_telemetry_asic_t asic = {};
+        asic.count = (count < WS_TELEMETRY_MAX_ASICS) ? count : WS_TELEMETRY_MAX_ASICS;
+        for (int i = 0; i < asic.count; i++) {
+            asic.chips[i].hashrate = HASHRATE_MONITOR.getChipHashrate(i);
+            asic.chips[i].temp = board->getChipTemp(i);
+            asic.chips[i].frequency = chips->getChipFrequency(i);
+        }
+        ws_telemetry_publish(WS_TELEMETRY_ASIC, &asic, offsetof(ws_telemetry_asic_t, chips) + asic.count * sizeof(ws_telemetry_chip_t));
+    }
+}
+
+size_t LiveStats::get(Topic topic, char *buf, size_t size)
+{
+    PThreadGuard g(m_mutex);
+    Buffer *b = &m_buffers[topic];
+    size_t len = b->len[b->front];
+    if (!len || len >= size) {
+        return 0;
+    }
+    memcpy(buf, b->data[b->front], len);
+    buf[len] = 0;
+    return len;
+}
+
+const char *LiveStats::topicName(Topic topic)
+{
+    return (topic < NUM_TOPICS) ? topicNames[topic] : "";
+}
+
+LiveStats::Topic LiveStats::topicByName(const char *name, size_t len)
+{
+    for (int i = 0; i < NUM_TOPICS; i++) {
+        if (strlen(topicNames[i]) == len && !strncmp(topicNames[i], name, len)) {
+            return (Topic) i;
+        }
+    }
+    return NUM_TOPICS;
+}
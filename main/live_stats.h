@@ -0,0 +1,53 @@
+#pragma once
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define LIVE_STATS_BUF_SIZE 1024
+
+// Preformatted JSON of the frequently polled values
+//
+// The producer tasks format their topic after each update, the API
+// handlers only copy the current buffer. No NVS access and no JSON
+// document is needed per request.
+class LiveStats {
+  public:
+    enum Topic
+    {
+        LIVE = 0, // hashrate, power, temps, fan, shares
+        POOL,     // stratum statistics
+        ASIC,     // per-chip temps and frequencies
+        NUM_TOPICS
+    };
+
+  protected:
+    // double buffered, only one producer per topic
+    struct Buffer
+    {
+        char data[2][LIVE_STATS_BUF_SIZE];
+        size_t len[2];
+        int front;
+    };
+
+    Buffer m_buffers[NUM_TOPICS]{};
+    pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    char *back(Topic topic);
+    void publish(Topic topic, int len);
+
+  public:
+    // called by the system task
+    void updateLive();
+    void updatePool();
+
+    // called by the power management task
+    void updateAsic();
+
+    // copies the topic into buf, returns the length or 0 if not available
+    size_t get(Topic topic, char *buf, size_t size);
+
+    static const char *topicName(Topic topic);
+
+    // returns NUM_TOPICS if unknown
+    static Topic topicByName(const char *name, size_t len);
+};
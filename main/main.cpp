@@ -3,6 +3,7 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_netif.h"
+#include "esp_system.h"
 #include "esp_task_wdt.h"
 #include "mbedtls/platform.h"
 #include "nvs_flash.h"
@@ -33,9 +34,9 @@
 #include "otp/otp.h"
 #include "ping_task.h"
 #include "serial.h"
-#include "stratum/stratum_manager_fallback.h"
-#include "stratum/stratum_manager_dual_pool.h"
+#include "stratum/stratum_manager.h"
 #include "system.h"
+#include "task_monitor.h"
 #include "wifi_health.h"
 #include "guards.h"
 #include "utils.h"
@@ -46,6 +47,7 @@ System SYSTEM_MODULE;
 
 PowerManagementTask POWER_MANAGEMENT_MODULE;
 HashrateMonitor HASHRATE_MONITOR;
+LiveStats LIVE_STATS;
 
 StratumManager *STRATUM_MANAGER = nullptr;
 APIsFetcher APIs_FETCHER;
@@ -54,6 +56,7 @@ FactoryOTAUpdate FACTORY_OTA_UPDATER;
 DiscordAlerter discordAlerter;
 
 AsicJobs asicJobs;
+NotifyPool notifyPool;
 
 OTP otp;
 SNTP sntp;
@@ -66,10 +69,8 @@ static const char *TAG = "nerd*axe";
 
 uint64_t now_ms()
 {
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-    // Combine seconds + microseconds → milliseconds
-    return (uint64_t) tv.tv_sec * 1000ULL + tv.tv_usec / 1000ULL;
+    // UTC from the slewed esp_timer mapping, never jumps on resyncs
+    return sntp.nowMs();
 }
 
 uint32_t now()
@@ -149,15 +150,11 @@ void initWatchdog()
 
 StratumManager* newStratumManager() {
     int mode = (int) Config::getPoolMode();
-    switch (mode) {
-    case 0:
-        return new StratumManagerFallback();
-    case 1:
-        return new StratumManagerDualPool();
-    default:
+    if (mode < 0 || mode >= POOL_MODE_MAX) {
         ESP_LOGE(TAG, "invalid pool mode %d", (int) mode);
         return nullptr;
     }
+    return new StratumManager((StratumManager::PoolMode) mode);
 }
 
 // Custom calloc function that allocates from PSRAM
@@ -176,22 +173,6 @@ void free_psram(void *ptr)
     heap_caps_free(ptr);
 }
 
-#if 0
-const UBaseType_t max_tasks = 30;
-TaskStatus_t task_list[max_tasks];
-
-void monitor_all_task_watermarks() {
-    UBaseType_t count = uxTaskGetSystemState(task_list, max_tasks, NULL);
-
-    for (int i = 0; i < count; ++i) {
-        ESP_LOGW("TASK_MON", "Task '%s': watermark = %lu words",
-            task_list[i].pcTaskName,
-            task_list[i].usStackHighWaterMark);
-
-    }
-}
-#endif
-
 
 extern "C" void app_main(void)
 {
@@ -200,6 +181,11 @@ extern "C" void app_main(void)
     // use PSRAM because TLS costs a lot of internal RAM
     mbedtls_platform_set_calloc_free(psram_calloc, free_psram);
 
+    // mining.notify blocks, allocated once before the heap gets used
+    if (!notifyPool.init(psram_calloc, free_psram)) {
+        ESP_LOGE(TAG, "no memory for the notify pool");
+    }
+
     ESP_LOGI(TAG, "Welcome to the Nerd*Axe - hack the planet!");
     ESP_ERROR_CHECK(nvs_flash_init());
 
@@ -244,6 +230,7 @@ extern "C" void app_main(void)
 
 
     SYSTEM_MODULE.setBoard(board);
+    task_plan_apply(board->getTaskPlan());
 
     size_t total_psram = esp_psram_get_size();
     ESP_LOGI(TAG, "PSRAM found with %dMB", total_psram / (1024 * 1024));
@@ -252,8 +239,18 @@ extern "C" void app_main(void)
 
     uint64_t best_diff = Config::getBestDiff();
     bool should_self_test = Config::isSelfTestEnabled();
-    if (should_self_test && !best_diff) {
+    bool field_self_test = Config::isSelfTestField();
+    if (should_self_test && (!best_diff || field_self_test)) {
         board->selfTest();
+
+        // a self-test requested via API returns to mining, the report
+        // is available on the API after the restart
+        if (field_self_test) {
+            Config::setSelfTest(false);
+            Config::setSelfTestField(false);
+            vTaskDelay(pdMS_TO_TICKS(10000));
+            esp_restart();
+        }
         vTaskDelay(pdMS_TO_TICKS(60 * 60 * 1000));
     }
 
@@ -266,8 +263,8 @@ extern "C" void app_main(void)
 
     STRATUM_MANAGER->loadSettings();
 
-    xTaskCreate(SYSTEM_MODULE.taskWrapper, "SYSTEM_task", 4096, &SYSTEM_MODULE, 3, NULL);
-    xTaskCreate(POWER_MANAGEMENT_MODULE.taskWrapper, "power mangement", 8192, (void *) &POWER_MANAGEMENT_MODULE, 10, NULL);
+    task_create(TASK_SYSTEM, SYSTEM_MODULE.taskWrapper, &SYSTEM_MODULE);
+    task_create(TASK_POWER_MANAGEMENT, POWER_MANAGEMENT_MODULE.taskWrapper, (void *) &POWER_MANAGEMENT_MODULE);
 
     setup_wifi();
 
@@ -303,13 +300,13 @@ extern "C" void app_main(void)
         }
         POWER_MANAGEMENT_MODULE.unlock();
 
-        xTaskCreate(create_jobs_task, "stratum miner", 8192, NULL, 10, NULL);
-        xTaskCreate(ASIC_result_task, "asic result", 8192, NULL, 15, NULL);
-        xTaskCreate(influx_task, "influx", 8192, NULL, 1, NULL);
-        xTaskCreatePSRAM(APIs_FETCHER.taskWrapper, "apis ticker", 8192, (void *) &APIs_FETCHER, 5, NULL);
-        xTaskCreatePSRAM(wifi_monitor_task, "wifi monitor", 4096, NULL, 1, NULL);
-        xTaskCreate(FACTORY_OTA_UPDATER.taskWrapper, "ota updater", 8192, (void *) &FACTORY_OTA_UPDATER, 1, NULL);
-        xTaskCreate(StratumManager::taskWrapper, "stratum manager", 8192, (void *) STRATUM_MANAGER, 5, NULL);
+        task_create(TASK_CREATE_JOBS, create_jobs_task, NULL);
+        task_create(TASK_ASIC_RESULT, ASIC_result_task, NULL);
+        task_create(TASK_INFLUX, influx_task, NULL);
+        task_create(TASK_APIS, APIs_FETCHER.taskWrapper, (void *) &APIs_FETCHER);
+        task_create(TASK_WIFI_MONITOR, wifi_monitor_task, NULL);
+        task_create(TASK_OTA, FACTORY_OTA_UPDATER.taskWrapper, (void *) &FACTORY_OTA_UPDATER);
+        task_create(TASK_STRATUM_MANAGER, StratumManager::taskWrapper, (void *) STRATUM_MANAGER);
 
         if (board->hasHashrateCounter()) {
             HASHRATE_MONITOR.start(board, board->getAsics());
@@ -331,7 +328,6 @@ extern "C" void app_main(void)
         if (free_internal_heap < 10000) {
             ESP_LOGW(TAG, "*** WARNING *** Free internal heap: %d bytes", free_internal_heap);
         }
-        // monitor_all_task_watermarks();
     }
 }
 
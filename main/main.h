@@ -13,5 +13,3 @@ extern "C"
 #ifdef __cplusplus
 }
 #endif
-
-void self_test(void *pvParameters);
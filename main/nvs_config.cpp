@@ -4,8 +4,6 @@
 #include "nvs.h"
 #include "nvs_config.h"
 
-#define NVS_CONFIG_NAMESPACE "main"
-
 namespace Config
 {
 
@@ -43,6 +41,9 @@ char *nvs_config_get_string(const char *key, const char *default_value)
 
 void nvs_config_set_string(const char *key, const char *value)
 {
+    if (nvs_config_txn_stage(key, TXN_STR, 0, value)) {
+        return;
+    }
 
     nvs_handle handle;
     esp_err_t err;
@@ -81,6 +82,9 @@ uint16_t nvs_config_get_u16(const char *key, const uint16_t default_value)
 
 void nvs_config_set_u16(const char *key, const uint16_t value)
 {
+    if (nvs_config_txn_stage(key, TXN_U16, value, nullptr)) {
+        return;
+    }
 
     nvs_handle handle;
     esp_err_t err;
@@ -121,6 +125,9 @@ uint64_t nvs_config_get_u64(const char *key, const uint64_t default_value)
 
 void nvs_config_set_u64(const char *key, const uint64_t value)
 {
+    if (nvs_config_txn_stage(key, TXN_U64, value, nullptr)) {
+        return;
+    }
 
     nvs_handle handle;
     esp_err_t err;
@@ -139,6 +146,9 @@ void nvs_config_set_u64(const char *key, const uint64_t value)
 
 void migrate_config()
 {
+    // complete settings that were saved when the power was lost
+    nvs_config_recover();
+
     // overwrite previously allowed 0 value to disable
     // over-temp shutdown
     uint16_t asic_overheat_temp = Config::getOverheatTemp();
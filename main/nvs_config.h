@@ -14,14 +14,17 @@
 #define NVS_CONFIG_STRATUM_PASS "stratumpass"
 #define NVS_CONFIG_STRATUM_ENONCE_SUB "stratumesub"
 #define NVS_CONFIG_STRATUM_TLS "stratumtls"
+#define NVS_CONFIG_STRATUM_TLS_CERT "stratumcert"
 #define NVS_CONFIG_STRATUM_FALLBACK_URL "fbstratumurl"
 #define NVS_CONFIG_STRATUM_FALLBACK_PORT "fbstratumport"
 #define NVS_CONFIG_STRATUM_FALLBACK_USER "fbstratumuser"
 #define NVS_CONFIG_STRATUM_FALLBACK_PASS "fbstratumpass"
 #define NVS_CONFIG_STRATUM_FALLBACK_ENONCE_SUB "fbstratumesub"
 #define NVS_CONFIG_STRATUM_FALLBACK_TLS "fbstratumtls"
+#define NVS_CONFIG_STRATUM_FALLBACK_TLS_CERT "fbstratumcert"
 #define NVS_CONFIG_STRATUM_DIFFICULTY "stratumdiff"
 #define NVS_CONFIG_STRATUM_KEEPALIVE "stratum_keep"
+#define NVS_CONFIG_SHARE_INTERVAL "shareinterval"
 
 #define NVS_CONFIG_ASIC_FREQ "asicfrequency"
 #define NVS_CONFIG_ASIC_VOLTAGE "asicvoltage"
@@ -34,8 +37,18 @@
 #define NVS_CONFIG_AUTO_FAN_SPEED "autofanspeed"
 #define NVS_CONFIG_FAN_SPEED "fanspeed"
 #define NVS_CONFIG_SELF_TEST "selftest"
+#define NVS_CONFIG_SELF_TEST_FIELD "selftest_field"
+#define NVS_CONFIG_SELF_TEST_REPORT "selftest_rep"
 #define NVS_CONFIG_AUTO_SCREEN_OFF "autoscreenoff"
 #define NVS_CONFIG_OVERHEAT_TEMP "overheat_temp"
+#define NVS_CONFIG_FAN_MAX_RPM "fan_max_rpm"
+#define NVS_CONFIG_FAN_CURVE_0 "fan_curve0"
+#define NVS_CONFIG_FAN_CURVE_1 "fan_curve1"
+#define NVS_CONFIG_CHIP_BALANCE "chip_balance"
+#define NVS_CONFIG_CHIP_BOOST "chip_boost"
+#define NVS_CONFIG_AMBIENT_TEMP "ambient_temp"
+#define NVS_CONFIG_TEMP_CAL_TMUX "tcal_tmux"
+#define NVS_CONFIG_TEMP_CAL_TMP1075 "tcal_tmp1075"
 
 #define NVS_CONFIG_INFLUX_ENABLE "influx_enable"
 #define NVS_CONFIG_INFLUX_URL "influx_url"
@@ -54,6 +67,8 @@
 #define NVS_CONFIG_ALERT_DISCORD_URL    "alrt_disc_url"
 #define NVS_CONFIG_ALERT_DISCORD_BLOCK_FOUND_ENABLE "alrt_disc_bf_en"
 #define NVS_CONFIG_ALERT_DISCORD_BEST_DIFF "alrt_disc_bd_en"
+#define NVS_CONFIG_ALERT_TARGETS "alrt_targets"      // additional webhooks (JSON)
+#define NVS_CONFIG_ALERT_QUEUE "alrt_queue"          // undelivered alerts (JSON)
 
 #define NVS_CONFIG_SHOW_BLOCK_FOUND_ENABLE "block_found_en"
 
@@ -64,6 +79,7 @@
 // device global stats
 #define NVS_TOTAL_FOUND_BLOCKS "totalblocks"
 #define NVS_CONFIG_BEST_DIFF "bestdiff"
+#define NVS_CONFIG_SOLO_STATS "solostats"
 
 
 // OTP
@@ -77,6 +93,28 @@
 #define NVS_CONFIG_POOL_MODE_BALANCE "pool_balance"
 #define NVS_CONFIG_POOL_MODE "pool_mode"
 
+// pools 3 and 4, pools 1 and 2 use the stratum keys above
+#define NVS_CONFIG_POOL3_URL "pool3url"
+#define NVS_CONFIG_POOL3_PORT "pool3port"
+#define NVS_CONFIG_POOL3_USER "pool3user"
+#define NVS_CONFIG_POOL3_PASS "pool3pass"
+#define NVS_CONFIG_POOL3_ENONCE_SUB "pool3esub"
+#define NVS_CONFIG_POOL3_TLS "pool3tls"
+#define NVS_CONFIG_POOL3_TLS_CERT "pool3cert"
+#define NVS_CONFIG_POOL4_URL "pool4url"
+#define NVS_CONFIG_POOL4_PORT "pool4port"
+#define NVS_CONFIG_POOL4_USER "pool4user"
+#define NVS_CONFIG_POOL4_PASS "pool4pass"
+#define NVS_CONFIG_POOL4_ENONCE_SUB "pool4esub"
+#define NVS_CONFIG_POOL4_TLS "pool4tls"
+#define NVS_CONFIG_POOL4_TLS_CERT "pool4cert"
+
+// weighted mode, pools 1 and 2 default to the pool balance
+#define NVS_CONFIG_POOL1_WEIGHT "pool1weight"
+#define NVS_CONFIG_POOL2_WEIGHT "pool2weight"
+#define NVS_CONFIG_POOL3_WEIGHT "pool3weight"
+#define NVS_CONFIG_POOL4_WEIGHT "pool4weight"
+
 #if defined(CONFIG_FAN_MODE_MANUAL)
 #define CONFIG_AUTO_FAN_SPEED_VALUE 0
 #elif defined(CONFIG_FAN_MODE_CLASSIC)
@@ -93,6 +131,8 @@
 
 #include <stdint.h>
 
+#include "nvs_config_txn.h"
+
 namespace Config {
     char* nvs_config_get_string(const char* key, const char* default_value);
     void nvs_config_set_string(const char* key, const char* value);
@@ -101,6 +141,7 @@ namespace Config {
     uint64_t nvs_config_get_u64(const char* key, uint64_t default_value);
     void nvs_config_set_u64(const char* key, uint64_t value);
 
+
     // ---- String Getters ----
     inline char* getWifiSSID() { return nvs_config_get_string(NVS_CONFIG_WIFI_SSID, CONFIG_ESP_WIFI_SSID); }
     inline char* getWifiPass() { return nvs_config_get_string(NVS_CONFIG_WIFI_PASS, CONFIG_ESP_WIFI_PASSWORD); }
@@ -111,6 +152,8 @@ namespace Config {
     inline char* getStratumFallbackURL() { return nvs_config_get_string(NVS_CONFIG_STRATUM_FALLBACK_URL, CONFIG_STRATUM_FALLBACK_URL); }
     inline char* getStratumFallbackUser() { return nvs_config_get_string(NVS_CONFIG_STRATUM_FALLBACK_USER, CONFIG_STRATUM_FALLBACK_USER); }
     inline char* getStratumFallbackPass() { return nvs_config_get_string(NVS_CONFIG_STRATUM_FALLBACK_PASS, CONFIG_STRATUM_FALLBACK_PW); }
+    inline char* getStratumTLSCert() { return nvs_config_get_string(NVS_CONFIG_STRATUM_TLS_CERT, ""); }
+    inline char* getStratumFallbackTLSCert() { return nvs_config_get_string(NVS_CONFIG_STRATUM_FALLBACK_TLS_CERT, ""); }
     inline char* getInfluxURL() { return nvs_config_get_string(NVS_CONFIG_INFLUX_URL, CONFIG_INFLUX_URL); }
     inline char* getInfluxToken() { return nvs_config_get_string(NVS_CONFIG_INFLUX_TOKEN, CONFIG_INFLUX_TOKEN); }
     inline char* getInfluxBucket() { return nvs_config_get_string(NVS_CONFIG_INFLUX_BUCKET, CONFIG_INFLUX_BUCKET); }
@@ -118,6 +161,12 @@ namespace Config {
     inline char* getInfluxPrefix() { return nvs_config_get_string(NVS_CONFIG_INFLUX_PREFIX, CONFIG_INFLUX_PREFIX); }
     inline char* getSwarmConfig() { return nvs_config_get_string(NVS_CONFIG_SWARM, ""); }
     inline char* getDiscordWebhook() { return nvs_config_get_string(NVS_CONFIG_ALERT_DISCORD_URL, CONFIG_ALERT_DISCORD_URL); }
+    inline char* getAlertTargets() { return nvs_config_get_string(NVS_CONFIG_ALERT_TARGETS, "[]"); }
+    inline char* getAlertQueue() { return nvs_config_get_string(NVS_CONFIG_ALERT_QUEUE, ""); }
+    inline char* getTempCalibration(const char* key) { return nvs_config_get_string(key, ""); }
+    inline char* getSelfTestReport() { return nvs_config_get_string(NVS_CONFIG_SELF_TEST_REPORT, ""); }
+    inline char* getFanCurve(int ch) { return nvs_config_get_string(ch ? NVS_CONFIG_FAN_CURVE_1 : NVS_CONFIG_FAN_CURVE_0, ""); }
+    inline char* getSoloStats() { return nvs_config_get_string(NVS_CONFIG_SOLO_STATS, ""); }
 
     // ---- String Setters ----
     inline void setWifiSSID(const char* value) { nvs_config_set_string(NVS_CONFIG_WIFI_SSID, value); }
@@ -129,6 +178,8 @@ namespace Config {
     inline void setStratumFallbackURL(const char* value) { nvs_config_set_string(NVS_CONFIG_STRATUM_FALLBACK_URL, value); }
     inline void setStratumFallbackUser(const char* value) { nvs_config_set_string(NVS_CONFIG_STRATUM_FALLBACK_USER, value); }
     inline void setStratumFallbackPass(const char* value) { nvs_config_set_string(NVS_CONFIG_STRATUM_FALLBACK_PASS, value); }
+    inline void setStratumTLSCert(const char* value) { nvs_config_set_string(NVS_CONFIG_STRATUM_TLS_CERT, value); }
+    inline void setStratumFallbackTLSCert(const char* value) { nvs_config_set_string(NVS_CONFIG_STRATUM_FALLBACK_TLS_CERT, value); }
     inline void setInfluxURL(const char* value) { nvs_config_set_string(NVS_CONFIG_INFLUX_URL, value); }
     inline void setInfluxToken(const char* value) { nvs_config_set_string(NVS_CONFIG_INFLUX_TOKEN, value); }
     inline void setInfluxBucket(const char* value) { nvs_config_set_string(NVS_CONFIG_INFLUX_BUCKET, value); }
@@ -136,6 +187,12 @@ namespace Config {
     inline void setInfluxPrefix(const char* value) { nvs_config_set_string(NVS_CONFIG_INFLUX_PREFIX, value); }
     inline void setSwarmConfig(const char* value) { nvs_config_set_string(NVS_CONFIG_SWARM, value); }
     inline void setDiscordWebhook(const char* value) { nvs_config_set_string(NVS_CONFIG_ALERT_DISCORD_URL, value); }
+    inline void setAlertTargets(const char* value) { nvs_config_set_string(NVS_CONFIG_ALERT_TARGETS, value); }
+    inline void setAlertQueue(const char* value) { nvs_config_set_string(NVS_CONFIG_ALERT_QUEUE, value); }
+    inline void setTempCalibration(const char* key, const char* value) { nvs_config_set_string(key, value); }
+    inline void setSelfTestReport(const char* value) { nvs_config_set_string(NVS_CONFIG_SELF_TEST_REPORT, value); }
+    inline void setSoloStats(const char* value) { nvs_config_set_string(NVS_CONFIG_SOLO_STATS, value); }
+    inline void setFanCurve(int ch, const char* value) { nvs_config_set_string(ch ? NVS_CONFIG_FAN_CURVE_1 : NVS_CONFIG_FAN_CURVE_0, value); }
 
     // ---- uint16_t Getters ----
     inline uint16_t getStratumPortNumber() { return nvs_config_get_u16(NVS_CONFIG_STRATUM_PORT, CONFIG_STRATUM_PORT); }
@@ -143,9 +200,13 @@ namespace Config {
     inline uint16_t getFanSpeed() { return nvs_config_get_u16(NVS_CONFIG_FAN_SPEED, CONFIG_FAN_SPEED); }
     inline uint16_t getOverheatTemp() { return nvs_config_get_u16(NVS_CONFIG_OVERHEAT_TEMP, CONFIG_OVERHEAT_TEMP); }
     inline uint16_t getInfluxPort() { return nvs_config_get_u16(NVS_CONFIG_INFLUX_PORT, CONFIG_INFLUX_PORT); }
+    inline uint16_t getFanMaxRPM() { return nvs_config_get_u16(NVS_CONFIG_FAN_MAX_RPM, 0); }
+    inline uint16_t getChipBoost() { return nvs_config_get_u16(NVS_CONFIG_CHIP_BOOST, 0); }
+    inline uint16_t getAmbientTemp() { return nvs_config_get_u16(NVS_CONFIG_AMBIENT_TEMP, 25); }
     inline uint16_t getTempControlMode() { return nvs_config_get_u16(NVS_CONFIG_AUTO_FAN_SPEED, CONFIG_AUTO_FAN_SPEED_VALUE); }
     inline uint16_t getPoolMode() { return nvs_config_get_u16(NVS_CONFIG_POOL_MODE, 0); }
     inline uint16_t getPoolBalance() { return nvs_config_get_u16(NVS_CONFIG_POOL_MODE_BALANCE, 50); }
+    inline uint16_t getShareInterval() { return nvs_config_get_u16(NVS_CONFIG_SHARE_INTERVAL, 0); }
 
     // ---- uint16_t Setters ----
     inline void setAsicFrequency(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_ASIC_FREQ, value); }
@@ -156,9 +217,41 @@ namespace Config {
     inline void setFanSpeed(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_FAN_SPEED, value); }
     inline void setOverheatTemp(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_OVERHEAT_TEMP, value); }
     inline void setInfluxPort(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_INFLUX_PORT, value); }
+    inline void setFanMaxRPM(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_FAN_MAX_RPM, value); }
+    inline void setChipBoost(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_CHIP_BOOST, value); }
+    inline void setAmbientTemp(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_AMBIENT_TEMP, value); }
     inline void setTempControlMode(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_AUTO_FAN_SPEED, value); }
     inline void setPoolMode(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_POOL_MODE, value); }
     inline void setPoolBalance(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_POOL_MODE_BALANCE, value); }
+    inline void setShareInterval(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_SHARE_INTERVAL, value); }
+
+    // ---- pools 3 and 4 (pool index 2 and 3) ----
+    inline char* getExtraPoolURL(int pool) { return nvs_config_get_string(pool == 2 ? NVS_CONFIG_POOL3_URL : NVS_CONFIG_POOL4_URL, ""); }
+    inline char* getExtraPoolUser(int pool) { return nvs_config_get_string(pool == 2 ? NVS_CONFIG_POOL3_USER : NVS_CONFIG_POOL4_USER, ""); }
+    inline char* getExtraPoolPass(int pool) { return nvs_config_get_string(pool == 2 ? NVS_CONFIG_POOL3_PASS : NVS_CONFIG_POOL4_PASS, ""); }
+    inline char* getExtraPoolTLSCert(int pool) { return nvs_config_get_string(pool == 2 ? NVS_CONFIG_POOL3_TLS_CERT : NVS_CONFIG_POOL4_TLS_CERT, ""); }
+    inline uint16_t getExtraPoolPortNumber(int pool) { return nvs_config_get_u16(pool == 2 ? NVS_CONFIG_POOL3_PORT : NVS_CONFIG_POOL4_PORT, 3333); }
+    inline bool isExtraPoolEnonceSubscribe(int pool) { return nvs_config_get_u16(pool == 2 ? NVS_CONFIG_POOL3_ENONCE_SUB : NVS_CONFIG_POOL4_ENONCE_SUB, 0) != 0; }
+    inline bool isExtraPoolTLS(int pool) { return nvs_config_get_u16(pool == 2 ? NVS_CONFIG_POOL3_TLS : NVS_CONFIG_POOL4_TLS, 0) != 0; }
+
+    inline void setExtraPoolURL(int pool, const char* value) { nvs_config_set_string(pool == 2 ? NVS_CONFIG_POOL3_URL : NVS_CONFIG_POOL4_URL, value); }
+    inline void setExtraPoolUser(int pool, const char* value) { nvs_config_set_string(pool == 2 ? NVS_CONFIG_POOL3_USER : NVS_CONFIG_POOL4_USER, value); }
+    inline void setExtraPoolPass(int pool, const char* value) { nvs_config_set_string(pool == 2 ? NVS_CONFIG_POOL3_PASS : NVS_CONFIG_POOL4_PASS, value); }
+    inline void setExtraPoolTLSCert(int pool, const char* value) { nvs_config_set_string(pool == 2 ? NVS_CONFIG_POOL3_TLS_CERT : NVS_CONFIG_POOL4_TLS_CERT, value); }
+    inline void setExtraPoolPortNumber(int pool, uint16_t value) { nvs_config_set_u16(pool == 2 ? NVS_CONFIG_POOL3_PORT : NVS_CONFIG_POOL4_PORT, value); }
+    inline void setExtraPoolEnonceSubscribe(int pool, bool value) { nvs_config_set_u16(pool == 2 ? NVS_CONFIG_POOL3_ENONCE_SUB : NVS_CONFIG_POOL4_ENONCE_SUB, value ? 1 : 0); }
+    inline void setExtraPoolTLS(int pool, bool value) { nvs_config_set_u16(pool == 2 ? NVS_CONFIG_POOL3_TLS : NVS_CONFIG_POOL4_TLS, value ? 1 : 0); }
+
+    // ---- pool weights (pool index 0..3) ----
+    inline const char* poolWeightKey(int pool) {
+        static const char* const keys[] = {NVS_CONFIG_POOL1_WEIGHT, NVS_CONFIG_POOL2_WEIGHT, NVS_CONFIG_POOL3_WEIGHT, NVS_CONFIG_POOL4_WEIGHT};
+        return keys[pool & 3];
+    }
+    inline uint16_t getPoolWeight(int pool) {
+        uint16_t balance = getPoolBalance();
+        return nvs_config_get_u16(poolWeightKey(pool), pool == 0 ? balance : (pool == 1 ? 100 - balance : 0));
+    }
+    inline void setPoolWeight(int pool, uint16_t value) { nvs_config_set_u16(poolWeightKey(pool), value); }
 
     inline void setPidTargetTemp(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_PID_TARGET_TEMP, value); }
     inline void setPidP(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_PID_P, value); }
@@ -179,6 +272,7 @@ namespace Config {
     // ---- Boolean Getters (Stored as uint16_t but used as bool) ----
     inline bool isInvertScreenEnabled() { return nvs_config_get_u16(NVS_CONFIG_INVERT_SCREEN, 0) != 0; } // todo unused?
     inline bool isSelfTestEnabled() { return nvs_config_get_u16(NVS_CONFIG_SELF_TEST, 0) != 0; }
+    inline bool isSelfTestField() { return nvs_config_get_u16(NVS_CONFIG_SELF_TEST_FIELD, 0) != 0; }
     inline bool isAutoScreenOffEnabled() { return nvs_config_get_u16(NVS_CONFIG_AUTO_SCREEN_OFF, CONFIG_AUTO_SCREEN_OFF_VALUE) != 0; }
     inline bool isInfluxEnabled() { return nvs_config_get_u16(NVS_CONFIG_INFLUX_ENABLE, CONFIG_INFLUX_ENABLE_VALUE) != 0; }
     inline bool isDiscordWatchdogAlertEnabled() { return nvs_config_get_u16(NVS_CONFIG_ALERT_DISCORD_WATCHDOG_ENABLE, CONFIG_ALERT_DISCORD_WATCHDOG_ENABLE_VALUE) != 0; }
@@ -189,6 +283,7 @@ namespace Config {
     inline bool isStratumFallbackEnonceSubscribe() { return nvs_config_get_u16(NVS_CONFIG_STRATUM_FALLBACK_ENONCE_SUB, CONFIG_STRATUM_FALLBACK_ENONCE_SUBSCRIBE_VALUE) != 0; }
     inline bool isStratumTLS() { return nvs_config_get_u16(NVS_CONFIG_STRATUM_TLS, CONFIG_STRATUM_TLS_VALUE) != 0; }
     inline bool isStratumFallbackTLS() { return nvs_config_get_u16(NVS_CONFIG_STRATUM_FALLBACK_TLS, CONFIG_STRATUM_FALLBACK_TLS_VALUE) != 0; }
+    inline bool isChipBalanceEnabled() { return nvs_config_get_u16(NVS_CONFIG_CHIP_BALANCE, 0) != 0; }
     inline bool isShowBlockFoundEnabled() { return nvs_config_get_u16(NVS_CONFIG_SHOW_BLOCK_FOUND_ENABLE, CONFIG_SHOW_BLOCK_FOUND_ENABLE_VALUE) != 0; }
 
     // ---- Boolean Setters ----
@@ -196,6 +291,7 @@ namespace Config {
     inline void setInvertScreen(bool value) { nvs_config_set_u16(NVS_CONFIG_INVERT_SCREEN, value ? 1 : 0); }
     inline void setFanPolarity(bool value) { nvs_config_set_u16(NVS_CONFIG_FAN_PWM_POLARITY, value ? 1 : 0); }
     inline void setSelfTest(bool value) { nvs_config_set_u16(NVS_CONFIG_SELF_TEST, value ? 1 : 0); }
+    inline void setSelfTestField(bool value) { nvs_config_set_u16(NVS_CONFIG_SELF_TEST_FIELD, value ? 1 : 0); }
     inline void setAutoScreenOff(bool value) { nvs_config_set_u16(NVS_CONFIG_AUTO_SCREEN_OFF, value ? 1 : 0); }
     inline void setInfluxEnabled(bool value) { nvs_config_set_u16(NVS_CONFIG_INFLUX_ENABLE, value ? 1 : 0); }
     inline void setDiscordWatchdogAlertEnabled(bool value) { nvs_config_set_u16(NVS_CONFIG_ALERT_DISCORD_WATCHDOG_ENABLE, value ? 1 : 0); }
@@ -206,6 +302,7 @@ namespace Config {
     inline void setStratumFallbackEnonceSubscribe(bool value) { nvs_config_set_u16(NVS_CONFIG_STRATUM_FALLBACK_ENONCE_SUB, value ? 1 : 0); }
     inline void setStratumTLS(bool value) { nvs_config_set_u16(NVS_CONFIG_STRATUM_TLS, value ? 1 : 0); }
     inline void setStratumFallbackTLS(bool value) { nvs_config_set_u16(NVS_CONFIG_STRATUM_FALLBACK_TLS, value ? 1 : 0); }
+    inline void setChipBalanceEnabled(bool value) { nvs_config_set_u16(NVS_CONFIG_CHIP_BALANCE, value ? 1 : 0); }
     inline void setShowBlockFoundEnabled(bool value) { nvs_config_set_u16(NVS_CONFIG_SHOW_BLOCK_FOUND_ENABLE, value ? 1 : 0); }
 
     // with board specific default values
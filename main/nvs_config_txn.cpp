@@ -0,0 +1,362 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+
+#include "nvs_config_txn.h"
+
+namespace Config
+{
+
+static const char *TAG = "nvs_config";
+
+// held for the whole transaction, one at a time
+static pthread_mutex_t s_txnMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// open transaction and the task that owns it, the setters of all tasks
+// read them
+static pthread_mutex_t s_ownerMutex = PTHREAD_MUTEX_INITIALIZER;
+static Transaction *s_txn = nullptr;
+static TaskHandle_t s_txnOwner = nullptr;
+
+static void set_owner(Transaction *txn, TaskHandle_t owner)
+{
+    pthread_mutex_lock(&s_ownerMutex);
+    s_txn = txn;
+    s_txnOwner = owner;
+    pthread_mutex_unlock(&s_ownerMutex);
+}
+
+// setters of the task with the open transaction are staged
+bool nvs_config_txn_stage(const char *key, uint8_t type, uint64_t num, const char *str)
+{
+    pthread_mutex_lock(&s_ownerMutex);
+    bool staged = s_txn && s_txnOwner == xTaskGetCurrentTaskHandle() && s_txn->stage(key, type, num, str);
+    pthread_mutex_unlock(&s_ownerMutex);
+    return staged;
+}
+
+// journal record: u8 type, u8 key length, key, u16 value length, value
+// (u16/u64 little endian, strings with terminating zero)
+
+static size_t journal_record_size(const char *key, uint8_t type, const char *str)
+{
+    size_t vlen = (type == TXN_STR) ? strlen(str) + 1 : (type == TXN_U16) ? 2 : 8;
+    return 1 + 1 + strlen(key) + 2 + vlen;
+}
+
+static uint8_t *journal_put(uint8_t *p, const char *key, uint8_t type, uint64_t num, const char *str)
+{
+    size_t klen = strlen(key);
+    size_t vlen = (type == TXN_STR) ? strlen(str) + 1 : (type == TXN_U16) ? 2 : 8;
+
+    *p++ = type;
+    *p++ = (uint8_t) klen;
+    memcpy(p, key, klen);
+    p += klen;
+    *p++ = (uint8_t) (vlen & 0xff);
+    *p++ = (uint8_t) (vlen >> 8);
+    if (type == TXN_STR) {
+        memcpy(p, str, vlen);
+    } else {
+        for (size_t i = 0; i < vlen; i++) {
+            p[i] = (uint8_t) (num >> (8 * i));
+        }
+    }
+    return p + vlen;
+}
+
+// writes all records of the journal, doesn't commit
+static esp_err_t journal_apply(nvs_handle handle, const uint8_t *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    const uint8_t *end = buf + len;
+
+    while (p < end) {
+        if (end - p < 4) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        uint8_t type = p[0];
+        size_t klen = p[1];
+        if (klen == 0 || klen > 15 || (size_t) (end - p) < 4 + klen) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        char key[16];
+        memcpy(key, p + 2, klen);
+        key[klen] = 0;
+        p += 2 + klen;
+
+        size_t vlen = p[0] | (p[1] << 8);
+        p += 2;
+        if ((size_t) (end - p) < vlen) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        uint64_t num = 0;
+        for (size_t i = 0; type != TXN_STR && i < vlen && i < 8; i++) {
+            num |= (uint64_t) p[i] << (8 * i);
+        }
+
+        esp_err_t err;
+        switch (type) {
+        case TXN_STR:
+            if (!vlen || p[vlen - 1] != 0) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            err = nvs_set_str(handle, key, (const char *) p);
+            break;
+        case TXN_U16:
+            err = nvs_set_u16(handle, key, (uint16_t) num);
+            break;
+        case TXN_U64:
+            err = nvs_set_u64(handle, key, num);
+            break;
+        default:
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Could not write nvs key: %s (%s)", key, esp_err_to_name(err));
+            return err;
+        }
+        p += vlen;
+    }
+    return ESP_OK;
+}
+
+// compares the staged value with the stored one
+static bool value_differs(nvs_handle handle, const char *key, uint8_t type, uint64_t num, const char *str)
+{
+    switch (type) {
+    case TXN_STR: {
+        size_t size = 0;
+        if (nvs_get_str(handle, key, NULL, &size) != ESP_OK || size != strlen(str) + 1) {
+            return true;
+        }
+        char *stored = (char *) malloc(size);
+        if (!stored) {
+            return true;
+        }
+        bool differs = nvs_get_str(handle, key, stored, &size) != ESP_OK || strcmp(stored, str) != 0;
+        free(stored);
+        return differs;
+    }
+    case TXN_U16: {
+        uint16_t stored;
+        return nvs_get_u16(handle, key, &stored) != ESP_OK || stored != (uint16_t) num;
+    }
+    case TXN_U64: {
+        uint64_t stored;
+        return nvs_get_u64(handle, key, &stored) != ESP_OK || stored != num;
+    }
+    }
+    return true;
+}
+
+Transaction::Transaction()
+{
+    pthread_mutex_lock(&s_txnMutex);
+    m_entries = (Entry *) calloc(NVS_CONFIG_TXN_MAX, sizeof(Entry));
+    if (!m_entries) {
+        ESP_LOGE(TAG, "no memory for settings transaction");
+        m_overflow = true;
+    }
+    set_owner(this, xTaskGetCurrentTaskHandle());
+}
+
+Transaction::~Transaction()
+{
+    set_owner(nullptr, nullptr);
+    if (m_entries) {
+        for (int i = 0; i < m_numEntries; i++) {
+            free(m_entries[i].str);
+        }
+        free(m_entries);
+    }
+    pthread_mutex_unlock(&s_txnMutex);
+}
+
+bool Transaction::stage(const char *key, uint8_t type, uint64_t num, const char *str)
+{
+    // a failed transaction swallows the setters, nothing of it is written
+    if (m_done || m_overflow) {
+        return true;
+    }
+
+    if (strlen(key) > 15 || (type == TXN_STR && !str)) {
+        ESP_LOGE(TAG, "invalid value for key %s", key);
+        m_overflow = true;
+        return true;
+    }
+
+    // the last value of a key wins
+    Entry *e = nullptr;
+    for (int i = 0; i < m_numEntries; i++) {
+        if (!strcmp(m_entries[i].key, key)) {
+            e = &m_entries[i];
+            break;
+        }
+    }
+    if (!e) {
+        if (m_numEntries >= NVS_CONFIG_TXN_MAX) {
+            ESP_LOGE(TAG, "too many values in settings transaction");
+            m_overflow = true;
+            return true;
+        }
+        e = &m_entries[m_numEntries++];
+        strcpy(e->key, key);
+    }
+
+    free(e->str);
+    e->str = nullptr;
+    e->type = type;
+    e->num = num;
+    if (type == TXN_STR) {
+        e->str = strdup(str);
+        if (!e->str) {
+            m_overflow = true;
+        }
+    }
+    return true;
+}
+
+bool Transaction::commit()
+{
+    if (m_done) {
+        return false;
+    }
+    m_done = true;
+    set_owner(nullptr, nullptr);
+
+    if (m_overflow) {
+        return false;
+    }
+
+    nvs_handle handle;
+    esp_err_t err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Could not open nvs");
+        return false;
+    }
+
+    // only values that differ from the stored ones are written
+    size_t len = 0;
+    for (int i = 0; i < m_numEntries; i++) {
+        Entry *e = &m_entries[i];
+        e->changed = value_differs(handle, e->key, e->type, e->num, e->str);
+        if (e->changed) {
+            m_numChanged++;
+            len += journal_record_size(e->key, e->type, e->str);
+        }
+    }
+
+    if (!m_numChanged) {
+        nvs_close(handle);
+        return true;
+    }
+
+    uint8_t *journal = (uint8_t *) malloc(len);
+    if (!journal) {
+        ESP_LOGE(TAG, "no memory for settings journal");
+        nvs_close(handle);
+        m_numChanged = 0;
+        return false;
+    }
+
+    uint8_t *p = journal;
+    for (int i = 0; i < m_numEntries; i++) {
+        Entry *e = &m_entries[i];
+        if (e->changed) {
+            p = journal_put(p, e->key, e->type, e->num, e->str);
+        }
+    }
+
+    // 1) journal, from here on the batch is completed even after a reset
+    err = nvs_set_blob(handle, NVS_CONFIG_JOURNAL, journal, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+
+    // 2) values
+    if (err == ESP_OK) {
+        err = journal_apply(handle, journal, len);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+
+    // 3) done
+    if (err == ESP_OK) {
+        err = nvs_erase_key(handle, NVS_CONFIG_JOURNAL);
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+    }
+
+    free(journal);
+    nvs_close(handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "settings transaction failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    ESP_LOGI(TAG, "%d of %d settings changed", m_numChanged, m_numEntries);
+    return true;
+}
+
+bool Transaction::changed(const char *key)
+{
+    for (int i = 0; i < m_numEntries; i++) {
+        if (m_entries[i].changed && !strcmp(m_entries[i].key, key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Transaction::changedAny(const char *const *keys)
+{
+    for (; *keys; keys++) {
+        if (changed(*keys)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void nvs_config_recover()
+{
+    nvs_handle handle;
+    if (nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+
+    size_t len = 0;
+    if (nvs_get_blob(handle, NVS_CONFIG_JOURNAL, NULL, &len) != ESP_OK || !len) {
+        nvs_close(handle);
+        return;
+    }
+
+    ESP_LOGW(TAG, "completing interrupted settings transaction");
+
+    uint8_t *journal = (uint8_t *) malloc(len);
+    esp_err_t err = journal ? nvs_get_blob(handle, NVS_CONFIG_JOURNAL, journal, &len) : ESP_ERR_NO_MEM;
+    if (err == ESP_OK) {
+        err = journal_apply(handle, journal, len);
+    }
+    if (err != ESP_OK) {
+        // a broken journal can't be completed, drop it
+        ESP_LOGE(TAG, "settings journal invalid: %s", esp_err_to_name(err));
+    }
+    nvs_erase_key(handle, NVS_CONFIG_JOURNAL);
+    nvs_commit(handle);
+
+    free(journal);
+    nvs_close(handle);
+}
+
+} // namespace Config
@@ -0,0 +1,74 @@
+#pragma once
+
+// clang-format off
+
+#include <stdint.h>
+
+#define NVS_CONFIG_NAMESPACE "main"
+
+// pending settings transaction, see Config::Transaction
+#define NVS_CONFIG_JOURNAL "cfg_journal"
+
+// max number of staged values of a transaction
+#define NVS_CONFIG_TXN_MAX 64
+
+// value types of the staged values and the journal records
+enum
+{
+    TXN_STR = 1,
+    TXN_U16,
+    TXN_U64,
+};
+
+// Settings transactions of nvs_config.cpp, no dependencies on the config
+// defaults (see host/nvs_txn_sim.cpp).
+namespace Config {
+
+// Batches all Config setters of the calling task until commit().
+// Only one transaction can be open at a time, setters of other tasks
+// are written directly. Getters return the stored values until commit.
+//
+// commit() skips values that didn't change and writes the rest with a
+// single NVS handle. The batch is first stored as a journal blob so a
+// power loss in the middle of it is completed on the next boot
+// (nvs_config_recover).
+class Transaction {
+  protected:
+    struct Entry
+    {
+        char key[16];   // NVS keys have max 15 chars
+        uint8_t type;
+        uint64_t num;
+        char* str;
+        bool changed;
+    };
+
+    Entry* m_entries = nullptr;
+    int m_numEntries = 0;
+    int m_numChanged = 0;
+    bool m_overflow = false;
+    bool m_done = false;
+
+  public:
+    Transaction();
+    ~Transaction(); // discards the staged values if not committed
+
+    bool commit();
+
+    // after commit: was the key written?
+    bool changed(const char* key);
+    // nullptr terminated list of keys
+    bool changedAny(const char* const* keys);
+    int numChanged() { return m_numChanged; }
+
+    // used by the setters
+    bool stage(const char* key, uint8_t type, uint64_t num, const char* str);
+};
+
+// completes a transaction that was interrupted by a reset
+void nvs_config_recover();
+
+// stages the value if the calling task has the open transaction
+bool nvs_config_txn_stage(const char* key, uint8_t type, uint64_t num, const char* str);
+
+} // namespace Config
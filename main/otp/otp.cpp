@@ -15,6 +15,7 @@
 #include "global_state.h"
 #include "macros.h"
 #include "otp.h"
+#include "totp.h"
 
 /*** RFC4648 Base32 (uppercase, no padding) ***/
 static const char B32_ALPH[33] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
@@ -31,25 +32,6 @@ struct SessionPayload
 };
 #pragma pack(pop)
 
-
-bool OTP::parse_otp6(const std::string &s, uint32_t &out)
-{
-    // Accept exactly 6 digits (ignore spaces)
-    out = 0;
-    int cnt = 0;
-    for (char c : s) {
-        if (c == ' ')
-            continue;
-        if (!std::isdigit((unsigned char) c))
-            return false;
-        out = out * 10u + (uint32_t) (c - '0');
-        ++cnt;
-        if (cnt > 6)
-            return false;
-    }
-    return cnt == 6;
-}
-
 /*** Base32 (RFC4648, uppercase, no padding) decode; returns bytes written or 0 on error ***/
 size_t OTP::base32_decode(const char *in, size_t inlen, uint8_t *out, size_t outcap)
 {
@@ -109,63 +91,21 @@ bool OTP::hmac_sha256(const uint8_t *key, size_t keylen, const uint8_t *msg, siz
     return mbedtls_md_hmac(info, key, keylen, msg, mlen, mac32) == 0;
 }
 
-/*** HOTP (RFC4226) using HMAC-SHA1 ***/
-bool OTP::hotp_sha1(const uint8_t *key, size_t keylen, uint64_t counter, uint32_t &out_code, int digits = 6)
-{
-    uint8_t msg[8];
-    for (int i = 7; i >= 0; --i) {
-        msg[i] = (uint8_t) (counter & 0xFF);
-        counter >>= 8;
-    }
-
-    const mbedtls_md_info_t *info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA1);
-    if (!info)
-        return false;
-
-    uint8_t mac[20];
-    if (mbedtls_md_hmac(info, key, keylen, msg, sizeof(msg), mac) != 0)
-        return false;
-
-    int off = mac[19] & 0x0F;
-    uint32_t bin = ((mac[off] & 0x7F) << 24) | ((mac[off + 1] & 0xFF) << 16) | ((mac[off + 2] & 0xFF) << 8) | (mac[off + 3] & 0xFF);
-    uint32_t mod = 1;
-    for (int i = 0; i < digits; i++)
-        mod *= 10;
-    out_code = bin % mod;
-    return true;
-}
-
-/*** TOTP verify with +/-1 window and 3-bit replay mask ***/
-bool OTP::totp_verify_window(const uint8_t *key, size_t keylen, time_t now, int period, int digits, uint32_t user_code,
-                             int64_t &io_base_step, uint8_t &io_mask)
+/*** codes of step-1, step, step+1; HMAC only runs once per time step ***/
+bool OTP::refreshCodes(int64_t step)
 {
-    int64_t step = now / period;
-
-    // Slide window forward if time advanced beyond base+1
-    if (io_base_step == 0 || step > io_base_step + 1) {
-        io_base_step = step;
-        io_mask = 0;
-    } else if (step < io_base_step - 1) {
-        return false; // far too old
+    if (m_codeStep == step) {
+        return true;
     }
 
     for (int off = -1; off <= 1; ++off) {
-        int64_t s = step + off;
-        int idx = (int) (s - (io_base_step - 1)); // 0,1,2 map to base-1, base, base+1
-        if (idx < 0 || idx > 2)
-            continue;
-        if (io_mask & (1u << idx))
-            continue; // replay
-
-        uint32_t code = 0;
-        if (!hotp_sha1(key, keylen, (uint64_t) s, code, digits))
+        if (!hotp_sha1(m_key, m_keyLen, (uint64_t) (step + off), m_codes[off + 1], OTP_DIGITS)) {
+            m_codeStep = 0;
             return false;
-        if (code == user_code) {
-            io_mask |= (1u << idx); // mark used
-            return true;
         }
     }
-    return false;
+    m_codeStep = step;
+    return true;
 }
 
 // --- Session token mint/verify ---------------------------------------------
@@ -210,12 +150,63 @@ std::string OTP::mintSessionToken(uint32_t ttl_sec /*= 24h*/)
     return token;
 }
 
+// FNV-1a, only used to pick the cache slot
+uint32_t OTP::token_hash(const char *token, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t) token[i]) * 16777619u;
+    }
+    return h;
+}
+
+bool OTP::sessionCacheLookup(const std::string &token, uint32_t ts)
+{
+    if (token.size() >= OTP_SESSION_TOKEN_MAX) {
+        return false;
+    }
+    uint32_t h = token_hash(token.data(), token.size());
+    SessionCacheEntry &e = m_sessCache[h % OTP_SESSION_CACHE_SIZE];
+
+    if (!e.len || e.hash != h || e.len != token.size()) {
+        return false;
+    }
+    if (e.exp <= ts) {
+        e.len = 0; // expired
+        return false;
+    }
+    return otp_ct_equal(e.token, token.data(), e.len);
+}
+
+void OTP::sessionCacheInsert(const std::string &token, uint32_t exp)
+{
+    if (token.size() >= OTP_SESSION_TOKEN_MAX) {
+        return;
+    }
+    uint32_t h = token_hash(token.data(), token.size());
+    SessionCacheEntry &e = m_sessCache[h % OTP_SESSION_CACHE_SIZE];
+
+    e.hash = h;
+    e.exp = exp;
+    e.len = (uint8_t) token.size();
+    memcpy(e.token, token.data(), token.size());
+}
+
+void OTP::sessionCacheClear()
+{
+    memset(m_sessCache, 0, sizeof(m_sessCache));
+}
+
 bool OTP::verifySessionToken(const std::string &token)
 {
     PThreadGuard lock(m_mutex);
     if (!m_hasSessKey || token.empty())
         return false;
 
+    // 0) token already verified and not expired?
+    if (sessionCacheLookup(token, now()))
+        return true;
+
     // 1) Split "payload.sig"
     const char *dot = (const char *) memchr(token.data(), '.', token.size());
     if (!dot)
@@ -242,7 +233,7 @@ bool OTP::verifySessionToken(const std::string &token)
         return false;
     }
 
-    if (memcmp(mac, sref, 32) != 0)
+    if (!otp_ct_equal(mac, sref, 32))
         return false;
 
     // 4) Check exp/iat/time and boot-id
@@ -257,11 +248,16 @@ bool OTP::verifySessionToken(const std::string &token)
     if (pl->bid != m_bootId)
         return false; // token minted on prior boot -> reject
 
+    sessionCacheInsert(token, pl->exp);
     return true;
 }
 
 OTP::OTP() : m_mutex(PTHREAD_MUTEX_INITIALIZER), m_enrollmentActive(false), m_isEnabled(false)
-{}
+{
+    memset(m_key, 0, sizeof(m_key));
+    memset(m_codes, 0, sizeof(m_codes));
+    sessionCacheClear();
+}
 
 bool OTP::init()
 {
@@ -293,6 +289,26 @@ void OTP::createSessionKey()
     esp_fill_random(m_sessKey, sizeof(m_sessKey));
 
     m_hasSessKey = true;
+
+    // tokens signed with the old key are invalid now
+    sessionCacheClear();
+}
+
+void OTP::setSecret(const std::string &secret)
+{
+    m_secretBase32 = secret;
+    m_codeStep = 0;
+    m_keyLen = base32_decode(m_secretBase32.c_str(), m_secretBase32.size(), m_key, sizeof(m_key));
+    if (!m_secretBase32.empty() && !m_keyLen) {
+        ESP_LOGE(TAG, "Base32 decode failed");
+    }
+}
+
+void OTP::resetReplayState()
+{
+    m_baseStep = 0;
+    m_usedMask = 0;
+    Config::setOTPReplayState(0, 0);
 }
 
 // Calculates the Base32 output length for a given byte length
@@ -305,10 +321,14 @@ static inline size_t base32_length(size_t n_bytes)
 void OTP::loadSettings()
 {
     m_isEnabled = Config::isOTPEnabled();
-    m_secretBase32 = Config::getOTPSecret();
+    char *secret = Config::getOTPSecret();
+    setSecret(secret);
+    free(secret);
     m_bootId = Config::getOTPBootId();
+    Config::getOTPReplayState(m_baseStep, m_usedMask);
 
     m_hasSessKey = false;
+    sessionCacheClear();
 
     char *tmp = Config::getOTPSessionKey();
     if (!tmp) {
@@ -350,7 +370,7 @@ void OTP::saveSettings()
 
     Config::setOTPSecret(m_secretBase32.c_str());
     Config::setOTPEnabled(m_isEnabled);
-    Config::setOTPReplayState(0, 0);
+    resetReplayState();
 }
 
 /*** Minimal URL-encode for label/issuer (space -> %20 etc.) ***/
@@ -414,48 +434,49 @@ bool OTP::validate(const std::string &token)
 
     // 1) Parse 6-digit code
     uint32_t user_code = 0;
-    if (!parse_otp6(token, user_code)) {
+    if (!totp_parse_code(token, user_code)) {
         ESP_LOGE(TAG, "TOTP parse failed");
         return false;
     }
 
-    // 2) Ensure we have a Base32 secret (load from NVS if needed)
+    // 2) Ensure we have a decoded secret
     if (m_secretBase32.empty()) {
         ESP_LOGE(TAG, "No TOTP secret");
         return false;
     }
-
-    // 3) Decode Base32 -> binary key
-    uint8_t key[32];
-    size_t klen = base32_decode(m_secretBase32.c_str(), m_secretBase32.size(), key, sizeof(key));
-    if (klen == 0) {
+    if (!m_keyLen) {
         ESP_LOGE(TAG, "Base32 decode failed");
         return false;
     }
 
-    // 4) Load replay-state from NVS (base_step + mask), defaults 0
-    int64_t base_step = 0;
-    uint8_t used_mask = 0;
-    Config::getOTPReplayState(base_step, used_mask);
-
-    // 5) Current time
+    // 3) Current time
     if (!is_time_synced()) {
         ESP_LOGE(TAG, "System time not set");
         return false;
     }
 
-    time_t ts = now();
+    int64_t step = (int64_t) now() / OTP_PERIOD;
 
-    // 6) Verify with +/-1 window and replay protection
-    bool ok = totp_verify_window(key, klen, ts, /*period=*/30, /*digits=*/6, user_code, base_step, used_mask);
-    if (!ok) {
+    // 4) Codes of the current window (cached per time step)
+    if (!refreshCodes(step)) {
+        ESP_LOGE(TAG, "HMAC failed");
+        return false;
+    }
+
+    // 5) Verify with +/-1 window and replay protection on a copy of the
+    // replay state, it's only taken over when the code was accepted
+    int64_t base_step = m_baseStep;
+    uint8_t used_mask = m_usedMask;
+    if (!totp_verify_window(m_codes, step, user_code, base_step, used_mask)) {
         ESP_LOGE(TAG, "invalid otp");
         return false;
     }
     ESP_LOGI(TAG, "otp verified!");
 
-    // 7) Persist updated replay-state (atomic enough for this use-case)
-    Config::setOTPReplayState(base_step, (uint8_t) (used_mask & 0x07));
+    // 6) Persist updated replay-state (atomic enough for this use-case)
+    m_baseStep = base_step;
+    m_usedMask = used_mask & 0x07;
+    Config::setOTPReplayState(m_baseStep, m_usedMask);
 
     return true;
 }
@@ -483,7 +504,7 @@ bool OTP::createNewQrCode()
     createSessionKey();
 
     // 1) Make a fresh secret and URI
-    m_secretBase32 = createSecret();
+    setSecret(createSecret());
     m_uri = createURI();
 
     // 2) Allocate buffers in PSRAM (max version 10 keeps QR small & readable on 170px)
@@ -515,7 +536,7 @@ bool OTP::createNewQrCode()
     ESP_LOGI(TAG, "QR ready: size=%d modules", m_qrSize);
 
     // Reset replay-state for fresh secret
-    Config::setOTPReplayState(0, 0);
+    resetReplayState();
     return true;
 }
 
@@ -6,6 +6,13 @@
 #include "lvgl.h"
 #include "qrcodegen.h"
 
+#define OTP_PERIOD 30
+#define OTP_DIGITS 6
+
+// verified session tokens are cached so repeated requests skip the HMAC
+#define OTP_SESSION_CACHE_SIZE 8
+#define OTP_SESSION_TOKEN_MAX 80
+
 class OTP {
   private:
     pthread_mutex_t m_mutex;
@@ -28,6 +35,27 @@ class OTP {
 
     bool m_isEnabled;
 
+    // decoded TOTP secret, refreshed whenever m_secretBase32 changes
+    uint8_t m_key[32];
+    size_t m_keyLen = 0;
+
+    // codes of step-1, step and step+1, computed once per time step
+    int64_t m_codeStep = 0;
+    uint32_t m_codes[3];
+
+    // replay state, mirrors what is persisted to NVS
+    int64_t m_baseStep = 0;
+    uint8_t m_usedMask = 0;
+
+    struct SessionCacheEntry
+    {
+        uint32_t hash;
+        uint32_t exp;
+        uint8_t len;
+        char token[OTP_SESSION_TOKEN_MAX];
+    };
+    SessionCacheEntry m_sessCache[OTP_SESSION_CACHE_SIZE];
+
     // base32
     std::string base32_encode(const uint8_t *in, size_t len);
     size_t base32_decode(const char *in, size_t inlen, uint8_t *out, size_t outcap);
@@ -37,13 +65,17 @@ class OTP {
     bool is_unreserved(char c);
 
     void createSessionKey();
+    void setSecret(const std::string &secret);
+    void resetReplayState();
 
+    // session cache
+    static uint32_t token_hash(const char *token, size_t len);
+    bool sessionCacheLookup(const std::string &token, uint32_t ts);
+    void sessionCacheInsert(const std::string &token, uint32_t exp);
+    void sessionCacheClear();
 
     // otp functions
-    bool parse_otp6(const std::string &s, uint32_t &out);
-    bool hotp_sha1(const uint8_t *key, size_t keylen, uint64_t counter, uint32_t &out_code, int digits);
-    bool totp_verify_window(const uint8_t *key, size_t keylen, time_t now, int period, int digits, uint32_t user_code,
-                            int64_t &io_base_step, uint8_t &io_mask);
+    bool refreshCodes(int64_t step);
 
     std::string url_encode(const std::string &s);
     std::string build_otpauth_uri(const std::string &label_raw, const std::string &issuer_raw, const std::string &secret_b32);
@@ -0,0 +1,96 @@
+#include <cctype>
+
+#include "mbedtls/md.h"
+
+#include "totp.h"
+
+// compares without an early exit so the timing doesn't leak the position
+// of the first mismatch
+bool otp_ct_equal(const void *a, const void *b, size_t len)
+{
+    const volatile uint8_t *pa = (const volatile uint8_t *) a;
+    const volatile uint8_t *pb = (const volatile uint8_t *) b;
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++) {
+        diff |= pa[i] ^ pb[i];
+    }
+    return diff == 0;
+}
+
+bool totp_parse_code(const std::string &s, uint32_t &out)
+{
+    // Accept exactly 6 digits (ignore spaces)
+    out = 0;
+    int cnt = 0;
+    for (char c : s) {
+        if (c == ' ')
+            continue;
+        if (!std::isdigit((unsigned char) c))
+            return false;
+        out = out * 10u + (uint32_t) (c - '0');
+        ++cnt;
+        if (cnt > 6)
+            return false;
+    }
+    return cnt == 6;
+}
+
+/*** HOTP (RFC4226) using HMAC-SHA1 ***/
+bool hotp_sha1(const uint8_t *key, size_t keylen, uint64_t counter, uint32_t &out_code, int digits)
+{
+    uint8_t msg[8];
+    for (int i = 7; i >= 0; --i) {
+        msg[i] = (uint8_t) (counter & 0xFF);
+        counter >>= 8;
+    }
+
+    const mbedtls_md_info_t *info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA1);
+    if (!info)
+        return false;
+
+    uint8_t mac[20];
+    if (mbedtls_md_hmac(info, key, keylen, msg, sizeof(msg), mac) != 0)
+        return false;
+
+    int off = mac[19] & 0x0F;
+    uint32_t bin = ((mac[off] & 0x7F) << 24) | ((mac[off + 1] & 0xFF) << 16) | ((mac[off + 2] & 0xFF) << 8) | (mac[off + 3] & 0xFF);
+    uint32_t mod = 1;
+    for (int i = 0; i < digits; i++)
+        mod *= 10;
+    out_code = bin % mod;
+    return true;
+}
+
+/*** TOTP verify with +/-1 window and 3-bit replay mask ***/
+bool totp_verify_window(const uint32_t codes[3], int64_t step, uint32_t user_code, int64_t &io_base_step,
+                        uint8_t &io_mask)
+{
+    // Slide window forward if time advanced beyond base+1
+    if (io_base_step == 0 || step > io_base_step + 1) {
+        io_base_step = step;
+        io_mask = 0;
+    } else if (step < io_base_step - 1) {
+        return false; // far too old
+    }
+
+    // check all candidates without an early exit
+    int match = -1;
+    for (int off = -1; off <= 1; ++off) {
+        int64_t s = step + off;
+        int idx = (int) (s - (io_base_step - 1)); // 0,1,2 map to base-1, base, base+1
+        if (idx < 0 || idx > 2)
+            continue;
+        if (io_mask & (1u << idx))
+            continue; // replay
+
+        if (otp_ct_equal(&codes[off + 1], &user_code, sizeof(user_code)) && match < 0) {
+            match = idx;
+        }
+    }
+
+    if (match < 0) {
+        return false;
+    }
+    io_mask |= (1u << match); // mark used
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// TOTP codes (RFC 6238) and the replay window of the OTP module
+//
+// Only depends on mbedtls (see host/otp_sim.cpp).
+
+// compares without an early exit so the timing doesn't leak the position
+// of the first mismatch
+bool otp_ct_equal(const void *a, const void *b, size_t len);
+
+// exactly 6 digits, spaces are ignored
+bool totp_parse_code(const std::string &s, uint32_t &out);
+
+// HOTP (RFC 4226) using HMAC-SHA1
+bool hotp_sha1(const uint8_t *key, size_t keylen, uint64_t counter, uint32_t &out_code, int digits);
+
+// checks a code against the codes of step-1, step and step+1 (codes[0..2])
+// with a 3-bit replay mask. io_base_step/io_mask are only meaningful as a
+// pair and are updated when the code is accepted.
+bool totp_verify_window(const uint32_t codes[3], int64_t step, uint32_t user_code, int64_t &io_base_step,
+                        uint8_t &io_mask);
@@ -1,95 +1,65 @@
+#include <algorithm>
+#include <stdarg.h>
 #include <string.h>
 
 #include "esp_log.h"
-#include "nvs_flash.h"
-#include "displays/displayDriver.h"
-#include "utils.h"
+#include "esp_timer.h"
 
-#include "EMC2302.h"
-#include "global_state.h"
-#include "i2c_master.h"
+#include "ArduinoJson.h"
 #include "nvs_config.h"
-#include "boards/board.h"
+#include "periodic.hpp"
+#include "psram_allocator.h"
+#include "self_test.h"
+#include "utils.h"
 
 static const char *TAG = "self_test";
 
-static void display_msg(char *msg)
+// measurement window per frequency and settle time after a frequency change
+#define HASH_WINDOW_US ((int64_t) sec_to_us(20))
+#define HASH_SETTLE_US ((int64_t) sec_to_us(3))
+#define TEMP_POLL_US ((int64_t) sec_to_us(2))
+
+// fan response
+#define FAN_SETTLE_MS 5000
+#define FAN_LOW_PERC 0.3f
+
+#define REPORT_MAX_SIZE 3072
+
+SelfTest::SelfTest(Board *board, DisplayDriver *display, float minVout, float maxVout)
+    : m_board(board), m_display(display), m_minVout(minVout), m_maxVout(maxVout)
 {
-    // todo show on screen
-    ESP_LOGI(TAG, "%s", msg);
+    m_asicCount = board->getAsicCount();
 }
 
-static bool fan_sense_pass(Board *board)
+SelfTest::~SelfTest()
 {
-    uint16_t fan_speed = 0;
-    board->getFanSpeedCh(0, &fan_speed);
-
-    ESP_LOGI(TAG, "fanSpeed: %d", fan_speed);
-    if (fan_speed > 1000) {
-        return true;
-    }
-    return false;
+    delete m_eval;
 }
 
-static bool core_voltage_pass(Board *board)
+void SelfTest::log(const char *fmt, ...)
 {
-    uint16_t core_voltage = (int) (board->getVout() * 1000.0f);
-    ESP_LOGI(TAG, "Voltage: %u", core_voltage);
-
-    if (core_voltage > 1100 && core_voltage < 1300) {
-        return true;
+    char buf[128];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    ESP_LOGI(TAG, "%s", buf);
+    if (m_display) {
+        m_display->logMessage(buf);
     }
-    return false;
 }
 
-void self_test(void *pvParameters)
+// block header from mainnet with the coinbase and 13 merkle branches
+void SelfTest::buildJob()
 {
-    // TODO cleanup
-#if 0
-    // Initialize display
-    display_init();
-    display_log_message("Self test initiated...");
-    vTaskDelay(pdMS_TO_TICKS(1000));
-
-    GlobalState *GLOBAL_STATE = (GlobalState *) pvParameters;
-
-    PowerManagementModule *power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
-
-    for (int i = 0; i < MAX_ASIC_JOBS; i++) {
-
-        GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[i] = NULL;
-        GLOBAL_STATE->valid_jobs[i] = 0;
-    }
-
-    // Init I2C
-    ESP_ERROR_CHECK(i2c_master_init());
-    ESP_LOGI(TAG, "I2C initialized successfully");
-
-    VCORE_init(GLOBAL_STATE);
-    VCORE_set_voltage(Config::getAsicVoltage() / 1000.0, GLOBAL_STATE);
-
-
-    }
-
-    SERIAL_init();
-    uint8_t chips_detected =
-        (GLOBAL_STATE->ASIC_functions.init_fn)(GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value, GLOBAL_STATE->asic_count);
-    ESP_LOGI(TAG, "%u chips detected, %u expected", chips_detected, GLOBAL_STATE->asic_count);
-
-    int baud = (*GLOBAL_STATE->ASIC_functions.set_max_baud_fn)();
-    vTaskDelay(pdMS_TO_TICKS(10));
-    SERIAL_set_baud(baud);
-
-    vTaskDelay(pdMS_TO_TICKS(1000));
-
-    mining_notify notify_message;
-    notify_message.job_id = 0;
+    mining_notify notify_message{};
     hex2bin("0c859545a3498373a57452fac22eb7113df2a465000543520000000000000000", notify_message._prev_block_hash, 32);
     notify_message.version = 0x20000004;
     notify_message.version_mask = 0x1fffe000;
     notify_message.target = 0x1705ae3a;
     notify_message.ntime = 0x647025b5;
-    notify_message.difficulty = 1000000;
+    notify_message.difficulty = SELF_TEST_DIFFICULTY;
 
     const char *coinbase_tx = "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff4b0389130cfab"
                               "e6d6d5cbab26a2599e92916edec"
@@ -120,53 +90,344 @@ void self_test(void *pvParameters)
     char merkle_root[65];
     calculate_merkle_root_hash(coinbase_tx, merkles, num_merkles, merkle_root);
 
-    bm_job *job = (bm_job*) malloc(sizeof(bm_job));
-    construct_bm_job(&notify_message, merkle_root, 0x1fffe000, job);
+    memset(&m_job, 0, sizeof(m_job));
+    construct_bm_job(&notify_message, merkle_root, notify_message.version_mask, &m_job);
+    m_job.asic_diff = SELF_TEST_DIFFICULTY;
+}
 
-    (*GLOBAL_STATE->ASIC_functions.set_difficulty_mask_fn)(32);
+// eco, default and configured frequency, lowest first
+void SelfTest::selectFrequencies()
+{
+    float candidates[] = {(float) m_board->getEcoAsicFrequency(), (float) m_board->getDefaultAsicFrequency(),
+                          (float) m_board->getAsicFrequency()};
 
-    ESP_LOGI(TAG, "Sending work");
+    for (float f : candidates) {
+        if (f > 0.0f && m_board->validateFrequency(f)) {
+            m_eval->addFrequency(f);
+        }
+    }
+    m_eval->sortFrequencies();
+}
 
-    (*GLOBAL_STATE->ASIC_functions.send_work_fn)(GLOBAL_STATE, job);
-    // vTaskDelay(pdMS_TO_TICKS((GLOBAL_STATE->asic_job_frequency_ms - 0.3)));
+void SelfTest::senderTaskWrapper(void *pv)
+{
+    SelfTest *self = (SelfTest *) pv;
+    self->senderTask();
+    vTaskDelete(NULL);
+}
 
-    // ESP_LOGI(TAG, "Receiving work");
+// sends a new job on the board's job interval, every job gets a new ntime
+// so the asics don't repeat work
+void SelfTest::senderTask()
+{
+    uint32_t counter = 0;
+    while (m_sending) {
+        bm_job job = m_job;
+        job.ntime += counter;
 
-    // task_result * asic_result = (*GLOBAL_STATE->ASIC_functions.receive_result_fn)(GLOBAL_STATE);
-    // if (asic_result != NULL) {
+        uint8_t asic_job_id = m_asics->sendWork(counter, &job);
 
-    //     ESP_LOGI(TAG, "Received work");
+        pthread_mutex_lock(&m_jobMutex);
+        m_sentJobs[asic_job_id % SELF_TEST_JOB_SLOTS] = job;
+        m_sentValid[asic_job_id % SELF_TEST_JOB_SLOTS] = true;
+        pthread_mutex_unlock(&m_jobMutex);
 
-    //     // check the nonce difficulty
-    //     double nonce_diff = test_nonce_value(&job, asic_result->nonce, asic_result->rolled_version);
-    //     ESP_LOGI(TAG, "Nonce %lu Nonce difficulty %.32f.", asic_result->nonce, nonce_diff);
+        counter++;
+        vTaskDelay(pdMS_TO_TICKS(m_board->getAsicJobIntervalMs()));
+    }
+}
 
-    // if (asic_result->nonce == 4054974794) {
-    if (chips_detected < 1) {
-        ESP_LOGE(TAG, "SELF TEST FAIL, NO CHIPS DETECTED");
-        // ESP_LOGE(TAG, "SELF TEST FAIL, INCORRECT NONCE DIFF");
-        display_msg("ASIC:FAIL NO CHIPS", GLOBAL_STATE);
-        display_log_message("Test result: ERROR > NO CHIPS DETECTED");
-        return;
+bool SelfTest::startSender()
+{
+    m_sending = true;
+    if (xTaskCreate(senderTaskWrapper, "selftest jobs", 4096, (void *) this, 10, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "failed to create job task");
+        m_sending = false;
+        return false;
+    }
+    return true;
+}
+
+void SelfTest::stopSender()
+{
+    m_sending = false;
+    // let the task finish its last delay
+    vTaskDelay(pdMS_TO_TICKS(m_board->getAsicJobIntervalMs() + 100));
+}
+
+// processes asic results until the given time. Register replies (chip temps)
+// are handled like in the result task.
+void SelfTest::receive(int64_t until, bool counting)
+{
+    while (esp_timer_get_time() < until) {
+        task_result asic_result;
+        if (!m_asics->processWork(&asic_result)) {
+            continue;
+        }
+
+        if (asic_result.is_reg_resp) {
+            if (asic_result.reg == 0xb4 && (asic_result.data & 0x80000000)) {
+                float ftemp = (float) (asic_result.data & 0x0000ffff) * 0.171342f - 299.5144f;
+                m_board->setChipTemp(asic_result.asic_nr, ftemp);
+            }
+            continue;
+        }
+
+        int chip = asic_result.asic_nr;
+        if (chip < 0 || chip >= m_eval->getAsicCount()) {
+            ESP_LOGW(TAG, "nonce from unknown chip %d", chip);
+            continue;
+        }
+
+        bm_job job;
+        bool found;
+        pthread_mutex_lock(&m_jobMutex);
+        found = m_sentValid[asic_result.job_id % SELF_TEST_JOB_SLOTS];
+        job = m_sentJobs[asic_result.job_id % SELF_TEST_JOB_SLOTS];
+        pthread_mutex_unlock(&m_jobMutex);
+
+        if (!found) {
+            continue;
+        }
+
+        asic_result.rolled_version |= job.version;
+        double nonce_diff = test_nonce_value(&job, asic_result.nonce, asic_result.rolled_version);
+
+        m_eval->addNonce(chip, nonce_diff, esp_timer_get_time(), counting);
     }
+}
 
-    free(job);
+void SelfTest::readTemps(bool load)
+{
+    // the power management isn't running yet, the board samples its
+    // sensors here
+    m_board->requestChipTemps();
+    for (int i = 0; i < m_eval->getNumTempSensors(); i++) {
+        m_eval->setTemp(i, load, m_board->getTemperature(i));
+    }
+}
 
-    if (!core_voltage_pass(GLOBAL_STATE)) {
-        ESP_LOGE(TAG, "SELF TEST FAIL, NO CHIPS DETECTED");
-        display_msg("POWER:     FAIL", GLOBAL_STATE);
-        display_log_message("Test result: ERROR > Power FAIL, core voltage");
+void SelfTest::testFans()
+{
+    log("Testing fans ...");
+
+    uint16_t rpmFull[SELF_TEST_MAX_FANS]{};
+    m_board->setFanSpeed(1.0f);
+    vTaskDelay(pdMS_TO_TICKS(FAN_SETTLE_MS));
+    for (int i = 0; i < m_eval->getNumFans(); i++) {
+        m_board->getFanSpeedCh(i, &rpmFull[i]);
+    }
+
+    m_board->setFanSpeed(FAN_LOW_PERC);
+    vTaskDelay(pdMS_TO_TICKS(FAN_SETTLE_MS));
+    for (int i = 0; i < m_eval->getNumFans(); i++) {
+        uint16_t rpmLow = 0;
+        m_board->getFanSpeedCh(i, &rpmLow);
+        m_eval->setFan(i, rpmFull[i], rpmLow);
+        log("- fan %d: %u rpm / %u rpm %s", i, rpmFull[i], rpmLow, m_eval->fanOk(i) ? "OK" : "Warning");
+    }
+
+    // asics are hashing next
+    m_board->setFanSpeed(1.0f);
+}
+
+void SelfTest::testPower(bool load)
+{
+    m_board->requestBuckTelemtry();
+    vTaskDelay(pdMS_TO_TICKS(100));
+
+    m_eval->setPower(load, m_board->getPin(), m_board->getVout());
+    if (load) {
+        m_vrTemp = m_board->getVRTemp();
+    }
+}
+
+void SelfTest::testHashing()
+{
+    m_asics->setJobDifficultyMask(SELF_TEST_DIFFICULTY);
+
+    if (!startSender()) {
         return;
     }
+    m_eval->startHashing(esp_timer_get_time());
+
+    for (int f = 0; f < m_eval->getNumFreqs(); f++) {
+        float freq = m_eval->getFrequency(f);
+        log("Hashing at %.0fMHz ...", freq);
+
+        if (!m_board->setAsicFrequency(freq)) {
+            ESP_LOGE(TAG, "failed to set frequency %.2fMHz", freq);
+            continue;
+        }
+
+        receive(esp_timer_get_time() + HASH_SETTLE_US, false);
+
+        m_eval->startWindow();
+
+        int64_t start = esp_timer_get_time();
+        int64_t end = start + HASH_WINDOW_US;
+
+        // split the window to watch the temperature while hashing
+        while (esp_timer_get_time() < end && !m_overheated) {
+            receive(std::min(end, esp_timer_get_time() + TEMP_POLL_US), true);
+
+            m_board->requestChipTemps();
+            float maxTemp = 0.0f;
+            for (int i = 0; i < m_eval->getNumTempSensors(); i++) {
+                maxTemp = std::max(maxTemp, m_board->getTemperature(i));
+            }
+            maxTemp = std::max(maxTemp, m_board->getMaxChipTemp());
+
+            uint16_t overheatTemp = Config::getOverheatTemp();
+            if (overheatTemp && maxTemp > (float) overheatTemp) {
+                ESP_LOGE(TAG, "overheated (%.1f°C), hashing stopped", maxTemp);
+                m_overheated = true;
+            }
+        }
+
+        m_eval->endWindow(f, (float) (esp_timer_get_time() - start) / 1e6f);
+        for (int i = 0; i < m_asicCount; i++) {
+            log("- chip %d: %.1fGH/s (%.1fGH/s expected)", i, m_eval->getChip(i).hashrate[f], m_eval->expectedHashrate(freq));
+        }
+
+        if (m_overheated) {
+            break;
+        }
+    }
+
+    // telemetry at the highest frequency
+    testPower(true);
+    readTemps(true);
+
+    stopSender();
+
+    // back to the configured frequency
+    m_board->setAsicFrequency((float) m_board->getAsicFrequency());
+}
+
+bool SelfTest::saveReport(bool passed, bool field, int64_t durationUs)
+{
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    doc["result"] = passed ? "pass" : "fail";
+    doc["field"] = field;
+    doc["durationMs"] = (uint32_t) (durationUs / 1000);
+    doc["deviceModel"] = m_board->getDeviceModel();
+    doc["asicModel"] = m_board->getAsicModel();
+    doc["asicCount"] = m_asicCount;
+    doc["chipsDetected"] = m_board->getChipsDetected();
+    doc["difficulty"] = SELF_TEST_DIFFICULTY;
+    doc["overheated"] = m_overheated;
+
+    JsonArray freqs = doc["frequencies"].to<JsonArray>();
+    for (int f = 0; f < m_eval->getNumFreqs(); f++) {
+        freqs.add(m_eval->getFrequency(f));
+    }
 
-    if (!fan_sense_pass(GLOBAL_STATE)) {
-        ESP_LOGE(TAG, "FAN test failed!");
-        display_msg("FAN:       WARN", GLOBAL_STATE);
-        display_log_message("Test result: OK PASS > Warning fan");
+    JsonArray chips = doc["chips"].to<JsonArray>();
+    for (int i = 0; i < m_asicCount; i++) {
+        const SelfTestEval::ChipResult &result = m_eval->getChip(i);
+        JsonObject chip = chips.add<JsonObject>();
+        chip["valid"] = result.valid;
+        chip["invalid"] = result.invalid;
+        chip["firstNonceMs"] = result.firstNonceUs ? (int32_t) (result.firstNonceUs / 1000) : -1;
+        JsonArray hashrate = chip["hashrate"].to<JsonArray>();
+        JsonArray expected = chip["expected"].to<JsonArray>();
+        for (int f = 0; f < m_eval->getNumFreqs(); f++) {
+            hashrate.add(roundf(result.hashrate[f] * 10.0f) / 10.0f);
+            expected.add(roundf(m_eval->expectedHashrate(m_eval->getFrequency(f)) * 10.0f) / 10.0f);
+        }
+        chip["ok"] = m_eval->chipOk(i);
     }
 
-    display_msg("           PASS", GLOBAL_STATE);
-    display_log_message("Test result: OK PASS");
-    Config::setSelfTest(false);
-#endif
+    JsonArray fans = doc["fans"].to<JsonArray>();
+    for (int i = 0; i < m_eval->getNumFans(); i++) {
+        JsonObject fan = fans.add<JsonObject>();
+        fan["rpmFull"] = m_eval->getFan(i).rpmFull;
+        fan["rpmLow"] = m_eval->getFan(i).rpmLow;
+        fan["ok"] = m_eval->fanOk(i);
+    }
+
+    JsonObject vr = doc["vr"].to<JsonObject>();
+    vr["vout"] = m_eval->getVoutLoad();
+    vr["voutOk"] = m_eval->voutOk();
+    vr["pinIdle"] = m_eval->getPinIdle();
+    vr["pinLoad"] = m_eval->getPinLoad();
+    vr["powerOk"] = m_eval->powerOk();
+    vr["temp"] = m_vrTemp;
+
+    JsonArray temps = doc["tempSensors"].to<JsonArray>();
+    for (int i = 0; i < m_eval->getNumTempSensors(); i++) {
+        JsonObject temp = temps.add<JsonObject>();
+        temp["idle"] = m_eval->getTemp(i).idle;
+        temp["load"] = m_eval->getTemp(i).load;
+        temp["ok"] = m_eval->tempOk(i);
+    }
+
+    char *buf = (char *) MALLOC(REPORT_MAX_SIZE);
+    if (!buf) {
+        ESP_LOGE(TAG, "no memory for the report");
+        return false;
+    }
+
+    size_t len = serializeJson(doc, buf, REPORT_MAX_SIZE);
+    bool ok = len > 0 && len < REPORT_MAX_SIZE - 1;
+    if (ok) {
+        ESP_LOGI(TAG, "%s", buf);
+        Config::setSelfTestReport(buf);
+    } else {
+        ESP_LOGE(TAG, "report too large");
+    }
+    FREE(buf);
+    doc.clear();
+    return ok;
+}
+
+bool SelfTest::run(bool field)
+{
+    int64_t start = esp_timer_get_time();
+
+    m_asics = m_board->getAsics();
+
+    SelfTestEval::Limits limits;
+    limits.smallCoreCount = m_asics ? m_asics->getSmallCoreCount() : 0;
+    limits.minVout = m_minVout;
+    limits.maxVout = m_maxVout;
+    limits.minPin = m_board->getMinPin();
+    limits.maxPin = m_board->getMaxPin();
+    delete m_eval;
+    m_eval = new SelfTestEval(m_asicCount, m_board->getNumFans(), m_board->getNumTempSensors(), limits);
+
+    log("Asics detected [%d/%d]", m_board->getChipsDetected(), m_asicCount);
+
+    if (m_asics) {
+        buildJob();
+        selectFrequencies();
+
+        testFans();
+        testPower(false);
+        readTemps(false);
+        testHashing();
+    }
+
+    for (int i = 0; i < m_asicCount && m_asics; i++) {
+        if (!m_eval->chipOk(i)) {
+            log("- chip %d: %s", i, m_eval->getChip(i).firstNonceUs ? "low hashrate" : "no valid nonce");
+        }
+    }
+    for (int i = 0; i < m_eval->getNumTempSensors(); i++) {
+        if (!m_eval->tempOk(i)) {
+            log("- temp sensor %d: Warning (%.1f°C / %.1f°C)", i, m_eval->getTemp(i).idle, m_eval->getTemp(i).load);
+        }
+    }
+    log("- Power status: %s (%.2f W)", m_eval->powerOk() ? "OK" : "Warning", m_eval->getPinLoad());
+    log("- Asic voltage: %s (%.2f V)", m_eval->voutOk() ? "OK" : "Warning", m_eval->getVoutLoad());
+
+    bool passed = m_asics && m_eval->passed(m_board->getChipsDetected(), m_overheated);
+
+    saveReport(passed, field, esp_timer_get_time() - start);
+
+    log("%s", passed ? "OOOOOOOO TEST OK!!! OOOOOOO" : "XXXXXXXXX TEST KO XXXXXXXXX");
+    return passed;
 }
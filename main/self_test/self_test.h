@@ -0,0 +1,66 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "boards/board.h"
+#include "displays/displayDriver.h"
+#include "mining.h"
+#include "self_test_eval.h"
+
+#define SELF_TEST_JOB_SLOTS 128
+
+// Manufacturing and field self-test
+//
+// - feeds the known test vectors as jobs and verifies every chip returns
+//   valid nonces within the expected time
+// - measures the per-chip hashrate from the nonce rate on several frequencies
+// - checks fan, VR and temperature sensor response
+// - saves a JSON report to NVS that is served by the API
+class SelfTest {
+  protected:
+    Board *m_board;
+    Asic *m_asics = nullptr;
+    DisplayDriver *m_display;
+    float m_minVout;
+    float m_maxVout;
+
+    int m_asicCount = 0;
+    SelfTestEval *m_eval = nullptr;
+
+    float m_vrTemp = 0.0f;
+    bool m_overheated = false;
+
+    // test job and the clones sent to the asics
+    bm_job m_job;
+    bm_job m_sentJobs[SELF_TEST_JOB_SLOTS];
+    bool m_sentValid[SELF_TEST_JOB_SLOTS]{};
+    pthread_mutex_t m_jobMutex = PTHREAD_MUTEX_INITIALIZER;
+    volatile bool m_sending = false;
+
+    void log(const char *fmt, ...);
+
+    void buildJob();
+    void selectFrequencies();
+
+    static void senderTaskWrapper(void *pv);
+    void senderTask();
+    bool startSender();
+    void stopSender();
+
+    void receive(int64_t until, bool counting);
+    void readTemps(bool load);
+
+    void testFans();
+    void testHashing();
+    void testPower(bool load);
+
+    bool saveReport(bool passed, bool field, int64_t durationUs);
+
+  public:
+    SelfTest(Board *board, DisplayDriver *display, float minVout, float maxVout);
+    ~SelfTest();
+
+    // expects the asics to be initialized, returns true on pass
+    bool run(bool field);
+};
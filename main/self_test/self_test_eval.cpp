@@ -0,0 +1,174 @@
+#include <algorithm>
+
+#include "self_test_eval.h"
+
+// every chip has to return its first valid nonce in this time
+#define FIRST_NONCE_TIMEOUT_US 5000000LL
+
+// measured hashrate needs to reach this share of the theoretical hashrate
+#define MIN_HASHRATE_RATIO 0.70f
+
+// fan response
+#define FAN_MIN_RPM 1000
+#define FAN_MIN_DROP 0.8f
+
+// temperature sensors have to be plausible and follow the load
+#define TEMP_MIN_PLAUSIBLE 5.0f
+#define TEMP_MAX_PLAUSIBLE 105.0f
+#define TEMP_MIN_RISE 2.0f
+
+SelfTestEval::SelfTestEval(int asicCount, int numFans, int numTempSensors, const Limits &limits)
+    : m_limits(limits), m_asicCount(asicCount), m_numFans(std::min(numFans, SELF_TEST_MAX_FANS)),
+      m_numTempSensors(std::min(numTempSensors, SELF_TEST_MAX_TEMP_SENSORS))
+{
+    m_chips = new ChipResult[m_asicCount]();
+}
+
+SelfTestEval::~SelfTestEval()
+{
+    delete[] m_chips;
+}
+
+void SelfTestEval::addFrequency(float frequency)
+{
+    if (frequency <= 0.0f || m_numFreqs >= SELF_TEST_MAX_FREQS ||
+        std::find(m_freqs, m_freqs + m_numFreqs, frequency) != m_freqs + m_numFreqs) {
+        return;
+    }
+    m_freqs[m_numFreqs++] = frequency;
+}
+
+void SelfTestEval::sortFrequencies()
+{
+    std::sort(m_freqs, m_freqs + m_numFreqs);
+}
+
+void SelfTestEval::startHashing(int64_t nowUs)
+{
+    m_hashStart = nowUs;
+}
+
+void SelfTestEval::startWindow()
+{
+    for (int i = 0; i < m_asicCount; i++) {
+        m_chips[i].windowNonces = 0;
+    }
+}
+
+bool SelfTestEval::addNonce(int chip, double nonceDiff, int64_t nowUs, bool counting)
+{
+    if (chip < 0 || chip >= m_asicCount) {
+        return false;
+    }
+
+    ChipResult &result = m_chips[chip];
+    if (nonceDiff < SELF_TEST_DIFFICULTY) {
+        // the chip returned a nonce that doesn't meet the mask
+        result.invalid++;
+        return false;
+    }
+
+    result.valid++;
+    if (!result.firstNonceUs) {
+        // at least 1us so a nonce right at the start still counts as seen
+        result.firstNonceUs = std::max(nowUs - m_hashStart, (int64_t) 1);
+    }
+    if (counting) {
+        result.windowNonces++;
+    }
+    return true;
+}
+
+void SelfTestEval::endWindow(int freq, float elapsedS)
+{
+    if (freq < 0 || freq >= m_numFreqs || elapsedS <= 0.0f) {
+        return;
+    }
+    for (int i = 0; i < m_asicCount; i++) {
+        ChipResult &chip = m_chips[i];
+        chip.hashrate[freq] = (float) chip.windowNonces * SELF_TEST_DIFFICULTY * 4294967296.0f / elapsedS / 1e9f;
+    }
+}
+
+void SelfTestEval::setFan(int fan, uint16_t rpmFull, uint16_t rpmLow)
+{
+    if (fan < 0 || fan >= m_numFans) {
+        return;
+    }
+    m_fans[fan].rpmFull = rpmFull;
+    m_fans[fan].rpmLow = rpmLow;
+}
+
+void SelfTestEval::setTemp(int sensor, bool load, float temp)
+{
+    if (sensor < 0 || sensor >= m_numTempSensors) {
+        return;
+    }
+    if (load) {
+        m_temps[sensor].load = temp;
+    } else {
+        m_temps[sensor].idle = temp;
+    }
+}
+
+void SelfTestEval::setPower(bool load, float pin, float vout)
+{
+    if (!load) {
+        m_pinIdle = pin;
+        return;
+    }
+    m_pinLoad = pin;
+    m_voutLoad = vout;
+}
+
+float SelfTestEval::expectedHashrate(float frequency)
+{
+    // GH/s per chip
+    return frequency * (float) m_limits.smallCoreCount / 1000.0f;
+}
+
+bool SelfTestEval::chipOk(int chip)
+{
+    ChipResult &result = m_chips[chip];
+    if (!result.firstNonceUs || result.firstNonceUs > FIRST_NONCE_TIMEOUT_US) {
+        return false;
+    }
+    for (int f = 0; f < m_numFreqs; f++) {
+        if (result.hashrate[f] < expectedHashrate(m_freqs[f]) * MIN_HASHRATE_RATIO) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SelfTestEval::fanOk(int fan)
+{
+    return m_fans[fan].rpmFull > FAN_MIN_RPM && (float) m_fans[fan].rpmLow < (float) m_fans[fan].rpmFull * FAN_MIN_DROP;
+}
+
+bool SelfTestEval::tempOk(int sensor)
+{
+    TempResult &t = m_temps[sensor];
+    bool plausible = t.idle > TEMP_MIN_PLAUSIBLE && t.idle < TEMP_MAX_PLAUSIBLE && t.load > TEMP_MIN_PLAUSIBLE &&
+                     t.load < TEMP_MAX_PLAUSIBLE;
+    return plausible && (t.load - t.idle) >= TEMP_MIN_RISE;
+}
+
+bool SelfTestEval::voutOk()
+{
+    return m_voutLoad > m_limits.minVout && m_voutLoad < m_limits.maxVout;
+}
+
+bool SelfTestEval::powerOk()
+{
+    return m_pinLoad > m_limits.minPin && m_pinLoad < m_limits.maxPin && m_pinLoad > m_pinIdle;
+}
+
+bool SelfTestEval::passed(int chipsDetected, bool overheated)
+{
+    bool chipsOk = chipsDetected == m_asicCount;
+    for (int i = 0; i < m_asicCount; i++) {
+        chipsOk &= chipOk(i);
+    }
+    return chipsOk && voutOk() && !overheated;
+}
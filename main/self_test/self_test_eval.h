@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stdint.h>
+
+#define SELF_TEST_MAX_FREQS 3
+#define SELF_TEST_MAX_FANS 2
+#define SELF_TEST_MAX_TEMP_SENSORS 4
+
+// low difficulty gives a nonce rate high enough for a short measurement,
+// at 32 the 20s window left 0.1% of good chips below the hashrate limit
+// (host/self_test_sim.cpp)
+#define SELF_TEST_DIFFICULTY 8
+
+// Results and pass/fail rules of the self-test
+//
+// SelfTest drives the hardware and feeds what it measures, this class
+// counts the nonces per chip, computes the hashrate of each measurement
+// window and decides what passed.
+//
+// No ESP-IDF dependencies (see host/self_test_sim.cpp).
+class SelfTestEval {
+  public:
+    struct ChipResult
+    {
+        uint32_t valid;
+        uint32_t invalid;
+        int64_t firstNonceUs;                // since start of hashing, 0 = no nonce
+        uint32_t windowNonces;               // valid nonces in the current window
+        float hashrate[SELF_TEST_MAX_FREQS]; // GH/s
+    };
+
+    struct FanResult
+    {
+        uint16_t rpmFull;
+        uint16_t rpmLow;
+    };
+
+    struct TempResult
+    {
+        float idle;
+        float load;
+    };
+
+    // board specific limits
+    struct Limits
+    {
+        uint16_t smallCoreCount;
+        float minVout;
+        float maxVout;
+        float minPin;
+        float maxPin;
+    };
+
+  protected:
+    Limits m_limits;
+
+    int m_asicCount = 0;
+    ChipResult *m_chips = nullptr;
+
+    float m_freqs[SELF_TEST_MAX_FREQS];
+    int m_numFreqs = 0;
+
+    FanResult m_fans[SELF_TEST_MAX_FANS]{};
+    int m_numFans = 0;
+
+    TempResult m_temps[SELF_TEST_MAX_TEMP_SENSORS]{};
+    int m_numTempSensors = 0;
+
+    float m_voutLoad = 0.0f;
+    float m_pinIdle = 0.0f;
+    float m_pinLoad = 0.0f;
+
+    int64_t m_hashStart = 0;
+
+  public:
+    SelfTestEval(int asicCount, int numFans, int numTempSensors, const Limits &limits);
+    ~SelfTestEval();
+
+    // frequencies are measured in the given order, duplicates are skipped
+    void addFrequency(float frequency);
+    void sortFrequencies();
+
+    void startHashing(int64_t nowUs);
+    void startWindow();
+
+    // a nonce of a chip verified against its job, returns false if it
+    // doesn't meet the test difficulty
+    bool addNonce(int chip, double nonceDiff, int64_t nowUs, bool counting);
+
+    void endWindow(int freq, float elapsedS);
+
+    void setFan(int fan, uint16_t rpmFull, uint16_t rpmLow);
+    void setTemp(int sensor, bool load, float temp);
+    void setPower(bool load, float pin, float vout);
+
+    float expectedHashrate(float frequency);
+    bool chipOk(int chip);
+    bool fanOk(int fan);
+    bool tempOk(int sensor);
+    bool voutOk();
+    bool powerOk();
+
+    // fans, power and temp sensors are warnings, the asics and the VR have
+    // to work
+    bool passed(int chipsDetected, bool overheated);
+
+    int getAsicCount()
+    {
+        return m_asicCount;
+    }
+
+    int getNumFreqs()
+    {
+        return m_numFreqs;
+    }
+
+    float getFrequency(int freq)
+    {
+        return m_freqs[freq];
+    }
+
+    int getNumFans()
+    {
+        return m_numFans;
+    }
+
+    int getNumTempSensors()
+    {
+        return m_numTempSensors;
+    }
+
+    const ChipResult &getChip(int chip)
+    {
+        return m_chips[chip];
+    }
+
+    const FanResult &getFan(int fan)
+    {
+        return m_fans[fan];
+    }
+
+    const TempResult &getTemp(int sensor)
+    {
+        return m_temps[sensor];
+    }
+
+    float getVoutLoad()
+    {
+        return m_voutLoad;
+    }
+
+    float getPinIdle()
+    {
+        return m_pinIdle;
+    }
+
+    float getPinLoad()
+    {
+        return m_pinLoad;
+    }
+};
@@ -1,4 +0,0 @@
-#pragma once
-
-void self_test(void *pvParameters);
-
@@ -1,17 +1,30 @@
+#include <stdlib.h>
+
 #include "esp_log.h"
 #include "esp_sntp.h"
+#include "esp_timer.h"
 #include "global_state.h"
+#include "macros.h"
 #include "sntp.h"
 
 
 // ---- SNTP helpers ----
 static const char *TAG_TIME = "time";
 
-static bool synchronized = false;
+// libc clock (TLS, localtime) is only stepped if it's off by more
+#define SYSTEM_CLOCK_STEP_US 500000ll
+
+static int64_t system_clock_us()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t) tv.tv_sec * 1000000ll + tv.tv_usec;
+}
 
-static void time_sync_notification_cb(struct timeval *tv) {
-    ESP_LOGI(TAG_TIME, "Time synchronized");
-    synchronized = true;
+// replaces the weak default of esp_sntp that sets the system clock directly
+void sntp_sync_time(struct timeval *tv)
+{
+    sntp.onSample(tv);
 }
 
 SNTP::SNTP() {
@@ -19,7 +32,131 @@ SNTP::SNTP() {
 }
 
 bool SNTP::isTimeSynced() {
-    return (synchronized && now() >= 1722927653);
+    bool synced;
+    {
+        PThreadGuard lock(m_mutex);
+        synced = m_sync.isSynced();
+    }
+    return (synced && now() >= 1722927653);
+}
+
+uint64_t SNTP::nowMs() {
+    int64_t mono = esp_timer_get_time();
+    {
+        PThreadGuard lock(m_mutex);
+        if (m_sync.isSynced()) {
+            return (uint64_t) (m_sync.toUtc(mono) / 1000ll);
+        }
+    }
+    return (uint64_t) (system_clock_us() / 1000ll);
+}
+
+void SNTP::setSystemClock(int64_t utcUs, bool step) {
+    int64_t diff = utcUs - system_clock_us();
+    if (step || llabs(diff) > SYSTEM_CLOCK_STEP_US) {
+        struct timeval tv = {.tv_sec = (time_t) (utcUs / 1000000ll), .tv_usec = (suseconds_t) (utcUs % 1000000ll)};
+        settimeofday(&tv, nullptr);
+        return;
+    }
+    struct timeval delta = {.tv_sec = (time_t) (diff / 1000000ll), .tv_usec = (suseconds_t) (diff % 1000000ll)};
+    adjtime(&delta, nullptr);
+}
+
+void SNTP::notify(int64_t utcOffsetMs, int64_t stepMs) {
+    for (int i = 0; i < m_numListeners; i++) {
+        m_listeners[i].cb(m_listeners[i].ctx, utcOffsetMs, stepMs);
+    }
+}
+
+bool SNTP::addListener(time_listener_t cb, void *ctx) {
+    int64_t offsetMs = 0;
+    bool synced = false;
+    {
+        PThreadGuard lock(m_mutex);
+        if (m_numListeners >= SNTP_MAX_TIME_LISTENERS) {
+            return false;
+        }
+        m_listeners[m_numListeners].cb = cb;
+        m_listeners[m_numListeners].ctx = ctx;
+        m_numListeners++;
+
+        if (m_sync.isSynced()) {
+            int64_t mono = esp_timer_get_time();
+            offsetMs = (m_sync.toUtc(mono) - mono) / 1000ll;
+            synced = true;
+        }
+    }
+    // late listeners get the current offset right away
+    if (synced) {
+        cb(ctx, offsetMs, 0);
+    }
+    return true;
+}
+
+// called in the context of the lwip SNTP client
+void SNTP::onSample(struct timeval *tv) {
+    int64_t mono = esp_timer_get_time();
+    int64_t utc = (int64_t) tv->tv_sec * 1000000ll + tv->tv_usec;
+
+    TimeSync::Result result;
+    int64_t step = 0;
+    int64_t mapped;
+    int64_t offset;
+    double drift;
+    uint32_t interval;
+    {
+        PThreadGuard lock(m_mutex);
+        // the step of the first sync is relative to the system clock
+        int64_t before = m_sync.isSynced() ? m_sync.toUtc(mono) : system_clock_us();
+        result = m_sync.sample(mono, utc, &step);
+        if (result == TimeSync::Result::First) {
+            step = utc - before;
+        }
+        mapped = m_sync.isSynced() ? m_sync.toUtc(mono) : utc;
+        offset = m_sync.getLastOffset();
+        drift = m_sync.getDriftPpm();
+        interval = m_sync.getPollIntervalMs();
+    }
+
+    // learn the drift with short intervals, confirm large offsets quickly
+    sntp_set_sync_interval(interval);
+
+    switch (result) {
+    case TimeSync::Result::First:
+    case TimeSync::Result::Step:
+        ESP_LOGW(TAG_TIME, "clock %s by %lld ms", (result == TimeSync::Result::First) ? "set" : "stepped", step / 1000ll);
+        setSystemClock(mapped, true);
+        sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+        break;
+    case TimeSync::Result::Slew:
+        ESP_LOGI(TAG_TIME, "offset %lld ms, drift %.2f ppm, next sync in %lu s", offset / 1000ll, drift, interval / 1000);
+        setSystemClock(mapped, false);
+        sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+        break;
+    case TimeSync::Result::Pending:
+        ESP_LOGW(TAG_TIME, "offset of %lld ms, waiting for confirmation", offset / 1000ll);
+        return;
+    case TimeSync::Result::Rejected:
+        ESP_LOGW(TAG_TIME, "SNTP response rejected");
+        return;
+    }
+
+    notify((mapped - mono) / 1000ll, step / 1000ll);
+}
+
+double SNTP::getDriftPpm() {
+    PThreadGuard lock(m_mutex);
+    return m_sync.getDriftPpm();
+}
+
+int64_t SNTP::getLastOffsetUs() {
+    PThreadGuard lock(m_mutex);
+    return m_sync.getLastOffset();
+}
+
+uint32_t SNTP::getNumSteps() {
+    PThreadGuard lock(m_mutex);
+    return m_sync.getNumSteps();
 }
 
 void SNTP::start() {
@@ -28,14 +165,8 @@ void SNTP::start() {
     esp_sntp_setservername(0, "de.pool.ntp.org");
     esp_sntp_setservername(1, "pool.ntp.org");
 
-    // Resync interval (ms). Default ~3600000; 6h is fine for TOTP.
-    sntp_set_sync_interval(6 * 60 * 60 * 1000UL);
-
-    // Immediate time update is simplest for embedded
-    esp_sntp_set_sync_mode(SNTP_SYNC_MODE_IMMED);
-
-    // Optional: notification callback
-    sntp_set_time_sync_notification_cb(time_sync_notification_cb);
+    // Resync interval (ms), adapted by onSample while the drift is learned
+    sntp_set_sync_interval(TimeSync::POLL_LEARN_MS);
 
     // Set TZ to Europe/Berlin (CET/CEST with rules)
     setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
@@ -1,12 +1,49 @@
 #pragma once
 
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "time_sync.h"
+
+#define SNTP_MAX_TIME_LISTENERS 4
+
+// called after each accepted SNTP sample with the new offset between UTC and
+// the monotonic esp_timer clock and the size of the step (0 if slewed)
+typedef void (*time_listener_t)(void *ctx, int64_t utcOffsetMs, int64_t stepMs);
+
 class SNTP {
   protected:
+    TimeSync m_sync;
+    pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    struct
+    {
+        time_listener_t cb;
+        void *ctx;
+    } m_listeners[SNTP_MAX_TIME_LISTENERS];
+    int m_numListeners = 0;
+
     bool waitForInitialSync(int timeout_ms);
+    void setSystemClock(int64_t utcUs, bool step);
+    void notify(int64_t utcOffsetMs, int64_t stepMs);
+
   public:
     SNTP();
 
     void start();
     void logLocalTime();
     bool isTimeSynced();
-};
\ No newline at end of file
+
+    // SNTP response received at tv
+    void onSample(struct timeval *tv);
+
+    // UTC in ms, system clock before the first sync
+    uint64_t nowMs();
+
+    bool addListener(time_listener_t cb, void *ctx);
+
+    double getDriftPpm();
+    int64_t getLastOffsetUs();
+    uint32_t getNumSteps();
+};
@@ -0,0 +1,118 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "solo_stats.h"
+
+#define SOLO_STATS_VERSION 1
+
+double SoloStats::networkDifficulty(uint32_t nbits)
+{
+    uint32_t mantissa = nbits & 0x007fffff;
+    int exponent = (nbits >> 24) & 0xff;
+    if (!mantissa) {
+        return 0.0;
+    }
+    // 0xffff * 2^208 / (mantissa * 256^(exponent - 3))
+    return ldexp(65535.0 / mantissa, 208 - 8 * (exponent - 3));
+}
+
+double SoloStats::networkHashrate(double networkDiff)
+{
+    return networkDiff * 4294967296.0 / 600.0 / 1e9;
+}
+
+double SoloStats::expectedTimeToBlock(double networkDiff, double hashrateGhs)
+{
+    if (hashrateGhs <= 0.0) {
+        return 0.0;
+    }
+    return networkDiff * 4294967296.0 / (hashrateGhs * 1e9);
+}
+
+double SoloStats::expectedBestDiff(double work)
+{
+    return work / M_LN2;
+}
+
+double SoloStats::bestPercentile(double work, double bestDiff)
+{
+    if (bestDiff <= 0.0) {
+        return 0.0;
+    }
+    return exp(-work / bestDiff);
+}
+
+double SoloStats::luck(const solo_totals_t &t)
+{
+    return t.expectedBlocks > 0.0 ? 100.0 * t.blocks / t.expectedBlocks : 0.0;
+}
+
+void SoloStats::add(solo_totals_t *t, double work, double networkDiff)
+{
+    t->work += work;
+    if (networkDiff > 0.0) {
+        t->expectedBlocks += work / networkDiff;
+        t->roundExpected += work / networkDiff;
+    }
+}
+
+void SoloStats::addWork(double countDiff, uint32_t nbits)
+{
+    if (nbits != m_nbits) {
+        m_nbits = nbits;
+        m_networkDiff = networkDifficulty(nbits);
+    }
+    add(&m_total, countDiff, m_networkDiff);
+    add(&m_session, countDiff, m_networkDiff);
+}
+
+bool SoloStats::addShare(double diff, uint32_t nbits)
+{
+    if (nbits != m_nbits) {
+        m_nbits = nbits;
+        m_networkDiff = networkDifficulty(nbits);
+    }
+
+    if (diff > m_total.bestDiff) {
+        m_total.bestDiff = diff;
+    }
+    if (diff > m_session.bestDiff) {
+        m_session.bestDiff = diff;
+    }
+
+    // like checkForFoundBlock(), a block is above the network difficulty
+    if (!m_networkDiff || diff <= m_networkDiff) {
+        return false;
+    }
+
+    m_total.blocks++;
+    m_total.roundExpected = 0.0;
+    m_session.blocks++;
+    m_session.roundExpected = 0.0;
+    return true;
+}
+
+bool SoloStats::serialize(char *buf, size_t len) const
+{
+    int n = snprintf(buf, len, "%d;%.17g;%.17g;%.17g;%.17g;%lu", SOLO_STATS_VERSION, m_total.work, m_total.expectedBlocks,
+                     m_total.roundExpected, m_total.bestDiff, (unsigned long) m_total.blocks);
+    return n > 0 && (size_t) n < len;
+}
+
+bool SoloStats::deserialize(const char *buf)
+{
+    int version = 0;
+    solo_totals_t t{};
+    unsigned long blocks = 0;
+
+    if (!buf || sscanf(buf, "%d;%lg;%lg;%lg;%lg;%lu", &version, &t.work, &t.expectedBlocks, &t.roundExpected, &t.bestDiff,
+                       &blocks) != 6) {
+        return false;
+    }
+    if (version != SOLO_STATS_VERSION || t.work < 0.0 || t.expectedBlocks < 0.0) {
+        return false;
+    }
+    t.blocks = (uint32_t) blocks;
+    m_total = t;
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Solo mining statistics, without external APIs.
+//
+// The network difficulty comes from the nbits of the jobs. The work done is
+// counted in difficulty-1 units (2^32 hashes) from the ASIC results: every
+// result above the counting difficulty D stands for D units on average.
+//
+// - expected blocks: sum of work / network difficulty at the time
+// - luck: blocks found / expected blocks
+// - effort: expected blocks since the last block found (100% = one block's
+//   worth of work)
+// - best share: with W units done, the count of shares >= x is Poisson with
+//   mean W / x. So P(best < x) = exp(-W / x), the median best share is
+//   W / ln(2) and the percentile of the observed best is exp(-W / best)
+//
+// The totals survive reboots (serialize()/deserialize()), the session starts
+// at boot. Not thread safe, the owner locks. No ESP-IDF dependencies (see
+// host/solo_stats_sim.cpp).
+
+// serialize() buffer
+#define SOLO_STATS_STRING_SIZE 128
+
+typedef struct
+{
+    double work;           // difficulty-1 units
+    double expectedBlocks;
+    double roundExpected;  // expected blocks since the last block
+    double bestDiff;
+    uint32_t blocks;
+} solo_totals_t;
+
+class SoloStats {
+  protected:
+    solo_totals_t m_total{};
+    solo_totals_t m_session{};
+
+    uint32_t m_nbits = 0;
+    double m_networkDiff = 0.0;
+
+    static void add(solo_totals_t *t, double work, double networkDiff);
+
+  public:
+    // same as calculateNetworkDifficulty()
+    static double networkDifficulty(uint32_t nbits);
+
+    // network hashrate in GH/s at 600 s per block
+    static double networkHashrate(double networkDiff);
+
+    // time to a block in seconds at the hashrate
+    static double expectedTimeToBlock(double networkDiff, double hashrateGhs);
+
+    // median of the best share after the work
+    static double expectedBestDiff(double work);
+
+    // probability that the best share after the work is below the value
+    static double bestPercentile(double work, double bestDiff);
+
+    // ASIC result above the counting difficulty
+    void addWork(double countDiff, uint32_t nbits);
+
+    // difficulty of an ASIC result, tracks the best and found blocks.
+    // Returns true on a block
+    bool addShare(double diff, uint32_t nbits);
+
+    double getNetworkDifficulty() const
+    {
+        return m_networkDiff;
+    }
+
+    const solo_totals_t &getTotal() const
+    {
+        return m_total;
+    }
+
+    const solo_totals_t &getSession() const
+    {
+        return m_session;
+    }
+
+    // luck in percent, 0 without work
+    static double luck(const solo_totals_t &t);
+
+    // text for NVS, false if the buffer is too small
+    bool serialize(char *buf, size_t len) const;
+    bool deserialize(const char *buf);
+};
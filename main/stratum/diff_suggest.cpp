@@ -0,0 +1,94 @@
+#include <string.h>
+
+#include "diff_suggest.h"
+
+void DiffSuggester::configure(uint32_t fixedDiff, uint16_t intervalS)
+{
+    m_fixedDiff = fixedDiff;
+    m_intervalS = intervalS;
+}
+
+void DiffSuggester::setPool(const char *host, uint16_t port)
+{
+    if (port == m_port && !strncmp(host, m_host, sizeof(m_host) - 1)) {
+        return;
+    }
+    strncpy(m_host, host, sizeof(m_host) - 1);
+    m_host[sizeof(m_host) - 1] = 0;
+    m_port = port;
+    m_poolDiff = 0;
+    m_poolWanted = 0;
+}
+
+void DiffSuggester::setPoolDifficulty(uint32_t diff)
+{
+    m_poolDiff = diff;
+    m_poolWanted = m_wanted;
+}
+
+uint32_t DiffSuggester::fromHashrate(double hashrateGhs, uint16_t intervalS)
+{
+    if (hashrateGhs <= 0.0 || !intervalS) {
+        return 0;
+    }
+    double diff = hashrateGhs * 1e9 * intervalS / 4294967296.0;
+    if (diff < 1.0) {
+        return 1;
+    }
+    if (diff > 4294967295.0) {
+        return UINT32_MAX;
+    }
+    return (uint32_t) diff;
+}
+
+static bool within(uint32_t a, uint32_t b, double factor)
+{
+    return a && b && a < b * factor && b < a * factor;
+}
+
+uint32_t DiffSuggester::onConnect(double hashrateGhs, uint64_t nowMs)
+{
+    uint32_t diff = m_fixedDiff;
+    uint32_t wanted = fromHashrate(hashrateGhs, m_intervalS);
+
+    if (m_intervalS) {
+        if (!wanted) {
+            // no hashrate yet, the last session is better than nothing
+            diff = m_poolDiff ? m_poolDiff : m_fixedDiff;
+        } else if (m_poolDiff && within(m_poolWanted, wanted, RESUGGEST_FACTOR)) {
+            diff = m_poolDiff;
+        } else {
+            diff = wanted;
+        }
+    }
+
+    m_suggested = diff;
+    m_wanted = wanted;
+    m_suggestedMs = nowMs;
+    return diff;
+}
+
+bool DiffSuggester::needsUpdate(double hashrateGhs, uint64_t nowMs, uint32_t *diff)
+{
+    if (!m_intervalS || nowMs - m_suggestedMs < RESUGGEST_MIN_MS) {
+        return false;
+    }
+
+    uint32_t wanted = fromHashrate(hashrateGhs, m_intervalS);
+    if (!wanted) {
+        return false;
+    }
+
+    // compared with the hashrate of the last suggestion, not with the pool's
+    // difficulty, its vardiff may aim for another interval
+    uint32_t last = m_wanted ? m_wanted : m_suggested;
+    if (within(last, wanted, RESUGGEST_FACTOR)) {
+        return false;
+    }
+
+    m_suggested = wanted;
+    m_wanted = wanted;
+    m_suggestedMs = nowMs;
+    *diff = wanted;
+    return true;
+}
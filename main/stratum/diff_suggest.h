@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+
+// Difficulty for mining.suggest_difficulty.
+//
+// Pools start vardiff from scratch on every connect. A start far below the
+// right difficulty floods the pool with shares until vardiff catches up, a
+// start far above leaves long gaps. The suggestion is derived from the
+// measured hashrate and a target share interval:
+//
+//   diff = hashrate * interval / 2^32
+//
+// - at connect the difficulty the pool assigned in the last session is
+//   suggested again while the hashrate is about the same, it's what the
+//   pool's vardiff converged to
+// - without a hashrate (after boot) the remembered or the configured fixed
+//   difficulty is used
+// - while connected the difficulty is suggested again when the hashrate
+//   moved it by a factor of 2, at most every 5 minutes. A pool whose vardiff
+//   settled elsewhere isn't pushed back
+// - interval 0 (the default) disables it, the fixed difficulty is
+//   suggested at connect like before
+//
+// One instance per pool, used by the stratum task only. No ESP-IDF
+// dependencies (see host/diff_suggest_sim.cpp).
+
+class DiffSuggester {
+  protected:
+    uint32_t m_fixedDiff = 0;
+    uint16_t m_intervalS = 0;
+
+    // last session
+    char m_host[64] = {};
+    uint16_t m_port = 0;
+    uint32_t m_poolDiff = 0;
+    uint32_t m_poolWanted = 0; // from the hashrate while the pool set it
+
+    uint32_t m_suggested = 0;
+    uint32_t m_wanted = 0; // from the hashrate at the last suggestion, 0 if unknown
+    uint64_t m_suggestedMs = 0;
+
+  public:
+    static constexpr double RESUGGEST_FACTOR = 2.0;
+    static constexpr uint64_t RESUGGEST_MIN_MS = 5 * 60 * 1000;
+
+    void configure(uint32_t fixedDiff, uint16_t intervalS);
+
+    // forgets the remembered difficulty when the pool changed
+    void setPool(const char *host, uint16_t port);
+
+    // mining.set_difficulty
+    void setPoolDifficulty(uint32_t diff);
+
+    // difficulty with the interval at the hashrate, 0 if unknown
+    static uint32_t fromHashrate(double hashrateGhs, uint16_t intervalS);
+
+    // difficulty to suggest after subscribe
+    uint32_t onConnect(double hashrateGhs, uint64_t nowMs);
+
+    // true when the difficulty should be suggested again
+    bool needsUpdate(double hashrateGhs, uint64_t nowMs, uint32_t *diff);
+
+    uint32_t getSuggested() const
+    {
+        return m_suggested;
+    }
+
+    uint32_t getPoolDifficulty() const
+    {
+        return m_poolDiff;
+    }
+};
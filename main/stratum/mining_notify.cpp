@@ -0,0 +1,73 @@
+#include <string.h>
+
+#include "mining_notify.h"
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+mining_notify *mining_notify_alloc(NotifyPool *pool, const char *job_id, const char *coinbase_1, const char *coinbase_2,
+                                   size_t n_merkle_branches)
+{
+    if (n_merkle_branches > MAX_MERKLE_BRANCHES) {
+        return nullptr;
+    }
+
+    job_id = job_id ? job_id : "";
+    coinbase_1 = coinbase_1 ? coinbase_1 : "";
+    coinbase_2 = coinbase_2 ? coinbase_2 : "";
+
+    size_t job_id_len = strlen(job_id) + 1;
+    size_t coinbase_1_len = strlen(coinbase_1) + 1;
+    size_t coinbase_2_len = strlen(coinbase_2) + 1;
+    size_t branches_len = n_merkle_branches * HASH_SIZE;
+
+    mining_notify *notify = (mining_notify *) pool->alloc(sizeof(mining_notify) + branches_len + job_id_len + coinbase_1_len +
+                                                          coinbase_2_len);
+    if (!notify) {
+        return nullptr;
+    }
+
+    // the branches follow the struct, then the strings
+    uint8_t *p = (uint8_t *) (notify + 1);
+    notify->_merkle_branches = (uint8_t (*)[HASH_SIZE]) p;
+    notify->n_merkle_branches = n_merkle_branches;
+    p += branches_len;
+
+    notify->job_id = (char *) memcpy(p, job_id, job_id_len);
+    p += job_id_len;
+    notify->coinbase_1 = (char *) memcpy(p, coinbase_1, coinbase_1_len);
+    p += coinbase_1_len;
+    notify->coinbase_2 = (char *) memcpy(p, coinbase_2, coinbase_2_len);
+
+    return notify;
+}
+
+bool mining_notify_hex2bin(const char *hex, uint8_t *bin, size_t len)
+{
+    if (!hex) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        int hi = hex_value(hex[2 * i]);
+        if (hi < 0) {
+            return false;
+        }
+        int lo = hex_value(hex[2 * i + 1]);
+        if (lo < 0) {
+            return false;
+        }
+        bin[i] = (uint8_t) (hi << 4 | lo);
+    }
+    return hex[2 * len] == 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "notify_pool.h"
+
+// a merkle path of more than 32 levels would be a block with more than
+// 2^32 transactions
+#define MAX_MERKLE_BRANCHES 32
+#define HASH_SIZE 32
+
+// A parsed mining.notify. Allocated with mining_notify_alloc() in one
+// reference counted block: the struct, the merkle branches (as many as the
+// notify has) and the strings. Shared read-only after parsing.
+typedef struct
+{
+    char *job_id;
+    uint8_t _prev_block_hash[HASH_SIZE];
+    char *coinbase_1;
+    char *coinbase_2;
+    uint8_t (*_merkle_branches)[HASH_SIZE];
+    size_t n_merkle_branches;
+    uint32_t version;
+    uint32_t version_mask;
+    uint32_t target;
+    uint32_t ntime;
+    uint32_t difficulty;
+} mining_notify;
+
+// zeroed notify with copies of the strings and room for the branches.
+// nullptr if there are too many branches or no memory
+mining_notify *mining_notify_alloc(NotifyPool *pool, const char *job_id, const char *coinbase_1, const char *coinbase_2,
+                                   size_t n_merkle_branches);
+
+// exactly 2 * len hex digits, false on anything else
+bool mining_notify_hex2bin(const char *hex, uint8_t *bin, size_t len);
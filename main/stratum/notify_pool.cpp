@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "notify_pool.h"
+
+#define BLOCK_STRIDE (sizeof(Header) + NOTIFY_POOL_BLOCK_SIZE)
+
+bool NotifyPool::init(void *(*callocFn)(size_t, size_t), void (*freeFn)(void *))
+{
+    pthread_mutex_lock(&m_lock);
+    m_calloc = callocFn;
+    m_free = freeFn;
+    m_blocks = (uint8_t *) m_calloc(NOTIFY_POOL_BLOCKS, BLOCK_STRIDE);
+    if (m_blocks) {
+        // lowest block first
+        for (int i = 0; i < NOTIFY_POOL_BLOCKS; i++) {
+            m_freeList[i] = NOTIFY_POOL_BLOCKS - 1 - i;
+        }
+        m_numFree = NOTIFY_POOL_BLOCKS;
+        m_stats.blocks = NOTIFY_POOL_BLOCKS;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return m_blocks != nullptr;
+}
+
+void *NotifyPool::alloc(size_t size)
+{
+    Header *h = nullptr;
+
+    pthread_mutex_lock(&m_lock);
+    m_stats.allocs++;
+    if (size > m_stats.largest) {
+        m_stats.largest = size;
+    }
+
+    if (size <= NOTIFY_POOL_BLOCK_SIZE && m_numFree) {
+        int block = m_freeList[--m_numFree];
+        h = (Header *) (m_blocks + block * BLOCK_STRIDE);
+        h->block = block;
+        if (++m_stats.used > m_stats.peakUsed) {
+            m_stats.peakUsed = m_stats.used;
+        }
+    } else {
+        m_stats.fallbacks++;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (h) {
+        memset(h + 1, 0, size);
+    } else {
+        h = (Header *) (m_calloc ? m_calloc(1, sizeof(Header) + size) : calloc(1, sizeof(Header) + size));
+        if (!h) {
+            return nullptr;
+        }
+        h->block = -1;
+    }
+
+    h->refs = 1;
+    h->size = size;
+    return h + 1;
+}
+
+void *NotifyPool::ref(void *payload)
+{
+    if (!payload) {
+        return nullptr;
+    }
+    pthread_mutex_lock(&m_lock);
+    header(payload)->refs++;
+    pthread_mutex_unlock(&m_lock);
+    return payload;
+}
+
+void NotifyPool::release(void *payload)
+{
+    if (!payload) {
+        return;
+    }
+
+    Header *h = header(payload);
+    bool outside = false;
+
+    pthread_mutex_lock(&m_lock);
+    if (--h->refs == 0) {
+        if (h->block >= 0) {
+            m_freeList[m_numFree++] = h->block;
+            m_stats.used--;
+        } else {
+            outside = true;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (outside) {
+        if (m_free) {
+            m_free(h);
+        } else {
+            free(h);
+        }
+    }
+}
+
+void NotifyPool::getStats(notify_pool_stats_t *out)
+{
+    pthread_mutex_lock(&m_lock);
+    *out = m_stats;
+    pthread_mutex_unlock(&m_lock);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Reference counted blocks for the mining.notify lifecycle.
+//
+// A notify used to be 4 heap allocations (struct, job ID, coinbase parts)
+// and the same strings were strdup'ed again for the job creation. With
+// notifies of varying size every few seconds and other allocations in
+// between, the heap fragmented over days.
+//
+// - the blocks are allocated once at boot (PSRAM) and reused
+// - a notify with its strings is one block, the job creation takes a
+//   reference instead of copying
+// - a notify larger than a block or an exhausted pool falls back to the
+//   allocator, counted in the stats
+//
+// No ESP-IDF dependencies (see host/notify_pool_soak.cpp).
+
+#define NOTIFY_POOL_BLOCKS 12
+#define NOTIFY_POOL_BLOCK_SIZE 4096
+
+typedef struct
+{
+    uint32_t blocks;
+    uint32_t used;
+    uint32_t peakUsed;
+    uint32_t allocs;
+    uint32_t fallbacks;   // allocated outside the pool
+    uint32_t largest;     // largest size requested
+} notify_pool_stats_t;
+
+class NotifyPool {
+  protected:
+    // in front of every payload
+    struct Header
+    {
+        int32_t refs;
+        int32_t block; // -1 outside the pool
+        uint32_t size;
+        uint32_t _pad;
+    };
+
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+    void *(*m_calloc)(size_t, size_t) = nullptr;
+    void (*m_free)(void *) = nullptr;
+
+    uint8_t *m_blocks = nullptr;
+    int m_freeList[NOTIFY_POOL_BLOCKS];
+    int m_numFree = 0;
+    notify_pool_stats_t m_stats{};
+
+    static Header *header(void *payload)
+    {
+        return (Header *) payload - 1;
+    }
+
+  public:
+    // allocates the blocks, without init() everything uses calloc() / free()
+    bool init(void *(*callocFn)(size_t, size_t), void (*freeFn)(void *));
+
+    // zeroed payload of the size, one reference. nullptr if out of memory
+    void *alloc(size_t size);
+
+    // additional reference, returns the payload
+    void *ref(void *payload);
+
+    // drops a reference, the last one frees the block
+    void release(void *payload);
+
+    void getStats(notify_pool_stats_t *out);
+};
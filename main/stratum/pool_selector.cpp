@@ -0,0 +1,440 @@
+#include <string.h>
+
+#include "pool_selector.h"
+
+// ------------ failover
+
+class FailoverStrategy : public PoolStrategy {
+  protected:
+    int m_selected = 0;
+
+    // the pool that should carry the work: the first one that is connected or
+    // didn't fail yet. -1 when all configured pools failed
+    int candidate(const pool_state_t *pools, int numPools) const
+    {
+        for (int i = 0; i < numPools; i++) {
+            if (pools[i].configured && (pools[i].connected || !pools[i].failures)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+  public:
+    const char *getName() const override
+    {
+        return "failover";
+    }
+
+    bool wantsConnection(const pool_state_t *pools, int numPools, int pool) const override
+    {
+        if (!pools[pool].configured) {
+            return false;
+        }
+        // pools before the candidate keep retrying, pools after it stay off
+        int c = candidate(pools, numPools);
+        return c < 0 || pool <= c;
+    }
+
+    void update(const pool_state_t *pools, int numPools, uint64_t nowMs) override
+    {
+        for (int i = 0; i < numPools; i++) {
+            if (pools[i].configured && pools[i].connected) {
+                m_selected = i;
+                return;
+            }
+        }
+        // nothing connected, keep the selection until the next pool is up
+    }
+
+    int getNextActivePool(const pool_state_t *pools, int numPools) override
+    {
+        return m_selected;
+    }
+
+    bool acceptsNotifyFrom(int pool) const override
+    {
+        return pool == m_selected;
+    }
+
+    int getSelected() const override
+    {
+        return m_selected;
+    }
+};
+
+// ------------ weighted
+
+// smooth weighted round robin (nginx): every pool with valid work gains its
+// weight per job, the one ahead gets the job and pays the sum of all weights.
+// Distributes exactly and interleaves instead of sending bursts
+class WeightedStrategy : public PoolStrategy {
+  protected:
+    int32_t m_current[STRATUM_MAX_POOLS]{};
+    int m_selected = 0;
+    int m_last = 0;
+
+    // with all weights at 0 every pool counts the same
+    static uint16_t effectiveWeight(const pool_state_t *pools, int numPools, int pool)
+    {
+        for (int i = 0; i < numPools; i++) {
+            if (pools[i].configured && pools[i].weight) {
+                return pools[pool].weight;
+            }
+        }
+        return 1;
+    }
+
+  public:
+    const char *getName() const override
+    {
+        return "weighted";
+    }
+
+    bool wantsConnection(const pool_state_t *pools, int numPools, int pool) const override
+    {
+        return pools[pool].configured && effectiveWeight(pools, numPools, pool);
+    }
+
+    void update(const pool_state_t *pools, int numPools, uint64_t nowMs) override
+    {
+        // the "main" pool is the heaviest connected one
+        int best = -1;
+        for (int i = 0; i < numPools; i++) {
+            if (!pools[i].connected) {
+                continue;
+            }
+            if (best < 0 || effectiveWeight(pools, numPools, i) > effectiveWeight(pools, numPools, best)) {
+                best = i;
+            }
+        }
+        if (best >= 0) {
+            m_selected = best;
+        }
+    }
+
+    int getNextActivePool(const pool_state_t *pools, int numPools) override
+    {
+        int32_t total = 0;
+        int best = -1;
+        for (int i = 0; i < numPools; i++) {
+            uint16_t w = effectiveWeight(pools, numPools, i);
+            if (!pools[i].validNotify || !w) {
+                // rejoins without accumulated credit
+                m_current[i] = 0;
+                continue;
+            }
+            m_current[i] += w;
+            total += w;
+            if (best < 0 || m_current[i] > m_current[best]) {
+                best = i;
+            }
+        }
+
+        // nobody has valid work, doesn't matter
+        if (best < 0) {
+            return m_last;
+        }
+
+        m_current[best] -= total;
+        m_last = best;
+        return best;
+    }
+
+    bool acceptsNotifyFrom(int pool) const override
+    {
+        return true;
+    }
+
+    int getSelected() const override
+    {
+        return m_selected;
+    }
+
+    bool isMultiPool() const override
+    {
+        return true;
+    }
+
+    friend class PoolSelector;
+};
+
+// ------------ latency
+
+class LatencyStrategy : public PoolStrategy {
+  protected:
+    int m_selected = -1;
+    uint64_t m_sinceMs = 0;
+
+    static bool eligible(const pool_state_t *p)
+    {
+        return p->configured && p->connected && p->validNotify;
+    }
+
+    // lowest known latency, pools without a measurement count after the
+    // measured ones in priority order
+    static int fastest(const pool_state_t *pools, int numPools)
+    {
+        int best = -1;
+        for (int i = 0; i < numPools; i++) {
+            if (!eligible(&pools[i])) {
+                continue;
+            }
+            if (best < 0) {
+                best = i;
+                continue;
+            }
+            float l = pools[i].latencyMs;
+            float b = pools[best].latencyMs;
+            if (l > 0 && (b <= 0 || l < b)) {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+  public:
+    const char *getName() const override
+    {
+        return "latency";
+    }
+
+    bool wantsConnection(const pool_state_t *pools, int numPools, int pool) const override
+    {
+        return pools[pool].configured;
+    }
+
+    void update(const pool_state_t *pools, int numPools, uint64_t nowMs) override
+    {
+        int best = fastest(pools, numPools);
+        if (best < 0) {
+            // nothing usable, keep the selection
+            return;
+        }
+
+        // the current pool is gone, switch right away
+        if (m_selected < 0 || !eligible(&pools[m_selected])) {
+            m_selected = best;
+            m_sinceMs = nowMs;
+            return;
+        }
+
+        if (best == m_selected || nowMs - m_sinceMs < PoolSelector::LATENCY_DWELL_MS) {
+            return;
+        }
+
+        float cur = pools[m_selected].latencyMs;
+        float next = pools[best].latencyMs;
+        if (next <= 0) {
+            return;
+        }
+
+        // a measured pool replaces an unmeasured one, otherwise it has to be
+        // clearly faster so jitter doesn't flip the pools
+        if (cur > 0 && (next > cur * (1.0f - PoolSelector::LATENCY_MARGIN) || cur - next < PoolSelector::LATENCY_MIN_GAIN_MS)) {
+            return;
+        }
+
+        m_selected = best;
+        m_sinceMs = nowMs;
+    }
+
+    int getNextActivePool(const pool_state_t *pools, int numPools) override
+    {
+        return m_selected < 0 ? 0 : m_selected;
+    }
+
+    // all pools keep fresh work so a switch doesn't wait for a notify
+    bool acceptsNotifyFrom(int pool) const override
+    {
+        return true;
+    }
+
+    int getSelected() const override
+    {
+        return m_selected < 0 ? 0 : m_selected;
+    }
+};
+
+// ------------ selector
+
+PoolSelector::PoolSelector(pool_mode_t mode, int numPools)
+{
+    memset(m_pools, 0, sizeof(m_pools));
+    m_numPools = (numPools < 1 || numPools > STRATUM_MAX_POOLS) ? STRATUM_MAX_POOLS : numPools;
+
+    switch (mode) {
+    case POOL_MODE_WEIGHTED:
+        m_strategy = new WeightedStrategy();
+        break;
+    case POOL_MODE_LATENCY:
+        m_strategy = new LatencyStrategy();
+        break;
+    default:
+        mode = POOL_MODE_FAILOVER;
+        m_strategy = new FailoverStrategy();
+        break;
+    }
+    m_mode = mode;
+}
+
+PoolSelector::~PoolSelector()
+{
+    delete m_strategy;
+}
+
+void PoolSelector::setConfigured(int pool, bool configured, uint16_t weight)
+{
+    if (!isValidPool(pool)) {
+        return;
+    }
+    m_pools[pool].configured = configured;
+    m_pools[pool].weight = weight;
+}
+
+void PoolSelector::connected(int pool)
+{
+    if (!isValidPool(pool)) {
+        return;
+    }
+    m_pools[pool].connected = true;
+    m_pools[pool].failures = 0;
+}
+
+void PoolSelector::disconnected(int pool, bool failed)
+{
+    if (!isValidPool(pool)) {
+        return;
+    }
+    m_pools[pool].connected = false;
+    m_pools[pool].validNotify = false;
+    m_pools[pool].asicDiff = 0;
+    if (failed) {
+        m_pools[pool].failures++;
+    }
+}
+
+void PoolSelector::connectFailed(int pool)
+{
+    if (!isValidPool(pool)) {
+        return;
+    }
+    m_pools[pool].failures++;
+}
+
+void PoolSelector::setValidNotify(int pool, bool valid)
+{
+    if (!isValidPool(pool)) {
+        return;
+    }
+    m_pools[pool].validNotify = valid;
+}
+
+void PoolSelector::setLatency(int pool, float ms)
+{
+    if (!isValidPool(pool)) {
+        return;
+    }
+    m_pools[pool].latencyMs = ms;
+}
+
+bool PoolSelector::rebalance(uint64_t nowMs)
+{
+    m_strategy->update(m_pools, m_numPools, nowMs);
+
+    bool changed = false;
+    for (int i = 0; i < m_numPools; i++) {
+        bool wanted = m_strategy->wantsConnection(m_pools, m_numPools, i);
+        if (wanted != m_pools[i].wanted) {
+            changed = true;
+        }
+        m_pools[i].wanted = wanted;
+        if (!wanted) {
+            // next time it's needed it gets a fresh start
+            m_pools[i].failures = 0;
+        }
+    }
+    return changed;
+}
+
+int PoolSelector::getNextActivePool()
+{
+    int pool = m_strategy->getNextActivePool(m_pools, m_numPools);
+    return isValidPool(pool) ? pool : 0;
+}
+
+bool PoolSelector::acceptsNotifyFrom(int pool) const
+{
+    return isValidPool(pool) && m_strategy->acceptsNotifyFrom(pool);
+}
+
+uint32_t PoolSelector::selectAsicDiff(int pool, uint32_t poolDiff, uint32_t asicMin, uint32_t asicMax)
+{
+    // shouldn't happen
+    if (!isValidPool(pool)) {
+        return asicMax;
+    }
+
+    uint32_t diff = poolDiff;
+
+    if (isMultiPool()) {
+        m_pools[pool].asicDiff = poolDiff;
+        m_pools[pool].diffErr = poolDiff < asicMin;
+
+        // the ASIC mines for all pools, the lowest difficulty wins
+        for (int i = 0; i < m_numPools; i++) {
+            if (m_pools[i].connected && m_pools[i].asicDiff && m_pools[i].asicDiff < diff) {
+                diff = m_pools[i].asicDiff;
+            }
+        }
+    }
+
+    // clamp to ASIC range
+    if (diff < asicMin) {
+        return asicMin;
+    }
+    if (diff > asicMax) {
+        return asicMax;
+    }
+    return diff;
+}
+
+int PoolSelector::getShare(int pool) const
+{
+    if (!isValidPool(pool) || !m_pools[pool].connected) {
+        return 0;
+    }
+
+    if (!isMultiPool()) {
+        return pool == getSelected() ? 100 : 0;
+    }
+
+    uint32_t total = 0;
+    for (int i = 0; i < m_numPools; i++) {
+        if (m_pools[i].connected) {
+            total += WeightedStrategy::effectiveWeight(m_pools, m_numPools, i);
+        }
+    }
+    if (!total) {
+        return 0;
+    }
+    return (int) ((WeightedStrategy::effectiveWeight(m_pools, m_numPools, pool) * 100 + total / 2) / total);
+}
+
+int PoolSelector::getNumConnected() const
+{
+    int num = 0;
+    for (int i = 0; i < m_numPools; i++) {
+        num += m_pools[i].connected;
+    }
+    return num;
+}
+
+const char *pool_short_name(int pool)
+{
+    static const char *names[STRATUM_MAX_POOLS] = {"Pri", "Sec", "P3", "P4"};
+    if (pool < 0 || pool >= STRATUM_MAX_POOLS) {
+        return "?";
+    }
+    return names[pool];
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <stdint.h>
+
+// Which pools are connected and which one gets the next ASIC job.
+//
+// The StratumManager feeds connection events into a PoolSelector and applies
+// the wanted connection states to its stratum tasks. The selection itself is
+// done by a strategy:
+//
+// - failover: pools are tried in order, a pool only connects after all pools
+//   before it failed. Work comes from the first connected pool, lower pools
+//   are disconnected as soon as a better one is back.
+// - weighted: all pools with a weight stay connected, jobs are spread by
+//   smooth weighted round robin over the pools with valid work.
+// - latency: all pools stay connected, work comes from the one with the
+//   lowest latency. A switch needs a clear margin and a minimum dwell time.
+//
+// No ESP-IDF dependencies (see host/pool_selector_sim.cpp), callers lock.
+
+#define STRATUM_MAX_POOLS 4
+
+typedef enum
+{
+    POOL_MODE_FAILOVER = 0,
+    POOL_MODE_WEIGHTED = 1,
+    POOL_MODE_LATENCY = 2,
+    POOL_MODE_MAX
+} pool_mode_t;
+
+typedef struct
+{
+    bool configured;    // has a host
+    bool wanted;        // connection requested by the strategy
+    bool connected;     // stratum traffic seen
+    bool validNotify;   // current job is usable
+    uint16_t failures;  // failed connects since the last success or stop
+    uint16_t weight;    // weighted mode, 0 disables the pool
+    float latencyMs;    // lower is better, 0 unknown
+    uint32_t asicDiff;  // pool difficulty of the last job, 0 none
+    bool diffErr;       // pool difficulty below the ASIC minimum
+} pool_state_t;
+
+class PoolStrategy {
+  public:
+    virtual ~PoolStrategy() {}
+
+    virtual const char *getName() const = 0;
+
+    // should the pool hold a connection
+    virtual bool wantsConnection(const pool_state_t *pools, int numPools, int pool) const = 0;
+
+    // after every state change
+    virtual void update(const pool_state_t *pools, int numPools, uint64_t nowMs) {}
+
+    virtual int getNextActivePool(const pool_state_t *pools, int numPools) = 0;
+    virtual bool acceptsNotifyFrom(int pool) const = 0;
+
+    // "current" pool for the display, ping and aggregated stats
+    virtual int getSelected() const = 0;
+
+    // more than one pool mines at the same time, the ASIC difficulty has to
+    // fit all of them
+    virtual bool isMultiPool() const
+    {
+        return false;
+    }
+};
+
+class PoolSelector {
+  protected:
+    pool_state_t m_pools[STRATUM_MAX_POOLS];
+    int m_numPools;
+    pool_mode_t m_mode;
+    PoolStrategy *m_strategy;
+
+  public:
+    // latency mode: a pool has to be this much faster to take over
+    static constexpr float LATENCY_MARGIN = 0.2f;
+    static constexpr float LATENCY_MIN_GAIN_MS = 5.0f;
+    static constexpr uint64_t LATENCY_DWELL_MS = 5 * 60 * 1000;
+
+    PoolSelector(pool_mode_t mode, int numPools);
+    ~PoolSelector();
+
+    pool_mode_t getMode() const
+    {
+        return m_mode;
+    }
+
+    const char *getModeName() const
+    {
+        return m_strategy->getName();
+    }
+
+    int getNumPools() const
+    {
+        return m_numPools;
+    }
+
+    const pool_state_t *get(int pool) const
+    {
+        return &m_pools[pool];
+    }
+
+    bool isValidPool(int pool) const
+    {
+        return pool >= 0 && pool < m_numPools;
+    }
+
+    // config
+    void setConfigured(int pool, bool configured, uint16_t weight);
+
+    // events of the stratum tasks
+    void connected(int pool);
+    void disconnected(int pool, bool failed);
+    void connectFailed(int pool);
+    void setValidNotify(int pool, bool valid);
+    void setLatency(int pool, float ms);
+
+    // re-evaluates the wanted connections, returns true if one changed.
+    // Stopped pools start over with zero failures
+    bool rebalance(uint64_t nowMs);
+
+    bool isWanted(int pool) const
+    {
+        return isValidPool(pool) && m_pools[pool].wanted;
+    }
+
+    int getNextActivePool();
+
+    bool acceptsNotifyFrom(int pool) const;
+
+    // ASIC difficulty for a job of the pool, clamped to the ASIC range
+    uint32_t selectAsicDiff(int pool, uint32_t poolDiff, uint32_t asicMin, uint32_t asicMax);
+
+    // uses the dual pool ASIC minimum
+    bool isMultiPool() const
+    {
+        return m_strategy->isMultiPool();
+    }
+
+    int getSelected() const
+    {
+        return m_strategy->getSelected();
+    }
+
+    // expected share of the work in percent
+    int getShare(int pool) const;
+
+    int getNumConnected() const;
+};
+
+// "Pri", "Sec", "P3", ...
+const char *pool_short_name(int pool);
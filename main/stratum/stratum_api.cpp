@@ -20,6 +20,7 @@
 #include <string.h>
 
 
+#include "global_state.h"
 #include "macros.h"
 
 // The logging tag for ESP logging.
@@ -38,33 +39,6 @@ StratumApi::~StratumApi()
     safe_free(m_requestBuffer);
 }
 
-uint8_t StratumApi::hex2val(char c)
-{
-    if (c >= '0' && c <= '9') {
-        return c - '0';
-    } else if (c >= 'a' && c <= 'f') {
-        return c - 'a' + 10;
-    } else if (c >= 'A' && c <= 'F') {
-        return c - 'A' + 10;
-    } else {
-        return 0;
-    }
-}
-
-size_t StratumApi::hex2bin(const char *hex, uint8_t *bin, size_t bin_len)
-{
-    size_t len = 0;
-    while (*hex && len < bin_len) {
-        bin[len] = hex2val(*hex++) << 4;
-        if (!*hex) {
-            len++;
-            break;
-        }
-        bin[len++] |= hex2val(*hex++);
-    }
-    return len;
-}
-
 void StratumApi::debugTx(const char *msg)
 {
     const char *newline = strchr(msg, '\n');
@@ -197,27 +171,34 @@ bool StratumApi::parseMethods(JsonDocument &doc, const char *method_str, Stratum
     switch (message->method) {
     case MINING_NOTIFY: {
         ESP_LOGI(TAG, "mining notify");
-        mining_notify *new_work = (mining_notify *) MALLOC(sizeof(mining_notify));
-
         JsonArray params = doc["params"].as<JsonArray>();
 
-        new_work->job_id = strdup(params[0].as<const char *>());
-        hex2bin(params[1].as<const char *>(), new_work->_prev_block_hash, HASH_SIZE);
+        // the branches are checked before anything is allocated
+        JsonArray merkle_branch = params[4].as<JsonArray>();
+        if (!params[4].is<JsonArray>() || merkle_branch.size() > MAX_MERKLE_BRANCHES) {
+            ESP_LOGE(TAG, "Invalid merkle branches (%d).", (int) merkle_branch.size());
+            return false;
+        }
 
-        new_work->coinbase_1 = strdup(params[2].as<const char *>());
-        new_work->coinbase_2 = strdup(params[3].as<const char *>());
+        mining_notify *new_work = allocMiningNotify(params[0].as<const char *>(), params[2].as<const char *>(),
+                                                    params[3].as<const char *>(), merkle_branch.size());
+        if (!new_work) {
+            ESP_LOGE(TAG, "No memory for mining notify.");
+            return false;
+        }
 
-        JsonArray merkle_branch = params[4].as<JsonArray>();
-        new_work->n_merkle_branches = merkle_branch.size();
-        if (new_work->n_merkle_branches > MAX_MERKLE_BRANCHES) {
-            ESP_LOGE(TAG, "Too many Merkle branches.");
+        if (!mining_notify_hex2bin(params[1].as<const char *>(), new_work->_prev_block_hash, HASH_SIZE)) {
+            ESP_LOGE(TAG, "Invalid previous block hash.");
             freeMiningNotify(new_work);
-            safe_free(new_work);
             return false;
         }
 
         for (size_t i = 0; i < new_work->n_merkle_branches; i++) {
-            hex2bin(merkle_branch[i].as<const char *>(), new_work->_merkle_branches[i], HASH_SIZE);
+            if (!mining_notify_hex2bin(merkle_branch[i].as<const char *>(), new_work->_merkle_branches[i], HASH_SIZE)) {
+                ESP_LOGE(TAG, "Invalid merkle branch %d.", (int) i);
+                freeMiningNotify(new_work);
+                return false;
+            }
         }
 
         new_work->version = strtoul(params[5].as<const char *>(), NULL, 16);
@@ -385,18 +366,30 @@ bool StratumApi::parse(StratumApiV1Message *message, JsonDocument &doc)
     }
 }
 
+//--------------------------------------------------------------------
+// allocMiningNotify()
+//--------------------------------------------------------------------
+mining_notify *StratumApi::allocMiningNotify(const char *job_id, const char *coinbase_1, const char *coinbase_2,
+                                             size_t n_merkle_branches)
+{
+    return mining_notify_alloc(&notifyPool, job_id, coinbase_1, coinbase_2, n_merkle_branches);
+}
+
+//--------------------------------------------------------------------
+// refMiningNotify()
+//--------------------------------------------------------------------
+mining_notify *StratumApi::refMiningNotify(mining_notify *params)
+{
+    return (mining_notify *) notifyPool.ref(params);
+}
+
 //--------------------------------------------------------------------
 // freeMiningNotify()
 //--------------------------------------------------------------------
 void StratumApi::freeMiningNotify(mining_notify *params)
 {
-    // nothing to free
-    if (!params) {
-        return;
-    }
-    safe_free(params->job_id);
-    safe_free(params->coinbase_1);
-    safe_free(params->coinbase_2);
+    // the last reference frees the block
+    notifyPool.release(params);
 }
 
 //--------------------------------------------------------------------
@@ -471,6 +464,17 @@ bool StratumApi::suggestDifficulty(StratumTransport *transport, uint32_t difficu
     return send(transport, m_requestBuffer);
 }
 
+//--------------------------------------------------------------------
+// resuggestDifficulty()
+//--------------------------------------------------------------------
+bool StratumApi::resuggestDifficulty(StratumTransport *transport, uint32_t difficulty)
+{
+    snprintf(m_requestBuffer, BUFFER_SIZE, "{\"id\": %d, \"method\": \"mining.suggest_difficulty\", \"params\": [%ld]}\n",
+             STRATUM_ID_SUGGEST_DIFFICULTY, difficulty);
+
+    return send(transport, m_requestBuffer);
+}
+
 //--------------------------------------------------------------------
 // authenticate()
 //--------------------------------------------------------------------
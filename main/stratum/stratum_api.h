@@ -3,12 +3,12 @@
 #include <cstddef>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include "ArduinoJson.h"
 
+#include "mining_notify.h"
 #include "stratum_transport.h"
 
-#define MAX_MERKLE_BRANCHES 32
-#define HASH_SIZE 32
 #define COINBASE_SIZE 100
 #define COINBASE2_SIZE 128
 
@@ -34,21 +34,6 @@ static const int STRATUM_ID_EXTRANONCE_SUBSCRIBE = 5;
 
 #define STRATUM_LAST_SETUP_ID STRATUM_ID_EXTRANONCE_SUBSCRIBE
 
-typedef struct
-{
-    char *job_id;
-    uint8_t _prev_block_hash[HASH_SIZE];
-    char *coinbase_1;
-    char *coinbase_2;
-    uint8_t _merkle_branches[MAX_MERKLE_BRANCHES][HASH_SIZE];
-    size_t n_merkle_branches;
-    uint32_t version;
-    uint32_t version_mask;
-    uint32_t target;
-    uint32_t ntime;
-    uint32_t difficulty;
-} mining_notify;
-
 typedef struct
 {
     char *extranonce_str;
@@ -85,10 +70,6 @@ class StratumApi {
     // Helper: logs a transmit message (removing any trailing newline).
     void debugTx(const char *msg);
 
-    // Helper functions for hex conversion.
-    static uint8_t hex2val(char c);
-    static size_t hex2bin(const char *hex, uint8_t *bin, size_t bin_len);
-
     // Helper: checks whether the socket is still connected.
     static int isSocketConnected(StratumTransport *transport);
 
@@ -116,6 +97,10 @@ class StratumApi {
     // Sends a suggest-difficulty message.
     bool suggestDifficulty(StratumTransport *transport, uint32_t difficulty);
 
+    // Suggests the difficulty again in a running session. Uses the setup ID so
+    // the response isn't counted as a share result.
+    bool resuggestDifficulty(StratumTransport *transport, uint32_t difficulty);
+
     // Sends an authentication message.
     bool authenticate(StratumTransport *transport, const char *username, const char *pass);
 
@@ -132,11 +117,26 @@ class StratumApi {
     // clear the message buffer
     void clearBuffer();
 
+    // a complete line is buffered, receiveJsonRpcLine() won't read
+    bool hasLine() const
+    {
+        return m_len && strchr(m_buffer, '\n');
+    }
+
     // Parses a received JSON string into a StratumApiV1Message.
     static bool parse(StratumApiV1Message* message, const char* stratum_json);
     static bool parse(StratumApiV1Message *message, JsonDocument &doc);
 
-    // Frees a mining_notify structure allocated in parse().
+    // mining_notify with copies of the strings and room for the merkle
+    // branches in one reference counted block
+    static mining_notify *allocMiningNotify(const char *job_id, const char *coinbase_1, const char *coinbase_2,
+                                            size_t n_merkle_branches);
+
+    // additional reference, the notify is shared and must not be modified
+    static mining_notify *refMiningNotify(mining_notify *params);
+
+    // Drops a reference to a mining_notify allocated in parse(), the last
+    // one frees it.
     static void freeMiningNotify(mining_notify *params);
 
 };
@@ -16,65 +16,65 @@ static bool strEq(const char *a, const char *b)
     return strcmp(a, b) == 0;
 }
 
-StratumConfig::StratumConfig(int pool)
+StratumConfig::StratumConfig(int pool) : m_pool(pool)
 {
-    if (!pool) {
-        m_primary = true;
+    load();
+}
+
+void StratumConfig::load()
+{
+    switch (m_pool) {
+    case 0:
         m_host = Config::getStratumURL();
         m_port = Config::getStratumPortNumber();
         m_user = Config::getStratumUser();
         m_password = Config::getStratumPass();
         m_enonceSub = Config::isStratumEnonceSubscribe();
         m_tls = Config::isStratumTLS();
-    } else {
-        m_primary = false;
+        m_tlsCert = Config::getStratumTLSCert();
+        break;
+    case 1:
         m_host = Config::getStratumFallbackURL();
         m_port = Config::getStratumFallbackPortNumber();
         m_user = Config::getStratumFallbackUser();
         m_password = Config::getStratumFallbackPass();
         m_enonceSub = Config::isStratumFallbackEnonceSubscribe();
         m_tls = Config::isStratumFallbackTLS();
+        m_tlsCert = Config::getStratumFallbackTLSCert();
+        break;
+    default:
+        m_host = Config::getExtraPoolURL(m_pool);
+        m_port = Config::getExtraPoolPortNumber(m_pool);
+        m_user = Config::getExtraPoolUser(m_pool);
+        m_password = Config::getExtraPoolPass(m_pool);
+        m_enonceSub = Config::isExtraPoolEnonceSubscribe(m_pool);
+        m_tls = Config::isExtraPoolTLS(m_pool);
+        m_tlsCert = Config::getExtraPoolTLSCert(m_pool);
+        break;
     }
 }
 
 bool StratumConfig::reload()
 {
     // Load new values
-    char *newHost = m_primary ? Config::getStratumURL() : Config::getStratumFallbackURL();
-    int newPort   = m_primary ? Config::getStratumPortNumber() : Config::getStratumFallbackPortNumber();
-    char *newUser = m_primary ? Config::getStratumUser() : Config::getStratumFallbackUser();
-    char *newPass = m_primary ? Config::getStratumPass() : Config::getStratumFallbackPass();
-    bool newEnsub = m_primary ? Config::isStratumEnonceSubscribe() : Config::isStratumFallbackEnonceSubscribe();
-    bool newTLS   = m_primary ? Config::isStratumTLS() : Config::isStratumFallbackTLS();
+    StratumConfig fresh(m_pool);
+
     // Compare
     bool same =
-        strEq(m_host, newHost) &&
-        m_port == newPort &&
-        strEq(m_user, newUser) &&
-        strEq(m_password, newPass) &&
-        m_enonceSub == newEnsub &&
-        m_tls == newTLS;
+        strEq(m_host, fresh.m_host) &&
+        m_port == fresh.m_port &&
+        strEq(m_user, fresh.m_user) &&
+        strEq(m_password, fresh.m_password) &&
+        m_enonceSub == fresh.m_enonceSub &&
+        m_tls == fresh.m_tls &&
+        strEq(m_tlsCert, fresh.m_tlsCert);
 
     if (same) {
-        // Free temporary values (they were newly allocated by Config::get)
-        safe_free(newHost);
-        safe_free(newUser);
-        safe_free(newPass);
         return false;
     }
 
-    // Update fields: first free old values
-    safe_free(m_host);
-    safe_free(m_user);
-    safe_free(m_password);
-
-    m_host       = newHost;
-    m_port       = newPort;
-    m_user       = newUser;
-    m_password   = newPass;
-    m_enonceSub  = newEnsub;
-    m_tls        = newTLS;
-
+    // Update fields (the old values are freed)
+    fresh.copyInto(this);
     return true;
 }
 
@@ -83,20 +83,22 @@ void StratumConfig::copyInto(StratumConfig *dst)
     safe_free(dst->m_host);
     safe_free(dst->m_user);
     safe_free(dst->m_password);
+    safe_free(dst->m_tlsCert);
 
-    dst->m_primary   = m_primary;
+    dst->m_pool      = m_pool;
     dst->m_host      = m_host ? strdup(m_host) : nullptr;
     dst->m_port      = m_port;
     dst->m_user      = m_user ? strdup(m_user) : nullptr;
     dst->m_password  = m_password ? strdup(m_password) : nullptr;
     dst->m_enonceSub = m_enonceSub;
     dst->m_tls       = m_tls;
+    dst->m_tlsCert   = m_tlsCert ? strdup(m_tlsCert) : nullptr;
 }
 
 
 /*
 void StratumConfig::toLog(const StratumConfig &cfg, const char* prefix) {
-    char c = cfg.m_primary ? 'P' : 'S';
+    char c = '1' + cfg.m_pool;
     ESP_LOGE(TAG, "%s [%c] host: %s", prefix, c, cfg.m_host ? cfg.m_host : "null");
     ESP_LOGE(TAG, "%s [%c] port: %d", prefix, c, cfg.m_port);
     ESP_LOGE(TAG, "%s [%c] user: %s", prefix, c, cfg.m_user ? cfg.m_user : "null");
@@ -9,13 +9,17 @@ class StratumTask;
 
 class StratumConfig {
   protected:
-    bool m_primary = false;
+    int m_pool = 0;
     char *m_host = nullptr;
     int m_port = 0;
     char *m_user = nullptr;
     char *m_password = nullptr;
     bool m_enonceSub = false;
     bool m_tls = false;
+    char *m_tlsCert = nullptr; // pinned PEM, empty for the bundle
+
+    // reads the settings of the pool from NVS
+    void load();
 
   public:
     StratumConfig(int pool);
@@ -25,6 +29,7 @@ class StratumConfig {
         safe_free(m_host);
         safe_free(m_user);
         safe_free(m_password);
+        safe_free(m_tlsCert);
     }
 
     void copyInto(StratumConfig *dst);
@@ -32,7 +37,13 @@ class StratumConfig {
 
     bool isPrimary()
     {
-        return m_primary;
+        return !m_pool;
+    }
+
+    // a pool without host is skipped
+    bool isConfigured()
+    {
+        return m_host && m_host[0];
     }
 
     const char *getHost()
@@ -64,6 +75,11 @@ class StratumConfig {
         return m_tls;
     }
 
+    const char *getTLSCert()
+    {
+        return m_tlsCert;
+    }
+
     //static void toLog(const StratumConfig &cfg, const char* prefix="");
 };
 
@@ -6,6 +6,7 @@
 #include "esp_sntp.h"
 #include "esp_task_wdt.h"
 #include "esp_timer.h"
+#include "esp_vfs_eventfd.h"
 #include "esp_wifi.h"
 #include "global_state.h"
 #include "lwip/dns.h"
@@ -14,53 +15,304 @@
 #include "boards/board.h"
 #include "connect.h"
 #include "create_jobs_task.h"
+#include "ws_telemetry.h"
 #include "global_state.h"
 #include "macros.h"
 #include "nvs_config.h"
+#include "periodic.hpp"
 #include "psram_allocator.h"
 #include "stratum_task.h"
 #include "system.h"
+#include "task_monitor.h"
 
 #include "stratum_config.h"
 #include "stratum_manager.h"
 #include "utils.h"
 
 // ------------  stratum manager
-StratumManager::StratumManager(PoolMode poolmode) : m_poolmode(poolmode)
+StratumManager::StratumManager(PoolMode poolmode) : m_poolmode(poolmode), m_selector((pool_mode_t) poolmode, STRATUM_MAX_POOLS)
 {
-    m_stratumTasks[0] = nullptr;
-    m_stratumTasks[1] = nullptr;
-
-    m_stratumConfig[0] = new StratumConfig(0);
-    m_stratumConfig[1] = new StratumConfig(1);
+    for (int i = 0; i < STRATUM_MAX_POOLS; i++) {
+        m_stratumConfig[i] = new StratumConfig(i);
+    }
 
     suffixString(0, m_totalBestDiffString, DIFF_STRING_SIZE, 0);
     suffixString(0, m_bestSessionDiffString, DIFF_STRING_SIZE, 0);
 }
 
-void StratumManager::connect(int index)
+bool StratumManager::isConnected(int index)
 {
-    m_stratumTasks[index]->connect();
+    return m_stratumTasks[index] && m_stratumTasks[index]->isConnected();
 }
 
-void StratumManager::disconnect(int index)
+bool StratumManager::isAnyConnected()
 {
-    m_stratumTasks[index]->disconnect();
+    return getNumConnectedPools() > 0;
 }
 
-bool StratumManager::isConnected(int index)
+int StratumManager::getNumConnectedPools()
 {
-    return m_stratumTasks[index] && m_stratumTasks[index]->isConnected();
+    int num = 0;
+    for (int i = 0; i < STRATUM_MAX_POOLS; i++) {
+        num += !!isConnected(i);
+    }
+    return num;
 }
 
-bool StratumManager::isAnyConnected()
+bool StratumManager::isPoolConfigured(int pool)
 {
-    return isConnected(PRIMARY) || isConnected(SECONDARY);
+    return m_selector.isValidPool(pool) && m_selector.get(pool)->configured;
 }
 
-int StratumManager::getNumConnectedPools()
+bool StratumManager::isPoolConnected(int pool)
+{
+    return m_selector.isValidPool(pool) && isConnected(pool);
+}
+
+void StratumManager::createTasks()
+{
+    static const char *stratumNames[STRATUM_MAX_POOLS] = {"stratum task (pri)", "stratum task (sec)", "stratum task (p3)",
+                                                          "stratum task (p4)"};
+    static const char *pingNames[STRATUM_MAX_POOLS] = {"ping task (pri)", "ping task (sec)", "ping task (p3)", "ping task (p4)"};
+
+    // one eventfd per stratum task to wake it on queued shares
+    static bool eventfdRegistered = false;
+    if (!eventfdRegistered) {
+        esp_vfs_eventfd_config_t config = {.max_fds = STRATUM_MAX_POOLS};
+        esp_err_t err = esp_vfs_eventfd_register(&config);
+        if (err != ESP_OK) {
+            ESP_LOGE(m_tag, "eventfd register failed: %s", esp_err_to_name(err));
+        }
+        eventfdRegistered = true;
+    }
+
+    for (int i = 0; i < STRATUM_MAX_POOLS; i++) {
+        // primary and secondary always exist, more pools when configured
+        if (m_stratumTasks[i] || (i >= 2 && !m_stratumConfig[i]->isConfigured())) {
+            continue;
+        }
+
+        m_stratumTasks[i] = new StratumTask(this, i);
+        task_create(TASK_STRATUM, m_stratumTasks[i]->taskWrapper, (void *) m_stratumTasks[i], NULL, stratumNames[i]);
+
+        m_pingTasks[i] = new PingTask(this, i);
+        task_create(TASK_PING, m_pingTasks[i]->ping_task_wrapper, (void *) m_pingTasks[i], NULL, pingNames[i]);
+    }
+}
+
+void StratumManager::updateLatency(int pool)
+{
+    // ping RTT is closest to what a notify needs, pools that don't answer
+    // pings are rated by the response time of their submits
+    double rtt = m_pingTasks[pool] ? m_pingTasks[pool]->get_last_ping_rtt() : 0.0;
+    m_selector.setLatency(pool, rtt > 0.0 ? (float) rtt : m_stats[pool].responseMs);
+}
+
+void StratumManager::applySelection()
+{
+    int selected = m_selector.getSelected();
+
+    for (int i = 0; i < STRATUM_MAX_POOLS; i++) {
+        updateLatency(i);
+    }
+
+    m_selector.rebalance(esp_timer_get_time() / 1000);
+
+    for (int i = 0; i < STRATUM_MAX_POOLS; i++) {
+        if (!m_stratumTasks[i]) {
+            continue;
+        }
+        if (m_selector.isWanted(i)) {
+            m_stratumTasks[i]->connect();
+        } else {
+            m_stratumTasks[i]->disconnect();
+        }
+    }
+
+    if (selected != m_selector.getSelected()) {
+        ESP_LOGI(m_tag, "%s: switched from %s to %s", m_selector.getModeName(), pool_short_name(selected),
+                 pool_short_name(m_selector.getSelected()));
+    }
+}
+
+void StratumManager::reconnectTimerCallback(int index)
+{
+    PThreadGuard lock(m_mutex);
+    applySelection();
+}
+
+void StratumManager::connectedCallback(int index)
+{
+    PThreadGuard lock(m_mutex);
+
+    m_selector.connected(index);
+    applySelection();
+}
+
+void StratumManager::disconnectedCallback(int index, bool failed)
+{
+    PThreadGuard lock(m_mutex);
+    create_job_invalidate(index);
+
+    m_stats[index].pendingCount = 0;
+
+    m_selector.disconnected(index, failed);
+    applySelection();
+}
+
+void StratumManager::connectFailedCallback(int index)
+{
+    PThreadGuard lock(m_mutex);
+
+    m_selector.connectFailed(index);
+    applySelection();
+}
+
+bool StratumManager::acceptsNotifyFrom(int pool)
+{
+    return m_selector.acceptsNotifyFrom(pool);
+}
+
+int StratumManager::getNextActivePool()
+{
+    PThreadGuard lock(m_mutex);
+    return m_selector.getNextActivePool();
+}
+
+uint32_t StratumManager::selectAsicDiff(int pool, uint32_t poolDiff)
+{
+    Board *board = SYSTEM_MODULE.getBoard();
+    uint32_t asicMax = board->getAsicMaxDifficulty();
+    uint32_t asicMin = m_selector.isMultiPool() ? board->getAsicMinDifficultyDualPool() : board->getAsicMinDifficulty();
+
+    // not locked, called under the job mutex which dispatch() takes under ours
+    return m_selector.selectAsicDiff(pool, poolDiff, asicMin, asicMax);
+}
+
+int StratumManager::getSelectedPool()
+{
+    return m_selector.getSelected();
+}
+
+bool StratumManager::isUsingFallback()
+{
+    return m_poolmode == PoolMode::FAILOVER && m_selector.getSelected() != 0;
+}
+
+int StratumManager::getCompatPingPoolIndex()
+{
+    return m_selector.getSelected();
+}
+
+int StratumManager::getNextDisplayPool(int pool)
+{
+    if (!m_selector.isMultiPool()) {
+        return m_selector.getSelected();
+    }
+    for (int i = 1; i <= STRATUM_MAX_POOLS; i++) {
+        int next = (pool + i) % STRATUM_MAX_POOLS;
+        if (m_selector.get(next)->wanted) {
+            return next;
+        }
+    }
+    return 0;
+}
+
+const char *StratumManager::getPoolHost(int pool)
+{
+    if (!m_selector.isValidPool(pool) || !m_stratumConfig[pool]) {
+        return "-";
+    }
+    return m_stratumConfig[pool]->getHost();
+}
+
+int StratumManager::getPoolPort(int pool)
+{
+    if (!m_selector.isValidPool(pool) || !m_stratumConfig[pool]) {
+        return 0;
+    }
+    return m_stratumConfig[pool]->getPort();
+}
+
+uint64_t StratumManager::getSharesAccepted(int pool)
+{
+    return m_selector.isValidPool(pool) ? m_stats[pool].accepted : 0;
+}
+
+uint64_t StratumManager::getSharesRejected(int pool)
+{
+    return m_selector.isValidPool(pool) ? m_stats[pool].rejected : 0;
+}
+
+uint32_t StratumManager::getPoolDifficulty(int pool)
+{
+    return m_selector.isValidPool(pool) ? m_stats[pool].poolDifficulty : 0;
+}
+
+float StratumManager::getPoolResponseMs(int pool)
+{
+    return m_selector.isValidPool(pool) ? m_stats[pool].responseMs : 0.0f;
+}
+
+int StratumManager::getActivePoolBalance(int pool)
 {
-    return !!isConnected(PRIMARY) + !!isConnected(SECONDARY);
+    return m_selector.getShare(pool);
+}
+
+float StratumManager::getActivePoolHashrate(int pool)
+{
+    return SYSTEM_MODULE.getCurrentHashrate() * (float) getActivePoolBalance(pool) / 100.0f;
+}
+
+uint64_t StratumManager::getSharesAccepted()
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < STRATUM_MAX_POOLS; i++) {
+        sum += m_stats[i].accepted;
+    }
+    return sum;
+}
+
+uint64_t StratumManager::getSharesRejected()
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < STRATUM_MAX_POOLS; i++) {
+        sum += m_stats[i].rejected;
+    }
+    return sum;
+}
+
+uint64_t StratumManager::getBestSessionDiff()
+{
+    uint64_t best = 0;
+    for (int i = 0; i < STRATUM_MAX_POOLS; i++) {
+        best = std::max(best, m_stats[i].bestSessionDiff);
+    }
+    return best;
+}
+
+int StratumManager::getPoolErrors()
+{
+    int sum = 0;
+    for (int i = 0; i < STRATUM_MAX_POOLS; i++) {
+        sum += m_stratumTasks[i] ? m_stratumTasks[i]->m_poolErrors : 0;
+    }
+    return sum;
+}
+
+uint32_t StratumManager::getPoolDifficulty()
+{
+    return m_stats[m_selector.getSelected()].poolDifficulty;
+}
+
+void StratumManager::acceptedShare(int pool)
+{
+    m_stats[pool].accepted++;
+}
+
+void StratumManager::rejectedShare(int pool)
+{
+    m_stats[pool].rejected++;
 }
 
 // This static wrapper converts the void* parameter into a StratumManager pointer
@@ -80,24 +332,15 @@ void StratumManager::task()
         ESP_LOGE("StratumManager", "Failed to add task to watchdog!");
     }
 
-    ESP_LOGI("StratumManager", "%s mode enabled", m_poolmode == PoolMode::DUAL ? "Dual Pool" : "Failover");
+    ESP_LOGI("StratumManager", "%s mode enabled", m_selector.getModeName());
 
-    // Create the Stratum tasks for both pools
-    for (int i = 0; i < 2; i++) {
-        m_stratumTasks[i] = new StratumTask(this, i);
-        xTaskCreate(m_stratumTasks[i]->taskWrapper, (i == 0) ? "stratum task (pri)" : "stratum task (sec)", 8192,
-                    (void *) m_stratumTasks[i], 5, NULL);
-
-        m_pingTasks[i] = new PingTask(this, i);
-        xTaskCreate(m_pingTasks[i]->ping_task_wrapper, (i == 0) ? "ping task (pri)" : "ping task (sec)", 4096,
-                    (void *) m_pingTasks[i], 1, NULL);
-    }
+    loadSoloStats();
 
-    if (m_poolmode == PoolMode::DUAL) {
-        connect(PRIMARY);
-        connect(SECONDARY);
-    } else {
-        connect(PRIMARY);
+    // Create the Stratum tasks for the pools
+    {
+        PThreadGuard lock(m_mutex);
+        createTasks();
+        applySelection();
     }
 
     m_initialized = true;
@@ -115,6 +358,12 @@ void StratumManager::task()
         }
         vTaskDelay(pdMS_TO_TICKS(30000));
 
+        // the work done since the last save is lost on a reboot
+        static Periodic every_10m(sec_to_us(600), false);
+        if (every_10m.due()) {
+            saveSoloStats();
+        }
+
         // Reset watchdog if there was a submit response within the last hour
         if (m_lastSubmitResponseTimestamp && ((esp_timer_get_time() - m_lastSubmitResponseTimestamp) / 1000000) < 3600) {
             esp_task_wdt_reset();
@@ -128,7 +377,7 @@ void StratumManager::freeStratumV1Message(StratumApiV1Message *message)
         return;
     }
     StratumApi::freeMiningNotify(message->mining_notification);
-    safe_free(message->mining_notification);
+    message->mining_notification = nullptr;
     safe_free(message->extranonce_str);
 }
 
@@ -166,8 +415,14 @@ void StratumManager::dispatch(int pool, JsonDocument &doc)
         create_job_mining_notify(pool, m_stratum_api_v1_message.mining_notification,
                                  m_stratum_api_v1_message.should_abandon_work || selected->m_firstJob);
 
-        if (m_stratum_api_v1_message.mining_notification->ntime) {
-            m_stratumTasks[pool]->m_validNotify = true;
+        // queued shares of the old jobs would only be rejected as stale
+        if (m_stratum_api_v1_message.should_abandon_work) {
+            selected->m_submitQueue.newEpoch();
+        }
+
+        if (m_stratum_api_v1_message.mining_notification->ntime && !m_selector.get(pool)->validNotify) {
+            m_selector.setValidNotify(pool, true);
+            applySelection();
         }
 
         selected->m_firstJob = false;
@@ -175,7 +430,8 @@ void StratumManager::dispatch(int pool, JsonDocument &doc)
     }
 
     case MINING_SET_DIFFICULTY: {
-        setPoolDifficulty(pool, m_stratum_api_v1_message.new_difficulty);
+        m_stats[pool].poolDifficulty = m_stratum_api_v1_message.new_difficulty;
+        selected->m_diff.setPoolDifficulty(m_stratum_api_v1_message.new_difficulty);
         if (create_job_set_difficulty(pool, m_stratum_api_v1_message.new_difficulty)) {
             ESP_LOGI(tag, "Set stratum difficulty: %ld", m_stratum_api_v1_message.new_difficulty);
         }
@@ -218,6 +474,26 @@ void StratumManager::dispatch(int pool, JsonDocument &doc)
             rejectedShare(pool);
         }
         m_lastSubmitResponseTimestamp = esp_timer_get_time();
+
+        // responses come in submit order
+        pool_stats_t *stats = &m_stats[pool];
+        if (stats->pendingCount) {
+            float ms = (m_lastSubmitResponseTimestamp - stats->pendingSubmits[stats->pendingHead]) / 1000.0f;
+            stats->pendingHead = (stats->pendingHead + 1) % STRATUM_PENDING_SUBMITS;
+            stats->pendingCount--;
+            stats->responseMs = stats->responseMs > 0.0f ? stats->responseMs * 0.8f + ms * 0.2f : ms;
+        }
+
+        if (ws_telemetry_wanted(WS_TELEMETRY_SHARE)) {
+            ws_telemetry_share_t share = {
+                .pool = (uint8_t) pool,
+                .accepted = m_stratum_api_v1_message.response_success,
+                .reserved = 0,
+                .shares_accepted = (uint32_t) getSharesAccepted(),
+                .shares_rejected = (uint32_t) getSharesRejected(),
+            };
+            ws_telemetry_publish(WS_TELEMETRY_SHARE, &share, sizeof(share));
+        }
         break;
     }
 
@@ -240,9 +516,9 @@ void StratumManager::dispatch(int pool, JsonDocument &doc)
 }
 
 void StratumManager::submitShare(int pool, const char *jobid, const char *extranonce_2, const uint32_t ntime, const uint32_t nonce,
-                                 const uint32_t version)
+                                 const uint32_t version, bool blockCandidate)
 {
-    if (!m_stratumTasks[pool]) {
+    if (!m_selector.isValidPool(pool) || !m_stratumTasks[pool]) {
         ESP_LOGE(m_tag, "stratum task is null");
         return;
     }
@@ -251,7 +527,22 @@ void StratumManager::submitShare(int pool, const char *jobid, const char *extran
         ESP_LOGE(m_tag, "selected pool not connected");
         return;
     }
-    m_stratumTasks[pool]->submitShare(jobid, extranonce_2, ntime, nonce, version);
+
+    // not locked, the queue has its own lock and the task doesn't go away
+    m_stratumTasks[pool]->submitShare(jobid, extranonce_2, ntime, nonce, version, blockCandidate);
+}
+
+void StratumManager::shareSent(int pool)
+{
+    PThreadGuard lock(m_mutex);
+    pool_stats_t *stats = &m_stats[pool];
+    // a lost response would shift all following ones, drop the oldest
+    if (stats->pendingCount == STRATUM_PENDING_SUBMITS) {
+        stats->pendingHead = (stats->pendingHead + 1) % STRATUM_PENDING_SUBMITS;
+        stats->pendingCount--;
+    }
+    stats->pendingSubmits[(stats->pendingHead + stats->pendingCount) % STRATUM_PENDING_SUBMITS] = esp_timer_get_time();
+    stats->pendingCount++;
 }
 
 // --- stratum config related; mutexed
@@ -264,36 +555,43 @@ void StratumManager::copyConfigInto(int pool, StratumConfig *dst) {
     m_stratumConfig[pool]->copyInto(dst);
 }
 
-void StratumManager::loadSettings(bool reconnect)
+void StratumManager::loadSettings()
 {
-    m_totalBestDiff = Config::getBestDiff();
-    m_totalFoundBlocks = Config::getTotalFoundBlocks();
+    bool changed[STRATUM_MAX_POOLS] = {};
 
-    suffixString(m_totalBestDiff, m_totalBestDiffString, DIFF_STRING_SIZE, 0);
+    {
+        PThreadGuard lock(m_mutex);
 
-    // init with the reconnect flag from the child class
-    bool requiresReconnect[2] = {reconnect, reconnect};
+        m_totalBestDiff = Config::getBestDiff();
+        m_totalFoundBlocks = Config::getTotalFoundBlocks();
 
-    // load and compare config
-    for (int i=0; i<2; i++) {
-        bool changed = m_stratumConfig[i]->reload();
-        if (changed) {
-            requiresReconnect[i] = true;
-        }
-    }
+        suffixString(m_totalBestDiff, m_totalBestDiffString, DIFF_STRING_SIZE, 0);
 
-    // reconnect the pools with changed configs
-    for (int i=0;i<2;i++) {
-        if (!requiresReconnect[i]) {
-            continue;
+        for (int i = 0; i < STRATUM_MAX_POOLS; i++) {
+            // load and compare config
+            changed[i] = m_stratumConfig[i]->reload();
+
+            // weights apply to the next job, no reconnect needed
+            m_selector.setConfigured(i, m_stratumConfig[i]->isConfigured(), Config::getPoolWeight(i));
+
+            // trigger a reconnect of the pools with changed configs
+            if (changed[i] && m_stratumTasks[i]) {
+                m_stratumTasks[i]->triggerReconnect();
+            }
         }
-        // trigger a reconnect
-        if (m_stratumTasks[i]) {
-            m_stratumTasks[i]->triggerReconnect();
+
+        // pools added on the UI
+        if (m_initialized) {
+            createTasks();
         }
 
-        // reset ping stats
-        if (m_pingTasks[i]) {
+        applySelection();
+    }
+
+    // reset ping stats, not under our lock because the ping task holds
+    // its own while it copies the config
+    for (int i = 0; i < STRATUM_MAX_POOLS; i++) {
+        if (changed[i] && m_pingTasks[i]) {
             m_pingTasks[i]->reset();
         }
     }
@@ -303,6 +601,13 @@ void StratumManager::saveSettings(const JsonDocument &doc) {
     if (doc["poolMode"].is<uint16_t>()) {
         Config::setPoolMode(doc["poolMode"].as<uint16_t>());
     }
+    // the balance of the dual pool UI sets the weights of the first two pools
+    if (doc["poolBalance"].is<uint16_t>()) {
+        uint16_t balance = doc["poolBalance"].as<uint16_t>();
+        Config::setPoolBalance(balance);
+        Config::setPoolWeight(0, balance);
+        Config::setPoolWeight(1, 100 - balance);
+    }
     if (doc["stratumURL"].is<const char*>()) {
         Config::setStratumURL(doc["stratumURL"].as<const char*>());
     }
@@ -321,6 +626,9 @@ void StratumManager::saveSettings(const JsonDocument &doc) {
     if (doc["stratumTLS"].is<bool>()) {
         Config::setStratumTLS(doc["stratumTLS"].as<bool>());
     }
+    if (doc["stratumTLSCert"].is<const char*>()) {
+        Config::setStratumTLSCert(doc["stratumTLSCert"].as<const char*>());
+    }
     if (doc["fallbackStratumURL"].is<const char*>()) {
         Config::setStratumFallbackURL(doc["fallbackStratumURL"].as<const char*>());
     }
@@ -339,12 +647,70 @@ void StratumManager::saveSettings(const JsonDocument &doc) {
     if (doc["fallbackStratumTLS"].is<bool>()) {
         Config::setStratumFallbackTLS(doc["fallbackStratumTLS"].as<bool>());
     }
+    if (doc["fallbackStratumTLSCert"].is<const char*>()) {
+        Config::setStratumFallbackTLSCert(doc["fallbackStratumTLSCert"].as<const char*>());
+    }
+
+    // pools 3 and 4: "pool3URL", "pool4Port", ...
+    for (int pool = 2; pool < STRATUM_MAX_POOLS; pool++) {
+        char key[32];
+        snprintf(key, sizeof(key), "pool%dURL", pool + 1);
+        if (doc[key].is<const char*>()) {
+            Config::setExtraPoolURL(pool, doc[key].as<const char*>());
+        }
+        snprintf(key, sizeof(key), "pool%dUser", pool + 1);
+        if (doc[key].is<const char*>()) {
+            Config::setExtraPoolUser(pool, doc[key].as<const char*>());
+        }
+        snprintf(key, sizeof(key), "pool%dPassword", pool + 1);
+        if (doc[key].is<const char*>()) {
+            Config::setExtraPoolPass(pool, doc[key].as<const char*>());
+        }
+        snprintf(key, sizeof(key), "pool%dPort", pool + 1);
+        if (doc[key].is<uint16_t>()) {
+            Config::setExtraPoolPortNumber(pool, doc[key].as<uint16_t>());
+        }
+        snprintf(key, sizeof(key), "pool%dEnonceSubscribe", pool + 1);
+        if (doc[key].is<bool>()) {
+            Config::setExtraPoolEnonceSubscribe(pool, doc[key].as<bool>());
+        }
+        snprintf(key, sizeof(key), "pool%dTLS", pool + 1);
+        if (doc[key].is<bool>()) {
+            Config::setExtraPoolTLS(pool, doc[key].as<bool>());
+        }
+        snprintf(key, sizeof(key), "pool%dTLSCert", pool + 1);
+        if (doc[key].is<const char*>()) {
+            Config::setExtraPoolTLSCert(pool, doc[key].as<const char*>());
+        }
+    }
+
+    // "pool1Weight" .. "pool4Weight", after poolBalance so they win
+    for (int pool = 0; pool < STRATUM_MAX_POOLS; pool++) {
+        char key[16];
+        snprintf(key, sizeof(key), "pool%dWeight", pool + 1);
+        if (doc[key].is<uint16_t>()) {
+            Config::setPoolWeight(pool, doc[key].as<uint16_t>());
+        }
+    }
 }
 
 // ---
 
 void StratumManager::checkForBestDiff(int pool, double diff, uint32_t nbits)
 {
+    PThreadGuard lock(m_mutex);
+
+    if (!m_selector.isValidPool(pool)) {
+        return;
+    }
+
+    m_solo.addShare(diff, nbits);
+
+    if ((uint64_t) diff > m_stats[pool].bestSessionDiff) {
+        m_stats[pool].bestSessionDiff = (uint64_t) diff;
+        suffixString(getBestSessionDiff(), m_bestSessionDiffString, DIFF_STRING_SIZE, 0);
+    }
+
     if ((uint64_t) diff <= m_totalBestDiff) {
         return;
     }
@@ -360,6 +726,8 @@ void StratumManager::checkForBestDiff(int pool, double diff, uint32_t nbits)
 
 void StratumManager::getManagerInfoJson(JsonObject &obj)
 {
+    PThreadGuard lock(m_mutex);
+
     obj["poolMode"] = Config::getPoolMode();
     obj["activePoolMode"] = getPoolMode();
 
@@ -369,6 +737,45 @@ void StratumManager::getManagerInfoJson(JsonObject &obj)
     obj["poolBalance"] = Config::getPoolBalance();
 
     obj["totalBestDiff"] = m_totalBestDiff;
+
+    obj["usingFallback"] = isUsingFallback();
+    obj["selected"] = m_selector.getSelected();
+
+    // index is the pool number, unconfigured pools are included
+    JsonArray arr = obj["pools"].to<JsonArray>();
+
+    for (int i = 0; i < STRATUM_MAX_POOLS; i++) {
+        const pool_state_t *state = m_selector.get(i);
+        JsonObject pool = arr.add<JsonObject>();
+
+        pool["configured"] = state->configured;
+        pool["host"] = getPoolHost(i);
+        pool["port"] = getPoolPort(i);
+        pool["connected"] = isConnected(i);
+        pool["weight"] = state->weight;
+        pool["share"] = m_selector.getShare(i);
+        pool["poolDifficulty"] = m_stats[i].poolDifficulty;
+        pool["poolDiffErr"] = state->diffErr;
+        pool["accepted"] = m_stats[i].accepted;
+        pool["rejected"] = m_stats[i].rejected;
+        pool["responseMs"] = m_stats[i].responseMs;
+        pool["pingRtt"]  = m_pingTasks[i] ? m_pingTasks[i]->get_last_ping_rtt() : 0;
+        pool["pingLoss"] = m_pingTasks[i] ? m_pingTasks[i]->get_recent_ping_loss() : 0;
+        pool["bestDiff"] = m_stats[i].bestSessionDiff;
+
+        enonce2_stats_t enonce2;
+        create_job_get_enonce2_stats(i, &enonce2);
+        pool["enonce2Wraps"] = enonce2.wraps;
+        pool["enonce2Exhausted"] = enonce2.exhausted;
+        pool["ntimeRollMax"] = enonce2.maxNtimeRoll;
+
+        if (m_stratumTasks[i]) {
+            submit_stats_t submit;
+            m_stratumTasks[i]->m_submitQueue.getStats(&submit);
+            pool["submitDropped"] = submit.droppedFull + submit.droppedStale + submit.droppedDisconnect;
+            pool["submitMaxWaitMs"] = submit.maxWaitUs / 1000;
+        }
+    }
 }
 
 void StratumManager::checkForFoundBlock(int pool, double diff, uint32_t nbits)
@@ -385,9 +792,78 @@ void StratumManager::checkForFoundBlock(int pool, double diff, uint32_t nbits)
     m_totalFoundBlocks++;
     Config::setTotalFoundBlocks(m_totalFoundBlocks);
 
+    // counted by checkForBestDiff(), the round effort starts over
+    saveSoloStats();
+
     discordAlerter.sendBlockFoundAlert(diff, networkDiff);
 }
 
+void StratumManager::countWork(double countDiff, uint32_t nbits)
+{
+    PThreadGuard lock(m_mutex);
+    m_solo.addWork(countDiff, nbits);
+}
+
+void StratumManager::loadSoloStats()
+{
+    char *str = Config::getSoloStats();
+    {
+        PThreadGuard lock(m_mutex);
+        if (str[0] && !m_solo.deserialize(str)) {
+            ESP_LOGW(m_tag, "invalid solo stats \"%s\", starting over", str);
+        }
+    }
+    safe_free(str);
+}
+
+void StratumManager::saveSoloStats()
+{
+    char str[SOLO_STATS_STRING_SIZE];
+    bool ok;
+    {
+        PThreadGuard lock(m_mutex);
+        ok = m_solo.serialize(str, sizeof(str));
+    }
+    // NVS writes are slow, not under the lock
+    if (ok) {
+        Config::setSoloStats(str);
+    }
+}
+
+SoloStats StratumManager::getSoloStats()
+{
+    PThreadGuard lock(m_mutex);
+    return m_solo;
+}
+
+void StratumManager::getSoloStatsJson(JsonObject &obj, double hashrateGhs)
+{
+    SoloStats solo = getSoloStats();
+    const solo_totals_t &total = solo.getTotal();
+    const solo_totals_t &session = solo.getSession();
+    double networkDiff = solo.getNetworkDifficulty();
+
+    obj["networkDifficulty"] = networkDiff;
+    obj["networkHashrate"] = SoloStats::networkHashrate(networkDiff);
+    obj["expectedTimeToBlock"] = SoloStats::expectedTimeToBlock(networkDiff, hashrateGhs);
+
+    obj["work"] = total.work;
+    obj["expectedBlocks"] = total.expectedBlocks;
+    obj["blocks"] = total.blocks;
+    obj["luck"] = SoloStats::luck(total);
+    obj["effort"] = total.roundExpected * 100.0;
+
+    // the best share against what the work should have found
+    obj["bestDiff"] = total.bestDiff;
+    obj["expectedBestDiff"] = SoloStats::expectedBestDiff(total.work);
+    obj["bestPercentile"] = SoloStats::bestPercentile(total.work, total.bestDiff) * 100.0;
+
+    obj["sessionWork"] = session.work;
+    obj["sessionBestDiff"] = session.bestDiff;
+    obj["sessionExpectedBestDiff"] = SoloStats::expectedBestDiff(session.work);
+    obj["sessionBestPercentile"] = SoloStats::bestPercentile(session.work, session.bestDiff) * 100.0;
+}
+
 const char *StratumManager::getResolvedIpForPool(int pool) const
 {
     if (!m_stratumTasks[pool]) {
@@ -404,7 +880,7 @@ double get_last_ping_rtt()
         return 0.0;
     }
     int idx = STRATUM_MANAGER->getCompatPingPoolIndex();
-    PingTask *task = STRATUM_MANAGER->getPingTask(idx); // kleiner Getter
+    PingTask *task = STRATUM_MANAGER->getPingTask(idx);
     return task ? task->get_last_ping_rtt() : 0.0;
 }
 
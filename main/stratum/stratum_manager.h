@@ -7,28 +7,46 @@
 
 #include "ArduinoJson.h"
 
+#include "pool_selector.h"
+#include "solo_stats.h"
 #include "stratum_task.h"
 #include "../tasks/ping_task.h"
 
 #define DIFF_STRING_SIZE 12
 
+// submits waiting for their response, for the response time per pool
+#define STRATUM_PENDING_SUBMITS 8
+
+typedef struct
+{
+    uint64_t accepted;
+    uint64_t rejected;
+    uint64_t bestSessionDiff;
+    uint32_t poolDifficulty;
+
+    // submit -> response time, EWMA
+    float responseMs;
+    int64_t pendingSubmits[STRATUM_PENDING_SUBMITS];
+    int pendingHead;
+    int pendingCount;
+} pool_stats_t;
+
 /**
  * @brief StratumManager handles pool selection, connection management, and failover.
+ *
+ * Up to STRATUM_MAX_POOLS pools, which of them are connected and which one
+ * gets the next job is decided by the strategy of the pool mode (see
+ * pool_selector.h). The mode is applied after a restart.
  */
 class StratumManager {
     friend StratumTask;
     friend PingTask;
   public:
-    enum Selected
-    {
-        PRIMARY = 0,
-        SECONDARY = 1
-    };
-
     enum PoolMode
     {
-        FAILOVER = 0,
-        DUAL = 1
+        FAILOVER = POOL_MODE_FAILOVER,
+        DUAL = POOL_MODE_WEIGHTED,
+        LATENCY = POOL_MODE_LATENCY
     };
 
   protected:
@@ -40,9 +58,12 @@ class StratumManager {
     PoolMode m_poolmode;                                 // default FAILOVER
     uint64_t m_lastSubmitResponseTimestamp = 0;              ///< Timestamp of last submitted share response
 
-    StratumTask *m_stratumTasks[2]{};                      ///< Primary and secondary Stratum tasks
-    PingTask *m_pingTasks[2]{};
-    StratumConfig *m_stratumConfig[2]{};
+    PoolSelector m_selector;                             ///< Connection and job routing of the pool mode
+
+    StratumTask *m_stratumTasks[STRATUM_MAX_POOLS]{};      ///< Stratum tasks, created for configured pools
+    PingTask *m_pingTasks[STRATUM_MAX_POOLS]{};
+    StratumConfig *m_stratumConfig[STRATUM_MAX_POOLS]{};
+    pool_stats_t m_stats[STRATUM_MAX_POOLS]{};
 
     uint32_t m_totalFoundBlocks = 0;
     uint32_t m_foundBlocks = 0;
@@ -52,6 +73,8 @@ class StratumManager {
     char m_totalBestDiffString[DIFF_STRING_SIZE]{};        // String representation of the best difficulty
     char m_bestSessionDiffString[DIFF_STRING_SIZE]{}; // String representation of the best session difficulty
 
+    SoloStats m_solo; ///< Network difficulty, luck and best share statistics
+
     bool m_initialized = false;
 
     PoolMode getPoolMode() const
@@ -62,76 +85,123 @@ class StratumManager {
     void copyConfigInto(int pool, StratumConfig *dst);
 
     // Helper methods for connection management
-    void connect(int index);     ///< Connect to a specified pool (0 = primary, 1 = secondary)
-    void disconnect(int index);  ///< Disconnect from a specified pool
     bool isConnected(int index); ///< Check if a pool is connected
 
+    // creates the tasks of configured pools that don't have one yet
+    void createTasks();
+
+    // re-evaluates the strategy and starts / stops the pools, locked
+    void applySelection();
+
+    // ping RTT or submit response time
+    void updateLatency(int pool);
+
     // Handles incoming Stratum responses
     void dispatch(int pool, JsonDocument &doc);
 
     // Core Stratum management task
     void task();
 
-    // Clears queued mining jobs
-    void cleanQueue();
-
     void freeStratumV1Message(StratumApiV1Message *message);
 
-    // abstract methods
-    // reconnect logic for failover mode
-    virtual void reconnectTimerCallback(int index) = 0;
-    virtual void connectedCallback(int index) = 0;
-    virtual void disconnectedCallback(int index) = 0;
-    virtual bool acceptsNotifyFrom(int pool) = 0;
+    // solo stats from / to NVS, locks
+    void loadSoloStats();
+    void saveSoloStats();
+
+    // callbacks of the stratum tasks
+    void reconnectTimerCallback(int index);
+    void connectedCallback(int index);
+    void disconnectedCallback(int index, bool failed);
+    void connectFailedCallback(int index);
+
+    bool acceptsNotifyFrom(int pool);
 
-    virtual void acceptedShare(int pool) = 0;
-    virtual void rejectedShare(int pool) = 0;
-    virtual void setPoolDifficulty(int pool, uint32_t diff) = 0;
+    void acceptedShare(int pool);
+    void rejectedShare(int pool);
 
-    virtual int getPoolMode() = 0;
+    // the stratum task is about to send a queued share
+    void shareSent(int pool);
 
   public:
     StratumManager(PoolMode mode);
     static void taskWrapper(void *pvParameters); ///< Wrapper function for task execution
 
-    // Submit shares to the active Stratum pool
+    // Queues a share for the pool, block candidates are sent first
     void submitShare(int pool, const char *jobid, const char *extranonce_2, const uint32_t ntime, const uint32_t nonce,
-                     const uint32_t version);
+                     const uint32_t version, bool blockCandidate);
 
     void checkForFoundBlock(int pool, double diff, uint32_t nbits);
+    void checkForBestDiff(int pool, double diff, uint32_t nbits);
+
+    // ASIC result above the counting difficulty for the solo statistics
+    void countWork(double countDiff, uint32_t nbits);
 
     bool isAnyConnected();
     int getNumConnectedPools();
 
-    virtual bool isDualPool() const { return false; }
-    virtual bool isFallback() const { return false; }
-
-    virtual void getManagerInfoJson(JsonObject &obj);
+    int getNumPools() const
+    {
+        return m_selector.getNumPools();
+    }
 
-    virtual void loadSettings() = 0;
-    virtual void loadSettings(bool reconnect);
-    virtual void saveSettings(const JsonDocument &doc);
+    bool isPoolConfigured(int pool);
 
-    virtual bool isUsingFallback() {
-        return false;
+    // more than one pool gets work at the same time
+    bool isMultiPool() const
+    {
+        return m_selector.isMultiPool();
     }
 
-    // abstract
-    virtual const char *getResolvedIpForPool(int pool) const;
+    // next configured pool after `pool` for pages that cycle through the pools
+    int getNextDisplayPool(int pool);
+
+    void getManagerInfoJson(JsonObject &obj);
+
+    // hashrate in GH/s for the expected time to block
+    void getSoloStatsJson(JsonObject &obj, double hashrateGhs);
 
-    virtual int getNextActivePool() = 0;
+    // copy of the solo statistics
+    SoloStats getSoloStats();
 
-    virtual uint32_t selectAsicDiff(int pool, uint32_t poolDiff) = 0;
+    void loadSettings();
+    void saveSettings(const JsonDocument &doc);
 
-    virtual void checkForBestDiff(int pool, double diff, uint32_t nbits) = 0;
+    // failover mode works on a backup pool
+    bool isUsingFallback();
+
+    const char *getResolvedIpForPool(int pool) const;
+
+    int getNextActivePool();
+
+    uint32_t selectAsicDiff(int pool, uint32_t poolDiff);
 
     bool isInitialized() {
         return m_initialized;
     }
 
+    // per pool
+    const char *getPoolHost(int pool);
+    int getPoolPort(int pool);
+    bool isPoolConnected(int pool);
+    uint64_t getSharesAccepted(int pool);
+    uint64_t getSharesRejected(int pool);
+    uint32_t getPoolDifficulty(int pool);
+    float getPoolResponseMs(int pool);
+    int getActivePoolBalance(int pool);
+    float getActivePoolHashrate(int pool);
+
+    // "current" pool of the mode (failover: the working pool, weighted: the
+    // heaviest one, latency: the fastest one)
+    int getSelectedPool();
+
+    const char *getPoolModeName() const
+    {
+        return m_selector.getModeName();
+    }
+
     // compatibility
-    virtual uint64_t getSharesAccepted() = 0;
-    virtual uint64_t getSharesRejected() = 0;
+    uint64_t getSharesAccepted();
+    uint64_t getSharesRejected();
 
     uint32_t getTotalFoundBlocks() {
         return m_totalFoundBlocks;
@@ -149,19 +219,22 @@ class StratumManager {
         return m_totalBestDiff;
     }
 
-    virtual uint64_t getBestSessionDiff() = 0;
+    uint64_t getBestSessionDiff();
 
     const char *getBestSessionDiffString() {
         return m_bestSessionDiffString;
     }
 
-    virtual int getPoolErrors() = 0;
+    int getPoolErrors();
 
-    virtual uint32_t getPoolDifficulty() = 0;
+    uint32_t getPoolDifficulty();
 
-    virtual int getCompatPingPoolIndex() = 0;
+    int getCompatPingPoolIndex();
 
     PingTask *getPingTask(int i) {
+        if (i < 0 || i >= STRATUM_MAX_POOLS) {
+            return nullptr;
+        }
         return m_pingTasks[i];
     }
 };
@@ -1,11 +1,13 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "esp_log.h"
 #include "esp_sntp.h"
 #include "esp_task_wdt.h"
 #include "esp_timer.h"
+#include "esp_vfs_eventfd.h"
 #include "esp_wifi.h"
 #include "global_state.h"
 #include "lwip/dns.h"
@@ -18,6 +20,7 @@
 #include "macros.h"
 #include "nvs_config.h"
 #include "psram_allocator.h"
+#include "pool_selector.h"
 #include "stratum_task.h"
 #include "system.h"
 #include "guards.h"
@@ -31,6 +34,13 @@
         }                                                                                                                          \
     } while (0)
 
+// how often the loop looks for queued shares while the pool is quiet when
+// the task has no eventfd to be woken on a push
+#define STRATUM_SUBMIT_POLL_MS 10
+
+// how often the hashrate is compared with the suggested difficulty
+#define STRATUM_DIFF_CHECK_US (30 * 1000000ll)
+
 // fallback can nicely be tested with netcat
 // mkfifo /tmp/ncpipe
 // nc -l -p 4444 < /tmp/ncpipe | nc solo.ckpool.org 3333 > /tmp/ncpipe
@@ -38,13 +48,25 @@
 StratumTask::StratumTask(StratumManager *manager, int index)
     : m_manager(manager), m_index(index)
 {
-    if (!index) {
-        m_tag = "stratum task (Pri)";
-    } else {
-        m_tag = "stratum task (Sec)";
-    }
+    static const char *tags[STRATUM_MAX_POOLS] = {"stratum task (Pri)", "stratum task (Sec)", "stratum task (P3)",
+                                                  "stratum task (P4)"};
+    m_tag = tags[index];
 
     m_config = new StratumConfig(index);
+
+    // needs esp_vfs_eventfd_register(), see StratumManager::createTasks()
+    m_wakeFd = eventfd(0, 0);
+    if (m_wakeFd < 0) {
+        ESP_LOGW(m_tag, "no eventfd, polling for queued shares");
+    }
+}
+
+void StratumTask::wake()
+{
+    if (m_wakeFd >= 0) {
+        uint64_t one = 1;
+        write(m_wakeFd, &one, sizeof(one));
+    }
 }
 
 bool StratumTask::isWifiConnected()
@@ -189,7 +211,12 @@ void StratumTask::stratumLoop()
     success = success && m_stratumAPI.authenticate(m_transport, m_config->getUser(), m_config->getPassword());
 
     // mining.suggest_difficulty - ID: 4
-    success = success && m_stratumAPI.suggestDifficulty(m_transport, Config::getStratumDifficulty());
+    m_diff.configure(Config::getStratumDifficulty(), Config::getShareInterval());
+    m_diff.setPool(m_config->getHost(), m_config->getPort());
+    uint32_t diff = m_diff.onConnect(getHashrateEstimate(), esp_timer_get_time() / 1000);
+    m_diffCheckUs = esp_timer_get_time();
+    ESP_LOGI(m_tag, "suggesting difficulty %lu", diff);
+    success = success && m_stratumAPI.suggestDifficulty(m_transport, diff);
 
     // mining.mining.extranonce.subscribe - ID 5
     if (m_config->isEnonceSubscribeEnabled()) {
@@ -216,7 +243,13 @@ void StratumTask::stratumLoop()
             }
             break;
         }
-        line = m_stratumAPI.receiveJsonRpcLine(m_transport);
+        // shares go out while we wait
+        if (waitForPool() < 0) {
+            ESP_LOGE(m_tag, "Failed to wait for pool data, reconnecting ...");
+            return;
+        }
+
+        line = m_reconnect ? nullptr : m_stratumAPI.receiveJsonRpcLine(m_transport);
 
         // release memory when out of scope
         MemoryGuard g(line);
@@ -274,6 +307,7 @@ void StratumTask::disconnect()
 
 void StratumTask::triggerReconnect() {
     m_reconnect = true;
+    wake();
 }
 
 
@@ -296,9 +330,15 @@ void StratumTask::connectedCallback()
 }
 
 // Disconnected Callback
-void StratumTask::disconnectedCallback()
+void StratumTask::disconnectedCallback(bool failed)
+{
+    m_manager->disconnectedCallback(m_index, failed);
+}
+
+// Connect failed Callback
+void StratumTask::connectFailedCallback()
 {
-    m_manager->disconnectedCallback(m_index);
+    m_manager->connectFailedCallback(m_index);
 }
 
 // Start the reconnect timer
@@ -323,9 +363,81 @@ void StratumTask::stopReconnectTimer()
 }
 
 void StratumTask::submitShare(const char *jobid, const char *extranonce_2, const uint32_t ntime, const uint32_t nonce,
-                              const uint32_t version)
+                              const uint32_t version, bool blockCandidate)
+{
+    if (!m_submitQueue.push(jobid, extranonce_2, ntime, nonce, version, blockCandidate, esp_timer_get_time())) {
+        ESP_LOGE(m_tag, "submit queue full, share dropped");
+    }
+    wake();
+}
+
+bool StratumTask::sendQueuedShares()
+{
+    submit_entry_t share;
+    while (m_submitQueue.pop(&share, esp_timer_get_time())) {
+        if (share.blockCandidate) {
+            ESP_LOGI(m_tag, "sending block candidate, queued %lld us", esp_timer_get_time() - share.queuedUs);
+        }
+        m_manager->shareSent(m_index);
+        if (!m_stratumAPI.submitShare(m_transport, m_config->getUser(), share.jobid, share.extranonce2, share.ntime,
+                                      share.nonce, share.version)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double StratumTask::getHashrateEstimate()
+{
+    double hashrate = m_manager->getActivePoolHashrate(m_index);
+    if (hashrate > 0.0) {
+        return hashrate;
+    }
+    // not connected yet, in the single pool modes it gets everything
+    return m_manager->isMultiPool() ? 0.0 : SYSTEM_MODULE.getCurrentHashrate();
+}
+
+bool StratumTask::updateDifficulty()
 {
-    m_stratumAPI.submitShare(m_transport, m_config->getUser(), jobid, extranonce_2, ntime, nonce, version);
+    int64_t now = esp_timer_get_time();
+    if (now - m_diffCheckUs < STRATUM_DIFF_CHECK_US) {
+        return true;
+    }
+    m_diffCheckUs = now;
+
+    uint32_t diff;
+    if (!m_diff.needsUpdate(getHashrateEstimate(), now / 1000, &diff)) {
+        return true;
+    }
+    ESP_LOGI(m_tag, "hashrate changed, suggesting difficulty %lu", diff);
+    return m_stratumAPI.resuggestDifficulty(m_transport, diff);
+}
+
+int StratumTask::waitForPool()
+{
+    while (1) {
+        if (!sendQueuedShares() || !updateDifficulty()) {
+            return -1;
+        }
+        if (m_reconnect) {
+            return 0;
+        }
+        // a line from the last read is still buffered
+        if (m_stratumAPI.hasLine()) {
+            return 1;
+        }
+        // blocks until the pool sends, a share is queued or the next
+        // difficulty check is due
+        int waitMs = STRATUM_SUBMIT_POLL_MS;
+        if (m_wakeFd >= 0) {
+            waitMs = (int) ((m_diffCheckUs + STRATUM_DIFF_CHECK_US - esp_timer_get_time()) / 1000) + 1;
+            waitMs = waitMs > 0 ? waitMs : 0;
+        }
+        int ready = m_transport->poll(waitMs, m_wakeFd);
+        if (ready != 0) {
+            return ready;
+        }
+    }
 }
 
 void StratumTask::taskWrapper(void *pvParameters)
@@ -377,14 +489,16 @@ void StratumTask::task()
         char ip[INET_ADDRSTRLEN] = {0};
         if (!resolveHostname(m_config->getHost(), ip, sizeof(ip))) {
             ESP_LOGE(m_tag, "%s couldn't be resolved!", m_config->getHost());
+            connectFailedCallback();
             vTaskDelay(pdMS_TO_TICKS(10000));
             continue;
         }
 
-        ESP_LOGI(m_tag, "Connecting to: stratum+tcp://%s:%d (%s)", m_config->getHost(), m_config->getPort(), ip);
+        ESP_LOGI(m_tag, "Connecting to: stratum+%s://%s:%d (%s)", m_config->isTLS() ? "ssl" : "tcp", m_config->getHost(), m_config->getPort(), ip);
 
         // switch transports
         if (m_config->isTLS()) {
+            m_tlsTransport.setPinnedCert(m_config->getTLSCert());
             m_transport = &m_tlsTransport;
         } else {
             m_transport = &m_tcpTransport;
@@ -392,6 +506,7 @@ void StratumTask::task()
 
         if (!m_transport->connect(m_config->getHost(), ip, m_config->getPort())) {
             ESP_LOGE(m_tag, "Socket unable to connect to %s:%d (errno %d)", m_config->getHost(), m_config->getPort(), errno);
+            connectFailedCallback();
             vTaskDelay(pdMS_TO_TICKS(10000));
             continue;
         }
@@ -411,7 +526,11 @@ void StratumTask::task()
         ESP_LOGIE(m_reconnect, m_tag, "Shutdown socket ...");
         m_transport->close();
 
-        disconnectedCallback();
+        // job IDs are only valid in the session
+        m_submitQueue.clear();
+
+        // a stop or reconnect request isn't the pool's fault
+        disconnectedCallback(!m_reconnect && !m_stopFlag);
         m_isConnected = false;
 
         // skip reconnect delay
@@ -9,10 +9,10 @@
 #include "stratum_api.h"
 #include "stratum_config.h"
 #include "stratum_transport.h"
+#include "diff_suggest.h"
+#include "submit_queue.h"
 
 class StratumManager;
-class StratumManagerFallback;
-class StratumManagerDualPool;
 
 
 /**
@@ -20,13 +20,11 @@ class StratumManagerDualPool;
  */
 class StratumTask {
     friend StratumManager;
-    friend StratumManagerFallback;
-    friend StratumManagerDualPool;
 
   protected:
     StratumManager *m_manager = nullptr; ///< Reference to the StratumManager
     StratumConfig *m_config = nullptr;
-    int m_index = 0;                     ///< Index of the Stratum task (0 = primary, 1 = secondary)
+    int m_index = 0;                     ///< Index of the pool (0 = primary, 1 = secondary, ...)
 
     StratumApi m_stratumAPI;     ///< API instance for Stratum communication
     const char *m_tag = nullptr; ///< Debug tag for logging
@@ -37,7 +35,6 @@ class StratumTask {
 
     bool m_stopFlag = true;    ///< Stop flag for the task
     bool m_firstJob = true;
-    bool m_validNotify = false; // flag if the mining notify is valid
     int m_poolErrors = 0;
 
     volatile bool m_isConnected = false; ///< Connection state flag
@@ -65,12 +62,37 @@ class StratumTask {
     void triggerReconnect();
 
     // Connection event callbacks
-    void connectedCallback();    ///< Called when a pool successfully connects
-    void disconnectedCallback(); ///< Called when a pool disconnects
+    void connectedCallback();               ///< Called when a pool successfully connects
+    void disconnectedCallback(bool failed); ///< Called when a pool disconnects
+    void connectFailedCallback();           ///< Called when the pool couldn't be reached
 
-    // Submit mining shares to the pool
+    // Shares found by the ASICs, sent by this task between reads
+    SubmitQueue m_submitQueue;
+
+    // wakes waitForPool() on a queued share or a reconnect request
+    int m_wakeFd = -1;
+    void wake();
+
+    // queues a share, doesn't block
     void submitShare(const char *jobid, const char *extranonce_2, const uint32_t ntime, const uint32_t nonce,
-                     const uint32_t version);
+                     const uint32_t version, bool blockCandidate);
+
+    // sends the queued shares
+    bool sendQueuedShares();
+
+    // sends queued shares until the pool has data, >0 data, 0 reconnect
+    // requested, <0 error. Blocks in between
+    int waitForPool();
+
+    // suggested difficulty, remembers the pool's difficulty over reconnects
+    DiffSuggester m_diff;
+    int64_t m_diffCheckUs = 0;
+
+    // hashrate this pool gets in GH/s, 0 if not known yet
+    double getHashrateEstimate();
+
+    // suggests the difficulty again when the hashrate changed a lot
+    bool updateDifficulty();
 
     // Stratum task function
     void task();
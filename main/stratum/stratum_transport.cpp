@@ -1,57 +1,77 @@
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <sys/select.h>
+#include <unistd.h>
 
 #include "esp_log.h"
 #include "esp_crt_bundle.h"
+#include "esp_timer.h"
 #include "esp_transport.h"
 #include "esp_transport_tcp.h"
-#include "esp_transport_ssl.h"
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/error.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/x509_crt.h"
 
+#include "capture.h"
+#include "macros.h"
 #include "nvs_config.h"
 #include "stratum_transport.h"
 
 static const char* TAG = "stratum_transport";
 
-StratumTransport::StratumTransport(bool use_tls)
-    : m_use_tls(use_tls), m_t(nullptr) {}
+#define STRATUM_CONNECT_TIMEOUT_MS 5000
+#define STRATUM_IO_TIMEOUT_MS 30000
 
-StratumTransport::~StratumTransport()
+// waits for data on fd or a wakeup on wakeFd, like poll()
+static int wait_readable(int fd, int wakeFd, int timeoutMs)
 {
-    close();
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    FD_SET(wakeFd, &fds);
+    struct timeval tv = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+    int ret = select((fd > wakeFd ? fd : wakeFd) + 1, &fds, nullptr, nullptr, &tv);
+    if (ret <= 0) {
+        return ret;
+    }
+    if (FD_ISSET(wakeFd, &fds)) {
+        uint64_t count;
+        read(wakeFd, &count, sizeof(count));
+    }
+    return FD_ISSET(fd, &fds) ? 1 : 0;
 }
 
-bool StratumTransport::connect(const char* host, const char* ip, uint16_t port)
+TcpStratumTransport::TcpStratumTransport()
+    : m_t(nullptr) {}
+
+TcpStratumTransport::~TcpStratumTransport()
 {
     close();
+}
 
-    esp_transport_handle_t t = nullptr;
-
-    if (m_use_tls) {
-        t = esp_transport_ssl_init();
-        if (!t) {
-            ESP_LOGE(TAG, "esp_transport_ssl_init failed");
-            return false;
-        }
+bool TcpStratumTransport::connect(const char* host, const char* ip, uint16_t port)
+{
+    close();
 
-        esp_transport_ssl_crt_bundle_attach(t, esp_crt_bundle_attach);
-        esp_transport_ssl_set_common_name(t, host);
-    } else {
-        t = esp_transport_tcp_init();
-        if (!t) {
-            ESP_LOGE(TAG, "esp_transport_tcp_init failed");
-            return false;
-        }
+    esp_transport_handle_t t = esp_transport_tcp_init();
+    if (!t) {
+        ESP_LOGE(TAG, "esp_transport_tcp_init failed");
+        return false;
     }
 
     m_t = t;
     applyKeepAlive_();
 
-    const char* connect_host = (m_use_tls ? host : (ip ? ip : host));
+    const char* connect_host = ip ? ip : host;
 
-    ESP_LOGI(TAG, "Connecting (%s) to %s:%u",
-             m_use_tls ? "TLS" : "TCP", connect_host, (unsigned)port);
+    ESP_LOGI(TAG, "Connecting (TCP) to %s:%u", connect_host, (unsigned)port);
 
-    if (esp_transport_connect(m_t, connect_host, (int)port, 5000) != 0) {
+    if (esp_transport_connect(m_t, connect_host, (int)port, STRATUM_CONNECT_TIMEOUT_MS) != 0) {
         int terr = esp_transport_get_errno(m_t);
         ESP_LOGE(TAG, "esp_transport_connect failed, errno=%d (%s)", terr, strerror(terr));
         close();
@@ -62,14 +82,14 @@ bool StratumTransport::connect(const char* host, const char* ip, uint16_t port)
     return true;
 }
 
-int StratumTransport::send(const void* data, size_t len)
+int TcpStratumTransport::send(const void* data, size_t len)
 {
     if (!m_t) {
         errno = ENOTCONN;
         return -1;
     }
 
-    int ret = esp_transport_write(m_t, (const char*)data, (int)len, 30000);
+    int ret = esp_transport_write(m_t, (const char*)data, (int)len, STRATUM_IO_TIMEOUT_MS);
     if (ret < 0) {
         int terr = esp_transport_get_errno(m_t);
         errno = (terr > 0) ? terr : ECONNRESET;
@@ -83,19 +103,21 @@ int StratumTransport::send(const void* data, size_t len)
         return -1;
     }
 
+    CAPTURE_record(CAPTURE_STRATUM_TX, data, ret);
     return ret;
 }
 
-int StratumTransport::recv(void* buf, size_t len)
+int TcpStratumTransport::recv(void* buf, size_t len)
 {
     if (!m_t) {
         errno = ENOTCONN;
         return -1;
     }
 
-    int ret = esp_transport_read(m_t, (char*)buf, (int)len, 30000);
+    int ret = esp_transport_read(m_t, (char*)buf, (int)len, STRATUM_IO_TIMEOUT_MS);
 
     if (ret > 0) {
+        CAPTURE_record(CAPTURE_STRATUM_RX, buf, ret);
         return ret;
     }
 
@@ -110,14 +132,26 @@ int StratumTransport::recv(void* buf, size_t len)
         return 0; // peer closed
     }
 
-    // other negatives: transport/tls error (can be mbedTLS codes etc.)
+    // other negatives: transport error
     int terr = esp_transport_get_errno(m_t); // get+clear :contentReference[oaicite:6]{index=6}
     errno = (terr > 0) ? terr : ECONNRESET;
     ESP_LOGW(TAG, "read failed ret=%d errno=%d (%s)", ret, errno, strerror(errno));
     return -1;
 }
 
-bool StratumTransport::isConnected()
+int TcpStratumTransport::poll(int timeoutMs, int wakeFd)
+{
+    if (!m_t) {
+        errno = ENOTCONN;
+        return -1;
+    }
+    if (wakeFd < 0) {
+        return esp_transport_poll_read(m_t, timeoutMs);
+    }
+    return wait_readable(esp_transport_get_socket(m_t), wakeFd, timeoutMs);
+}
+
+bool TcpStratumTransport::isConnected()
 {
     if (!m_t) {
         return false;
@@ -127,7 +161,7 @@ bool StratumTransport::isConnected()
     return (r >= 0);
 }
 
-void StratumTransport::close()
+void TcpStratumTransport::close()
 {
     if (m_t) {
         esp_transport_close(m_t);
@@ -136,7 +170,7 @@ void StratumTransport::close()
     }
 }
 
-void StratumTransport::applyKeepAlive_()
+void TcpStratumTransport::applyKeepAlive_()
 {
     esp_transport_keep_alive_t ka = {};
     ka.keep_alive_enable = Config::isStratumKeepaliveEnabled();
@@ -148,9 +182,497 @@ void StratumTransport::applyKeepAlive_()
         return;
     }
 
-    if (m_use_tls) {
-        esp_transport_ssl_set_keep_alive(m_t, &ka);
-    } else {
-        esp_transport_tcp_set_keep_alive(m_t, &ka);
+    esp_transport_tcp_set_keep_alive(m_t, &ka);
+}
+
+// --- TLS
+
+// per connection state, only allocated while connected
+struct tls_conn_t {
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_x509_crt pinned;
+    bool handshakeDone;
+};
+
+static const int preferred_ciphersuites[] = {
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3)
+    MBEDTLS_TLS1_3_AES_128_GCM_SHA256,
+    MBEDTLS_TLS1_3_CHACHA20_POLY1305_SHA256,
+    MBEDTLS_TLS1_3_AES_256_GCM_SHA384,
+#endif
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
+    0,
+};
+
+static const uint16_t preferred_groups[] = {
+    MBEDTLS_SSL_IANA_TLS_GROUP_X25519,
+    MBEDTLS_SSL_IANA_TLS_GROUP_SECP256R1,
+    MBEDTLS_SSL_IANA_TLS_GROUP_SECP384R1,
+    MBEDTLS_SSL_IANA_TLS_GROUP_NONE,
+};
+
+static int64_t now_ms()
+{
+    return esp_timer_get_time() / 1000ll;
+}
+
+static void log_mbedtls_error(const char* what, int ret)
+{
+    char buf[96];
+    mbedtls_strerror(ret, buf, sizeof(buf));
+    ESP_LOGE(TAG, "%s failed: -0x%04x (%s)", what, (unsigned)-ret, buf);
+}
+
+TlsStratumTransport::TlsStratumTransport()
+    : m_conn(nullptr), m_fd(-1), m_pinnedCert(nullptr), m_connPort(0), m_hasSession(false), m_sessionPort(0),
+      m_compatCiphers(false), m_rxBytes(0), m_txBytes(0)
+{
+    mbedtls_ssl_session_init(&m_session);
+    m_sessionHost[0] = 0;
+    m_connHost[0] = 0;
+}
+
+TlsStratumTransport::~TlsStratumTransport()
+{
+    close();
+    dropSession_();
+    safe_free(m_pinnedCert);
+}
+
+void TlsStratumTransport::setPinnedCert(const char* pem)
+{
+    if (pem && !*pem) {
+        pem = nullptr;
+    }
+    if ((!pem && !m_pinnedCert) || (pem && m_pinnedCert && !strcmp(pem, m_pinnedCert))) {
+        return;
+    }
+
+    // a session of the old trust anchor must not be resumed
+    dropSession_();
+    safe_free(m_pinnedCert);
+    m_pinnedCert = pem ? strdup(pem) : nullptr;
+}
+
+int TlsStratumTransport::bioSend_(void* ctx, const unsigned char* buf, size_t len)
+{
+    TlsStratumTransport* self = (TlsStratumTransport*)ctx;
+    int ret = ::send(self->m_fd, buf, len, 0);
+    if (ret < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return MBEDTLS_ERR_SSL_WANT_WRITE;
+        }
+        return MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+    self->m_txBytes += ret;
+    return ret;
+}
+
+int TlsStratumTransport::bioRecv_(void* ctx, unsigned char* buf, size_t len)
+{
+    TlsStratumTransport* self = (TlsStratumTransport*)ctx;
+    int ret = ::recv(self->m_fd, buf, len, 0);
+    if (ret < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return MBEDTLS_ERR_SSL_WANT_READ;
+        }
+        return MBEDTLS_ERR_NET_RECV_FAILED;
+    }
+    self->m_rxBytes += ret;
+    return ret;
+}
+
+// > 0 ready, 0 timeout, < 0 error
+int TlsStratumTransport::wait_(bool write, int timeoutMs)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(m_fd, &fds);
+    struct timeval tv = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+    return select(m_fd + 1, write ? nullptr : &fds, write ? &fds : nullptr, nullptr, &tv);
+}
+
+bool TlsStratumTransport::connectSocket_(const char* host, const char* ip, uint16_t port, int timeoutMs)
+{
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+
+    if (!ip || inet_pton(AF_INET, ip, &addr.sin_addr) != 1) {
+        struct addrinfo hints = {};
+        struct addrinfo* res = nullptr;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host, nullptr, &hints, &res) != 0 || !res) {
+            ESP_LOGE(TAG, "%s couldn't be resolved", host);
+            errno = EHOSTUNREACH;
+            return false;
+        }
+        addr.sin_addr = ((struct sockaddr_in*)res->ai_addr)->sin_addr;
+        freeaddrinfo(res);
+    }
+
+    m_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (m_fd < 0) {
+        ESP_LOGE(TAG, "socket failed, errno=%d", errno);
+        return false;
+    }
+
+    if (Config::isStratumKeepaliveEnabled()) {
+        int on = 1, idle = 10, interval = 5, count = 3;
+        setsockopt(m_fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+        setsockopt(m_fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+        setsockopt(m_fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+        setsockopt(m_fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+    }
+
+    // everything after this is driven by select
+    fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL, 0) | O_NONBLOCK);
+
+    if (::connect(m_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 && errno != EINPROGRESS) {
+        ESP_LOGE(TAG, "connect failed, errno=%d (%s)", errno, strerror(errno));
+        return false;
+    }
+
+    int ret = wait_(true, timeoutMs);
+    if (ret <= 0) {
+        errno = ret ? errno : ETIMEDOUT;
+        ESP_LOGE(TAG, "connect failed, errno=%d (%s)", errno, strerror(errno));
+        return false;
+    }
+
+    int err = 0;
+    socklen_t errLen = sizeof(err);
+    getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &err, &errLen);
+    if (err) {
+        errno = err;
+        ESP_LOGE(TAG, "connect failed, errno=%d (%s)", err, strerror(err));
+        return false;
+    }
+    return true;
+}
+
+bool TlsStratumTransport::setupSsl_(const char* host)
+{
+    tls_conn_t* c = m_conn;
+    int ret;
+
+    if ((ret = mbedtls_ctr_drbg_seed(&c->drbg, mbedtls_entropy_func, &c->entropy, nullptr, 0)) != 0) {
+        log_mbedtls_error("mbedtls_ctr_drbg_seed", ret);
+        return false;
+    }
+
+    if ((ret = mbedtls_ssl_config_defaults(&c->conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                           MBEDTLS_SSL_PRESET_DEFAULT)) != 0) {
+        log_mbedtls_error("mbedtls_ssl_config_defaults", ret);
+        return false;
+    }
+
+    mbedtls_ssl_conf_authmode(&c->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_rng(&c->conf, mbedtls_ctr_drbg_random, &c->drbg);
+
+    // the pinned certificate is the only trust anchor, the bundle isn't searched
+    bool pinned = false;
+    if (m_pinnedCert) {
+        ret = mbedtls_x509_crt_parse(&c->pinned, (const unsigned char*)m_pinnedCert, strlen(m_pinnedCert) + 1);
+        if (ret == 0) {
+            mbedtls_ssl_conf_ca_chain(&c->conf, &c->pinned, nullptr);
+            pinned = true;
+        } else {
+            log_mbedtls_error("pinned certificate", ret);
+            ESP_LOGW(TAG, "using the certificate bundle");
+        }
+    }
+    if (!pinned && esp_crt_bundle_attach(&c->conf) != ESP_OK) {
+        ESP_LOGE(TAG, "esp_crt_bundle_attach failed");
+        return false;
+    }
+
+    if (!m_compatCiphers) {
+        mbedtls_ssl_conf_ciphersuites(&c->conf, preferred_ciphersuites);
+        mbedtls_ssl_conf_groups(&c->conf, preferred_groups);
+    }
+
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    // stratum lines are small, pools that accept it let us shrink the buffers
+    mbedtls_ssl_conf_max_frag_len(&c->conf, MBEDTLS_SSL_MAX_FRAG_LEN_4096);
+#endif
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&c->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+    if ((ret = mbedtls_ssl_setup(&c->ssl, &c->conf)) != 0) {
+        log_mbedtls_error("mbedtls_ssl_setup", ret);
+        return false;
+    }
+
+    if ((ret = mbedtls_ssl_set_hostname(&c->ssl, host)) != 0) {
+        log_mbedtls_error("mbedtls_ssl_set_hostname", ret);
+        return false;
+    }
+
+    mbedtls_ssl_set_bio(&c->ssl, this, bioSend_, bioRecv_, nullptr);
+    return true;
+}
+
+bool TlsStratumTransport::connect(const char* host, const char* ip, uint16_t port)
+{
+    close();
+
+    m_conn = (tls_conn_t*)CALLOC(1, sizeof(tls_conn_t));
+    if (!m_conn) {
+        ESP_LOGE(TAG, "no memory for the TLS context");
+        errno = ENOMEM;
+        return false;
+    }
+    mbedtls_ssl_init(&m_conn->ssl);
+    mbedtls_ssl_config_init(&m_conn->conf);
+    mbedtls_entropy_init(&m_conn->entropy);
+    mbedtls_ctr_drbg_init(&m_conn->drbg);
+    mbedtls_x509_crt_init(&m_conn->pinned);
+
+    m_rxBytes = m_txBytes = 0;
+    strlcpy(m_connHost, host, sizeof(m_connHost));
+    m_connPort = port;
+
+    if (!setupSsl_(host)) {
+        close();
+        errno = ECONNABORTED;
+        return false;
+    }
+
+    // only resume sessions of the same pool
+    bool offered = false;
+    if (m_hasSession && m_sessionPort == port && !strcmp(m_sessionHost, host)) {
+        int ret = mbedtls_ssl_set_session(&m_conn->ssl, &m_session);
+        if (ret == 0) {
+            offered = true;
+        } else {
+            log_mbedtls_error("mbedtls_ssl_set_session", ret);
+            dropSession_();
+        }
+    }
+
+    ESP_LOGI(TAG, "Connecting (TLS) to %s:%u%s", host, (unsigned)port, offered ? ", resuming session" : "");
+
+    int64_t start = now_ms();
+    if (!connectSocket_(host, ip, port, STRATUM_CONNECT_TIMEOUT_MS)) {
+        int err = errno;
+        close();
+        errno = err;
+        return false;
+    }
+
+    int64_t deadline = now_ms() + STRATUM_CONNECT_TIMEOUT_MS;
+    int ret;
+    while ((ret = mbedtls_ssl_handshake(&m_conn->ssl)) != 0) {
+        int64_t remaining = deadline - now_ms();
+        if ((ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) && remaining > 0) {
+            wait_(ret == MBEDTLS_ERR_SSL_WANT_WRITE, (int)remaining);
+            continue;
+        }
+
+        log_mbedtls_error("TLS handshake", ret);
+        uint32_t flags = mbedtls_ssl_get_verify_result(&m_conn->ssl);
+        if (flags && flags != (uint32_t)-1) {
+            char buf[128];
+            mbedtls_x509_crt_verify_info(buf, sizeof(buf), "", flags);
+            ESP_LOGE(TAG, "certificate: %s", buf);
+        }
+
+        // try the full default lists next time, and never offer a session
+        // that might be the reason
+        if (ret == MBEDTLS_ERR_SSL_HANDSHAKE_FAILURE || ret == MBEDTLS_ERR_SSL_BAD_PROTOCOL_VERSION) {
+            m_compatCiphers = true;
+        }
+        dropSession_();
+        close();
+        errno = ECONNREFUSED;
+        return false;
+    }
+    m_conn->handshakeDone = true;
+
+    size_t maxIn = mbedtls_ssl_get_max_in_record_payload(&m_conn->ssl);
+    ESP_LOGI(TAG, "Connected (%s, %s), handshake %lldms, %lu/%lu bytes rx/tx, %s, records %u bytes",
+             mbedtls_ssl_get_version(&m_conn->ssl), mbedtls_ssl_get_ciphersuite(&m_conn->ssl), now_ms() - start,
+             (unsigned long)m_rxBytes, (unsigned long)m_txBytes, offered ? "session offered" : "full handshake",
+             (unsigned)maxIn);
+
+    // TLS 1.2 sessions are complete now, TLS 1.3 tickets arrive later and
+    // are taken on close
+    saveSession_();
+    return true;
+}
+
+void TlsStratumTransport::saveSession_()
+{
+    if (!m_conn || !m_conn->handshakeDone) {
+        return;
+    }
+
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    if (mbedtls_ssl_get_session(&m_conn->ssl, &session) != 0) {
+        // nothing (new) to resume
+        mbedtls_ssl_session_free(&session);
+        return;
+    }
+
+    mbedtls_ssl_session_free(&m_session);
+    m_session = session;
+    m_hasSession = true;
+    strlcpy(m_sessionHost, m_connHost, sizeof(m_sessionHost));
+    m_sessionPort = m_connPort;
+}
+
+void TlsStratumTransport::dropSession_()
+{
+    if (m_hasSession) {
+        mbedtls_ssl_session_free(&m_session);
+        mbedtls_ssl_session_init(&m_session);
+    }
+    m_hasSession = false;
+    m_sessionHost[0] = 0;
+    m_sessionPort = 0;
+}
+
+int TlsStratumTransport::send(const void* data, size_t len)
+{
+    if (!m_conn) {
+        errno = ENOTCONN;
+        return -1;
+    }
+
+    int64_t deadline = now_ms() + STRATUM_IO_TIMEOUT_MS;
+    size_t written = 0;
+    while (written < len) {
+        int ret = mbedtls_ssl_write(&m_conn->ssl, (const unsigned char*)data + written, len - written);
+        if (ret > 0) {
+            written += ret;
+            continue;
+        }
+
+        int64_t remaining = deadline - now_ms();
+        if ((ret == MBEDTLS_ERR_SSL_WANT_WRITE || ret == MBEDTLS_ERR_SSL_WANT_READ) && remaining > 0) {
+            wait_(ret == MBEDTLS_ERR_SSL_WANT_WRITE, (int)remaining);
+            continue;
+        }
+        if (ret == MBEDTLS_ERR_SSL_WANT_WRITE || ret == MBEDTLS_ERR_SSL_WANT_READ) {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        errno = ECONNRESET;
+        ESP_LOGW(TAG, "write failed ret=-0x%04x", (unsigned)-ret);
+        return -1;
+    }
+
+    CAPTURE_record(CAPTURE_STRATUM_TX, data, written);
+    return (int)written;
+}
+
+int TlsStratumTransport::recv(void* buf, size_t len)
+{
+    if (!m_conn) {
+        errno = ENOTCONN;
+        return -1;
+    }
+
+    int64_t deadline = now_ms() + STRATUM_IO_TIMEOUT_MS;
+    while (1) {
+        // decrypted or buffered data doesn't show up on the socket
+        if (!mbedtls_ssl_get_bytes_avail(&m_conn->ssl) && !mbedtls_ssl_check_pending(&m_conn->ssl)) {
+            int64_t remaining = deadline - now_ms();
+            int ready = (remaining > 0) ? wait_(false, (int)remaining) : 0;
+            if (ready == 0) {
+                errno = EAGAIN;
+                return -1;
+            }
+            if (ready < 0) {
+                errno = ECONNRESET;
+                return -1;
+            }
+        }
+
+        int ret = mbedtls_ssl_read(&m_conn->ssl, (unsigned char*)buf, len);
+        if (ret > 0) {
+            CAPTURE_record(CAPTURE_STRATUM_RX, buf, ret);
+            return ret;
+        }
+        if (ret == 0 || ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+            return 0; // peer closed
+        }
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            continue;
+        }
+#if defined(MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET)
+        if (ret == MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET) {
+            saveSession_();
+            continue;
+        }
+#endif
+
+        errno = ECONNRESET;
+        ESP_LOGW(TAG, "read failed ret=-0x%04x", (unsigned)-ret);
+        return -1;
+    }
+}
+
+int TlsStratumTransport::poll(int timeoutMs, int wakeFd)
+{
+    if (!m_conn || m_fd < 0) {
+        errno = ENOTCONN;
+        return -1;
+    }
+    if (mbedtls_ssl_get_bytes_avail(&m_conn->ssl) || mbedtls_ssl_check_pending(&m_conn->ssl)) {
+        return 1;
+    }
+    if (wakeFd < 0) {
+        return wait_(false, timeoutMs);
+    }
+    return wait_readable(m_fd, wakeFd, timeoutMs);
+}
+
+bool TlsStratumTransport::isConnected()
+{
+    if (!m_conn || m_fd < 0) {
+        return false;
+    }
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err) {
+        return false;
+    }
+    return wait_(true, 0) >= 0;
+}
+
+void TlsStratumTransport::close()
+{
+    if (m_conn) {
+        if (m_conn->handshakeDone) {
+            // the TLS 1.3 ticket of this connection
+            saveSession_();
+            mbedtls_ssl_close_notify(&m_conn->ssl);
+        }
+        mbedtls_ssl_free(&m_conn->ssl);
+        mbedtls_ssl_config_free(&m_conn->conf);
+        mbedtls_ctr_drbg_free(&m_conn->drbg);
+        mbedtls_entropy_free(&m_conn->entropy);
+        mbedtls_x509_crt_free(&m_conn->pinned);
+        FREE(m_conn);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
     }
 }
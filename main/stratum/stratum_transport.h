@@ -6,32 +6,93 @@
 #include <sys/socket.h>
 
 #include "esp_transport.h"
+#include "mbedtls/ssl.h"
 
 
 class StratumTransport {
 public:
-    explicit StratumTransport(bool use_tls);
-    ~StratumTransport();
+    virtual ~StratumTransport() {}
 
-    bool connect(const char* host, const char* ip, uint16_t port);
-    int send(const void* data, size_t len);
-    int recv(void* buf, size_t len);
-    bool isConnected();
-    void close();
+    virtual bool connect(const char* host, const char* ip, uint16_t port) = 0;
+    virtual int send(const void* data, size_t len) = 0;
+    virtual int recv(void* buf, size_t len) = 0;
+    // >0 data to read, 0 timeout, <0 error. A readable wakeFd (eventfd)
+    // ends the wait as well, it is read to reset it and 0 is returned
+    virtual int poll(int timeoutMs, int wakeFd = -1) = 0;
+    virtual bool isConnected() = 0;
+    virtual void close() = 0;
+};
+
+class TcpStratumTransport : public StratumTransport {
+public:
+    TcpStratumTransport();
+    ~TcpStratumTransport();
+
+    bool connect(const char* host, const char* ip, uint16_t port) override;
+    int send(const void* data, size_t len) override;
+    int recv(void* buf, size_t len) override;
+    int poll(int timeoutMs, int wakeFd = -1) override;
+    bool isConnected() override;
+    void close() override;
 
 private:
     void applyKeepAlive_();
 
-    bool m_use_tls;
     esp_transport_handle_t m_t;
 };
 
-class TcpStratumTransport : public StratumTransport {
-public:
-    TcpStratumTransport() : StratumTransport(false) {}
-};
+struct tls_conn_t;
 
+// stratum+ssl on mbedtls directly, esp-tls doesn't expose what's needed:
+// - the session (ID or ticket) of the last connection is offered again on
+//   reconnects to the same pool, a resumed handshake skips the certificate
+//   chain and the key exchange signature
+// - an optional pinned CA or self signed leaf (PEM) replaces the bundle
+// - max fragment length 4096 is requested, with variable buffers mbedtls
+//   shrinks the 16kB record buffers when the pool accepts it
+// - cheap suites and groups first (AES-GCM has hardware support, X25519
+//   is the fastest key exchange in software), the full default lists are
+//   used after a failed negotiation
 class TlsStratumTransport : public StratumTransport {
 public:
-    TlsStratumTransport() : StratumTransport(true) {}
+    TlsStratumTransport();
+    ~TlsStratumTransport();
+
+    // PEM of the pinned certificate, nullptr or empty for the bundle
+    void setPinnedCert(const char* pem);
+
+    bool connect(const char* host, const char* ip, uint16_t port) override;
+    int send(const void* data, size_t len) override;
+    int recv(void* buf, size_t len) override;
+    int poll(int timeoutMs, int wakeFd = -1) override;
+    bool isConnected() override;
+    void close() override;
+
+private:
+    static int bioSend_(void* ctx, const unsigned char* buf, size_t len);
+    static int bioRecv_(void* ctx, unsigned char* buf, size_t len);
+
+    bool connectSocket_(const char* host, const char* ip, uint16_t port, int timeoutMs);
+    bool setupSsl_(const char* host);
+    int wait_(bool write, int timeoutMs);
+    void saveSession_();
+    void dropSession_();
+
+    tls_conn_t* m_conn;
+    int m_fd;
+    char* m_pinnedCert;
+    char m_connHost[64];
+    uint16_t m_connPort;
+
+    // session of the last connection
+    mbedtls_ssl_session m_session;
+    bool m_hasSession;
+    char m_sessionHost[64];
+    uint16_t m_sessionPort;
+
+    bool m_compatCiphers;
+
+    // bytes on the socket since connect
+    uint32_t m_rxBytes;
+    uint32_t m_txBytes;
 };
@@ -0,0 +1,122 @@
+#include <string.h>
+
+#include "submit_queue.h"
+
+class SubmitQueueLock {
+  public:
+    explicit SubmitQueueLock(pthread_mutex_t &m) : m_mutex(m)
+    {
+        pthread_mutex_lock(&m_mutex);
+    }
+    ~SubmitQueueLock()
+    {
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+  private:
+    pthread_mutex_t &m_mutex;
+};
+
+submit_entry_t *SubmitQueue::tail(Ring *ring)
+{
+    return &ring->entries[(ring->head + ring->count) % ring->len];
+}
+
+void SubmitQueue::popHead(Ring *ring)
+{
+    ring->head = (ring->head + 1) % ring->len;
+    ring->count--;
+}
+
+bool SubmitQueue::push(const char *jobid, const char *extranonce2, uint32_t ntime, uint32_t nonce, uint32_t version,
+                       bool blockCandidate, int64_t nowUs)
+{
+    SubmitQueueLock lock(m_mutex);
+
+    Ring *ring = blockCandidate ? &m_block : &m_normal;
+
+    if (ring->count == ring->len) {
+        if (blockCandidate) {
+            // four blocks in flight, won't happen
+            m_stats.droppedFull++;
+            return false;
+        }
+        // the oldest share is the least likely to be accepted
+        popHead(ring);
+        m_stats.droppedFull++;
+    }
+
+    submit_entry_t *e = tail(ring);
+    strncpy(e->jobid, jobid, sizeof(e->jobid) - 1);
+    e->jobid[sizeof(e->jobid) - 1] = 0;
+    strncpy(e->extranonce2, extranonce2, sizeof(e->extranonce2) - 1);
+    e->extranonce2[sizeof(e->extranonce2) - 1] = 0;
+    e->ntime = ntime;
+    e->nonce = nonce;
+    e->version = version;
+    e->blockCandidate = blockCandidate;
+    e->epoch = m_epoch;
+    e->queuedUs = nowUs;
+    ring->count++;
+
+    m_stats.queued++;
+    m_stats.blockCandidates += blockCandidate;
+    return true;
+}
+
+bool SubmitQueue::pop(submit_entry_t *out, int64_t nowUs)
+{
+    SubmitQueueLock lock(m_mutex);
+
+    if (m_block.count) {
+        *out = m_block.entries[m_block.head];
+        popHead(&m_block);
+    } else {
+        // skip what the pool would reject as stale
+        while (m_normal.count && m_normal.entries[m_normal.head].epoch != m_epoch) {
+            popHead(&m_normal);
+            m_stats.droppedStale++;
+        }
+        if (!m_normal.count) {
+            return false;
+        }
+        *out = m_normal.entries[m_normal.head];
+        popHead(&m_normal);
+    }
+
+    int64_t waitUs = nowUs - out->queuedUs;
+    if (waitUs > m_stats.maxWaitUs) {
+        m_stats.maxWaitUs = waitUs;
+    }
+    if (out->blockCandidate && waitUs > m_stats.maxBlockWaitUs) {
+        m_stats.maxBlockWaitUs = waitUs;
+    }
+    m_stats.sent++;
+    return true;
+}
+
+void SubmitQueue::newEpoch()
+{
+    SubmitQueueLock lock(m_mutex);
+    m_epoch++;
+}
+
+void SubmitQueue::clear()
+{
+    SubmitQueueLock lock(m_mutex);
+    m_stats.droppedDisconnect += m_normal.count + m_block.count;
+    m_normal.head = m_normal.count = 0;
+    m_block.head = m_block.count = 0;
+}
+
+bool SubmitQueue::isEmpty()
+{
+    SubmitQueueLock lock(m_mutex);
+    return !m_normal.count && !m_block.count;
+}
+
+void SubmitQueue::getStats(submit_stats_t *out)
+{
+    SubmitQueueLock lock(m_mutex);
+    *out = m_stats;
+}
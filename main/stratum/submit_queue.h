@@ -0,0 +1,92 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+// Shares waiting to be sent to a pool.
+//
+// The ASIC result task only queues, the stratum task of the pool sends
+// between reads. A slow pool socket doesn't stall nonce processing anymore
+// and the result task never touches the transport.
+//
+// - shares that solve a block go out first and are never dropped while the
+//   session lives
+// - other shares are FIFO, when the queue is full the oldest one is dropped
+// - a mining.notify with clean_jobs starts a new epoch, queued shares of the
+//   previous jobs are dropped instead of being sent as stale
+// - a disconnect clears the queue, job IDs and extranonces belong to the
+//   session
+//
+// No ESP-IDF dependencies (see host/submit_queue_sim.cpp).
+
+#define SUBMIT_QUEUE_LEN 16
+#define SUBMIT_QUEUE_BLOCK_LEN 4
+
+#define SUBMIT_JOBID_LEN 64
+#define SUBMIT_EXTRANONCE2_LEN 33
+
+typedef struct
+{
+    char jobid[SUBMIT_JOBID_LEN];
+    char extranonce2[SUBMIT_EXTRANONCE2_LEN];
+    uint32_t ntime;
+    uint32_t nonce;
+    uint32_t version;
+    bool blockCandidate;
+    uint32_t epoch;
+    int64_t queuedUs; // time of push
+} submit_entry_t;
+
+typedef struct
+{
+    uint32_t queued;
+    uint32_t sent;
+    uint32_t droppedFull;
+    uint32_t droppedStale;
+    uint32_t droppedDisconnect;
+    uint32_t blockCandidates;
+    int64_t maxWaitUs;      // longest time a share waited for sending
+    int64_t maxBlockWaitUs; // same for block candidates
+} submit_stats_t;
+
+class SubmitQueue {
+  protected:
+    struct Ring
+    {
+        submit_entry_t *entries;
+        int len;
+        int head;
+        int count;
+    };
+
+    pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    submit_entry_t m_normalEntries[SUBMIT_QUEUE_LEN];
+    submit_entry_t m_blockEntries[SUBMIT_QUEUE_BLOCK_LEN];
+    Ring m_normal = {m_normalEntries, SUBMIT_QUEUE_LEN, 0, 0};
+    Ring m_block = {m_blockEntries, SUBMIT_QUEUE_BLOCK_LEN, 0, 0};
+
+    uint32_t m_epoch = 0;
+    submit_stats_t m_stats{};
+
+    static submit_entry_t *tail(Ring *ring);
+    static void popHead(Ring *ring);
+
+  public:
+    // false when the share was dropped
+    bool push(const char *jobid, const char *extranonce2, uint32_t ntime, uint32_t nonce, uint32_t version,
+              bool blockCandidate, int64_t nowUs);
+
+    // next share to send, block candidates first. Stale shares are skipped
+    bool pop(submit_entry_t *out, int64_t nowUs);
+
+    // clean_jobs notify, queued shares of older jobs are stale
+    void newEpoch();
+
+    // session ended
+    void clear();
+
+    bool isEmpty();
+
+    void getStats(submit_stats_t *out);
+};
@@ -26,6 +26,7 @@
 #include "history.h"
 #include "boards/board.h"
 #include "utils.h"
+#include "ws_telemetry.h"
 
 static const char* TAG = "SystemModule";
 
@@ -67,6 +68,11 @@ void System::initSystem() {
     if (!m_history->init(m_board->getAsicCount())) {
         ESP_LOGE(TAG, "history couldn't be initialized!");
     }
+
+    // keep the UTC view of the history in sync with the time service
+    sntp.addListener([](void *ctx, int64_t utcOffsetMs, int64_t stepMs) {
+        ((History *) ctx)->setUtcOffset(utcOffsetMs, stepMs);
+    }, m_history);
 }
 
 void System::loadSettings() {
@@ -218,6 +224,20 @@ void System::pushHistory() {
     }
 
     m_history->push(hashrate, filteredVreg, filteredAsicTemp, timestamp);
+
+    if (ws_telemetry_wanted(WS_TELEMETRY_HISTORY)) {
+        ws_telemetry_history_t sample = {
+            .timestamp = timestamp,
+            .hashrate = hashrate,
+            .hashrate_1m = (float) m_history->getCurrentHashrate1m(),
+            .hashrate_10m = (float) m_history->getCurrentHashrate10m(),
+            .hashrate_1h = (float) m_history->getCurrentHashrate1h(),
+            .hashrate_1d = (float) m_history->getCurrentHashrate1d(),
+            .vreg_temp = filteredVreg,
+            .asic_temp = filteredAsicTemp,
+        };
+        ws_telemetry_publish(WS_TELEMETRY_HISTORY, &sample, sizeof(sample));
+    }
 }
 
 void System::task() {
@@ -262,7 +282,7 @@ void System::task() {
     m_display->updateIpAddress(m_ipAddress);
     int lastFoundBlocks = 0;
 
-    int toggle = 1;
+    int pool = 0;
 
     while (1) {
         pthread_mutex_lock(&m_loop_mutex);
@@ -294,14 +314,18 @@ void System::task() {
         }
         lastFoundBlocks = foundBlocks;
 
-        // toggle
-        toggle = 1-toggle;
+        // cycle through the pools that get work
+        pool = STRATUM_MANAGER->getNextDisplayPool(pool);
 
-        m_display->updateGlobalState(toggle);
-        m_display->updateCurrentSettings(toggle);
+        m_display->updateGlobalState(pool);
+        m_display->updateCurrentSettings(pool);
         m_display->refreshScreen();
 
         pushHistory();
+
+        // preformatted for the live API
+        LIVE_STATS.updateLive();
+        LIVE_STATS.updatePool();
     }
 }
 
@@ -0,0 +1,184 @@
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "latency_histogram.h"
+#include "macros.h"
+#include "task_monitor.h"
+#include "utils.h"
+
+static const char *TAG = "task_monitor";
+
+#define TASK_MONITOR_MAX_TASKS 40
+
+static TaskPlan default_plan;
+static TaskPlan *s_plan = &default_plan;
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static LatencyHistogram s_notifyLatency;
+
+void task_plan_apply(TaskPlan *plan)
+{
+    int changed = plan->resolve(portNUM_PROCESSORS, configMAX_PRIORITIES);
+    if (changed) {
+        ESP_LOGW(TAG, "%d task placements adjusted for this chip", changed);
+    }
+    int conflicts = plan->numWifiCoreConflicts();
+    if (conflicts) {
+        ESP_LOGW(TAG, "%d mining critical tasks can run on the WiFi core", conflicts);
+    }
+    s_plan = plan;
+}
+
+BaseType_t task_create(task_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *handle, const char *name)
+{
+    const task_placement_t *t = s_plan->get(id);
+    const char *taskName = name ? name : t->name;
+    BaseType_t core = (t->core == TASK_CORE_ANY) ? tskNO_AFFINITY : (BaseType_t) t->core;
+
+    BaseType_t ret;
+    if (t->stack == TASK_STACK_PSRAM) {
+        ret = xTaskCreatePSRAMPinnedToCore(fn, taskName, t->stackBytes, arg, t->priority, handle, core);
+    } else {
+        ret = xTaskCreatePinnedToCore(fn, taskName, t->stackBytes, arg, t->priority, handle, core);
+    }
+
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "error creating task '%s'", taskName);
+        return ret;
+    }
+    ESP_LOGI(TAG, "'%s' on core %d, prio %d, %lu bytes %s stack", taskName, t->core, t->priority, t->stackBytes,
+             (t->stack == TASK_STACK_PSRAM) ? "PSRAM" : "internal");
+    return ret;
+}
+
+void task_monitor_notify_latency(uint32_t us)
+{
+    PThreadGuard lock(s_mutex);
+    s_notifyLatency.add(us);
+}
+
+static void get_latency_stats(JsonObject obj)
+{
+    PThreadGuard lock(s_mutex);
+    obj["count"] = s_notifyLatency.getCount();
+    obj["avgUs"] = s_notifyLatency.getAvg();
+    obj["p50Us"] = s_notifyLatency.percentile(50.0f);
+    obj["p99Us"] = s_notifyLatency.percentile(99.0f);
+    obj["maxUs"] = s_notifyLatency.getMax();
+    obj["firstBucketUs"] = LatencyHistogram::FIRST_BUCKET_US;
+    JsonArray buckets = obj["buckets"].to<JsonArray>();
+    for (int i = 0; i < LatencyHistogram::NUM_BUCKETS; i++) {
+        buckets.add(s_notifyLatency.getBucket(i));
+    }
+}
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+typedef struct
+{
+    TaskHandle_t handle;
+    configRUN_TIME_COUNTER_TYPE runtime;
+} task_runtime_t;
+
+// counters of the previous call to get the usage of the interval
+static task_runtime_t s_prev[TASK_MONITOR_MAX_TASKS];
+static int s_numPrev = 0;
+static configRUN_TIME_COUNTER_TYPE s_prevTotal = 0;
+
+static configRUN_TIME_COUNTER_TYPE prev_runtime(TaskHandle_t handle)
+{
+    for (int i = 0; i < s_numPrev; i++) {
+        if (s_prev[i].handle == handle) {
+            return s_prev[i].runtime;
+        }
+    }
+    return 0;
+}
+#endif
+
+static int task_core(const TaskStatus_t *s)
+{
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+    return (s->xCoreID == tskNO_AFFINITY) ? TASK_CORE_ANY : (int) s->xCoreID;
+#else
+    return TASK_CORE_ANY;
+#endif
+}
+
+void task_monitor_get_stats(JsonObject obj)
+{
+    obj["cores"] = portNUM_PROCESSORS;
+    get_latency_stats(obj["notifyLatency"].to<JsonObject>());
+
+    TaskStatus_t *tasks = (TaskStatus_t *) MALLOC(TASK_MONITOR_MAX_TASKS * sizeof(TaskStatus_t));
+    if (!tasks) {
+        return;
+    }
+
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t num = uxTaskGetSystemState(tasks, TASK_MONITOR_MAX_TASKS, &total);
+
+    PThreadGuard lock(s_mutex);
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    // the counter runs once for all cores, every core can use 100%
+    configRUN_TIME_COUNTER_TYPE interval = total - s_prevTotal;
+    float coreBusy[portNUM_PROCESSORS];
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+        coreBusy[c] = 100.0f;
+    }
+    obj["intervalMs"] = (uint32_t) (interval / 1000);
+#endif
+
+    JsonArray arr = obj["tasks"].to<JsonArray>();
+    for (UBaseType_t i = 0; i < num; i++) {
+        const TaskStatus_t *s = &tasks[i];
+        JsonObject t = arr.add<JsonObject>();
+        t["name"] = s->pcTaskName;
+        t["core"] = task_core(s);
+        t["prio"] = s->uxCurrentPriority;
+        t["stackFree"] = s->usStackHighWaterMark;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        float cpu = interval ? 100.0f * (float) (s->ulRunTimeCounter - prev_runtime(s->xHandle)) / (float) interval : 0.0f;
+        t["cpu"] = roundf(cpu * 10.0f) / 10.0f;
+
+        // the idle tasks are pinned, their share is what the core didn't use
+        int core = task_core(s);
+        if (!strncmp(s->pcTaskName, "IDLE", 4) && core >= 0 && core < portNUM_PROCESSORS) {
+            coreBusy[core] -= cpu;
+        }
+#endif
+    }
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    JsonArray load = obj["coreLoad"].to<JsonArray>();
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+        load.add(roundf((coreBusy[c] < 0.0f ? 0.0f : coreBusy[c]) * 10.0f) / 10.0f);
+    }
+
+    s_numPrev = (int) num;
+    for (UBaseType_t i = 0; i < num; i++) {
+        s_prev[i].handle = tasks[i].xHandle;
+        s_prev[i].runtime = tasks[i].ulRunTimeCounter;
+    }
+    s_prevTotal = total;
+#endif
+
+    FREE(tasks);
+}
+
+#else
+
+void task_monitor_get_stats(JsonObject obj)
+{
+    obj["cores"] = portNUM_PROCESSORS;
+    get_latency_stats(obj["notifyLatency"].to<JsonObject>());
+}
+
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "ArduinoJson.h"
+#include "task_plan.h"
+
+// activates the placement plan of the board, tasks created before use the
+// default plan
+void task_plan_apply(TaskPlan *plan);
+
+// creates a task with the core, priority and stack of its plan entry,
+// name overrides the name of the entry (e.g. one task per pool)
+BaseType_t task_create(task_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *handle = nullptr, const char *name = nullptr);
+
+// time from a parsed mining.notify to the first job sent to the ASICs
+void task_monitor_notify_latency(uint32_t us);
+
+// CPU usage per task and core since the previous call, placement, stack
+// watermarks and the notify latency histogram
+void task_monitor_get_stats(JsonObject obj);
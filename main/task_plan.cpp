@@ -0,0 +1,104 @@
+#include "task_plan.h"
+
+// default placement for the dual core ESP32-S3
+//
+// priorities are unchanged from the unpinned setup. The stratum task stays
+// unpinned, it follows lwIP and picks up whichever core is free first.
+// Tasks that touch the flash or run during flash writes keep their stack
+// in internal RAM.
+static const task_placement_t default_plan[TASK_MAX] = {
+    // name                 core           prio  stack  location
+    {"SYSTEM_task",         TASK_CORE_ANY, 3,    4096,  TASK_STACK_INTERNAL}, // TASK_SYSTEM
+    {"power mangement",     0,             10,   8192,  TASK_STACK_INTERNAL}, // TASK_POWER_MANAGEMENT
+    {"stratum miner",       1,             10,   8192,  TASK_STACK_INTERNAL}, // TASK_CREATE_JOBS
+    {"asic result",         1,             15,   8192,  TASK_STACK_INTERNAL}, // TASK_ASIC_RESULT
+    {"stratum manager",     TASK_CORE_ANY, 5,    8192,  TASK_STACK_INTERNAL}, // TASK_STRATUM_MANAGER
+    {"stratum task",        TASK_CORE_ANY, 5,    8192,  TASK_STACK_INTERNAL}, // TASK_STRATUM
+    {"ping task",           TASK_CORE_ANY, 1,    4096,  TASK_STACK_INTERNAL}, // TASK_PING
+    {"hr_monitor",          0,             10,   4096,  TASK_STACK_PSRAM},    // TASK_HASHRATE_MONITOR
+    {"influx",              TASK_CORE_ANY, 1,    8192,  TASK_STACK_INTERNAL}, // TASK_INFLUX
+    {"apis ticker",         TASK_CORE_ANY, 5,    8192,  TASK_STACK_PSRAM},    // TASK_APIS
+    {"wifi monitor",        TASK_CORE_ANY, 1,    4096,  TASK_STACK_PSRAM},    // TASK_WIFI_MONITOR
+    {"ota updater",         TASK_CORE_ANY, 1,    8192,  TASK_STACK_INTERNAL}, // TASK_OTA
+    {"discord_task",        TASK_CORE_ANY, 5,    8192,  TASK_STACK_INTERNAL}, // TASK_ALERTER
+    {"http async",          TASK_CORE_ANY, 5,    8192,  TASK_STACK_INTERNAL}, // TASK_HTTP_ASYNC
+    {"lvgl Timer",          1,             4,    6000,  TASK_STACK_INTERNAL}, // TASK_LVGL
+};
+
+TaskPlan::TaskPlan()
+{
+    for (int i = 0; i < TASK_MAX; i++) {
+        m_tasks[i] = default_plan[i];
+    }
+}
+
+void TaskPlan::set(task_id_t id, int core, int priority)
+{
+    m_tasks[id].core = core;
+    m_tasks[id].priority = priority;
+}
+
+void TaskPlan::setStack(task_id_t id, uint32_t stackBytes, task_stack_t stack)
+{
+    m_tasks[id].stackBytes = stackBytes;
+    m_tasks[id].stack = stack;
+}
+
+int TaskPlan::resolve(int numCores, int maxPriority)
+{
+    int changed = 0;
+    for (int i = 0; i < TASK_MAX; i++) {
+        task_placement_t *t = &m_tasks[i];
+        bool fixed = false;
+
+        if (t->core != TASK_CORE_ANY && (t->core < 0 || t->core >= numCores || numCores == 1)) {
+            t->core = TASK_CORE_ANY;
+            fixed = true;
+        }
+        // 0 is the idle task
+        if (t->priority < 1) {
+            t->priority = 1;
+            fixed = true;
+        }
+        if (t->priority >= maxPriority) {
+            t->priority = maxPriority - 1;
+            fixed = true;
+        }
+        if (t->stackBytes < MIN_STACK_BYTES) {
+            t->stackBytes = MIN_STACK_BYTES;
+            fixed = true;
+        }
+        if (t->stack == TASK_STACK_PSRAM && writesFlash((task_id_t) i)) {
+            t->stack = TASK_STACK_INTERNAL;
+            fixed = true;
+        }
+        changed += fixed;
+    }
+    return changed;
+}
+
+bool TaskPlan::isMiningCritical(task_id_t id)
+{
+    return id == TASK_CREATE_JOBS || id == TASK_ASIC_RESULT;
+}
+
+bool TaskPlan::writesFlash(task_id_t id)
+{
+    // settings (Config setters), the alert queue and the factory OTA
+    return id == TASK_SYSTEM || id == TASK_POWER_MANAGEMENT || id == TASK_STRATUM_MANAGER || id == TASK_OTA ||
+           id == TASK_ALERTER;
+}
+
+int TaskPlan::numWifiCoreConflicts() const
+{
+    int num = 0;
+    for (int i = 0; i < TASK_MAX; i++) {
+        if (!isMiningCritical((task_id_t) i)) {
+            continue;
+        }
+        if (m_tasks[i].core == TASK_CORE_ANY || m_tasks[i].core == WIFI_CORE) {
+            num++;
+        }
+    }
+    return num;
+}
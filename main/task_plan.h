@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+
+// Core, priority and stack placement of the firmware tasks.
+//
+// WiFi runs on core 0 (ESP-IDF default), so the CPU bound part of the
+// mining hot path (job creation, ASIC results) is pinned to core 1 where it
+// only shares the CPU with the lower priority LVGL task. Boards can change
+// single entries in their constructor.
+//
+// No ESP-IDF dependencies (see host/task_plan_sim.cpp), tasks are created
+// with task_create() (task_monitor.h).
+
+#define TASK_CORE_ANY -1
+
+typedef enum
+{
+    TASK_SYSTEM,
+    TASK_POWER_MANAGEMENT,
+    TASK_CREATE_JOBS,
+    TASK_ASIC_RESULT,
+    TASK_STRATUM_MANAGER,
+    TASK_STRATUM,
+    TASK_PING,
+    TASK_HASHRATE_MONITOR,
+    TASK_INFLUX,
+    TASK_APIS,
+    TASK_WIFI_MONITOR,
+    TASK_OTA,
+    TASK_ALERTER,
+    TASK_HTTP_ASYNC,
+    TASK_LVGL,
+    TASK_MAX
+} task_id_t;
+
+typedef enum
+{
+    TASK_STACK_INTERNAL,
+    TASK_STACK_PSRAM,
+} task_stack_t;
+
+typedef struct
+{
+    const char *name;
+    int core; // TASK_CORE_ANY for no affinity
+    int priority;
+    uint32_t stackBytes;
+    task_stack_t stack;
+} task_placement_t;
+
+class TaskPlan {
+  public:
+    // the WiFi task and the lwIP driver side run here
+    static constexpr int WIFI_CORE = 0;
+    static constexpr uint32_t MIN_STACK_BYTES = 2048;
+
+  protected:
+    task_placement_t m_tasks[TASK_MAX];
+
+  public:
+    TaskPlan();
+
+    void set(task_id_t id, int core, int priority);
+    void setStack(task_id_t id, uint32_t stackBytes, task_stack_t stack);
+
+    const task_placement_t *get(task_id_t id) const
+    {
+        return &m_tasks[id];
+    }
+
+    // fixes entries the target can't satisfy (core doesn't exist, priority
+    // out of range, stack too small, PSRAM stack of a task that writes the
+    // flash), returns the number of changed entries
+    int resolve(int numCores, int maxPriority);
+
+    // hot path tasks that should not share a core with WiFi
+    static bool isMiningCritical(task_id_t id);
+
+    // tasks that write the flash (NVS, OTA), the cache and with it the
+    // PSRAM is off during the write so their stack has to be internal
+    static bool writesFlash(task_id_t id);
+
+    // number of mining critical tasks that can end up on the WiFi core
+    int numWifiCoreConflicts() const;
+};
@@ -5,6 +5,7 @@
 
 #include "esp_heap_caps.h"
 
+#include "job_slots.h"
 #include "macros.h"
 #include "mining.h"
 
@@ -13,6 +14,8 @@
 class AsicJobs {
 protected:
     bm_job *m_activeJobs[MAX_ASIC_JOBS];
+    bm_job *m_prevJobs[MAX_ASIC_JOBS]; // last occupant of the slot, for late results
+    JobSlots m_slots;
     pthread_mutex_t m_validJobsLock;
 
     void lock() {
@@ -41,6 +44,7 @@ public:
     AsicJobs() {
         m_validJobsLock = PTHREAD_MUTEX_INITIALIZER;
         memset(m_activeJobs, 0, sizeof(m_activeJobs));
+        memset(m_prevJobs, 0, sizeof(m_prevJobs));
     }
 
     int cleanJobs(int pool) {
@@ -52,18 +56,25 @@ public:
                 m_activeJobs[i] = 0;
                 deleted++;
             }
+            if (m_prevJobs[i] && m_prevJobs[i]->pool_id == pool) {
+                free_bm_job(m_prevJobs[i]);
+                m_prevJobs[i] = 0;
+            }
         }
         return deleted;
     }
 
-    void storeJob(bm_job *next_job, uint8_t asic_job_id) {
+    // before the job is sent, so no result of it can miss the slot
+    void storeJob(bm_job *next_job, uint8_t asic_job_id, int64_t nowUs) {
         PThreadGuard g(m_validJobsLock);
-        // if a slot was used before free it
-        if (m_activeJobs[asic_job_id]) {
-            free_bm_job(m_activeJobs[asic_job_id]);
+        // the job before the last one in this slot is gone for good
+        if (m_prevJobs[asic_job_id]) {
+            free_bm_job(m_prevJobs[asic_job_id]);
         }
-        // save job into slot
+        // keep the last one for late results, save job into slot
+        m_prevJobs[asic_job_id] = m_activeJobs[asic_job_id];
         m_activeJobs[asic_job_id] = next_job;
+        m_slots.dispatch(asic_job_id, nowUs);
     }
 
     bm_job *getClone(uint8_t asic_job_id) {
@@ -79,6 +90,29 @@ public:
         return job;
     }
 
+    bm_job *getPrevClone(uint8_t asic_job_id) {
+        PThreadGuard g(m_validJobsLock);
+        if (!m_prevJobs[asic_job_id]) {
+            return NULL;
+        }
+        return cloneBmJob(m_prevJobs[asic_job_id]);
+    }
+
+    job_result_t classify(uint8_t asic_job_id, bool matchCurrent, bool matchPrevious, bool previousKnown, int64_t nowUs) {
+        PThreadGuard g(m_validJobsLock);
+        return m_slots.classify(asic_job_id, matchCurrent, matchPrevious, previousKnown, nowUs);
+    }
+
+    int64_t getLateUs() {
+        PThreadGuard g(m_validJobsLock);
+        return m_slots.getLateUs();
+    }
+
+    void getStats(job_slot_stats_t *out) {
+        PThreadGuard g(m_validJobsLock);
+        m_slots.getStats(out);
+    }
+
 };
 
 
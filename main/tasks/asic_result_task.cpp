@@ -1,6 +1,7 @@
 #include <string.h>
 
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "serial.h"
 #include "utils.h"
@@ -26,6 +27,14 @@ uint64_t getDuplicateHWNonces() {
     return duplicateHWNonces;
 }
 
+// The ASICs only report nonces above the difficulty mask, the largest power
+// of 2 below the job's ASIC difficulty. Verified against the wrong job a
+// nonce has a random difficulty and only rarely gets there.
+static inline bool belongs_to_job(const bm_job *job, double nonce_diff)
+{
+    return nonce_diff >= job->asic_diff / 4.0;
+}
+
 // Combine nonce + version into a single 64-bit key
 static inline uint64_t make_key(uint32_t nonce, uint32_t version)
 {
@@ -78,8 +87,40 @@ void ASIC_result_task(void *pvParameters)
         }
 
         uint8_t asic_job_id = asic_result.job_id;
+        int64_t now_us = esp_timer_get_time();
 
+        // check the nonce difficulty against the job in the slot
         bm_job *job = asicJobs.getClone(asic_job_id);
+        double nonce_diff = job ? test_nonce_value(job, asic_result.nonce, asic_result.rolled_version | job->version) : 0.0;
+        bool match_current = job && belongs_to_job(job, nonce_diff);
+
+        // and against the job before if the slot was reused meanwhile
+        bm_job *prev = match_current ? NULL : asicJobs.getPrevClone(asic_job_id);
+        double prev_diff = prev ? test_nonce_value(prev, asic_result.nonce, asic_result.rolled_version | prev->version) : 0.0;
+        bool match_prev = prev && belongs_to_job(prev, prev_diff);
+
+        job_result_t kind = asicJobs.classify(asic_job_id, match_current, match_prev, prev != NULL, now_us);
+
+        if (match_prev) {
+            // late but the pool job is still valid, otherwise it would be cleaned
+            ESP_LOGI(TAG, "late result for job ID %02X, slot was reused", asic_job_id);
+            if (job) {
+                free_bm_job(job);
+            }
+            job = prev;
+            nonce_diff = prev_diff;
+        } else if (prev) {
+            free_bm_job(prev);
+        }
+
+        if (kind == JOB_RESULT_STALE) {
+            ESP_LOGD(TAG, "stale result for job ID %02X", asic_job_id);
+            if (job) {
+                free_bm_job(job);
+            }
+            continue;
+        }
+
         if (!job) {
             //ESP_LOGI(TAG, "Invalid job id found, 0x%02X", asic_job_id);
             continue;
@@ -88,14 +129,11 @@ void ASIC_result_task(void *pvParameters)
         // now we have the original job and can `or` the version
         asic_result.rolled_version |= job->version;
 
-        // check the nonce difficulty
-        double nonce_diff = test_nonce_value(job, asic_result.nonce, asic_result.rolled_version);
-
         // get best known session diff
         char bestDiffString[16];
         suffixString(STRATUM_MANAGER->getBestSessionDiff(), bestDiffString, sizeof(bestDiffString), 3);
 
-        const char *pool_str = job->pool_id ? "Sec" : "Pri";
+        const char *pool_str = pool_short_name(job->pool_id);
 
         // log the ASIC response, including pool and best session difficulty using human-readable SI formatting
         // we only show responses >= maxAsicDifficulty to avoid spamming the log
@@ -115,12 +153,15 @@ void ASIC_result_task(void *pvParameters)
 
         if (!duplicate && nonce_diff >= board->getAsicMaxDifficulty()) {
             SYSTEM_MODULE.pushShare(asic_result.asic_nr);
+            STRATUM_MANAGER->countWork(board->getAsicMaxDifficulty(), job->target);
         }
 
         // send duplicates to the server (they will get rejected and counted as rejected)
         if (nonce_diff >= job->pool_diff) {
+            // a block goes out before all queued shares
+            bool blockCandidate = nonce_diff > calculateNetworkDifficulty(job->target);
             STRATUM_MANAGER->submitShare(job->pool_id, job->jobid, job->extranonce2, job->ntime, asic_result.nonce,
-                                    asic_result.rolled_version ^ job->version);
+                                    asic_result.rolled_version ^ job->version, blockCandidate);
         }
 
         STRATUM_MANAGER->checkForBestDiff(job->pool_id, nonce_diff, job->target);
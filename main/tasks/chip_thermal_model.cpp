@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "chip_thermal_model.h"
+
+static const char *TAG = "chip_thermal";
+
+#define THERMAL_ALPHA 0.05f
+
+// share of a neighbor's power that heats a chip
+#define NEIGHBOR_COUPLING 0.25f
+
+// frequency granularity and max change per allocation
+#define FREQ_STEP 6.25f
+#define FREQ_MAX_CHANGE 25.0f
+
+// solver iterations, neighbors depend on each other
+#define ALLOC_ITERATIONS 3
+
+static int fanBucket(uint16_t fanPerc)
+{
+    return std::clamp((int) fanPerc * THERMAL_FAN_BUCKETS / 101, 0, THERMAL_FAN_BUCKETS - 1);
+}
+
+ChipThermalModel::ChipThermalModel()
+{}
+
+void ChipThermalModel::init(Board *board)
+{
+    m_asicCount = board->getAsicCount();
+    m_cols = board->getChipLayoutCols();
+    m_chips = new ChipState[m_asicCount]();
+}
+
+void ChipThermalModel::reset(float frequency)
+{
+    m_baseFrequency = frequency;
+    for (int i = 0; i < m_asicCount; i++) {
+        m_chips[i].frequency = frequency;
+        m_chips[i].target = frequency;
+    }
+}
+
+void ChipThermalModel::setChipFrequency(int chip, float frequency)
+{
+    if (chip < 0 || chip >= m_asicCount) {
+        return;
+    }
+    m_chips[chip].frequency = frequency;
+}
+
+bool ChipThermalModel::hasChipOffsets()
+{
+    for (int i = 0; i < m_asicCount; i++) {
+        if (m_chips[i].frequency != m_baseFrequency) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ChipThermalModel::getChipFrequencies(float *out)
+{
+    for (int i = 0; i < m_asicCount; i++) {
+        out[i] = m_chips[i].frequency;
+    }
+}
+
+float ChipThermalModel::getThermalResistance(int chip, uint16_t fanPerc)
+{
+    if (chip < 0 || chip >= m_asicCount) {
+        return 0.0f;
+    }
+    return m_chips[chip].res[fanBucket(fanPerc)];
+}
+
+float ChipThermalModel::sumFrequency(bool useTarget)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < m_asicCount; i++) {
+        sum += useTarget ? m_chips[i].target : m_chips[i].frequency;
+    }
+    return sum;
+}
+
+// board power is split by frequency, all chips share the same voltage
+float ChipThermalModel::chipPower(int chip, float power, bool useTarget)
+{
+    // the power of a frequency change is estimated with the current W/MHz
+    float wattsPerMHz = power / sumFrequency(false);
+    return wattsPerMHz * (useTarget ? m_chips[chip].target : m_chips[chip].frequency);
+}
+
+float ChipThermalModel::neighborPower(int chip, float power, bool useTarget)
+{
+    int row = chip / m_cols;
+    int col = chip % m_cols;
+    float neighbors = 0.0f;
+
+    const int dr[] = {-1, 1, 0, 0};
+    const int dc[] = {0, 0, -1, 1};
+    for (int n = 0; n < 4; n++) {
+        int r = row + dr[n];
+        int c = col + dc[n];
+        int idx = r * m_cols + c;
+        if (r < 0 || c < 0 || c >= m_cols || idx >= m_asicCount) {
+            continue;
+        }
+        neighbors += chipPower(idx, power, useTarget);
+    }
+    return neighbors;
+}
+
+float ChipThermalModel::effectivePower(int chip, float power, bool useTarget)
+{
+    return chipPower(chip, power, useTarget) + NEIGHBOR_COUPLING * neighborPower(chip, power, useTarget);
+}
+
+void ChipThermalModel::learn(Board *board, uint16_t fanPerc, float power)
+{
+    if (!m_chips || power < 1.0f || sumFrequency(false) <= 0.0f) {
+        return;
+    }
+
+    int bucket = fanBucket(fanPerc);
+    for (int i = 0; i < m_asicCount; i++) {
+        float temp = board->getChipTemp(i);
+        float p = effectivePower(i, power, false);
+        if (temp <= m_ambient || p <= 0.0f) {
+            continue;
+        }
+        float r = (temp - m_ambient) / p;
+        float &res = m_chips[i].res[bucket];
+        res = res ? res + THERMAL_ALPHA * (r - res) : r;
+    }
+}
+
+bool ChipThermalModel::allocate(float minFreq, float maxFreq, float cap, uint16_t fanPerc, float power)
+{
+    if (!m_chips || power < 1.0f || sumFrequency(false) <= 0.0f) {
+        return false;
+    }
+
+    int bucket = fanBucket(fanPerc);
+    float wattsPerMHz = power / sumFrequency(false);
+
+    for (int i = 0; i < m_asicCount; i++) {
+        m_chips[i].target = m_chips[i].frequency;
+    }
+
+    for (int iter = 0; iter < ALLOC_ITERATIONS; iter++) {
+        for (int i = 0; i < m_asicCount; i++) {
+            ChipState &chip = m_chips[i];
+            float res = chip.res[bucket];
+
+            // no model for this fan speed yet, keep the chip where it is
+            if (!res) {
+                continue;
+            }
+
+            // power budget of this chip after the heat of its neighbors
+            float budget = (cap - m_ambient) / res;
+            float own = budget - NEIGHBOR_COUPLING * neighborPower(i, power, true);
+
+            float f = std::max(own, 0.0f) / wattsPerMHz;
+            f = std::clamp(f, chip.frequency - FREQ_MAX_CHANGE, chip.frequency + FREQ_MAX_CHANGE);
+            f = std::clamp(f, minFreq, maxFreq);
+
+            // stay on the 6.25MHz grid and don't chase small changes
+            if (f != maxFreq && f != minFreq) {
+                f = floorf(f / FREQ_STEP) * FREQ_STEP;
+            }
+            if (fabsf(f - chip.frequency) < FREQ_STEP) {
+                f = chip.frequency;
+            }
+            chip.target = f;
+        }
+    }
+
+    bool changed = false;
+    for (int i = 0; i < m_asicCount; i++) {
+        ChipState &chip = m_chips[i];
+        float res = chip.res[bucket];
+        chip.predicted = res ? m_ambient + res * effectivePower(i, power, true) : 0.0f;
+        if (chip.target != chip.frequency) {
+            ESP_LOGI(TAG, "chip %d: %.2fMHz -> %.2fMHz (predicted %.1f°C, cap %.1f°C)", i, chip.frequency, chip.target,
+                     chip.predicted, cap);
+            changed = true;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "boards/board.h"
+
+// fan speed ranges the thermal resistance is learned for
+#define THERMAL_FAN_BUCKETS 4
+
+// Per-chip thermal model for multi-chip boards
+//
+// Each chip is modeled as T = T_amb + R(fan) * (P_chip + k * sum(P_neighbors)).
+// Chip power is the board power split by chip frequency, neighbors come from
+// the board's chip layout. R is learned per chip and fan speed range and used
+// to assign each chip the highest frequency that keeps it below the cap.
+class ChipThermalModel {
+  protected:
+    struct ChipState
+    {
+        float res[THERMAL_FAN_BUCKETS]; // °C/W, 0 = not learned yet
+        float frequency;                // currently applied frequency
+        float target;                   // allocated frequency
+        float predicted;                // predicted temp at target frequency
+    };
+
+    int m_asicCount = 0;
+    int m_cols = 0;
+    float m_baseFrequency = 0.0f; // set for all chips by reset()
+    float m_ambient = 25.0f;
+    ChipState *m_chips = nullptr;
+
+    float chipPower(int chip, float power, bool useTarget);
+    float neighborPower(int chip, float power, bool useTarget);
+    float effectivePower(int chip, float power, bool useTarget);
+    float sumFrequency(bool useTarget);
+
+  public:
+    ChipThermalModel();
+
+    void init(Board *board);
+
+    // air temperature at the fan inlet (ambientTemp setting)
+    void setAmbientTemp(float temp)
+    {
+        m_ambient = temp;
+    }
+
+    // all chips were set to the same frequency
+    void reset(float frequency);
+
+    // learn the thermal resistance from the current temps
+    void learn(Board *board, uint16_t fanPerc, float power);
+
+    // computes the target frequency of each chip, returns true if any chip
+    // needs to change
+    bool allocate(float minFreq, float maxFreq, float cap, uint16_t fanPerc, float power);
+
+    void setChipFrequency(int chip, float frequency);
+
+    // true when a chip doesn't run on the frequency set for all
+    bool hasChipOffsets();
+
+    void getChipFrequencies(float *out);
+
+    float getChipFrequency(int chip)
+    {
+        return (chip >= 0 && chip < m_asicCount) ? m_chips[chip].frequency : 0.0f;
+    }
+
+    float getTargetFrequency(int chip)
+    {
+        return (chip >= 0 && chip < m_asicCount) ? m_chips[chip].target : 0.0f;
+    }
+
+    float getPredictedTemp(int chip)
+    {
+        return (chip >= 0 && chip < m_asicCount) ? m_chips[chip].predicted : 0.0f;
+    }
+
+    float getThermalResistance(int chip, uint16_t fanPerc);
+};
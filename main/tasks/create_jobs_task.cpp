@@ -1,5 +1,6 @@
 #include <limits.h>
 #include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
 
@@ -13,9 +14,7 @@
 #include "boards/board.h"
 #include "macros.h"
 #include "system.h"
-
-#define PRIMARY 0
-#define SECONDARY 1
+#include "task_monitor.h"
 
 static const char *TAG = "create_jobs_task";
 
@@ -26,6 +25,7 @@ pthread_mutex_t current_stratum_job_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 class MiningInfo {
   public:
+    // shared with the stratum message, don't modify
     mining_notify *current_job = nullptr;
 
     char *extranonce_str = nullptr;
@@ -38,12 +38,14 @@ class MiningInfo {
     uint32_t active_stratum_difficulty = 8192;
     uint32_t version_mask = 0;
 
-  public:
-    MiningInfo()
-    {
-        current_job = (mining_notify *) CALLOC(1, sizeof(mining_notify));
-    }
+    // arrival of the current job, until the first ASIC job was sent
+    int64_t notify_time_us = 0;
+    bool notify_pending = false;
 
+    Extranonce2Allocator enonce2;
+    bool enonce2_exhausted = false; // logged for the current job
+
+  public:
     void set_version_mask(uint32_t mask)
     {
         version_mask = mask;
@@ -65,6 +67,7 @@ class MiningInfo {
 
         extranonce_str = strdup(enonce);
         extranonce_2_len = enonce2_len;
+        enonce2.setLength(enonce2_len);
     }
 
     void set_next_enonce(char *enonce, int enonce2_len)
@@ -75,45 +78,45 @@ class MiningInfo {
         next_extranonce_2_len = enonce2_len;
     }
 
-    void create_job_mining_notify(mining_notify *notify)
+    void create_job_mining_notify(mining_notify *notify, bool clean)
     {
         // do we have a pending extranonce switch?
         if (next_extranonce_str) {
             safe_free(extranonce_str);
             extranonce_str = strdup(next_extranonce_str);
             extranonce_2_len = next_extranonce_2_len;
+            enonce2.setLength(extranonce_2_len);
             safe_free(next_extranonce_str);
             next_extranonce_2_len = 0;
         }
 
-        safe_free(current_job->job_id);
-        safe_free(current_job->coinbase_1);
-        safe_free(current_job->coinbase_2);
-
-        // copy trivial types
-        memcpy(current_job, notify, sizeof(mining_notify));
-        // duplicate dynamic strings with unknown length
-        current_job->job_id = strdup(notify->job_id);
-        current_job->coinbase_1 = strdup(notify->coinbase_1);
-        current_job->coinbase_2 = strdup(notify->coinbase_2);
+        // a reference instead of a copy
+        StratumApi::freeMiningNotify(current_job);
+        current_job = StratumApi::refMiningNotify(notify);
 
         // set active difficulty with the mining.notify command
         active_stratum_difficulty = stratum_difficulty;
+
+        notify_time_us = esp_timer_get_time();
+        notify_pending = true;
+
+        enonce2.newJob(notify_time_us, notify->ntime, clean);
+        enonce2_exhausted = false;
     }
 
     void invalidate()
     {
         // mark as invalid
-        current_job->ntime = 0;
+        StratumApi::freeMiningNotify(current_job);
+        current_job = nullptr;
         safe_free(extranonce_str);
         safe_free(next_extranonce_str);
-        safe_free(current_job->job_id);
-        safe_free(current_job->coinbase_1);
-        safe_free(current_job->coinbase_2);
     }
 };
 
-MiningInfo miningInfo[2] = {MiningInfo{}, MiningInfo{}};
+MiningInfo miningInfo[STRATUM_MAX_POOLS];
+
+static volatile int s_jobIntervalMs = 0;
 
 #define min(a, b) ((a < b) ? (a) : (b))
 #define max(a, b) ((a > b) ? (a) : (b))
@@ -164,7 +167,7 @@ void create_job_mining_notify(int pool, mining_notify *notify, bool abandonWork)
         if (abandonWork) {
             asicJobs.cleanJobs(pool);
         }
-        miningInfo[pool].create_job_mining_notify(notify);
+        miningInfo[pool].create_job_mining_notify(notify, abandonWork);
     }
     trigger_job_creation();
 }
@@ -176,6 +179,17 @@ void create_job_invalidate(int pool)
     asicJobs.cleanJobs(pool);
 }
 
+int create_job_get_interval_ms()
+{
+    return s_jobIntervalMs;
+}
+
+void create_job_get_enonce2_stats(int pool, enonce2_stats_t *out)
+{
+    PThreadGuard g(current_stratum_job_mutex);
+    miningInfo[pool].enonce2.getStats(out);
+}
+
 void *create_jobs_task(void *pvParameters)
 {
     Board *board = SYSTEM_MODULE.getBoard();
@@ -199,11 +213,16 @@ void *create_jobs_task(void *pvParameters)
         return NULL;
     }
 
-    uint32_t last_ntime[2]{0};
+    uint32_t last_ntime[STRATUM_MAX_POOLS]{0};
     uint64_t last_submit_time = 0;
-    uint32_t extranonce_2 = 0;
+    // ASIC job IDs are derived from it, the extranonce2 values are per pool
+    uint32_t job_counter = 0;
 
     int lastJobInterval = board->getAsicJobIntervalMs();
+    int lastConfiguredInterval = lastJobInterval;
+    s_jobIntervalMs = lastJobInterval;
+    int jobSlots = asics ? asics->getJobSlotCount() : 0;
+    int versionBits = 0;
 
     while (1) {
         if (POWER_MANAGEMENT_MODULE.isShutdown()) {
@@ -214,14 +233,24 @@ void *create_jobs_task(void *pvParameters)
         pthread_cond_wait(&job_cond, &job_mutex); // Wait for the timer or external trigger
         pthread_mutex_unlock(&job_mutex);
 
-        // job interval changed via UI
-        if (board->getAsicJobIntervalMs() != lastJobInterval) {
-            xTimerChangePeriod(job_timer, pdMS_TO_TICKS(board->getAsicJobIntervalMs()), 0);
-            lastJobInterval = board->getAsicJobIntervalMs();
+        // job interval changed via UI or doesn't fit the slots and hashrate anymore
+        int configuredInterval = board->getAsicJobIntervalMs();
+        int jobInterval = JobSlots::policyIntervalMs(configuredInterval, jobSlots, asicJobs.getLateUs(),
+                                                     SYSTEM_MODULE.getCurrentHashrate(), versionBits);
+        if (configuredInterval != lastConfiguredInterval || abs(jobInterval - lastJobInterval) > lastJobInterval / 8) {
+            if (jobInterval != configuredInterval) {
+                ESP_LOGW(TAG, "ASIC job interval %d ms instead of %d ms (%d slots, results up to %lld ms late)", jobInterval,
+                         configuredInterval, jobSlots, asicJobs.getLateUs() / 1000);
+            }
+            xTimerChangePeriod(job_timer, max(pdMS_TO_TICKS(jobInterval), (TickType_t) 1), 0);
+            lastJobInterval = jobInterval;
+            lastConfiguredInterval = configuredInterval;
+            s_jobIntervalMs = jobInterval;
             continue;
         }
 
         bm_job *next_job = nullptr;
+        int64_t notify_time_us = 0;
         int active_pool = 0;
         const char *active_pool_str = "";
 
@@ -231,7 +260,7 @@ void *create_jobs_task(void *pvParameters)
 
         // select pool to mine for
         active_pool = STRATUM_MANAGER->getNextActivePool();
-        active_pool_str = active_pool ? "Sec" : "Pri";
+        active_pool_str = pool_short_name(active_pool);
 
         { // scope for mutex
             PThreadGuard g(current_stratum_job_mutex);
@@ -239,36 +268,41 @@ void *create_jobs_task(void *pvParameters)
             // set current pool data
             MiningInfo *mi = &miningInfo[active_pool];
 
-            if (!mi->current_job->ntime || !asics) {
+            if (!mi->current_job || !mi->current_job->ntime || !asics) {
                 continue;
             }
 
+            versionBits = __builtin_popcount(mi->version_mask);
+
             if (last_ntime[active_pool] != mi->current_job->ntime) {
                 last_ntime[active_pool] = mi->current_job->ntime;
                 ESP_LOGI(TAG, "(%s) New Work Received %s", active_pool_str, mi->current_job->job_id);
             }
 
+            if (mi->notify_pending) {
+                notify_time_us = mi->notify_time_us;
+                mi->notify_pending = false;
+            }
+
+            // next unused extranonce2 of the pool, rolled ntime after a wrap
+            uint64_t extranonce_2;
+            uint32_t ntime_roll;
+            if (!mi->enonce2.next(esp_timer_get_time(), &extranonce_2, &ntime_roll)) {
+                if (!mi->enonce2_exhausted) {
+                    ESP_LOGW(TAG, "(%s) extranonce2 space of %d bytes exhausted, ntime can't be rolled further", active_pool_str,
+                             mi->extranonce_2_len);
+                    mi->enonce2_exhausted = true;
+                }
+                continue;
+            }
+
             // generate extranonce2 hex string
             char extranonce_2_str[mi->extranonce_2_len * 2 + 1]; // +1 zero termination
-            snprintf(extranonce_2_str, sizeof(extranonce_2_str), "%0*lx", (int) mi->extranonce_2_len * 2, extranonce_2);
-
-            // generate coinbase tx
-            int coinbase_tx_len = strlen(mi->current_job->coinbase_1) + strlen(mi->extranonce_str) + strlen(extranonce_2_str) +
-                                  strlen(mi->current_job->coinbase_2);
-            char coinbase_tx[coinbase_tx_len + 1]; // +1 zero termination
-            snprintf(coinbase_tx, sizeof(coinbase_tx), "%s%s%s%s", mi->current_job->coinbase_1, mi->extranonce_str,
-                     extranonce_2_str, mi->current_job->coinbase_2);
-
-            // calculate merkle root
-            char merkle_root[65];
-            calculate_merkle_root_hash(coinbase_tx, mi->current_job->_merkle_branches, mi->current_job->n_merkle_branches,
-                                       merkle_root);
-
-            // we need malloc because we will save it in the job array
-            next_job = (bm_job *) malloc(sizeof(bm_job));
-            construct_bm_job(mi->current_job, merkle_root, mi->version_mask, next_job);
-            next_job->jobid = strdup(mi->current_job->job_id);
-            next_job->extranonce2 = strdup(extranonce_2_str);
+            snprintf(extranonce_2_str, sizeof(extranonce_2_str), "%0*llx", (int) mi->extranonce_2_len * 2,
+                     (unsigned long long) extranonce_2);
+
+            next_job = create_bm_job(mi->current_job, mi->extranonce_str, extranonce_2_str, mi->version_mask);
+            next_job->ntime += ntime_roll;
             next_job->pool_diff = mi->active_stratum_difficulty;
             next_job->pool_id = active_pool;
             next_job->asic_diff = STRATUM_MANAGER->selectAsicDiff(active_pool, mi->active_stratum_difficulty);
@@ -283,14 +317,21 @@ void *create_jobs_task(void *pvParameters)
         }
         last_submit_time = current_time;
 
-        int asic_job_id = asics->sendWork(extranonce_2, next_job);
+        // save job first, results can come back before sendWork returns.
+        // A clean jobs notify may free it meanwhile, the ASIC gets a copy
+        bm_job work = *next_job;
+        int asic_job_id = asics->getAsicJobId(job_counter);
+        asicJobs.storeJob(next_job, asic_job_id, current_time);
 
-        ESP_LOGD(TAG, "(%s) Sent Job (%d): %02X", active_pool_str, active_pool, asic_job_id);
+        asics->sendWork(job_counter, &work);
 
-        // save job
-        asicJobs.storeJob(next_job, asic_job_id);
+        if (notify_time_us) {
+            task_monitor_notify_latency((uint32_t) (esp_timer_get_time() - notify_time_us));
+        }
+
+        ESP_LOGD(TAG, "(%s) Sent Job (%d): %02X", active_pool_str, active_pool, asic_job_id);
 
-        extranonce_2++;
+        job_counter++;
     }
 
     return NULL;
@@ -2,6 +2,7 @@
 
 #include <stdbool.h>
 
+#include "extranonce2.h"
 #include "stratum/stratum_api.h"
 
 
@@ -13,3 +14,9 @@ void set_next_enonce(int pool, char *enonce, int enonce2_len);
 bool create_job_set_difficulty(int pool, uint32_t difficulty);
 void create_job_set_version_mask(int pool, uint32_t mask);
 void create_job_invalidate(int pool);
+
+// job interval in use, the configured one unless the slot policy changed it
+int create_job_get_interval_ms();
+
+// extranonce2 wraps and exhaustion of the pool
+void create_job_get_enonce2_stats(int pool, enonce2_stats_t *out);
@@ -0,0 +1,60 @@
+#include "extranonce2.h"
+
+void Extranonce2Allocator::setLength(int len)
+{
+    if (len < 0) {
+        len = 0;
+    }
+    if (len == m_len && m_mask) {
+        return;
+    }
+    m_len = len;
+    m_mask = len >= 8 ? UINT64_MAX : (1ull << (8 * len)) - 1;
+    m_next = 0;
+    m_used = 0;
+    m_ntime = m_jobNtime;
+}
+
+void Extranonce2Allocator::newJob(int64_t nowUs, uint32_t ntime, bool clean)
+{
+    // the old jobs are abandoned, a far future ntime of one of them doesn't
+    // stay the base of the pool time and the roll
+    int64_t clock = (int64_t) ntime - nowUs / 1000000;
+    if (clock > m_clock || clean) {
+        m_clock = clock;
+    }
+
+    m_jobNtime = ntime;
+
+    // a newer ntime starts over, otherwise the values continue on the
+    // rolled ntime
+    if (ntime > m_ntime || clean) {
+        m_ntime = ntime;
+        m_used = 0;
+    }
+}
+
+bool Extranonce2Allocator::next(int64_t nowUs, uint64_t *value, uint32_t *ntimeRoll)
+{
+    // the whole space was used with this ntime
+    if (m_used > m_mask) {
+        int64_t allowed = m_clock + nowUs / 1000000 + ENONCE2_NTIME_AHEAD_S;
+        if ((int64_t) m_ntime + 1 > allowed) {
+            m_stats.exhausted++;
+            return false;
+        }
+        m_ntime++;
+        m_used = 0;
+        m_stats.wraps++;
+    }
+
+    *value = m_next;
+    *ntimeRoll = m_ntime - m_jobNtime;
+    if (*ntimeRoll > m_stats.maxNtimeRoll) {
+        m_stats.maxNtimeRoll = *ntimeRoll;
+    }
+    m_next = (m_next + 1) & m_mask;
+    m_used++;
+    m_stats.allocated++;
+    return true;
+}
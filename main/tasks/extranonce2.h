@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+// Extranonce2 values of one pool.
+//
+// The job creation used one 32 bit counter for all pools, printed into a
+// buffer of the negotiated length. Above the length the string was cut
+// off, with a 2 byte extranonce2 16 consecutive jobs got the same value
+// after 9 h at 500 ms and the same work was sent again.
+//
+// - every pool counts on its own within the space of its extranonce2 length
+// - the values continue across jobs
+// - after the whole space the ntime is rolled by a second. The rolled ntime
+//   only grows, a job with an older ntime (e.g. a resent identical job)
+//   continues on it and can't repeat work
+// - the ntime never runs more than ENONCE2_NTIME_AHEAD_S ahead of the pool
+//   time, estimated from the notifies
+// - a clean_jobs notify starts the rolled ntime and the pool time over
+//   from its ntime, a single job with a far future ntime only shifts them
+//   until the next one
+// - if no roll is allowed, the space is exhausted until the next second
+//
+// The ASICs roll the version bits and the nonce within every value.
+//
+// No ESP-IDF dependencies (see host/extranonce2_sim.cpp).
+
+// seconds the ntime may run ahead of the pool time
+#define ENONCE2_NTIME_AHEAD_S 60
+
+typedef struct
+{
+    uint64_t allocated;
+    uint32_t wraps;     // went through the whole space within a job
+    uint32_t exhausted; // jobs not created, no value left and ntime not rollable
+    uint32_t maxNtimeRoll;
+} enonce2_stats_t;
+
+class Extranonce2Allocator {
+  protected:
+    int m_len = 0;
+    uint64_t m_mask = 0;   // largest value of the length
+    uint64_t m_next = 0;
+    uint64_t m_used = 0;     // values used with m_ntime
+    uint32_t m_ntime = 0;    // ntime of the values, rolled
+    uint32_t m_jobNtime = 0; // ntime of the current job
+    int64_t m_clock = INT32_MIN; // pool time minus the local time in s
+    enonce2_stats_t m_stats{};
+
+  public:
+    // negotiated length in bytes, a change starts over
+    void setLength(int len);
+
+    int getLength() const
+    {
+        return m_len;
+    }
+
+    // new mining.notify with its ntime, clean if the older jobs are abandoned
+    void newJob(int64_t nowUs, uint32_t ntime, bool clean = false);
+
+    // next value and the seconds to add to the ntime of the job. False if
+    // the space is exhausted
+    bool next(int64_t nowUs, uint64_t *value, uint32_t *ntimeRoll);
+
+    void getStats(enonce2_stats_t *out) const
+    {
+        *out = m_stats;
+    }
+};
@@ -0,0 +1,394 @@
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "fan_controller.h"
+#include "nvs_config.h"
+#include "periodic.hpp"
+
+static const char *TAG = "fan_controller";
+
+// characterization: samples (of 2s) to wait after a step and samples to average
+#define CHAR_SETTLE_SAMPLES 3
+#define CHAR_AVG_SAMPLES 2
+
+// abort the sweep when getting this much above the target temp
+#define CHAR_ABORT_MARGIN 5.0f
+
+// lowest sweep point while the asics hash, below it the curve is extrapolated
+#define CHAR_MIN_PERC_HASHING 20
+
+// stall: output at least this percentage but no tach signal for n samples
+#define STALL_MIN_PERC 20
+#define STALL_SAMPLES 3
+
+// degradation: filtered rpm ratio thresholds with hysteresis
+#define DEGRADED_RATIO 0.70f
+#define RECOVERED_RATIO 0.80f
+#define RATIO_ALPHA 0.05f
+
+// cooling response learning
+#define THERMAL_ALPHA 0.02f
+
+// noise limited mode
+#define THROTTLE_MARGIN 2.0f
+#define THROTTLE_INTERVAL_US sec_to_us(30)
+
+static int percToPoint(uint16_t perc)
+{
+    return std::clamp(((int) perc + 5) / 10 - 1, 0, FAN_CURVE_POINTS - 1);
+}
+
+static uint16_t pointToPerc(int point)
+{
+    return (uint16_t) ((point + 1) * 10);
+}
+
+FanController::FanController()
+{
+    for (int i = 0; i < FAN_MAX_CHANNELS; i++) {
+        m_fans[i].health = FAN_OK;
+        m_fans[i].rpmRatio = 1.0f;
+    }
+}
+
+void FanController::init(Board *board)
+{
+    m_board = board;
+    m_numFans = std::min(board->getNumFans(), FAN_MAX_CHANNELS);
+
+    loadCurves();
+    loadSettings();
+
+    // learn the curve on first start
+    for (int i = 0; i < m_numFans; i++) {
+        if (!m_fans[i].hasCurve) {
+            ESP_LOGI(TAG, "no fan curve for fan %d, characterization scheduled", i);
+            m_charRequested = true;
+        }
+    }
+}
+
+void FanController::loadSettings()
+{
+    m_maxRPM = Config::getFanMaxRPM();
+    m_ambient = (float) Config::getAmbientTemp();
+    // 0 is manual fan speed
+    m_manual = !Config::getTempControlMode();
+}
+
+void FanController::loadCurves()
+{
+    for (int ch = 0; ch < m_numFans; ch++) {
+        char *str = Config::getFanCurve(ch);
+        char *p = str;
+        int n = 0;
+
+        while (*p && n < FAN_CURVE_POINTS) {
+            char *end = nullptr;
+            long v = strtol(p, &end, 10);
+            if (end == p || v < 0 || v > UINT16_MAX) {
+                break;
+            }
+            m_fans[ch].curve[n++] = (uint16_t) v;
+            p = (*end == ',') ? end + 1 : end;
+        }
+        free(str);
+
+        // only accept complete curves with a spinning fan at full speed
+        m_fans[ch].hasCurve = (n == FAN_CURVE_POINTS) && m_fans[ch].curve[FAN_CURVE_POINTS - 1];
+        if (m_fans[ch].hasCurve) {
+            ESP_LOGI(TAG, "fan %d curve loaded, %u rpm at 100%%", ch, m_fans[ch].curve[FAN_CURVE_POINTS - 1]);
+        }
+    }
+}
+
+void FanController::saveCurve(int ch)
+{
+    char buf[FAN_CURVE_POINTS * 6 + 1] = {0};
+    size_t offset = 0;
+
+    for (int i = 0; i < FAN_CURVE_POINTS; i++) {
+        offset += snprintf(buf + offset, sizeof(buf) - offset, i ? ",%u" : "%u", m_fans[ch].curve[i]);
+    }
+    Config::setFanCurve(ch, buf);
+    ESP_LOGI(TAG, "fan %d curve: %s", ch, buf);
+}
+
+float FanController::expectedRPM(int ch, uint16_t perc)
+{
+    const uint16_t *curve = m_fans[ch].curve;
+
+    // below the first point we assume a linear ramp from 0
+    if (perc <= 10) {
+        return (float) curve[0] * (float) perc / 10.0f;
+    }
+
+    int idx = (perc - 10) / 10;
+    if (idx >= FAN_CURVE_POINTS - 1) {
+        return (float) curve[FAN_CURVE_POINTS - 1];
+    }
+
+    float frac = (float) ((perc - 10) % 10) / 10.0f;
+    return (float) curve[idx] + ((float) curve[idx + 1] - (float) curve[idx]) * frac;
+}
+
+// returns the highest fan percentage keeping all characterized fans at or
+// below the given rpm. The fan curve is nonlinear, so we search it instead of
+// scaling the percentage.
+uint16_t FanController::percForRPM(uint16_t rpm)
+{
+    bool hasCurve = false;
+    for (int ch = 0; ch < m_numFans; ch++) {
+        hasCurve |= m_fans[ch].hasCurve;
+    }
+
+    // nothing learned yet, we can't limit
+    if (!hasCurve) {
+        return 100;
+    }
+
+    for (uint16_t perc = 100; perc > 10; perc--) {
+        float maxRPM = 0.0f;
+        for (int ch = 0; ch < m_numFans; ch++) {
+            if (m_fans[ch].hasCurve) {
+                maxRPM = std::max(maxRPM, expectedRPM(ch, perc));
+            }
+        }
+        if (maxRPM <= (float) rpm) {
+            return perc;
+        }
+    }
+    return 10;
+}
+
+bool FanController::anyStalled()
+{
+    for (int ch = 0; ch < m_numFans; ch++) {
+        if (m_fans[ch].health == FAN_STALLED) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// steps the fans from 100% down to 10% and records the settled rpm on each
+// point. Starting from full speed keeps the asics safe while the sweep runs.
+// The sweep stops at floorPerc, the points below are extrapolated.
+uint16_t FanController::characterize(const uint16_t *rpm, float temp, float target, uint16_t floorPerc)
+{
+    if (temp > target + CHAR_ABORT_MARGIN) {
+        ESP_LOGW(TAG, "fan characterization aborted at %u%%, temp %.1f°C too high", pointToPerc(m_charPoint), temp);
+        m_characterizing = false;
+        return 100;
+    }
+
+    // the temp control wants more than the point in progress
+    if (pointToPerc(m_charPoint) < floorPerc && m_charPoint < FAN_CURVE_POINTS - 1) {
+        finishCharacterization(m_charPoint + 1);
+        return 100;
+    }
+
+    m_charSamples++;
+
+    if (m_charSamples > CHAR_SETTLE_SAMPLES) {
+        for (int ch = 0; ch < m_numFans; ch++) {
+            m_charSum[ch] += rpm[ch];
+        }
+    }
+
+    if (m_charSamples < CHAR_SETTLE_SAMPLES + CHAR_AVG_SAMPLES) {
+        return pointToPerc(m_charPoint);
+    }
+
+    for (int ch = 0; ch < m_numFans; ch++) {
+        m_fans[ch].curve[m_charPoint] = (uint16_t) (m_charSum[ch] / CHAR_AVG_SAMPLES);
+        m_charSum[ch] = 0;
+    }
+    m_charSamples = 0;
+
+    if (m_charPoint > 0 && pointToPerc(m_charPoint - 1) >= floorPerc) {
+        m_charPoint--;
+        return pointToPerc(m_charPoint);
+    }
+
+    finishCharacterization(m_charPoint);
+    return 100;
+}
+
+void FanController::finishCharacterization(int lowestPoint)
+{
+    // a line through 0 like expectedRPM() below 10%. Real fans spin faster at
+    // low PWM than that, so the health check can't see them as degraded
+    if (lowestPoint > 0) {
+        ESP_LOGI(TAG, "fan curve below %u%% extrapolated, asics running", pointToPerc(lowestPoint));
+    }
+    for (int ch = 0; ch < m_numFans; ch++) {
+        for (int i = 0; i < lowestPoint; i++) {
+            m_fans[ch].curve[i] = (uint16_t) ((uint32_t) m_fans[ch].curve[lowestPoint] * pointToPerc(i) / pointToPerc(lowestPoint));
+        }
+    }
+
+    for (int ch = 0; ch < m_numFans; ch++) {
+        m_fans[ch].hasCurve = m_fans[ch].curve[FAN_CURVE_POINTS - 1] != 0;
+        if (!m_fans[ch].hasCurve) {
+            ESP_LOGE(TAG, "fan %d reported no rpm at 100%%, curve not saved", ch);
+            continue;
+        }
+        m_fans[ch].rpmRatio = 1.0f;
+        saveCurve(ch);
+    }
+    ESP_LOGI(TAG, "fan characterization finished");
+    m_characterizing = false;
+}
+
+void FanController::checkHealth(const uint16_t *rpm)
+{
+    // rpm lags behind while the fan speeds up or down
+    bool settled = abs((int) m_lastPerc - (int) m_prevPerc) <= 5;
+
+    for (int ch = 0; ch < m_numFans; ch++) {
+        FanState &fan = m_fans[ch];
+
+        if (m_lastPerc >= STALL_MIN_PERC && !rpm[ch]) {
+            if (++fan.stallCount >= STALL_SAMPLES && fan.health != FAN_STALLED) {
+                ESP_LOGE(TAG, "fan %d stalled at %u%%", ch, m_lastPerc);
+                fan.health = FAN_STALLED;
+            }
+            continue;
+        }
+
+        if (rpm[ch]) {
+            fan.stallCount = 0;
+            if (fan.health == FAN_STALLED) {
+                ESP_LOGW(TAG, "fan %d spinning again (%u rpm)", ch, rpm[ch]);
+                fan.health = FAN_OK;
+            }
+        }
+
+        if (!fan.hasCurve || !settled) {
+            continue;
+        }
+
+        float expected = expectedRPM(ch, m_lastPerc);
+        if (expected < 100.0f) {
+            continue;
+        }
+
+        fan.rpmRatio += RATIO_ALPHA * ((float) rpm[ch] / expected - fan.rpmRatio);
+
+        if (fan.health == FAN_OK && fan.rpmRatio < DEGRADED_RATIO) {
+            ESP_LOGW(TAG, "fan %d degraded, running at %.0f%% of learned rpm", ch, fan.rpmRatio * 100.0f);
+            fan.health = FAN_DEGRADED;
+        } else if (fan.health == FAN_DEGRADED && fan.rpmRatio > RECOVERED_RATIO) {
+            ESP_LOGI(TAG, "fan %d recovered", ch);
+            fan.health = FAN_OK;
+        }
+    }
+}
+
+void FanController::learnCoolingResponse(uint16_t perc, float temp, float power)
+{
+    if (temp <= m_ambient || power < 1.0f) {
+        return;
+    }
+
+    float r = (temp - m_ambient) / power;
+    float &res = m_thermalRes[percToPoint(perc)];
+    res = res ? res + THERMAL_ALPHA * (r - res) : r;
+}
+
+// in noise limited mode we trade frequency for rpm: step the frequency down
+// while the capped fans can't hold the target and back up once there is headroom
+void FanController::updateThrottle(uint16_t requestedPerc, float temp, float power, float target)
+{
+    if (!m_maxRPM || m_capPerc >= 100) {
+        if (m_throttleSteps) {
+            ESP_LOGI(TAG, "noise limit inactive, frequency restored");
+            m_throttleSteps = 0;
+        }
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (now - m_lastThrottleChange < (int64_t) THROTTLE_INTERVAL_US) {
+        return;
+    }
+
+    if (requestedPerc > m_capPerc && temp > target + THROTTLE_MARGIN) {
+        if (m_throttleSteps < FAN_MAX_THROTTLE_STEPS) {
+            m_throttleSteps++;
+            m_lastThrottleChange = now;
+            ESP_LOGI(TAG, "fans capped at %u%% (%u rpm), frequency step down (%d)", m_capPerc, m_maxRPM, m_throttleSteps);
+        }
+        return;
+    }
+
+    if (m_throttleSteps > 0 && temp < target - THROTTLE_MARGIN) {
+        // only step up when the learned cooling response predicts we stay
+        // below target with a bit more power
+        float res = m_thermalRes[percToPoint(m_capPerc)];
+        if (!res || m_ambient + res * power * 1.05f < target) {
+            m_throttleSteps--;
+            m_lastThrottleChange = now;
+            ESP_LOGI(TAG, "thermal headroom, frequency step up (%d)", m_throttleSteps);
+        }
+    }
+}
+
+uint16_t FanController::process(uint16_t requestedPerc, const uint16_t *rpm, float temp, float power, float target, bool hashing)
+{
+    if (!m_numFans) {
+        return requestedPerc;
+    }
+
+    // the fan speed was set by hand, the sweep waits for automatic control
+    if (m_manual && m_characterizing) {
+        ESP_LOGW(TAG, "fan characterization aborted, manual fan speed");
+        m_characterizing = false;
+        m_charRequested = true;
+    }
+
+    if (m_charRequested && !m_characterizing && !m_manual) {
+        ESP_LOGI(TAG, "starting fan characterization");
+        m_charRequested = false;
+        m_characterizing = true;
+        m_charPoint = FAN_CURVE_POINTS - 1;
+        m_charSamples = 0;
+        memset(m_charSum, 0, sizeof(m_charSum));
+    }
+
+    uint16_t perc;
+    if (m_characterizing) {
+        uint16_t floorPerc = hashing ? std::max(requestedPerc, (uint16_t) CHAR_MIN_PERC_HASHING) : 0;
+        perc = characterize(rpm, temp, target, floorPerc);
+    } else {
+        checkHealth(rpm);
+        learnCoolingResponse(m_lastPerc, temp, power);
+
+        m_capPerc = m_maxRPM ? percForRPM(m_maxRPM) : 100;
+
+        if (anyStalled()) {
+            // remaining fans have to do the work
+            perc = 100;
+        } else if (m_manual) {
+            // a fan speed set by hand is neither capped nor traded for frequency
+            if (m_throttleSteps) {
+                ESP_LOGI(TAG, "manual fan speed, frequency restored");
+                m_throttleSteps = 0;
+            }
+            perc = requestedPerc;
+        } else {
+            updateThrottle(requestedPerc, temp, power, target);
+            perc = std::min(requestedPerc, m_capPerc);
+        }
+    }
+
+    m_prevPerc = m_lastPerc;
+    m_lastPerc = perc;
+    return perc;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "boards/board.h"
+
+// learned curve points at 10%, 20%, ... 100% PWM
+#define FAN_CURVE_POINTS 10
+#define FAN_MAX_CHANNELS 2
+
+// max number of frequency options we step down in noise limited mode
+#define FAN_MAX_THROTTLE_STEPS 8
+
+class FanController {
+  public:
+    enum Health
+    {
+        FAN_OK,
+        FAN_DEGRADED,
+        FAN_STALLED
+    };
+
+    static const char *healthToStr(Health health)
+    {
+        switch (health) {
+        case FAN_OK:
+            return "ok";
+        case FAN_DEGRADED:
+            return "degraded";
+        case FAN_STALLED:
+            return "stalled";
+        default:
+            return "unknown";
+        }
+    }
+
+  protected:
+    struct FanState
+    {
+        uint16_t curve[FAN_CURVE_POINTS]; // learned rpm per curve point
+        bool hasCurve;
+        Health health;
+        int stallCount;
+        float rpmRatio; // filtered measured / expected rpm
+    };
+
+    Board *m_board = nullptr;
+    int m_numFans = 0;
+    FanState m_fans[FAN_MAX_CHANNELS]{};
+
+    // learned cooling response per curve point
+    // estimated thermal resistance in °C/W above ambient, 0 = unknown
+    float m_thermalRes[FAN_CURVE_POINTS]{};
+    float m_ambient = 25.0f;
+
+    // characterization sweep
+    bool m_characterizing = false;
+    bool m_charRequested = false;
+    int m_charPoint = 0;
+    int m_charSamples = 0;
+    uint32_t m_charSum[FAN_MAX_CHANNELS]{};
+
+    // manual fan speed, no sweep, no noise limit
+    bool m_manual = false;
+
+    // noise limited mode
+    uint16_t m_maxRPM = 0;
+    uint16_t m_capPerc = 100;
+    int m_throttleSteps = 0;
+    int64_t m_lastThrottleChange = 0;
+
+    uint16_t m_lastPerc = 0;
+    uint16_t m_prevPerc = 0;
+
+    void loadCurves();
+    void saveCurve(int ch);
+
+    uint16_t characterize(const uint16_t *rpm, float temp, float target, uint16_t floorPerc);
+    void finishCharacterization(int lowestPoint);
+    void checkHealth(const uint16_t *rpm);
+    void learnCoolingResponse(uint16_t perc, float temp, float power);
+    void updateThrottle(uint16_t requestedPerc, float temp, float power, float target);
+
+    float expectedRPM(int ch, uint16_t perc);
+    uint16_t percForRPM(uint16_t rpm);
+    bool anyStalled();
+
+  public:
+    FanController();
+
+    void init(Board *board);
+    void loadSettings();
+
+    // called once per power management loop with the fan rpms measured for the
+    // last applied output. Returns the fan percentage that should be applied.
+    // While the asics hash the sweep doesn't go below the requested speed
+    uint16_t process(uint16_t requestedPerc, const uint16_t *rpm, float temp, float power, float target, bool hashing);
+
+    void requestCharacterization()
+    {
+        m_charRequested = true;
+    }
+
+    bool isCharacterizing()
+    {
+        return m_characterizing;
+    }
+
+    Health getHealth(int ch)
+    {
+        return (ch >= 0 && ch < m_numFans) ? m_fans[ch].health : FAN_OK;
+    }
+
+    float getRPMRatio(int ch)
+    {
+        return (ch >= 0 && ch < m_numFans) ? m_fans[ch].rpmRatio : 0.0f;
+    }
+
+    uint16_t getMaxRPM()
+    {
+        return m_maxRPM;
+    }
+
+    // number of frequency options the asics are stepped down to stay
+    // within the rpm limit
+    int getThrottleSteps()
+    {
+        return m_throttleSteps;
+    }
+};
@@ -3,6 +3,7 @@
 #include "boards/board.h"
 #include "esp_log.h"
 #include "mining.h"
+#include "task_monitor.h"
 #include "utils.h"
 
 static const char *HR_TAG = "hashrate_monitor";
@@ -30,7 +31,7 @@ bool HashrateMonitor::start(Board *board, Asic *asic)
     m_prevCounter = new uint32_t[m_asicCount]();
 
 
-    xTaskCreatePSRAM(&HashrateMonitor::taskWrapper, "hr_monitor", 4096, (void *) this, 10, NULL);
+    task_create(TASK_HASHRATE_MONITOR, &HashrateMonitor::taskWrapper, (void *) this);
     ESP_LOGI(HR_TAG, "started (period=%lums)", m_period_ms);
     return true;
 }
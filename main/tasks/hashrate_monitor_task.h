@@ -84,7 +84,6 @@ class HashrateMonitor {
     Asic *m_asic = nullptr;
 
     void setChipHashrate(int nr, float temp);
-    float getChipHashrate(int nr);
     float getTotalChipHashrate();
 
   public:
@@ -105,4 +104,7 @@ class HashrateMonitor {
     float getHashrate() {
       return m_hashrate;
     }
+
+    // GH/s of a single chip
+    float getChipHashrate(int nr);
 };
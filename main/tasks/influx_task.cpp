@@ -98,6 +98,39 @@ static void influx_task_fetch_from_stratum_manager(StratumManager *module) {
         influxdb->m_stats.total_blocks_found++;
     }
     last_block_found = found;
+
+    // per pool
+    strlcpy(influxdb->m_poolMode, module->getPoolModeName(), sizeof(influxdb->m_poolMode));
+    for (int i = 0; i < INFLUX_MAX_POOLS && i < STRATUM_MAX_POOLS; i++) {
+        PoolStats *p = &influxdb->m_pools[i];
+        p->configured = module->isPoolConfigured(i);
+        if (!p->configured) {
+            continue;
+        }
+        p->connected = module->isPoolConnected(i);
+        strlcpy(p->host, module->getPoolHost(i), sizeof(p->host));
+        p->accepted = module->getSharesAccepted(i);
+        p->rejected = module->getSharesRejected(i);
+        p->difficulty = module->getPoolDifficulty(i);
+        p->share = module->getActivePoolBalance(i);
+        p->response_ms = module->getPoolResponseMs(i);
+
+        PingTask *ping = module->getPingTask(i);
+        p->ping_rtt = ping ? ping->get_last_ping_rtt() : 0.0f;
+    }
+
+    // solo statistics, the hashrate was fetched from the system module
+    SoloStats solo = module->getSoloStats();
+    const solo_totals_t &total = solo.getTotal();
+    SoloMiningStats *s = &influxdb->m_solo;
+    s->network_difficulty = solo.getNetworkDifficulty();
+    s->valid = s->network_difficulty > 0.0;
+    s->expected_time_s = SoloStats::expectedTimeToBlock(s->network_difficulty, influxdb->m_stats.hashing_speed);
+    s->expected_blocks = total.expectedBlocks;
+    s->luck = SoloStats::luck(total);
+    s->effort = total.roundExpected * 100.0;
+    s->best_percentile = SoloStats::bestPercentile(total.work, total.bestDiff) * 100.0;
+    s->expected_best = SoloStats::expectedBestDiff(total.work);
 }
 
 static void influx_task_fetch_from_system_module(System *module)
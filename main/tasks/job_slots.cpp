@@ -0,0 +1,102 @@
+#include <math.h>
+#include <limits.h>
+
+#include "job_slots.h"
+
+void JobSlots::updateLate(int64_t lateUs)
+{
+    if (lateUs > m_lateUs) {
+        m_lateUs = lateUs;
+    }
+    if (lateUs > m_stats.maxLateUs) {
+        m_stats.maxLateUs = lateUs;
+    }
+}
+
+void JobSlots::dispatch(uint8_t slot, int64_t nowUs)
+{
+    if (m_running >= 0) {
+        m_slots[m_running].retiredUs = nowUs;
+    }
+
+    Slot *s = &m_slots[slot];
+    s->prevRetiredUs = s->retiredUs;
+    s->generation++;
+    s->dispatchUs = nowUs;
+    s->retiredUs = 0;
+    m_running = slot;
+
+    // the peak fades, halves in about 700 dispatches
+    m_lateUs -= m_lateUs >> 10;
+    m_stats.dispatched++;
+}
+
+job_result_t JobSlots::classify(uint8_t slot, bool matchCurrent, bool matchPrevious, bool previousKnown, int64_t nowUs)
+{
+    const Slot *s = &m_slots[slot];
+
+    if (matchCurrent) {
+        if (s->retiredUs && nowUs > s->retiredUs) {
+            updateLate(nowUs - s->retiredUs);
+        }
+        m_stats.current++;
+        return JOB_RESULT_CURRENT;
+    }
+
+    if (matchPrevious) {
+        updateLate(nowUs - s->prevRetiredUs);
+        m_stats.late++;
+        return JOB_RESULT_LATE;
+    }
+
+    // results of a job that was dropped (clean jobs) or already replaced
+    // twice can't be verified, while the slot is fresh they are stale
+    if (!previousKnown && s->generation > 1 && nowUs - s->dispatchUs < 2 * getLateUs()) {
+        m_stats.stale++;
+        return JOB_RESULT_STALE;
+    }
+
+    m_stats.invalid++;
+    return JOB_RESULT_INVALID;
+}
+
+int64_t JobSlots::getLateUs() const
+{
+    return m_lateUs > JOB_SLOTS_MIN_LATE_US ? m_lateUs : JOB_SLOTS_MIN_LATE_US;
+}
+
+int JobSlots::minIntervalMs(int slots, int64_t lateUs)
+{
+    if (slots < 2) {
+        return 0;
+    }
+    // a slot is reused (slots - 1) intervals after its job was retired,
+    // twice the lateness as margin
+    return (int) ((2 * lateUs + (slots - 1) * 1000 - 1) / ((slots - 1) * 1000));
+}
+
+int JobSlots::maxIntervalMs(double hashrateGhs, int versionBits)
+{
+    if (hashrateGhs <= 0.0) {
+        return INT_MAX;
+    }
+    // nonce and version space of a job, half of it as margin
+    double ms = ldexp(1.0, 32 + versionBits) / (hashrateGhs * 1e9) * 1000.0 / 2.0;
+    return ms > INT_MAX ? INT_MAX : (int) ms;
+}
+
+int JobSlots::policyIntervalMs(int configuredMs, int slots, int64_t lateUs, double hashrateGhs, int versionBits)
+{
+    int minMs = minIntervalMs(slots, lateUs);
+    int maxMs = maxIntervalMs(hashrateGhs, versionBits);
+
+    if (configuredMs < minMs) {
+        return minMs;
+    }
+    // without version rolling the space may be gone faster than the slots
+    // allow, the slots win
+    if (configuredMs > maxMs && maxMs >= minMs) {
+        return maxMs;
+    }
+    return configuredMs;
+}
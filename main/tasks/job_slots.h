@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+
+// Bookkeeping of the ASIC job slots.
+//
+// The ASIC job ID is derived from the extranonce2 counter and only 16
+// distinct IDs exist on the BM1366/BM1368/BM1370, a slot gets a new job
+// every 16 dispatches. A result only carries the slot, a nonce arriving
+// after its slot was reused was verified against the wrong job and looked
+// like a hardware error.
+//
+// - every dispatch starts a new generation of the slot and retires the job
+//   that ran on the ASICs until then
+// - the previous job of a slot is kept, a result that doesn't verify against
+//   the current job is tried against it (late result)
+// - the lateness of results (arrival after their job was retired) is
+//   tracked, the job interval policy keeps the slot reuse time above it
+//
+// No ESP-IDF dependencies (see host/job_slots_sim.cpp).
+
+#define JOB_SLOTS_MAX 128
+
+// lateness assumed before anything was measured
+#define JOB_SLOTS_MIN_LATE_US 20000
+
+typedef enum
+{
+    JOB_RESULT_CURRENT, // verified against the job in the slot
+    JOB_RESULT_LATE,    // verified against the previous job, the slot was reused
+    JOB_RESULT_STALE,   // slot reused recently, the previous job is gone
+    JOB_RESULT_INVALID, // verified against nothing, hardware error
+} job_result_t;
+
+typedef struct
+{
+    uint32_t dispatched;
+    uint32_t current;
+    uint32_t late;
+    uint32_t stale;
+    uint32_t invalid;
+    int64_t maxLateUs; // latest arrival after the job was retired
+} job_slot_stats_t;
+
+class JobSlots {
+  protected:
+    struct Slot
+    {
+        uint32_t generation;
+        int64_t dispatchUs;
+        int64_t retiredUs;     // next job was sent, 0 while running
+        int64_t prevRetiredUs; // of the previous job in the slot
+    };
+
+    Slot m_slots[JOB_SLOTS_MAX] = {};
+    int m_running = -1;  // slot of the job on the ASICs
+    int64_t m_lateUs = 0; // decaying peak of the lateness
+    job_slot_stats_t m_stats{};
+
+    void updateLate(int64_t lateUs);
+
+  public:
+    // job sent to the ASICs
+    void dispatch(uint8_t slot, int64_t nowUs);
+
+    // result verified (or not) against the current and the previous job
+    job_result_t classify(uint8_t slot, bool matchCurrent, bool matchPrevious, bool previousKnown, int64_t nowUs);
+
+    uint32_t getGeneration(uint8_t slot) const
+    {
+        return m_slots[slot].generation;
+    }
+
+    // how long results arrive after their job was retired
+    int64_t getLateUs() const;
+
+    void getStats(job_slot_stats_t *out) const
+    {
+        *out = m_stats;
+    }
+
+    // shortest interval that doesn't reuse a slot while its results arrive
+    static int minIntervalMs(int slots, int64_t lateUs);
+
+    // longest interval before the ASICs run out of nonce and version space
+    static int maxIntervalMs(double hashrateGhs, int versionBits);
+
+    // the configured interval, clamped to the two above
+    static int policyIntervalMs(int configuredMs, int slots, int64_t lateUs, double hashrateGhs, int versionBits);
+};
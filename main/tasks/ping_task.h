@@ -48,11 +48,8 @@ class PingTask {
 
   public:
     PingTask(StratumManager *manager, int pool) : m_pool(pool), m_manager(manager) {
-        if (!pool) {
-            m_tag = "ping task (pri)";
-        } else {
-            m_tag = "ping task (sec)";
-        }
+        static const char *tags[] = {"ping task (pri)", "ping task (sec)", "ping task (p3)", "ping task (p4)"};
+        m_tag = tags[pool & 3];
     }
 
     void reset();
@@ -18,6 +18,9 @@
 
 #define POLL_RATE 2000
 
+// per-chip temperature cap above the pid target for chip balancing
+#define CHIP_TEMP_CAP_MARGIN 3.0f
+
 static const char *TAG = "power_management";
 
 PowerManagementTask::PowerManagementTask()
@@ -79,15 +82,50 @@ void PowerManagementTask::checkCoreVoltageChanged()
     }
 }
 
+// configured frequency, stepped down through the board's frequency
+// options while the fans are noise limited
+uint16_t PowerManagementTask::getEffectiveAsicFrequency()
+{
+    uint16_t asic_frequency = m_board->getAsicFrequency();
+    int steps = m_fanController.getThrottleSteps();
+
+    const std::vector<uint32_t> &options = m_board->getFrequencyOptions();
+    for (auto it = options.rbegin(); it != options.rend() && steps > 0; ++it) {
+        if (*it < asic_frequency) {
+            asic_frequency = (uint16_t) *it;
+            steps--;
+        }
+    }
+    return asic_frequency;
+}
+
+// chips that were balanced individually are ramped from their own
+// frequency, a broadcast ramp would make them jump to the last common one
+bool PowerManagementTask::setAllChipsFrequency(float frequency)
+{
+    bool ok;
+    if (m_chipModel.hasChipOffsets()) {
+        std::vector<float> current(m_board->getAsicCount());
+        m_chipModel.getChipFrequencies(current.data());
+        ok = m_board->setAsicFrequency(frequency, current.data());
+    } else {
+        ok = m_board->setAsicFrequency(frequency);
+    }
+
+    // all chips run on the same frequency again
+    m_chipModel.reset(frequency);
+    return ok;
+}
+
 void PowerManagementTask::checkAsicFrequencyChanged()
 {
     static uint16_t last_asic_frequency = 0;
 
-    uint16_t asic_frequency = m_board->getAsicFrequency();
+    uint16_t asic_frequency = getEffectiveAsicFrequency();
 
     if (asic_frequency != last_asic_frequency) {
         ESP_LOGI(TAG, "setting new asic frequency to %uMHz", asic_frequency);
-        if (!m_board->setAsicFrequency((float) asic_frequency)) {
+        if (!setAllChipsFrequency((float) asic_frequency)) {
             ESP_LOGE(TAG, "pll setting not found for %uMHz", asic_frequency);
         }
         last_asic_frequency = asic_frequency;
@@ -127,6 +165,61 @@ void PowerManagementTask::checkPidSettingsChanged()
     }
 }
 
+// moves frequency from hot chips to cooler ones so a single hotspot doesn't
+// throttle the whole board
+void PowerManagementTask::balanceChipFrequencies(float targetTemp)
+{
+    // not available when asics are shutdown or not initialized
+    if (m_shutdown || !m_board->isInitialized() || m_board->getAsicCount() < 2) {
+        return;
+    }
+
+    // requires per-chip temperatures
+    if (m_board->getMaxChipTemp() == 0.0f) {
+        return;
+    }
+
+    m_chipModel.setAmbientTemp((float) Config::getAmbientTemp());
+    m_chipModel.learn(m_board, m_fanPerc, m_power);
+
+    float base = (float) getEffectiveAsicFrequency();
+
+    if (!Config::isChipBalanceEnabled()) {
+        if (m_chipModel.hasChipOffsets()) {
+            ESP_LOGI(TAG, "chip balancing disabled, setting all chips to %.2fMHz", base);
+            setAllChipsFrequency(base);
+        }
+        return;
+    }
+
+    static Periodic every_30s(sec_to_us(30), /*start_immediately=*/false);
+    if (!every_30s.due()) {
+        return;
+    }
+
+    const std::vector<uint32_t> &options = m_board->getFrequencyOptions();
+    float minFreq = options.empty() ? base : std::min((float) options.front(), base);
+    float maxFreq = base + (float) Config::getChipBoost();
+    if (m_board->getAbsMaxAsicFrequency()) {
+        maxFreq = std::min(maxFreq, (float) m_board->getAbsMaxAsicFrequency());
+    }
+
+    if (!m_chipModel.allocate(minFreq, maxFreq, targetTemp + CHIP_TEMP_CAP_MARGIN, m_fanPerc, m_power)) {
+        return;
+    }
+
+    for (int i = 0; i < m_board->getAsicCount(); i++) {
+        float current = m_chipModel.getChipFrequency(i);
+        float target = m_chipModel.getTargetFrequency(i);
+        if (target == current) {
+            continue;
+        }
+        if (m_board->setChipFrequency(i, current, target)) {
+            m_chipModel.setChipFrequency(i, target);
+        }
+    }
+}
+
 void PowerManagementTask::logChipTemps()
 {
     size_t offset = 0;
@@ -254,6 +347,9 @@ void PowerManagementTask::task()
 
     m_board->setFanPolarity(invert);
 
+    m_fanController.init(m_board);
+    m_chipModel.init(m_board);
+
     // pointer to pid settings
     PidSettings *pidSettings = m_board->getPidSettings();
 
@@ -300,6 +396,8 @@ void PowerManagementTask::task()
             asic_overheat_temp = 70;
         }
 
+        m_fanController.loadSettings();
+
         applyAsicSettings();
 
         // check if pid settings changed
@@ -347,6 +445,8 @@ void PowerManagementTask::task()
 
         influx_task_set_temperature(m_chipTempMax, m_vrTemp);
 
+        balanceChipFrequencies((float) pidSettings->targetTemp);
+
         float vr_maxTemp = asic_overheat_temp;
         if (m_board->getVrMaxTemp()) {
             vr_maxTemp = m_board->getVrMaxTemp();
@@ -373,21 +473,25 @@ void PowerManagementTask::task()
         case 0:
             // manual
             m_fanPerc = Config::getFanSpeed();
-            m_board->setFanSpeed((float) m_fanPerc / 100.0f);
             break;
         case 2:
             // pid
             m_fanPerc = (uint16_t) roundf(pid_output);
-            m_board->setFanSpeed((float) m_fanPerc / 100.0f);
             // ESP_LOGI(TAG, "PID: Temp: %.1f°C, SetPoint: %.1f°C, Output: %.1f%%", pid_input, pid_target, pid_output);
             // ESP_LOGI(TAG, "p:%.2f i:%.2f d:%.2f", m_pid->GetKp(), m_pid->GetKi(), m_pid->GetKd());
             break;
         default:
             ESP_LOGE(TAG, "invalid temp control mode: %d. Defaulting to manual mode 100%%.", temp_control_mode);
             m_fanPerc = 100;
-            m_board->setFanSpeed((float) m_fanPerc / 100.0f);
         }
+
+        // characterization, stall handling and noise limit
+        m_fanPerc = m_fanController.process(m_fanPerc, m_fanRPM, pid_input, m_power, pid_target, !m_shutdown);
+        m_board->setFanSpeed((float) m_fanPerc / 100.0f);
+
         unlock();
+
+        LIVE_STATS.updateAsic();
         // uint64_t end = esp_timer_get_time();
         // uint64_t duration = (end - start) / 1000llu;
         // uint64_t interval = (start - last_time) / 1000llu;
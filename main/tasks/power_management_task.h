@@ -3,6 +3,8 @@
 #include <pthread.h>
 #include "boards/board.h"
 #include "pid/PID_v1_bc.h"
+#include "fan_controller.h"
+#include "chip_thermal_model.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "esp_timer.h"
@@ -36,11 +38,16 @@ class PowerManagementTask {
     bool m_shutdown = false;
     PID *m_pid;
     Board* m_board = nullptr;
+    FanController m_fanController;
+    ChipThermalModel m_chipModel;
 
+    uint16_t getEffectiveAsicFrequency();
+    bool setAllChipsFrequency(float frequency);
     void checkCoreVoltageChanged();
     void checkAsicFrequencyChanged();
     void checkPidSettingsChanged();
     void checkVrFrequencyChanged();
+    void balanceChipFrequencies(float targetTemp);
     void readAndPublishPowerTelemetry();
     void applyAsicSettings();
     void task();
@@ -87,6 +94,16 @@ class PowerManagementTask {
         return m_fanPerc;
     };
 
+    FanController *getFanController()
+    {
+        return &m_fanController;
+    };
+
+    ChipThermalModel *getChipModel()
+    {
+        return &m_chipModel;
+    };
+
     void lock() {
         xSemaphoreTakeRecursive(m_mutex, portMAX_DELAY);
     }
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+
+#include "time_sync.h"
+
+int64_t TimeSync::appliedSlew(int64_t dt) const
+{
+    if (dt <= 0 || !m_slew) {
+        return 0;
+    }
+    // the slew is applied with MAX_SLEW_PPM from the base of the mapping
+    int64_t max = dt * MAX_SLEW_PPM / 1000000ll;
+    if (m_slew > max) {
+        return max;
+    }
+    if (m_slew < -max) {
+        return -max;
+    }
+    return m_slew;
+}
+
+int64_t TimeSync::toUtc(int64_t monoUs) const
+{
+    int64_t dt = monoUs - m_baseMono;
+    int64_t drift = (int64_t) ((double) dt * m_driftPpm / 1e6);
+    return m_baseUtc + dt + drift + appliedSlew(dt);
+}
+
+int64_t TimeSync::getSlewRemaining(int64_t monoUs) const
+{
+    return m_slew - appliedSlew(monoUs - m_baseMono);
+}
+
+void TimeSync::rebase(int64_t monoUs, int64_t utcUs, int64_t slew)
+{
+    m_baseMono = monoUs;
+    m_baseUtc = utcUs;
+    m_slew = slew;
+}
+
+TimeSync::Result TimeSync::sample(int64_t monoUs, int64_t utcUs, int64_t *stepUs)
+{
+    if (utcUs < MIN_VALID_UTC_US || (m_synced && monoUs < m_baseMono)) {
+        return Result::Rejected;
+    }
+
+    m_numSamples++;
+
+    if (!m_synced) {
+        rebase(monoUs, utcUs, 0);
+        m_driftMono = monoUs;
+        m_driftOffset = 0;
+        m_lastOffset = 0;
+        m_synced = true;
+        return Result::First;
+    }
+
+    int64_t predicted = toUtc(monoUs);
+    int64_t offset = utcUs - predicted;
+    m_lastOffset = offset;
+
+    if (llabs(offset) > STEP_THRESHOLD_US) {
+        // a single bad response must not step the clock, wait for a second
+        // sample that agrees with this one
+        if (!m_pending || llabs(offset - m_pendingOffset) > STEP_THRESHOLD_US) {
+            m_pending = true;
+            m_pendingOffset = offset;
+            return Result::Pending;
+        }
+        m_pending = false;
+
+        // the drift estimate stays, the step most likely wasn't caused by it
+        rebase(monoUs, utcUs, 0);
+        m_driftMono = monoUs;
+        m_driftOffset = 0;
+        m_lastStep = offset;
+        m_numSteps++;
+        if (stepUs) {
+            *stepUs = offset;
+        }
+        return Result::Step;
+    }
+    m_pending = false;
+
+    // the part of the offset that isn't explained by the not yet applied slew
+    // accumulated because of the frequency error
+    m_driftOffset += offset - getSlewRemaining(monoUs);
+
+    int64_t interval = monoUs - m_driftMono;
+    if (interval >= MIN_DRIFT_INTERVAL_US) {
+        double errorPpm = (double) m_driftOffset * 1e6 / (double) interval;
+
+        // weight the estimates by their interval, the network jitter is
+        // the same for every sample
+        double gain = (double) interval / (double) (m_driftWeight + interval);
+        m_driftPpm += gain * errorPpm;
+        m_driftWeight += interval;
+        if (m_driftWeight > MAX_DRIFT_WEIGHT_US) {
+            m_driftWeight = MAX_DRIFT_WEIGHT_US;
+        }
+        if (m_driftPpm > MAX_DRIFT_PPM) {
+            m_driftPpm = MAX_DRIFT_PPM;
+        }
+        if (m_driftPpm < -MAX_DRIFT_PPM) {
+            m_driftPpm = -MAX_DRIFT_PPM;
+        }
+        m_numDriftSamples++;
+        m_driftMono = monoUs;
+        m_driftOffset = 0;
+    }
+
+    // continue from the predicted time so the mapping stays continuous,
+    // the whole offset (including the remaining slew) is slewed from here
+    rebase(monoUs, predicted, offset);
+    return Result::Slew;
+}
+
+uint32_t TimeSync::getPollIntervalMs() const
+{
+    if (m_pending) {
+        return POLL_CONFIRM_MS;
+    }
+    if (isDriftLocked()) {
+        return POLL_LOCKED_MS;
+    }
+    return POLL_LEARN_MS << m_numDriftSamples;
+}
+
+const char *TimeSync::resultToStr(Result r)
+{
+    switch (r) {
+    case Result::First:
+        return "first";
+    case Result::Slew:
+        return "slew";
+    case Result::Step:
+        return "step";
+    case Result::Pending:
+        return "pending";
+    case Result::Rejected:
+        return "rejected";
+    }
+    return "unknown";
+}
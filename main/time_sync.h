@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+
+// Maps the monotonic esp_timer clock (us since boot) to UTC (us since epoch).
+//
+// SNTP results are fed in as samples. Small offsets are slewed (max 500ppm)
+// so the mapped time never jumps or runs backwards, only offsets above
+// STEP_THRESHOLD_US are stepped - and only after a second sample confirmed
+// them. The frequency error of the crystal is estimated from the offsets of
+// consecutive samples and applied to the mapping.
+//
+// No locking and no ESP-IDF dependencies (see host/time_sync_sim.cpp).
+class TimeSync {
+  public:
+    enum class Result
+    {
+        First,    // first sample, clock was set
+        Slew,     // offset is being slewed
+        Step,     // confirmed large offset, clock was stepped
+        Pending,  // large offset, waiting for confirmation
+        Rejected, // implausible sample
+    };
+
+    static constexpr int64_t STEP_THRESHOLD_US = 128000;
+    static constexpr int32_t MAX_SLEW_PPM = 500;
+    static constexpr double MAX_DRIFT_PPM = 500.0;
+    static constexpr int64_t MIN_DRIFT_INTERVAL_US = 60ll * 1000000ll;
+    static constexpr int64_t MIN_VALID_UTC_US = 1609459200ll * 1000000ll; // 2021-01-01
+
+    static constexpr int64_t MAX_DRIFT_WEIGHT_US = 4ll * 3600ll * 1000000ll;
+
+    // short intervals until the drift is known, even 500ppm stay below
+    // the step threshold then, doubled after each estimate
+    static constexpr uint32_t POLL_CONFIRM_MS = 30 * 1000;
+    static constexpr uint32_t POLL_LEARN_MS = 64 * 1000;
+    static constexpr uint32_t POLL_LOCKED_MS = 60 * 60 * 1000;
+    static constexpr int DRIFT_LOCK_SAMPLES = 6;
+
+  protected:
+    bool m_synced = false;
+
+    // mapping: utc = baseUtc + dt * (1 + drift) + slew applied so far
+    int64_t m_baseMono = 0;
+    int64_t m_baseUtc = 0;
+    double m_driftPpm = 0.0;
+    int64_t m_slew = 0;
+
+    // drift estimation
+    int64_t m_driftMono = 0;   // start of the current estimation interval
+    int64_t m_driftOffset = 0; // offset caused by the frequency error since then
+    int64_t m_driftWeight = 0; // sum of the estimation intervals (capped)
+    int m_numDriftSamples = 0;
+
+    // large offset waiting for confirmation
+    bool m_pending = false;
+    int64_t m_pendingOffset = 0;
+
+    int64_t m_lastOffset = 0;
+    int64_t m_lastStep = 0;
+    uint32_t m_numSteps = 0;
+    uint32_t m_numSamples = 0;
+
+    int64_t appliedSlew(int64_t dt) const;
+    void rebase(int64_t monoUs, int64_t utcUs, int64_t slew);
+
+  public:
+    // stepUs is set to the size of the step for Step
+    Result sample(int64_t monoUs, int64_t utcUs, int64_t *stepUs);
+
+    int64_t toUtc(int64_t monoUs) const;
+
+    bool isSynced() const
+    {
+        return m_synced;
+    }
+    double getDriftPpm() const
+    {
+        return m_driftPpm;
+    }
+    bool isDriftLocked() const
+    {
+        return m_numDriftSamples >= DRIFT_LOCK_SAMPLES;
+    }
+    int64_t getLastOffset() const
+    {
+        return m_lastOffset;
+    }
+    int64_t getLastStep() const
+    {
+        return m_lastStep;
+    }
+    uint32_t getNumSteps() const
+    {
+        return m_numSteps;
+    }
+    uint32_t getNumSamples() const
+    {
+        return m_numSamples;
+    }
+
+    // slew that still has to be applied at monoUs
+    int64_t getSlewRemaining(int64_t monoUs) const;
+
+    // SNTP poll interval for the next request
+    uint32_t getPollIntervalMs() const;
+
+    static const char *resultToStr(Result r);
+};
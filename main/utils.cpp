@@ -75,6 +75,14 @@ double calculateNetworkDifficulty(uint32_t nBits)
 
 BaseType_t xTaskCreatePSRAM(TaskFunction_t pxTaskCode, const char *const pcName, const uint32_t usStackDepthBytes,
                             void *const pvParameters, UBaseType_t uxPriority, TaskHandle_t *const pxCreatedTask)
+{
+    return xTaskCreatePSRAMPinnedToCore(pxTaskCode, pcName, usStackDepthBytes, pvParameters, uxPriority, pxCreatedTask,
+                                        tskNO_AFFINITY);
+}
+
+BaseType_t xTaskCreatePSRAMPinnedToCore(TaskFunction_t pxTaskCode, const char *const pcName, const uint32_t usStackDepthBytes,
+                                        void *const pvParameters, UBaseType_t uxPriority, TaskHandle_t *const pxCreatedTask,
+                                        const BaseType_t xCoreID)
 {
     const uint32_t stackDepth = usStackDepthBytes / sizeof(StackType_t);
 
@@ -93,10 +101,11 @@ BaseType_t xTaskCreatePSRAM(TaskFunction_t pxTaskCode, const char *const pcName,
         return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
     }
 
-    TaskHandle_t handle = xTaskCreateStatic(pxTaskCode, pcName, stackDepth, pvParameters, uxPriority, stack, tcb);
+    TaskHandle_t handle =
+        xTaskCreateStaticPinnedToCore(pxTaskCode, pcName, stackDepth, pvParameters, uxPriority, stack, tcb, xCoreID);
 
     if (!handle) {
-        ESP_LOGE("task_psram", "xTaskCreateStatic failed");
+        ESP_LOGE("task_psram", "xTaskCreateStaticPinnedToCore failed");
         heap_caps_free(stack);
         heap_caps_free(tcb);
         return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
@@ -8,3 +8,6 @@ double calculateNetworkDifficulty(uint32_t nBits);
 
 BaseType_t xTaskCreatePSRAM(TaskFunction_t pxTaskCode, const char *const pcName, const uint32_t usStackDepthBytes,
                             void *const pvParameters, UBaseType_t uxPriority, TaskHandle_t *const pxCreatedTask);
+BaseType_t xTaskCreatePSRAMPinnedToCore(TaskFunction_t pxTaskCode, const char *const pcName, const uint32_t usStackDepthBytes,
+                                        void *const pvParameters, UBaseType_t uxPriority, TaskHandle_t *const pxCreatedTask,
+                                        const BaseType_t xCoreID);
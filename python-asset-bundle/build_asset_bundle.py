@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""Pack the web UI into a read-only asset bundle for the www partition.
+
+Layout (little endian):
+
+    header   magic "NQAB", u16 version, u16 count, u32 total size,
+             u32 strings offset, u32 data offset, u32 reserved
+    entries  count * (u32 path, u32 mime, u32 offset, u32 size,
+                      u8 hash[16], u32 flags), sorted by path
+    strings  NUL-terminated paths and mime types
+    data     file contents, 4 byte aligned
+
+Files ending with .gz are stored as they are and served with
+Content-Encoding gzip under the name without .gz. The hash is the first
+16 bytes of the SHA-256 of the stored bytes and used as ETag.
+"""
+
+import argparse
+import hashlib
+import os
+import struct
+import sys
+
+MAGIC = b"NQAB"
+VERSION = 1
+
+HEADER = struct.Struct("<4sHHIIII")
+ENTRY = struct.Struct("<IIII16sI")
+
+FLAG_GZIP = 0x01
+
+# keep in sync with set_content_type_from_file in handler_file.cpp
+MIME_TYPES = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+    ".svg": "image/svg+xml",
+    ".woff2": "font/woff2",
+    ".json": "application/json",
+}
+
+
+def align4(n):
+    return (n + 3) & ~3
+
+
+def collect(base_dir):
+    """Return a list of (url path, file path, flags)."""
+    assets = {}
+    for root, _, files in os.walk(base_dir):
+        for name in files:
+            full = os.path.join(root, name)
+            rel = "/" + os.path.relpath(full, base_dir).replace(os.sep, "/")
+            flags = 0
+            if rel.endswith(".gz"):
+                rel = rel[:-3]
+                flags |= FLAG_GZIP
+            if rel in assets:
+                raise ValueError("duplicate asset %s" % rel)
+            assets[rel] = (full, flags)
+    return [(path, full, flags) for path, (full, flags) in sorted(assets.items(), key=lambda a: a[0].encode())]
+
+
+def mime_type(path):
+    return MIME_TYPES.get(os.path.splitext(path)[1], "text/plain")
+
+
+def build(base_dir):
+    assets = collect(base_dir)
+    if not assets:
+        raise ValueError("no files found in %s" % base_dir)
+    if len(assets) > 0xFFFF:
+        raise ValueError("too many files")
+
+    strings = bytearray()
+    string_pos = {}
+
+    def add_string(s):
+        if s not in string_pos:
+            string_pos[s] = len(strings)
+            strings.extend(s.encode() + b"\0")
+        return string_pos[s]
+
+    strings_offset = HEADER.size + ENTRY.size * len(assets)
+    for path, _, _ in assets:
+        add_string(path)
+        add_string(mime_type(path))
+
+    data_offset = align4(strings_offset + len(strings))
+    data = bytearray()
+    entries = bytearray()
+
+    for path, full, flags in assets:
+        with open(full, "rb") as f:
+            content = f.read()
+        offset = data_offset + len(data)
+        digest = hashlib.sha256(content).digest()[:16]
+        entries.extend(ENTRY.pack(strings_offset + string_pos[path], strings_offset + string_pos[mime_type(path)],
+                                  offset, len(content), digest, flags))
+        data.extend(content)
+        data.extend(b"\0" * (align4(len(data)) - len(data)))
+
+    total = data_offset + len(data)
+    header = HEADER.pack(MAGIC, VERSION, len(assets), total, strings_offset, data_offset, 0)
+    image = header + entries + strings + b"\0" * (data_offset - strings_offset - len(strings)) + data
+    assert len(image) == total
+    return image
+
+
+def read_cstring(image, offset):
+    end = image.index(b"\0", offset)
+    return image[offset:end].decode()
+
+
+def parse(image):
+    """Parse a bundle the way the firmware does, returns {path: (mime, flags, hash, bytes)}."""
+    magic, version, count, total, _, _, _ = HEADER.unpack_from(image, 0)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("invalid bundle header")
+    if total > len(image):
+        raise ValueError("bundle truncated")
+
+    result = {}
+    for i in range(count):
+        path_off, mime_off, offset, size, digest, flags = ENTRY.unpack_from(image, HEADER.size + i * ENTRY.size)
+        if offset + size > total:
+            raise ValueError("entry %d out of bounds" % i)
+        result[read_cstring(image, path_off)] = (read_cstring(image, mime_off), flags, digest, image[offset:offset + size])
+    return result
+
+
+def verify(image, base_dir):
+    """Compare every asset in the bundle against its source file."""
+    parsed = parse(image)
+    paths = list(parsed)
+    if paths != sorted(paths, key=lambda p: p.encode()):
+        raise ValueError("index not sorted")
+
+    assets = collect(base_dir)
+    if len(assets) != len(parsed):
+        raise ValueError("asset count mismatch")
+
+    for path, full, flags in assets:
+        with open(full, "rb") as f:
+            content = f.read()
+        mime, bflags, digest, data = parsed[path]
+        if data != content:
+            raise ValueError("content mismatch for %s" % path)
+        if bflags != flags or mime != mime_type(path):
+            raise ValueError("metadata mismatch for %s" % path)
+        if digest != hashlib.sha256(content).digest()[:16]:
+            raise ValueError("hash mismatch for %s" % path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build the www asset bundle")
+    parser.add_argument("base_dir", help="directory with the web UI files")
+    parser.add_argument("output", help="output image")
+    parser.add_argument("--max-size", type=lambda v: int(v, 0), help="partition size")
+    parser.add_argument("--verify", action="store_true", help="compare the bundle against the source files")
+    args = parser.parse_args()
+
+    try:
+        image = build(args.base_dir)
+        if args.max_size and len(image) > args.max_size:
+            raise ValueError("bundle size %d exceeds partition size %d" % (len(image), args.max_size))
+        if args.verify:
+            verify(image, args.base_dir)
+    except (OSError, ValueError) as e:
+        print("[ERROR] %s" % e, file=sys.stderr)
+        return 1
+
+    with open(args.output, "wb") as f:
+        f.write(image)
+
+    print("asset bundle: %d files, %d bytes" % (HEADER.unpack_from(image, 0)[2], len(image)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,282 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""Decode, analyze and replay traffic captures downloaded from /api/capture."""
+
+import argparse
+import json
+import socket
+import struct
+import sys
+import time
+
+UART_TX = 0
+UART_RX = 1
+STRATUM_TX = 2
+STRATUM_RX = 3
+
+TYPE_NAMES = {
+    UART_TX: "uart-tx",
+    UART_RX: "uart-rx",
+    STRATUM_TX: "stratum-tx",
+    STRATUM_RX: "stratum-rx",
+}
+
+HEADER = struct.Struct("<5sBBBqII")
+
+# asic job packets: preamble 55 aa, header TYPE_JOB | CMD_WRITE
+ASIC_JOB_HEADER = 0x21
+
+
+class Frame:
+    __slots__ = ("time_us", "type", "data")
+
+    def __init__(self, time_us, type_, data):
+        self.time_us = time_us
+        self.type = type_
+        self.data = data
+
+
+def read_varint(buf, pos):
+    value = 0
+    shift = 0
+    while True:
+        b = buf[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return value, pos
+
+
+def load_capture(path):
+    """Return (header dict, list of frames) of a capture file."""
+    with open(path, "rb") as f:
+        raw = f.read()
+
+    if len(raw) < HEADER.size:
+        raise ValueError("file too short")
+
+    magic, version, sources, _, base_time, frames, dropped = HEADER.unpack_from(raw, 0)
+    if magic != b"NQCAP" or version != 1:
+        raise ValueError("not a capture file (magic %r version %d)" % (magic, version))
+
+    header = {"sources": sources, "base_time_us": base_time, "frames": frames, "dropped": dropped}
+
+    result = []
+    pos = HEADER.size
+    t = base_time
+    while pos < len(raw):
+        delta, pos = read_varint(raw, pos)
+        type_ = raw[pos]
+        pos += 1
+        length, pos = read_varint(raw, pos)
+        if pos + length > len(raw):
+            print("[WARN] truncated frame at offset %d" % pos, file=sys.stderr)
+            break
+        t += delta
+        result.append(Frame(t, type_, raw[pos:pos + length]))
+        pos += length
+
+    return header, result
+
+
+def percentiles(values, points=(50, 90, 99)):
+    if not values:
+        return {}
+    values = sorted(values)
+    out = {}
+    for p in points:
+        idx = min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))
+        out["p%d" % p] = values[idx]
+    out["max"] = values[-1]
+    return out
+
+
+def format_ms(stats):
+    if not stats:
+        return "-"
+    return " ".join("%s=%.1fms" % (k, v / 1000.0) for k, v in stats.items())
+
+
+def stratum_lines(frames, type_):
+    """Split stream frames into json lines, timestamped with the frame that completed them."""
+    pending = b""
+    for fr in frames:
+        if fr.type != type_:
+            continue
+        pending += fr.data
+        while b"\n" in pending:
+            line, pending = pending.split(b"\n", 1)
+            line = line.strip()
+            if not line:
+                continue
+            try:
+                yield fr.time_us, json.loads(line)
+            except ValueError:
+                continue
+
+
+def analyze(header, frames, gap_ms):
+    print("frames: %d (dropped %d before the oldest frame)" % (len(frames), header["dropped"]))
+    if not frames:
+        return
+
+    duration = (frames[-1].time_us - frames[0].time_us) / 1e6
+    print("duration: %.1fs" % duration)
+
+    for type_, name in TYPE_NAMES.items():
+        sel = [f for f in frames if f.type == type_]
+        size = sum(len(f.data) for f in sel)
+        rate = len(sel) / duration if duration > 0 else 0
+        print("  %-11s %8d frames %10d bytes %8.1f frames/s" % (name, len(sel), size, rate))
+
+    # asic side
+    jobs = [f.time_us for f in frames if f.type == UART_TX and len(f.data) > 3 and f.data[2] == ASIC_JOB_HEADER]
+    nonces = [f.time_us for f in frames
+              if f.type == UART_RX and len(f.data) == 11 and f.data[0] == 0xAA and f.data[1] == 0x55 and f.data[10] & 0x80]
+
+    print("\nasic")
+    print("  jobs sent:       %d" % len(jobs))
+    print("  nonces received: %d" % len(nonces))
+    print("  job interval:    %s" % format_ms(percentiles([b - a for a, b in zip(jobs, jobs[1:])])))
+    nonce_gaps = [b - a for a, b in zip(nonces, nonces[1:])]
+    print("  nonce gap:       %s" % format_ms(percentiles(nonce_gaps)))
+
+    long_gaps = [(a, b) for a, b in zip(nonces, nonces[1:]) if b - a > gap_ms * 1000]
+    for a, b in long_gaps[:10]:
+        print("  no nonces for %.1fs at +%.1fs" % ((b - a) / 1e6, (a - frames[0].time_us) / 1e6))
+
+    # burst: max nonces within 100ms
+    burst = 0
+    j = 0
+    for i in range(len(nonces)):
+        while nonces[i] - nonces[j] > 100000:
+            j += 1
+        burst = max(burst, i - j + 1)
+    print("  max nonces/100ms: %d" % burst)
+
+    # pool side
+    notifies = [t for t, m in stratum_lines(frames, STRATUM_RX) if m.get("method") == "mining.notify"]
+    responses = {}
+    for t, m in stratum_lines(frames, STRATUM_RX):
+        if "result" in m or "error" in m:
+            responses.setdefault(m.get("id"), t)
+    submit_latency = []
+    for t, m in stratum_lines(frames, STRATUM_TX):
+        if m.get("method") == "mining.submit" and responses.get(m.get("id"), -1) >= t:
+            submit_latency.append(responses[m.get("id")] - t)
+
+    print("\npool")
+    print("  notifies:          %d" % len(notifies))
+    storm = 0
+    j = 0
+    for i in range(len(notifies)):
+        while notifies[i] - notifies[j] > 1000000:
+            j += 1
+        storm = max(storm, i - j + 1)
+    print("  max notifies/s:    %d" % storm)
+
+    # time from a notify to the next asic job
+    notify_to_job = []
+    k = 0
+    for t in notifies:
+        while k < len(jobs) and jobs[k] < t:
+            k += 1
+        if k < len(jobs):
+            notify_to_job.append(jobs[k] - t)
+    print("  notify -> job:     %s" % format_ms(percentiles(notify_to_job)))
+    print("  submit -> result:  %s" % format_ms(percentiles(submit_latency)))
+
+
+def replay(frames, speed, types):
+    """Print the frames with their original timing."""
+    if not frames:
+        return
+    start_wall = time.monotonic()
+    start_cap = frames[0].time_us
+    for fr in frames:
+        if fr.type not in types:
+            continue
+        wait = (fr.time_us - start_cap) / 1e6 / speed - (time.monotonic() - start_wall)
+        if wait > 0:
+            time.sleep(wait)
+        rel = (fr.time_us - start_cap) / 1e6
+        if fr.type in (STRATUM_TX, STRATUM_RX):
+            text = fr.data.decode("utf-8", "replace").rstrip()
+        else:
+            text = fr.data.hex()
+        print("%10.3f %-11s %s" % (rel, TYPE_NAMES.get(fr.type, "?"), text))
+
+
+def serve_stratum(frames, port, speed):
+    """Act as pool and play the recorded pool messages to a connecting miner."""
+    pool = [f for f in frames if f.type == STRATUM_RX]
+    if not pool:
+        print("[ERROR] capture contains no stratum frames", file=sys.stderr)
+        return 1
+
+    srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    srv.bind(("0.0.0.0", port))
+    srv.listen(1)
+    print("waiting for a miner on port %d ..." % port)
+    conn, addr = srv.accept()
+    print("miner connected from %s:%d, replaying %d frames at %.1fx" % (addr[0], addr[1], len(pool), speed))
+    conn.setblocking(False)
+
+    start_wall = time.monotonic()
+    start_cap = pool[0].time_us
+    for fr in pool:
+        wait = (fr.time_us - start_cap) / 1e6 / speed - (time.monotonic() - start_wall)
+        if wait > 0:
+            time.sleep(wait)
+        # drain what the miner sends, we don't answer it
+        try:
+            while conn.recv(4096):
+                pass
+        except BlockingIOError:
+            pass
+        conn.sendall(fr.data)
+
+    print("replay finished")
+    conn.close()
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Analyze and replay NerdQAxe traffic captures")
+    parser.add_argument("capture", help="capture file downloaded from /api/capture")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("stats", help="frame rates and latency percentiles")
+    p.add_argument("--gap-ms", type=int, default=5000, help="report nonce gaps longer than this")
+
+    p = sub.add_parser("replay", help="print the frames with the original timing")
+    p.add_argument("--speed", type=float, default=1.0, help="replay speed factor")
+    p.add_argument("--only", choices=["uart", "stratum"], help="replay only one source")
+
+    p = sub.add_parser("serve", help="replay the recorded pool messages to a miner")
+    p.add_argument("--port", type=int, default=3333)
+    p.add_argument("--speed", type=float, default=1.0, help="replay speed factor")
+
+    args = parser.parse_args()
+
+    try:
+        header, frames = load_capture(args.capture)
+    except (OSError, ValueError) as e:
+        print("[ERROR] %s" % e, file=sys.stderr)
+        return 1
+
+    if args.cmd == "stats":
+        analyze(header, frames, args.gap_ms)
+    elif args.cmd == "replay":
+        types = {"uart": (UART_TX, UART_RX), "stratum": (STRATUM_TX, STRATUM_RX)}.get(args.only, tuple(TYPE_NAMES))
+        replay(frames, args.speed, types)
+    elif args.cmd == "serve":
+        return serve_stratum(frames, args.port, args.speed)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
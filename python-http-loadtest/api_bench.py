@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""Checks the live API payloads and compares requests per second
+against the monolithic /api/system/info."""
+
+import argparse
+import json
+import sys
+import time
+import urllib.request
+
+# keys every topic must contain
+EXPECTED = {
+    "/api/live": ["timestamp", "uptimeSeconds", "shutdown", "hashRate", "hashRate_1m", "hashRate_10m", "hashRate_1h",
+                  "hashRate_1d", "power", "voltage", "current", "temp", "vrTemp", "fanspeed", "fanrpm",
+                  "sharesAccepted", "sharesRejected", "bestDiff", "bestSessionDiff", "foundBlocks"],
+    "/api/live/pool": ["connected", "poolDifficulty", "poolErrors", "sharesAccepted", "sharesRejected", "foundBlocks",
+                       "totalFoundBlocks", "lastpingrtt", "recentpingloss", "usingFallback"],
+    "/api/live/asic": ["asicCount", "asicTemps", "asicFrequencies", "frequency", "coreVoltage"],
+}
+
+# live keys that have to match the system info (slowly changing values)
+COMPARE = ["sharesAccepted", "sharesRejected", "bestDiff", "foundBlocks", "shutdown"]
+
+
+def fetch(base, path, timeout):
+    with urllib.request.urlopen(base + path, timeout=timeout) as r:
+        return r.read()
+
+
+def check_payloads(base, timeout):
+    errors = 0
+    payloads = {}
+    for path, keys in EXPECTED.items():
+        data = json.loads(fetch(base, path, timeout))
+        payloads[path] = data
+        missing = [k for k in keys if k not in data]
+        if missing:
+            print("%s: missing %s" % (path, ", ".join(missing)))
+            errors += 1
+        else:
+            print("%s: ok (%d bytes)" % (path, len(json.dumps(data))))
+
+    asic = payloads["/api/live/asic"]
+    if len(asic["asicTemps"]) != asic["asicCount"] or len(asic["asicFrequencies"]) != asic["asicCount"]:
+        print("/api/live/asic: array length doesn't match asicCount")
+        errors += 1
+
+    batch = json.loads(fetch(base, "/api/live/batch", timeout))
+    if sorted(batch.keys()) != ["asic", "live", "pool"]:
+        print("/api/live/batch: unexpected topics %s" % sorted(batch.keys()))
+        errors += 1
+    partial = json.loads(fetch(base, "/api/live/batch?topics=pool", timeout))
+    if list(partial.keys()) != ["pool"]:
+        print("/api/live/batch?topics=pool: unexpected topics %s" % list(partial.keys()))
+        errors += 1
+
+    info = json.loads(fetch(base, "/api/system/info", timeout))
+    live = json.loads(fetch(base, "/api/live", timeout))
+    for key in COMPARE:
+        if info.get(key) != live.get(key):
+            print("%s differs: info %r live %r" % (key, info.get(key), live.get(key)))
+            errors += 1
+    return errors
+
+
+def bench(base, path, seconds, timeout):
+    count = 0
+    size = 0
+    start = time.time()
+    while time.time() - start < seconds:
+        size += len(fetch(base, path, timeout))
+        count += 1
+    elapsed = time.time() - start
+    print("%-20s %6.1f req/s  %6d bytes/response" % (path, count / elapsed, size / max(count, 1)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Live API payload check and benchmark")
+    parser.add_argument("host", help="miner IP or hostname")
+    parser.add_argument("--seconds", type=float, default=10.0, help="duration of each benchmark")
+    parser.add_argument("--timeout", type=float, default=10.0)
+    args = parser.parse_args()
+
+    base = "http://%s" % args.host
+
+    errors = check_payloads(base, args.timeout)
+
+    for path in ["/api/system/info", "/api/live", "/api/live/batch"]:
+        bench(base, path, args.seconds, args.timeout)
+
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""Load test for the HTTP server with deliberately slow readers.
+
+Opens a number of connections that request large responses and read them
+at a trickle, while a second set of clients polls small API endpoints and
+records their latency. Without async handling the small calls queue behind
+the slow transfers, with it their tail latency should stay low.
+"""
+
+import argparse
+import socket
+import statistics
+import sys
+import threading
+import time
+
+
+def slow_reader(host, port, path, rate, duration, stats, stop):
+    """Request path and read it at rate bytes per second."""
+    while not stop.is_set():
+        try:
+            s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            # small receive window so the server really has to wait
+            s.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1024)
+            s.settimeout(30)
+            s.connect((host, port))
+            s.sendall(("GET %s HTTP/1.1\r\nHost: %s\r\n\r\n" % (path, host)).encode())
+            start = time.time()
+            total = 0
+            while not stop.is_set() and time.time() - start < duration:
+                data = s.recv(64)
+                if not data:
+                    break
+                total += len(data)
+                time.sleep(len(data) / float(rate))
+            s.close()
+            stats["slow_bytes"] += total
+            stats["slow_requests"] += 1
+        except OSError:
+            stats["slow_errors"] += 1
+            time.sleep(1)
+
+
+def request(host, port, path, timeout):
+    """Single request, returns (status, latency in ms)."""
+    start = time.time()
+    s = socket.create_connection((host, port), timeout=timeout)
+    try:
+        s.sendall(("GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n" % (path, host)).encode())
+        response = b""
+        while True:
+            data = s.recv(4096)
+            if not data:
+                break
+            response += data
+    finally:
+        s.close()
+    status = int(response.split(b" ", 2)[1]) if response.startswith(b"HTTP/") else 0
+    return status, (time.time() - start) * 1000.0
+
+
+def poller(host, port, paths, interval, timeout, latencies, stats, stop):
+    i = 0
+    while not stop.is_set():
+        path = paths[i % len(paths)]
+        i += 1
+        try:
+            status, ms = request(host, port, path, timeout)
+            stats["status_%d" % status] = stats.get("status_%d" % status, 0) + 1
+            if status == 200:
+                latencies.append(ms)
+        except OSError:
+            stats["poll_errors"] += 1
+        time.sleep(interval)
+
+
+def percentile(values, p):
+    values = sorted(values)
+    k = min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))
+    return values[k]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="HTTP tail latency test with slow readers")
+    parser.add_argument("host", help="miner IP or hostname")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--slow", type=int, default=3, help="number of slow readers")
+    parser.add_argument("--slow-path", default="/api/system/info?ts=1&limit=1000", help="large response for the slow readers")
+    parser.add_argument("--rate", type=int, default=512, help="bytes per second per slow reader")
+    parser.add_argument("--pollers", type=int, default=2, help="number of clients polling small endpoints")
+    parser.add_argument("--poll-path", action="append", help="small endpoint (can be repeated)")
+    parser.add_argument("--interval", type=float, default=0.2, help="pause between polls in seconds")
+    parser.add_argument("--timeout", type=float, default=10.0)
+    parser.add_argument("--duration", type=int, default=60, help="test duration in seconds")
+    args = parser.parse_args()
+
+    paths = args.poll_path or ["/api/system/asic", "/api/otp/status", "/api/influx/info"]
+
+    stop = threading.Event()
+    stats = {"slow_bytes": 0, "slow_requests": 0, "slow_errors": 0, "poll_errors": 0}
+    latencies = []
+    threads = []
+
+    for _ in range(args.slow):
+        threads.append(threading.Thread(target=slow_reader,
+                                        args=(args.host, args.port, args.slow_path, args.rate, args.duration, stats, stop)))
+    for _ in range(args.pollers):
+        threads.append(threading.Thread(target=poller,
+                                        args=(args.host, args.port, paths, args.interval, args.timeout, latencies, stats, stop)))
+
+    for t in threads:
+        t.daemon = True
+        t.start()
+
+    try:
+        time.sleep(args.duration)
+    except KeyboardInterrupt:
+        pass
+    stop.set()
+    for t in threads:
+        t.join(args.timeout + 1)
+
+    print("slow readers:  %d requests, %d bytes, %d errors" % (stats["slow_requests"], stats["slow_bytes"], stats["slow_errors"]))
+    print("poll errors:   %d" % stats["poll_errors"])
+    for key in sorted(k for k in stats if k.startswith("status_")):
+        print("HTTP %s:      %d" % (key[7:], stats[key]))
+
+    if not latencies:
+        print("no successful polls")
+        return 1
+
+    print("latency (ms):  n=%d min=%.0f p50=%.0f p90=%.0f p99=%.0f max=%.0f mean=%.0f" % (
+        len(latencies), min(latencies), percentile(latencies, 50), percentile(latencies, 90),
+        percentile(latencies, 99), max(latencies), statistics.mean(latencies)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""Client for the binary websocket telemetry (/api/ws/telemetry).
+
+    ws_telemetry.py <miner>                   print decoded messages
+    ws_telemetry.py <miner> --clients 4       fan-out benchmark
+    ws_telemetry.py --selftest                encoder/decoder round trip
+"""
+
+import argparse
+import base64
+import json
+import os
+import socket
+import struct
+import sys
+import threading
+import time
+
+VERSION = 1
+
+# keep in sync with ws_telemetry.h
+HEADER = struct.Struct("<BBHIQ")
+LIVE = struct.Struct("<10fHHII")
+CHIP = struct.Struct("<3f")
+ASIC_HEAD = struct.Struct("<B3x")
+SHARE = struct.Struct("<BBHII")
+HISTORY = struct.Struct("<Q7f")
+
+TYPES = {1: "live", 2: "asic", 3: "share", 4: "history"}
+
+LIVE_FIELDS = ["hashrate", "hashrate_1m", "hashrate_10m", "hashrate_1h", "hashrate_1d", "power", "voltage",
+               "current", "temp", "vr_temp", "fan_perc", "fan_rpm", "shares_accepted", "shares_rejected"]
+HISTORY_FIELDS = ["timestamp", "hashrate", "hashrate_1m", "hashrate_10m", "hashrate_1h", "hashrate_1d",
+                  "vreg_temp", "asic_temp"]
+
+
+def decode(msg):
+    version, mtype, length, seq, ts = HEADER.unpack_from(msg, 0)
+    if version != VERSION:
+        raise ValueError("unsupported version %d" % version)
+    payload = msg[HEADER.size:HEADER.size + length]
+    if len(payload) != length:
+        raise ValueError("truncated message")
+
+    result = {"type": TYPES.get(mtype, mtype), "seq": seq, "timestamp_ms": ts}
+    if mtype == 1:
+        result.update(zip(LIVE_FIELDS, LIVE.unpack(payload)))
+    elif mtype == 2:
+        (count,) = ASIC_HEAD.unpack_from(payload, 0)
+        if ASIC_HEAD.size + count * CHIP.size != length:
+            raise ValueError("asic count doesn't match length")
+        result["chips"] = [dict(zip(["hashrate", "temp", "frequency"], CHIP.unpack_from(payload, ASIC_HEAD.size + i * CHIP.size)))
+                           for i in range(count)]
+    elif mtype == 3:
+        pool, accepted, _, acc, rej = SHARE.unpack(payload)
+        result.update(pool=pool, accepted=bool(accepted), shares_accepted=acc, shares_rejected=rej)
+    elif mtype == 4:
+        result.update(zip(HISTORY_FIELDS, HISTORY.unpack(payload)))
+    return result
+
+
+def encode(mtype, seq, ts, payload):
+    return HEADER.pack(VERSION, mtype, len(payload), seq, ts) + payload
+
+
+def selftest():
+    live = LIVE.pack(1000.5, 990.0, 995.0, 1001.0, 1002.0, 20.5, 12.0, 1.7, 55.5, 60.25, 80, 4500, 123, 4)
+    d = decode(encode(1, 7, 12345, live))
+    assert d["type"] == "live" and d["seq"] == 7 and d["fan_rpm"] == 4500 and d["shares_rejected"] == 4
+    assert d["vr_temp"] == 60.25 and len(live) == 52
+
+    chips = ASIC_HEAD.pack(2) + CHIP.pack(250.0, 55.0, 500.0) + CHIP.pack(251.0, 56.0, 525.0)
+    d = decode(encode(2, 1, 0, chips))
+    assert [c["frequency"] for c in d["chips"]] == [500.0, 525.0]
+
+    d = decode(encode(3, 2, 0, SHARE.pack(1, 1, 0, 10, 1)))
+    assert d["pool"] == 1 and d["accepted"] and SHARE.size == 12
+
+    d = decode(encode(4, 3, 0, HISTORY.pack(99999, 1, 2, 3, 4, 5, 6, 7)))
+    assert d["timestamp"] == 99999 and d["asic_temp"] == 7.0 and HISTORY.size == 36
+
+    for bad in [encode(2, 1, 0, ASIC_HEAD.pack(3) + CHIP.pack(1, 2, 3)), encode(1, 1, 0, live)[:-1]]:
+        try:
+            decode(bad)
+        except (ValueError, struct.error):
+            continue
+        raise AssertionError("invalid message accepted")
+
+    assert HEADER.size == 16
+    print("selftest ok")
+
+
+class WebSocket:
+    """Minimal websocket client, enough for the telemetry channel."""
+
+    def __init__(self, host, port, path):
+        self.sock = socket.create_connection((host, port), timeout=30)
+        key = base64.b64encode(os.urandom(16)).decode()
+        self.sock.sendall(("GET %s HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                           "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n" % (path, host, key)).encode())
+        response = b""
+        while b"\r\n\r\n" not in response:
+            data = self.sock.recv(1024)
+            if not data:
+                raise OSError("connection closed during handshake")
+            response += data
+        if b" 101 " not in response.split(b"\r\n")[0]:
+            raise OSError("handshake failed: %s" % response.split(b"\r\n")[0].decode())
+        self.buf = response.split(b"\r\n\r\n", 1)[1]
+
+    def _read(self, n):
+        while len(self.buf) < n:
+            data = self.sock.recv(4096)
+            if not data:
+                raise OSError("connection closed")
+            self.buf += data
+        out, self.buf = self.buf[:n], self.buf[n:]
+        return out
+
+    def send_text(self, text):
+        payload = text.encode()
+        mask = os.urandom(4)
+        header = bytes([0x81])
+        if len(payload) < 126:
+            header += bytes([0x80 | len(payload)])
+        else:
+            header += bytes([0x80 | 126]) + struct.pack(">H", len(payload))
+        self.sock.sendall(header + mask + bytes(b ^ mask[i % 4] for i, b in enumerate(payload)))
+
+    def recv(self):
+        """Returns (opcode, payload)."""
+        b0, b1 = self._read(2)
+        length = b1 & 0x7f
+        if length == 126:
+            (length,) = struct.unpack(">H", self._read(2))
+        elif length == 127:
+            (length,) = struct.unpack(">Q", self._read(8))
+        return b0 & 0x0f, self._read(length)
+
+    def close(self):
+        self.sock.close()
+
+
+def subscribe(args):
+    ws = WebSocket(args.host, args.port, "/api/ws/telemetry")
+    ws.send_text(json.dumps({"topics": args.topics, "interval": args.interval}))
+    return ws
+
+
+def monitor(args):
+    ws = subscribe(args)
+    while True:
+        opcode, payload = ws.recv()
+        if opcode == 2:
+            print(json.dumps(decode(payload)))
+        elif opcode == 8:
+            break
+
+
+def bench_client(args, stats, index, stop):
+    counts = {}
+    gaps = 0
+    last_seq = {}
+    try:
+        ws = subscribe(args)
+        ws.sock.settimeout(2)
+        while not stop.is_set():
+            try:
+                opcode, payload = ws.recv()
+            except socket.timeout:
+                continue
+            if opcode != 2:
+                continue
+            msg = decode(payload)
+            counts[msg["type"]] = counts.get(msg["type"], 0) + 1
+            if msg["type"] in last_seq and msg["seq"] != last_seq[msg["type"]] + 1:
+                gaps += 1
+            last_seq[msg["type"]] = msg["seq"]
+        ws.close()
+    except OSError as e:
+        counts["error"] = str(e)
+    stats[index] = (counts, gaps)
+
+
+def bench(args):
+    stop = threading.Event()
+    stats = [None] * args.clients
+    threads = [threading.Thread(target=bench_client, args=(args, stats, i, stop)) for i in range(args.clients)]
+    for t in threads:
+        t.daemon = True
+        t.start()
+    time.sleep(args.duration)
+    stop.set()
+    for t in threads:
+        t.join(5)
+
+    for i, s in enumerate(stats):
+        if s is None:
+            print("client %d: no result" % i)
+            continue
+        counts, gaps = s
+        rates = ", ".join("%s %.2f/s" % (k, v / args.duration) for k, v in sorted(counts.items()) if k != "error")
+        print("client %d: %s, %d seq gaps (skipped by rate limit or dropped) %s" % (i, rates, gaps, counts.get("error", "")))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Websocket telemetry client")
+    parser.add_argument("host", nargs="?", help="miner IP or hostname")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--topics", nargs="+", default=["live", "asic", "share", "history"])
+    parser.add_argument("--interval", type=int, default=1000, help="min ms between state messages")
+    parser.add_argument("--clients", type=int, default=0, help="run the fan-out benchmark with N clients")
+    parser.add_argument("--duration", type=int, default=60)
+    parser.add_argument("--selftest", action="store_true")
+    args = parser.parse_args()
+
+    if args.selftest:
+        selftest()
+        return 0
+    if not args.host:
+        parser.error("host is required")
+    if args.clients:
+        bench(args)
+    else:
+        monitor(args)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())